@@ -1097,8 +1097,9 @@ static VC_CONTAINER_STATUS_T avi_reader_read( VC_CONTAINER_T *p_ctx,
       uint8_t *data = p_packet->data;
       uint32_t buffer_size = p_packet->buffer_size;
       uint32_t size = 0;
-      uint32_t len;     
-      
+      uint32_t len;
+      const uint8_t *borrowed;
+
       /* See if we need to insert extra data */
       if (p_state->extra_chunk_data_len)
       {
@@ -1111,9 +1112,14 @@ static VC_CONTAINER_STATUS_T avi_reader_read( VC_CONTAINER_T *p_ctx,
          p_state->extra_chunk_data_offs += len;
       }
 
-      /* Now try to read data into buffer */
+      /* Now try to read data into buffer, or point straight at the data if
+         the i/o holds it in memory and there's nothing to insert before it */
       len = MIN(buffer_size, p_state->chunk_data_left);
-      READ_BYTES(p_ctx, data, len);
+      if ((flags & VC_CONTAINER_READ_FLAG_ZERO_COPY) && !size &&
+          (borrowed = BORROW_BYTES(p_ctx, len)) != NULL)
+         p_packet->borrowed = borrowed;
+      else
+         READ_BYTES(p_ctx, data, len);
       size += len;
       p_state->chunk_data_left -= len;
       p_packet->size = size;
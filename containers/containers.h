@@ -302,6 +302,8 @@ typedef struct VC_CONTAINER_PACKET_T
    void *user_data;            /**< Field reserved for use by the client */
    void *framework_data;       /**< Field reserved for use by the framework */
 
+   const uint8_t *borrowed;    /**< If set, read-only stream data lent by the reader in place of p_data (see \ref VC_CONTAINER_READ_FLAG_ZERO_COPY) */
+
 } VC_CONTAINER_PACKET_T;
 
 /** \name Container Packet Flags
@@ -471,7 +473,8 @@ VC_CONTAINER_T *vc_container_open_writer( const char *psz_uri, VC_CONTAINER_STAT
    VC_CONTAINER_PROGRESS_REPORT_FUNC_T pf_progress, void *progress_userdata);
 
 /** Closes an instance of a container reader / writer.
- * This will free all the resources associated with the context.
+ * This will free all the resources associated with the context. For writers, an error is
+ * returned if the data couldn't all be written out.
  *
  * \param  context   Pointer to the context of the instance to close
  * \return           the status of the operation
@@ -489,6 +492,10 @@ typedef uint32_t VC_CONTAINER_READ_FLAGS_T;
 #define VC_CONTAINER_READ_FLAG_SKIP   2
 /** Force the container to read data from the specified track */
 #define VC_CONTAINER_READ_FLAG_FORCE_TRACK 4
+/** Ask the container to lend the stream data held in memory through the borrowed pointer
+ * of the packet instead of copying it into the packet buffer, when the i/o allows it.
+ * The borrowed field is only accessed when this flag is given. */
+#define VC_CONTAINER_READ_FLAG_ZERO_COPY 8
 /* @} */
 
 /** Reads a data packet from a container reader.
@@ -504,6 +511,12 @@ typedef uint32_t VC_CONTAINER_READ_FLAGS_T;
  * \ref VC_CONTAINER_READ_FLAG_SKIP will instruct the reader to skip the next packet. In this case
  * it isn't necessary for the caller to pass a pointer to a \ref VC_CONTAINER_PACKET_T structure
  * unless the \ref VC_CONTAINER_READ_FLAG_INFO is also given.\n
+ * \ref VC_CONTAINER_READ_FLAG_ZERO_COPY will instruct the reader to set the borrowed pointer of
+ * the packet to the stream data when it is held in memory (e.g. memory mapped files) instead of
+ * copying it into the data buffer. This data is read-only and remains valid until the container
+ * is closed. The size of the packet is still limited by buffer_size, and readers which can't lend
+ * the data will copy it into the buffer as usual and leave the borrowed pointer to NULL, so callers
+ * need to pass in a valid buffer in all cases.\n
  * A combination of all these flags can be used.
  *
  * \param  context   Pointer to the context of the reader to use
@@ -597,6 +610,72 @@ typedef struct VC_CONTAINER_WRITE_STATS_T
    /** This logs the length of time that we wait for a flush command to complete. */
    VC_CONTAINER_STATS_T flush;
 } VC_CONTAINER_WRITE_STATS_T;
+
+/** This type represents the statistics saved by the io layer when it is reading ahead. */
+typedef struct VC_CONTAINER_READ_STATS_T
+{
+   /** This logs the number of bytes read ahead in count, and the microseconds taken to read
+    * them in num. */
+   VC_CONTAINER_STATS_T read;
+   /** This logs the length of time the read function has to wait for the asynchronous task. */
+   VC_CONTAINER_STATS_T wait;
+   /** Number of reads which found their data already read ahead. */
+   uint32_t hits;
+   /** Number of reads which found their data still being read ahead. */
+   uint32_t pending_hits;
+   /** Number of reads for data which hadn't been read ahead. */
+   uint32_t misses;
+   /** Number of areas read ahead because of VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES hints. */
+   uint32_t hinted;
+   /** Number of areas read ahead which were discarded before being used. */
+   uint32_t wasted;
+} VC_CONTAINER_READ_STATS_T;
+
+/** This type describes an area of a stream. */
+typedef struct VC_CONTAINER_IO_RANGE_T
+{
+   int64_t offset; /**< Offset of the start of the area in the stream */
+   int64_t size;   /**< Size of the area in bytes */
+} VC_CONTAINER_IO_RANGE_T;
+
+/** This type describes a buffer for one datagram of a batch read with
+ * VC_CONTAINER_CONTROL_IO_READ_DATAGRAMS. */
+typedef struct VC_CONTAINER_IO_DATAGRAM_T
+{
+   uint8_t *data;  /**< Where to store the datagram */
+   uint32_t size;  /**< Size of the buffer, updated to the size of the datagram received */
+} VC_CONTAINER_IO_DATAGRAM_T;
+
+/** This type represents the reception statistics kept by a reader for a real-time stream,
+ * e.g. an RTP session. */
+typedef struct VC_CONTAINER_RTP_STATS_T
+{
+   /** Number of packets accepted from the network. */
+   uint32_t received;
+   /** Number of packets expected, from the range of sequence numbers received. */
+   uint32_t expected;
+   /** Number of packets given up on as lost. */
+   uint32_t lost;
+   /** Number of packets which arrived after they had been given up on. They are dropped. */
+   uint32_t late;
+   /** Number of packets which arrived out of order, but in time to be put back in order. */
+   uint32_t reordered;
+   /** Number of duplicate packets dropped. */
+   uint32_t duplicates;
+   /** Estimate of the interarrival jitter, in microseconds. */
+   uint32_t jitter;
+   /** Time currently allowed for a missing packet to arrive, in microseconds. */
+   uint32_t target_latency;
+   /** Number of RTCP sender reports received. */
+   uint32_t sender_reports;
+   /** Number of RTCP receiver reports sent. */
+   uint32_t receiver_reports;
+   /** Sender wallclock time, in microseconds since 1970, of the timestamp below. Zero until
+    * an RTCP sender report has been received. */
+   int64_t wallclock_time;
+   /** Presentation timestamp, in microseconds, which corresponds to the wallclock time. */
+   int64_t wallclock_pts;
+} VC_CONTAINER_RTP_STATS_T;
    
 
 /** Control operations which can be done on containers. */
@@ -660,7 +739,8 @@ typedef enum
 
    /** Collects performance statistics.\n
     * Arguments:\n
-    *   arg1= VC_CONTAINER_WRITE_STATS_T *: */
+    *   arg1= VC_CONTAINER_WRITE_STATS_T *: when writing, or\n
+    *   arg1= VC_CONTAINER_READ_STATS_T *: when reading */
    VC_CONTAINER_CONTROL_GET_IO_PERF_STATS,
 
    /** HACK.\n
@@ -717,6 +797,52 @@ typedef enum
     *   arg2= VC_CONTAINER_FOURCC_T: codec variant to output */
    VC_CONTAINER_CONTROL_TRACK_PACKETIZE,
 
+   /** Hint the io about the areas of the stream which are going to be read next, e.g. the
+    * next chunk of each track of an interleaved stream, so they can be read ahead. The
+    * hints replace any previously given ones.\n
+    * Arguments:\n
+    *   arg1= unsigned int: number of areas\n
+    *   arg2= const VC_CONTAINER_IO_RANGE_T *: list of areas */
+   VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES,
+
+   /** Let a reader keep an index of the stream in memory to speed up seeking, e.g. a copy
+    * of the sample tables of an MP4 file. The index is built when it is first needed.
+    * Some readers keep a small one by default (e.g. Matroska cue points).\n
+    * Arguments:\n
+    *   arg1= uint32_t: maximum amount of memory the index can use, in bytes. 0 disables it. */
+   VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE,
+
+   /** Set the latency budget of the jitter buffer of a real-time stream reader, i.e. the
+    * longest time a missing packet is waited for before it is declared lost. Zero delivers
+    * packets as they arrive and drops any that are out of order.\n
+    * Arguments:\n
+    *   arg1= uint32_t: latency in milliseconds */
+   VC_CONTAINER_CONTROL_SET_JITTER_BUFFER_LATENCY_MS,
+
+   /** Get the reception statistics of a track of a real-time stream reader.\n
+    * Arguments:\n
+    *   arg1= unsigned int: index of the track\n
+    *   arg2= VC_CONTAINER_RTP_STATS_T *: statistics */
+   VC_CONTAINER_CONTROL_GET_RTP_STATS,
+
+   /** Read the datagrams waiting on a datagram i/o (e.g. udp: or rtp:) straight into the
+    * caller's buffers, as many as there are buffers, in as few system calls as possible.
+    * The read timeout applies to the first datagram only.\n
+    * Arguments:\n
+    *   arg1= VC_CONTAINER_IO_DATAGRAM_T *: buffers, whose sizes are updated\n
+    *   arg2= unsigned int: number of buffers\n
+    *   arg3= unsigned int *: number of datagrams read */
+   VC_CONTAINER_CONTROL_IO_READ_DATAGRAMS,
+
+   /** Get the time by which a real-time stream reader needs to be read again even if no
+    * data arrives, e.g. to give up on a missing packet or to send a receiver report. This
+    * lets a caller reading many streams without blocking only come back to each of them
+    * when it has data or when this time is reached.\n
+    * Arguments:\n
+    *   arg1= int64_t *: time in microseconds, as given by vcos_getmicrosecs64(), or
+    *                    INT64_MAX if only the arrival of data matters */
+   VC_CONTAINER_CONTROL_GET_NEXT_READ_TIME,
+
    /** Private user extensions must be above this number */
    VC_CONTAINER_CONTROL_USER_EXTENSIONS = 0x1000
 
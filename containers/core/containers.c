@@ -179,6 +179,7 @@ error:
 /*****************************************************************************/
 VC_CONTAINER_STATUS_T vc_container_close( VC_CONTAINER_T *p_ctx )
 {
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS, io_status;
    unsigned int i;
 
    if(!p_ctx)
@@ -189,15 +190,20 @@ VC_CONTAINER_STATUS_T vc_container_close( VC_CONTAINER_T *p_ctx )
          vc_packetizer_close(p_ctx->tracks[i]->priv->packetizer);
    if(p_ctx->priv->packetizer_buffer) free(p_ctx->priv->packetizer_buffer);
    if(p_ctx->priv->drm_filter) vc_container_filter_close(p_ctx->priv->drm_filter);
-   if(p_ctx->priv->pf_close) p_ctx->priv->pf_close(p_ctx);
-   if(p_ctx->priv->io) vc_container_io_close(p_ctx->priv->io);
+   if(p_ctx->priv->pf_close) status = p_ctx->priv->pf_close(p_ctx);
+   if(p_ctx->priv->io)
+   {
+      /* For writers, this is where the last of the data actually gets committed */
+      io_status = vc_container_io_close(p_ctx->priv->io);
+      if(status == VC_CONTAINER_SUCCESS) status = io_status;
+   }
    if(p_ctx->priv->module_handle) vc_container_unload(p_ctx);
    for(i = 0; i < p_ctx->meta_num; i++) free(p_ctx->meta[i]);
    if(p_ctx->meta_num) free(p_ctx->meta);
    p_ctx->meta_num = 0;
    free(p_ctx);
 
-   return VC_CONTAINER_SUCCESS;
+   return status;
 }
 
 /*****************************************************************************/
@@ -259,6 +265,12 @@ VC_CONTAINER_STATUS_T vc_container_read( VC_CONTAINER_T *p_ctx, VC_CONTAINER_PAC
       (!p_packet || p_packet->track >= p_ctx->tracks_num || !p_ctx->tracks[p_packet->track]->is_enabled))
       return VC_CONTAINER_ERROR_INVALID_ARGUMENT;
 
+   /* Lent data is read-only so it can't go through filters which work in place */
+   if(p_ctx->priv->drm_filter)
+      flags &= ~VC_CONTAINER_READ_FLAG_ZERO_COPY;
+   if(p_packet && (flags & VC_CONTAINER_READ_FLAG_ZERO_COPY))
+      p_packet->borrowed = 0;
+
    /* Always having a packet structure to work with simplifies things */
    if(!p_packet)
       p_packet = &p_ctx->priv->packetizer_packet;
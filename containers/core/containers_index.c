@@ -139,6 +139,61 @@ VC_CONTAINER_STATUS_T vc_container_index_add( VC_CONTAINER_INDEX_T *index, int64
    return VC_CONTAINER_SUCCESS;
 }
 
+VC_CONTAINER_STATUS_T vc_container_index_insert( VC_CONTAINER_INDEX_T *index, int64_t time, int64_t file_offset )
+{
+   int start = 0, end, i;
+
+   if(index == NULL)
+      return VC_CONTAINER_ERROR_FAILED;
+
+   // find the first entry which isn't earlier than the new one
+   end = index->next;
+   while(start < end)
+   {
+      int guess = (start+end)>>1;
+      if(index->entry[ENTRY(index, guess)].time < time)
+         start = guess+1;
+      else
+         end = guess;
+   }
+
+   if(start < index->next && index->entry[ENTRY(index, start)].time == time)
+   {
+      index->entry[ENTRY(index, start)].file_offset = file_offset;
+      return VC_CONTAINER_SUCCESS;
+   }
+
+   if(index->next == (1<<index->len))
+   {
+      // New entry doesn't fit, we discard every other index record
+      // in the same way as vc_container_index_add does.
+      index->next >>= 1;
+      index->gap++;
+      index->mgap--;
+      index->max_count++;
+
+      if(index->gap == index->len)
+      {
+         index->gap = 0;
+         index->mgap = index->len;
+      }
+
+      // only the even records before the insertion point are left
+      start = (start+1)>>1;
+   }
+
+   // make room for the new entry
+   for(i = index->next; i > start; i--)
+      index->entry[ENTRY(index, i)] = index->entry[ENTRY(index, i-1)];
+
+   index->entry[ENTRY(index, start)].file_offset = file_offset;
+   index->entry[ENTRY(index, start)].time = time;
+   index->next++;
+   index->max_time = index->entry[ENTRY(index, index->next-1)].time;
+
+   return VC_CONTAINER_SUCCESS;
+}
+
 VC_CONTAINER_STATUS_T vc_container_index_get( VC_CONTAINER_INDEX_T *index, int later, int64_t *time, int64_t *file_offset, int *past )
 {
    int guess, start, end, entry;
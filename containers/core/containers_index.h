@@ -67,6 +67,20 @@ VC_CONTAINER_STATUS_T vc_container_index_free( VC_CONTAINER_INDEX_T *index );
 VC_CONTAINER_STATUS_T vc_container_index_add( VC_CONTAINER_INDEX_T *index, int64_t time, int64_t file_offset );
 
 
+/**
+ * Inserts an entry anywhere in the index, keeping it in time order.  Unlike
+ * vc_container_index_add, entries don't need to be added in increasing time order,
+ * which suits positions found while searching a stream.  An entry with the same
+ * timestamp as an existing one replaces it.  If the index is full then every other
+ * stored record is discarded.
+ * @param index        Pointer to a valid index.
+ * @param time         Timestamp of new index entry.
+ * @param file_offset  File offset for new index entry.
+ * @return             Status code
+ */
+VC_CONTAINER_STATUS_T vc_container_index_insert( VC_CONTAINER_INDEX_T *index, int64_t time, int64_t file_offset );
+
+
 /**
  * Retrieves the best entry for the supplied time offset.
  * @param index        Pointer to valid index.
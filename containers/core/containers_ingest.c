@@ -0,0 +1,735 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "containers/containers.h"
+#include "containers/core/containers_private.h"
+#include "containers/core/containers_uri.h"
+#include "containers/core/containers_ingest.h"
+#include "containers/net/net_sockets.h"
+#include "interface/vcos/vcos.h"
+
+/******************************************************************************
+Defines and constants.
+******************************************************************************/
+
+/** Interval at which a stream whose reader can't tell when it next needs reading is
+ * serviced, whether or not data arrived for it */
+#define INGEST_TICK_MS           10
+/** Longest time a thread waits, so that it notices being told to stop */
+#define INGEST_WAIT_MAX_MS       100
+/** Maximum number of ready streams handled per wait */
+#define INGEST_EVENTS_MAX        64
+/** Space needed in a stream's unit buffer before reading more data into it */
+#define PACKET_SIZE_MAX          4096
+/** Initial size of a stream's unit buffer */
+#define UNIT_SIZE_INITIAL        (64*1024)
+/** Largest unit kept, bigger ones are dropped */
+#define UNIT_SIZE_MAX            (8*1024*1024)
+/** Socket receive buffer size, to ride out a thread being busy with other streams */
+#define READ_BUFFER_SIZE         (256*1024)
+
+/******************************************************************************
+Type definitions
+******************************************************************************/
+
+typedef struct INGEST_WORKER_T INGEST_WORKER_T;
+
+struct VC_CONTAINER_INGEST_STREAM_T
+{
+   VC_CONTAINER_INGEST_STREAM_T *next;    /**< Next stream of the same thread */
+   INGEST_WORKER_T *worker;               /**< Thread receiving the stream */
+   VC_CONTAINER_NET_T *sock;              /**< Socket the RTP packets arrive on */
+   VC_CONTAINER_T *reader;                /**< Reader of the stream */
+   VC_CONTAINER_INGEST_CALLBACK_T callback;
+   void *userdata;
+
+   bool readable;                         /**< Socket may have data waiting */
+   bool failed;                           /**< Reader failed, nothing more is read */
+   int64_t wakeup;                        /**< Time by which the reader needs reading without data */
+
+   uint8_t *unit;                         /**< Unit being gathered */
+   uint32_t unit_size;                    /**< Bytes of the unit gathered so far */
+   uint32_t unit_capacity;                /**< Size of the unit buffer */
+   bool in_unit;                          /**< A unit has been started */
+   bool framed;                           /**< Reader marks the start and end of units */
+   bool discontinuity;                    /**< Data has been lost before the next unit */
+   VC_CONTAINER_PACKET_T unit_info;       /**< Timestamps and flags of the unit */
+};
+
+struct INGEST_WORKER_T
+{
+   VC_CONTAINER_INGEST_T *ingest;
+   VCOS_THREAD_T thread;
+   VCOS_MUTEX_T lock;                     /**< Protects the streams and their readers */
+   VC_CONTAINER_NET_POLL_T *poll;         /**< Sockets of the streams */
+   VC_CONTAINER_INGEST_STREAM_T *streams;
+   unsigned int streams_num;
+   unsigned int removals;                 /**< Number of streams removed so far */
+   int64_t wakeup;                        /**< No stream needs servicing without data before this */
+   volatile bool stop;
+   bool started;
+};
+
+struct VC_CONTAINER_INGEST_T
+{
+   VCOS_MUTEX_T lock;                     /**< Serialises adding and removing streams */
+   unsigned int workers_num;
+   INGEST_WORKER_T workers[VC_CONTAINER_INGEST_THREADS_MAX];
+};
+
+/** The i/o of a stream's reader reads from the stream's socket, but only when the
+ * thread has been told there is something to read, so that servicing a stream
+ * costs no system calls when it has nothing */
+typedef struct VC_CONTAINER_IO_MODULE_T
+{
+   VC_CONTAINER_INGEST_STREAM_T *stream;
+} VC_CONTAINER_IO_MODULE_T;
+
+/******************************************************************************
+Local Functions
+******************************************************************************/
+
+/*****************************************************************************/
+static vc_container_net_status_t ingest_net_control(VC_CONTAINER_NET_T *sock,
+   vc_container_net_control_t operation, ...)
+{
+   vc_container_net_status_t status;
+   va_list args;
+
+   va_start(args, operation);
+   status = vc_container_net_control(sock, operation, args);
+   va_end(args);
+
+   return status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ingest_io_status(VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   switch (vc_container_net_status(stream->sock))
+   {
+   case VC_CONTAINER_NET_SUCCESS:
+   case VC_CONTAINER_NET_ERROR_TIMED_OUT:
+   case VC_CONTAINER_NET_ERROR_WOULD_BLOCK:
+   case VC_CONTAINER_NET_ERROR_TRY_AGAIN:
+      return VC_CONTAINER_ERROR_ABORTED;
+   case VC_CONTAINER_NET_ERROR_NO_MEMORY:
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   default:
+      return VC_CONTAINER_ERROR_EOS;
+   }
+}
+
+/*****************************************************************************/
+static size_t ingest_io_read(VC_CONTAINER_IO_T *io, void *buffer, size_t size)
+{
+   VC_CONTAINER_INGEST_STREAM_T *stream = io->module->stream;
+   size_t ret = 0;
+
+   if (stream->readable)
+      ret = vc_container_net_read(stream->sock, buffer, size);
+
+   if (ret)
+      io->status = VC_CONTAINER_SUCCESS;
+   else
+   {
+      stream->readable = false;
+      io->status = ingest_io_status(stream);
+   }
+   return ret;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ingest_io_seek(VC_CONTAINER_IO_T *io, int64_t offset)
+{
+   VC_CONTAINER_PARAM_UNUSED(io);
+   VC_CONTAINER_PARAM_UNUSED(offset);
+   return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ingest_io_read_datagrams(VC_CONTAINER_IO_T *io, va_list args)
+{
+   VC_CONTAINER_INGEST_STREAM_T *stream = io->module->stream;
+   VC_CONTAINER_IO_DATAGRAM_T *datagrams = va_arg(args, VC_CONTAINER_IO_DATAGRAM_T *);
+   unsigned int count = va_arg(args, unsigned int);
+   unsigned int *p_received = va_arg(args, unsigned int *);
+   VC_CONTAINER_NET_DATAGRAM_T buffers[INGEST_EVENTS_MAX];
+   size_t ii, received = 0;
+
+   if (count > INGEST_EVENTS_MAX)
+      count = INGEST_EVENTS_MAX;
+
+   if (stream->readable)
+   {
+      for (ii = 0; ii < count; ii++)
+      {
+         buffers[ii].buffer = datagrams[ii].data;
+         buffers[ii].size = datagrams[ii].size;
+      }
+      received = vc_container_net_read_datagrams(stream->sock, buffers, count);
+      for (ii = 0; ii < received; ii++)
+         datagrams[ii].size = (uint32_t)buffers[ii].size;
+   }
+
+   /* A short batch means the socket has been drained */
+   if (received < count)
+      stream->readable = false;
+
+   *p_received = (unsigned int)received;
+   return received ? VC_CONTAINER_SUCCESS : ingest_io_status(stream);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ingest_io_control(VC_CONTAINER_IO_T *io,
+   VC_CONTAINER_CONTROL_T operation, va_list args)
+{
+   VC_CONTAINER_STATUS_T status;
+
+   switch (operation)
+   {
+   case VC_CONTAINER_CONTROL_IO_READ_DATAGRAMS:
+      status = ingest_io_read_datagrams(io, args);
+      break;
+   case VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS:
+      /* Reads never wait, the thread waits on all of its streams at once */
+      status = VC_CONTAINER_SUCCESS;
+      break;
+   case VC_CONTAINER_CONTROL_IO_SET_READ_BUFFER_SIZE:
+      status = vc_container_net_control(io->module->stream->sock,
+            VC_CONTAINER_NET_CONTROL_SET_READ_BUFFER_SIZE, args) == VC_CONTAINER_NET_SUCCESS ?
+         VC_CONTAINER_SUCCESS : VC_CONTAINER_ERROR_FAILED;
+      break;
+   default:
+      status = VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   }
+
+   io->status = status;
+   return status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ingest_io_close(VC_CONTAINER_IO_T *io)
+{
+   /* The socket belongs to the stream */
+   free(io->module);
+   io->module = NULL;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static void ingest_deliver(VC_CONTAINER_INGEST_STREAM_T *stream, VC_CONTAINER_PACKET_T *unit)
+{
+   if (stream->discontinuity)
+      unit->flags |= VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
+   stream->discontinuity = false;
+
+   stream->callback(stream, stream->userdata, unit);
+}
+
+/*****************************************************************************/
+static bool ingest_reserve(VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   uint32_t capacity = stream->unit_capacity;
+   uint8_t *unit;
+
+   if (capacity - stream->unit_size >= PACKET_SIZE_MAX)
+      return true;
+
+   capacity = capacity ? capacity * 2 : UNIT_SIZE_INITIAL;
+   if (capacity > UNIT_SIZE_MAX)
+      return false;
+
+   unit = (uint8_t *)realloc(stream->unit, capacity);
+   if (!unit)
+      return false;
+
+   stream->unit = unit;
+   stream->unit_capacity = capacity;
+   return true;
+}
+
+/** Reads everything the reader of a stream has to give, and hands complete units to
+ * the callback. Must be called with the thread's lock held. */
+static void ingest_service(VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_STATUS_T status;
+
+   stream->wakeup = INT64_MAX;
+   if (stream->failed)
+      return;
+
+   for (;;)
+   {
+      if (!ingest_reserve(stream))
+      {
+         /* Unit too big to keep, or out of memory: drop it */
+         stream->in_unit = false;
+         stream->unit_size = 0;
+         stream->discontinuity = true;
+         if (!stream->unit_capacity)
+            return;
+      }
+
+      memset(&packet, 0, sizeof(packet));
+      packet.data = stream->unit + stream->unit_size;
+      packet.buffer_size = stream->unit_capacity - stream->unit_size;
+
+      status = vc_container_read(stream->reader, &packet, 0);
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_DISCONTINUITY)
+         stream->discontinuity = true;
+
+      if (packet.flags & (VC_CONTAINER_PACKET_FLAG_FRAME_START | VC_CONTAINER_PACKET_FLAG_FRAME_END))
+         stream->framed = true;
+
+      if (!stream->framed)
+      {
+         /* Each read is a unit of its own */
+         ingest_deliver(stream, &packet);
+         continue;
+      }
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
+      {
+         if (stream->in_unit)
+         {
+            /* The previous unit never ended */
+            memmove(stream->unit, packet.data, packet.size);
+            stream->discontinuity = true;
+         }
+         stream->unit_size = 0;
+         stream->unit_info = packet;
+         stream->unit_info.data = stream->unit;
+         stream->in_unit = true;
+      }
+      else if (!stream->in_unit)
+      {
+         /* The middle of a unit whose start was not seen */
+         stream->discontinuity = true;
+         continue;
+      }
+      else
+         stream->unit_info.flags |= packet.flags;
+
+      stream->unit_size += packet.size;
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_END)
+      {
+         stream->unit_info.size = stream->unit_size;
+         stream->unit_info.buffer_size = stream->unit_capacity;
+         stream->unit_info.flags |= VC_CONTAINER_PACKET_FLAG_FRAME_END;
+         ingest_deliver(stream, &stream->unit_info);
+         stream->in_unit = false;
+         stream->unit_size = 0;
+      }
+   }
+
+   if (status != VC_CONTAINER_ERROR_ABORTED && status != VC_CONTAINER_ERROR_CONTINUE &&
+       status != VC_CONTAINER_ERROR_OUT_OF_MEMORY)
+   {
+      /* Nothing more can be read, so stop waiting on the socket */
+      stream->failed = true;
+      vc_container_net_poll_remove(stream->worker->poll, stream->sock);
+      return;
+   }
+
+   /* Only come back without data when the reader needs it, e.g. to give up on a
+    * missing packet, rather than every stream on every tick */
+   if (vc_container_control(stream->reader, VC_CONTAINER_CONTROL_GET_NEXT_READ_TIME,
+                            &stream->wakeup) != VC_CONTAINER_SUCCESS)
+      stream->wakeup = vcos_getmicrosecs64() + INGEST_TICK_MS * 1000;
+}
+
+/** Whether a stream is still one of a thread's. Must be called with the thread's lock held. */
+static bool ingest_worker_has_stream(INGEST_WORKER_T *worker, VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   VC_CONTAINER_INGEST_STREAM_T *it;
+
+   for (it = worker->streams; it; it = it->next)
+      if (it == stream)
+         return true;
+   return false;
+}
+
+/*****************************************************************************/
+static void *ingest_worker_thread(void *arg)
+{
+   INGEST_WORKER_T *worker = (INGEST_WORKER_T *)arg;
+   void *ready[INGEST_EVENTS_MAX];
+   unsigned int removals;
+   int64_t wakeup;
+
+   vcos_mutex_lock(&worker->lock);
+   removals = worker->removals;
+   wakeup = worker->wakeup;
+   vcos_mutex_unlock(&worker->lock);
+
+   while (!worker->stop)
+   {
+      VC_CONTAINER_INGEST_STREAM_T *stream;
+      vc_container_net_status_t net_status;
+      size_t count = INGEST_EVENTS_MAX, ii;
+      uint32_t timeout_ms = INGEST_WAIT_MAX_MS;
+      int64_t now;
+
+      /* Streams are serviced when data arrives for them, and otherwise only when
+       * their reader needs it */
+      now = vcos_getmicrosecs64();
+      if (wakeup <= now)
+         timeout_ms = 0;
+      else if (wakeup - now < INGEST_WAIT_MAX_MS * 1000)
+         timeout_ms = (uint32_t)((wakeup - now + 999) / 1000);
+
+      net_status = vc_container_net_poll_wait(worker->poll, ready, &count, timeout_ms);
+      if (net_status != VC_CONTAINER_NET_SUCCESS)
+         count = 0;
+      if (net_status != VC_CONTAINER_NET_SUCCESS && net_status != VC_CONTAINER_NET_ERROR_TIMED_OUT)
+         vcos_sleep(INGEST_TICK_MS);
+
+      vcos_mutex_lock(&worker->lock);
+
+      for (ii = 0; ii < count; ii++)
+      {
+         stream = (VC_CONTAINER_INGEST_STREAM_T *)ready[ii];
+
+         /* A stream removed during the wait may still be amongst the ready ones */
+         if (worker->removals != removals && !ingest_worker_has_stream(worker, stream))
+            continue;
+         stream->readable = true;
+         ingest_service(stream);
+         if (stream->wakeup < worker->wakeup)
+            worker->wakeup = stream->wakeup;
+      }
+
+      now = vcos_getmicrosecs64();
+      if (now >= worker->wakeup)
+      {
+         worker->wakeup = INT64_MAX;
+         for (stream = worker->streams; stream; stream = stream->next)
+         {
+            if (stream->wakeup <= now)
+               ingest_service(stream);
+            if (stream->wakeup < worker->wakeup)
+               worker->wakeup = stream->wakeup;
+         }
+      }
+
+      removals = worker->removals;
+      wakeup = worker->wakeup;
+      vcos_mutex_unlock(&worker->lock);
+   }
+
+   return NULL;
+}
+
+/*****************************************************************************/
+static void ingest_stream_free(VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   if (stream->reader)
+      vc_container_close(stream->reader);
+   if (stream->sock)
+      vc_container_net_close(stream->sock);
+   free(stream->unit);
+   free(stream);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ingest_stream_open(VC_CONTAINER_INGEST_STREAM_T *stream, const char *uri)
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_URI_PARTS_T *uri_parts;
+   VC_CONTAINER_IO_T *io = NULL;
+   const char *host, *port;
+
+   /* Only receiving on a local port is handled */
+   uri_parts = vc_uri_create();
+   if (!uri_parts)
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   if (!vc_uri_parse(uri_parts, uri)) { status = VC_CONTAINER_ERROR_URI_OPEN_FAILED; goto end; }
+
+   host = vc_uri_host(uri_parts);
+   port = vc_uri_port(uri_parts);
+   if ((host && *host) || !port || !*port) { status = VC_CONTAINER_ERROR_URI_OPEN_FAILED; goto end; }
+
+   stream->sock = vc_container_net_open(NULL, port, 0, NULL);
+   if (!stream->sock) { status = VC_CONTAINER_ERROR_URI_NOT_FOUND; goto end; }
+   ingest_net_control(stream->sock, VC_CONTAINER_NET_CONTROL_SET_READ_BUFFER_SIZE, (uint32_t)READ_BUFFER_SIZE);
+   ingest_net_control(stream->sock, VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS, (uint32_t)0);
+
+   io = vc_container_io_create(uri, VC_CONTAINER_IO_MODE_READ, VC_CONTAINER_IO_CAPS_CANT_SEEK, &status);
+   if (!io)
+      goto end;
+
+   io->module = (VC_CONTAINER_IO_MODULE_T *)malloc(sizeof(*io->module));
+   if (!io->module) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto end; }
+   io->module->stream = stream;
+   io->pf_close = ingest_io_close;
+   io->pf_read = ingest_io_read;
+   io->pf_seek = ingest_io_seek;
+   io->pf_control = ingest_io_control;
+
+   stream->reader = vc_container_open_reader_with_io(io, uri, &status, NULL, NULL);
+   if (!stream->reader)
+      goto end;
+   io = NULL;   /* Now belongs to the reader */
+
+   /* The reader must never wait for data */
+   vc_container_control(stream->reader, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, (uint32_t)0);
+
+end:
+   if (io)
+      vc_container_io_close(io);
+   vc_uri_release(uri_parts);
+   return status;
+}
+
+/******************************************************************************
+Functions exported as part of the API
+******************************************************************************/
+
+/*****************************************************************************/
+VC_CONTAINER_INGEST_T *vc_container_ingest_create(unsigned int threads, VC_CONTAINER_STATUS_T *p_status)
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_INGEST_T *ingest;
+   unsigned int ii;
+
+   if (!threads || threads > VC_CONTAINER_INGEST_THREADS_MAX)
+   {
+      status = VC_CONTAINER_ERROR_INVALID_ARGUMENT;
+      goto end;
+   }
+
+   ingest = (VC_CONTAINER_INGEST_T *)malloc(sizeof(*ingest));
+   if (!ingest) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto end; }
+   memset(ingest, 0, sizeof(*ingest));
+
+   if (vcos_mutex_create(&ingest->lock, "ingest") != VCOS_SUCCESS)
+   {
+      free(ingest);
+      status = VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+      goto end;
+   }
+
+   for (ii = 0; ii < threads; ii++)
+   {
+      INGEST_WORKER_T *worker = &ingest->workers[ii];
+
+      worker->ingest = ingest;
+      worker->wakeup = INT64_MAX;
+      worker->poll = vc_container_net_poll_create(NULL);
+      if (!worker->poll)
+         break;
+      if (vcos_mutex_create(&worker->lock, "ingest_worker") != VCOS_SUCCESS)
+      {
+         vc_container_net_poll_close(worker->poll);
+         break;
+      }
+      ingest->workers_num++;
+
+      if (vcos_thread_create(&worker->thread, "ingest_worker", NULL,
+                             ingest_worker_thread, worker) != VCOS_SUCCESS)
+         break;
+      worker->started = true;
+   }
+
+   if (ii < threads)
+   {
+      vc_container_ingest_destroy(ingest);
+      ingest = NULL;
+      status = VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+   }
+
+end:
+   if (p_status) *p_status = status;
+   return status == VC_CONTAINER_SUCCESS ? ingest : NULL;
+}
+
+/*****************************************************************************/
+void vc_container_ingest_destroy(VC_CONTAINER_INGEST_T *ingest)
+{
+   unsigned int ii;
+
+   if (!ingest)
+      return;
+
+   for (ii = 0; ii < ingest->workers_num; ii++)
+   {
+      INGEST_WORKER_T *worker = &ingest->workers[ii];
+
+      worker->stop = true;
+      if (worker->started)
+         vcos_thread_join(&worker->thread, NULL);
+
+      while (worker->streams)
+      {
+         VC_CONTAINER_INGEST_STREAM_T *stream = worker->streams;
+
+         worker->streams = stream->next;
+         ingest_stream_free(stream);
+      }
+
+      vc_container_net_poll_close(worker->poll);
+      vcos_mutex_delete(&worker->lock);
+   }
+
+   vcos_mutex_delete(&ingest->lock);
+   free(ingest);
+}
+
+/*****************************************************************************/
+VC_CONTAINER_INGEST_STREAM_T *vc_container_ingest_add_stream(VC_CONTAINER_INGEST_T *ingest,
+   const char *uri, VC_CONTAINER_INGEST_CALLBACK_T callback, void *userdata,
+   VC_CONTAINER_STATUS_T *p_status)
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_INGEST_STREAM_T *stream = NULL;
+   INGEST_WORKER_T *worker;
+   unsigned int ii;
+
+   if (!ingest || !uri || !callback) { status = VC_CONTAINER_ERROR_INVALID_ARGUMENT; goto end; }
+
+   stream = (VC_CONTAINER_INGEST_STREAM_T *)malloc(sizeof(*stream));
+   if (!stream) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto end; }
+   memset(stream, 0, sizeof(*stream));
+   stream->callback = callback;
+   stream->userdata = userdata;
+
+   status = ingest_stream_open(stream, uri);
+   if (status != VC_CONTAINER_SUCCESS)
+      goto end;
+
+   vcos_mutex_lock(&ingest->lock);
+
+   worker = &ingest->workers[0];
+   for (ii = 1; ii < ingest->workers_num; ii++)
+      if (ingest->workers[ii].streams_num < worker->streams_num)
+         worker = &ingest->workers[ii];
+
+   vcos_mutex_lock(&worker->lock);
+   if (vc_container_net_poll_add(worker->poll, stream->sock, stream) == VC_CONTAINER_NET_SUCCESS)
+   {
+      stream->worker = worker;
+      stream->next = worker->streams;
+      worker->streams = stream;
+      worker->streams_num++;
+      worker->wakeup = 0;   /* Find out when the new stream needs servicing */
+   }
+   else
+      status = VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+   vcos_mutex_unlock(&worker->lock);
+
+   vcos_mutex_unlock(&ingest->lock);
+
+end:
+   if (status != VC_CONTAINER_SUCCESS && stream)
+   {
+      ingest_stream_free(stream);
+      stream = NULL;
+   }
+   if (p_status) *p_status = status;
+   return stream;
+}
+
+/*****************************************************************************/
+void vc_container_ingest_remove_stream(VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   VC_CONTAINER_INGEST_STREAM_T **p_stream;
+   VC_CONTAINER_INGEST_T *ingest;
+   INGEST_WORKER_T *worker;
+
+   if (!stream)
+      return;
+
+   worker = stream->worker;
+   ingest = worker->ingest;
+
+   vcos_mutex_lock(&ingest->lock);
+
+   /* The thread may still have the stream amongst those it was told are ready,
+    * which it checks for when streams have been removed */
+   vcos_mutex_lock(&worker->lock);
+   if (!stream->failed)
+      vc_container_net_poll_remove(worker->poll, stream->sock);
+   p_stream = &worker->streams;
+   while (*p_stream != stream)
+      p_stream = &(*p_stream)->next;
+   *p_stream = stream->next;
+   worker->streams_num--;
+   worker->removals++;
+   vcos_mutex_unlock(&worker->lock);
+
+   vcos_mutex_unlock(&ingest->lock);
+
+   ingest_stream_free(stream);
+}
+
+/*****************************************************************************/
+const VC_CONTAINER_ES_FORMAT_T *vc_container_ingest_stream_format(VC_CONTAINER_INGEST_STREAM_T *stream)
+{
+   if (!stream || !stream->reader->tracks_num)
+      return NULL;
+   return stream->reader->tracks[0]->format;
+}
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T vc_container_ingest_stream_control(VC_CONTAINER_INGEST_STREAM_T *stream,
+   VC_CONTAINER_CONTROL_T operation, ...)
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   VC_CONTAINER_T *reader;
+   bool locked;
+   va_list args;
+
+   if (!stream)
+      return VC_CONTAINER_ERROR_INVALID_ARGUMENT;
+
+   reader = stream->reader;
+
+   /* The callback may use this, and is already called with the lock held */
+   locked = vcos_thread_current() != &stream->worker->thread;
+   if (locked)
+      vcos_mutex_lock(&stream->worker->lock);
+
+   va_start(args, operation);
+   if (reader->priv->pf_control)
+      status = reader->priv->pf_control(reader, operation, args);
+   va_end(args);
+
+   if (locked)
+      vcos_mutex_unlock(&stream->worker->lock);
+
+   return status;
+}
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef VC_CONTAINERS_INGEST_H
+#define VC_CONTAINERS_INGEST_H
+
+/** \file containers_ingest.h
+ * Engine for receiving many real-time streams (e.g. rtp:) at once with a few threads.
+ * Each thread waits on the sockets of all of its streams together and only reads from
+ * those which have data, rather than every stream needing a thread of its own blocked in
+ * vc_container_read. Complete access units are handed to a callback as they come out of
+ * each stream's reader (and its jitter buffer).
+ */
+
+#include "containers/containers.h"
+
+/** Ingest engine, with its threads */
+typedef struct VC_CONTAINER_INGEST_T VC_CONTAINER_INGEST_T;
+/** A stream being received by an ingest engine */
+typedef struct VC_CONTAINER_INGEST_STREAM_T VC_CONTAINER_INGEST_STREAM_T;
+
+/** Maximum number of threads of an ingest engine */
+#define VC_CONTAINER_INGEST_THREADS_MAX   16
+
+/** Called on one of the engine's threads for each access unit of a stream, in order.
+ * The data only stays valid until the callback returns. A unit after data was lost (i.e.
+ * units which were incomplete, and so were dropped) has VC_CONTAINER_PACKET_FLAG_DISCONTINUITY
+ * set. The callback must not add or remove streams, but may use
+ * vc_container_ingest_stream_control.
+ *
+ * \param  stream    The stream
+ * \param  userdata  As given when the stream was added
+ * \param  unit      The access unit, with its timestamps and flags
+ */
+typedef void (*VC_CONTAINER_INGEST_CALLBACK_T)(VC_CONTAINER_INGEST_STREAM_T *stream,
+   void *userdata, const VC_CONTAINER_PACKET_T *unit);
+
+/** Create an ingest engine.
+ *
+ * \param  threads   Number of threads to spread the streams over, up to
+ *                   VC_CONTAINER_INGEST_THREADS_MAX. One per core is plenty.
+ * \param  p_status  Optional pointer to a variable to receive the status of the operation.
+ * \return           The engine, or NULL on failure.
+ */
+VC_CONTAINER_INGEST_T *vc_container_ingest_create(unsigned int threads, VC_CONTAINER_STATUS_T *p_status);
+
+/** Stop an ingest engine and remove all of its streams.
+ *
+ * \param  ingest    The engine
+ */
+void vc_container_ingest_destroy(VC_CONTAINER_INGEST_T *ingest);
+
+/** Start receiving a stream.
+ * The URI is the same as would be given to vc_container_open_reader, e.g.
+ * rtp://:5004?rtppt=96&mime-type=video/H264, and must give the local port to receive on.
+ * The stream is given to the thread with the fewest streams.
+ *
+ * \param  ingest    The engine
+ * \param  uri       URI of the stream
+ * \param  callback  Function to be called with the access units of the stream
+ * \param  userdata  Value to pass to the callback
+ * \param  p_status  Optional pointer to a variable to receive the status of the operation.
+ * \return           The stream, or NULL on failure.
+ */
+VC_CONTAINER_INGEST_STREAM_T *vc_container_ingest_add_stream(VC_CONTAINER_INGEST_T *ingest,
+   const char *uri, VC_CONTAINER_INGEST_CALLBACK_T callback, void *userdata,
+   VC_CONTAINER_STATUS_T *p_status);
+
+/** Stop receiving a stream. Once this returns, the callback will not be called again for it.
+ * Must not be called from the callback.
+ *
+ * \param  stream    The stream
+ */
+void vc_container_ingest_remove_stream(VC_CONTAINER_INGEST_STREAM_T *stream);
+
+/** Get the format of a stream, as found when it was added.
+ *
+ * \param  stream    The stream
+ * \return           The format, valid until the stream is removed.
+ */
+const VC_CONTAINER_ES_FORMAT_T *vc_container_ingest_stream_format(VC_CONTAINER_INGEST_STREAM_T *stream);
+
+/** Carry out a control operation on the reader of a stream, e.g.
+ * VC_CONTAINER_CONTROL_GET_RTP_STATS or VC_CONTAINER_CONTROL_SET_JITTER_BUFFER_LATENCY_MS.
+ * This is safe to do while the stream is being received.
+ *
+ * \param  stream    The stream
+ * \param  operation The control operation, followed by its arguments
+ * \return           The status of the operation.
+ */
+VC_CONTAINER_STATUS_T vc_container_ingest_stream_control(VC_CONTAINER_INGEST_STREAM_T *stream,
+   VC_CONTAINER_CONTROL_T operation, ...);
+
+#endif /* VC_CONTAINERS_INGEST_H */
@@ -79,6 +79,7 @@ typedef struct VC_CONTAINER_IO_PRIVATE_T
    int64_t actual_offset;
 
    struct VC_CONTAINER_IO_ASYNC_T *async_io;
+   struct VC_CONTAINER_IO_READ_AHEAD_T *read_ahead;
 
 } VC_CONTAINER_IO_PRIVATE_T;
 
@@ -93,6 +94,10 @@ VC_CONTAINER_STATUS_T vc_container_io_pktfile_open( VC_CONTAINER_IO_T *p_ctx, co
                                                  VC_CONTAINER_IO_MODE_T mode );
 VC_CONTAINER_STATUS_T vc_container_io_http_open( VC_CONTAINER_IO_T *p_ctx, const char *uri,
                                                  VC_CONTAINER_IO_MODE_T mode );
+VC_CONTAINER_STATUS_T vc_container_io_mmap_open( VC_CONTAINER_IO_T *p_ctx, const char *uri,
+                                                 VC_CONTAINER_IO_MODE_T mode );
+VC_CONTAINER_STATUS_T vc_container_io_uring_open( VC_CONTAINER_IO_T *p_ctx, const char *uri,
+                                                 VC_CONTAINER_IO_MODE_T mode );
 static VC_CONTAINER_STATUS_T io_seek_not_seekable(VC_CONTAINER_IO_T *p_ctx, int64_t offset);
 
 static size_t vc_container_io_cache_read( VC_CONTAINER_IO_T *p_ctx,
@@ -114,6 +119,16 @@ static VC_CONTAINER_STATUS_T async_io_wait_complete( struct VC_CONTAINER_IO_ASYN
 static void async_io_stats_initialise( struct VC_CONTAINER_IO_ASYNC_T *ctx, int enable );
 static void async_io_stats_get( struct VC_CONTAINER_IO_ASYNC_T *ctx, VC_CONTAINER_WRITE_STATS_T *stats );
 
+static struct VC_CONTAINER_IO_READ_AHEAD_T *read_ahead_start( VC_CONTAINER_IO_T *io );
+static void read_ahead_stop( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx );
+static size_t read_ahead_read( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int64_t offset,
+                               uint8_t *buffer, size_t size );
+static void read_ahead_hint( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, unsigned int num_ranges,
+                             const VC_CONTAINER_IO_RANGE_T *ranges );
+static void read_ahead_lock_io( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int lock );
+static void read_ahead_stats_initialise( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int enable );
+static void read_ahead_stats_get( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, VC_CONTAINER_READ_STATS_T *stats );
+
 /*****************************************************************************/
 static VC_CONTAINER_IO_T *vc_container_io_open_core( const char *uri, VC_CONTAINER_IO_MODE_T mode,
                                                      VC_CONTAINER_IO_CAPABILITIES_T capabilities,
@@ -147,6 +162,8 @@ static VC_CONTAINER_IO_T *vc_container_io_open_core( const char *uri, VC_CONTAIN
 #ifdef ENABLE_CONTAINER_IO_HTTP
       if(status) status = vc_container_io_http_open(p_ctx, uri, mode);
 #endif
+      if(status) status = vc_container_io_mmap_open(p_ctx, uri, mode);
+      if(status) status = vc_container_io_uring_open(p_ctx, uri, mode);
       if(status) status = vc_container_io_file_open(p_ctx, uri, mode);
       if(status != VC_CONTAINER_SUCCESS) goto error;
 
@@ -201,6 +218,11 @@ static VC_CONTAINER_IO_T *vc_container_io_open_core( const char *uri, VC_CONTAIN
    if(mode == VC_CONTAINER_IO_MODE_WRITE && p_ctx->priv->cache && num_areas >= 2)
       p_ctx->priv->async_io = async_io_start( p_ctx, num_areas, 0 );
 
+   /* Try to start reading ahead asynchronously if we're in read mode on a seekable stream */
+   if(mode == VC_CONTAINER_IO_MODE_READ && p_ctx->priv->cache &&
+      !(p_ctx->capabilities & VC_CONTAINER_IO_CAPS_CANT_SEEK))
+      p_ctx->priv->read_ahead = read_ahead_start( p_ctx );
+
  end:
    if(p_status) *p_status = status;
    return p_ctx;
@@ -230,6 +252,7 @@ VC_CONTAINER_IO_T *vc_container_io_create( const char *uri, VC_CONTAINER_IO_MODE
 /*****************************************************************************/
 VC_CONTAINER_STATUS_T vc_container_io_close( VC_CONTAINER_IO_T *p_ctx )
 {
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    unsigned int i;
 
    if(p_ctx)
@@ -242,6 +265,9 @@ VC_CONTAINER_STATUS_T vc_container_io_close( VC_CONTAINER_IO_T *p_ctx )
                vc_container_io_cache_flush( p_ctx, &p_ctx->priv->caches, 1 );
          }
          
+         if(p_ctx->priv->read_ahead)
+            read_ahead_stop( p_ctx->priv->read_ahead );
+
          if(p_ctx->priv->async_io)
             async_io_stop( p_ctx->priv->async_io );
          else if(p_ctx->priv->caches_num)
@@ -251,19 +277,28 @@ VC_CONTAINER_STATUS_T vc_container_io_close( VC_CONTAINER_IO_T *p_ctx )
             free(p_ctx->priv->cached_areas[i].mem);
          
          if(p_ctx->pf_close)
-            p_ctx->pf_close(p_ctx);
+            status = p_ctx->pf_close(p_ctx);
       }
       vc_uri_release(p_ctx->uri_parts);
       free(p_ctx);
    }
-   return VC_CONTAINER_SUCCESS;
+   return status;
 }
 
 /*****************************************************************************/
 size_t vc_container_io_peek(VC_CONTAINER_IO_T *p_ctx, void *buffer, size_t size)
 {
+   const uint8_t *data;
    size_t ret;
 
+   /* No need to move the read position when the data is in memory */
+   data = vc_container_io_peek_borrow(p_ctx, size);
+   if(data)
+   {
+      memcpy(buffer, data, size);
+      return size;
+   }
+
    if(p_ctx->priv->cache)
    {
       /* FIXME: do something a bit more clever than this */
@@ -298,6 +333,30 @@ size_t vc_container_io_read(VC_CONTAINER_IO_T *p_ctx, void *buffer, size_t size)
    return ret;
 }
 
+/*****************************************************************************/
+const uint8_t *vc_container_io_peek_borrow(VC_CONTAINER_IO_T *p_ctx, size_t size)
+{
+   /* Memory can't be lent while reads go through one of our caches as the
+    * stream position of the i/o module isn't ours */
+   if(!p_ctx->pf_borrow || p_ctx->priv->cache)
+      return 0;
+
+   return p_ctx->pf_borrow(p_ctx, p_ctx->offset, size);
+}
+
+/*****************************************************************************/
+const uint8_t *vc_container_io_borrow(VC_CONTAINER_IO_T *p_ctx, size_t size)
+{
+   const uint8_t *data = vc_container_io_peek_borrow(p_ctx, size);
+
+   if(!data || p_ctx->pf_seek(p_ctx, p_ctx->offset + size) != VC_CONTAINER_SUCCESS)
+      return 0;
+
+   p_ctx->offset += size;
+   p_ctx->priv->actual_offset = p_ctx->offset;
+   return data;
+}
+
 /*****************************************************************************/
 size_t vc_container_io_write(VC_CONTAINER_IO_T *p_ctx, const void *buffer, size_t size)
 {
@@ -404,7 +463,12 @@ VC_CONTAINER_STATUS_T vc_container_io_control_list(VC_CONTAINER_IO_T *context, V
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
 
    if (context->pf_control)
+   {
+      /* The read ahead thread might be driving the i/o module */
+      if(context->priv->read_ahead) read_ahead_lock_io(context->priv->read_ahead, 1);
       status = context->pf_control(context, operation, args);
+      if(context->priv->read_ahead) read_ahead_lock_io(context->priv->read_ahead, 0);
+   }
 
    /* Option to add generic I/O control here */
 
@@ -426,6 +490,26 @@ VC_CONTAINER_STATUS_T vc_container_io_control_list(VC_CONTAINER_IO_T *context, V
       async_io_stats_get(context->priv->async_io, va_arg(args, VC_CONTAINER_WRITE_STATS_T *));
    }
 
+   if(operation == VC_CONTAINER_CONTROL_SET_IO_PERF_STATS && context->priv->read_ahead)
+   {
+      status = VC_CONTAINER_SUCCESS;
+      read_ahead_stats_initialise(context->priv->read_ahead, va_arg(args, int));
+   }
+
+   if(operation == VC_CONTAINER_CONTROL_GET_IO_PERF_STATS && context->priv->read_ahead)
+   {
+      status = VC_CONTAINER_SUCCESS;
+      read_ahead_stats_get(context->priv->read_ahead, va_arg(args, VC_CONTAINER_READ_STATS_T *));
+   }
+
+   if(operation == VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES && context->priv->read_ahead)
+   {
+      unsigned int num_ranges = va_arg(args, unsigned int);
+      status = VC_CONTAINER_SUCCESS;
+      read_ahead_hint(context->priv->read_ahead, num_ranges,
+                      va_arg(args, const VC_CONTAINER_IO_RANGE_T *));
+   }
+
    return status;
 }
 
@@ -442,6 +526,28 @@ VC_CONTAINER_STATUS_T vc_container_io_control(VC_CONTAINER_IO_T *context, VC_CON
    return result;
 }
 
+/*****************************************************************************/
+/** Read data at the given offset from the i/o module, or from the read-ahead thread
+ * if there is one since it is then the only one driving the i/o module */
+static size_t vc_container_io_module_read( VC_CONTAINER_IO_T *p_ctx, int64_t offset,
+   uint8_t *buffer, size_t size )
+{
+   size_t ret;
+
+   if(p_ctx->priv->read_ahead)
+      return read_ahead_read( p_ctx->priv->read_ahead, offset, buffer, size );
+
+   if(p_ctx->priv->actual_offset != offset)
+   {
+      if(p_ctx->pf_seek(p_ctx, offset) != VC_CONTAINER_SUCCESS)
+         return 0;
+   }
+
+   ret = p_ctx->pf_read(p_ctx, buffer, size);
+   p_ctx->priv->actual_offset = offset + ret;
+   return ret;
+}
+
 /*****************************************************************************/
 size_t vc_container_io_cache(VC_CONTAINER_IO_T *p_ctx, size_t size)
 {
@@ -492,10 +598,10 @@ size_t vc_container_io_cache(VC_CONTAINER_IO_T *p_ctx, size_t size)
    /* Read the rest of the cache directly from the stream */
    if(cache->mem_size > cache->size)
    {
-      size_t ret = cache->io->pf_read(cache->io, cache->buffer + cache->size,
-                                      cache->mem_size - cache->size);
+      size_t ret = vc_container_io_module_read(cache->io, cache->offset + cache->size,
+                                               cache->buffer + cache->size,
+                                               cache->mem_size - cache->size);
       cache->size += ret;
-      cache->io->priv->actual_offset = cache->offset + cache->size;
    }
 
    status = vc_container_io_seek(p_ctx, cache->end);
@@ -516,16 +622,10 @@ static size_t vc_container_io_cache_refill( VC_CONTAINER_IO_T *p_ctx,
 
    if(ret) return 0; /* TODO what should we do there ? */
 
-   if(p_ctx->priv->actual_offset != cache->offset)
-   {
-      if(cache->io->pf_seek(cache->io, cache->offset) != VC_CONTAINER_SUCCESS)
-         return 0;
-   }
-
-   ret = cache->io->pf_read(cache->io, cache->buffer, cache->buffer_end - cache->buffer);
+   ret = vc_container_io_module_read(cache->io, cache->offset, cache->buffer,
+                                     cache->buffer_end - cache->buffer);
    cache->size = ret;
    cache->position = 0;
-   cache->io->priv->actual_offset = cache->offset + ret;
    return ret;
 }
 
@@ -537,16 +637,9 @@ static size_t vc_container_io_cache_refill_bypass( VC_CONTAINER_IO_T *p_ctx,
 
    if(ret) return 0; /* TODO what should we do there ? */
 
-   if(p_ctx->priv->actual_offset != cache->offset)
-   {
-      if(cache->io->pf_seek(cache->io, cache->offset) != VC_CONTAINER_SUCCESS)
-         return 0;
-   }
-
-   ret = cache->io->pf_read(cache->io, buffer, size);
+   ret = vc_container_io_module_read(cache->io, cache->offset, buffer, size);
    cache->size = cache->position = 0;
    cache->offset += ret;
-   cache->io->priv->actual_offset = cache->offset;
    return ret;
 }
 
@@ -676,16 +769,12 @@ static VC_CONTAINER_STATUS_T vc_container_io_cache_seek(VC_CONTAINER_IO_T *p_ctx
       offset >= cache->offset - (int64_t)shift && offset < cache->offset)
    {
       /* We need to refill the partial bit of the cache that we didn't take care of last time */
-      status = cache->io->pf_seek(cache->io, cache->offset - shift);
-      if(status != VC_CONTAINER_SUCCESS) return status;
+      ret = vc_container_io_module_read(cache->io, cache->offset - shift, cache->buffer - shift, shift);
+      if(ret != shift) return cache->io->status ? cache->io->status : VC_CONTAINER_ERROR_FAILED;
       cache->offset -= shift;
       cache->buffer -= shift;
-
-      ret = cache->io->pf_read(cache->io, cache->buffer, shift);
-      vc_container_assert(ret == shift); /* FIXME: ret must = shift */
       cache->size += shift;
       cache->position = offset - cache->offset;
-      cache->io->priv->actual_offset = cache->offset + ret;
       return VC_CONTAINER_SUCCESS;
    }
 
@@ -694,8 +783,12 @@ static VC_CONTAINER_STATUS_T vc_container_io_cache_seek(VC_CONTAINER_IO_T *p_ctx
 
    if(p_ctx->priv->async_io) async_io_wait_complete( p_ctx->priv->async_io, cache, 1 );
 
-   status = cache->io->pf_seek(cache->io, offset);
-   if(status != VC_CONTAINER_SUCCESS) return status;
+   /* When reading ahead, the seek is only done by the read-ahead thread on the next read */
+   if(!p_ctx->priv->read_ahead)
+   {
+      status = cache->io->pf_seek(cache->io, offset);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
 
    vc_container_io_cache_flush( p_ctx, cache, 1 );
 
@@ -753,10 +846,10 @@ static size_t vc_container_io_cache_flush( VC_CONTAINER_IO_T *p_ctx,
  * to continue its work while the I/O is taking place in the background.
  *****************************************************************************/
 
-#ifdef ENABLE_CONTAINERS_ASYNC_IO
+#if defined(ENABLE_CONTAINERS_ASYNC_IO) || defined(ENABLE_CONTAINERS_READ_AHEAD)
 #include "vcos.h"
 
-#define NUMPC(c,n,s) ((c) < (1<<(s)) ? (n) : ((n) / (c >> (s))))
+#define NUMPC(c,n,s) ((c) < (1U<<(s)) ? (n) : ((n) / (c >> (s))))
 
 static void stats_initialise(VC_CONTAINER_STATS_T *st, uint32_t shift)
 {
@@ -828,7 +921,9 @@ static void stats_add_value(VC_CONTAINER_STATS_T *st, uint32_t count, uint32_t n
       }
    }
 }
+#endif
 
+#ifdef ENABLE_CONTAINERS_ASYNC_IO
 typedef struct VC_CONTAINER_IO_ASYNC_T
 {
    VC_CONTAINER_IO_T *io;
@@ -1085,4 +1180,471 @@ static void async_io_stats_get( struct VC_CONTAINER_IO_ASYNC_T *ctx, VC_CONTAINE
 }
 
 
+#endif
+
+/*****************************************************************************
+ * Asynchronous read-ahead.
+ * This is here to hide the latency of the I/O from readers by having the data
+ * they are about to need read into memory windows in the background. Windows
+ * are read ahead of the sequential read position as well as at the areas of
+ * the stream readers hint at with VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES
+ * (e.g. the next chunk of each track of an interleaved file).
+ * Each stream costs a thread and READ_AHEAD_NUM_WINDOWS windows so, like the
+ * asynchronous writer, it is only built in with ENABLE_CONTAINERS_READ_AHEAD.
+ * Otherwise the cache is refilled synchronously.
+ *****************************************************************************/
+
+#ifdef ENABLE_CONTAINERS_READ_AHEAD
+
+#define READ_AHEAD_WINDOW_SIZE (128*1024) /* Needs to be a power of 2 */
+#define READ_AHEAD_NUM_WINDOWS 8
+#define READ_AHEAD_SEQUENTIAL_WINDOWS 4   /* Windows kept ahead of the read position */
+#define READ_AHEAD_RANGE_WINDOWS 2        /* Windows read ahead for each hinted range */
+#define READ_AHEAD_MAX_RANGES 16
+
+typedef enum
+{
+   READ_AHEAD_WINDOW_FREE = 0,
+   READ_AHEAD_WINDOW_QUEUED,
+   READ_AHEAD_WINDOW_READING,
+   READ_AHEAD_WINDOW_READY
+
+} READ_AHEAD_WINDOW_STATE_T;
+
+typedef struct READ_AHEAD_WINDOW_T
+{
+   READ_AHEAD_WINDOW_STATE_T state;
+   int64_t offset;               /**< Offset of the window in the stream */
+   size_t size;                  /**< Size of the valid data once the window has been read */
+   VC_CONTAINER_STATUS_T status; /**< Status of the i/o after the window has been read */
+   uint32_t queued;              /**< Order in which the window has been queued (0 is urgent) */
+   uint32_t used;                /**< When the window was last used (0 if it never was) */
+   uint8_t *mem;
+
+} READ_AHEAD_WINDOW_T;
+
+typedef struct VC_CONTAINER_IO_READ_AHEAD_T
+{
+   VC_CONTAINER_IO_T *io;
+   VC_CONTAINER_IO_T thread_io; /**< Context of its own the thread uses to drive the i/o module
+                                     so the status and size it updates aren't shared with the reader */
+   VCOS_THREAD_T thread;
+   VCOS_MUTEX_T lock;
+   VCOS_MUTEX_T io_lock;        /**< Held while the i/o module is being used */
+   VCOS_SEMAPHORE_T wake_sema;  /**< Posted when windows have been queued */
+   VCOS_SEMAPHORE_T ready_sema; /**< Posted when the window being waited for has been read */
+   READ_AHEAD_WINDOW_T *waiting;
+   int quit;
+
+   int64_t position;      /**< Current position of the i/o module (-1 if unknown) */
+   int64_t read_offset;   /**< Where the last read ended */
+   int64_t size;          /**< Size of the stream as last reported to the thread */
+   uint32_t queue_count;
+   uint32_t use_count;
+
+   unsigned int num_ranges;
+   VC_CONTAINER_IO_RANGE_T ranges[READ_AHEAD_MAX_RANGES];
+
+   READ_AHEAD_WINDOW_T windows[READ_AHEAD_NUM_WINDOWS];
+
+   int stats_enable;
+   VC_CONTAINER_READ_STATS_T stats;
+
+} VC_CONTAINER_IO_READ_AHEAD_T;
+
+/*****************************************************************************/
+static void read_ahead_stats_initialise( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int enable )
+{
+   vcos_mutex_lock(&ctx->lock);
+   ctx->stats_enable = enable;
+   memset(&ctx->stats, 0, sizeof(ctx->stats));
+   stats_initialise(&ctx->stats.read, 8);
+   stats_initialise(&ctx->stats.wait, 0);
+   vcos_mutex_unlock(&ctx->lock);
+}
+
+static void read_ahead_stats_get( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, VC_CONTAINER_READ_STATS_T *stats )
+{
+   vcos_mutex_lock(&ctx->lock);
+   *stats = ctx->stats;
+   vcos_mutex_unlock(&ctx->lock);
+}
+
+/*****************************************************************************/
+static READ_AHEAD_WINDOW_T *read_ahead_find( VC_CONTAINER_IO_READ_AHEAD_T *ctx, int64_t offset )
+{
+   unsigned int i;
+
+   for(i = 0; i < READ_AHEAD_NUM_WINDOWS; i++)
+      if(ctx->windows[i].state != READ_AHEAD_WINDOW_FREE && ctx->windows[i].offset == offset)
+         return &ctx->windows[i];
+   return 0;
+}
+
+/** Queue a window for reading, recycling one if needed. Windows which have been
+ * read ahead but not used yet are only recycled for urgent reads. */
+static READ_AHEAD_WINDOW_T *read_ahead_queue( VC_CONTAINER_IO_READ_AHEAD_T *ctx, int64_t offset,
+                                              bool urgent )
+{
+   int64_t current = ctx->read_offset & ~(int64_t)(READ_AHEAD_WINDOW_SIZE-1);
+   READ_AHEAD_WINDOW_T *window = 0;
+   uint64_t rank, best_rank = 0;
+   unsigned int i;
+
+   for(i = 0; i < READ_AHEAD_NUM_WINDOWS; i++)
+   {
+      READ_AHEAD_WINDOW_T *candidate = &ctx->windows[i];
+
+      if(candidate->state == READ_AHEAD_WINDOW_FREE) { window = candidate; break; }
+      if(candidate->state == READ_AHEAD_WINDOW_READING || candidate->offset == current)
+         continue;
+      if(!candidate->used && !urgent)
+         continue;
+
+      /* Recycle the least recently used window first, then the most speculative one */
+      rank = candidate->used ? candidate->used : (1ULL << 32) + (uint32_t)~candidate->queued;
+      if(!window || rank < best_rank) { window = candidate; best_rank = rank; }
+   }
+   if(!window) return 0;
+
+   if(window->state == READ_AHEAD_WINDOW_READY && !window->used)
+      ctx->stats.wasted++;
+
+   window->state = READ_AHEAD_WINDOW_QUEUED;
+   window->offset = offset;
+   window->size = 0;
+   window->status = VC_CONTAINER_SUCCESS;
+   window->queued = urgent ? 0 : ++ctx->queue_count;
+   window->used = 0;
+   return window;
+}
+
+/** Queue the windows that are going to be needed next */
+static void read_ahead_schedule( VC_CONTAINER_IO_READ_AHEAD_T *ctx )
+{
+   int64_t offset = ctx->read_offset & ~(int64_t)(READ_AHEAD_WINDOW_SIZE-1);
+   int64_t end = ctx->size ? ctx->size : INT64_MAX;
+   bool queued = false;
+   unsigned int i, j;
+
+   for(i = 0; i < READ_AHEAD_SEQUENTIAL_WINDOWS && offset < end; i++, offset += READ_AHEAD_WINDOW_SIZE)
+   {
+      if(read_ahead_find(ctx, offset)) continue;
+      if(!read_ahead_queue(ctx, offset, false)) break;
+      queued = true;
+   }
+
+   for(i = 0; i < ctx->num_ranges; i++)
+   {
+      VC_CONTAINER_IO_RANGE_T *range = &ctx->ranges[i];
+
+      /* Ranges are read in order so the ones behind the read position are done with */
+      if(range->offset + range->size <= ctx->read_offset)
+      {
+         *range = ctx->ranges[--ctx->num_ranges];
+         i--;
+         continue;
+      }
+
+      offset = range->offset & ~(int64_t)(READ_AHEAD_WINDOW_SIZE-1);
+      for(j = 0; j < READ_AHEAD_RANGE_WINDOWS && offset < end &&
+          offset < range->offset + range->size; j++, offset += READ_AHEAD_WINDOW_SIZE)
+      {
+         if(read_ahead_find(ctx, offset)) continue;
+         if(!read_ahead_queue(ctx, offset, false)) break;
+         ctx->stats.hinted++;
+         queued = true;
+      }
+   }
+
+   if(queued) vcos_semaphore_post(&ctx->wake_sema);
+}
+
+/*****************************************************************************/
+static void *read_ahead_thread(void *argv)
+{
+   VC_CONTAINER_IO_READ_AHEAD_T *ctx = argv;
+   VC_CONTAINER_IO_T *io = &ctx->thread_io;
+
+   vcos_mutex_lock(&ctx->lock);
+   while(!ctx->quit)
+   {
+      READ_AHEAD_WINDOW_T *window = 0;
+      VC_CONTAINER_STATUS_T status;
+      unsigned long time = 0;
+      int64_t offset, stream_size;
+      size_t size = 0;
+      unsigned int i;
+
+      /* Pick the window that was queued first, urgent ones being queued as 0 */
+      for(i = 0; i < READ_AHEAD_NUM_WINDOWS; i++)
+         if(ctx->windows[i].state == READ_AHEAD_WINDOW_QUEUED &&
+            (!window || ctx->windows[i].queued < window->queued))
+            window = &ctx->windows[i];
+
+      if(!window)
+      {
+         vcos_mutex_unlock(&ctx->lock);
+         vcos_semaphore_wait(&ctx->wake_sema);
+         vcos_mutex_lock(&ctx->lock);
+         continue;
+      }
+
+      window->state = READ_AHEAD_WINDOW_READING;
+      offset = window->offset;
+      if(ctx->stats_enable)
+         time = vcos_getmicrosecs();
+      vcos_mutex_unlock(&ctx->lock);
+
+      vcos_mutex_lock(&ctx->io_lock);
+      io->status = VC_CONTAINER_SUCCESS;
+      if(ctx->position == offset || io->pf_seek(io, offset) == VC_CONTAINER_SUCCESS)
+         size = io->pf_read(io, window->mem, READ_AHEAD_WINDOW_SIZE);
+      ctx->position = io->status == VC_CONTAINER_SUCCESS ? offset + (int64_t)size : -1;
+      status = io->status;
+      stream_size = io->size;
+      vcos_mutex_unlock(&ctx->io_lock);
+
+      vcos_mutex_lock(&ctx->lock);
+      if(ctx->stats_enable)
+         stats_add_value(&ctx->stats.read, size, vcos_getmicrosecs() - time);
+
+      /* Handed over to the reader on its next read */
+      if(stream_size > ctx->size) ctx->size = stream_size;
+      window->size = size;
+      window->status = status;
+      window->state = READ_AHEAD_WINDOW_READY;
+      if(ctx->waiting == window)
+      {
+         ctx->waiting = 0;
+         vcos_semaphore_post(&ctx->ready_sema);
+      }
+   }
+   vcos_mutex_unlock(&ctx->lock);
+
+   return NULL;
+}
+
+/*****************************************************************************/
+static size_t read_ahead_read( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int64_t offset,
+                               uint8_t *buffer, size_t size )
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   bool retried = false;
+   size_t read = 0;
+
+   vcos_mutex_lock(&ctx->lock);
+   while(size)
+   {
+      int64_t window_offset = offset & ~(int64_t)(READ_AHEAD_WINDOW_SIZE-1);
+      size_t position = (size_t)(offset - window_offset), bytes;
+      READ_AHEAD_WINDOW_T *window;
+
+      ctx->read_offset = offset;
+      window = read_ahead_find(ctx, window_offset);
+
+      /* A window cut short by the end of the file is read again once, in case data
+       * has been appended to the file since */
+      if(window && window->state == READ_AHEAD_WINDOW_READY && !retried &&
+         position >= window->size && window->size < READ_AHEAD_WINDOW_SIZE)
+      {
+         window->state = READ_AHEAD_WINDOW_FREE;
+         window = 0;
+         retried = true;
+      }
+
+      if(!window)
+      {
+         window = read_ahead_queue(ctx, window_offset, true);
+         vc_container_assert(window); /* Only one window can be in the middle of being read */
+         vcos_semaphore_post(&ctx->wake_sema);
+         ctx->stats.misses++;
+      }
+      else if(window->state != READ_AHEAD_WINDOW_READY)
+         ctx->stats.pending_hits++;
+      else
+         ctx->stats.hits++;
+
+      if(window->state != READ_AHEAD_WINDOW_READY)
+      {
+         unsigned long time = ctx->stats_enable ? vcos_getmicrosecs() : 0;
+
+         ctx->waiting = window;
+         vcos_mutex_unlock(&ctx->lock);
+         vcos_semaphore_wait(&ctx->ready_sema);
+         vcos_mutex_lock(&ctx->lock);
+
+         if(ctx->stats_enable)
+            stats_add_value(&ctx->stats.wait, 1, vcos_getmicrosecs() - time);
+      }
+
+      window->used = ++ctx->use_count;
+      if(position >= window->size)
+      {
+         status = window->status ? window->status : VC_CONTAINER_ERROR_EOS;
+         break;
+      }
+
+      bytes = MIN(size, window->size - position);
+      memcpy(buffer + read, window->mem + position, bytes);
+      offset += bytes;
+      read += bytes;
+      size -= bytes;
+   }
+
+   ctx->read_offset = offset;
+   if(ctx->size > ctx->io->size) ctx->io->size = ctx->size;
+   read_ahead_schedule(ctx);
+   vcos_mutex_unlock(&ctx->lock);
+
+   ctx->io->status = status;
+   return read;
+}
+
+/*****************************************************************************/
+static void read_ahead_hint( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, unsigned int num_ranges,
+                             const VC_CONTAINER_IO_RANGE_T *ranges )
+{
+   if(num_ranges > READ_AHEAD_MAX_RANGES) num_ranges = READ_AHEAD_MAX_RANGES;
+
+   vcos_mutex_lock(&ctx->lock);
+   ctx->num_ranges = ranges ? num_ranges : 0;
+   if(ctx->num_ranges)
+      memcpy(ctx->ranges, ranges, ctx->num_ranges * sizeof(*ranges));
+   read_ahead_schedule(ctx);
+   vcos_mutex_unlock(&ctx->lock);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_IO_READ_AHEAD_T *read_ahead_start( VC_CONTAINER_IO_T *io )
+{
+   VC_CONTAINER_IO_READ_AHEAD_T *ctx = 0;
+   unsigned int i;
+
+   /* Allocate our context and the memory for all the windows in one go */
+   ctx = malloc(sizeof(*ctx) + READ_AHEAD_NUM_WINDOWS * READ_AHEAD_WINDOW_SIZE);
+   if(!ctx) return 0;
+   memset(ctx, 0, sizeof(*ctx));
+   ctx->io = io;
+   ctx->size = io->size;
+
+   /* The thread only gets what it needs to read from the i/o module */
+   ctx->thread_io.module = io->module;
+   ctx->thread_io.uri = io->uri;
+   ctx->thread_io.uri_parts = io->uri_parts;
+   ctx->thread_io.size = io->size;
+   ctx->thread_io.capabilities = io->capabilities;
+   ctx->thread_io.max_size = io->max_size;
+   ctx->thread_io.pf_read = io->pf_read;
+   ctx->thread_io.pf_seek = io->pf_seek;
+   ctx->thread_io.pf_control = io->pf_control;
+   ctx->position = io->priv->actual_offset;
+   ctx->read_offset = io->offset;
+   for(i = 0; i < READ_AHEAD_NUM_WINDOWS; i++)
+      ctx->windows[i].mem = (uint8_t *)&ctx[1] + i * READ_AHEAD_WINDOW_SIZE;
+
+   if(vcos_mutex_create(&ctx->lock, "read_ahead_lock") != VCOS_SUCCESS)
+      goto error_lock;
+   if(vcos_mutex_create(&ctx->io_lock, "read_ahead_io_lock") != VCOS_SUCCESS)
+      goto error_io_lock;
+   read_ahead_stats_initialise(ctx, 0);
+
+   if(vcos_semaphore_create(&ctx->wake_sema, "read_ahead_wake_sem", 0) != VCOS_SUCCESS)
+      goto error_wake_sema;
+
+   if(vcos_semaphore_create(&ctx->ready_sema, "read_ahead_ready_sem", 0) != VCOS_SUCCESS)
+      goto error_ready_sema;
+
+   if(vcos_thread_create(&ctx->thread, "read_ahead", NULL, read_ahead_thread, ctx) != VCOS_SUCCESS)
+      goto error_thread;
+
+   /* Start reading the beginning of the stream straight away */
+   vcos_mutex_lock(&ctx->lock);
+   read_ahead_schedule(ctx);
+   vcos_mutex_unlock(&ctx->lock);
+   return ctx;
+
+ error_thread:
+   vcos_semaphore_delete(&ctx->ready_sema);
+ error_ready_sema:
+   vcos_semaphore_delete(&ctx->wake_sema);
+ error_wake_sema:
+   vcos_mutex_delete(&ctx->io_lock);
+ error_io_lock:
+   vcos_mutex_delete(&ctx->lock);
+ error_lock:
+   free(ctx);
+   return 0;
+}
+
+static void read_ahead_stop( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx )
+{
+   vcos_mutex_lock(&ctx->lock);
+   ctx->quit = 1;
+   vcos_mutex_unlock(&ctx->lock);
+   vcos_semaphore_post(&ctx->wake_sema);
+   vcos_thread_join(&ctx->thread, NULL);
+
+   vcos_semaphore_delete(&ctx->ready_sema);
+   vcos_semaphore_delete(&ctx->wake_sema);
+   vcos_mutex_delete(&ctx->io_lock);
+   vcos_mutex_delete(&ctx->lock);
+   free(ctx);
+}
+
+/*****************************************************************************/
+static void read_ahead_lock_io( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int lock )
+{
+   if(lock) vcos_mutex_lock(&ctx->io_lock);
+   else vcos_mutex_unlock(&ctx->io_lock);
+}
+#else
+
+static struct VC_CONTAINER_IO_READ_AHEAD_T *read_ahead_start( VC_CONTAINER_IO_T *io )
+{
+   VC_CONTAINER_PARAM_UNUSED(io);
+   return 0;
+}
+
+static void read_ahead_stop( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx )
+{
+   VC_CONTAINER_PARAM_UNUSED(ctx);
+}
+
+static size_t read_ahead_read( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int64_t offset,
+                               uint8_t *buffer, size_t size )
+{
+   VC_CONTAINER_PARAM_UNUSED(ctx);
+   VC_CONTAINER_PARAM_UNUSED(offset);
+   VC_CONTAINER_PARAM_UNUSED(buffer);
+   VC_CONTAINER_PARAM_UNUSED(size);
+   return 0;
+}
+
+static void read_ahead_hint( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, unsigned int num_ranges,
+                             const VC_CONTAINER_IO_RANGE_T *ranges )
+{
+   VC_CONTAINER_PARAM_UNUSED(ctx);
+   VC_CONTAINER_PARAM_UNUSED(num_ranges);
+   VC_CONTAINER_PARAM_UNUSED(ranges);
+}
+
+static void read_ahead_lock_io( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int lock )
+{
+   VC_CONTAINER_PARAM_UNUSED(ctx);
+   VC_CONTAINER_PARAM_UNUSED(lock);
+}
+
+static void read_ahead_stats_initialise( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, int enable )
+{
+   VC_CONTAINER_PARAM_UNUSED(ctx);
+   VC_CONTAINER_PARAM_UNUSED(enable);
+}
+
+static void read_ahead_stats_get( struct VC_CONTAINER_IO_READ_AHEAD_T *ctx, VC_CONTAINER_READ_STATS_T *stats )
+{
+   VC_CONTAINER_PARAM_UNUSED(ctx);
+   VC_CONTAINER_PARAM_UNUSED(stats);
+}
+
 #endif
@@ -121,6 +121,11 @@ struct VC_CONTAINER_IO_T
    VC_CONTAINER_STATUS_T (*pf_control)(struct VC_CONTAINER_IO_T *io, 
                                        VC_CONTAINER_CONTROL_T operation, va_list args);
 
+   /** \private
+    * Function pointer to get a pointer to data of the stream held in memory by a
+    * container io module. Can be NULL if the module doesn't support this. */
+   const uint8_t *(*pf_borrow)(struct VC_CONTAINER_IO_T *io, int64_t offset, size_t size);
+
 };
 
 /** Opens an i/o stream pointed to by a URI.
@@ -152,7 +157,8 @@ VC_CONTAINER_IO_T *vc_container_io_create( const char *uri, VC_CONTAINER_IO_MODE
 
 /** Closes an instance of a container i/o module.
  * \param  context     Pointer to the VC_CONTAINER_IO_T context of the instance to close
- * \return             VC_CONTAINER_SUCCESS on success.
+ * \return             VC_CONTAINER_SUCCESS on success, or an error if data written to the
+ *                     i/o couldn't be committed (e.g. a failed final write).
  */
 VC_CONTAINER_STATUS_T vc_container_io_close( VC_CONTAINER_IO_T *context );
 
@@ -172,6 +178,28 @@ size_t vc_container_io_peek(VC_CONTAINER_IO_T *context, void *buffer, size_t siz
  */
 size_t vc_container_io_read(VC_CONTAINER_IO_T *context, void *buffer, size_t size);
 
+/** Borrow data from an i/o stream without copying it.
+ * This returns a pointer to the data at the current position of the stream, held in
+ * memory by the i/o module (e.g. a memory mapped file), and advances the read position
+ * past this data. The data remains valid until the i/o stream is closed.
+ * This is only supported by some i/o modules, and callers need to fall back to
+ * \ref vc_container_io_read when NULL is returned.
+ * \param  context     Pointer to the VC_CONTAINER_IO_T instance to use
+ * \param  size        Number of bytes to borrow
+ * \return             Pointer to the data, or NULL if the data can't be borrowed. The
+ *                     read position is left untouched in that case.
+ */
+const uint8_t *vc_container_io_borrow(VC_CONTAINER_IO_T *context, size_t size);
+
+/** Borrow data from an i/o stream without copying it and without advancing the
+ * read position within the stream.
+ * \see vc_container_io_borrow
+ * \param  context     Pointer to the VC_CONTAINER_IO_T instance to use
+ * \param  size        Number of bytes to borrow
+ * \return             Pointer to the data, or NULL if the data can't be borrowed.
+ */
+const uint8_t *vc_container_io_peek_borrow(VC_CONTAINER_IO_T *context, size_t size);
+
 /** Skip data in an i/o stream without reading it.
  * \param  context     Pointer to the VC_CONTAINER_IO_T instance to use
  * \param  size        Number of bytes to skip
@@ -0,0 +1,242 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_nal.h"
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define NAL_HAVE_AVX2
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+# define NAL_HAVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define NAL_HAVE_NEON
+#endif
+
+/******************************************************************************
+Local Functions
+******************************************************************************/
+
+/** Finds the first two zero bytes followed by a byte which, masked with mask, equals
+ * value. This covers start codes (00 00 01), emulation prevention bytes (00 00 03) and
+ * the sequences which need one inserted (00 00 0x, x <= 3).
+ * Returns the offset of the first zero byte, or size if there is no such sequence. */
+static size_t nal_find_zero_zero(const uint8_t *data, size_t size, uint8_t mask, uint8_t value)
+{
+   size_t i = 0;
+
+#if defined(NAL_HAVE_AVX2)
+   {
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i vmask = _mm256_set1_epi8((char)mask), vvalue = _mm256_set1_epi8((char)value);
+
+      for (; i + 32 + 2 <= size; i += 32)
+      {
+         __m256i a = _mm256_loadu_si256((const __m256i *)(data + i));
+         __m256i b = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+         __m256i c = _mm256_loadu_si256((const __m256i *)(data + i + 2));
+         __m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(a, b), zero),
+            _mm256_cmpeq_epi8(_mm256_and_si256(c, vmask), vvalue));
+         unsigned int bits = (unsigned int)_mm256_movemask_epi8(match);
+         if (bits)
+            return i + __builtin_ctz(bits);
+      }
+   }
+#elif defined(NAL_HAVE_SSE2)
+   {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i vmask = _mm_set1_epi8((char)mask), vvalue = _mm_set1_epi8((char)value);
+
+      for (; i + 16 + 2 <= size; i += 16)
+      {
+         __m128i a = _mm_loadu_si128((const __m128i *)(data + i));
+         __m128i b = _mm_loadu_si128((const __m128i *)(data + i + 1));
+         __m128i c = _mm_loadu_si128((const __m128i *)(data + i + 2));
+         __m128i match = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(a, b), zero),
+            _mm_cmpeq_epi8(_mm_and_si128(c, vmask), vvalue));
+         int bits = _mm_movemask_epi8(match);
+         if (bits)
+            return i + __builtin_ctz(bits);
+      }
+   }
+#elif defined(NAL_HAVE_NEON)
+   {
+      const uint8x16_t zero = vdupq_n_u8(0);
+      const uint8x16_t vmask = vdupq_n_u8(mask), vvalue = vdupq_n_u8(value);
+
+      for (; i + 16 + 2 <= size; i += 16)
+      {
+         uint8x16_t a = vld1q_u8(data + i), b = vld1q_u8(data + i + 1), c = vld1q_u8(data + i + 2);
+         uint8x16_t match = vandq_u8(vceqq_u8(vorrq_u8(a, b), zero),
+            vceqq_u8(vandq_u8(c, vmask), vvalue));
+         /* Narrow to 4 bits per byte to get a mask which can be scanned */
+         uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+         if (bits)
+            return i + (__builtin_ctzll(bits) >> 2);
+      }
+   }
+#endif
+
+   /* A non-zero second byte rules out a match starting at either of the first two */
+   while (i + 2 < size)
+   {
+      if (data[i + 1])
+         i += 2;
+      else if (data[i] || (data[i + 2] & mask) != value)
+         i++;
+      else
+         return i;
+   }
+
+   return size;
+}
+
+/******************************************************************************
+Functions exported as part of the API
+******************************************************************************/
+
+/*****************************************************************************/
+size_t vc_container_nal_find_start_code( const uint8_t *data, size_t size )
+{
+   return nal_find_zero_zero(data, size, 0xFF, 0x01);
+}
+
+/*****************************************************************************/
+size_t vc_container_nal_remove_epb( uint8_t *dst, const uint8_t *src, size_t size )
+{
+   size_t in = 0, out = 0, next, end;
+
+   while (in < size)
+   {
+      /* Copy up to and including the two zero bytes, then skip the 03 */
+      next = in + nal_find_zero_zero(src + in, size - in, 0xFF, 0x03);
+      end = next < size ? next + 2 : size;
+
+      if (dst + out != src + in)
+         memmove(dst + out, src + in, end - in);
+      out += end - in;
+      in = next < size ? next + 3 : size;
+   }
+
+   return out;
+}
+
+/*****************************************************************************/
+size_t vc_container_nal_insert_epb( uint8_t *dst, const uint8_t *src, size_t size )
+{
+   size_t in = 0, out = 0, next, end;
+
+   while (in < size)
+   {
+      /* Copy up to and including the two zero bytes, then insert a 03. The byte after
+       * them starts afresh, so is not part of the next sequence. */
+      next = in + nal_find_zero_zero(src + in, size - in, 0xFC, 0x00);
+      end = next < size ? next + 2 : size;
+
+      memcpy(dst + out, src + in, end - in);
+      out += end - in;
+      if (next < size)
+         dst[out++] = 0x03;
+      in = end;
+   }
+
+   /* Trailing zero bytes (cabac_zero_words) would run into the next start code */
+   if (out >= 2 && !dst[out - 1] && !dst[out - 2])
+      dst[out++] = 0x03;
+
+   return out;
+}
+
+/*****************************************************************************/
+size_t vc_container_nal_annexb_to_avcc( uint8_t *dst, size_t dst_size,
+   const uint8_t *src, size_t size, unsigned int length_size )
+{
+   size_t pos, start, end, nal_size, out = 0;
+   unsigned int i;
+
+   if (length_size < 1 || length_size > 4)
+      return 0;
+
+   pos = vc_container_nal_find_start_code(src, size);
+   while (pos < size)
+   {
+      start = pos + 3;
+      pos = start + vc_container_nal_find_start_code(src + start, size - start);
+
+      /* Drop the zero bytes in front of the next start code */
+      for (end = pos; end > start && !src[end - 1]; end--);
+      nal_size = end - start;
+      if (!nal_size)
+         continue;
+
+      if ((length_size < 4 && nal_size >> (length_size * 8)) ||
+          (uint64_t)nal_size > UINT32_MAX || dst_size - out < length_size + nal_size)
+         return 0;
+
+      for (i = length_size; i > 0; i--)
+         *dst++ = (uint8_t)(nal_size >> ((i - 1) * 8));
+      memcpy(dst, src + start, nal_size);
+      dst += nal_size;
+      out += length_size + nal_size;
+   }
+
+   return out;
+}
+
+/*****************************************************************************/
+size_t vc_container_nal_avcc_to_annexb( uint8_t *dst, size_t dst_size,
+   const uint8_t *src, size_t size, unsigned int length_size )
+{
+   size_t in = 0, out = 0, nal_size;
+   unsigned int i;
+
+   if (length_size < 1 || length_size > 4)
+      return 0;
+
+   while (in < size)
+   {
+      if (size - in < length_size)
+         return 0;
+      for (i = 0, nal_size = 0; i < length_size; i++)
+         nal_size = (nal_size << 8) | src[in++];
+
+      if (nal_size > size - in || dst_size - out < 4 + nal_size)
+         return 0;
+
+      dst[out++] = 0; dst[out++] = 0; dst[out++] = 0; dst[out++] = 1;
+      memcpy(dst + out, src + in, nal_size);
+      in += nal_size;
+      out += nal_size;
+   }
+
+   return out;
+}
@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef VC_CONTAINERS_NAL_H
+#define VC_CONTAINERS_NAL_H
+
+/** \file containers_nal.h
+ * Helpers for H.264 (and H.265) NAL unit byte streams: finding start codes, removing and
+ * inserting emulation prevention bytes, and converting between Annex-B byte streams
+ * (NAL units preceded by 00 00 01 or 00 00 00 01) and ISO 14496-15 (avcC) samples (NAL
+ * units preceded by their size). The scanning is vectorised where SSE2, AVX2 or NEON
+ * is available at compile time.
+ */
+
+#include "containers/containers.h"
+
+/** Largest output of vc_container_nal_insert_epb for a given input size */
+#define VC_CONTAINER_NAL_EPB_SIZE_MAX(size) ((size) + (size) / 2 + 1)
+
+/**
+ * Finds the next start code prefix (00 00 01).
+ * @param data  Data to search.
+ * @param size  Size of the data.
+ * @return      Offset of the start code prefix, or size if there is none.
+ */
+size_t vc_container_nal_find_start_code( const uint8_t *data, size_t size );
+
+/**
+ * Removes the emulation prevention bytes from the payload of a NAL unit, i.e. the 03
+ * from each 00 00 03 sequence. The NAL unit header should not be included.
+ * @param dst   Where to write the result, which may be the same as src.
+ * @param src   Payload to remove the bytes from.
+ * @param size  Size of the payload.
+ * @return      Size of the result.
+ */
+size_t vc_container_nal_remove_epb( uint8_t *dst, const uint8_t *src, size_t size );
+
+/**
+ * Inserts emulation prevention bytes into the payload of a NAL unit, so that it
+ * contains no 00 00 00, 00 00 01, 00 00 02 or 00 00 03 sequence and does not end with
+ * 00 00. The NAL unit header should not be included.
+ * @param dst   Where to write the result, with room for
+ *              VC_CONTAINER_NAL_EPB_SIZE_MAX(size) bytes. Must not overlap src.
+ * @param src   Payload to insert the bytes into.
+ * @param size  Size of the payload.
+ * @return      Size of the result.
+ */
+size_t vc_container_nal_insert_epb( uint8_t *dst, const uint8_t *src, size_t size );
+
+/**
+ * Converts an Annex-B byte stream into NAL units preceded by their size, in big-endian
+ * order. Anything before the first start code is dropped, as are zero bytes following
+ * a NAL unit and empty NAL units.
+ * @param dst          Where to write the result. Must not overlap src.
+ * @param dst_size     Size of the dst buffer.
+ * @param src          Annex-B byte stream.
+ * @param size         Size of the byte stream.
+ * @param length_size  Size of the NAL unit sizes, from 1 to 4 bytes.
+ * @return             Size of the result, or 0 if it did not fit in dst or a NAL unit
+ *                     was too big for length_size.
+ */
+size_t vc_container_nal_annexb_to_avcc( uint8_t *dst, size_t dst_size,
+   const uint8_t *src, size_t size, unsigned int length_size );
+
+/**
+ * Converts NAL units preceded by their size, in big-endian order, into an Annex-B byte
+ * stream with 4 byte start codes.
+ * @param dst          Where to write the result. Must not overlap src.
+ * @param dst_size     Size of the dst buffer.
+ * @param src          NAL units preceded by their size.
+ * @param size         Size of the NAL units.
+ * @param length_size  Size of the NAL unit sizes, from 1 to 4 bytes.
+ * @return             Size of the result, or 0 if it did not fit in dst or the
+ *                     NAL unit sizes do not add up to the size of the data.
+ */
+size_t vc_container_nal_avcc_to_annexb( uint8_t *dst, size_t dst_size,
+   const uint8_t *src, size_t size, unsigned int length_size );
+
+#endif /* VC_CONTAINERS_NAL_H */
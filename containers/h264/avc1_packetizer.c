@@ -38,6 +38,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_logging.h"
 #include "containers/core/containers_utils.h"
 #include "containers/core/containers_bytestream.h"
+#include "containers/core/containers_nal.h"
 
 #ifndef ENABLE_CONTAINERS_LOG_FORMAT_VERBOSE
 //#define ENABLE_CONTAINERS_LOG_FORMAT_VERBOSE
@@ -175,6 +176,22 @@ static VC_CONTAINER_STATUS_T avc1_packetizer_packetize( VC_PACKETIZER_T *p_ctx,
       /* We now know that we'll have to read some data so reset the output size */
       out->size = 0;
 
+      /* A frame held whole in a single packet, which fits in the output buffer,
+       * can be converted in one go */
+      packet = stream->current;
+      if (!module->bytes_read && !stream->offset &&
+          (packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME_END) &&
+          out->buffer_size >= module->frame_size &&
+          vc_container_nal_avcc_to_annexb(out->data, out->buffer_size, packet->data,
+             packet->size, module->length_size) == module->frame_size)
+      {
+         out->size = module->frame_size;
+         bytestream_skip_packet(stream);
+         module->state = STATE_FRAME_WAIT;
+         module->frame_size = 0;
+         return VC_CONTAINER_SUCCESS;
+      }
+
       /* Go to the next relevant state */
       module->state = STATE_NAL_START;
       if (module->nal_bytes_left || module->bytes_read == module->frame_size)
@@ -48,6 +48,28 @@ Defines and constants.
 
 #define IO_HTTP_DEFAULT_PORT     "80"
 
+/** Number of connections kept open on the server. Each one streams a large range of the
+ * file into its own read-ahead ring buffer, so a seek into a distant region (e.g. a moov
+ * atom at the end of the file) doesn't tear down the connection streaming the media data. */
+#define IO_HTTP_NUM_STREAMS            3
+
+/** Default size of the read-ahead ring buffer of each connection */
+#define IO_HTTP_RING_SIZE_DEFAULT      (1024*1024)
+/** Smallest allowed size of the read-ahead ring buffer */
+#define IO_HTTP_RING_SIZE_MIN          (64*1024)
+
+/** Largest range requested in one go on a persistent connection. Ranges start small after
+ * a seek and double each time the stream carries on sequentially, so random accesses don't
+ * make the server send lots of data which will never be read. Servers which close the
+ * connection after each response are asked for everything up to the end of the file. */
+#define IO_HTTP_RANGE_SIZE             (16*1024*1024)
+/** Size of the first range requested after a seek */
+#define IO_HTTP_RANGE_SIZE_MIN         (256*1024)
+
+/** Largest amount of unwanted data read off a persistent connection to be able to reuse it
+ * for another range. Past that, reconnecting is cheaper. */
+#define IO_HTTP_DRAIN_MAX              (256*1024)
+
 /** Space for sending requests and receiving responses */
 #define COMMS_BUFFER_SIZE              4000
 
@@ -64,6 +86,9 @@ Defines and constants.
 /** Format of a range request */
 #define HTTP_RANGE_REQUEST             "Range: bytes=%"PRId64"-%"PRId64"\r\n"
 
+/** Format of a range request going up to the end of the file */
+#define HTTP_OPEN_RANGE_REQUEST        "Range: bytes=%"PRId64"-\r\n"
+
 /** Format string for common headers used with all request methods.
  * Note: includes double new line to terminate headers */
 #define TRAILING_HEADERS_FORMAT        "User-Agent: Broadcom/1.0\r\n\r\n"
@@ -101,14 +126,37 @@ typedef struct http_header_tag {
 /******************************************************************************
 Type definitions
 ******************************************************************************/
-typedef struct VC_CONTAINER_IO_MODULE_T
+
+/** A connection to the server and the data it has delivered.
+ * The ring buffer holds the data between start and offset, each byte being stored at its
+ * file offset modulo the size of the ring. */
+typedef struct IO_HTTP_STREAM_T
 {
    VC_CONTAINER_NET_T *sock;
+   bool response_pending;  /**< Headers of the response to the last request haven't been read */
+   int64_t start;          /**< Offset of the oldest data held in the ring buffer */
+   int64_t offset;         /**< Offset of the next byte coming from the connection */
+   int64_t end;            /**< End of the range requested on the connection */
+   int64_t range_size;     /**< Size of the last range requested */
+   int64_t position;       /**< Where the last read from the stream ended. Reading ahead never
+                                overwrites the data past that point. */
+   uint32_t used;          /**< When the stream was last used (0 if it never was) */
+   uint8_t *ring;
+} IO_HTTP_STREAM_T;
+
+typedef struct VC_CONTAINER_IO_MODULE_T
+{
    VC_CONTAINERS_LIST_T *header_list;           /**< Parsed response headers, pointing into comms buffer */
 
    bool persistent;
    int64_t cur_offset;
-   bool reconnecting;
+
+   size_t ring_size;                            /**< Size of the read-ahead ring buffer of each stream */
+   uint32_t socket_buffer_size;                 /**< Socket read buffer size (0 for the default) */
+   uint32_t read_timeout_ms;
+   uint32_t use_count;
+   IO_HTTP_STREAM_T *current;                   /**< Stream the last read was served from */
+   IO_HTTP_STREAM_T streams[IO_HTTP_NUM_STREAMS];
 
    /* Buffer used for sending and receiving HTTP messages */
    char comms_buffer[COMMS_BUFFER_SIZE];
@@ -119,7 +167,7 @@ Function prototypes
 ******************************************************************************/
 
 static int io_http_header_comparator(const HTTP_HEADER_T *first, const HTTP_HEADER_T *second);
-static VC_CONTAINER_STATUS_T io_http_send(VC_CONTAINER_IO_T *p_ctx);
+static VC_CONTAINER_STATUS_T io_http_send(VC_CONTAINER_IO_T *p_ctx, VC_CONTAINER_NET_T *sock);
 
 VC_CONTAINER_STATUS_T vc_container_io_http_open(VC_CONTAINER_IO_T *, const char *,
    VC_CONTAINER_IO_MODE_T);
@@ -291,7 +339,21 @@ static VC_CONTAINER_STATUS_T translate_net_status_to_container_status(vc_contain
 }
 
 /*****************************************************************************/
-static VC_CONTAINER_STATUS_T io_http_open_socket(VC_CONTAINER_IO_T *ctx)
+static vc_container_net_status_t io_http_net_control(VC_CONTAINER_NET_T *sock,
+   vc_container_net_control_t operation, ...)
+{
+   vc_container_net_status_t net_status;
+   va_list args;
+
+   va_start(args, operation);
+   net_status = vc_container_net_control(sock, operation, args);
+   va_end(args);
+
+   return net_status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_http_open_socket(VC_CONTAINER_IO_T *ctx, IO_HTTP_STREAM_T *stream)
 {
    VC_CONTAINER_IO_MODULE_T *module = ctx->module;
    VC_CONTAINER_STATUS_T status;
@@ -319,13 +381,21 @@ static VC_CONTAINER_STATUS_T io_http_open_socket(VC_CONTAINER_IO_T *ctx)
       goto error;
    }
 
-   module->sock = vc_container_net_open(host, port, VC_CONTAINER_NET_OPEN_FLAG_STREAM, NULL);
-   if (!module->sock)
+   stream->sock = vc_container_net_open(host, port, VC_CONTAINER_NET_OPEN_FLAG_STREAM, NULL);
+   if (!stream->sock)
    {
       status = VC_CONTAINER_ERROR_URI_NOT_FOUND;
       goto error;
    }
 
+   /* Apply the settings which were requested for the connections */
+   if (module->socket_buffer_size)
+      io_http_net_control(stream->sock, VC_CONTAINER_NET_CONTROL_SET_READ_BUFFER_SIZE,
+                          module->socket_buffer_size);
+   if (module->read_timeout_ms != INFINITE_TIMEOUT_MS)
+      io_http_net_control(stream->sock, VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS,
+                          module->read_timeout_ms);
+
    return VC_CONTAINER_SUCCESS;
 
 error:
@@ -333,25 +403,30 @@ error:
 }
 
 /*****************************************************************************/
-static VC_CONTAINER_STATUS_T io_http_close_socket(VC_CONTAINER_IO_MODULE_T *module)
+static VC_CONTAINER_STATUS_T io_http_close_socket(IO_HTTP_STREAM_T *stream)
 {
-   if (module->sock)
+   if (stream->sock)
    {
-      vc_container_net_close(module->sock);
-      module->sock = NULL;
+      vc_container_net_close(stream->sock);
+      stream->sock = NULL;
    }
 
+   /* Nothing more is coming from the connection */
+   stream->response_pending = false;
+   stream->end = stream->offset;
+
    return VC_CONTAINER_SUCCESS;
 }
 
 /*****************************************************************************/
-static size_t io_http_read_from_net(VC_CONTAINER_IO_T *p_ctx, void *buffer, size_t size)
+static size_t io_http_read_from_net(VC_CONTAINER_IO_T *p_ctx, VC_CONTAINER_NET_T *sock,
+   void *buffer, size_t size)
 {
    size_t ret;
    vc_container_net_status_t net_status;
 
-   ret           = vc_container_net_read(p_ctx->module->sock, buffer, size);
-   net_status    = vc_container_net_status(p_ctx->module->sock);
+   ret           = vc_container_net_read(sock, buffer, size);
+   net_status    = vc_container_net_status(sock);
    p_ctx->status = translate_net_status_to_container_status(net_status);
 
    return ret;
@@ -364,9 +439,10 @@ static size_t io_http_read_from_net(VC_CONTAINER_IO_T *p_ctx, void *buffer, size
  * occur in the real headers.
  *
  * @param p_ctx   The HTTP reader context.
+ * @param sock    The connection to read the response from.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T io_http_read_response(VC_CONTAINER_IO_T *p_ctx)
+static VC_CONTAINER_STATUS_T io_http_read_response(VC_CONTAINER_IO_T *p_ctx, VC_CONTAINER_NET_T *sock)
 {
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
    char *next_read = module->comms_buffer;
@@ -392,7 +468,7 @@ static VC_CONTAINER_STATUS_T io_http_read_response(VC_CONTAINER_IO_T *p_ctx)
 
    while (space_available)
    {
-      if (io_http_read_from_net(p_ctx, next_read, 1) != 1)
+      if (io_http_read_from_net(p_ctx, sock, next_read, 1) != 1)
          break;
 
       next_read++;
@@ -491,40 +567,379 @@ static VC_CONTAINER_STATUS_T io_http_read_response(VC_CONTAINER_IO_T *p_ctx)
 }
 
 /**************************************************************************//**
- * Send a GET request to the HTTP server.
+ * Send a GET request for a range of the file to the HTTP server.
  *
  * @param p_ctx      The reader context.
+ * @param sock       The connection to send the request on.
+ * @param offset     Offset in the file of the start of the range.
+ * @param end        Offset in the file of the end of the range.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T io_http_send_get_request(VC_CONTAINER_IO_T *p_ctx, size_t size)
+static VC_CONTAINER_STATUS_T io_http_send_get_request(VC_CONTAINER_IO_T *p_ctx,
+   VC_CONTAINER_NET_T *sock, int64_t offset, int64_t end)
 {
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
-   char *ptr = module->comms_buffer, *end = ptr + sizeof(module->comms_buffer);
-   int64_t end_offset;
+   char *ptr = module->comms_buffer, *buffer_end = ptr + sizeof(module->comms_buffer);
 
-   ptr += snprintf(ptr, end - ptr, HTTP_REQUEST_LINE_FORMAT, GET_METHOD,
+   ptr += snprintf(ptr, buffer_end - ptr, HTTP_REQUEST_LINE_FORMAT, GET_METHOD,
                    vc_uri_path(p_ctx->uri_parts), vc_uri_host(p_ctx->uri_parts));
 
-   end_offset = module->cur_offset + size - 1;
-   if (end_offset >= p_ctx->size)
-      end_offset = p_ctx->size - 1;
+   if (ptr < buffer_end)
+   {
+      if (end >= p_ctx->size)
+         ptr += snprintf(ptr, buffer_end - ptr, HTTP_OPEN_RANGE_REQUEST, offset);
+      else
+         ptr += snprintf(ptr, buffer_end - ptr, HTTP_RANGE_REQUEST, offset, end - 1);
+   }
 
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, HTTP_RANGE_REQUEST, module->cur_offset, end_offset);
+   if (ptr < buffer_end)
+      ptr += snprintf(ptr, buffer_end - ptr, TRAILING_HEADERS_FORMAT);
 
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, TRAILING_HEADERS_FORMAT);
-
-   if (ptr >= end)
+   if (ptr >= buffer_end)
    {
-      LOG_ERROR(0, "comms buffer too small (%i/%u)", (int)(end - ptr),
+      LOG_ERROR(0, "comms buffer too small (%i/%u)", (int)(buffer_end - ptr),
                 sizeof(module->comms_buffer));
       return VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
    }
 
    if (ENABLE_HTTP_EXTRA_LOGGING)
       LOG_DEBUG(NULL, "Sending server read request:\n%s\n---------------------\n", module->comms_buffer);
-   return io_http_send(p_ctx);
+   return io_http_send(p_ctx, sock);
+}
+
+/**************************************************************************//**
+ * Request a range of the file starting at the given offset on a stream.
+ * The connection is reused if the server keeps connections alive and what's
+ * left of the previous response is small enough to be drained, otherwise a
+ * new connection is opened. The data held in the ring buffer is kept if the
+ * new range carries on from it.
+ *
+ * @param p_ctx      The reader context.
+ * @param stream     The stream to send the request on.
+ * @param offset     Offset in the file of the start of the range.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T io_http_stream_request(VC_CONTAINER_IO_T *p_ctx,
+   IO_HTTP_STREAM_T *stream, int64_t offset)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   VC_CONTAINER_STATUS_T status;
+
+   if (stream->sock && (!module->persistent || stream->response_pending ||
+                        stream->end - stream->offset > IO_HTTP_DRAIN_MAX))
+      io_http_close_socket(stream);
+
+   if (stream->sock && stream->offset < stream->end)
+   {
+      /* Drain the rest of the previous response so the connection can be reused */
+      int64_t remaining = stream->end - stream->offset;
+
+      while (remaining > 0)
+      {
+         size_t size = sizeof(module->comms_buffer);
+         if ((int64_t)size > remaining)
+            size = (size_t)remaining;
+
+         size = io_http_read_from_net(p_ctx, stream->sock, module->comms_buffer, size);
+         if (p_ctx->status != VC_CONTAINER_SUCCESS)
+            break;
+         remaining -= size;
+      }
+
+      /* None of the drained data made it into the ring buffer */
+      stream->start = stream->offset = stream->end;
+      if (remaining > 0)
+         io_http_close_socket(stream);
+   }
+
+   if (offset != stream->offset || !stream->range_size)
+      stream->range_size = IO_HTTP_RANGE_SIZE_MIN;
+   else if (stream->range_size < IO_HTTP_RANGE_SIZE)
+      stream->range_size *= 2;
+
+   if (offset != stream->offset)
+      stream->start = stream->offset = offset;
+   stream->position = offset;
+   stream->end = p_ctx->size;
+   if (module->persistent && stream->end - offset > stream->range_size)
+      stream->end = offset + stream->range_size;
+
+   if (!stream->sock)
+   {
+      status = io_http_open_socket(p_ctx, stream);
+      if (status != VC_CONTAINER_SUCCESS)
+      {
+         LOG_ERROR(NULL, "Error opening socket for GET request");
+         goto error;
+      }
+   }
+
+   status = io_http_send_get_request(p_ctx, stream->sock, offset, stream->end);
+   if (status != VC_CONTAINER_SUCCESS)
+   {
+      LOG_ERROR(NULL, "Error sending GET request");
+      goto error;
+   }
+
+   stream->response_pending = true;
+   return VC_CONTAINER_SUCCESS;
+
+error:
+   io_http_close_socket(stream);
+   return status;
+}
+
+/**************************************************************************//**
+ * Read the response to the range request sent on a stream and check that the
+ * server is sending the whole range.
+ *
+ * @param p_ctx      The reader context.
+ * @param stream     The stream to read the response from.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T io_http_stream_response(VC_CONTAINER_IO_T *p_ctx,
+   IO_HTTP_STREAM_T *stream)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   VC_CONTAINER_STATUS_T status;
+   uint64_t content_length;
+
+   status = io_http_read_response(p_ctx, stream->sock);
+   if (status == VC_CONTAINER_ERROR_EOS)
+   {
+      /* The server might have closed a connection which was idle for too long */
+      LOG_DEBUG(NULL, "reconnecting");
+      vc_container_net_close(stream->sock);
+      stream->sock = NULL;
+      status = io_http_open_socket(p_ctx, stream);
+      if (status == VC_CONTAINER_SUCCESS)
+         status = io_http_send_get_request(p_ctx, stream->sock, stream->offset, stream->end);
+      if (status == VC_CONTAINER_SUCCESS)
+         status = io_http_read_response(p_ctx, stream->sock);
+   }
+   if (status != VC_CONTAINER_SUCCESS)
+   {
+      LOG_ERROR(NULL, "Error reading GET response");
+      goto error;
+   }
+
+   /*
+    * How much data is the server offering us?
+    */
+
+   content_length = io_http_get_content_length(module->header_list);
+   if (content_length != (uint64_t)(stream->end - stream->offset))
+   {
+      LOG_ERROR(NULL, "unexpected amount of data (%"PRIu64"/%"PRId64")",
+                content_length, stream->end - stream->offset);
+      status = VC_CONTAINER_ERROR_CORRUPTED;
+      goto error;
+   }
+
+   stream->response_pending = false;
+   return VC_CONTAINER_SUCCESS;
+
+error:
+   io_http_close_socket(stream);
+   return status;
+}
+
+/**************************************************************************//**
+ * Receive data from the connection of a stream into its ring buffer.
+ * Data which hasn't been read yet is never overwritten.
+ *
+ * @param p_ctx      The reader context.
+ * @param stream     The stream to receive data on.
+ * @param wait       Whether to wait for data or only take what has already arrived.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T io_http_stream_receive(VC_CONTAINER_IO_T *p_ctx,
+   IO_HTTP_STREAM_T *stream, bool wait)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   VC_CONTAINER_STATUS_T status;
+   size_t size, index;
+
+   if (!stream->sock || stream->offset >= stream->end)
+      return VC_CONTAINER_ERROR_EOS;
+   if (!wait && !vc_container_net_is_data_available(stream->sock))
+      return VC_CONTAINER_SUCCESS;
+
+   if (stream->response_pending)
+   {
+      status = io_http_stream_response(p_ctx, stream);
+      if (status != VC_CONTAINER_SUCCESS)
+         return status;
+      if (!wait && !vc_container_net_is_data_available(stream->sock))
+         return VC_CONTAINER_SUCCESS;
+   }
+
+   if (!stream->ring)
+   {
+      stream->ring = malloc(module->ring_size);
+      if (!stream->ring)
+         return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   }
+
+   size = module->ring_size;
+   if (stream->position < stream->offset)
+      size -= (size_t)(stream->offset - stream->position);
+   index = (size_t)(stream->offset % module->ring_size);
+   if (size > module->ring_size - index)
+      size = module->ring_size - index;
+   if ((int64_t)size > stream->end - stream->offset)
+      size = (size_t)(stream->end - stream->offset);
+   if (!size)
+      return VC_CONTAINER_SUCCESS;
+
+   size = io_http_read_from_net(p_ctx, stream->sock, stream->ring + index, size);
+   if (p_ctx->status != VC_CONTAINER_SUCCESS)
+   {
+      status = p_ctx->status;
+      io_http_close_socket(stream);
+      return status;
+   }
+
+   stream->offset += size;
+   if (stream->offset - stream->start > (int64_t)module->ring_size)
+      stream->start = stream->offset - module->ring_size;
+
+   /* The server closes the connection once it has sent the response */
+   if (!module->persistent && stream->offset == stream->end)
+      io_http_close_socket(stream);
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Find the stream which holds the data at the given offset, or which will
+ * get to it after receiving less than a ring buffer's worth of data.
+ *
+ * @param p_ctx      The reader context.
+ * @param offset     Offset in the file.
+ * @return  The stream, NULL if none of them is close to the offset.
+ */
+static IO_HTTP_STREAM_T *io_http_stream_lookup(VC_CONTAINER_IO_T *p_ctx, int64_t offset)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   IO_HTTP_STREAM_T *stream;
+   unsigned int i;
+
+   for (i = 0; i < IO_HTTP_NUM_STREAMS; i++)
+   {
+      stream = &module->streams[i];
+      if (offset >= stream->start && offset < stream->offset)
+         return stream;
+   }
+
+   for (i = 0; i < IO_HTTP_NUM_STREAMS; i++)
+   {
+      stream = &module->streams[i];
+      if (stream->sock && offset >= stream->offset && offset < stream->end &&
+          offset - stream->offset < (int64_t)module->ring_size)
+         return stream;
+   }
+
+   return NULL;
+}
+
+/**************************************************************************//**
+ * Get a stream to read the data at the given offset from. If none of them is
+ * close to the offset, the stream which stopped right there or otherwise the
+ * least recently used one is given a new range to fetch.
+ *
+ * @param p_ctx      The reader context.
+ * @param offset     Offset in the file.
+ * @param p_status   Where to return the status if no stream is available.
+ * @return  The stream, NULL on error.
+ */
+static IO_HTTP_STREAM_T *io_http_stream_find(VC_CONTAINER_IO_T *p_ctx, int64_t offset,
+   VC_CONTAINER_STATUS_T *p_status)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   IO_HTTP_STREAM_T *stream;
+   unsigned int i;
+
+   stream = io_http_stream_lookup(p_ctx, offset);
+   if (stream)
+      return stream;
+
+   for (i = 0; i < IO_HTTP_NUM_STREAMS && !stream; i++)
+      if (module->streams[i].offset == offset && module->streams[i].end == offset)
+         stream = &module->streams[i];
+
+   if (!stream)
+      for (i = 0; i < IO_HTTP_NUM_STREAMS; i++)
+         if (!stream || module->streams[i].used < stream->used)
+            stream = &module->streams[i];
+
+   *p_status = io_http_stream_request(p_ctx, stream, offset);
+   return *p_status == VC_CONTAINER_SUCCESS ? stream : NULL;
+}
+
+/**************************************************************************//**
+ * Take in whatever data has already arrived on the connections so they keep
+ * flowing while the data is being processed. The stream being read asks for
+ * its next range as soon as it has received the current one.
+ *
+ * @param p_ctx      The reader context.
+ */
+static void io_http_read_ahead(VC_CONTAINER_IO_T *p_ctx)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   unsigned int i;
+
+   for (i = 0; i < IO_HTTP_NUM_STREAMS; i++)
+   {
+      IO_HTTP_STREAM_T *stream = &module->streams[i];
+      int64_t offset;
+
+      if (stream == module->current && stream->sock && module->persistent &&
+          !stream->response_pending && stream->offset == stream->end &&
+          stream->end < p_ctx->size &&
+          io_http_stream_request(p_ctx, stream, stream->end) != VC_CONTAINER_SUCCESS)
+         continue;
+
+      do {
+         offset = stream->offset;
+      } while (io_http_stream_receive(p_ctx, stream, false) == VC_CONTAINER_SUCCESS &&
+               stream->offset != offset);
+   }
+}
+
+/**************************************************************************//**
+ * Start fetching ranges which will be needed soon on connections of their
+ * own, so they come in parallel with the data currently being read.
+ *
+ * @param p_ctx      The reader context.
+ * @param num_ranges Number of ranges.
+ * @param ranges     The ranges, most urgent first.
+ */
+static void io_http_prefetch(VC_CONTAINER_IO_T *p_ctx, unsigned int num_ranges,
+   const VC_CONTAINER_IO_RANGE_T *ranges)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   unsigned int i, j, requests = 0;
+
+   for (i = 0; i < num_ranges && requests < IO_HTTP_NUM_STREAMS - 1; i++)
+   {
+      IO_HTTP_STREAM_T *stream = NULL;
+      int64_t offset = ranges[i].offset;
+
+      if (offset < 0 || offset >= p_ctx->size || io_http_stream_lookup(p_ctx, offset))
+         continue;
+
+      /* Never take the stream being read away */
+      for (j = 0; j < IO_HTTP_NUM_STREAMS; j++)
+         if (&module->streams[j] != module->current &&
+             (!stream || module->streams[j].used < stream->used))
+            stream = &module->streams[j];
+
+      if (io_http_stream_request(p_ctx, stream, offset) != VC_CONTAINER_SUCCESS)
+         break;
+      stream->used = ++module->use_count;
+      requests++;
+   }
 }
 
 /*****************************************************************************/
@@ -552,11 +967,16 @@ static VC_CONTAINER_STATUS_T io_http_seek(VC_CONTAINER_IO_T *p_ctx, int64_t offs
 static VC_CONTAINER_STATUS_T io_http_close(VC_CONTAINER_IO_T *p_ctx)
 {
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   unsigned int i;
 
    if (!module)
       return VC_CONTAINER_ERROR_INVALID_ARGUMENT;
 
-   io_http_close_socket(module);
+   for (i = 0; i < IO_HTTP_NUM_STREAMS; i++)
+   {
+      io_http_close_socket(&module->streams[i]);
+      free(module->streams[i].ring);
+   }
    if (module->header_list)
       vc_containers_list_destroy(module->header_list);
 
@@ -571,108 +991,80 @@ static size_t io_http_read(VC_CONTAINER_IO_T *p_ctx, void *buffer, size_t size)
 {
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
-   size_t content_length;
-   size_t bytes_read;
+   IO_HTTP_STREAM_T *stream;
+   uint8_t *ptr = buffer;
+   bool retried = false;
    size_t ret = 0;
-   char *ptr = buffer;
 
-   /*
-    * Are we at the end of the file?
-    */
-
-   if (module->cur_offset >= p_ctx->size)
+   while (ret < size)
    {
-      p_ctx->status = VC_CONTAINER_ERROR_EOS;
-      return 0;
-   }
-
-   if (!module->persistent)
-   {
-      status = io_http_open_socket(p_ctx);
-      if (status != VC_CONTAINER_SUCCESS)
-      {
-         LOG_ERROR(NULL, "Error opening socket for GET request");
-         return status;
-      }
-   }
+      int64_t offset = module->cur_offset;
+      size_t index, bytes;
 
-   /* Send GET request and get response */
-   status = io_http_send_get_request(p_ctx, size);
-   if (status != VC_CONTAINER_SUCCESS)
-   {
-      LOG_ERROR(NULL, "Error sending GET request");
-      goto error;
-   }
+      /*
+       * Are we at the end of the file?
+       */
 
-   status = io_http_read_response(p_ctx);
-   if (status == VC_CONTAINER_ERROR_EOS && !module->reconnecting)
-   {
-      LOG_DEBUG(NULL, "reconnecting");
-      io_http_close_socket(module);
-      status = io_http_open_socket(p_ctx);
-      if (status == VC_CONTAINER_SUCCESS)
+      if (offset >= p_ctx->size)
       {
-         module->reconnecting = true;
-         status = io_http_read(p_ctx, buffer, size);
-         module->reconnecting = false;
-         return status;
+         status = VC_CONTAINER_ERROR_EOS;
+         break;
       }
-   }
-   if (status != VC_CONTAINER_SUCCESS)
-   {
-      LOG_ERROR(NULL, "Error reading GET response");
-      goto error;
-   }
-
-   /*
-    * How much data is the server offering us?
-    */
 
-   content_length = (size_t)io_http_get_content_length(module->header_list);
-   if (content_length > size)
-   {
-      LOG_ERROR(NULL, "received too much data (%i/%i)",
-                (int)content_length, (int)size);
-      status = VC_CONTAINER_ERROR_CORRUPTED;
-      goto error;
-   }
+      stream = io_http_stream_find(p_ctx, offset, &status);
+      if (!stream)
+         break;
+      stream->used = ++module->use_count;
+      module->current = stream;
 
-   bytes_read = 0;
-   while (bytes_read < content_length && p_ctx->status == VC_CONTAINER_SUCCESS)
-   {
-      ret = io_http_read_from_net(p_ctx, ptr, content_length - bytes_read);
-      if (p_ctx->status == VC_CONTAINER_SUCCESS)
+      if (offset >= stream->offset)
       {
-         bytes_read += ret;
-         ptr += ret;
+         /* Wait for the data, skipping anything before it */
+         if (stream->position < offset)
+            stream->position = offset;
+         status = io_http_stream_receive(p_ctx, stream, true);
+         if (status == VC_CONTAINER_SUCCESS)
+            retried = false;
+         else if (!retried)
+         {
+            /* The connection has been closed, give a new one a go */
+            status = VC_CONTAINER_SUCCESS;
+            retried = true;
+         }
+         else
+            break;
+         continue;
       }
-   }
 
-   if (p_ctx->status == VC_CONTAINER_SUCCESS)
-   {
-      module->cur_offset += bytes_read;
-      ret = bytes_read;
+      /* Copy the data out of the ring buffer */
+      index = (size_t)(offset % module->ring_size);
+      bytes = size - ret;
+      if ((int64_t)bytes > stream->offset - offset)
+         bytes = (size_t)(stream->offset - offset);
+      if (bytes > module->ring_size - index)
+         bytes = module->ring_size - index;
+
+      memcpy(ptr + ret, stream->ring + index, bytes);
+      ret += bytes;
+      module->cur_offset += bytes;
+      if (stream->position < module->cur_offset)
+         stream->position = module->cur_offset;
    }
 
-   if (!module->persistent)
-      io_http_close_socket(module);
+   io_http_read_ahead(p_ctx);
 
+   p_ctx->status = status;
    return ret;
-
-error:
-   if (!module->persistent)
-      io_http_close_socket(module);
-
-   return status;
 }
 
 /*****************************************************************************/
-static size_t io_http_write(VC_CONTAINER_IO_T *p_ctx, const void *buffer, size_t size)
+static size_t io_http_write(VC_CONTAINER_IO_T *p_ctx, VC_CONTAINER_NET_T *sock,
+   const void *buffer, size_t size)
 {
-   size_t ret = vc_container_net_write(p_ctx->module->sock, buffer, size);
+   size_t ret = vc_container_net_write(sock, buffer, size);
    vc_container_net_status_t net_status;
 
-   net_status = vc_container_net_status(p_ctx->module->sock);
+   net_status = vc_container_net_status(sock);
    p_ctx->status = translate_net_status_to_container_status(net_status);
 
    return ret;
@@ -683,16 +1075,44 @@ static VC_CONTAINER_STATUS_T io_http_control(struct VC_CONTAINER_IO_T *p_ctx,
       VC_CONTAINER_CONTROL_T operation,
       va_list args)
 {
-   vc_container_net_status_t net_status;
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   vc_container_net_status_t net_status = VC_CONTAINER_NET_SUCCESS;
    VC_CONTAINER_STATUS_T status;
+   unsigned int num_ranges, i;
+   uint32_t value;
 
    switch (operation)
    {
    case VC_CONTAINER_CONTROL_IO_SET_READ_BUFFER_SIZE:
-      net_status = vc_container_net_control(p_ctx->module->sock, VC_CONTAINER_NET_CONTROL_SET_READ_BUFFER_SIZE, args);
+      value = va_arg(args, uint32_t);
+
+      /* The read-ahead ring buffers are sized after the read buffer, which drops
+       * the data they currently hold */
+      module->ring_size = value > IO_HTTP_RING_SIZE_MIN ? value : IO_HTTP_RING_SIZE_MIN;
+      for (i = 0; i < IO_HTTP_NUM_STREAMS; i++)
+      {
+         free(module->streams[i].ring);
+         module->streams[i].ring = NULL;
+         module->streams[i].start = module->streams[i].offset;
+      }
+
+      module->socket_buffer_size = value;
+      for (i = 0; i < IO_HTTP_NUM_STREAMS && net_status == VC_CONTAINER_NET_SUCCESS; i++)
+         if (module->streams[i].sock)
+            net_status = io_http_net_control(module->streams[i].sock,
+                                             VC_CONTAINER_NET_CONTROL_SET_READ_BUFFER_SIZE, value);
       break;
    case VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS:
-      net_status = vc_container_net_control(p_ctx->module->sock, VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS, args);
+      value = va_arg(args, uint32_t);
+      module->read_timeout_ms = value;
+      for (i = 0; i < IO_HTTP_NUM_STREAMS && net_status == VC_CONTAINER_NET_SUCCESS; i++)
+         if (module->streams[i].sock)
+            net_status = io_http_net_control(module->streams[i].sock,
+                                             VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS, value);
+      break;
+   case VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES:
+      num_ranges = va_arg(args, unsigned int);
+      io_http_prefetch(p_ctx, num_ranges, va_arg(args, const VC_CONTAINER_IO_RANGE_T *));
       break;
    default:
       net_status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
@@ -708,9 +1128,10 @@ static VC_CONTAINER_STATUS_T io_http_control(struct VC_CONTAINER_IO_T *p_ctx,
  * Send out the data in the comms buffer.
  *
  * @param p_ctx      The reader context.
+ * @param sock       The connection to send the data on.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T io_http_send(VC_CONTAINER_IO_T *p_ctx)
+static VC_CONTAINER_STATUS_T io_http_send(VC_CONTAINER_IO_T *p_ctx, VC_CONTAINER_NET_T *sock)
 {
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
    size_t to_write;
@@ -721,7 +1142,7 @@ static VC_CONTAINER_STATUS_T io_http_send(VC_CONTAINER_IO_T *p_ctx)
 
    while (to_write)
    {
-      written = io_http_write(p_ctx, buffer, to_write);
+      written = io_http_write(p_ctx, sock, buffer, to_write);
       if (p_ctx->status != VC_CONTAINER_SUCCESS)
          break;
 
@@ -736,9 +1157,10 @@ static VC_CONTAINER_STATUS_T io_http_send(VC_CONTAINER_IO_T *p_ctx)
  * Send a HEAD request to the HTTP server.
  *
  * @param p_ctx      The reader context.
+ * @param sock       The connection to send the request on.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T io_http_send_head_request(VC_CONTAINER_IO_T *p_ctx)
+static VC_CONTAINER_STATUS_T io_http_send_head_request(VC_CONTAINER_IO_T *p_ctx, VC_CONTAINER_NET_T *sock)
 {
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
    char *ptr = module->comms_buffer, *end = ptr + sizeof(module->comms_buffer);
@@ -755,20 +1177,20 @@ static VC_CONTAINER_STATUS_T io_http_send_head_request(VC_CONTAINER_IO_T *p_ctx)
       return VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
    }
 
-   return io_http_send(p_ctx);
+   return io_http_send(p_ctx, sock);
 }
 
-static VC_CONTAINER_STATUS_T io_http_head(VC_CONTAINER_IO_T *p_ctx)
+static VC_CONTAINER_STATUS_T io_http_head(VC_CONTAINER_IO_T *p_ctx, IO_HTTP_STREAM_T *stream)
 {
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
    uint64_t content_length;
 
    /* Send HEAD request and get response */
-   status = io_http_send_head_request(p_ctx);
+   status = io_http_send_head_request(p_ctx, stream->sock);
    if (status != VC_CONTAINER_SUCCESS)
       return status;
-   status = io_http_read_response(p_ctx);
+   status = io_http_read_response(p_ctx, stream->sock);
    if (status != VC_CONTAINER_SUCCESS)
       return status;
 
@@ -804,7 +1226,7 @@ static VC_CONTAINER_STATUS_T io_http_head(VC_CONTAINER_IO_T *p_ctx)
    else
    {
       LOG_DEBUG(NULL, "Server does not support persistent connections");
-      io_http_close_socket(module);
+      io_http_close_socket(stream);
    }
 
    module->cur_offset = 0;
@@ -852,6 +1274,8 @@ VC_CONTAINER_STATUS_T vc_container_io_http_open(VC_CONTAINER_IO_T *p_ctx,
       goto error;
    }
    p_ctx->module = module;
+   module->ring_size = IO_HTTP_RING_SIZE_DEFAULT;
+   module->read_timeout_ms = INFINITE_TIMEOUT_MS;
 
    /* header_list will contain pointers into the response_buffer, so take care in re-use */
    module->header_list = vc_containers_list_create(HEADER_LIST_INITIAL_CAPACITY, sizeof(HTTP_HEADER_T),
@@ -869,15 +1293,16 @@ VC_CONTAINER_STATUS_T vc_container_io_http_open(VC_CONTAINER_IO_T *p_ctx,
    if (vc_uri_port(p_ctx->uri_parts) == NULL)
       vc_uri_set_port(p_ctx->uri_parts, IO_HTTP_DEFAULT_PORT);
 
-   status = io_http_open_socket(p_ctx);
+   status = io_http_open_socket(p_ctx, &module->streams[0]);
    if (status != VC_CONTAINER_SUCCESS)
       goto error;
 
    /*
     * Whoo hoo! Our socket is open. Now let's send a HEAD request.
+    * The connection is then kept to stream the start of the file.
     */
 
-   status = io_http_head(p_ctx);
+   status = io_http_head(p_ctx, &module->streams[0]);
    if (status != VC_CONTAINER_SUCCESS)
       goto error;
 
@@ -0,0 +1,489 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_io.h"
+#include "containers/core/containers_uri.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define IO_MMAP_SUPPORTED
+#endif
+
+/* Memory mapped i/o module. This is only used for reading local files opened
+ * explicitly with the mmap:// scheme. It lends memory from the mapping to readers
+ * (see vc_container_io_borrow()) so packet data can be used straight from the page
+ * cache without being copied.
+ * Another process can truncate the file while it is mapped. Touching the pages
+ * past the new end of the file would raise SIGBUS so a handler replaces such pages
+ * with zeros, and the module notices the new size on its next access.
+ * Files can also grow while being read (e.g. recordings in progress). Address space
+ * is reserved after the mapping so it can be extended in place, which keeps the
+ * memory already lent valid. Data past the reserved area is read with pread(). */
+
+/** Size of the windows of the file the kernel is asked to read ahead */
+#define IO_MMAP_WINDOW_SIZE (4*1024*1024)
+/** Files smaller than this are read ahead in one go */
+#define IO_MMAP_SMALL_FILE_SIZE (2*IO_MMAP_WINDOW_SIZE)
+/** Maximum number of files mapped at the same time */
+#define IO_MMAP_REGIONS_MAX 64
+/** Address space reserved after the end of the file for it to grow into */
+#define IO_MMAP_RESERVE_SIZE (sizeof(void *) > 4 ? (size_t)1 << 34 : (size_t)64 << 20)
+
+VC_CONTAINER_STATUS_T vc_container_io_mmap_open( VC_CONTAINER_IO_T *, const char *,
+   VC_CONTAINER_IO_MODE_T );
+
+#ifdef IO_MMAP_SUPPORTED
+typedef struct VC_CONTAINER_IO_MODULE_T
+{
+   int fd;             /**< Kept open to follow changes to the size of the file */
+   uint8_t *data;      /**< Start of the mapping */
+   size_t mapped;      /**< Size of the part of the mapping backed by the file */
+   size_t reserved;    /**< Size of the address space reserved for the mapping */
+   size_t size;        /**< Size of the file when last checked */
+   size_t position;    /**< Current position in the mapping */
+   size_t advised_end; /**< End of the area the kernel has been asked to read ahead */
+   unsigned int region; /**< Index of the mapping in the regions watched for SIGBUS */
+
+} VC_CONTAINER_IO_MODULE_T;
+
+/** Mappings watched by the SIGBUS handler. Slots are claimed and released with
+ * atomic operations as the handler can't take any lock. */
+static struct
+{
+   uint8_t *start;
+   size_t size;
+   int faulted;        /**< A page past the end of the file has been replaced */
+} io_mmap_regions[IO_MMAP_REGIONS_MAX];
+
+static pthread_once_t io_mmap_once = PTHREAD_ONCE_INIT;
+static struct sigaction io_mmap_sigbus_previous;
+static size_t io_mmap_page_size;
+
+/*****************************************************************************/
+static void io_mmap_sigbus(int sig, siginfo_t *info, void *context)
+{
+   uint8_t *addr = (uint8_t *)info->si_addr;
+   unsigned int i;
+
+   for(i = 0; i < IO_MMAP_REGIONS_MAX; i++)
+   {
+      uint8_t *start = __atomic_load_n(&io_mmap_regions[i].start, __ATOMIC_ACQUIRE);
+      size_t size = __atomic_load_n(&io_mmap_regions[i].size, __ATOMIC_ACQUIRE);
+      void *page;
+
+      if(!start || addr < start || addr >= start + size) continue;
+
+      /* The file has shrunk. Let the access complete by reading zeros. */
+      page = (void *)((uintptr_t)addr & ~(uintptr_t)(io_mmap_page_size - 1));
+      if(mmap(page, io_mmap_page_size, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED,
+              -1, 0) == MAP_FAILED)
+         break;
+      __atomic_store_n(&io_mmap_regions[i].faulted, 1, __ATOMIC_RELEASE);
+      return;
+   }
+
+   /* Not one of our mappings */
+   if(io_mmap_sigbus_previous.sa_flags & SA_SIGINFO)
+      io_mmap_sigbus_previous.sa_sigaction(sig, info, context);
+   else if(io_mmap_sigbus_previous.sa_handler != SIG_DFL &&
+           io_mmap_sigbus_previous.sa_handler != SIG_IGN)
+      io_mmap_sigbus_previous.sa_handler(sig);
+   else
+      signal(SIGBUS, SIG_DFL); /* The fault will happen again with the default action */
+}
+
+static void io_mmap_init_once(void)
+{
+   struct sigaction action;
+
+   io_mmap_page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+   memset(&action, 0, sizeof(action));
+   action.sa_sigaction = io_mmap_sigbus;
+   action.sa_flags = SA_SIGINFO;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGBUS, &action, &io_mmap_sigbus_previous);
+}
+
+/** Have the SIGBUS handler watch a mapping. Returns false if too many files are mapped. */
+static bool io_mmap_region_add( VC_CONTAINER_IO_MODULE_T *module )
+{
+   unsigned int i;
+
+   for(i = 0; i < IO_MMAP_REGIONS_MAX; i++)
+   {
+      uint8_t *expected = 0;
+      if(!__atomic_compare_exchange_n(&io_mmap_regions[i].start, &expected, module->data, 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+         continue;
+      __atomic_store_n(&io_mmap_regions[i].faulted, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&io_mmap_regions[i].size, module->mapped, __ATOMIC_RELEASE);
+      module->region = i;
+      return true;
+   }
+   return false;
+}
+
+static void io_mmap_region_remove( VC_CONTAINER_IO_MODULE_T *module )
+{
+   __atomic_store_n(&io_mmap_regions[module->region].size, 0, __ATOMIC_RELEASE);
+   __atomic_store_n(&io_mmap_regions[module->region].start, 0, __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************/
+/** Extend the mapping over the data appended to the file, as far as the reserved
+ * address space allows. Pages which were replaced with zeros when the file shrunk
+ * are mapped to the file again. */
+static void io_mmap_grow( VC_CONTAINER_IO_MODULE_T *module, size_t size )
+{
+   size_t page_mask = io_mmap_page_size - 1;
+   size_t start = module->size & ~page_mask, end = (size + page_mask) & ~page_mask;
+
+   if(end > module->reserved) end = module->reserved;
+   if(end > start && mmap(module->data + start, end - start, PROT_READ,
+                          MAP_PRIVATE|MAP_FIXED, module->fd, (off_t)start) == MAP_FAILED)
+      end = start; /* The rest will be read with pread() */
+   if(end > module->mapped)
+   {
+      module->mapped = end;
+      __atomic_store_n(&io_mmap_regions[module->region].size, end, __ATOMIC_RELEASE);
+   }
+   module->size = size;
+}
+
+/** Find out about changes to the size of the file. Pages past the end of a file
+ * which has shrunk are replaced with zeros so they can't raise SIGBUS anymore. */
+static void io_mmap_update_size( VC_CONTAINER_IO_T *p_ctx )
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   size_t page_mask = io_mmap_page_size - 1, end;
+   struct stat info;
+
+   __atomic_store_n(&io_mmap_regions[module->region].faulted, 0, __ATOMIC_RELAXED);
+   if(fstat(module->fd, &info) || (uint64_t)info.st_size == module->size)
+      return;
+
+   if((uint64_t)info.st_size > module->size)
+   {
+      io_mmap_grow(module, (uint64_t)info.st_size > (SIZE_MAX >> 1) ?
+                   (SIZE_MAX >> 1) : (size_t)info.st_size);
+      p_ctx->size = module->size;
+      return;
+   }
+
+   module->size = (size_t)info.st_size;
+   end = (module->size + page_mask) & ~page_mask;
+   if(end < module->mapped)
+      mmap(module->data + end, module->mapped - end, PROT_READ,
+           MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0);
+   if(module->advised_end > module->size) module->advised_end = module->size;
+   p_ctx->size = module->size;
+}
+
+/** Check whether the SIGBUS handler has caught an access past the end of the file */
+static bool io_mmap_faulted( VC_CONTAINER_IO_MODULE_T *module )
+{
+   return __atomic_load_n(&io_mmap_regions[module->region].faulted, __ATOMIC_ACQUIRE);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_mmap_close( VC_CONTAINER_IO_T *p_ctx )
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   io_mmap_region_remove(module);
+   munmap(module->data, module->reserved);
+   close(module->fd);
+   free(module);
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Make sure the kernel is reading ahead of the given area of the file */
+static void io_mmap_read_ahead( VC_CONTAINER_IO_MODULE_T *module, size_t offset, size_t size )
+{
+   size_t page_mask = io_mmap_page_size - 1, end;
+
+   if(module->size <= IO_MMAP_SMALL_FILE_SIZE) return; /* Already all read ahead */
+
+   /* Restart reading ahead from the current position if we've jumped away from
+    * the area being read ahead, for instance after a seek */
+   if(offset > module->advised_end || offset + 2 * IO_MMAP_WINDOW_SIZE < module->advised_end)
+      module->advised_end = offset & ~page_mask;
+
+   /* Keep at least one window ahead of the reads */
+   if(offset + size + IO_MMAP_WINDOW_SIZE <= module->advised_end) return;
+
+   end = (offset + size + 2 * IO_MMAP_WINDOW_SIZE) & ~page_mask;
+   if(end > module->size) end = module->size;
+   if(end > module->mapped) end = module->mapped;
+   if(end <= module->advised_end) return;
+
+   madvise(module->data + module->advised_end, end - module->advised_end, MADV_WILLNEED);
+   module->advised_end = end;
+}
+
+/*****************************************************************************/
+static size_t io_mmap_read(VC_CONTAINER_IO_T *p_ctx, void *buffer, size_t size)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   size_t requested = size, copied = 0;
+   ssize_t ret;
+
+   /* Reaching the end of the file is a good time to check whether it has grown */
+   if(io_mmap_faulted(module) || module->position > module->size ||
+      size > module->size - module->position)
+      io_mmap_update_size(p_ctx);
+
+   if(module->position > module->size)
+      size = 0;
+   else if(size > module->size - module->position)
+      size = module->size - module->position;
+
+   io_mmap_read_ahead(module, module->position, size);
+   if(module->position < module->mapped)
+      copied = MIN(size, module->mapped - module->position);
+   memcpy(buffer, module->data + module->position, copied);
+
+   /* What lies past the reserved address space has to be read */
+   if(copied < size)
+   {
+      ret = pread(module->fd, (uint8_t *)buffer + copied, size - copied,
+                  (off_t)(module->position + copied));
+      size = copied + (ret > 0 ? (size_t)ret : 0);
+   }
+
+   /* The file has been truncated while we were copying. What was copied past
+    * the new end of the file is only zeros. */
+   if(io_mmap_faulted(module))
+   {
+      io_mmap_update_size(p_ctx);
+      if(module->position > module->size)
+         size = 0;
+      else if(size > module->size - module->position)
+         size = module->size - module->position;
+   }
+
+   if(size < requested) p_ctx->status = VC_CONTAINER_ERROR_EOS;
+   module->position += size;
+   return size;
+}
+
+/*****************************************************************************/
+static const uint8_t *io_mmap_borrow(VC_CONTAINER_IO_T *p_ctx, int64_t offset, size_t size)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+
+   if(io_mmap_faulted(module) || offset < 0 || (uint64_t)offset > module->size ||
+      size > module->size - (size_t)offset)
+      io_mmap_update_size(p_ctx);
+
+   /* Only what is mapped can be lent */
+   if(offset < 0 || (uint64_t)offset > module->size || size > module->size - (size_t)offset ||
+      (size_t)offset + size > module->mapped)
+      return NULL;
+
+   io_mmap_read_ahead(module, (size_t)offset, size);
+   return module->data + offset;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_mmap_seek(VC_CONTAINER_IO_T *p_ctx, int64_t offset)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+
+   /* Seeking past the end fails unless the file has grown in the meantime, which
+    * tells readers that the data they are looking for isn't there yet */
+   if(io_mmap_faulted(module) || (offset >= 0 && (uint64_t)offset > module->size))
+      io_mmap_update_size(p_ctx);
+
+   if(offset < 0 || (uint64_t)offset > module->size)
+   {
+      p_ctx->status = VC_CONTAINER_ERROR_EOS;
+      return p_ctx->status;
+   }
+
+   module->position = (size_t)offset;
+   p_ctx->status = VC_CONTAINER_SUCCESS;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_mmap_control(VC_CONTAINER_IO_T *p_ctx,
+   VC_CONTAINER_CONTROL_T operation, va_list args)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   size_t page_mask = io_mmap_page_size - 1;
+   const VC_CONTAINER_IO_RANGE_T *ranges;
+   unsigned int i, num_ranges;
+
+   if(operation != VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES)
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+
+   /* Have the kernel page in the hinted areas which aren't already being read ahead */
+   num_ranges = va_arg(args, unsigned int);
+   ranges = va_arg(args, const VC_CONTAINER_IO_RANGE_T *);
+   for(i = 0; ranges && i < num_ranges; i++)
+   {
+      size_t start, end;
+
+      if(ranges[i].offset < 0 || ranges[i].size <= 0 || (uint64_t)ranges[i].offset >= module->size)
+         continue;
+      start = (size_t)ranges[i].offset & ~page_mask;
+      end = (uint64_t)ranges[i].size < module->size - (size_t)ranges[i].offset ?
+         (size_t)(ranges[i].offset + ranges[i].size) : module->size;
+      if(end > module->mapped) end = module->mapped;
+      if(start >= end) continue;
+      if(module->size <= IO_MMAP_SMALL_FILE_SIZE ||
+         (start >= module->position && end <= module->advised_end))
+         continue;
+
+      madvise(module->data + start, end - start, MADV_WILLNEED);
+   }
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T vc_container_io_mmap_open( VC_CONTAINER_IO_T *p_ctx,
+   const char *unused, VC_CONTAINER_IO_MODE_T mode )
+{
+   VC_CONTAINER_IO_MODULE_T *module = 0;
+   const char *scheme = vc_uri_scheme(p_ctx->uri_parts);
+   const char *path = vc_uri_path(p_ctx->uri_parts);
+   struct stat info;
+   size_t page_mask;
+   void *data;
+   int fd;
+   VC_CONTAINER_PARAM_UNUSED(unused);
+
+   /* Only local files can be mapped, and the mapping is read-only */
+   if(!scheme || strcasecmp(scheme, "mmap"))
+      return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+   if(vc_uri_host(p_ctx->uri_parts) && *vc_uri_host(p_ctx->uri_parts))
+      return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+   if(mode != VC_CONTAINER_IO_MODE_READ)
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   if(!path) path = p_ctx->uri;
+
+   pthread_once(&io_mmap_once, io_mmap_init_once);
+   page_mask = io_mmap_page_size - 1;
+
+   fd = open(path, O_RDONLY);
+   if(fd < 0) return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+
+   /* Empty files, devices, pipes and files too big for the address space are left
+    * to the other i/o modules */
+   if(fstat(fd, &info) || !S_ISREG(info.st_mode) || !info.st_size ||
+      (uint64_t)info.st_size > (SIZE_MAX >> 1))
+   {
+      close(fd);
+      return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+   }
+
+   module = malloc( sizeof(*module) );
+   if(!module)
+   {
+      close(fd);
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   }
+   memset(module, 0, sizeof(*module));
+   module->fd = fd;
+   module->size = (size_t)info.st_size;
+   module->mapped = (module->size + page_mask) & ~page_mask;
+   module->reserved = module->mapped + IO_MMAP_RESERVE_SIZE;
+
+   /* Reserve address space for the file to grow into, and map the file at its start.
+    * Without the reservation, growth is only followed with pread(). */
+   data = mmap(NULL, module->reserved, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+   if(data != MAP_FAILED &&
+      mmap(data, module->mapped, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED)
+   {
+      munmap(data, module->reserved);
+      data = MAP_FAILED;
+   }
+   if(data == MAP_FAILED)
+   {
+      module->reserved = module->mapped;
+      data = mmap(NULL, module->mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+   }
+   if(data == MAP_FAILED) goto error;
+   module->data = data;
+   if(!io_mmap_region_add(module))
+   {
+      munmap(data, module->reserved);
+      goto error;
+   }
+
+   /* Small files are read ahead in one go. Big files are read sequentially
+    * by windows, with the pages behind the reads being dropped first. */
+   if(module->size <= IO_MMAP_SMALL_FILE_SIZE)
+      madvise(module->data, module->size, MADV_WILLNEED);
+   else
+      madvise(module->data, module->size, MADV_SEQUENTIAL);
+
+   p_ctx->module = module;
+   p_ctx->pf_close = io_mmap_close;
+   p_ctx->pf_read = io_mmap_read;
+   p_ctx->pf_seek = io_mmap_seek;
+   p_ctx->pf_borrow = io_mmap_borrow;
+   p_ctx->pf_control = io_mmap_control;
+   p_ctx->size = info.st_size;
+
+   /* Reads are memory copies from the mapping so there is no point caching them */
+   p_ctx->capabilities = 0;
+   return VC_CONTAINER_SUCCESS;
+
+ error:
+   close(fd);
+   free(module);
+   return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+}
+
+#else /* IO_MMAP_SUPPORTED */
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T vc_container_io_mmap_open( VC_CONTAINER_IO_T *p_ctx,
+   const char *unused, VC_CONTAINER_IO_MODE_T mode )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_ctx);
+   VC_CONTAINER_PARAM_UNUSED(unused);
+   VC_CONTAINER_PARAM_UNUSED(mode);
+   return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+}
+
+#endif /* IO_MMAP_SUPPORTED */
@@ -67,6 +67,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 Defines and constants.
 ******************************************************************************/
 
+/** Maximum number of datagrams read by one VC_CONTAINER_CONTROL_IO_READ_DATAGRAMS */
+#define DATAGRAM_BATCH_MAX             64
+
 /******************************************************************************
 Type definitions
 ******************************************************************************/
@@ -87,7 +90,9 @@ static struct
    bool is_udp;
 } recognised_schemes[] = {
    { "rtp:", true },
+   { "udp:", true },
    { "rtsp:", false },
+   { "rtspt:", false },
 };
 
 /******************************************************************************
@@ -268,6 +273,39 @@ static size_t io_net_write(VC_CONTAINER_IO_T *p_ctx, const void *buffer, size_t
    return ret;
 }
 
+/*****************************************************************************/
+static vc_container_net_status_t io_net_read_datagrams(VC_CONTAINER_IO_T *p_ctx, va_list args)
+{
+   VC_CONTAINER_IO_DATAGRAM_T *datagrams = va_arg(args, VC_CONTAINER_IO_DATAGRAM_T *);
+   unsigned int count = va_arg(args, unsigned int);
+   unsigned int *p_received = va_arg(args, unsigned int *);
+   VC_CONTAINER_NET_DATAGRAM_T buffers[DATAGRAM_BATCH_MAX];
+   size_t ii, received;
+
+   if (count > DATAGRAM_BATCH_MAX)
+      count = DATAGRAM_BATCH_MAX;
+
+   for (ii = 0; ii < count; ii++)
+   {
+      buffers[ii].buffer = datagrams[ii].data;
+      buffers[ii].size = datagrams[ii].size;
+   }
+
+   received = vc_container_net_read_datagrams(p_ctx->module->sock, buffers, count);
+
+   for (ii = 0; ii < received; ii++)
+   {
+      datagrams[ii].size = (uint32_t)buffers[ii].size;
+#ifdef IO_NET_CAPTURE_PACKETS
+      io_net_capture_write_packet(p_ctx->module->read_capture_file, (const char *)datagrams[ii].data,
+            datagrams[ii].size);
+#endif
+   }
+   *p_received = (unsigned int)received;
+
+   return vc_container_net_status(p_ctx->module->sock);
+}
+
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T io_net_control(struct VC_CONTAINER_IO_T *p_ctx, 
       VC_CONTAINER_CONTROL_T operation,
@@ -284,6 +322,9 @@ static VC_CONTAINER_STATUS_T io_net_control(struct VC_CONTAINER_IO_T *p_ctx,
    case VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS:
       net_status = vc_container_net_control(p_ctx->module->sock, VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS, args);
       break;
+   case VC_CONTAINER_CONTROL_IO_READ_DATAGRAMS:
+      net_status = io_net_read_datagrams(p_ctx, args);
+      break;
    default:
       net_status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
    }
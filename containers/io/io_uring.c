@@ -0,0 +1,774 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_io.h"
+#include "containers/core/containers_uri.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(O_DIRECT)
+#define IO_URING_SUPPORTED
+#endif
+#endif
+
+/* io_uring i/o module. This is only used for local files on Linux.
+ * Reads and writes go through a set of aligned buffers. The buffers are
+ * submitted to the kernel in batches and their completions are polled from
+ * the completion ring. Several areas of the file can therefore be in flight
+ * at once without a helper thread.
+ * Files can be opened explicitly with the uring:// scheme, or with the
+ * uring+direct:// scheme to bypass the page cache with O_DIRECT
+ * (e.g. uring+direct:///media/usb/rec.mp4). It is only used when asked for
+ * explicitly, whether reading or writing, so the cached io_file and its async
+ * writer remain the default for local files. The module steps aside when the
+ * kernel doesn't support io_uring, so io_file is used instead. */
+
+/** Size of the buffers. Needs to be a power of 2. */
+#define IO_URING_BUFFER_SIZE (128*1024)
+#define IO_URING_NUM_BUFFERS 8
+/** Size of the submission queue. Big enough for all the buffers to be in flight. */
+#define IO_URING_ENTRIES (2*IO_URING_NUM_BUFFERS)
+/** Alignment of O_DIRECT transfers. This is a multiple of the alignment of the
+ * i/o cache and covers the logical block size of common devices. */
+#define IO_URING_ALIGNMENT 4096
+/** Number of write buffers gathered before they are submitted together */
+#define IO_URING_SUBMIT_BATCH 2
+/** Number of buffers read ahead of the read position */
+#define IO_URING_READ_AHEAD 4
+#define IO_URING_MAX_RANGES 16
+
+VC_CONTAINER_STATUS_T vc_container_io_uring_open( VC_CONTAINER_IO_T *, const char *,
+   VC_CONTAINER_IO_MODE_T );
+
+#ifdef IO_URING_SUPPORTED
+typedef enum
+{
+   IO_URING_BUFFER_FREE = 0,
+   IO_URING_BUFFER_FILLING, /**< Write buffer being filled */
+   IO_URING_BUFFER_BUSY,    /**< Read or write in flight */
+   IO_URING_BUFFER_READY    /**< Read buffer holding valid data */
+
+} IO_URING_BUFFER_STATE_T;
+
+typedef struct IO_URING_BUFFER_T
+{
+   IO_URING_BUFFER_STATE_T state;
+   int64_t offset;  /**< Offset of the buffer in the file */
+   size_t size;     /**< Size of the valid data */
+   size_t capacity; /**< Size of the data a write buffer can gather */
+   int result;      /**< Result of the last transfer */
+   uint32_t used;   /**< When a read buffer was last used (0 if it never was) */
+   uint8_t *mem;
+
+} IO_URING_BUFFER_T;
+
+typedef struct VC_CONTAINER_IO_MODULE_T
+{
+   int ring;        /**< io_uring instance */
+   int fd;          /**< File used for aligned transfers (opened with O_DIRECT if requested) */
+   int buffered_fd; /**< File used for unaligned transfers (same as fd without O_DIRECT) */
+   bool writing;
+   bool error;      /**< A write failed or transfers couldn't be submitted */
+
+   unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+   unsigned int sq_entries, sq_local_tail, to_submit;
+   struct io_uring_sqe *sqes;
+   unsigned int *cq_head, *cq_tail, *cq_mask;
+   struct io_uring_cqe *cqes;
+   void *sq_ring, *cq_ring;
+   size_t sq_ring_size, cq_ring_size, sqes_size;
+
+   unsigned int in_flight;
+   int64_t position;
+   int64_t size;           /**< Size of the file */
+   int64_t last_write_end; /**< End of the last write queued */
+   uint32_t use_count;
+   IO_URING_BUFFER_T *filling;
+
+   unsigned int num_ranges;
+   VC_CONTAINER_IO_RANGE_T ranges[IO_URING_MAX_RANGES];
+
+   IO_URING_BUFFER_T buffers[IO_URING_NUM_BUFFERS];
+   uint8_t *mem;
+
+} VC_CONTAINER_IO_MODULE_T;
+
+/*****************************************************************************/
+static int io_uring_enter( VC_CONTAINER_IO_MODULE_T *module, unsigned int to_submit,
+   unsigned int min_complete, unsigned int flags )
+{
+   return (int)syscall(__NR_io_uring_enter, module->ring, to_submit, min_complete, flags, NULL, 0);
+}
+
+/** Process the completions posted by the kernel */
+static void io_uring_reap( VC_CONTAINER_IO_MODULE_T *module )
+{
+   unsigned int head = *module->cq_head;
+   unsigned int tail = __atomic_load_n(module->cq_tail, __ATOMIC_ACQUIRE);
+
+   for(; head != tail; head++)
+   {
+      struct io_uring_cqe *cqe = &module->cqes[head & *module->cq_mask];
+      IO_URING_BUFFER_T *buffer = (IO_URING_BUFFER_T *)(uintptr_t)cqe->user_data;
+
+      buffer->result = cqe->res;
+      module->in_flight--;
+      if(module->writing)
+      {
+         if(cqe->res != (int)buffer->size) module->error = true;
+         buffer->state = IO_URING_BUFFER_FREE;
+      }
+      else
+      {
+         buffer->size = cqe->res > 0 ? (size_t)cqe->res : 0;
+         buffer->state = IO_URING_BUFFER_READY;
+      }
+   }
+
+   __atomic_store_n(module->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/** Take back the transfers the kernel didn't take when io_uring_enter failed.
+ * Their buffers are freed with the error as their result. */
+static void io_uring_unqueue( VC_CONTAINER_IO_MODULE_T *module, int result )
+{
+   unsigned int head = __atomic_load_n(module->sq_head, __ATOMIC_ACQUIRE);
+
+   for(; module->sq_local_tail != head; module->sq_local_tail--)
+   {
+      struct io_uring_sqe *sqe = &module->sqes[(module->sq_local_tail - 1) & *module->sq_mask];
+      IO_URING_BUFFER_T *buffer = (IO_URING_BUFFER_T *)(uintptr_t)sqe->user_data;
+
+      buffer->result = result;
+      buffer->state = IO_URING_BUFFER_FREE;
+      module->in_flight--;
+   }
+
+   __atomic_store_n(module->sq_tail, module->sq_local_tail, __ATOMIC_RELEASE);
+   module->to_submit = 0;
+   module->error = true;
+}
+
+/** Hand the queued transfers over to the kernel, waiting for at least one
+ * completion if asked to. Returns false if the kernel refused them. */
+static bool io_uring_submit_wait( VC_CONTAINER_IO_MODULE_T *module, bool wait )
+{
+   int ret;
+
+   if(!module->to_submit && !wait) return true;
+
+   __atomic_store_n(module->sq_tail, module->sq_local_tail, __ATOMIC_RELEASE);
+   ret = io_uring_enter(module, module->to_submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+   if(ret >= 0)
+   {
+      module->to_submit -= ret;
+      return true;
+   }
+   if(errno == EINTR) return true;
+
+   io_uring_unqueue(module, -errno);
+   return false;
+}
+
+/** Hand the queued transfers over to the kernel in one go */
+static bool io_uring_submit( VC_CONTAINER_IO_MODULE_T *module )
+{
+   return io_uring_submit_wait(module, false);
+}
+
+/** Wait until the given buffer isn't busy anymore, or until nothing is in flight
+ * if no buffer is given. Gives up if io_uring_enter fails. */
+static void io_uring_wait( VC_CONTAINER_IO_MODULE_T *module, IO_URING_BUFFER_T *buffer )
+{
+   while(1)
+   {
+      bool submitted = io_uring_submit(module);
+
+      io_uring_reap(module);
+      if(buffer ? buffer->state != IO_URING_BUFFER_BUSY : !module->in_flight)
+         break;
+
+      if(!submitted || !io_uring_submit_wait(module, true))
+         break;
+   }
+}
+
+/** Wait until at least one more transfer has completed. Returns false if
+ * io_uring_enter failed. */
+static bool io_uring_wait_any( VC_CONTAINER_IO_MODULE_T *module )
+{
+   unsigned int in_flight = module->in_flight;
+
+   while(in_flight && module->in_flight == in_flight)
+   {
+      bool submitted = io_uring_submit_wait(module, true);
+
+      io_uring_reap(module);
+      if(!submitted) return false;
+   }
+   return true;
+}
+
+/** Queue a transfer of the given buffer */
+static void io_uring_queue( VC_CONTAINER_IO_MODULE_T *module, IO_URING_BUFFER_T *buffer,
+   uint8_t opcode, int fd, size_t size, uint8_t flags )
+{
+   unsigned int index = module->sq_local_tail & *module->sq_mask;
+   struct io_uring_sqe *sqe = &module->sqes[index];
+
+   /* There are more entries than buffers so the queue can't overflow */
+   vc_container_assert(module->sq_local_tail - __atomic_load_n(module->sq_head, __ATOMIC_ACQUIRE) <
+                       module->sq_entries);
+
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->opcode = opcode;
+   sqe->flags = flags;
+   sqe->fd = fd;
+   sqe->addr = (uintptr_t)buffer->mem;
+   sqe->len = size;
+   sqe->off = buffer->offset;
+   sqe->user_data = (uintptr_t)buffer;
+   module->sq_array[index] = index;
+   module->sq_local_tail++;
+   module->to_submit++;
+   module->in_flight++;
+   buffer->state = IO_URING_BUFFER_BUSY;
+}
+
+/*****************************************************************************/
+/** Queue the write of a write buffer */
+static void io_uring_write_buffer( VC_CONTAINER_IO_MODULE_T *module, IO_URING_BUFFER_T *buffer )
+{
+   bool aligned = !(((uint64_t)buffer->offset | buffer->size) & (IO_URING_ALIGNMENT-1));
+   uint8_t flags = 0;
+
+   /* Writes which don't follow on from the previous one can overlap with writes
+    * still in flight (e.g. a header being patched) so they need to be ordered */
+   if(buffer->offset != module->last_write_end) flags |= IOSQE_IO_DRAIN;
+   module->last_write_end = buffer->offset + buffer->size;
+
+   io_uring_queue(module, buffer, IORING_OP_WRITE, aligned ? module->fd : module->buffered_fd,
+                  buffer->size, flags);
+   if(module->to_submit >= IO_URING_SUBMIT_BATCH)
+      io_uring_submit(module);
+}
+
+/** Queue the write of the buffer being filled, if any */
+static void io_uring_write_filling( VC_CONTAINER_IO_MODULE_T *module )
+{
+   if(!module->filling) return;
+   io_uring_write_buffer(module, module->filling);
+   module->filling = 0;
+}
+
+/*****************************************************************************/
+static IO_URING_BUFFER_T *io_uring_find( VC_CONTAINER_IO_MODULE_T *module, int64_t offset )
+{
+   unsigned int i;
+
+   for(i = 0; i < IO_URING_NUM_BUFFERS; i++)
+      if(module->buffers[i].state != IO_URING_BUFFER_FREE && module->buffers[i].offset == offset)
+         return &module->buffers[i];
+   return 0;
+}
+
+/** Get a buffer to read into. Buffers which have been read ahead but not used
+ * yet are only recycled for urgent reads. */
+static IO_URING_BUFFER_T *io_uring_get_read_buffer( VC_CONTAINER_IO_MODULE_T *module, bool urgent )
+{
+   int64_t current = module->position & ~(int64_t)(IO_URING_BUFFER_SIZE-1);
+   IO_URING_BUFFER_T *buffer = 0;
+   unsigned int i;
+
+   for(i = 0; i < IO_URING_NUM_BUFFERS; i++)
+   {
+      IO_URING_BUFFER_T *candidate = &module->buffers[i];
+
+      if(candidate->state == IO_URING_BUFFER_FREE) return candidate;
+      if(candidate->state != IO_URING_BUFFER_READY || candidate->offset == current)
+         continue;
+      if(!candidate->used && !urgent)
+         continue;
+
+      /* Recycle the least recently used buffer, preferring the ones which were used */
+      if(!buffer || (candidate->used && (!buffer->used || candidate->used < buffer->used)))
+         buffer = candidate;
+   }
+
+   return buffer;
+}
+
+/** Queue the read of the buffer starting at the given offset */
+static IO_URING_BUFFER_T *io_uring_read_buffer( VC_CONTAINER_IO_MODULE_T *module, int64_t offset,
+   bool urgent )
+{
+   IO_URING_BUFFER_T *buffer = io_uring_get_read_buffer(module, urgent);
+
+   /* Urgent reads wait for a buffer to come back if they're all in flight */
+   while(!buffer && urgent && module->in_flight)
+   {
+      if(!io_uring_wait_any(module)) break;
+      buffer = io_uring_get_read_buffer(module, urgent);
+   }
+   if(!buffer) return 0;
+
+   buffer->offset = offset;
+   buffer->size = 0;
+   buffer->used = 0;
+   io_uring_queue(module, buffer, IORING_OP_READ, module->fd, IO_URING_BUFFER_SIZE, 0);
+   return buffer;
+}
+
+/** Queue reads ahead of the read position and at the hinted ranges */
+static void io_uring_read_ahead( VC_CONTAINER_IO_MODULE_T *module )
+{
+   int64_t offset = module->position & ~(int64_t)(IO_URING_BUFFER_SIZE-1);
+   unsigned int i;
+
+   for(i = 0; i < IO_URING_READ_AHEAD && offset < module->size; i++, offset += IO_URING_BUFFER_SIZE)
+   {
+      if(io_uring_find(module, offset)) continue;
+      if(!io_uring_read_buffer(module, offset, false)) break;
+   }
+
+   for(i = 0; i < module->num_ranges; i++)
+   {
+      VC_CONTAINER_IO_RANGE_T *range = &module->ranges[i];
+
+      /* Ranges are read in order so the ones behind the read position are done with */
+      if(range->offset + range->size <= module->position)
+      {
+         *range = module->ranges[--module->num_ranges];
+         i--;
+         continue;
+      }
+
+      offset = range->offset & ~(int64_t)(IO_URING_BUFFER_SIZE-1);
+      if(offset >= module->size || io_uring_find(module, offset)) continue;
+      if(!io_uring_read_buffer(module, offset, false)) break;
+   }
+
+   io_uring_submit(module);
+}
+
+/** Check whether data has been appended to the file since a buffer cut short by the
+ * end of the file was read. The buffer is dropped so it gets read again if so. */
+static bool io_uring_refresh( VC_CONTAINER_IO_T *p_ctx, IO_URING_BUFFER_T *buffer )
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   struct stat info;
+
+   if(buffer->size == IO_URING_BUFFER_SIZE || fstat(module->fd, &info) ||
+      info.st_size <= buffer->offset + (int64_t)buffer->size)
+      return false;
+
+   module->size = p_ctx->size = info.st_size;
+   buffer->state = IO_URING_BUFFER_FREE;
+   return true;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_uring_close( VC_CONTAINER_IO_T *p_ctx )
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   VC_CONTAINER_STATUS_T status;
+
+   /* Everything needs to have landed before the memory can go */
+   io_uring_write_filling(module);
+   io_uring_wait(module, 0);
+
+   if(module->buffered_fd != module->fd && close(module->buffered_fd) && module->writing)
+      module->error = true;
+   if(close(module->fd) && module->writing)
+      module->error = true;
+   status = module->error ? VC_CONTAINER_ERROR_FAILED : VC_CONTAINER_SUCCESS;
+   munmap(module->sqes, module->sqes_size);
+   if(module->cq_ring != module->sq_ring) munmap(module->cq_ring, module->cq_ring_size);
+   munmap(module->sq_ring, module->sq_ring_size);
+   close(module->ring);
+   free(module->mem);
+   free(module);
+   return status;
+}
+
+/*****************************************************************************/
+static size_t io_uring_read(VC_CONTAINER_IO_T *p_ctx, void *data, size_t size)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   bool refreshed = false;
+   size_t read = 0;
+
+   if(module->writing)
+   {
+      ssize_t ret;
+
+      /* Reading back what's being written needs all the writes to have landed */
+      io_uring_write_filling(module);
+      io_uring_wait(module, 0);
+
+      ret = pread(module->buffered_fd, data, size, module->position);
+      if(ret < 0) ret = 0;
+      if((size_t)ret != size)
+         p_ctx->status = ret >= 0 ? VC_CONTAINER_ERROR_EOS : VC_CONTAINER_ERROR_FAILED;
+      module->position += ret;
+      return ret;
+   }
+
+   while(size)
+   {
+      int64_t offset = module->position & ~(int64_t)(IO_URING_BUFFER_SIZE-1);
+      size_t skip = (size_t)(module->position - offset), bytes;
+      IO_URING_BUFFER_T *buffer = io_uring_find(module, offset);
+
+      if(!buffer) buffer = io_uring_read_buffer(module, offset, true);
+      if(!buffer) { p_ctx->status = VC_CONTAINER_ERROR_FAILED; break; }
+      if(buffer->state == IO_URING_BUFFER_BUSY)
+      {
+         /* Get the reads ahead going while we wait */
+         io_uring_read_ahead(module);
+         io_uring_wait(module, buffer);
+         if(buffer->state == IO_URING_BUFFER_BUSY)
+         {
+            p_ctx->status = VC_CONTAINER_ERROR_FAILED;
+            break;
+         }
+      }
+
+      if(buffer->result < 0)
+      {
+         buffer->state = IO_URING_BUFFER_FREE;
+         p_ctx->status = VC_CONTAINER_ERROR_FAILED;
+         break;
+      }
+
+      buffer->used = ++module->use_count;
+      if(skip >= buffer->size)
+      {
+         /* The file might have grown since the buffer was read */
+         if(!refreshed && io_uring_refresh(p_ctx, buffer))
+         {
+            refreshed = true;
+            continue;
+         }
+         p_ctx->status = VC_CONTAINER_ERROR_EOS;
+         break;
+      }
+
+      bytes = MIN(size, buffer->size - skip);
+      memcpy((uint8_t *)data + read, buffer->mem + skip, bytes);
+      module->position += bytes;
+      read += bytes;
+      size -= bytes;
+   }
+
+   io_uring_reap(module);
+   io_uring_read_ahead(module);
+   return read;
+}
+
+/*****************************************************************************/
+static size_t io_uring_write(VC_CONTAINER_IO_T *p_ctx, const void *data, size_t size)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   size_t written = 0;
+
+   if(module->error)
+   {
+      p_ctx->status = VC_CONTAINER_ERROR_FAILED;
+      return 0;
+   }
+
+   while(size)
+   {
+      IO_URING_BUFFER_T *buffer = module->filling;
+      size_t bytes;
+
+      if(module->error)
+      {
+         p_ctx->status = VC_CONTAINER_ERROR_FAILED;
+         break;
+      }
+
+      /* The data needs to follow on from what's already in the buffer */
+      if(buffer && module->position != buffer->offset + (int64_t)buffer->size)
+      {
+         io_uring_write_filling(module);
+         buffer = 0;
+      }
+
+      if(!buffer)
+      {
+         unsigned int i;
+
+         for(i = 0; i < IO_URING_NUM_BUFFERS; i++)
+            if(module->buffers[i].state == IO_URING_BUFFER_FREE) break;
+         if(i == IO_URING_NUM_BUFFERS)
+         {
+            /* All the buffers are in flight */
+            io_uring_submit(module);
+            io_uring_wait_any(module);
+            continue;
+         }
+
+         /* Buffers end on a buffer size boundary so the following ones are aligned */
+         buffer = module->filling = &module->buffers[i];
+         buffer->state = IO_URING_BUFFER_FILLING;
+         buffer->offset = module->position;
+         buffer->size = 0;
+         buffer->capacity = IO_URING_BUFFER_SIZE -
+            (size_t)(module->position & (IO_URING_BUFFER_SIZE-1));
+      }
+
+      bytes = MIN(size, buffer->capacity - buffer->size);
+      memcpy(buffer->mem + buffer->size, (const uint8_t *)data + written, bytes);
+      buffer->size += bytes;
+      module->position += bytes;
+      written += bytes;
+      size -= bytes;
+
+      if(buffer->size == buffer->capacity)
+         io_uring_write_filling(module);
+   }
+
+   io_uring_reap(module);
+   if(module->position > module->size) module->size = module->position;
+   return written;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_uring_seek(VC_CONTAINER_IO_T *p_ctx, int64_t offset)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   struct stat info;
+
+   /* When reading, seeking past the end fails unless the file has grown in the
+    * meantime, which tells readers that the data they want isn't there yet */
+   if(!module->writing && offset > module->size && !fstat(module->fd, &info))
+      module->size = p_ctx->size = info.st_size;
+
+   if(offset < 0 || (!module->writing && offset > module->size))
+   {
+      p_ctx->status = VC_CONTAINER_ERROR_EOS;
+      return p_ctx->status;
+   }
+
+   module->position = offset;
+   p_ctx->status = VC_CONTAINER_SUCCESS;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T io_uring_control(VC_CONTAINER_IO_T *p_ctx,
+   VC_CONTAINER_CONTROL_T operation, va_list args)
+{
+   VC_CONTAINER_IO_MODULE_T *module = p_ctx->module;
+   const VC_CONTAINER_IO_RANGE_T *ranges;
+   unsigned int num_ranges;
+
+   switch(operation)
+   {
+   case VC_CONTAINER_CONTROL_IO_FLUSH:
+      io_uring_write_filling(module);
+      io_uring_wait(module, 0);
+      return module->error ? VC_CONTAINER_ERROR_FAILED : VC_CONTAINER_SUCCESS;
+
+   case VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES:
+      if(module->writing) break;
+      num_ranges = va_arg(args, unsigned int);
+      ranges = va_arg(args, const VC_CONTAINER_IO_RANGE_T *);
+      if(num_ranges > IO_URING_MAX_RANGES) num_ranges = IO_URING_MAX_RANGES;
+      module->num_ranges = ranges ? num_ranges : 0;
+      if(module->num_ranges)
+         memcpy(module->ranges, ranges, module->num_ranges * sizeof(*ranges));
+      io_uring_reap(module);
+      io_uring_read_ahead(module);
+      return VC_CONTAINER_SUCCESS;
+
+   default: break;
+   }
+
+   return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+}
+
+/*****************************************************************************/
+/** Set up the io_uring instance and map its rings */
+static bool io_uring_create( VC_CONTAINER_IO_MODULE_T *module )
+{
+   struct io_uring_params params;
+
+   memset(&params, 0, sizeof(params));
+   module->ring = (int)syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params);
+   if(module->ring < 0) return false; /* Not supported or not allowed */
+
+   module->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+   module->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+   if(params.features & IORING_FEAT_SINGLE_MMAP)
+      module->sq_ring_size = module->cq_ring_size = MAX(module->sq_ring_size, module->cq_ring_size);
+   module->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+   module->sq_ring = mmap(0, module->sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                          module->ring, IORING_OFF_SQ_RING);
+   if(module->sq_ring == MAP_FAILED) goto error_sq;
+
+   module->cq_ring = module->sq_ring;
+   if(!(params.features & IORING_FEAT_SINGLE_MMAP))
+      module->cq_ring = mmap(0, module->cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                             module->ring, IORING_OFF_CQ_RING);
+   if(module->cq_ring == MAP_FAILED) goto error_cq;
+
+   module->sqes = mmap(0, module->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                       module->ring, IORING_OFF_SQES);
+   if(module->sqes == MAP_FAILED) goto error_sqes;
+
+   module->sq_head = (unsigned int *)((uint8_t *)module->sq_ring + params.sq_off.head);
+   module->sq_tail = (unsigned int *)((uint8_t *)module->sq_ring + params.sq_off.tail);
+   module->sq_mask = (unsigned int *)((uint8_t *)module->sq_ring + params.sq_off.ring_mask);
+   module->sq_array = (unsigned int *)((uint8_t *)module->sq_ring + params.sq_off.array);
+   module->sq_entries = params.sq_entries;
+   module->sq_local_tail = *module->sq_tail;
+   module->cq_head = (unsigned int *)((uint8_t *)module->cq_ring + params.cq_off.head);
+   module->cq_tail = (unsigned int *)((uint8_t *)module->cq_ring + params.cq_off.tail);
+   module->cq_mask = (unsigned int *)((uint8_t *)module->cq_ring + params.cq_off.ring_mask);
+   module->cqes = (struct io_uring_cqe *)((uint8_t *)module->cq_ring + params.cq_off.cqes);
+   return true;
+
+ error_sqes:
+   if(module->cq_ring != module->sq_ring) munmap(module->cq_ring, module->cq_ring_size);
+ error_cq:
+   munmap(module->sq_ring, module->sq_ring_size);
+ error_sq:
+   close(module->ring);
+   return false;
+}
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T vc_container_io_uring_open( VC_CONTAINER_IO_T *p_ctx,
+   const char *unused, VC_CONTAINER_IO_MODE_T mode )
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_URI_NOT_FOUND;
+   VC_CONTAINER_IO_MODULE_T *module = 0;
+   const char *scheme = vc_uri_scheme(p_ctx->uri_parts);
+   const char *path = vc_uri_path(p_ctx->uri_parts);
+   bool direct = scheme && !strcasecmp(scheme, "uring+direct");
+   bool explicit = direct || (scheme && !strcasecmp(scheme, "uring"));
+   int flags = mode == VC_CONTAINER_IO_MODE_WRITE ? O_RDWR|O_CREAT|O_TRUNC : O_RDONLY;
+   struct stat info;
+   unsigned int i;
+   VC_CONTAINER_PARAM_UNUSED(unused);
+
+   /* Local files are left to the cached file i/o unless io_uring is explicitly
+    * asked for */
+   if(!explicit)
+      return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+   if(vc_uri_host(p_ctx->uri_parts) && *vc_uri_host(p_ctx->uri_parts))
+      return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+   if(!path) path = p_ctx->uri;
+
+   module = malloc( sizeof(*module) );
+   if(!module) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   memset(module, 0, sizeof(*module));
+   module->fd = module->buffered_fd = -1;
+
+   /* Step aside if the kernel can't give us an io_uring */
+   if(!io_uring_create(module)) goto error_ring;
+
+   if(direct) module->fd = open(path, flags | O_DIRECT, 0666);
+   if(module->fd < 0) module->fd = open(path, flags, 0666);
+   else if(mode == VC_CONTAINER_IO_MODE_WRITE)
+      module->buffered_fd = open(path, O_RDWR);
+   if(module->buffered_fd < 0) module->buffered_fd = module->fd;
+   if(module->fd < 0) goto error;
+
+   /* Devices and pipes are left to the other i/o modules */
+   if(fstat(module->fd, &info) || !S_ISREG(info.st_mode)) goto error;
+
+   module->mem = NULL;
+   if(posix_memalign((void **)&module->mem, IO_URING_ALIGNMENT,
+                     IO_URING_NUM_BUFFERS * IO_URING_BUFFER_SIZE))
+   {
+      status = VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      goto error;
+   }
+   for(i = 0; i < IO_URING_NUM_BUFFERS; i++)
+      module->buffers[i].mem = module->mem + i * IO_URING_BUFFER_SIZE;
+
+   module->writing = mode == VC_CONTAINER_IO_MODE_WRITE;
+   module->size = info.st_size;
+
+   p_ctx->module = module;
+   p_ctx->pf_close = io_uring_close;
+   p_ctx->pf_read = io_uring_read;
+   p_ctx->pf_write = io_uring_write;
+   p_ctx->pf_seek = io_uring_seek;
+   p_ctx->pf_control = io_uring_control;
+   if(!module->writing)
+      p_ctx->size = info.st_size;
+
+   /* The module does its own buffering so there is no point caching on top of it */
+   p_ctx->capabilities = 0;
+
+   /* Get the start of the file coming in straight away */
+   if(!module->writing) io_uring_read_ahead(module);
+   return VC_CONTAINER_SUCCESS;
+
+ error:
+   if(module->buffered_fd != module->fd) close(module->buffered_fd);
+   if(module->fd >= 0) close(module->fd);
+   munmap(module->sqes, module->sqes_size);
+   if(module->cq_ring != module->sq_ring) munmap(module->cq_ring, module->cq_ring_size);
+   munmap(module->sq_ring, module->sq_ring_size);
+   close(module->ring);
+ error_ring:
+   free(module);
+   return status;
+}
+
+#else /* IO_URING_SUPPORTED */
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T vc_container_io_uring_open( VC_CONTAINER_IO_T *p_ctx,
+   const char *unused, VC_CONTAINER_IO_MODE_T mode )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_ctx);
+   VC_CONTAINER_PARAM_UNUSED(unused);
+   VC_CONTAINER_PARAM_UNUSED(mode);
+   return VC_CONTAINER_ERROR_URI_NOT_FOUND;
+}
+
+#endif /* IO_URING_SUPPORTED */
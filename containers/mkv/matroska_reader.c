@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_io_helpers.h"
 #include "containers/core/containers_utils.h"
 #include "containers/core/containers_logging.h"
+#include "interface/vcos/vcos.h"
 
 /******************************************************************************
 Defines.
@@ -53,6 +54,11 @@ Defines.
 
 #define MKV_MAX_READER_STATE_LEVEL 4
 
+#define MKV_INDEX_SIZE_DEFAULT (4*1024*1024) /* Memory allowed for the seek index by default */
+#define MKV_INDEX_ENTRIES_MIN 256
+#define MKV_INDEX_SCAN_TIMECODE_ELEMENTS 4 /* Elements looked at for the timecode of a cluster */
+#define MKV_LACING_HEADER_MAX 1024 /* Size of the lace tables decoded in one pass */
+
 #define MKV_SKIP_U8(ctx,n)   (size -= 1, SKIP_U8(ctx,n))
 #define MKV_SKIP_U16(ctx,n)  (size -= 2, SKIP_U16(ctx,n))
 #define MKV_SKIP_U24(ctx,n)  (size -= 3, SKIP_U24(ctx,n))
@@ -268,6 +274,7 @@ typedef enum
    MKV_ELEMENT_ID_CUE_TRACK_POSITIONS = 0xB7,
    MKV_ELEMENT_ID_CUE_TRACK = 0xF7,
    MKV_ELEMENT_ID_CUE_CLUSTER_POSITION = 0xF1,
+   MKV_ELEMENT_ID_CUE_RELATIVE_POSITION = 0xF0,
    MKV_ELEMENT_ID_CUE_BLOCK_NUMBER = 0x5378,
 
    /* Attachments */
@@ -332,6 +339,14 @@ typedef struct
    uint32_t header_size_backup;
 } MKV_READER_STATE_T;
 
+/** Entry of the seek index, from a cue point or from scanning the clusters */
+typedef struct
+{
+   int64_t timecode;             /**< Unscaled timecode */
+   uint64_t cluster_offset;      /**< Offset of the cluster from the start of the segment */
+   uint64_t relative_position;   /**< Offset of the block from the start of the cluster data (0 if unknown) */
+} MKV_INDEX_ENTRY_T;
+
 typedef struct
 {
    const MKV_ELEMENT_ID_T id;
@@ -433,6 +448,26 @@ typedef struct VC_CONTAINER_MODULE_T
    int64_t cue_timecode;
    uint64_t cue_cluster_offset;
    unsigned int cue_block;
+   uint64_t cue_relative_position;
+
+   /* Seek index, built from the cues or by scanning the clusters in the background
+    * when there aren't any */
+   struct {
+      uint32_t max_size;         /**< Memory allowed for the index, 0 to walk the cues instead */
+      MKV_INDEX_ENTRY_T *entries;
+      unsigned int num;
+      unsigned int max;
+      bool built;                /**< The index holds the cue points */
+      bool failed;               /**< The cues couldn't be indexed so they are walked instead */
+      unsigned int track;        /**< Track number the cue points were picked for (0 for all) */
+
+      bool scanning;             /**< The clusters are being scanned in the background */
+      volatile bool scan_done;
+      volatile bool scan_stop;
+      VC_CONTAINER_IO_T *scan_io;
+      VCOS_THREAD_T scan_thread;
+      VCOS_MUTEX_T lock;         /**< Protects the entries while they are being scanned */
+   } index;
 
 } VC_CONTAINER_MODULE_T;
 
@@ -611,6 +646,7 @@ MKV_ELEMENT_T mkv_elements_list[] =
    {MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, MKV_ELEMENT_ID_CUE_POINT, "Cue Track Positions", mkv_read_elements},
    {MKV_ELEMENT_ID_CUE_TRACK, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Track", 0},
    {MKV_ELEMENT_ID_CUE_CLUSTER_POSITION, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Cluster Position", 0},
+   {MKV_ELEMENT_ID_CUE_RELATIVE_POSITION, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Relative Position", 0},
    {MKV_ELEMENT_ID_CUE_BLOCK_NUMBER, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Block Number", 0},
 
    /* Attachments */
@@ -679,6 +715,7 @@ MKV_ELEMENT_T mkv_cue_elements_list[] =
    {MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, MKV_ELEMENT_ID_CUE_POINT, "Cue Track Positions", mkv_read_elements},
    {MKV_ELEMENT_ID_CUE_TRACK, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Track", mkv_read_subelements_cue_point},
    {MKV_ELEMENT_ID_CUE_CLUSTER_POSITION, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Cluster Position", mkv_read_subelements_cue_point},
+   {MKV_ELEMENT_ID_CUE_RELATIVE_POSITION, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Relative Position", mkv_read_subelements_cue_point},
    {MKV_ELEMENT_ID_CUE_BLOCK_NUMBER, MKV_ELEMENT_ID_CUE_TRACK_POSITIONS, "Cue Block Number", mkv_read_subelements_cue_point},
 
    /* Global Elements */
@@ -1608,6 +1645,8 @@ static VC_CONTAINER_STATUS_T mkv_read_subelements_cue_point( VC_CONTAINER_T *p_c
       module->cue_track = value; break;
    case MKV_ELEMENT_ID_CUE_CLUSTER_POSITION:
       module->cue_cluster_offset = value; break;
+   case MKV_ELEMENT_ID_CUE_RELATIVE_POSITION:
+      module->cue_relative_position = value; break;
    case MKV_ELEMENT_ID_CUE_BLOCK_NUMBER:
       module->cue_block = value; break;
    default: break;
@@ -1812,6 +1851,66 @@ static VC_CONTAINER_STATUS_T mkv_find_next_block(VC_CONTAINER_T *p_ctx, MKV_READ
    return status == VC_CONTAINER_SUCCESS ? STREAM_STATUS(p_ctx) : status;
 }
 
+/** Decode the Xiph or EBML lace table of a block from memory, the same way
+ * mkv_read_next_frame_header does from the stream.
+ * Returns the size of the table or 0 if the data given doesn't contain all of it. */
+static unsigned int mkv_read_lacing_sizes(MKV_READER_STATE_T *state, unsigned int lacing,
+      const uint8_t *data, size_t data_size)
+{
+   unsigned int i, pos = 0, start;
+   int32_t fs = 0;
+
+   for(i = 0; i < state->lacing_num_frames; i++)
+   {
+      if(lacing == 1) /* Xiph lacing */
+      {
+         for(fs = 0; pos < data_size && data[pos] == 255; pos++)
+            fs += 255;
+         if(pos == data_size) return 0;
+         fs += data[pos++];
+      }
+      else /* EBML lacing, with the sizes after the first one coded as signed differences */
+      {
+         uint64_t value, mask = 0x80;
+         int64_t number;
+
+         if(pos == data_size) return 0;
+         start = pos;
+         value = data[pos++];
+         if(value == 0xFF) number = -1;
+         else
+         {
+            for(; mask; mask <<= 7)
+            {
+               if(value & mask) break;
+               if(pos == data_size) return 0;
+               value = (value << 8) | data[pos++];
+            }
+            number = mask ? (int64_t)(value & ~mask) : 0;
+         }
+
+         if(!i) fs = number;
+         else
+         {
+            switch(pos - start)
+            {
+            case 1: number -= 0x3F; break;
+            case 2: number -= 0x1FFF; break;
+            case 3: number -= 0xFFFFF; break;
+            case 4: number -= 0x7FFFFFF; break;
+            default: break;
+            }
+            fs += number;
+         }
+      }
+
+      if(state->lacing_num_frames > MKV_MAX_LACING_NUM) continue;
+      state->lacing_sizes[state->lacing_num_frames-(i+1)] = fs;
+   }
+
+   return pos;
+}
+
 static VC_CONTAINER_STATUS_T mkv_read_next_frame_header(VC_CONTAINER_T *p_ctx,
       MKV_READER_STATE_T *state, uint32_t *pi_track, uint32_t *pi_length)
 {
@@ -1863,14 +1962,31 @@ static VC_CONTAINER_STATUS_T mkv_read_next_frame_header(VC_CONTAINER_T *p_ctx,
    state->lacing_num_frames = 0;
    if(i < p_ctx->tracks_num && (flags & 0x06))
    {
-      unsigned int i, value = 0;
+      unsigned int i, value = 0, lacing = (flags & 0x06)>>1, table_size = 0;
       int32_t fs = 0;
 
       state->lacing_num_frames = MKV_READ_U8(p_ctx, "Lacing Head");
       state->lacing_size = 0;
-      switch((flags & 0x06)>>1)
+
+      /* Decode the table of frame sizes in one pass when it fits in our buffer, otherwise
+       * fall back to reading it byte by byte */
+      if(lacing != 2 && size > 0)
+      {
+         uint8_t table[MKV_LACING_HEADER_MAX];
+         size_t peek_size = state->lacing_num_frames * (lacing == 1 ? 4 : 8);
+         peek_size = PEEK_BYTES(p_ctx, table, (size_t)MIN((int64_t)MIN(peek_size, sizeof(table)), size));
+         table_size = mkv_read_lacing_sizes(state, lacing, table, peek_size);
+         if(table_size)
+         {
+            SKIP_BYTES(p_ctx, table_size);
+            size -= table_size;
+         }
+      }
+
+      switch(lacing)
       {
       case 1:  /* Xiph lacing */
+         if(table_size) break;
          for(i = 0; i < state->lacing_num_frames; i++, fs = 0)
          {
             do {
@@ -1883,6 +1999,7 @@ static VC_CONTAINER_STATUS_T mkv_read_next_frame_header(VC_CONTAINER_T *p_ctx,
          }
          break;
       case 3:  /* EBML lacing */
+         if(table_size) break;
          for(i = 0; i < state->lacing_num_frames; i++)
          {
             if(!i) fs = MKV_READ_UINT(p_ctx, "Frame Size");
@@ -2022,6 +2139,330 @@ static VC_CONTAINER_STATUS_T mkv_read_frame_data(VC_CONTAINER_T *p_ctx,
    return STREAM_STATUS(p_ctx);
 }
 
+/** Lends the frame data straight from the i/o if it holds it in memory.
+ * Returns false if the data needs to be read with mkv_read_frame_data() instead. */
+static bool mkv_borrow_frame_data(VC_CONTAINER_T *p_ctx,
+      MKV_READER_STATE_T *state, const uint8_t **pp_data, uint32_t *pi_length)
+{
+   const uint8_t *data;
+   uint64_t size;
+
+   /* Stripped headers need to be inserted in front of the frame data */
+   if(state->header_size) return false;
+
+   size = state->levels[state->level].size - state->levels[state->level].data_start -
+      state->levels[state->level].data_offset;
+   if(state->lacing_num_frames)
+      size = state->lacing_current_size - state->levels[state->level].data_offset;
+   if(size > *pi_length) size = *pi_length;
+
+   data = BORROW_BYTES(p_ctx, size);
+   if(!data) return false;
+
+   state->levels[state->level].data_offset += size;
+   *pp_data = data;
+   *pi_length = size;
+   return true;
+}
+
+/*****************************************************************************/
+/** Add an entry to the seek index, within the amount of memory we're allowed to use */
+static VC_CONTAINER_STATUS_T mkv_index_add(VC_CONTAINER_MODULE_T *module,
+   int64_t timecode, uint64_t cluster_offset, uint64_t relative_position)
+{
+   MKV_INDEX_ENTRY_T *entry;
+
+   if(module->index.num == module->index.max)
+   {
+      unsigned int max = module->index.max ? module->index.max * 2 : MKV_INDEX_ENTRIES_MIN;
+      if((uint64_t)module->index.num * sizeof(*entry) >= module->index.max_size)
+         return VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+      if((uint64_t)max * sizeof(*entry) > module->index.max_size)
+         max = module->index.max_size / sizeof(*entry);
+
+      entry = realloc(module->index.entries, max * sizeof(*entry));
+      if(!entry) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      module->index.entries = entry;
+      module->index.max = max;
+   }
+
+   entry = &module->index.entries[module->index.num++];
+   entry->timecode = timecode;
+   entry->cluster_offset = cluster_offset;
+   entry->relative_position = relative_position;
+   return VC_CONTAINER_SUCCESS;
+}
+
+static int mkv_index_compare(const void *a, const void *b)
+{
+   const MKV_INDEX_ENTRY_T *entry_a = a, *entry_b = b;
+   if(entry_a->timecode != entry_b->timecode)
+      return entry_a->timecode < entry_b->timecode ? -1 : 1;
+   return entry_a->cluster_offset < entry_b->cluster_offset ? -1 :
+      entry_a->cluster_offset > entry_b->cluster_offset;
+}
+
+/** Build the seek index from the cue points of the given track (all of them if 0) */
+static VC_CONTAINER_STATUS_T mkv_index_build(VC_CONTAINER_T *p_ctx, unsigned int track_number)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+   MKV_ELEMENT_T *element = mkv_cue_elements_list;
+   int64_t size, element_size;
+   MKV_ELEMENT_ID_T id;
+   unsigned int i;
+   bool sorted = true;
+
+   module->index.num = 0;
+   module->index.built = false;
+   module->index.track = track_number;
+
+   status = SEEK(p_ctx, module->cues_offset);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+   status = mkv_read_element_header(p_ctx, INT64_C(-1), &id, &element_size,
+                                    MKV_ELEMENT_ID_SEGMENT, &element);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+   if(id != MKV_ELEMENT_ID_CUES) return VC_CONTAINER_ERROR_CORRUPTED;
+   size = element_size;
+
+   module->elements_list = mkv_cue_elements_list;
+   while(size > 0)
+   {
+      int64_t element_offset = STREAM_POSITION(p_ctx);
+      element = mkv_cue_elements_list;
+      module->cue_relative_position = 0;
+
+      status = mkv_read_element_header(p_ctx, size, &id, &element_size,
+                                       MKV_ELEMENT_ID_CUES, &element);
+      size -= STREAM_POSITION(p_ctx) - element_offset;
+      if(status == VC_CONTAINER_SUCCESS && element->id != MKV_ELEMENT_ID_UNKNOWN)
+         status = mkv_read_element_data(p_ctx, element, element_size, size);
+
+      /* Like the cue walk, stop at the first thing we can't make sense of
+       * and just keep what we've got so far */
+      if(status != VC_CONTAINER_SUCCESS || element->id == MKV_ELEMENT_ID_UNKNOWN)
+      {
+         status = VC_CONTAINER_SUCCESS;
+         break;
+      }
+
+      size -= element_size;
+      if(id != MKV_ELEMENT_ID_CUE_POINT) continue;
+      if(track_number && track_number != module->cue_track) continue;
+
+      if(module->index.num &&
+         module->index.entries[module->index.num-1].timecode > module->cue_timecode)
+         sorted = false;
+      status = mkv_index_add(module, module->cue_timecode, module->cue_cluster_offset,
+                             module->cue_relative_position);
+      if(status != VC_CONTAINER_SUCCESS) break;
+   }
+   module->elements_list = mkv_elements_list;
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   if(!sorted)
+      qsort(module->index.entries, module->index.num, sizeof(*module->index.entries),
+            mkv_index_compare);
+
+   for(i = 0; i < module->index.num; i++)
+      LOG_FORMAT(p_ctx, "INDEX: %"PRIi64, module->index.entries[i].timecode);
+   LOG_DEBUG(p_ctx, "indexed %u cue points for track %u", module->index.num, track_number);
+   module->index.built = true;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/** Read the timecode of a cluster with the scanning i/o, which is positioned
+ * at the start of the cluster data */
+static bool mkv_index_scan_timecode(VC_CONTAINER_IO_T *io, int64_t cluster_size, int64_t *timecode)
+{
+   unsigned int i;
+
+   for(i = 0; i < MKV_INDEX_SCAN_TIMECODE_ELEMENTS && cluster_size > 0; i++)
+   {
+      int64_t size = cluster_size, element_size, value = 0;
+      MKV_ELEMENT_ID_T id = mkv_io_read_id(io, &size);
+
+      element_size = mkv_io_read_uint(io, &size);
+      if(io->status != VC_CONTAINER_SUCCESS || element_size < 0) return false;
+      cluster_size = size - element_size;
+
+      if(id != MKV_ELEMENT_ID_TIMECODE)
+      {
+         if(vc_container_io_skip(io, (size_t)element_size) != (size_t)element_size) return false;
+         continue;
+      }
+
+      if(element_size > 8) return false;
+      while(element_size--)
+         value = (value << 8) | vc_container_io_read_uint8(io);
+      *timecode = value;
+      return io->status == VC_CONTAINER_SUCCESS;
+   }
+
+   return false;
+}
+
+/** Background thread building the seek index by going through the clusters of
+ * a segment which doesn't have any cues, using its own i/o */
+static void *mkv_index_scan_thread(void *arg)
+{
+   VC_CONTAINER_T *p_ctx = arg;
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_IO_T *io = module->index.scan_io;
+   int64_t offset = module->cluster_offset, end = INT64_C(-1);
+
+   if(module->segment_size >= 0)
+      end = module->segment_offset + module->segment_size;
+
+   while(!module->index.scan_stop && (end < 0 || offset < end))
+   {
+      int64_t size = INT64_C(1) << 30, element_size, timecode;
+      MKV_ELEMENT_ID_T id;
+
+      if(vc_container_io_seek(io, offset) != VC_CONTAINER_SUCCESS) break;
+      id = mkv_io_read_id(io, &size);
+      element_size = mkv_io_read_uint(io, &size);
+      /* We can't skip elements of unknown size (live streams) */
+      if(io->status != VC_CONTAINER_SUCCESS || element_size < 0) break;
+
+      if(id == MKV_ELEMENT_ID_CLUSTER && mkv_index_scan_timecode(io, element_size, &timecode))
+      {
+         VC_CONTAINER_STATUS_T status;
+
+         vcos_mutex_lock(&module->index.lock);
+         status = mkv_index_add(module, timecode, offset - module->segment_offset, 0);
+         vcos_mutex_unlock(&module->index.lock);
+         if(status != VC_CONTAINER_SUCCESS) break;
+      }
+
+      offset += (INT64_C(1) << 30) - size + element_size;
+   }
+
+   LOG_DEBUG(p_ctx, "scanned %u clusters", module->index.num);
+   module->index.scan_done = true;
+   return NULL;
+}
+
+/** Start indexing the clusters in the background */
+static void mkv_index_scan_start(VC_CONTAINER_T *p_ctx)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+
+   module->index.scan_io = vc_container_io_open(p_ctx->priv->io->uri, VC_CONTAINER_IO_MODE_READ, &status);
+   if(!module->index.scan_io) return;
+
+   if(vcos_thread_create(&module->index.scan_thread, "mkv_index", NULL,
+                         mkv_index_scan_thread, p_ctx) != VCOS_SUCCESS)
+   {
+      vc_container_io_close(module->index.scan_io);
+      module->index.scan_io = 0;
+      return;
+   }
+
+   module->index.scanning = true;
+}
+
+/** Find where to seek to in the seek index, mirroring what the cue walk does.
+ * Returns VC_CONTAINER_ERROR_NOT_FOUND if there is no index to use. */
+static VC_CONTAINER_STATUS_T mkv_index_find(VC_CONTAINER_T *p_ctx, unsigned int track_number,
+   int64_t *p_time, VC_CONTAINER_SEEK_FLAGS_T flags, uint64_t *p_offset, uint64_t *p_relative_position)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   unsigned int low, high, mid;
+   const MKV_INDEX_ENTRY_T *entry = 0;
+
+   if(!module->index.max_size) return VC_CONTAINER_ERROR_NOT_FOUND;
+
+   if(module->index.scanning)
+   {
+      /* Wait until the clusters around the requested time have been scanned */
+      while(!module->index.scan_done)
+      {
+         bool found;
+         vcos_mutex_lock(&module->index.lock);
+         found = module->index.num && module->index.entries[module->index.num-1].timecode *
+            module->timecode_scale / 1000 > *p_time;
+         vcos_mutex_unlock(&module->index.lock);
+         if(found) break;
+         vcos_sleep(1);
+      }
+   }
+   else
+   {
+      if(module->index.failed || !module->cues_offset) return VC_CONTAINER_ERROR_NOT_FOUND;
+      if(!module->index.built || module->index.track != track_number)
+      {
+         status = mkv_index_build(p_ctx, track_number);
+         if(status != VC_CONTAINER_SUCCESS)
+         {
+            LOG_DEBUG(p_ctx, "can't index the cues (%i)", status);
+            module->index.failed = true;
+            return VC_CONTAINER_ERROR_NOT_FOUND;
+         }
+      }
+   }
+
+   vcos_mutex_lock(&module->index.lock);
+
+   /* Find the first entry after the requested time */
+   for(low = 0, high = module->index.num; low < high; )
+   {
+      mid = low + (high - low) / 2;
+      if(module->index.entries[mid].timecode * module->timecode_scale / 1000 > *p_time) high = mid;
+      else low = mid + 1;
+   }
+
+   if(low == module->index.num)
+   {
+      if(flags & VC_CONTAINER_SEEK_FLAG_FORWARD) status = VC_CONTAINER_ERROR_EOS;
+      else if(low) entry = &module->index.entries[low-1]; /* Just use the last entry */
+   }
+   else if(flags & VC_CONTAINER_SEEK_FLAG_FORWARD) entry = &module->index.entries[low];
+   else if(low) entry = &module->index.entries[low-1];
+
+   *p_time = entry ? entry->timecode * module->timecode_scale / 1000 : 0;
+   *p_offset = entry ? entry->cluster_offset : 0;
+   *p_relative_position = entry ? entry->relative_position : 0;
+
+   vcos_mutex_unlock(&module->index.lock);
+   return status;
+}
+
+/** Once the reader state is positioned at the start of a cluster, skip straight to
+ * the block a cue point refers to. The cluster timecode still needs reading first. */
+static void mkv_seek_block(VC_CONTAINER_T *p_ctx, MKV_READER_STATE_T *state,
+   int64_t cluster_offset, uint64_t relative_position)
+{
+   VC_CONTAINER_STATUS_T status;
+   int64_t size;
+   uint64_t value;
+
+   status = mkv_find_next_element(p_ctx, state, MKV_ELEMENT_ID_CLUSTER);
+   if(status != VC_CONTAINER_SUCCESS) goto error;
+   if(state->levels[state->level].size < 0 ||
+      relative_position >= (uint64_t)state->levels[state->level].size) goto error;
+
+   status = mkv_find_next_element(p_ctx, state, MKV_ELEMENT_ID_TIMECODE);
+   if(status != VC_CONTAINER_SUCCESS) goto error;
+   size = state->levels[state->level].size;
+   status = mkv_read_element_data_uint(p_ctx, size, &value);
+   if(status != VC_CONTAINER_SUCCESS) goto error;
+   state->cluster_timecode = value;
+   state->level--;
+
+   if(STREAM_POSITION(p_ctx) - state->levels[state->level].offset < (int64_t)relative_position)
+      SEEK(p_ctx, state->levels[state->level].offset + relative_position);
+   return;
+
+ error:
+   /* Just start from the beginning of the cluster */
+   LOG_DEBUG(p_ctx, "can't go straight to the cue block (%i)", status);
+   state->level = 0;
+   SEEK(p_ctx, cluster_offset);
+}
+
 /*****************************************************************************
  Functions exported as part of the Container Module API
  *****************************************************************************/
@@ -2078,7 +2519,9 @@ static VC_CONTAINER_STATUS_T mkv_reader_read(VC_CONTAINER_T *p_ctx,
 
    /* Read the frame data */
    buffer_size = p_packet->buffer_size;
-   status = mkv_read_frame_data(p_ctx, state, p_packet->data, &buffer_size);
+   if(!(flags & VC_CONTAINER_READ_FLAG_ZERO_COPY) ||
+      !mkv_borrow_frame_data(p_ctx, state, &p_packet->borrowed, &buffer_size))
+      status = mkv_read_frame_data(p_ctx, state, p_packet->data, &buffer_size);
    if(status != VC_CONTAINER_SUCCESS)
    {
       /* FIXME */
@@ -2099,7 +2542,7 @@ static VC_CONTAINER_STATUS_T mkv_reader_seek(VC_CONTAINER_T *p_ctx,
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    MKV_READER_STATE_T *state = &module->state;
-   uint64_t offset = 0, prev_offset = 0, position = STREAM_POSITION(p_ctx);
+   uint64_t offset = 0, prev_offset = 0, position = STREAM_POSITION(p_ctx), relative_position = 0;
    int64_t time_offset = 0, prev_time_offset = 0;
    unsigned int i, video_track;
    MKV_ELEMENT_T *element = mkv_cue_elements_list;
@@ -2114,6 +2557,17 @@ static VC_CONTAINER_STATUS_T mkv_reader_seek(VC_CONTAINER_T *p_ctx,
          p_ctx->tracks[video_track]->format->es_type == VC_CONTAINER_ES_TYPE_VIDEO) break;
 
    if(!*p_offset) goto end; /* Nothing much to do */
+
+   /* Use the seek index if we've got one, otherwise walk the cues */
+   time_offset = *p_offset;
+   status = mkv_index_find(p_ctx, video_track != p_ctx->tracks_num ?
+                           p_ctx->tracks[video_track]->priv->module->number : 0,
+                           &time_offset, flags, &offset, &relative_position);
+   if(status == VC_CONTAINER_SUCCESS) {*p_offset = time_offset; goto end;}
+   if(status != VC_CONTAINER_ERROR_NOT_FOUND) goto error;
+   status = VC_CONTAINER_SUCCESS;
+   time_offset = 0;
+
    if(!module->cues_offset) {status = VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION; goto error;}
 
    /* We need to do a search in the cue list */
@@ -2196,6 +2650,9 @@ static VC_CONTAINER_STATUS_T mkv_reader_seek(VC_CONTAINER_T *p_ctx,
       p_track->priv->module->state = state;
    }
 
+   if(relative_position && status == VC_CONTAINER_SUCCESS)
+      mkv_seek_block(p_ctx, state, module->segment_offset + offset, relative_position);
+
    /* If we have a video track, we skip frames until the next keyframe */
    for(i = 0; video_track != p_ctx->tracks_num && i < 200 /* limit search */; )
    {
@@ -2225,6 +2682,15 @@ static VC_CONTAINER_STATUS_T mkv_reader_close(VC_CONTAINER_T *p_ctx)
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    unsigned int i, j;
 
+   if(module->index.scanning)
+   {
+      module->index.scan_stop = true;
+      vcos_thread_join(&module->index.scan_thread, NULL);
+      vc_container_io_close(module->index.scan_io);
+   }
+   vcos_mutex_delete(&module->index.lock);
+   free(module->index.entries);
+
    for(i = 0; i < p_ctx->tracks_num; i++)
    {
       for(j = 0; j < MKV_MAX_ENCODINGS; j++)
@@ -2235,6 +2701,31 @@ static VC_CONTAINER_STATUS_T mkv_reader_close(VC_CONTAINER_T *p_ctx)
    return VC_CONTAINER_SUCCESS;
 }
 
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mkv_reader_control(VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_CONTROL_T operation, va_list args)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   switch(operation)
+   {
+   case VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE:
+      vcos_mutex_lock(&module->index.lock);
+      module->index.max_size = va_arg(args, uint32_t);
+      /* The cue points will be indexed again within the new limit when next needed */
+      if(!module->index.scanning)
+      {
+         module->index.built = module->index.failed = false;
+         module->index.num = 0;
+      }
+      vcos_mutex_unlock(&module->index.lock);
+      return VC_CONTAINER_SUCCESS;
+
+   default:
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   }
+}
+
 /*****************************************************************************/
 VC_CONTAINER_STATUS_T mkv_reader_open(VC_CONTAINER_T *p_ctx)
 {
@@ -2257,9 +2748,15 @@ VC_CONTAINER_STATUS_T mkv_reader_open(VC_CONTAINER_T *p_ctx)
    module = malloc(sizeof(*module));
    if(!module) {status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error;}
    memset(module, 0, sizeof(*module));
+   if(vcos_mutex_create(&module->index.lock, "mkv_index") != VCOS_SUCCESS)
+   {
+      free(module);
+      return VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+   }
    p_ctx->priv->module = module;
    p_ctx->tracks = module->tracks;
    module->elements_list = mkv_elements_list;
+   module->index.max_size = MKV_INDEX_SIZE_DEFAULT;
 
    /* Read and sanity check the EBML header */
    status = mkv_read_element(p_ctx, INT64_C(-1), MKV_ELEMENT_ID_UNKNOWN);
@@ -2289,6 +2786,7 @@ VC_CONTAINER_STATUS_T mkv_reader_open(VC_CONTAINER_T *p_ctx)
    p_ctx->priv->pf_close = mkv_reader_close;
    p_ctx->priv->pf_read = mkv_reader_read;
    p_ctx->priv->pf_seek = mkv_reader_seek;
+   p_ctx->priv->pf_control = mkv_reader_control;
    p_ctx->duration = module->duration / 1000 * module->timecode_scale;
 
    /* Check if we're done */
@@ -2297,6 +2795,14 @@ VC_CONTAINER_STATUS_T mkv_reader_open(VC_CONTAINER_T *p_ctx)
 
    if(module->cues_offset && (int64_t)module->cues_offset < p_ctx->size)
       p_ctx->capabilities |= VC_CONTAINER_CAPS_CAN_SEEK;
+   else if(module->cluster_offset)
+   {
+      /* No cues so we need to find the clusters ourselves */
+      module->cues_offset = 0;
+      mkv_index_scan_start(p_ctx);
+      if(module->index.scanning)
+         p_ctx->capabilities |= VC_CONTAINER_CAPS_CAN_SEEK;
+   }
 
    if(module->tags_offset)
    {
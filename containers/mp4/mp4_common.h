@@ -73,6 +73,20 @@ typedef enum {
    MP4_BOX_TYPE_DAWP              = VC_FOURCC('d','a','w','p'),
    MP4_BOX_TYPE_DEVC              = VC_FOURCC('d','e','v','c'),
    MP4_BOX_TYPE_WAVE              = VC_FOURCC('w','a','v','e'),
+   MP4_BOX_TYPE_MVEX              = VC_FOURCC('m','v','e','x'),
+   MP4_BOX_TYPE_MEHD              = VC_FOURCC('m','e','h','d'),
+   MP4_BOX_TYPE_TREX              = VC_FOURCC('t','r','e','x'),
+   MP4_BOX_TYPE_STYP              = VC_FOURCC('s','t','y','p'),
+   MP4_BOX_TYPE_SIDX              = VC_FOURCC('s','i','d','x'),
+   MP4_BOX_TYPE_MOOF              = VC_FOURCC('m','o','o','f'),
+   MP4_BOX_TYPE_MFHD              = VC_FOURCC('m','f','h','d'),
+   MP4_BOX_TYPE_TRAF              = VC_FOURCC('t','r','a','f'),
+   MP4_BOX_TYPE_TFHD              = VC_FOURCC('t','f','h','d'),
+   MP4_BOX_TYPE_TFDT              = VC_FOURCC('t','f','d','t'),
+   MP4_BOX_TYPE_TRUN              = VC_FOURCC('t','r','u','n'),
+   MP4_BOX_TYPE_MFRA              = VC_FOURCC('m','f','r','a'),
+   MP4_BOX_TYPE_TFRA              = VC_FOURCC('t','f','r','a'),
+   MP4_BOX_TYPE_MFRO              = VC_FOURCC('m','f','r','o'),
    MP4_BOX_TYPE_ZERO              = 0
 } MP4_BOX_TYPE_T;
 
@@ -85,6 +99,10 @@ typedef enum {
    MP4_BRAND_SKM2                 = VC_FOURCC('s','k','m','2'),
    MP4_BRAND_SKM3                 = VC_FOURCC('s','k','m','3'),
    MP4_BRAND_QT                   = VC_FOURCC('q','t',' ',' '),
+   MP4_BRAND_ISO6                 = VC_FOURCC('i','s','o','6'),
+   MP4_BRAND_CMFC                 = VC_FOURCC('c','m','f','c'),
+   MP4_BRAND_CMFS                 = VC_FOURCC('c','m','f','s'),
+   MP4_BRAND_CMFF                 = VC_FOURCC('c','m','f','f'),
    MP4_BRAND_NUM
 } MP4_BRAND_T;
 
@@ -100,6 +118,34 @@ typedef enum
    MP4_SAMPLE_TABLE_NUM
 } MP4_SAMPLE_TABLE_T;
 
+/** \name Flags of the track fragment header box (tfhd)
+ * @{ */
+#define MP4_TFHD_BASE_DATA_OFFSET_PRESENT          0x000001
+#define MP4_TFHD_SAMPLE_DESCRIPTION_INDEX_PRESENT  0x000002
+#define MP4_TFHD_DEFAULT_SAMPLE_DURATION_PRESENT   0x000008
+#define MP4_TFHD_DEFAULT_SAMPLE_SIZE_PRESENT       0x000010
+#define MP4_TFHD_DEFAULT_SAMPLE_FLAGS_PRESENT      0x000020
+#define MP4_TFHD_DURATION_IS_EMPTY                 0x010000
+#define MP4_TFHD_DEFAULT_BASE_IS_MOOF              0x020000
+/* @} */
+
+/** \name Flags of the track fragment run box (trun)
+ * @{ */
+#define MP4_TRUN_DATA_OFFSET_PRESENT               0x000001
+#define MP4_TRUN_FIRST_SAMPLE_FLAGS_PRESENT        0x000004
+#define MP4_TRUN_SAMPLE_DURATION_PRESENT           0x000100
+#define MP4_TRUN_SAMPLE_SIZE_PRESENT               0x000200
+#define MP4_TRUN_SAMPLE_FLAGS_PRESENT              0x000400
+#define MP4_TRUN_SAMPLE_COMPOSITION_TIME_OFFSETS_PRESENT 0x000800
+/* @} */
+
+/** Bit of the sample flags signalling a sample which isn't a sync sample */
+#define MP4_SAMPLE_FLAG_IS_NON_SYNC                0x00010000
+/** Sample flags for a sample which doesn't depend on others (i.e. a sync sample) */
+#define MP4_SAMPLE_FLAGS_SYNC                      0x02000000
+/** Sample flags for a sample which depends on others */
+#define MP4_SAMPLE_FLAGS_NON_SYNC                  (0x01000000|MP4_SAMPLE_FLAG_IS_NON_SYNC)
+
 /* Values for object_type_indication (mp4_decoder_config_descriptor)
  * see ISO/IEC 14496-1:2001(E) section 8.6.6.2 table 8 p. 30
  * see ISO/IEC 14496-15:2003 (draft) section 4.2.2 table 3 p. 11
@@ -61,6 +61,12 @@ Defines.
 
 #define MP4_MAX_SAMPLES_BATCH_SIZE (16*1024)
 
+#define MP4_FRAGMENT_SAMPLES_MAX (64*1024) /* Maximum number of samples queued per track */
+#define MP4_FRAGMENT_SAMPLES_MIN 256
+#define MP4_FRAGMENT_INDEX_MIN 64
+#define MP4_TRUN_BUFFER_SIZE 4096
+#define MP4_INDEX_BUFFER_ENTRIES 512 /* Sample table entries read at once when building a seek index */
+
 #define MP4_SKIP_U8(ctx,n)   (size -= 1, SKIP_U8(ctx,n))
 #define MP4_SKIP_U16(ctx,n)  (size -= 2, SKIP_U16(ctx,n))
 #define MP4_SKIP_U24(ctx,n)  (size -= 3, SKIP_U24(ctx,n))
@@ -77,6 +83,8 @@ Defines.
 #define MP4_SKIP_BYTES(ctx,sz) (size -= sz, SKIP_BYTES(ctx,sz))
 #define MP4_SKIP_STRING(ctx,sz,n) (size -= sz, SKIP_STRING(ctx,sz,n))
 
+#define MP4_BE32(p) (((uint32_t)(p)[0] << 24) | ((p)[1] << 16) | ((p)[2] << 8) | (p)[3])
+
 /******************************************************************************
 Type definitions.
 ******************************************************************************/
@@ -111,6 +119,50 @@ typedef struct
 
 } MP4_READER_STATE_T;
 
+/** Sample of a track fragment (from a trun box) */
+typedef struct
+{
+   int64_t offset;
+   int64_t dts;                /**< Decoding time in the timescale of the track */
+   int32_t composition_offset;
+   uint32_t size;
+   uint32_t duration;
+   bool sync;
+} MP4_FRAGMENT_SAMPLE_T;
+
+/** Entry of the fragment index used for seeking */
+typedef struct
+{
+   int64_t offset;             /**< Where to start looking for the movie fragment */
+   int64_t time;               /**< Decoding time of the fragment in the timescale of the reference track */
+} MP4_FRAGMENT_INDEX_T;
+
+/** Run of samples with the same duration in the seek index. Consecutive stts entries
+ * with the same duration are merged into a single run. */
+typedef struct
+{
+   int64_t time;               /**< Decoding time of the first sample in the timescale of the track */
+   uint32_t sample;            /**< First sample of the run */
+   uint32_t delta;             /**< Duration of each sample of the run */
+   uint32_t entry;             /**< First stts entry of the run */
+} MP4_INDEX_STTS_T;
+
+/** Run of samples with the same composition offset in the seek index */
+typedef struct
+{
+   uint32_t sample;            /**< First sample of the run */
+   int32_t offset;
+   uint32_t entry;             /**< First ctts entry of the run */
+} MP4_INDEX_CTTS_T;
+
+/** Entry of the stsc table in the seek index */
+typedef struct
+{
+   uint32_t sample;            /**< First sample of the first chunk */
+   uint32_t first_chunk;       /**< As found in the table (starting from 1) */
+   uint32_t samples_per_chunk;
+} MP4_INDEX_STSC_T;
+
 typedef struct VC_CONTAINER_TRACK_MODULE_T
 {
    MP4_READER_STATE_T state;
@@ -127,6 +179,38 @@ typedef struct VC_CONTAINER_TRACK_MODULE_T
 
    uint32_t samples_batch_size;
 
+   uint32_t track_id;
+
+   struct {
+      uint32_t default_duration; /**< Defaults from the trex box */
+      uint32_t default_size;
+      uint32_t default_flags;
+
+      MP4_FRAGMENT_SAMPLE_T *samples; /**< Queue of the samples parsed from movie fragments */
+      unsigned int num;
+      unsigned int max;
+      unsigned int index;        /**< Next sample of the queue to be read */
+      int64_t dts;               /**< Decoding time of the next sample to be parsed */
+   } fragment;
+
+   /** Copy of the sample tables kept in memory to speed up seeking */
+   struct {
+      bool built;
+      bool failed;               /**< Too big or unusable so the tables are walked instead */
+      size_t size;               /**< Memory used by the index */
+      MP4_INDEX_STTS_T *stts;
+      uint32_t stts_num;
+      uint32_t samples;          /**< Number of samples described by the stts table */
+      int64_t duration;          /**< Sum of the durations of these samples */
+      MP4_INDEX_CTTS_T *ctts;
+      uint32_t ctts_num;
+      uint32_t ctts_samples;     /**< Number of samples described by the ctts table */
+      MP4_INDEX_STSC_T *stsc;
+      uint32_t stsc_num;
+      uint32_t *stss;            /**< Sync samples (starting from 1) */
+      uint32_t stss_num;
+   } seek_index;
+
 } VC_CONTAINER_TRACK_MODULE_T;
 
 typedef struct VC_CONTAINER_MODULE_T
@@ -145,6 +229,36 @@ typedef struct VC_CONTAINER_MODULE_T
    int64_t data_offset;
    int64_t data_size;
 
+   bool prefetch_hint; /**< A track switched chunk so the i/o needs new prefetch hints */
+
+   bool fragmented; /**< The samples are described by movie fragments (moof) */
+   struct {
+      int64_t first_offset; /**< Where to start looking for the first movie fragment */
+      int64_t next_offset;  /**< Where to start looking for the next movie fragment */
+      int64_t moof_offset;
+      int64_t base_offset;  /**< Base data offset of the current track fragment */
+      int64_t data_offset;  /**< Where the data of the next track run starts */
+      int64_t data_end;     /**< End of the data of the last track fragment */
+      VC_CONTAINER_TRACK_MODULE_T *track; /**< Track of the current track fragment */
+      uint32_t default_duration;
+      uint32_t default_size;
+      uint32_t default_flags;
+      bool index_only;      /**< Only parse the timing of the fragment */
+      int64_t ref_dts;      /**< Decoding time of the reference track in the current fragment */
+
+      MP4_FRAGMENT_INDEX_T *index;
+      unsigned int index_num;
+      unsigned int index_max;
+      bool index_complete;  /**< The index comes from a sidx or mfra covering the whole file */
+      bool index_tail;      /**< The last fragment parsed is the last one in the index */
+      bool mfra_checked;
+   } fragment;
+
+   struct {
+      uint32_t max_size;    /**< Memory allowed for the seek indexes of all the tracks, 0 if disabled */
+      size_t size;          /**< Memory used by the seek indexes */
+   } seek_index;
+
 } VC_CONTAINER_MODULE_T;
 
 /******************************************************************************
@@ -186,6 +300,18 @@ static VC_CONTAINER_STATUS_T mp4_read_box_soun_dawp( VC_CONTAINER_T *p_ctx, int6
 static VC_CONTAINER_STATUS_T mp4_read_box_soun_devc( VC_CONTAINER_T *p_ctx, int64_t size );
 static VC_CONTAINER_STATUS_T mp4_read_box_soun_wave( VC_CONTAINER_T *p_ctx, int64_t size );
 
+static VC_CONTAINER_STATUS_T mp4_read_box_mvex( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_mehd( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_trex( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_sidx( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_moof( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_traf( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_tfhd( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_tfdt( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_trun( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_mfra( VC_CONTAINER_T *p_ctx, int64_t size );
+static VC_CONTAINER_STATUS_T mp4_read_box_tfra( VC_CONTAINER_T *p_ctx, int64_t size );
+
 static struct {
   const MP4_BOX_TYPE_T type;
   VC_CONTAINER_STATUS_T (*pf_func)( VC_CONTAINER_T *, int64_t );
@@ -229,6 +355,22 @@ static struct {
    {MP4_BOX_TYPE_WAVE, mp4_read_box_soun_wave, MP4_BOX_TYPE_SOUN},
    {MP4_BOX_TYPE_ESDS, mp4_read_box_esds, MP4_BOX_TYPE_SOUN},
 
+   /* Movie fragments */
+   {MP4_BOX_TYPE_MVEX, mp4_read_box_mvex, MP4_BOX_TYPE_MOOV},
+   {MP4_BOX_TYPE_MEHD, mp4_read_box_mehd, MP4_BOX_TYPE_MVEX},
+   {MP4_BOX_TYPE_TREX, mp4_read_box_trex, MP4_BOX_TYPE_MVEX},
+   {MP4_BOX_TYPE_STYP, 0,                 MP4_BOX_TYPE_ROOT},
+   {MP4_BOX_TYPE_SIDX, mp4_read_box_sidx, MP4_BOX_TYPE_ROOT},
+   {MP4_BOX_TYPE_MOOF, mp4_read_box_moof, MP4_BOX_TYPE_ROOT},
+   {MP4_BOX_TYPE_MFHD, 0,                 MP4_BOX_TYPE_MOOF},
+   {MP4_BOX_TYPE_TRAF, mp4_read_box_traf, MP4_BOX_TYPE_MOOF},
+   {MP4_BOX_TYPE_TFHD, mp4_read_box_tfhd, MP4_BOX_TYPE_TRAF},
+   {MP4_BOX_TYPE_TFDT, mp4_read_box_tfdt, MP4_BOX_TYPE_TRAF},
+   {MP4_BOX_TYPE_TRUN, mp4_read_box_trun, MP4_BOX_TYPE_TRAF},
+   {MP4_BOX_TYPE_MFRA, mp4_read_box_mfra, MP4_BOX_TYPE_ROOT},
+   {MP4_BOX_TYPE_TFRA, mp4_read_box_tfra, MP4_BOX_TYPE_MFRA},
+   {MP4_BOX_TYPE_MFRO, 0,                 MP4_BOX_TYPE_MFRA},
+
    {MP4_BOX_TYPE_UNKNOWN, 0,              MP4_BOX_TYPE_UNKNOWN}
 };
 
@@ -528,6 +670,7 @@ static VC_CONTAINER_STATUS_T mp4_read_box_trak( VC_CONTAINER_T *p_ctx, int64_t s
 static VC_CONTAINER_STATUS_T mp4_read_box_tkhd( VC_CONTAINER_T *p_ctx, int64_t size )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[module->current_track]->priv->module;
    uint32_t i, version;
    int64_t duration;
 
@@ -538,7 +681,7 @@ static VC_CONTAINER_STATUS_T mp4_read_box_tkhd( VC_CONTAINER_T *p_ctx, int64_t s
    {
       MP4_SKIP_U64(p_ctx, "creation_time");
       MP4_SKIP_U64(p_ctx, "modification_time");
-      MP4_SKIP_U32(p_ctx, "track_ID");
+      track_module->track_id = MP4_READ_U32(p_ctx, "track_ID");
       MP4_SKIP_U32(p_ctx, "reserved");
       duration = MP4_READ_U64(p_ctx, "duration");
    }
@@ -546,7 +689,7 @@ static VC_CONTAINER_STATUS_T mp4_read_box_tkhd( VC_CONTAINER_T *p_ctx, int64_t s
    {
       MP4_SKIP_U32(p_ctx, "creation_time");
       MP4_SKIP_U32(p_ctx, "modification_time");
-      MP4_SKIP_U32(p_ctx, "track_ID");
+      track_module->track_id = MP4_READ_U32(p_ctx, "track_ID");
       MP4_SKIP_U32(p_ctx, "reserved");
       duration = MP4_READ_U32(p_ctx, "duration");
    }
@@ -1197,6 +1340,452 @@ static VC_CONTAINER_STATUS_T mp4_read_box_text( VC_CONTAINER_T *p_ctx, int64_t s
    return STREAM_STATUS(p_ctx);
 }
 
+/*****************************************************************************/
+static VC_CONTAINER_TRACK_MODULE_T *mp4_find_track( VC_CONTAINER_T *p_ctx, uint32_t track_id )
+{
+   unsigned int i;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+      if(p_ctx->tracks[i]->priv->module->track_id == track_id)
+         return p_ctx->tracks[i]->priv->module;
+   return 0;
+}
+
+/*****************************************************************************/
+/** The timing of the fragment index is the one of the first enabled video track
+ * or of the first track if there is no video */
+static unsigned int mp4_fragment_ref_track( VC_CONTAINER_T *p_ctx )
+{
+   unsigned int i;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+      if(p_ctx->tracks[i]->is_enabled &&
+         p_ctx->tracks[i]->format->es_type == VC_CONTAINER_ES_TYPE_VIDEO) return i;
+   return 0;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_fragment_index_add( VC_CONTAINER_T *p_ctx,
+   int64_t offset, int64_t time )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   MP4_FRAGMENT_INDEX_T *index;
+
+   /* The index is sorted by offset */
+   if(module->fragment.index_num &&
+      offset <= module->fragment.index[module->fragment.index_num - 1].offset)
+      return VC_CONTAINER_SUCCESS;
+
+   if(module->fragment.index_num == module->fragment.index_max)
+   {
+      unsigned int max = MAX(module->fragment.index_max * 2, MP4_FRAGMENT_INDEX_MIN);
+      index = realloc(module->fragment.index, max * sizeof(*index));
+      if(!index) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      module->fragment.index = index;
+      module->fragment.index_max = max;
+   }
+
+   index = &module->fragment.index[module->fragment.index_num++];
+   index->offset = offset;
+   index->time = time;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_mvex( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   p_ctx->priv->module->fragmented = true;
+   return mp4_read_boxes( p_ctx, size, MP4_BOX_TYPE_MVEX);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_mehd( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   uint32_t version;
+   int64_t duration;
+
+   version = MP4_READ_U8(p_ctx, "version");
+   MP4_SKIP_U24(p_ctx, "flags");
+   if(version) duration = MP4_READ_U64(p_ctx, "fragment_duration");
+   else duration = MP4_READ_U32(p_ctx, "fragment_duration");
+
+   if(!p_ctx->duration && module->timescale)
+      p_ctx->duration = duration * 1000000 / module->timescale;
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_trex( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   uint32_t track_id, duration, sample_size, flags;
+
+   MP4_SKIP_U8(p_ctx, "version");
+   MP4_SKIP_U24(p_ctx, "flags");
+   track_id = MP4_READ_U32(p_ctx, "track_ID");
+   MP4_SKIP_U32(p_ctx, "default_sample_description_index");
+   duration = MP4_READ_U32(p_ctx, "default_sample_duration");
+   sample_size = MP4_READ_U32(p_ctx, "default_sample_size");
+   flags = MP4_READ_U32(p_ctx, "default_sample_flags");
+
+   track_module = mp4_find_track(p_ctx, track_id);
+   if(track_module)
+   {
+      track_module->fragment.default_duration = duration;
+      track_module->fragment.default_size = sample_size;
+      track_module->fragment.default_flags = flags;
+   }
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_sidx( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   uint32_t version, track_id, timescale, i, count, reference, duration;
+   int64_t offset = STREAM_POSITION(p_ctx) + size, time;
+
+   if(module->fragment.index_complete || !p_ctx->tracks_num)
+      return VC_CONTAINER_SUCCESS;
+
+   version = MP4_READ_U8(p_ctx, "version");
+   MP4_SKIP_U24(p_ctx, "flags");
+   track_id = MP4_READ_U32(p_ctx, "reference_ID");
+   timescale = MP4_READ_U32(p_ctx, "timescale");
+   if(version)
+   {
+      time = MP4_READ_U64(p_ctx, "earliest_presentation_time");
+      offset += MP4_READ_U64(p_ctx, "first_offset");
+   }
+   else
+   {
+      time = MP4_READ_U32(p_ctx, "earliest_presentation_time");
+      offset += MP4_READ_U32(p_ctx, "first_offset");
+   }
+   MP4_SKIP_U16(p_ctx, "reserved");
+   count = MP4_READ_U16(p_ctx, "reference_count");
+
+   /* Only the segment index of the reference track is of any use for seeking */
+   track_module = p_ctx->tracks[mp4_fragment_ref_track(p_ctx)]->priv->module;
+   if(track_id != track_module->track_id || !timescale || !track_module->timescale)
+      return STREAM_STATUS(p_ctx);
+   if(count > size / 12) return VC_CONTAINER_ERROR_CORRUPTED;
+
+   for(i = 0; i < count; i++)
+   {
+      reference = MP4_READ_U32(p_ctx, "referenced_size");
+      duration = MP4_READ_U32(p_ctx, "subsegment_duration");
+      MP4_SKIP_U32(p_ctx, "SAP");
+      if(STREAM_STATUS(p_ctx) != VC_CONTAINER_SUCCESS) break;
+
+      /* Hierarchical indexes aren't supported, we'll fall back to scanning the fragments */
+      if(reference >> 31) return VC_CONTAINER_SUCCESS;
+
+      if(mp4_fragment_index_add(p_ctx, offset, time * track_module->timescale / timescale))
+         return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      offset += reference & 0x7FFFFFFF;
+      time += duration;
+   }
+
+   /* Check whether the index covers the whole file */
+   if(count && p_ctx->priv->io->size > 0 && offset >= p_ctx->priv->io->size)
+   {
+      module->fragment.index_complete = true;
+      if(!p_ctx->duration) p_ctx->duration = time * 1000000 / timescale;
+   }
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_moof( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   module->fragment.moof_offset = module->box_offset;
+   module->fragment.data_end = module->box_offset;
+   return mp4_read_boxes( p_ctx, size, MP4_BOX_TYPE_MOOF);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_traf( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+
+   module->fragment.track = 0;
+   status = mp4_read_boxes( p_ctx, size, MP4_BOX_TYPE_TRAF);
+   module->fragment.track = 0;
+   return status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_tfhd( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   uint32_t flags;
+
+   MP4_SKIP_U8(p_ctx, "version");
+   flags = MP4_READ_U24(p_ctx, "flags");
+   track_module = mp4_find_track(p_ctx, MP4_READ_U32(p_ctx, "track_ID"));
+
+   /* The data of the first track fragment starts by default at the moof box and the one
+    * of the following track fragments where the data of the previous one ended */
+   if(flags & MP4_TFHD_BASE_DATA_OFFSET_PRESENT)
+      module->fragment.base_offset = MP4_READ_U64(p_ctx, "base_data_offset");
+   else if(flags & MP4_TFHD_DEFAULT_BASE_IS_MOOF)
+      module->fragment.base_offset = module->fragment.moof_offset;
+   else
+      module->fragment.base_offset = module->fragment.data_end;
+   module->fragment.data_offset = module->fragment.base_offset;
+
+   if(flags & MP4_TFHD_SAMPLE_DESCRIPTION_INDEX_PRESENT)
+      MP4_SKIP_U32(p_ctx, "sample_description_index");
+
+   module->fragment.default_duration = track_module ? track_module->fragment.default_duration : 0;
+   module->fragment.default_size = track_module ? track_module->fragment.default_size : 0;
+   module->fragment.default_flags = track_module ? track_module->fragment.default_flags : 0;
+   if(flags & MP4_TFHD_DEFAULT_SAMPLE_DURATION_PRESENT)
+      module->fragment.default_duration = MP4_READ_U32(p_ctx, "default_sample_duration");
+   if(flags & MP4_TFHD_DEFAULT_SAMPLE_SIZE_PRESENT)
+      module->fragment.default_size = MP4_READ_U32(p_ctx, "default_sample_size");
+   if(flags & MP4_TFHD_DEFAULT_SAMPLE_FLAGS_PRESENT)
+      module->fragment.default_flags = MP4_READ_U32(p_ctx, "default_sample_flags");
+
+   module->fragment.track = track_module;
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_tfdt( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->priv->module->fragment.track;
+   uint32_t version;
+   int64_t dts;
+
+   version = MP4_READ_U8(p_ctx, "version");
+   MP4_SKIP_U24(p_ctx, "flags");
+   if(version) dts = MP4_READ_U64(p_ctx, "baseMediaDecodeTime");
+   else dts = MP4_READ_U32(p_ctx, "baseMediaDecodeTime");
+
+   if(track_module && STREAM_STATUS(p_ctx) == VC_CONTAINER_SUCCESS)
+      track_module->fragment.dts = dts;
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+/** Make room in the queue of samples of a track for the given number of new samples.
+ * If the queue would grow too big, the oldest samples are dropped. */
+static VC_CONTAINER_STATUS_T mp4_fragment_queue_reserve( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_TRACK_MODULE_T *track_module, unsigned int count )
+{
+   unsigned int max = track_module->fragment.max, drop;
+   MP4_FRAGMENT_SAMPLE_T *samples;
+
+   if(track_module->fragment.num + count > MP4_FRAGMENT_SAMPLES_MAX)
+   {
+      drop = MIN(track_module->fragment.num, track_module->fragment.num + count - MP4_FRAGMENT_SAMPLES_MAX);
+      LOG_DEBUG(p_ctx, "dropping %u queued samples", drop);
+      memmove(track_module->fragment.samples, track_module->fragment.samples + drop,
+              (track_module->fragment.num - drop) * sizeof(*samples));
+      track_module->fragment.num -= drop;
+      track_module->fragment.index -= MIN(track_module->fragment.index, drop);
+   }
+
+   if(track_module->fragment.num + count <= max)
+      return VC_CONTAINER_SUCCESS;
+
+   while(max < track_module->fragment.num + count)
+      max = MAX(max * 2, MP4_FRAGMENT_SAMPLES_MIN);
+   samples = realloc(track_module->fragment.samples, max * sizeof(*samples));
+   if(!samples) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   track_module->fragment.samples = samples;
+   track_module->fragment.max = max;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_trun( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = module->fragment.track;
+   VC_CONTAINER_STATUS_T status;
+   uint32_t flags, count, first_flags = 0, i, j, entry_size, entries;
+   MP4_FRAGMENT_SAMPLE_T sample, *samples = 0;
+   uint8_t buffer[MP4_TRUN_BUFFER_SIZE];
+   int64_t offset;
+
+   MP4_SKIP_U8(p_ctx, "version");
+   flags = MP4_READ_U24(p_ctx, "flags");
+   count = MP4_READ_U32(p_ctx, "sample_count");
+   offset = module->fragment.data_offset;
+   if(flags & MP4_TRUN_DATA_OFFSET_PRESENT)
+      offset = module->fragment.base_offset + (int32_t)MP4_READ_U32(p_ctx, "data_offset");
+   if(flags & MP4_TRUN_FIRST_SAMPLE_FLAGS_PRESENT)
+      first_flags = MP4_READ_U32(p_ctx, "first_sample_flags");
+
+   status = STREAM_STATUS(p_ctx);
+   if(status != VC_CONTAINER_SUCCESS || !track_module) return status;
+
+   entry_size = 4 * (!!(flags & MP4_TRUN_SAMPLE_DURATION_PRESENT) +
+      !!(flags & MP4_TRUN_SAMPLE_SIZE_PRESENT) + !!(flags & MP4_TRUN_SAMPLE_FLAGS_PRESENT) +
+      !!(flags & MP4_TRUN_SAMPLE_COMPOSITION_TIME_OFFSETS_PRESENT));
+   if((entry_size && count > size / entry_size) || count > MP4_FRAGMENT_SAMPLES_MAX)
+      return VC_CONTAINER_ERROR_CORRUPTED;
+
+   if(!module->fragment.index_only)
+   {
+      status = mp4_fragment_queue_reserve(p_ctx, track_module, count);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+      samples = track_module->fragment.samples + track_module->fragment.num;
+   }
+
+   /* That's the first sample of the reference track in this fragment */
+   if(module->fragment.ref_dts < 0 &&
+      track_module == p_ctx->tracks[mp4_fragment_ref_track(p_ctx)]->priv->module)
+      module->fragment.ref_dts = track_module->fragment.dts;
+
+   /* The sample entries are read in batches rather than field by field */
+   sample.duration = module->fragment.default_duration;
+   sample.size = module->fragment.default_size;
+   sample.composition_offset = 0;
+   for(i = 0; i < count; i += entries)
+   {
+      const uint8_t *entry = buffer;
+
+      entries = entry_size ? MIN(count - i, sizeof(buffer) / entry_size) : count - i;
+      if(entry_size && MP4_READ_BYTES(p_ctx, buffer, entries * entry_size) != entries * entry_size)
+         return STREAM_STATUS(p_ctx);
+
+      for(j = 0; j < entries; j++)
+      {
+         uint32_t sample_flags = module->fragment.default_flags;
+         if(i + j == 0 && (flags & MP4_TRUN_FIRST_SAMPLE_FLAGS_PRESENT))
+            sample_flags = first_flags;
+
+         if(flags & MP4_TRUN_SAMPLE_DURATION_PRESENT)
+            { sample.duration = MP4_BE32(entry); entry += 4; }
+         if(flags & MP4_TRUN_SAMPLE_SIZE_PRESENT)
+            { sample.size = MP4_BE32(entry); entry += 4; }
+         if(flags & MP4_TRUN_SAMPLE_FLAGS_PRESENT)
+            { sample_flags = MP4_BE32(entry); entry += 4; }
+         if(flags & MP4_TRUN_SAMPLE_COMPOSITION_TIME_OFFSETS_PRESENT)
+            { sample.composition_offset = (int32_t)MP4_BE32(entry); entry += 4; }
+
+         sample.offset = offset;
+         sample.dts = track_module->fragment.dts;
+         sample.sync = !(sample_flags & MP4_SAMPLE_FLAG_IS_NON_SYNC);
+         if(samples) *samples++ = sample;
+
+         offset += sample.size;
+         track_module->fragment.dts += sample.duration;
+      }
+   }
+
+   if(samples) track_module->fragment.num += count;
+   module->fragment.data_offset = module->fragment.data_end = offset;
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_mfra( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   return mp4_read_boxes( p_ctx, size, MP4_BOX_TYPE_MFRA);
+}
+
+/*****************************************************************************/
+static uint32_t mp4_read_tfra_number( VC_CONTAINER_T *p_ctx, unsigned int length )
+{
+   switch(length)
+   {
+   case 0: return READ_U8(p_ctx, "number");
+   case 1: return READ_U16(p_ctx, "number");
+   case 2: return READ_U24(p_ctx, "number");
+   default: return READ_U32(p_ctx, "number");
+   }
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_box_tfra( VC_CONTAINER_T *p_ctx, int64_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   MP4_FRAGMENT_INDEX_T *index;
+   uint32_t version, track_id, lengths, count, i, num = 0, entry_size;
+   uint32_t traf_number, trun_number, sample_number;
+   int64_t time, offset;
+
+   version = MP4_READ_U8(p_ctx, "version");
+   MP4_SKIP_U24(p_ctx, "flags");
+   track_id = MP4_READ_U32(p_ctx, "track_ID");
+   lengths = MP4_READ_U32(p_ctx, "length_size_of_traf_trun_sample_num");
+   count = MP4_READ_U32(p_ctx, "number_of_entry");
+
+   track_module = p_ctx->tracks[mp4_fragment_ref_track(p_ctx)]->priv->module;
+   if(track_id != track_module->track_id || !count)
+      return STREAM_STATUS(p_ctx);
+
+   entry_size = (version ? 16 : 8) + ((lengths >> 4) & 3) + ((lengths >> 2) & 3) + (lengths & 3) + 3;
+   if(count > size / entry_size) return VC_CONTAINER_ERROR_CORRUPTED;
+
+   index = malloc(count * sizeof(*index));
+   if(!index) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+
+   for(i = 0; i < count; i++)
+   {
+      if(version)
+      {
+         time = READ_U64(p_ctx, "time");
+         offset = READ_U64(p_ctx, "moof_offset");
+      }
+      else
+      {
+         time = READ_U32(p_ctx, "time");
+         offset = READ_U32(p_ctx, "moof_offset");
+      }
+      traf_number = mp4_read_tfra_number(p_ctx, (lengths >> 4) & 3);
+      trun_number = mp4_read_tfra_number(p_ctx, (lengths >> 2) & 3);
+      sample_number = mp4_read_tfra_number(p_ctx, lengths & 3);
+      if(STREAM_STATUS(p_ctx) != VC_CONTAINER_SUCCESS) break;
+
+      /* Only the random access points starting a fragment give us the decoding
+       * time of the fragment */
+      if(traf_number != 1 || trun_number != 1 || sample_number != 1) continue;
+      if(num && offset <= index[num - 1].offset) continue;
+      index[num].offset = offset;
+      index[num].time = time;
+      num++;
+   }
+   if(num)
+   {
+      free(module->fragment.index);
+      module->fragment.index = index;
+      module->fragment.index_num = module->fragment.index_max = num;
+      module->fragment.index_complete = true;
+   }
+   else free(index);
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static void mp4_seek_index_free( VC_CONTAINER_T *p_ctx, VC_CONTAINER_TRACK_MODULE_T *track_module )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   free(track_module->seek_index.stts);
+   free(track_module->seek_index.ctts);
+   free(track_module->seek_index.stsc);
+   free(track_module->seek_index.stss);
+   module->seek_index.size -= track_module->seek_index.size;
+   memset(&track_module->seek_index, 0, sizeof(track_module->seek_index));
+}
+
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T mp4_reader_close( VC_CONTAINER_T *p_ctx )
 {
@@ -1204,11 +1793,37 @@ static VC_CONTAINER_STATUS_T mp4_reader_close( VC_CONTAINER_T *p_ctx )
    unsigned int i;
 
    for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      mp4_seek_index_free(p_ctx, p_ctx->tracks[i]->priv->module);
+      free(p_ctx->tracks[i]->priv->module->fragment.samples);
       vc_container_free_track(p_ctx, p_ctx->tracks[i]);
+   }
+   free(module->fragment.index);
    free(module);
    return VC_CONTAINER_SUCCESS;
 }
 
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_reader_control( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_CONTROL_T operation, va_list args )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   unsigned int i;
+
+   switch(operation)
+   {
+   case VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE:
+      module->seek_index.max_size = va_arg(args, uint32_t);
+      /* The indexes will be rebuilt within the new limit when next needed */
+      for(i = 0; i < p_ctx->tracks_num; i++)
+         mp4_seek_index_free(p_ctx, p_ctx->tracks[i]->priv->module);
+      return VC_CONTAINER_SUCCESS;
+
+   default:
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   }
+}
+
 /*****************************************************************************/
 #ifdef ENABLE_MP4_READER_LOG_STATE
 static void mp4_log_state( VC_CONTAINER_T *p_ctx, MP4_READER_STATE_T *state )
@@ -1342,37 +1957,85 @@ static VC_CONTAINER_STATUS_T mp4_read_sample_table( VC_CONTAINER_T *p_ctx,
 }
 
 /*****************************************************************************/
-static VC_CONTAINER_STATUS_T mp4_read_sample_header( VC_CONTAINER_T *p_ctx, uint32_t track,
+static VC_CONTAINER_STATUS_T mp4_read_fragment_sample_header( VC_CONTAINER_T *p_ctx, uint32_t track,
    MP4_READER_STATE_T *state )
 {
    VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[track]->priv->module;
+   MP4_FRAGMENT_SAMPLE_T *sample;
 
    if(state->status != VC_CONTAINER_SUCCESS) return state->status;
 
    if(state->sample_offset < state->sample_size)
       return state->status; /* We still have data left from the current sample */
 
-   /* Switch to the next sample */
-   state->offset += state->sample_size;
    state->sample_offset = 0;
    state->sample_size = 0;
+
+   /* We need to wait for the next fragment to be parsed */
+   if(track_module->fragment.index >= track_module->fragment.num)
+      return state->status = VC_CONTAINER_ERROR_CONTINUE;
+
+   sample = &track_module->fragment.samples[track_module->fragment.index++];
+   state->offset = sample->offset;
+   state->sample_size = sample->size;
+   state->keyframe = sample->sync;
    state->sample++;
+   if(track_module->timescale)
+   {
+      state->dts = sample->dts * 1000000 / track_module->timescale;
+      state->pts = (sample->dts + sample->composition_offset) * 1000000 / track_module->timescale;
+   }
 
-   if(!state->samples_in_chunk)
+   /* Try to batch several contiguous samples together if requested */
+   while(track_module->samples_batch_size && state->sample_size < track_module->samples_batch_size &&
+         track_module->fragment.index < track_module->fragment.num &&
+         sample[1].offset == sample->offset + sample->size)
    {
-      /* We're switching to the next chunk */
-      if(!state->chunks)
-      {
-         /* Seek to the next entry in the STSC */
-         state->status = mp4_read_sample_table( p_ctx, track_module, state, MP4_SAMPLE_TABLE_STSC, 1 );
-         if(state->status != VC_CONTAINER_SUCCESS) goto error;
-      }
+      sample++;
+      state->sample_size += sample->size;
+      track_module->fragment.index++;
+      state->sample++;
+   }
 
-      /* Get the offset of the new chunk */
-      state->status = mp4_read_sample_table( p_ctx, track_module, state, MP4_SAMPLE_TABLE_STCO, 1 );
-      if(state->status != VC_CONTAINER_SUCCESS) goto error;
+   return state->status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_read_sample_header( VC_CONTAINER_T *p_ctx, uint32_t track,
+   MP4_READER_STATE_T *state )
+{
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[track]->priv->module;
+
+   if(state->status != VC_CONTAINER_SUCCESS) return state->status;
+
+   if(p_ctx->priv->module->fragmented)
+      return mp4_read_fragment_sample_header(p_ctx, track, state);
+
+   if(state->sample_offset < state->sample_size)
+      return state->status; /* We still have data left from the current sample */
+
+   /* Switch to the next sample */
+   state->offset += state->sample_size;
+   state->sample_offset = 0;
+   state->sample_size = 0;
+   state->sample++;
+
+   if(!state->samples_in_chunk)
+   {
+      /* We're switching to the next chunk */
+      if(!state->chunks)
+      {
+         /* Seek to the next entry in the STSC */
+         state->status = mp4_read_sample_table( p_ctx, track_module, state, MP4_SAMPLE_TABLE_STSC, 1 );
+         if(state->status != VC_CONTAINER_SUCCESS) goto error;
+      }
+
+      /* Get the offset of the new chunk */
+      state->status = mp4_read_sample_table( p_ctx, track_module, state, MP4_SAMPLE_TABLE_STCO, 1 );
+      if(state->status != VC_CONTAINER_SUCCESS) goto error;
 
       state->chunks--;
+      p_ctx->priv->module->prefetch_hint = true;
    }
    state->samples_in_chunk--;
 
@@ -1450,7 +2113,7 @@ static VC_CONTAINER_STATUS_T mp4_read_sample_header( VC_CONTAINER_T *p_ctx, uint
 
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T mp4_read_sample_data( VC_CONTAINER_T *p_ctx, uint32_t track,
-   MP4_READER_STATE_T *state, uint8_t *data, unsigned int *data_size )
+   MP4_READER_STATE_T *state, uint8_t **data, unsigned int *data_size, const uint8_t **borrowed )
 {
    VC_CONTAINER_STATUS_T status;
    unsigned int size = state->sample_size - state->sample_offset;
@@ -1464,13 +2127,21 @@ static VC_CONTAINER_STATUS_T mp4_read_sample_data( VC_CONTAINER_T *p_ctx, uint32
       state->status = SEEK(p_ctx, state->offset + state->sample_offset);
       if(state->status != VC_CONTAINER_SUCCESS) return state->status;
 
-      size = READ_BYTES(p_ctx, data, size);
+      /* Point straight at the sample if the i/o has it in memory */
+      if(borrowed) *borrowed = BORROW_BYTES(p_ctx, size);
+      if(!borrowed || !*borrowed) size = READ_BYTES(p_ctx, *data, size);
    }
    state->sample_offset += size;
 
    if(data_size) *data_size = size;
    state->status = STREAM_STATUS(p_ctx);
-   if(state->status != VC_CONTAINER_SUCCESS) return state->status;
+   if(state->status != VC_CONTAINER_SUCCESS)
+   {
+      /* The end of a fragment might not have been written yet so make sure the
+       * sample is read again from the same point once more data is available */
+      if(p_ctx->priv->module->fragmented) state->sample_offset -= size;
+      return state->status;
+   }
 
    status = state->status;
 
@@ -1481,6 +2152,169 @@ static VC_CONTAINER_STATUS_T mp4_read_sample_data( VC_CONTAINER_T *p_ctx, uint32
    return status;
 }
 
+/*****************************************************************************/
+/** Let the i/o know where the data of each track is going to be read from next so
+ * it can be read ahead. The rest of the current chunk of each track is hinted at. */
+static void mp4_hint_prefetch( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_IO_RANGE_T ranges[MP4_TRACKS_MAX];
+   unsigned int i, num_ranges = 0;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[i]->priv->module;
+      MP4_READER_STATE_T *state = &track_module->state;
+      if(state->status != VC_CONTAINER_SUCCESS) continue;
+
+      ranges[num_ranges].offset = state->offset + state->sample_offset;
+      ranges[num_ranges].size = (int64_t)state->sample_size * (state->samples_in_chunk + 1) -
+         state->sample_offset;
+
+      /* With movie fragments, that's the rest of the samples queued for the track */
+      if(p_ctx->priv->module->fragmented && track_module->fragment.num)
+      {
+         MP4_FRAGMENT_SAMPLE_T *last = &track_module->fragment.samples[track_module->fragment.num - 1];
+         if(last->offset + last->size > ranges[num_ranges].offset)
+            ranges[num_ranges].size = last->offset + last->size - ranges[num_ranges].offset;
+      }
+      num_ranges++;
+   }
+
+   vc_container_io_control(p_ctx->priv->io, VC_CONTAINER_CONTROL_IO_PREFETCH_RANGES,
+                           num_ranges, ranges);
+}
+
+/*****************************************************************************/
+/** Parse the next movie fragment and queue its samples. In index only mode, only
+ * the timing of the fragment is worked out (to build the fragment index). */
+static VC_CONTAINER_STATUS_T mp4_read_fragment( VC_CONTAINER_T *p_ctx, bool index_only )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   VC_CONTAINER_STATUS_T status;
+   int64_t start = module->fragment.next_offset, end, dts[MP4_TRACKS_MAX];
+   unsigned int i, num[MP4_TRACKS_MAX];
+   MP4_FRAGMENT_INDEX_T *last;
+   MP4_BOX_TYPE_T box_type;
+   int64_t box_size;
+
+   /* Find the next moof box */
+   while(1)
+   {
+      status = SEEK(p_ctx, module->fragment.next_offset);
+      if(status == VC_CONTAINER_SUCCESS)
+         status = mp4_read_box_header( p_ctx, INT64_C(-1), &box_type, &box_size );
+      if(status != VC_CONTAINER_SUCCESS)
+         return STREAM_STATUS(p_ctx) != VC_CONTAINER_SUCCESS ? VC_CONTAINER_ERROR_EOS : status;
+
+      end = STREAM_POSITION(p_ctx) + box_size;
+      if(box_type == MP4_BOX_TYPE_MOOF) break;
+      if(box_type == MP4_BOX_TYPE_MFRA) return VC_CONTAINER_ERROR_EOS;
+      if(box_type == MP4_BOX_TYPE_SIDX)
+      {
+         status = mp4_read_box_data( p_ctx, box_type, box_size, MP4_BOX_TYPE_ROOT );
+         if(status != VC_CONTAINER_SUCCESS) return status;
+      }
+      module->fragment.next_offset = end;
+   }
+
+   /* Get rid of the samples which have already been read and remember where the
+    * queues were in case the fragment isn't complete yet */
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      track_module = p_ctx->tracks[i]->priv->module;
+      if(track_module->fragment.index)
+      {
+         memmove(track_module->fragment.samples,
+                 track_module->fragment.samples + track_module->fragment.index,
+                 (track_module->fragment.num - track_module->fragment.index) *
+                    sizeof(*track_module->fragment.samples));
+         track_module->fragment.num -= track_module->fragment.index;
+         track_module->fragment.index = 0;
+      }
+      num[i] = track_module->fragment.num;
+      dts[i] = track_module->fragment.dts;
+   }
+
+   module->fragment.index_only = index_only;
+   module->fragment.ref_dts = -1;
+   status = mp4_read_box_data( p_ctx, box_type, box_size, MP4_BOX_TYPE_ROOT );
+   module->fragment.index_only = false;
+   if(status != VC_CONTAINER_SUCCESS)
+   {
+      /* Forget about the incomplete fragment, we'll start from the same point next time */
+      for(i = 0; i < p_ctx->tracks_num; i++)
+      {
+         p_ctx->tracks[i]->priv->module->fragment.num = num[i];
+         p_ctx->tracks[i]->priv->module->fragment.dts = dts[i];
+      }
+      return STREAM_STATUS(p_ctx) != VC_CONTAINER_SUCCESS ? VC_CONTAINER_ERROR_EOS : status;
+   }
+   module->fragment.next_offset = end;
+   module->prefetch_hint = true;
+
+   /* Extend the fragment index if this fragment directly follows the last one indexed */
+   if(module->fragment.index_complete || !p_ctx->tracks_num)
+      return VC_CONTAINER_SUCCESS;
+   if(module->fragment.ref_dts < 0)
+      module->fragment.ref_dts =
+         p_ctx->tracks[mp4_fragment_ref_track(p_ctx)]->priv->module->fragment.dts;
+   last = module->fragment.index_num ? &module->fragment.index[module->fragment.index_num - 1] : 0;
+   if(!last || (module->fragment.index_tail && module->fragment.moof_offset > last->offset))
+   {
+      module->fragment.index_tail = true;
+      return mp4_fragment_index_add(p_ctx, module->fragment.moof_offset, module->fragment.ref_dts);
+   }
+   module->fragment.index_tail = start <= last->offset && last->offset <= module->fragment.moof_offset;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Make sure a sample is ready to be read, parsing new movie fragments if necessary.
+ * If a track is specified, it is the one which needs a sample. */
+static VC_CONTAINER_STATUS_T mp4_read_fragment_samples( VC_CONTAINER_T *p_ctx, int track )
+{
+   VC_CONTAINER_STATUS_T status;
+   unsigned int i;
+   bool ready;
+
+   if(track >= (int)p_ctx->tracks_num) return VC_CONTAINER_ERROR_INVALID_ARGUMENT;
+
+   while(1)
+   {
+      for(i = 0, ready = false; i < p_ctx->tracks_num; i++)
+      {
+         VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[i]->priv->module;
+         MP4_READER_STATE_T *state = &track_module->state;
+
+         /* Wake up the tracks for which new samples have been queued or which
+          * failed half way through a sample */
+         if(state->status != VC_CONTAINER_SUCCESS && state->sample_offset < state->sample_size)
+         {
+            state->status = VC_CONTAINER_SUCCESS;
+         }
+         else if(state->status != VC_CONTAINER_SUCCESS &&
+            track_module->fragment.index < track_module->fragment.num)
+         {
+            state->status = VC_CONTAINER_SUCCESS;
+            mp4_read_fragment_sample_header(p_ctx, i, state);
+         }
+
+         if(state->status == VC_CONTAINER_SUCCESS && (track < 0 || (int)i == track))
+            ready = true;
+      }
+      if(ready) return VC_CONTAINER_SUCCESS;
+
+      status = mp4_read_fragment(p_ctx, false);
+      if(status != VC_CONTAINER_SUCCESS) break;
+   }
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+      if(p_ctx->tracks[i]->priv->module->state.status == VC_CONTAINER_ERROR_CONTINUE)
+         p_ctx->tracks[i]->priv->module->state.status = status;
+   return status;
+}
+
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T mp4_reader_read( VC_CONTAINER_T *p_ctx,
                                               VC_CONTAINER_PACKET_T *packet, uint32_t flags )
@@ -1493,6 +2327,14 @@ static VC_CONTAINER_STATUS_T mp4_reader_read( VC_CONTAINER_T *p_ctx,
    uint8_t *data = 0;
    int64_t offset;
 
+   /* Make sure the samples of the next movie fragment are available */
+   if(p_ctx->priv->module->fragmented)
+   {
+      status = mp4_read_fragment_samples(p_ctx, (flags & VC_CONTAINER_READ_FLAG_FORCE_TRACK) ?
+                                         (int)packet->track : -1);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
    /* Select the track to read from. If no specific track is requested by the caller, this
     * will be the track to which the next bit of data in the mdat belongs to */
    if(!(flags & VC_CONTAINER_READ_FLAG_FORCE_TRACK))
@@ -1519,8 +2361,14 @@ static VC_CONTAINER_STATUS_T mp4_reader_read( VC_CONTAINER_T *p_ctx,
    status = mp4_read_sample_header(p_ctx, track, state);
    if(status != VC_CONTAINER_SUCCESS) return status;
 
+   if(p_ctx->priv->module->prefetch_hint)
+   {
+      p_ctx->priv->module->prefetch_hint = false;
+      mp4_hint_prefetch(p_ctx);
+   }
+
    if(!packet) /* Skip packet */
-      return mp4_read_sample_data(p_ctx, track, state, 0, 0);
+      return mp4_read_sample_data(p_ctx, track, state, 0, 0, 0);
 
    packet->dts = state->dts;
    packet->pts = state->pts;
@@ -1532,14 +2380,15 @@ static VC_CONTAINER_STATUS_T mp4_reader_read( VC_CONTAINER_T *p_ctx,
    packet->size = state->sample_size - state->sample_offset;
 
    if(flags & VC_CONTAINER_READ_FLAG_SKIP)
-      return mp4_read_sample_data(p_ctx, track, state, 0, 0);
+      return mp4_read_sample_data(p_ctx, track, state, 0, 0, 0);
    else if((flags & VC_CONTAINER_READ_FLAG_INFO) || !packet->data)
       return VC_CONTAINER_SUCCESS;
 
    data = packet->data;
    data_size = packet->buffer_size;
 
-   status = mp4_read_sample_data(p_ctx, track, state, data, &data_size);
+   status = mp4_read_sample_data(p_ctx, track, state, &data, &data_size,
+      (flags & VC_CONTAINER_READ_FLAG_ZERO_COPY) ? &packet->borrowed : 0);
    if(status != VC_CONTAINER_SUCCESS)
    {
       /* FIXME */
@@ -1553,6 +2402,344 @@ static VC_CONTAINER_STATUS_T mp4_reader_read( VC_CONTAINER_T *p_ctx,
    return status;
 }
 
+/*****************************************************************************/
+/** Read a batch of entries of a sample table in one go */
+static VC_CONTAINER_STATUS_T mp4_read_table_entries( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_TRACK_MODULE_T *track_module, MP4_SAMPLE_TABLE_T table,
+   uint32_t entry, uint32_t num, uint8_t *buffer )
+{
+   size_t size = num * track_module->sample_table[table].entry_size;
+   VC_CONTAINER_STATUS_T status;
+
+   status = SEEK(p_ctx, track_module->sample_table[table].offset +
+                 (int64_t)track_module->sample_table[table].entry_size * entry);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   if(READ_BYTES(p_ctx, buffer, size) != size)
+      return STREAM_STATUS(p_ctx) != VC_CONTAINER_SUCCESS ?
+         STREAM_STATUS(p_ctx) : VC_CONTAINER_ERROR_CORRUPTED;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Build the seek index of a track by reading its sample tables once.
+ * Runs of samples are stored along with the time / sample number they start at
+ * so that seeking only involves binary searches instead of walking the tables.
+ * Tables which don't make sense are left to the code walking the tables. */
+static VC_CONTAINER_STATUS_T mp4_seek_index_build( VC_CONTAINER_T *p_ctx, uint32_t track )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[track]->priv->module;
+   uint32_t stts_entries = track_module->sample_table[MP4_SAMPLE_TABLE_STTS].entries;
+   uint32_t ctts_entries = track_module->sample_table[MP4_SAMPLE_TABLE_CTTS].entries;
+   uint32_t stsc_entries = track_module->sample_table[MP4_SAMPLE_TABLE_STSC].entries;
+   uint32_t stss_entries = track_module->sample_table[MP4_SAMPLE_TABLE_STSS].entries;
+   MP4_INDEX_STTS_T *stts = 0, *runs;
+   MP4_INDEX_CTTS_T *ctts = 0, *comp_runs;
+   MP4_INDEX_STSC_T *stsc = 0;
+   uint32_t *stss = 0;
+   uint8_t buffer[MP4_INDEX_BUFFER_ENTRIES * 12];
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   uint32_t i, j, batch, stts_num = 0, ctts_num = 0, sample;
+   int64_t time;
+   uint64_t size;
+
+   track_module->seek_index.failed = true; /* Until proven otherwise */
+
+   /* Check the worst case against the memory we're allowed to use */
+   size = (uint64_t)stts_entries * sizeof(*stts) + (uint64_t)ctts_entries * sizeof(*ctts) +
+      (uint64_t)stsc_entries * sizeof(*stsc) + (uint64_t)stss_entries * sizeof(*stss);
+   if(!stts_entries || module->seek_index.size + size > module->seek_index.max_size)
+   {
+      LOG_DEBUG(p_ctx, "no seek index for track %u (%u bytes needed)", track, (unsigned int)size);
+      return VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+   }
+
+   stts = malloc(stts_entries * sizeof(*stts));
+   if(ctts_entries) ctts = malloc(ctts_entries * sizeof(*ctts));
+   if(stsc_entries) stsc = malloc(stsc_entries * sizeof(*stsc));
+   if(stss_entries) stss = malloc(stss_entries * sizeof(*stss));
+   status = VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   if(!stts || (ctts_entries && !ctts) || (stsc_entries && !stsc) || (stss_entries && !stss))
+      goto error;
+
+   /* Decoding times, merging consecutive entries with the same duration */
+   for(i = 0, sample = 0, time = 0; i < stts_entries; i += batch)
+   {
+      batch = MIN(stts_entries - i, MP4_INDEX_BUFFER_ENTRIES);
+      status = mp4_read_table_entries(p_ctx, track_module, MP4_SAMPLE_TABLE_STTS, i, batch, buffer);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+
+      for(j = 0; j < batch; j++)
+      {
+         uint32_t count = MP4_BE32(buffer + j * 8), delta = MP4_BE32(buffer + j * 8 + 4);
+         status = VC_CONTAINER_ERROR_CORRUPTED;
+         if(!count) goto error;
+
+         if(!stts_num || stts[stts_num - 1].delta != delta)
+         {
+            stts[stts_num].time = time;
+            stts[stts_num].sample = sample;
+            stts[stts_num].delta = delta;
+            stts[stts_num++].entry = i + j;
+         }
+         sample += count;
+         time += (int64_t)count * delta;
+      }
+   }
+   track_module->seek_index.samples = sample;
+   track_module->seek_index.duration = time;
+
+   /* Composition offsets, merged the same way */
+   for(i = 0, sample = 0; i < ctts_entries; i += batch)
+   {
+      batch = MIN(ctts_entries - i, MP4_INDEX_BUFFER_ENTRIES);
+      status = mp4_read_table_entries(p_ctx, track_module, MP4_SAMPLE_TABLE_CTTS, i, batch, buffer);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+
+      for(j = 0; j < batch; j++)
+      {
+         uint32_t count = MP4_BE32(buffer + j * 8);
+         int32_t offset = (int32_t)MP4_BE32(buffer + j * 8 + 4);
+         status = VC_CONTAINER_ERROR_CORRUPTED;
+         if(!count) goto error;
+
+         if(!ctts_num || ctts[ctts_num - 1].offset != offset)
+         {
+            ctts[ctts_num].sample = sample;
+            ctts[ctts_num].offset = offset;
+            ctts[ctts_num++].entry = i + j;
+         }
+         sample += count;
+      }
+   }
+   track_module->seek_index.ctts_samples = sample;
+
+   /* Chunks, with the number of samples before each entry */
+   for(i = 0; i < stsc_entries; i += batch)
+   {
+      batch = MIN(stsc_entries - i, MP4_INDEX_BUFFER_ENTRIES);
+      status = mp4_read_table_entries(p_ctx, track_module, MP4_SAMPLE_TABLE_STSC, i, batch, buffer);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+
+      for(j = 0; j < batch; j++)
+      {
+         stsc[i + j].first_chunk = MP4_BE32(buffer + j * 12);
+         stsc[i + j].samples_per_chunk = MP4_BE32(buffer + j * 12 + 4);
+      }
+   }
+   for(i = 0; i < stsc_entries; i++)
+   {
+      status = VC_CONTAINER_ERROR_CORRUPTED;
+      if(!stsc[i].first_chunk || !stsc[i].samples_per_chunk) goto error;
+      if(!i) { stsc[i].sample = 0; continue; }
+      if(stsc[i].first_chunk <= stsc[i - 1].first_chunk) goto error;
+      stsc[i].sample = stsc[i - 1].sample +
+         (stsc[i].first_chunk - stsc[i - 1].first_chunk) * stsc[i - 1].samples_per_chunk;
+   }
+
+   /* Sync samples, which need to be in order for the binary searches */
+   for(i = 0; i < stss_entries; i += batch)
+   {
+      batch = MIN(stss_entries - i, MP4_INDEX_BUFFER_ENTRIES);
+      status = mp4_read_table_entries(p_ctx, track_module, MP4_SAMPLE_TABLE_STSS, i, batch, buffer);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+
+      for(j = 0; j < batch; j++)
+      {
+         stss[i + j] = MP4_BE32(buffer + j * 4);
+         status = VC_CONTAINER_ERROR_CORRUPTED;
+         if(i + j && stss[i + j] < stss[i + j - 1]) goto error;
+      }
+   }
+
+   /* Give back the memory saved by merging runs */
+   if(stts_num < stts_entries && (runs = realloc(stts, stts_num * sizeof(*stts))) != NULL)
+      stts = runs;
+   if(ctts_num < ctts_entries && (comp_runs = realloc(ctts, ctts_num * sizeof(*ctts))) != NULL)
+      ctts = comp_runs;
+
+   track_module->seek_index.stts = stts;
+   track_module->seek_index.stts_num = stts_num;
+   track_module->seek_index.ctts = ctts;
+   track_module->seek_index.ctts_num = ctts_num;
+   track_module->seek_index.stsc = stsc;
+   track_module->seek_index.stsc_num = stsc_entries;
+   track_module->seek_index.stss = stss;
+   track_module->seek_index.stss_num = stss_entries;
+   track_module->seek_index.size = stts_num * sizeof(*stts) + ctts_num * sizeof(*ctts) +
+      stsc_entries * sizeof(*stsc) + stss_entries * sizeof(*stss);
+   module->seek_index.size += track_module->seek_index.size;
+   track_module->seek_index.built = true;
+   track_module->seek_index.failed = false;
+   LOG_DEBUG(p_ctx, "seek index for track %u: %u bytes (%u stts runs)", track,
+             (unsigned int)track_module->seek_index.size, stts_num);
+   return VC_CONTAINER_SUCCESS;
+
+ error:
+   LOG_DEBUG(p_ctx, "failed to build the seek index for track %u (%i)", track, status);
+   free(stts);
+   free(ctts);
+   free(stsc);
+   free(stss);
+   return status;
+}
+
+/*****************************************************************************/
+/** Check whether the seek index of a track can be used, building it if needed */
+static bool mp4_seek_index_ready( VC_CONTAINER_T *p_ctx, uint32_t track )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[track]->priv->module;
+
+   if(track_module->seek_index.built) return true;
+   if(!module->seek_index.max_size || track_module->seek_index.failed) return false;
+   return mp4_seek_index_build(p_ctx, track) == VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Same as the table walk done by mp4_find_sample but using the seek index */
+static uint32_t mp4_seek_index_find_sample( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   int64_t seek_time, int64_t seek_time_up )
+{
+   const MP4_INDEX_STTS_T *stts = track_module->seek_index.stts;
+   uint32_t low = 0, high = track_module->seek_index.stts_num, mid;
+
+   if(seek_time >= track_module->seek_index.duration)
+      return track_module->seek_index.samples;
+
+   /* Find the last run starting at or before the requested time */
+   while(high - low > 1)
+   {
+      mid = low + (high - low) / 2;
+      if(stts[mid].time <= seek_time) low = mid;
+      else high = mid;
+   }
+
+   if(!stts[low].delta) return stts[low].sample;
+   seek_time = (seek_time - stts[low].time) / stts[low].delta;
+   seek_time_up = (seek_time_up - stts[low].time) / stts[low].delta;
+   return stts[low].sample + MAX(seek_time, seek_time_up);
+}
+
+/*****************************************************************************/
+/** Find the sync sample to seek to for a given sample (both starting from 0) */
+static uint32_t mp4_seek_index_sync_sample( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   uint32_t sample, bool forward )
+{
+   const uint32_t *stss = track_module->seek_index.stss;
+   uint32_t num = track_module->seek_index.stss_num, low = 0, high = num, mid;
+
+   if(!num) return sample;
+
+   /* Find the first sync sample after the requested one */
+   while(low < high)
+   {
+      mid = low + (high - low) / 2;
+      if(stss[mid] - 1 > sample) high = mid;
+      else low = mid + 1;
+   }
+
+   if(low == num) return stss[num - 1] - 1; /* No sync sample after this one */
+   if(forward) return stss[low] - 1;
+   return low ? stss[low - 1] - 1 : 0;
+}
+
+/*****************************************************************************/
+/** Set up the chunk part of the reader state for a given sample, using the seek index.
+ * Returns the chunk containing the sample and the number of samples before it in the chunk. */
+static uint32_t mp4_seek_index_chunk( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   MP4_READER_STATE_T *state, uint32_t sample, uint32_t *p_samples )
+{
+   const MP4_INDEX_STSC_T *stsc = track_module->seek_index.stsc;
+   uint32_t num = track_module->seek_index.stsc_num, low = 0, high = num, mid, chunk, chunks;
+
+   /* Find the last entry starting at or before the sample */
+   while(high - low > 1)
+   {
+      mid = low + (high - low) / 2;
+      if(stsc[mid].sample <= sample) low = mid;
+      else high = mid;
+   }
+
+   chunk = (sample - stsc[low].sample) / stsc[low].samples_per_chunk;
+   *p_samples = (sample - stsc[low].sample) % stsc[low].samples_per_chunk;
+
+   /* Same number of chunks as mp4_read_sample_table would give for that entry */
+   chunks = (low + 1 < num ? stsc[low + 1].first_chunk : (uint32_t)-1) - stsc[low].first_chunk;
+   state->chunks = chunks - chunk - 1;
+   state->samples_per_chunk = state->samples_in_chunk = stsc[low].samples_per_chunk;
+   state->sample_table[MP4_SAMPLE_TABLE_STSC].entry = low + 1;
+
+   return stsc[low].first_chunk - stsc[0].first_chunk + chunk;
+}
+
+/*****************************************************************************/
+/** Set up the timing part of the reader state for a given sample, using the seek index */
+static void mp4_seek_index_time( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   MP4_READER_STATE_T *state, uint32_t sample )
+{
+   const MP4_INDEX_STTS_T *stts = track_module->seek_index.stts;
+   uint32_t num = track_module->seek_index.stts_num, low = 0, high = num, mid;
+
+   while(high - low > 1)
+   {
+      mid = low + (high - low) / 2;
+      if(stts[mid].sample <= sample) low = mid;
+      else high = mid;
+   }
+
+   /* A merged run is consumed as if it was a single table entry */
+   state->sample_duration = stts[low].delta;
+   state->sample_duration_count =
+      (low + 1 < num ? stts[low + 1].sample : track_module->seek_index.samples) - sample;
+   state->duration = stts[low].time + (int64_t)(sample - stts[low].sample) * stts[low].delta;
+   state->sample_table[MP4_SAMPLE_TABLE_STTS].entry = low + 1 < num ? stts[low + 1].entry :
+      track_module->sample_table[MP4_SAMPLE_TABLE_STTS].entries;
+
+   if(!track_module->seek_index.ctts_num) return;
+   {
+      const MP4_INDEX_CTTS_T *ctts = track_module->seek_index.ctts;
+      num = track_module->seek_index.ctts_num, low = 0, high = num;
+
+      while(high - low > 1)
+      {
+         mid = low + (high - low) / 2;
+         if(ctts[mid].sample <= sample) low = mid;
+         else high = mid;
+      }
+
+      state->sample_composition_offset = ctts[low].offset;
+      state->sample_composition_count =
+         (low + 1 < num ? ctts[low + 1].sample : track_module->seek_index.ctts_samples) - sample;
+      state->sample_table[MP4_SAMPLE_TABLE_CTTS].entry = low + 1 < num ? ctts[low + 1].entry :
+         track_module->sample_table[MP4_SAMPLE_TABLE_CTTS].entries;
+   }
+}
+
+/*****************************************************************************/
+/** Set up the synchronisation part of the reader state for a given sample, using the seek index */
+static void mp4_seek_index_sync( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   MP4_READER_STATE_T *state, uint32_t sample )
+{
+   const uint32_t *stss = track_module->seek_index.stss;
+   uint32_t num = track_module->seek_index.stss_num, low = 0, high = num, mid;
+
+   if(!num) return;
+
+   /* Find the first sync sample at or after this one */
+   while(low < high)
+   {
+      mid = low + (high - low) / 2;
+      if(stss[mid] >= sample + 1) high = mid;
+      else low = mid + 1;
+   }
+
+   if(low == num) low--;
+   state->next_sync_sample = stss[low];
+   state->sample_table[MP4_SAMPLE_TABLE_STSS].entry = low + 1;
+}
+
 /*****************************************************************************/
 static uint32_t mp4_find_sample( VC_CONTAINER_T *p_ctx, uint32_t track,
    MP4_READER_STATE_T *state, int64_t seek_time, VC_CONTAINER_STATUS_T *p_status )
@@ -1569,6 +2756,12 @@ static uint32_t mp4_find_sample( VC_CONTAINER_T *p_ctx, uint32_t track,
     * rounding errors in the timestamp (because of the timescale conversion) */
    seek_time_up = seek_time_up * track_module->timescale / 1000000;
 
+   if(mp4_seek_index_ready(p_ctx, track))
+   {
+      sample = mp4_seek_index_find_sample(track_module, seek_time, seek_time_up);
+      goto end;
+   }
+
    status = SEEK(p_ctx, track_module->sample_table[MP4_SAMPLE_TABLE_STTS].offset);
    if(status != VC_CONTAINER_SUCCESS) goto end;
 
@@ -1607,11 +2800,19 @@ static VC_CONTAINER_STATUS_T mp4_seek_track( VC_CONTAINER_T *p_ctx, uint32_t tra
    VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[track]->priv->module;
    uint32_t chunk = 0, samples;
    unsigned int i;
+   bool indexed;
 
    memset(state, 0, sizeof(*state));
 
+   /* Samples the tables don't fully describe are left to the table walk */
+   indexed = track_module->seek_index.built && track_module->seek_index.stsc_num &&
+      sample < track_module->seek_index.samples &&
+      (!track_module->seek_index.ctts_num || sample < track_module->seek_index.ctts_samples);
+
    /* Find the right chunk */
-   for(i = 0, samples = sample; i < track_module->sample_table[MP4_SAMPLE_TABLE_STSC].entries; i++)
+   if(indexed)
+      chunk = mp4_seek_index_chunk(track_module, state, sample, &samples);
+   else for(i = 0, samples = sample; i < track_module->sample_table[MP4_SAMPLE_TABLE_STSC].entries; i++)
    {
       state->status = mp4_read_sample_table( p_ctx, track_module, state, MP4_SAMPLE_TABLE_STSC, 1 );
       if(state->status != VC_CONTAINER_SUCCESS) goto error;
@@ -1651,6 +2852,14 @@ static VC_CONTAINER_STATUS_T mp4_seek_track( VC_CONTAINER_T *p_ctx, uint32_t tra
    }
 
    /* Get the timestamp */
+   if(indexed)
+   {
+      /* The index also gives the place in the composition and synchronisation tables */
+      mp4_seek_index_time(track_module, state, sample);
+      mp4_seek_index_sync(track_module, state, sample);
+      goto done;
+   }
+
    for(i = 0, samples = sample; i < track_module->sample_table[MP4_SAMPLE_TABLE_STTS].entries; i++)
    {
       state->status = mp4_read_sample_table( p_ctx, track_module, state, MP4_SAMPLE_TABLE_STTS, !i );
@@ -1693,6 +2902,7 @@ static VC_CONTAINER_STATUS_T mp4_seek_track( VC_CONTAINER_T *p_ctx, uint32_t tra
       if(state->next_sync_sample >= sample + 1) break;
    }
 
+ done:
    state->sample = sample;
    state->sample_size = 0;
    mp4_read_sample_header(p_ctx, track, state);
@@ -1701,6 +2911,183 @@ static VC_CONTAINER_STATUS_T mp4_seek_track( VC_CONTAINER_T *p_ctx, uint32_t tra
    return state->status;
 }
 
+/*****************************************************************************/
+/** Read the fragment index of the reference track from the mfra box, which is
+ * found via the mfro box at the very end of the file */
+static VC_CONTAINER_STATUS_T mp4_read_mfra( VC_CONTAINER_T *p_ctx )
+{
+   int64_t size = p_ctx->priv->io->size, box_size;
+   MP4_BOX_TYPE_T box_type;
+   VC_CONTAINER_STATUS_T status;
+   uint32_t mfra_size;
+
+   if(size < 16 || !STREAM_SEEKABLE(p_ctx)) return VC_CONTAINER_ERROR_NOT_FOUND;
+
+   status = SEEK(p_ctx, size - 16);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+   if(READ_U32(p_ctx, "size") != 16 || READ_FOURCC(p_ctx, "type") != MP4_BOX_TYPE_MFRO)
+      return VC_CONTAINER_ERROR_NOT_FOUND;
+   SKIP_U32(p_ctx, "version/flags");
+   mfra_size = READ_U32(p_ctx, "size");
+   if(mfra_size < 16 || mfra_size > size) return VC_CONTAINER_ERROR_NOT_FOUND;
+
+   status = SEEK(p_ctx, size - mfra_size);
+   if(status == VC_CONTAINER_SUCCESS)
+      status = mp4_read_box_header( p_ctx, mfra_size, &box_type, &box_size );
+   if(status != VC_CONTAINER_SUCCESS) return status;
+   if(box_type != MP4_BOX_TYPE_MFRA) return VC_CONTAINER_ERROR_NOT_FOUND;
+
+   return mp4_read_box_data( p_ctx, box_type, box_size, MP4_BOX_TYPE_ROOT );
+}
+
+/*****************************************************************************/
+/** Reset the tracks so the reading restarts from the given entry of the fragment index */
+static void mp4_fragment_reset( VC_CONTAINER_T *p_ctx, unsigned int entry )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   int64_t ref_timescale = p_ctx->tracks[mp4_fragment_ref_track(p_ctx)]->priv->module->timescale;
+   unsigned int i;
+
+   module->fragment.next_offset = module->fragment.first_offset;
+   if(module->fragment.index_num)
+      module->fragment.next_offset = module->fragment.index[entry].offset;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[i]->priv->module;
+      memset(&track_module->state, 0, sizeof(track_module->state));
+      track_module->fragment.num = track_module->fragment.index = 0;
+
+      /* The decoding time is only a best guess for the tracks without a tfdt box */
+      track_module->fragment.dts = 0;
+      if(module->fragment.index_num && ref_timescale)
+         track_module->fragment.dts =
+            module->fragment.index[entry].time * track_module->timescale / ref_timescale;
+   }
+}
+
+/*****************************************************************************/
+/** Scan the movie fragments which aren't indexed yet until we find one starting after
+ * the given time (in the timescale of the reference track) */
+static void mp4_fragment_index_extend( VC_CONTAINER_T *p_ctx, int64_t time )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   if(module->fragment.index_complete) return;
+   if(module->fragment.index_num &&
+      module->fragment.index[module->fragment.index_num - 1].time > time) return;
+
+   mp4_fragment_reset(p_ctx, module->fragment.index_num ? module->fragment.index_num - 1 : 0);
+   module->fragment.index_tail = true;
+
+   /* Only the boxes of the fragments get read, the media data is skipped */
+   while(mp4_read_fragment(p_ctx, true) == VC_CONTAINER_SUCCESS &&
+         module->fragment.index[module->fragment.index_num - 1].time <= time);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_reader_seek_fragment(VC_CONTAINER_T *p_ctx,
+   int64_t *offset, VC_CONTAINER_SEEK_FLAGS_T flags)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   MP4_FRAGMENT_SAMPLE_T *samples;
+   unsigned int i, j, ref, entry, low, high;
+   int64_t time, seek_time = *offset;
+   bool forward = !!(flags & VC_CONTAINER_SEEK_FLAG_FORWARD);
+   int found = -1;
+
+   if(!p_ctx->tracks_num) return VC_CONTAINER_ERROR_EOS;
+   ref = mp4_fragment_ref_track(p_ctx);
+   track_module = p_ctx->tracks[ref]->priv->module;
+   time = seek_time * track_module->timescale / 1000000;
+
+   /* Use the fragment random access box if there is one, otherwise the index is
+    * built as we go */
+   if(!module->fragment.mfra_checked)
+   {
+      module->fragment.mfra_checked = true;
+      if(!module->fragment.index_complete) mp4_read_mfra(p_ctx);
+   }
+   mp4_fragment_index_extend(p_ctx, time);
+
+   /* Find the last fragment starting before the seek point */
+   for(low = 0, high = module->fragment.index_num; low < high; )
+   {
+      unsigned int middle = (low + high) / 2;
+      if(module->fragment.index[middle].time <= time) low = middle + 1;
+      else high = middle;
+   }
+   entry = low ? low - 1 : 0;
+
+   /* Find the sync sample of the reference track, going back one fragment at a time
+    * if the fragment doesn't start with a sync sample */
+   while(1)
+   {
+      mp4_fragment_reset(p_ctx, entry);
+      samples = track_module->fragment.samples;
+
+      while(1)
+      {
+         unsigned int num = track_module->fragment.num;
+         samples = track_module->fragment.samples;
+
+         if(forward)
+         {
+            for(j = 0; j < num && found < 0; j++)
+               if(samples[j].sync && samples[j].dts >= time) found = j;
+            if(found >= 0) break;
+         }
+         else if(num && samples[num - 1].dts > time)
+         {
+            /* We've gone past the seek point so we know we've got the right sample */
+            for(j = 0; j < num && samples[j].dts <= time; j++)
+               if(samples[j].sync) found = j;
+            break;
+         }
+
+         if(mp4_read_fragment(p_ctx, false) != VC_CONTAINER_SUCCESS) break;
+      }
+
+      /* We've reached the end of the stream before the seek point */
+      samples = track_module->fragment.samples;
+      for(j = 0; !forward && found < 0 && j < track_module->fragment.num; j++)
+         if(samples[j].sync) found = j;
+
+      if(found >= 0 || !entry || forward) break;
+      entry--;
+   }
+
+   if(found < 0) found = forward ? (int)track_module->fragment.num : 0;
+   track_module->fragment.index = found;
+   if(mp4_read_fragment_sample_header(p_ctx, ref, &track_module->state) == VC_CONTAINER_SUCCESS)
+      seek_time = track_module->state.pts;
+
+   /* Skip the samples of the other tracks which end before the new seek point */
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      if(i == ref) continue;
+      track_module = p_ctx->tracks[i]->priv->module;
+      time = seek_time * track_module->timescale / 1000000;
+
+      while(1)
+      {
+         samples = track_module->fragment.samples;
+         while(track_module->fragment.index < track_module->fragment.num &&
+               samples[track_module->fragment.index].dts +
+                  samples[track_module->fragment.index].duration <= time)
+            track_module->fragment.index++;
+         if(track_module->fragment.index < track_module->fragment.num) break;
+         if(mp4_read_fragment(p_ctx, false) != VC_CONTAINER_SUCCESS) break;
+      }
+
+      mp4_read_fragment_sample_header(p_ctx, i, &track_module->state);
+   }
+
+   *offset = seek_time;
+   return VC_CONTAINER_SUCCESS;
+}
+
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T mp4_reader_seek(VC_CONTAINER_T *p_ctx,
    int64_t *offset, VC_CONTAINER_SEEK_MODE_T mode, VC_CONTAINER_SEEK_FLAGS_T flags)
@@ -1710,9 +3097,11 @@ static VC_CONTAINER_STATUS_T mp4_reader_seek(VC_CONTAINER_T *p_ctx,
    VC_CONTAINER_STATUS_T status;
    uint32_t i, track, sample, prev_sample, next_sample;
    int64_t seek_time = *offset;
-   VC_CONTAINER_PARAM_UNUSED(module);
    VC_CONTAINER_PARAM_UNUSED(mode);
 
+   if(module->fragmented)
+      return mp4_reader_seek_fragment(p_ctx, offset, flags);
+
    /* Reset the states */
    for(i = 0; i < p_ctx->tracks_num; i++)
       memset(&p_ctx->tracks[i]->priv->module->state, 0, sizeof(p_ctx->tracks[i]->priv->module->state));
@@ -1743,16 +3132,23 @@ static VC_CONTAINER_STATUS_T mp4_reader_seek(VC_CONTAINER_T *p_ctx,
    /* Find the closest sync sample */
    status = mp4_seek_sample_table( p_ctx, track_module, &track_module->state, MP4_SAMPLE_TABLE_STSS );
    if(status != VC_CONTAINER_SUCCESS) goto seek_time_found;
-   for(i = 0, prev_sample = 0, next_sample = 0;
-       i < track_module->sample_table[MP4_SAMPLE_TABLE_STSS].entries; i++)
+   if(track_module->seek_index.built)
+      sample = mp4_seek_index_sync_sample(track_module, sample, !!(flags & VC_CONTAINER_SEEK_FLAG_FORWARD));
+   else
    {
-      next_sample = _READ_U32(p_ctx) - 1;
-      if(next_sample > sample)
+      for(i = 0, prev_sample = 0, next_sample = 0;
+          i < track_module->sample_table[MP4_SAMPLE_TABLE_STSS].entries; i++)
       {
-         sample = (flags & VC_CONTAINER_SEEK_FLAG_FORWARD) ? next_sample : prev_sample;
-         break;
+         next_sample = _READ_U32(p_ctx) - 1;
+         if(next_sample > sample)
+         {
+            sample = (flags & VC_CONTAINER_SEEK_FLAG_FORWARD) ? next_sample : prev_sample;
+            break;
+         }
+         prev_sample = next_sample;
       }
-      prev_sample = next_sample;
+      if(i == track_module->sample_table[MP4_SAMPLE_TABLE_STSS].entries)
+         sample = prev_sample; /* No sync sample after the requested one */
    }
 
    /* Do the seek on this track and use its timestamp as the new seek point */
@@ -1828,13 +3224,24 @@ VC_CONTAINER_STATUS_T mp4_reader_open( VC_CONTAINER_T *p_ctx )
       int64_t box_size;
 
       status = mp4_read_box_header( p_ctx, INT64_C(-1), &box_type, &box_size );
+      if(status != VC_CONTAINER_SUCCESS && module->found_moov && module->fragmented)
+      {
+         /* The movie fragments might not have been written yet */
+         module->fragment.first_offset = module->box_offset;
+         break;
+      }
       if(status != VC_CONTAINER_SUCCESS) goto error;
 
-      if(box_type == MP4_BOX_TYPE_MDAT)
+      if(box_type == MP4_BOX_TYPE_MOOF && module->found_moov && module->fragmented)
+      {
+         module->fragment.first_offset = module->box_offset;
+         break; /* Samples are read as the movie fragments get parsed */
+      }
+      else if(box_type == MP4_BOX_TYPE_MDAT)
       {
          module->data_offset = STREAM_POSITION(p_ctx);
          module->data_size = box_size;
-         if(module->found_moov) break; /* We've got everything we want */
+         if(module->found_moov && !module->fragmented) break; /* We've got everything we want */
       }
       else if(box_type == MP4_BOX_TYPE_MOOV)
          module->found_moov = true;
@@ -1842,7 +3249,17 @@ VC_CONTAINER_STATUS_T mp4_reader_open( VC_CONTAINER_T *p_ctx )
       status = mp4_read_box_data( p_ctx, box_type, box_size, MP4_BOX_TYPE_ROOT );
       if(status != VC_CONTAINER_SUCCESS) goto error;
 
-      if(module->found_moov && module->data_offset) break; /* We've got everything we want */
+      if(module->found_moov && module->data_offset && !module->fragmented)
+         break; /* We've got everything we want */
+   }
+
+   /* Parse the first movie fragment so we can start emitting samples straight away */
+   if(module->fragmented)
+   {
+      if(!module->fragment.first_offset)
+         module->fragment.first_offset = STREAM_POSITION(p_ctx);
+      module->fragment.next_offset = module->fragment.first_offset;
+      mp4_read_fragment(p_ctx, false);
    }
 
    /* Initialise tracks */
@@ -1852,12 +3269,16 @@ VC_CONTAINER_STATUS_T mp4_reader_open( VC_CONTAINER_T *p_ctx )
       status = mp4_read_sample_header(p_ctx, i, &p_ctx->tracks[i]->priv->module->state);
    }
 
-   status = SEEK(p_ctx, module->data_offset);
-   if(status != VC_CONTAINER_SUCCESS) goto error;
+   if(!module->fragmented)
+   {
+      status = SEEK(p_ctx, module->data_offset);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+   }
 
    p_ctx->priv->pf_close = mp4_reader_close;
    p_ctx->priv->pf_read = mp4_reader_read;
    p_ctx->priv->pf_seek = mp4_reader_seek;
+   p_ctx->priv->pf_control = mp4_reader_control;
 
    if(STREAM_SEEKABLE(p_ctx))
       p_ctx->capabilities |= VC_CONTAINER_CAPS_CAN_SEEK;
@@ -1867,6 +3288,8 @@ VC_CONTAINER_STATUS_T mp4_reader_open( VC_CONTAINER_T *p_ctx )
  error:
    LOG_DEBUG(p_ctx, "mp4: error opening stream");
    if(module) mp4_reader_close(p_ctx);
+   p_ctx->tracks_num = 0; /* The tracks have been freed (e.g. truncated moov box) */
+   p_ctx->tracks = 0;
    return status;
 }
 
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_utils.h"
 #include "containers/core/containers_writer_utils.h"
 #include "containers/core/containers_logging.h"
+#include "containers/core/containers_nal.h"
 #include "containers/mp4/mp4_common.h"
 #undef CONTAINER_HELPER_LOG_INDENT
 #define CONTAINER_HELPER_LOG_INDENT(a) (a)->priv->module->box_level
@@ -47,9 +48,30 @@ Defines.
 
 #define MP4_64BITS_TIME 0 /* 0 to disable / 1 to enable */
 
+#define MP4_FRAGMENT_DURATION_DEFAULT 1000 /* ms */
+#define MP4_FRAGMENT_DATA_MAX (8*1024*1024) /* a fragment is written early past this */
+#define MP4_FRAGMENT_VIDEO_TIMESCALE 90000
+
 /******************************************************************************
 Type definitions.
 ******************************************************************************/
+/** Sample held in memory until the movie fragment it belongs to is written */
+typedef struct MP4_FRAGMENT_SAMPLE_T
+{
+   int64_t dts;                  /**< decoding time in track timescale */
+   int32_t composition_offset;   /**< in track timescale */
+   uint32_t size;
+   bool sync;
+} MP4_FRAGMENT_SAMPLE_T;
+
+/** Entry of the track fragment random access box (tfra) */
+typedef struct MP4_FRAGMENT_INDEX_T
+{
+   int64_t time;                 /**< in track timescale */
+   int64_t moof_offset;
+   uint32_t traf_number;
+} MP4_FRAGMENT_INDEX_T;
+
 typedef struct VC_CONTAINER_TRACK_MODULE_T
 {
    uint32_t fourcc;
@@ -69,6 +91,38 @@ typedef struct VC_CONTAINER_TRACK_MODULE_T
    int64_t first_pts;
    int64_t last_pts;
 
+   uint32_t timescale;
+
+   /* Movie fragment being built */
+   struct {
+      MP4_FRAGMENT_SAMPLE_T *samples;
+      unsigned int num, max;
+      uint8_t *data;               /**< data of the samples, followed by any partial sample */
+      size_t data_size, data_max;
+      size_t samples_size;         /**< size of the data of the complete samples */
+
+      int64_t next_dts;            /**< dts of the sample following the fragment, -1 if unknown */
+      int64_t end_dts;             /**< end of the last sample written */
+      uint32_t last_duration;
+      uint32_t traf_number;        /**< 1-based position in the moof, 0 if not in it */
+      uint32_t data_offset;        /**< from the start of the moof */
+      uint32_t tfhd_flags, trun_flags;
+      uint32_t default_duration, default_flags;
+
+      MP4_FRAGMENT_INDEX_T *index;
+      unsigned int index_num, index_max;
+   } fragment;
+
+   /* Annex-B H.264 converted into avcC samples */
+   struct {
+      bool enabled;
+      VC_CONTAINER_PACKET_T packet; /**< first packet of the access unit being gathered */
+      uint8_t *data;                /**< Annex-B data of the access unit */
+      size_t data_size, data_max;
+      uint8_t *sample;              /**< the access unit with its NAL units preceded by their size */
+      size_t sample_max;
+   } annexb;
+
 } VC_CONTAINER_TRACK_MODULE_T;
 
 typedef struct VC_CONTAINER_MODULE_T
@@ -96,6 +150,20 @@ typedef struct VC_CONTAINER_MODULE_T
    int64_t duration;
    /**/
 
+   bool fragmented;
+   bool cmaf;                    /**< fragments follow the CMAF constraints */
+   struct {
+      int64_t duration;          /**< minimum duration of a fragment in microseconds */
+      int64_t start_time;        /**< time of the first sample of the pending fragment */
+      unsigned int ref_track;    /**< track whose sync samples start the fragments */
+      int track;                 /**< only track written in the current moof, -1 for all */
+      uint32_t sequence_number;
+      int64_t moof_offset;
+      unsigned int moof_size;
+      int64_t mehd_offset;
+      unsigned int mfra_size;
+   } fragment;
+
 } VC_CONTAINER_MODULE_T;
 
 /******************************************************************************
@@ -128,6 +196,20 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stss( VC_CONTAINER_T *p_ctx );
 static VC_CONTAINER_STATUS_T mp4_write_box_vide( VC_CONTAINER_T *p_ctx );
 static VC_CONTAINER_STATUS_T mp4_write_box_soun( VC_CONTAINER_T *p_ctx );
 static VC_CONTAINER_STATUS_T mp4_write_box_esds( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_mvex( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_mehd( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_trex( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_styp( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_moof( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_mfhd( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_traf( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_tfhd( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_tfdt( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_trun( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_mfra( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_tfra( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_write_box_mfro( VC_CONTAINER_T *p_ctx );
+static VC_CONTAINER_STATUS_T mp4_writer_add_track_done( VC_CONTAINER_T *p_ctx );
 
 static struct {
   const MP4_BOX_TYPE_T type;
@@ -159,6 +241,20 @@ static struct {
    {MP4_BOX_TYPE_VIDE, mp4_write_box_vide},
    {MP4_BOX_TYPE_SOUN, mp4_write_box_soun},
    {MP4_BOX_TYPE_ESDS, mp4_write_box_esds},
+   /* Movie fragments */
+   {MP4_BOX_TYPE_MVEX, mp4_write_box_mvex},
+   {MP4_BOX_TYPE_MEHD, mp4_write_box_mehd},
+   {MP4_BOX_TYPE_TREX, mp4_write_box_trex},
+   {MP4_BOX_TYPE_STYP, mp4_write_box_styp},
+   {MP4_BOX_TYPE_MOOF, mp4_write_box_moof},
+   {MP4_BOX_TYPE_MFHD, mp4_write_box_mfhd},
+   {MP4_BOX_TYPE_TRAF, mp4_write_box_traf},
+   {MP4_BOX_TYPE_TFHD, mp4_write_box_tfhd},
+   {MP4_BOX_TYPE_TFDT, mp4_write_box_tfdt},
+   {MP4_BOX_TYPE_TRUN, mp4_write_box_trun},
+   {MP4_BOX_TYPE_MFRA, mp4_write_box_mfra},
+   {MP4_BOX_TYPE_TFRA, mp4_write_box_tfra},
+   {MP4_BOX_TYPE_MFRO, mp4_write_box_mfro},
    {MP4_BOX_TYPE_UNKNOWN, 0}
 };
 
@@ -231,6 +327,10 @@ static VC_CONTAINER_STATUS_T mp4_write_box_ftyp( VC_CONTAINER_T *p_ctx )
    WRITE_FOURCC(p_ctx, MP4_BRAND_ISOM, "compatible_brands");
    WRITE_FOURCC(p_ctx, MP4_BRAND_MP42, "compatible_brands");
    WRITE_FOURCC(p_ctx, MP4_BRAND_3GP4, "compatible_brands");
+   if(module->fragmented) /* needed for the default-base-is-moof flag of tfhd */
+      WRITE_FOURCC(p_ctx, MP4_BRAND_ISO6, "compatible_brands");
+   if(module->cmaf)
+      WRITE_FOURCC(p_ctx, MP4_BRAND_CMFC, "compatible_brands");
 
    return STREAM_STATUS(p_ctx);
 }
@@ -252,6 +352,9 @@ static VC_CONTAINER_STATUS_T mp4_write_box_moov( VC_CONTAINER_T *p_ctx )
       if(status != VC_CONTAINER_SUCCESS) return status;
    }
 
+   if(module->fragmented)
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MVEX);
+
    return status;
 }
 
@@ -396,6 +499,8 @@ static VC_CONTAINER_STATUS_T mp4_write_box_mdia( VC_CONTAINER_T *p_ctx )
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T mp4_write_box_mdhd( VC_CONTAINER_T *p_ctx )
 {
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   uint32_t timescale = p_ctx->tracks[module->current_track]->priv->module->timescale;
    unsigned int version = MP4_64BITS_TIME;
 
    WRITE_U8(p_ctx,  version, "version");
@@ -406,15 +511,15 @@ static VC_CONTAINER_STATUS_T mp4_write_box_mdhd( VC_CONTAINER_T *p_ctx )
    {
       WRITE_U64(p_ctx, 0, "creation_time");
       WRITE_U64(p_ctx, 0, "modification_time");
-      WRITE_U32(p_ctx, MP4_TIMESCALE, "timescale");
-      WRITE_U64(p_ctx, p_ctx->duration * MP4_TIMESCALE / 1000000, "duration");
+      WRITE_U32(p_ctx, timescale, "timescale");
+      WRITE_U64(p_ctx, p_ctx->duration * timescale / 1000000, "duration");
    }
    else
    {
       WRITE_U32(p_ctx, 0, "creation_time");
       WRITE_U32(p_ctx, 0, "modification_time");
-      WRITE_U32(p_ctx, MP4_TIMESCALE, "timescale");
-      WRITE_U32(p_ctx, p_ctx->duration * MP4_TIMESCALE / 1000000, "duration");
+      WRITE_U32(p_ctx, timescale, "timescale");
+      WRITE_U32(p_ctx, p_ctx->duration * timescale / 1000000, "duration");
    }
 
    WRITE_U16(p_ctx, 0x55c4, "language"); /* ISO-639-2/T language code */
@@ -572,7 +677,8 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stbl( VC_CONTAINER_T *p_ctx )
    else
       status = mp4_write_box(p_ctx, MP4_BOX_TYPE_CO64);
 
-   if(track->format->es_type == VC_CONTAINER_ES_TYPE_VIDEO)
+   /* An empty stss would mean that none of the samples is a sync sample */
+   if(track->format->es_type == VC_CONTAINER_ES_TYPE_VIDEO && !module->fragmented)
    {
       status = mp4_write_box(p_ctx, MP4_BOX_TYPE_STSS);
       if(status != VC_CONTAINER_SUCCESS) return status;
@@ -651,9 +757,10 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stts( VC_CONTAINER_T *p_ctx )
 
    WRITE_U32(p_ctx, track_module->sample_table[MP4_SAMPLE_TABLE_STTS].entries, "entry_count");
 
-   if(module->null.refcount)
+   if(module->null.refcount || module->fragmented)
    {
-      /* We're not actually writing the data, we just want the size */
+      /* We're not actually writing the data, we just want the size.
+       * The samples of fragmented files are described in the movie fragments. */
       WRITE_BYTES(p_ctx, 0, track_module->sample_table[MP4_SAMPLE_TABLE_STTS].entries * 8);
       return STREAM_STATUS(p_ctx);
    }
@@ -710,7 +817,7 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stsc( VC_CONTAINER_T *p_ctx )
    WRITE_U24(p_ctx, 0, "flags");
    WRITE_U32(p_ctx, track_module->sample_table[MP4_SAMPLE_TABLE_STSC].entries, "entry_count");
 
-   if(module->null.refcount)
+   if(module->null.refcount || module->fragmented)
    {
       /* We're not actually writing the data, we just want the size */
       WRITE_BYTES(p_ctx, 0, track_module->sample_table[MP4_SAMPLE_TABLE_STSC].entries * 12);
@@ -777,7 +884,7 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stsz( VC_CONTAINER_T *p_ctx )
    WRITE_U32(p_ctx, 0, "sample_size");
    WRITE_U32(p_ctx, track_module->sample_table[MP4_SAMPLE_TABLE_STSZ].entries, "sample_count");
 
-   if(module->null.refcount)
+   if(module->null.refcount || module->fragmented)
    {
       /* We're not actually writing the data, we just want the size */
       WRITE_BYTES(p_ctx, 0, track_module->sample_table[MP4_SAMPLE_TABLE_STSZ].entries * 4);
@@ -819,7 +926,7 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stco( VC_CONTAINER_T *p_ctx )
    WRITE_U24(p_ctx, 0, "flags");
    WRITE_U32(p_ctx, track_module->sample_table[MP4_SAMPLE_TABLE_STCO].entries, "entry_count");
 
-   if(module->null.refcount)
+   if(module->null.refcount || module->fragmented)
    {
       /* We're not actually writing the data, we just want the size */
       WRITE_BYTES(p_ctx, 0, track_module->sample_table[MP4_SAMPLE_TABLE_STCO].entries * 4);
@@ -886,7 +993,7 @@ static VC_CONTAINER_STATUS_T mp4_write_box_stss( VC_CONTAINER_T *p_ctx )
    WRITE_U24(p_ctx, 0, "flags");
    WRITE_U32(p_ctx, track_module->sample_table[MP4_SAMPLE_TABLE_STSS].entries, "entry_count");
 
-   if(module->null.refcount)
+   if(module->null.refcount || module->fragmented)
    {
       /* We're not actually writing the data, we just want the size */
       WRITE_BYTES(p_ctx, 0, track_module->sample_table[MP4_SAMPLE_TABLE_STSS].entries * 4);
@@ -1139,34 +1246,774 @@ static VC_CONTAINER_STATUS_T mp4_write_box_esds( VC_CONTAINER_T *p_ctx )
 }
 
 /*****************************************************************************/
-static VC_CONTAINER_STATUS_T mp4_writer_close( VC_CONTAINER_T *p_ctx )
+static VC_CONTAINER_STATUS_T mp4_write_box_mvex( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   unsigned int i;
+
+   /* The duration is only known once all the fragments have been written so
+    * it will be patched when closing */
+   if(!module->cmaf)
+   {
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MEHD);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      module->current_track = i;
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_TREX);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   return status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_mehd( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   WRITE_U8(p_ctx,  1, "version");
+   WRITE_U24(p_ctx, 0, "flags");
+
+   if(!module->null.refcount) module->fragment.mehd_offset = STREAM_POSITION(p_ctx);
+   WRITE_U64(p_ctx, 0, "fragment_duration");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_trex( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   WRITE_U8(p_ctx,  0, "version");
+   WRITE_U24(p_ctx, 0, "flags");
+
+   WRITE_U32(p_ctx, module->current_track + 1, "track_ID");
+   WRITE_U32(p_ctx, 1, "default_sample_description_index");
+   WRITE_U32(p_ctx, 0, "default_sample_duration");
+   WRITE_U32(p_ctx, 0, "default_sample_size");
+   WRITE_U32(p_ctx, 0, "default_sample_flags");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_styp( VC_CONTAINER_T *p_ctx )
+{
+   WRITE_FOURCC(p_ctx, MP4_BRAND_CMFS, "major_brand");
+   WRITE_U32(p_ctx, 0, "minor_version");
+   WRITE_FOURCC(p_ctx, MP4_BRAND_CMFS, "compatible_brands");
+   WRITE_FOURCC(p_ctx, MP4_BRAND_CMFF, "compatible_brands");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_moof( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+   unsigned int i;
+
+   status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MFHD);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      if(!p_ctx->tracks[i]->priv->module->fragment.traf_number) continue;
+      module->current_track = i;
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_TRAF);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   return status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_mfhd( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   WRITE_U8(p_ctx,  0, "version");
+   WRITE_U24(p_ctx, 0, "flags");
+   WRITE_U32(p_ctx, module->fragment.sequence_number, "sequence_number");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_traf( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_STATUS_T status;
+
+   status = mp4_write_box(p_ctx, MP4_BOX_TYPE_TFHD);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   status = mp4_write_box(p_ctx, MP4_BOX_TYPE_TFDT);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   return mp4_write_box(p_ctx, MP4_BOX_TYPE_TRUN);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_tfhd( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[module->current_track]->priv->module;
+   uint32_t flags = track_module->fragment.tfhd_flags;
+
+   WRITE_U8(p_ctx,  0, "version");
+   WRITE_U24(p_ctx, flags, "flags");
+
+   WRITE_U32(p_ctx, module->current_track + 1, "track_ID");
+   if(flags & MP4_TFHD_DEFAULT_SAMPLE_DURATION_PRESENT)
+      WRITE_U32(p_ctx, track_module->fragment.default_duration, "default_sample_duration");
+   if(flags & MP4_TFHD_DEFAULT_SAMPLE_FLAGS_PRESENT)
+      WRITE_U32(p_ctx, track_module->fragment.default_flags, "default_sample_flags");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_tfdt( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[module->current_track]->priv->module;
+
+   WRITE_U8(p_ctx,  1, "version");
+   WRITE_U24(p_ctx, 0, "flags");
+   WRITE_U64(p_ctx, track_module->fragment.samples[0].dts, "base_media_decode_time");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_trun( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[module->current_track]->priv->module;
+   MP4_FRAGMENT_SAMPLE_T *samples = track_module->fragment.samples;
+   uint32_t flags = track_module->fragment.trun_flags;
+   unsigned int i, num = track_module->fragment.num;
+
+   WRITE_U8(p_ctx,  1, "version"); /* signed composition time offsets */
+   WRITE_U24(p_ctx, flags, "flags");
+
+   WRITE_U32(p_ctx, num, "sample_count");
+   WRITE_U32(p_ctx, track_module->fragment.data_offset, "data_offset");
+   if(flags & MP4_TRUN_FIRST_SAMPLE_FLAGS_PRESENT)
+      WRITE_U32(p_ctx, MP4_SAMPLE_FLAGS_SYNC, "first_sample_flags");
+
+   if(module->null.refcount)
+   {
+      /* We're not actually writing the data, we just want the size */
+      unsigned int entry_size = 4 +
+         ((flags & MP4_TRUN_SAMPLE_DURATION_PRESENT) ? 4 : 0) +
+         ((flags & MP4_TRUN_SAMPLE_FLAGS_PRESENT) ? 4 : 0) +
+         ((flags & MP4_TRUN_SAMPLE_COMPOSITION_TIME_OFFSETS_PRESENT) ? 4 : 0);
+      WRITE_BYTES(p_ctx, 0, num * entry_size);
+      return STREAM_STATUS(p_ctx);
+   }
+
+   for(i = 0; i < num; i++)
+   {
+      if(flags & MP4_TRUN_SAMPLE_DURATION_PRESENT)
+         _WRITE_U32(p_ctx, i + 1 < num ? (uint32_t)(samples[i+1].dts - samples[i].dts) :
+                    track_module->fragment.last_duration);
+      _WRITE_U32(p_ctx, samples[i].size);
+      if(flags & MP4_TRUN_SAMPLE_FLAGS_PRESENT)
+         _WRITE_U32(p_ctx, samples[i].sync ? MP4_SAMPLE_FLAGS_SYNC : MP4_SAMPLE_FLAGS_NON_SYNC);
+      if(flags & MP4_TRUN_SAMPLE_COMPOSITION_TIME_OFFSETS_PRESENT)
+         _WRITE_U32(p_ctx, (uint32_t)samples[i].composition_offset);
+   }
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_mfra( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   unsigned int i;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      if(!p_ctx->tracks[i]->priv->module->fragment.index_num) continue;
+      module->current_track = i;
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_TFRA);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   return mp4_write_box(p_ctx, MP4_BOX_TYPE_MFRO);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_tfra( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[module->current_track]->priv->module;
+   unsigned int i;
+
+   WRITE_U8(p_ctx,  1, "version");
+   WRITE_U24(p_ctx, 0, "flags");
+
+   WRITE_U32(p_ctx, module->current_track + 1, "track_ID");
+   WRITE_U32(p_ctx, 0, "length_size_of_traf_trun_sample_num"); /* 1 byte each */
+   WRITE_U32(p_ctx, track_module->fragment.index_num, "number_of_entry");
+
+   if(module->null.refcount)
+   {
+      /* We're not actually writing the data, we just want the size */
+      WRITE_BYTES(p_ctx, 0, track_module->fragment.index_num * 19);
+      return STREAM_STATUS(p_ctx);
+   }
+
+   for(i = 0; i < track_module->fragment.index_num; i++)
+   {
+      MP4_FRAGMENT_INDEX_T *entry = &track_module->fragment.index[i];
+      _WRITE_U64(p_ctx, entry->time);
+      _WRITE_U64(p_ctx, entry->moof_offset);
+      _WRITE_U8(p_ctx, entry->traf_number);
+      _WRITE_U8(p_ctx, 1); /* trun_number */
+      _WRITE_U8(p_ctx, 1); /* sample_number */
+   }
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_write_box_mfro( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   WRITE_U8(p_ctx,  0, "version");
+   WRITE_U24(p_ctx, 0, "flags");
+   WRITE_U32(p_ctx, module->fragment.mfra_size, "size");
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static int64_t mp4_writer_packet_time( VC_CONTAINER_PACKET_T *packet )
+{
+   return packet->dts != VC_CONTAINER_TIME_UNKNOWN ? packet->dts : packet->pts;
+}
+
+/*****************************************************************************/
+static int64_t mp4_writer_fragment_time( VC_CONTAINER_TRACK_MODULE_T *track_module, int64_t time )
+{
+   return (time * track_module->timescale + 500000) / 1000000;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_writer_buffer_append( uint8_t **buffer, size_t *buffer_size,
+   size_t *buffer_max, const uint8_t *data, size_t size )
+{
+   if(*buffer_size + size > *buffer_max)
+   {
+      size_t max = *buffer_max ? *buffer_max : 64*1024;
+      uint8_t *new_buffer;
+
+      while(max < *buffer_size + size) max <<= 1;
+      new_buffer = realloc(*buffer, max);
+      if(!new_buffer) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      *buffer = new_buffer;
+      *buffer_max = max;
+   }
+
+   memcpy(*buffer + *buffer_size, data, size);
+   *buffer_size += size;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_writer_fragment_add_data( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   const uint8_t *data, size_t size )
+{
+   return mp4_writer_buffer_append(&track_module->fragment.data, &track_module->fragment.data_size,
+                                   &track_module->fragment.data_max, data, size);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_writer_fragment_add_sample( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_PACKET_T *packet )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_T *track = p_ctx->tracks[packet->track];
+   VC_CONTAINER_TRACK_MODULE_T *track_module = track->priv->module;
+   MP4_FRAGMENT_SAMPLE_T *sample;
+   int64_t dts, pts;
+
+   if(track_module->fragment.num >= track_module->fragment.max)
+   {
+      unsigned int max = track_module->fragment.max ? track_module->fragment.max * 2 : 64;
+      sample = realloc(track_module->fragment.samples, max * sizeof(*sample));
+      if(!sample) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      track_module->fragment.samples = sample;
+      track_module->fragment.max = max;
+   }
+
+   dts = mp4_writer_fragment_time(track_module, packet->dts);
+   pts = packet->pts != VC_CONTAINER_TIME_UNKNOWN ?
+      mp4_writer_fragment_time(track_module, packet->pts) : dts;
+   if(dts < 0) dts = 0;
+
+   /* Decoding times have to increase within a run */
+   if(track_module->fragment.num &&
+      dts < track_module->fragment.samples[track_module->fragment.num - 1].dts)
+      dts = track_module->fragment.samples[track_module->fragment.num - 1].dts;
+
+   sample = &track_module->fragment.samples[track_module->fragment.num++];
+   sample->dts = dts;
+   sample->composition_offset = (int32_t)(pts - dts);
+   sample->size = packet->size;
+   sample->sync = track->format->es_type != VC_CONTAINER_ES_TYPE_VIDEO ||
+      (packet->flags & VC_CONTAINER_PACKET_FLAG_KEYFRAME);
+   track_module->fragment.samples_size += packet->size;
+
+   if(!track_module->samples) track_module->first_pts = packet->pts;
+   track_module->last_pts = packet->pts;
+   track_module->samples++;
+
+   if(module->fragment.start_time == VC_CONTAINER_TIME_UNKNOWN)
+      module->fragment.start_time = packet->dts;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Decide how the samples of a track are going to be described in the fragment */
+static void mp4_writer_fragment_prepare( VC_CONTAINER_T *p_ctx, VC_CONTAINER_TRACK_T *track )
+{
+   VC_CONTAINER_TRACK_MODULE_T *track_module = track->priv->module;
+   MP4_FRAGMENT_SAMPLE_T *samples = track_module->fragment.samples;
+   unsigned int i, num = track_module->fragment.num;
+   bool constant_duration = true, composition_offsets = false, sync_samples = false;
+   uint32_t duration;
+   VC_CONTAINER_PARAM_UNUSED(p_ctx);
+
+   /* The duration of the last sample is only known if the next one has been seen already,
+    * otherwise we assume it lasts as long as the previous one */
+   if(track_module->fragment.next_dts > samples[num-1].dts)
+      duration = (uint32_t)(track_module->fragment.next_dts - samples[num-1].dts);
+   else if(num > 1)
+      duration = (uint32_t)(samples[num-1].dts - samples[num-2].dts);
+   else
+      duration = track_module->fragment.last_duration;
+   track_module->fragment.last_duration = duration;
+   track_module->fragment.end_dts = samples[num-1].dts + duration;
+
+   for(i = 0; i < num; i++)
+   {
+      if(i + 1 < num && samples[i+1].dts - samples[i].dts != duration)
+         constant_duration = false;
+      if(samples[i].composition_offset)
+         composition_offsets = true;
+      if(i && samples[i].sync)
+         sync_samples = true;
+   }
+
+   track_module->fragment.tfhd_flags =
+      MP4_TFHD_DEFAULT_BASE_IS_MOOF | MP4_TFHD_DEFAULT_SAMPLE_FLAGS_PRESENT;
+   track_module->fragment.trun_flags =
+      MP4_TRUN_DATA_OFFSET_PRESENT | MP4_TRUN_SAMPLE_SIZE_PRESENT;
+
+   if(constant_duration)
+   {
+      track_module->fragment.tfhd_flags |= MP4_TFHD_DEFAULT_SAMPLE_DURATION_PRESENT;
+      track_module->fragment.default_duration = duration;
+   }
+   else
+      track_module->fragment.trun_flags |= MP4_TRUN_SAMPLE_DURATION_PRESENT;
+
+   /* Only video has samples which aren't sync samples. The usual case of a fragment
+    * starting with a keyframe only needs the flags of the first sample. */
+   if(track->format->es_type != VC_CONTAINER_ES_TYPE_VIDEO)
+      track_module->fragment.default_flags = MP4_SAMPLE_FLAGS_SYNC;
+   else
+   {
+      track_module->fragment.default_flags = MP4_SAMPLE_FLAGS_NON_SYNC;
+      if(sync_samples)
+         track_module->fragment.trun_flags |= MP4_TRUN_SAMPLE_FLAGS_PRESENT;
+      else if(samples[0].sync)
+         track_module->fragment.trun_flags |= MP4_TRUN_FIRST_SAMPLE_FLAGS_PRESENT;
+   }
+
+   if(composition_offsets)
+      track_module->fragment.trun_flags |= MP4_TRUN_SAMPLE_COMPOSITION_TIME_OFFSETS_PRESENT;
+}
+
+/*****************************************************************************/
+static void mp4_writer_fragment_index_add( VC_CONTAINER_TRACK_MODULE_T *track_module,
+   int64_t moof_offset )
+{
+   MP4_FRAGMENT_INDEX_T *entry;
+
+   if(track_module->fragment.index_num >= track_module->fragment.index_max)
+   {
+      unsigned int max = track_module->fragment.index_max ? track_module->fragment.index_max * 2 : 64;
+      entry = realloc(track_module->fragment.index, max * sizeof(*entry));
+      if(!entry) return; /* The index is only there to speed up seeking */
+      track_module->fragment.index = entry;
+      track_module->fragment.index_max = max;
+   }
+
+   entry = &track_module->fragment.index[track_module->fragment.index_num++];
+   entry->time = track_module->fragment.samples[0].dts;
+   entry->moof_offset = moof_offset;
+   entry->traf_number = track_module->fragment.traf_number;
+}
+
+/*****************************************************************************/
+/** Write a moof and its mdat for the pending samples of one or all (-1) of the tracks */
+static VC_CONTAINER_STATUS_T mp4_writer_write_fragment( VC_CONTAINER_T *p_ctx, int track )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   uint32_t traf_number = 0, data_offset;
+   bool sync = false;
+   unsigned int i;
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      track_module = p_ctx->tracks[i]->priv->module;
+      track_module->fragment.traf_number = 0;
+      if(!track_module->fragment.num || (track >= 0 && (int)i != track)) continue;
+
+      track_module->fragment.traf_number = ++traf_number;
+      if(track >= 0 || i == module->fragment.ref_track)
+         sync = track_module->fragment.samples[0].sync;
+   }
+   if(!traf_number) return VC_CONTAINER_SUCCESS;
+
+   /* CMAF segments start with a sync sample and can be told apart by their styp */
+   if(module->cmaf && sync)
+   {
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_STYP);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   /* We need to find out the size of the moof before the runs can point at their data */
+   module->fragment.sequence_number++;
+   if(!vc_container_writer_extraio_enable(p_ctx, &module->null))
+   {
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MOOF);
+      module->fragment.moof_size = STREAM_POSITION(p_ctx);
+   }
+   vc_container_writer_extraio_disable(p_ctx, &module->null);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   data_offset = module->fragment.moof_size + 8;
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      track_module = p_ctx->tracks[i]->priv->module;
+      if(!track_module->fragment.traf_number) continue;
+      track_module->fragment.data_offset = data_offset;
+      data_offset += track_module->fragment.samples_size;
+   }
+
+   module->fragment.moof_offset = STREAM_POSITION(p_ctx);
+   status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MOOF);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   WRITE_U32(p_ctx, data_offset - module->fragment.moof_size, "size");
+   WRITE_FOURCC(p_ctx, VC_FOURCC('m','d','a','t'), "type");
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      track_module = p_ctx->tracks[i]->priv->module;
+      if(!track_module->fragment.traf_number) continue;
+
+      if(WRITE_BYTES(p_ctx, track_module->fragment.data, track_module->fragment.samples_size) !=
+         track_module->fragment.samples_size)
+         return STREAM_STATUS(p_ctx);
+
+      if(track_module->fragment.samples[0].sync)
+         mp4_writer_fragment_index_add(track_module, module->fragment.moof_offset);
+   }
+
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+/** Write out all the samples which have been buffered. The next sample, if known,
+ * gives us the exact duration of the last sample of its track. */
+static VC_CONTAINER_STATUS_T mp4_writer_fragment_flush( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_PACKET_T *next )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_TRACK_MODULE_T *track_module;
+   unsigned int i;
+
+   if(next)
+   {
+      track_module = p_ctx->tracks[next->track]->priv->module;
+      track_module->fragment.next_dts =
+         mp4_writer_fragment_time(track_module, mp4_writer_packet_time(next));
+   }
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+      if(p_ctx->tracks[i]->priv->module->fragment.num)
+         mp4_writer_fragment_prepare(p_ctx, p_ctx->tracks[i]);
+
+   /* CMAF fragments only contain a single track */
+   if(module->cmaf)
+      for(i = 0; i < p_ctx->tracks_num && status == VC_CONTAINER_SUCCESS; i++)
+         status = mp4_writer_write_fragment(p_ctx, i);
+   else
+      status = mp4_writer_write_fragment(p_ctx, -1);
+
+   /* Only keep the start of any sample which isn't complete yet */
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      track_module = p_ctx->tracks[i]->priv->module;
+      memmove(track_module->fragment.data,
+              track_module->fragment.data + track_module->fragment.samples_size,
+              track_module->fragment.data_size - track_module->fragment.samples_size);
+      track_module->fragment.data_size -= track_module->fragment.samples_size;
+      track_module->fragment.samples_size = 0;
+      track_module->fragment.num = 0;
+      track_module->fragment.next_dts = -1;
+   }
+
+   module->fragment.start_time = VC_CONTAINER_TIME_UNKNOWN;
+   return status;
+}
+
+/*****************************************************************************/
+/** Check whether the sample starting with this packet should go in a new fragment */
+static bool mp4_writer_fragment_due( VC_CONTAINER_T *p_ctx, VC_CONTAINER_PACKET_T *packet )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_T *track = p_ctx->tracks[packet->track];
+   size_t size = 0;
+   unsigned int i;
+
+   if(module->fragment.start_time == VC_CONTAINER_TIME_UNKNOWN)
+      return false; /* Nothing to write yet */
+
+   /* Don't let the fragment grow too big if the keyframes are far apart */
+   for(i = 0; i < p_ctx->tracks_num; i++)
+      size += p_ctx->tracks[i]->priv->module->fragment.data_size;
+   if(size >= MP4_FRAGMENT_DATA_MAX)
+      return true;
+
+   if(packet->track != module->fragment.ref_track)
+      return false;
+   if(track->format->es_type == VC_CONTAINER_ES_TYPE_VIDEO &&
+      !(packet->flags & VC_CONTAINER_PACKET_FLAG_KEYFRAME))
+      return false;
+
+   return mp4_writer_packet_time(packet) - module->fragment.start_time >= module->fragment.duration;
+}
+
+/*****************************************************************************/
+/** Finish off a fragmented file with the random access information */
+static VC_CONTAINER_STATUS_T mp4_writer_fragment_finalise( VC_CONTAINER_T *p_ctx )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    VC_CONTAINER_STATUS_T status;
+   int64_t duration = 0, end;
+   unsigned int i;
+
+   status = mp4_writer_fragment_flush(p_ctx, 0);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   /* The mfro box at the end of the mfra has to give the size of the mfra */
+   if(!vc_container_writer_extraio_enable(p_ctx, &module->null))
+   {
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MFRA);
+      module->fragment.mfra_size = STREAM_POSITION(p_ctx);
+   }
+   vc_container_writer_extraio_disable(p_ctx, &module->null);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MFRA);
+   if(status != VC_CONTAINER_SUCCESS || !module->fragment.mehd_offset) return status;
+
+   /* Now we know how long the movie is */
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[i]->priv->module;
+      end = track_module->fragment.end_dts * MP4_TIMESCALE / track_module->timescale;
+      if(end > duration) duration = end;
+   }
+   p_ctx->duration = duration * 1000000 / MP4_TIMESCALE;
+
+   SEEK(p_ctx, module->fragment.mehd_offset);
+   WRITE_U64(p_ctx, duration, "fragment_duration");
+   return STREAM_STATUS(p_ctx);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_writer_close( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    int64_t mdat_size;
+   unsigned int i;
 
-   mdat_size = STREAM_POSITION(p_ctx) - module->mdat_offset;
+   if(module->fragmented)
+   {
+      /* Everything but the last fragment has already been written */
+      if(!module->tracks_add_done)
+         status = mp4_writer_add_track_done(p_ctx);
+      if(status == VC_CONTAINER_SUCCESS)
+         status = mp4_writer_fragment_finalise(p_ctx);
+   }
+   else
+   {
+      mdat_size = STREAM_POSITION(p_ctx) - module->mdat_offset;
 
-   /* Write the moov box */
-   status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MOOV);
+      /* Write the moov box */
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MOOV);
+      for(i = 0; i < p_ctx->tracks_num; i++)
+      {
+         if(!p_ctx->tracks[i]->priv->module->annexb.enabled ||
+            p_ctx->tracks[i]->format->extradata_size) continue;
+         LOG_ERROR(p_ctx, "mp4: no SPS and PPS found for Annex-B H.264 track %u", i);
+         if(status == VC_CONTAINER_SUCCESS) status = VC_CONTAINER_ERROR_FORMAT_INVALID;
+      }
 
-   /* Finalise the mdat box */
-   SEEK(p_ctx, module->mdat_offset);
-   WRITE_U32(p_ctx, (uint32_t)mdat_size, "mdat size" );
+      /* Finalise the mdat box */
+      SEEK(p_ctx, module->mdat_offset);
+      WRITE_U32(p_ctx, (uint32_t)mdat_size, "mdat size" );
+      if(status == VC_CONTAINER_SUCCESS) status = STREAM_STATUS(p_ctx);
+   }
 
    for(; p_ctx->tracks_num > 0; p_ctx->tracks_num--)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *track_module = p_ctx->tracks[p_ctx->tracks_num-1]->priv->module;
+      free(track_module->fragment.samples);
+      free(track_module->fragment.data);
+      free(track_module->fragment.index);
+      free(track_module->annexb.data);
+      free(track_module->annexb.sample);
       vc_container_free_track(p_ctx, p_ctx->tracks[p_ctx->tracks_num-1]);
+   }
 
-   vc_container_writer_extraio_delete(p_ctx, &module->temp);
+   if(module->temp.io) vc_container_writer_extraio_delete(p_ctx, &module->temp);
    vc_container_writer_extraio_delete(p_ctx, &module->null);
    free(module);
 
    return status;
 }
 
+/*****************************************************************************/
+/** Finds the parameter sets of the given NAL unit type in NAL units preceded by their
+ * 4 byte size, and copies them to dst (if not null) each preceded by its 2 byte size
+ * as in the avcC record. Returns the number of parameter sets. */
+static unsigned int mp4_writer_avcc_parameter_sets( const uint8_t *data, size_t size,
+   unsigned int type, unsigned int max, uint8_t *dst, size_t *dst_size )
+{
+   unsigned int count = 0;
+   size_t i, nal_size;
+
+   *dst_size = 0;
+   for(i = 0; i + 4 < size && count < max; i += 4 + nal_size)
+   {
+      nal_size = ((uint32_t)data[i] << 24) | (data[i+1] << 16) | (data[i+2] << 8) | data[i+3];
+      if(nal_size > size - i - 4) break;
+
+      /* The avcC record takes its profile and level from the first SPS */
+      if((data[i+4] & 0x1F) != type || nal_size > 0xFFFF || (type == 7 && nal_size < 4))
+         continue;
+
+      if(dst)
+      {
+         dst[*dst_size] = (uint8_t)(nal_size >> 8);
+         dst[*dst_size + 1] = (uint8_t)nal_size;
+         memcpy(dst + *dst_size + 2, data + i + 4, nal_size);
+      }
+      *dst_size += 2 + nal_size;
+      count++;
+   }
+
+   return count;
+}
+
+/*****************************************************************************/
+/** Builds the avcC record of a track out of the SPS and PPS found in NAL units
+ * preceded by their 4 byte size. The extradata is left empty if there are none. */
+static VC_CONTAINER_STATUS_T mp4_writer_avcc_create( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_TRACK_T *track, const uint8_t *data, size_t size )
+{
+   VC_CONTAINER_STATUS_T status;
+   unsigned int sps_num, pps_num;
+   size_t sps_size, pps_size;
+   uint8_t *record;
+
+   track->format->extradata_size = 0;
+   sps_num = mp4_writer_avcc_parameter_sets(data, size, 7, 31, 0, &sps_size);
+   pps_num = mp4_writer_avcc_parameter_sets(data, size, 8, 255, 0, &pps_size);
+   if(!sps_num || !pps_num) return VC_CONTAINER_SUCCESS;
+
+   status = vc_container_track_allocate_extradata(p_ctx, track, 7 + sps_size + pps_size);
+   if(status != VC_CONTAINER_SUCCESS) return status;
+
+   record = track->format->extradata;
+   mp4_writer_avcc_parameter_sets(data, size, 7, 31, record + 6, &sps_size);
+   record[0] = 1;                 /* configurationVersion */
+   record[1] = record[9];         /* AVCProfileIndication */
+   record[2] = record[10];        /* profile_compatibility */
+   record[3] = record[11];        /* AVCLevelIndication */
+   record[4] = 0xFC | (4 - 1);    /* lengthSizeMinusOne */
+   record[5] = 0xE0 | sps_num;
+   record[6 + sps_size] = pps_num;
+   mp4_writer_avcc_parameter_sets(data, size, 8, 255, record + 7 + sps_size, &pps_size);
+   track->format->extradata_size = 7 + sps_size + pps_size;
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Sets up the conversion of an Annex-B H.264 track into avcC samples. The avcC record
+ * is built from the SPS and PPS in the extradata, or from the first access unit which
+ * has them. The moov of a fragmented file is written before any sample so these need
+ * to be in the extradata. */
+static VC_CONTAINER_STATUS_T mp4_writer_annexb_add_track( VC_CONTAINER_T *p_ctx,
+   VC_CONTAINER_TRACK_T *track )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   size_t size = track->format->extradata_size, max = size + size / 4 + 4;
+   uint8_t *data;
+
+   track->priv->module->annexb.enabled = true;
+   track->format->codec_variant = VC_FOURCC('a','v','c','C');
+
+   /* Extradata which already is an avcC record is kept as it is */
+   if(size && track->format->extradata[0] == 1) return VC_CONTAINER_SUCCESS;
+
+   if(size)
+   {
+      data = malloc(max);
+      if(!data) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      size = vc_container_nal_annexb_to_avcc(data, max, track->format->extradata, size, 4);
+      status = mp4_writer_avcc_create(p_ctx, track, data, size);
+      free(data);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   if(!track->format->extradata_size && module->fragmented)
+   {
+      LOG_ERROR(p_ctx, "mp4: fragmented Annex-B H.264 needs its SPS and PPS in the extradata");
+      return VC_CONTAINER_ERROR_TRACK_FORMAT_NOT_SUPPORTED;
+   }
+
+   return VC_CONTAINER_SUCCESS;
+}
+
 /*****************************************************************************/
 static VC_CONTAINER_STATUS_T mp4_writer_add_track( VC_CONTAINER_T *p_ctx, VC_CONTAINER_ES_FORMAT_T *format )
 {
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    VC_CONTAINER_STATUS_T status;
    VC_CONTAINER_TRACK_T *track;
    uint32_t type = 0;
@@ -1188,7 +2035,9 @@ static VC_CONTAINER_STATUS_T mp4_writer_add_track( VC_CONTAINER_T *p_ctx, VC_CON
    case VC_CONTAINER_CODEC_JPEG:   type = VC_FOURCC('m','p','4','v'); break;
    case VC_CONTAINER_CODEC_H263:   type = VC_FOURCC('s','2','6','3'); break;
    case VC_CONTAINER_CODEC_H264:
-      if(format->codec_variant == VC_FOURCC('a','v','c','C')) type = VC_FOURCC('a','v','c','1'); break;
+      /* Annex-B byte streams are converted into avcC samples */
+      if(format->codec_variant == VC_FOURCC('a','v','c','C') ||
+         format->codec_variant == VC_CONTAINER_VARIANT_H264_DEFAULT) type = VC_FOURCC('a','v','c','1'); break;
    case VC_CONTAINER_CODEC_MJPEG:  type = VC_FOURCC('j','p','e','g'); break;
    case VC_CONTAINER_CODEC_MJPEGA: type = VC_FOURCC('m','j','p','a'); break;
    case VC_CONTAINER_CODEC_MJPEGB: type = VC_FOURCC('m','j','p','b'); break;
@@ -1215,6 +2064,23 @@ static VC_CONTAINER_STATUS_T mp4_writer_add_track( VC_CONTAINER_T *p_ctx, VC_CON
    vc_container_format_copy(track->format, format, format->extradata_size);
    track->priv->module->fourcc = type;
    track->priv->module->offset = -1;
+   track->priv->module->fragment.next_dts = -1;
+
+   if(format->codec == VC_CONTAINER_CODEC_H264 &&
+      format->codec_variant == VC_CONTAINER_VARIANT_H264_DEFAULT)
+   {
+      status = mp4_writer_annexb_add_track(p_ctx, track);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+   }
+
+   /* Fragments carry the exact timing of every sample so use a timescale which can
+    * represent it */
+   track->priv->module->timescale = MP4_TIMESCALE;
+   if(module->fragmented && format->es_type == VC_CONTAINER_ES_TYPE_VIDEO)
+      track->priv->module->timescale = MP4_FRAGMENT_VIDEO_TIMESCALE;
+   else if(module->fragmented && format->es_type == VC_CONTAINER_ES_TYPE_AUDIO &&
+           format->type->audio.sample_rate)
+      track->priv->module->timescale = format->type->audio.sample_rate;
    track->priv->module->sample_table[MP4_SAMPLE_TABLE_STTS].entry_size = 8;
    track->priv->module->sample_table[MP4_SAMPLE_TABLE_STSZ].entry_size = 4;
    track->priv->module->sample_table[MP4_SAMPLE_TABLE_STSC].entry_size = 12;
@@ -1247,6 +2113,20 @@ static VC_CONTAINER_STATUS_T mp4_writer_add_track_done( VC_CONTAINER_T *p_ctx )
    }
    vc_container_writer_extraio_disable(p_ctx, &module->null);
 
+   /* The moov of a fragmented file only describes the tracks and can be written
+    * straight away */
+   if(status == VC_CONTAINER_SUCCESS && module->fragmented)
+   {
+      unsigned int i;
+      for(i = 0; i < p_ctx->tracks_num; i++)
+      {
+         if(p_ctx->tracks[i]->format->es_type != VC_CONTAINER_ES_TYPE_VIDEO) continue;
+         module->fragment.ref_track = i;
+         break;
+      }
+      status = mp4_write_box(p_ctx, MP4_BOX_TYPE_MOOV);
+   }
+
    if(status == VC_CONTAINER_SUCCESS) module->tracks_add_done = true;
    return status;
 }
@@ -1319,28 +2199,28 @@ static VC_CONTAINER_STATUS_T mp4_writer_add_sample( VC_CONTAINER_T *p_ctx,
 }
 
 /*****************************************************************************/
-static VC_CONTAINER_STATUS_T mp4_writer_write( VC_CONTAINER_T *p_ctx,
-                                               VC_CONTAINER_PACKET_T *packet )
+static VC_CONTAINER_STATUS_T mp4_writer_write_sample( VC_CONTAINER_T *p_ctx,
+                                                      VC_CONTAINER_PACKET_T *packet )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    VC_CONTAINER_PACKET_T *sample = &module->sample;
    VC_CONTAINER_STATUS_T status;
 
-   if(!module->tracks_add_done)
-   {
-      status = mp4_writer_add_track_done(p_ctx);
-      if(status != VC_CONTAINER_SUCCESS) return status;
-   }
-
    if(packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
       ++module->samples; /* Switching to a new sample */
 
    if(packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
    {
+      if(module->fragmented && mp4_writer_fragment_due(p_ctx, packet))
+      {
+         status = mp4_writer_fragment_flush(p_ctx, packet);
+         if(status != VC_CONTAINER_SUCCESS) return status;
+      }
+
       module->sample_offset = STREAM_POSITION(p_ctx);
       sample->size = packet->size;
       sample->pts = packet->pts;
-      sample->dts = packet->pts;
+      sample->dts = module->fragmented ? mp4_writer_packet_time(packet) : packet->pts;
       sample->track = packet->track;
       sample->flags = packet->flags;
    }
@@ -1350,6 +2230,19 @@ static VC_CONTAINER_STATUS_T mp4_writer_write( VC_CONTAINER_T *p_ctx,
       sample->flags |= packet->flags;
    }
 
+   if(module->fragmented)
+   {
+      /* The data is kept until the whole fragment can be written */
+      status = mp4_writer_fragment_add_data(p_ctx->tracks[packet->track]->priv->module,
+                                            packet->data, packet->size);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+      p_ctx->size += packet->size;
+
+      if(packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME_END)
+         return mp4_writer_fragment_add_sample(p_ctx, sample);
+      return VC_CONTAINER_SUCCESS;
+   }
+
    if(WRITE_BYTES(p_ctx, packet->data, packet->size) != packet->size)
       return STREAM_STATUS(p_ctx); // TODO do something
    p_ctx->size += packet->size;
@@ -1364,6 +2257,87 @@ static VC_CONTAINER_STATUS_T mp4_writer_write( VC_CONTAINER_T *p_ctx,
    return VC_CONTAINER_SUCCESS;
 }
 
+/*****************************************************************************/
+/** Gathers the packets of an Annex-B H.264 access unit and writes it as a single
+ * avcC sample once it is complete */
+static VC_CONTAINER_STATUS_T mp4_writer_write_annexb( VC_CONTAINER_T *p_ctx,
+                                                      VC_CONTAINER_PACKET_T *packet )
+{
+   VC_CONTAINER_TRACK_T *track = p_ctx->tracks[packet->track];
+   VC_CONTAINER_TRACK_MODULE_T *track_module = track->priv->module;
+   VC_CONTAINER_PACKET_T *sample = &track_module->annexb.packet;
+   VC_CONTAINER_STATUS_T status;
+   const uint8_t *data = packet->data;
+   size_t size = packet->size, max;
+
+   if(packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
+   {
+      *sample = *packet;
+      track_module->annexb.data_size = 0;
+   }
+   else
+      sample->flags |= packet->flags;
+
+   /* NAL units can span packets so the access unit is converted as a whole */
+   if((packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME) != VC_CONTAINER_PACKET_FLAG_FRAME)
+   {
+      status = mp4_writer_buffer_append(&track_module->annexb.data, &track_module->annexb.data_size,
+                                        &track_module->annexb.data_max, packet->data, packet->size);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+      if(!(packet->flags & VC_CONTAINER_PACKET_FLAG_FRAME_END)) return VC_CONTAINER_SUCCESS;
+      data = track_module->annexb.data;
+      size = track_module->annexb.data_size;
+   }
+
+   /* A 4 byte size replaces each start code, which can be 3 bytes long */
+   max = size + size / 4 + 4;
+   if(max > track_module->annexb.sample_max)
+   {
+      uint8_t *buffer = realloc(track_module->annexb.sample, max);
+      if(!buffer) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      track_module->annexb.sample = buffer;
+      track_module->annexb.sample_max = max;
+   }
+
+   size = vc_container_nal_annexb_to_avcc(track_module->annexb.sample, max, data, size, 4);
+   if(!size)
+   {
+      LOG_ERROR(p_ctx, "mp4: no NAL unit found in access unit (pts %"PRIi64")", sample->pts);
+      return VC_CONTAINER_ERROR_FORMAT_INVALID;
+   }
+
+   if(!track->format->extradata_size)
+   {
+      status = mp4_writer_avcc_create(p_ctx, track, track_module->annexb.sample, size);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   sample->data = track_module->annexb.sample;
+   sample->size = sample->buffer_size = size;
+   sample->flags |= VC_CONTAINER_PACKET_FLAG_FRAME;
+   return mp4_writer_write_sample(p_ctx, sample);
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T mp4_writer_write( VC_CONTAINER_T *p_ctx,
+                                               VC_CONTAINER_PACKET_T *packet )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+
+   if(!module->tracks_add_done)
+   {
+      status = mp4_writer_add_track_done(p_ctx);
+      if(status != VC_CONTAINER_SUCCESS) return status;
+   }
+
+   if(packet->track < p_ctx->tracks_num &&
+      p_ctx->tracks[packet->track]->priv->module->annexb.enabled)
+      return mp4_writer_write_annexb(p_ctx, packet);
+
+   return mp4_writer_write_sample(p_ctx, packet);
+}
+
 /******************************************************************************
 Global function definitions.
 ******************************************************************************/
@@ -1372,6 +2346,7 @@ VC_CONTAINER_STATUS_T mp4_writer_open( VC_CONTAINER_T *p_ctx )
 {
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
    const char *extension = vc_uri_path_extension(p_ctx->priv->uri);
+   const char *fragment = 0;
    VC_CONTAINER_MODULE_T *module = 0;
    MP4_BRAND_T brand;
 
@@ -1383,7 +2358,8 @@ VC_CONTAINER_STATUS_T mp4_writer_open( VC_CONTAINER_T *p_ctx )
       return VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
    if(strcasecmp(extension, "3gp") && strcasecmp(extension, "skm") &&
       strcasecmp(extension, "mov") && strcasecmp(extension, "mp4") &&
-      strcasecmp(extension, "m4v") && strcasecmp(extension, "m4a"))
+      strcasecmp(extension, "m4v") && strcasecmp(extension, "m4a") &&
+      strcasecmp(extension, "cmfv") && strcasecmp(extension, "cmfa"))
       return VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
 
    /* Allocate our context */
@@ -1400,22 +2376,41 @@ VC_CONTAINER_STATUS_T mp4_writer_open( VC_CONTAINER_T *p_ctx )
    else brand = MP4_BRAND_ISOM;
    module->brand = brand;
 
+   /* Check whether movie fragments have been requested, e.g. "file.mp4?fragment=2000"
+    * starts a new fragment at the first keyframe 2s or more after the start of the
+    * previous one, and "file.mp4?cmaf" also follows the CMAF constraints */
+   if(vc_uri_find_query(p_ctx->priv->uri, 0, "fragment", &fragment))
+      module->fragmented = true;
+   if(vc_uri_find_query(p_ctx->priv->uri, 0, "cmaf", 0) ||
+      !strcasecmp(extension, "cmfv") || !strcasecmp(extension, "cmfa"))
+      module->fragmented = module->cmaf = true;
+   module->fragment.duration = (fragment && *fragment ?
+      strtoul(fragment, 0, 0) : MP4_FRAGMENT_DURATION_DEFAULT) * INT64_C(1000);
+   module->fragment.start_time = VC_CONTAINER_TIME_UNKNOWN;
+
    /* Create a null i/o writer to help us out in writing our data */
    status = vc_container_writer_extraio_create_null(p_ctx, &module->null);
    if(status != VC_CONTAINER_SUCCESS) goto error;
 
-   /* Create a temporary i/o writer to help us out in writing our data */
-   status = vc_container_writer_extraio_create_temp(p_ctx, &module->temp);
-   if(status != VC_CONTAINER_SUCCESS) goto error;
+   /* Create a temporary i/o writer to help us out in writing our data. Fragmented
+    * files don't need one since the samples are described as they are written. */
+   if(!module->fragmented)
+   {
+      status = vc_container_writer_extraio_create_temp(p_ctx, &module->temp);
+      if(status != VC_CONTAINER_SUCCESS) goto error;
+   }
 
    status = mp4_write_box(p_ctx, MP4_BOX_TYPE_FTYP);
    if(status != VC_CONTAINER_SUCCESS) goto error;
 
    /* Start the mdat box */
-   module->mdat_offset = STREAM_POSITION(p_ctx);
-   WRITE_U32(p_ctx, 0, "size");
-   WRITE_FOURCC(p_ctx, VC_FOURCC('m','d','a','t'), "type");
-   module->data_offset = STREAM_POSITION(p_ctx);
+   if(!module->fragmented)
+   {
+      module->mdat_offset = STREAM_POSITION(p_ctx);
+      WRITE_U32(p_ctx, 0, "size");
+      WRITE_FOURCC(p_ctx, VC_FOURCC('m','d','a','t'), "type");
+      module->data_offset = STREAM_POSITION(p_ctx);
+   }
 
    p_ctx->priv->pf_close = mp4_writer_close;
    p_ctx->priv->pf_write = mp4_writer_write;
@@ -35,6 +35,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_io_helpers.h"
 #include "containers/core/containers_utils.h"
 #include "containers/core/containers_logging.h"
+#include "containers/core/containers_index.h"
+#include "containers/packetizers.h"
+#include "interface/vcos/vcos.h"
 #undef CONTAINER_HELPER_LOG_INDENT
 #define CONTAINER_HELPER_LOG_INDENT(a) (2*(a)->priv->module->level)
 
@@ -52,6 +55,25 @@ Defines.
     at open time or when resyncing. */
 #define PS_PACK_SCAN_MAX 128
 
+/** Number of pack positions remembered from previous seeks */
+#define PS_PROBE_INDEX_SIZE 1024
+
+/** Seeking stops probing the stream once it has found a pack this close to the
+    requested time (in microseconds) */
+#define PS_SEEK_TOLERANCE INT64_C(200000)
+
+/** Seeking also stops probing once the range of possible positions is that small,
+    or after that many probes */
+#define PS_SEEK_RANGE_MIN (16*1024)
+#define PS_SEEK_PROBES_MAX 32
+
+/** Size of the buffer used by the keyframe indexer to go through the stream */
+#define PS_INDEX_BUFFER_SIZE (128*1024)
+
+/** Number of recent video PES packets the keyframe indexer keeps track of to
+    find out where a keyframe started */
+#define PS_INDEX_PES_MAX 32
+
 /******************************************************************************
 Type definitions.
 ******************************************************************************/
@@ -70,6 +92,13 @@ typedef struct VC_CONTAINER_TRACK_MODULE_T
 
 } VC_CONTAINER_TRACK_MODULE_T;
 
+/** Position of a keyframe found by the keyframe indexer */
+typedef struct PS_KEYFRAME_T
+{
+   int64_t time;        /**< Presentation time of the keyframe, in microseconds */
+   uint64_t offset;     /**< Offset to the pack containing its first PES packet */
+} PS_KEYFRAME_T;
+
 typedef struct VC_CONTAINER_MODULE_T
 {
    /** Logging indentation level */
@@ -117,7 +146,28 @@ typedef struct VC_CONTAINER_MODULE_T
    int64_t packet_pts;
    int64_t packet_dts;
    int packet_track;
-   
+
+   /** Times and positions of the packs found while seeking, which narrow down
+       the search on the following seeks */
+   VC_CONTAINER_INDEX_T *probe_index;
+
+   /** Keyframe index built in the background (see VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE) */
+   struct
+   {
+      uint32_t max_size;      /**< Maximum size of the index in bytes */
+      PS_KEYFRAME_T *entries;
+      unsigned int num;
+      unsigned int max;
+      uint32_t stream_id;     /**< Video stream being indexed */
+      bool scanning;
+      volatile bool scan_done;
+      volatile bool scan_stop;
+      VC_CONTAINER_IO_T *io;  /**< Separate i/o used by the indexer */
+      VC_PACKETIZER_T *packetizer;
+      VCOS_THREAD_T thread;
+      VCOS_MUTEX_T lock;
+   } index;
+
 } VC_CONTAINER_MODULE_T;
 
 /******************************************************************************
@@ -977,6 +1027,452 @@ STATIC_INLINE VC_CONTAINER_STATUS_T ps_find_pes_packet( VC_CONTAINER_T *ctx )
    return status;
 }
 
+/*****************************************************************************/
+/** Decode a 33 bits timestamp coded like a PTS or an MPEG-1 system_clock_reference */
+STATIC_INLINE int64_t ps_decode_timestamp( const uint8_t *data )
+{
+   return ((int64_t)(data[0] & 0x0E) << 29) | (data[1] << 22) |
+      ((data[2] & 0xFE) << 14) | (data[3] << 7) | (data[4] >> 1);
+}
+
+/*****************************************************************************/
+/** Decode the system_clock_reference (in 27MHz ticks) of a pack header,
+    without touching the reader state */
+static bool ps_decode_scr( const uint8_t *data, int64_t *p_scr )
+{
+   if ((data[0] & 0xC4) == 0x44) /* program stream */
+   {
+      int64_t scr_base;
+      if (!(data[2] & 0x04) || !(data[4] & 0x04) || !(data[5] & 0x01)) return false;
+      scr_base = ((int64_t)(data[0] & 0x38) << 27) | ((int64_t)(data[0] & 0x03) << 28) |
+         (data[1] << 20) | ((data[2] & 0xF8) << 12) | ((data[2] & 0x03) << 13) |
+         (data[3] << 5) | (data[4] >> 3);
+      *p_scr = scr_base * INT64_C(300) + (((data[4] & 0x03) << 7) | (data[5] >> 1));
+      return true;
+   }
+
+   if ((data[0] & 0xF1) == 0x21) /* system stream */
+   {
+      if (!(data[2] & 0x01) || !(data[4] & 0x01)) return false;
+      *p_scr = ps_decode_timestamp(data) * INT64_C(300);
+      return true;
+   }
+
+   return false;
+}
+
+/*****************************************************************************/
+/** Find the first pack at or after the given offset and return its position and
+    the time of its system_clock_reference */
+static VC_CONTAINER_STATUS_T ps_probe_pack( VC_CONTAINER_T *ctx, uint64_t offset,
+   uint64_t *p_pack_offset, int64_t *p_time )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+   uint8_t header[10];
+   int64_t scr;
+   unsigned int i;
+
+   if ((status = SEEK(ctx, offset)) != VC_CONTAINER_SUCCESS)
+      return status;
+
+   for (i = 0; i != PS_PACK_SCAN_MAX; ++i)
+   {
+      if ((status = ps_find_start_code(ctx, header)) != VC_CONTAINER_SUCCESS)
+         return status;
+
+      if (header[3] == 0xBA)
+      {
+         *p_pack_offset = STREAM_POSITION(ctx);
+         if (PEEK_BYTES(ctx, header, 10) == 10 && ps_decode_scr(header + 4, &scr))
+         {
+            *p_time = (scr - module->scr_offset) / INT64_C(27);
+            return VC_CONTAINER_SUCCESS;
+         }
+         SKIP_BYTES(ctx, 4);
+      }
+      else
+      {
+         /* Skip PES packet */
+         SKIP_BYTES(ctx, 4);
+         SKIP_BYTES(ctx, READ_U16(ctx, "PES packet length"));
+      }
+   }
+
+   return VC_CONTAINER_ERROR_NOT_FOUND;
+}
+
+/*****************************************************************************/
+/** Find the pack to start reading from to get to the given time. The duration
+    based estimate can be quite inaccurate on variable bitrate streams so we
+    home in on the requested time by probing the system_clock_reference of the
+    packs and narrowing down the range they can be in. */
+static uint64_t ps_seek_bisect( VC_CONTAINER_T *ctx, int64_t time, VC_CONTAINER_SEEK_FLAGS_T flags )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   int64_t low = module->data_offset, high = module->data_offset + module->data_size;
+   int64_t low_time = 0, high_time = MAX(ctx->duration, time + 1);
+   int64_t entry_time, entry_offset, pack_time;
+   bool forward = !!(flags & VC_CONTAINER_SEEK_FLAG_FORWARD), high_is_pack = false;
+   uint64_t pack_offset;
+   unsigned int probes;
+   int past;
+
+   /* Start with the closest packs found on previous seeks */
+   entry_time = time;
+   if (vc_container_index_get(module->probe_index, 0, &entry_time, &entry_offset, &past) ==
+          VC_CONTAINER_SUCCESS && entry_time <= time && entry_offset > low)
+   {
+      low = entry_offset;
+      low_time = entry_time;
+   }
+   entry_time = time;
+   if (vc_container_index_get(module->probe_index, 1, &entry_time, &entry_offset, &past) ==
+          VC_CONTAINER_SUCCESS && entry_time > time && entry_offset < high)
+   {
+      high = entry_offset;
+      high_time = entry_time;
+      high_is_pack = true;
+   }
+
+   for (probes = 0; probes != PS_SEEK_PROBES_MAX; ++probes)
+   {
+      int64_t offset, range = high - low;
+
+      /* Stop once we're close enough */
+      if (!forward && time - low_time <= PS_SEEK_TOLERANCE)
+         break;
+      if (forward && high_is_pack && high_time - time <= PS_SEEK_TOLERANCE)
+         break;
+      if (range <= PS_SEEK_RANGE_MIN)
+         break;
+
+      /* Interpolate between both ends of the range, without getting too close to either */
+      if (high_time > low_time)
+         offset = low + (int64_t)((double)(time - low_time) * range / (high_time - low_time));
+      else
+         offset = low + range / 2;
+      offset = MAX(offset, low + range / 8);
+      offset = MIN(offset, high - range / 8);
+
+      if (ps_probe_pack(ctx, offset, &pack_offset, &pack_time) != VC_CONTAINER_SUCCESS ||
+          (int64_t)pack_offset >= high)
+      {
+         /* No pack between there and the end of the range */
+         high = offset;
+         continue;
+      }
+
+      vc_container_index_insert(module->probe_index, pack_time, pack_offset);
+
+      if (pack_time <= time)
+      {
+         low = pack_offset;
+         low_time = pack_time;
+      }
+      else
+      {
+         high = pack_offset;
+         high_time = pack_time;
+         high_is_pack = true;
+      }
+   }
+
+   LOG_DEBUG(ctx, "seek to %"PRId64" took %u probes (pack at %"PRId64")", time, probes,
+             forward && high_is_pack ? high_time : low_time);
+   return forward && high_is_pack ? high : low;
+}
+
+/*****************************************************************************/
+/** Look up the keyframe to seek to in the keyframe index, waiting for the indexer
+    to get there if need be. Returns VC_CONTAINER_ERROR_NOT_FOUND if there is no
+    index to use. */
+static VC_CONTAINER_STATUS_T ps_index_find( VC_CONTAINER_T *ctx, int64_t *p_time,
+   VC_CONTAINER_SEEK_FLAGS_T flags, uint64_t *p_offset )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_NOT_FOUND;
+   const PS_KEYFRAME_T *entry;
+   unsigned int low, high, mid;
+
+   if (!module->index.scanning || !module->index.max_size)
+      return VC_CONTAINER_ERROR_NOT_FOUND;
+
+   /* Wait until the keyframes around the requested time have been indexed */
+   while (!module->index.scan_done)
+   {
+      bool found;
+      vcos_mutex_lock(&module->index.lock);
+      found = module->index.num && module->index.entries[module->index.num - 1].time > *p_time;
+      vcos_mutex_unlock(&module->index.lock);
+      if (found) break;
+      vcos_sleep(1);
+   }
+
+   vcos_mutex_lock(&module->index.lock);
+
+   /* Find the first keyframe after the requested time */
+   for (low = 0, high = module->index.num; low < high; )
+   {
+      mid = low + (high - low) / 2;
+      if (module->index.entries[mid].time > *p_time) high = mid;
+      else low = mid + 1;
+   }
+
+   /* Without a keyframe on the right side of the requested time, let the caller
+      find the nearest pack instead */
+   if (!(flags & VC_CONTAINER_SEEK_FLAG_FORWARD))
+      entry = low ? &module->index.entries[low - 1] : 0;
+   else
+      entry = low < module->index.num ? &module->index.entries[low] : 0;
+
+   if (entry)
+   {
+      *p_time = entry->time;
+      *p_offset = entry->offset;
+      status = VC_CONTAINER_SUCCESS;
+   }
+
+   vcos_mutex_unlock(&module->index.lock);
+   return status;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ps_index_add( VC_CONTAINER_MODULE_T *module, int64_t time, uint64_t offset )
+{
+   PS_KEYFRAME_T *entry;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+
+   vcos_mutex_lock(&module->index.lock);
+
+   /* Keyframes are found in decoding order so make sure the index stays sorted */
+   if (module->index.num && module->index.entries[module->index.num - 1].time >= time)
+      goto end;
+
+   if (module->index.num == module->index.max)
+   {
+      unsigned int max = module->index.max ? module->index.max * 2 : 1024;
+      if ((uint64_t)max * sizeof(*entry) > module->index.max_size)
+         max = module->index.max_size / sizeof(*entry);
+      if (max <= module->index.num) { status = VC_CONTAINER_ERROR_OUT_OF_RESOURCES; goto end; }
+
+      entry = realloc(module->index.entries, max * sizeof(*entry));
+      if (!entry) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto end; }
+      module->index.entries = entry;
+      module->index.max = max;
+   }
+
+   entry = &module->index.entries[module->index.num++];
+   entry->time = time;
+   entry->offset = offset;
+
+end:
+   vcos_mutex_unlock(&module->index.lock);
+   return status;
+}
+
+/*****************************************************************************/
+/** Feed the payload of a video PES packet to the packetizer and record the
+    position of the keyframes it finds */
+static VC_CONTAINER_STATUS_T ps_index_pes_packet( VC_CONTAINER_T *ctx, uint8_t *data,
+   unsigned int length, uint64_t offset, PS_KEYFRAME_T *pes, unsigned int *pes_num )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_PACKET_T packet, *p_packet = &packet;
+   int64_t pts = VC_CONTAINER_TIME_UNKNOWN;
+   unsigned int i = 0;
+
+   /* Parse just enough of the PES packet header to get to the PTS and payload */
+   if (length >= 3 && (data[0] & 0xC0) == 0x80) /* program stream */
+   {
+      if (3u + data[2] > length) return VC_CONTAINER_SUCCESS;
+      if ((data[1] & 0x80) && data[2] >= 5) pts = ps_decode_timestamp(data + 3);
+      i = 3 + data[2];
+   }
+   else /* MPEG 1 PES header */
+   {
+      while (i < length && data[i] == 0xFF) i++;
+      if (i < length && (data[i] & 0xC0) == 0x40) i += 2;
+      if (i >= length) return VC_CONTAINER_SUCCESS;
+      if ((data[i] & 0xE0) == 0x20)
+      {
+         if (i + 5 > length) return VC_CONTAINER_SUCCESS;
+         pts = ps_decode_timestamp(data + i);
+         i += (data[i] & 0x10) ? 10 : 5;
+      }
+      else i++;
+      if (i > length) return VC_CONTAINER_SUCCESS;
+   }
+
+   if (pts != VC_CONTAINER_TIME_UNKNOWN)
+   {
+      pts = (INT64_C(300) * pts - module->scr_offset) / INT64_C(27);
+      pes[*pes_num % PS_INDEX_PES_MAX].time = pts;
+      pes[*pes_num % PS_INDEX_PES_MAX].offset = offset;
+      (*pes_num)++;
+   }
+
+   memset(&packet, 0, sizeof(packet));
+   packet.data = data + i;
+   packet.size = packet.buffer_size = length - i;
+   packet.pts = pts;
+   packet.dts = VC_CONTAINER_TIME_UNKNOWN;
+   vc_packetizer_push(module->index.packetizer, p_packet);
+   vc_packetizer_pop(module->index.packetizer, &p_packet, VC_PACKETIZER_FLAG_FORCE_RELEASE_INPUT);
+
+   memset(&packet, 0, sizeof(packet));
+   while (status == VC_CONTAINER_SUCCESS &&
+          vc_packetizer_read(module->index.packetizer, &packet, VC_PACKETIZER_FLAG_SKIP) == VC_CONTAINER_SUCCESS)
+   {
+      if (!(packet.flags & VC_CONTAINER_PACKET_FLAG_KEYFRAME) || packet.pts == VC_CONTAINER_TIME_UNKNOWN)
+         continue;
+
+      /* Find the PES packet the keyframe started in */
+      for (i = 0; i < PS_INDEX_PES_MAX && i < *pes_num; i++)
+      {
+         const PS_KEYFRAME_T *entry = &pes[(*pes_num - 1 - i) % PS_INDEX_PES_MAX];
+         if (entry->time != packet.pts) continue;
+         status = ps_index_add(module, entry->time, entry->offset);
+         break;
+      }
+   }
+
+   return status;
+}
+
+/*****************************************************************************/
+/** Background thread building the keyframe index by going through the whole
+    stream with its own i/o */
+static void *ps_index_thread( void *arg )
+{
+   VC_CONTAINER_T *ctx = arg;
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_IO_T *io = module->index.io;
+   PS_KEYFRAME_T pes[PS_INDEX_PES_MAX];
+   uint64_t offset = module->data_offset, pack_offset = module->data_offset;
+   unsigned int pes_num = 0;
+   size_t size = 0, pos = 0;
+   uint8_t *data;
+
+   data = malloc(PS_INDEX_BUFFER_SIZE);
+   if (!data || vc_container_io_seek(io, offset) != VC_CONTAINER_SUCCESS)
+      goto end;
+
+   while (!module->index.scan_stop)
+   {
+      unsigned int length, needed = 6;
+      uint8_t *p;
+
+      /* Make sure the buffer has the whole header or packet we're looking at */
+      if (size - pos >= 6 && !data[pos] && !data[pos + 1] && data[pos + 2] == 0x1)
+      {
+         if (data[pos + 3] == 0xBA)
+            needed = 14;
+         else if (data[pos + 3] == module->index.stream_id)
+            needed = 6 + ((data[pos + 4] << 8) | data[pos + 5]);
+      }
+      if (size - pos < needed)
+      {
+         memmove(data, data + pos, size - pos);
+         offset += pos;
+         size -= pos;
+         pos = 0;
+         size += vc_container_io_read(io, data + size, PS_INDEX_BUFFER_SIZE - size);
+         if (size < needed) break;
+      }
+      p = data + pos;
+
+      /* Look for the next pack or PES packet start code */
+      if (p[0] || p[1] || p[2] != 0x1 || p[3] < 0xB9)
+      {
+         for (pos++; pos + 3 < size; pos++)
+            if (!data[pos] && !data[pos + 1] && data[pos + 2] == 0x1 && data[pos + 3] >= 0xB9)
+               break;
+         continue;
+      }
+
+      if (p[3] == 0xB9) /* MPEG_program_end_code */
+         break;
+
+      if (p[3] == 0xBA)
+      {
+         pack_offset = offset + pos;
+         length = (p[4] & 0xC0) == 0x40 ? 14 + (p[13] & 0x7) : 12;
+      }
+      else
+      {
+         length = 6 + ((p[4] << 8) | p[5]);
+         if (p[3] == module->index.stream_id &&
+             ps_index_pes_packet(ctx, p + 6, length - 6, pack_offset, pes, &pes_num) != VC_CONTAINER_SUCCESS)
+            break;
+      }
+
+      /* Skip what we've just parsed */
+      if (pos + length <= size)
+      {
+         pos += length;
+         continue;
+      }
+      length -= size - pos;
+      offset += size;
+      size = pos = 0;
+      if (vc_container_io_skip(io, length) != length) break;
+      offset += length;
+   }
+
+ end:
+   LOG_DEBUG(ctx, "indexed %u keyframes", module->index.num);
+   free(data);
+   module->index.scan_done = true;
+   return NULL;
+}
+
+/*****************************************************************************/
+/** Start building the keyframe index of the first MPEG video track */
+static VC_CONTAINER_STATUS_T ps_index_start( VC_CONTAINER_T *ctx )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_TRACK_T *track = 0;
+   unsigned int i;
+
+   if (module->index.scanning)
+      return VC_CONTAINER_SUCCESS;
+
+   for (i = 0; i < ctx->tracks_num && !track; i++)
+      if (ctx->tracks[i]->format->codec == VC_CONTAINER_CODEC_MP1V ||
+          ctx->tracks[i]->format->codec == VC_CONTAINER_CODEC_MP2V)
+         track = ctx->tracks[i];
+   if (!track || !STREAM_SEEKABLE(ctx))
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+
+   module->index.stream_id = track->priv->module->stream_id;
+   module->index.packetizer = vc_packetizer_open(track->format, track->format->codec_variant, &status);
+   if (!module->index.packetizer)
+      return status;
+
+   module->index.io = vc_container_io_open(ctx->priv->io->uri, VC_CONTAINER_IO_MODE_READ, &status);
+   if (!module->index.io)
+      goto error;
+
+   if (vcos_thread_create(&module->index.thread, "ps_index", NULL, ps_index_thread, ctx) != VCOS_SUCCESS)
+   {
+      status = VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+      goto error;
+   }
+
+   module->index.scanning = true;
+   return VC_CONTAINER_SUCCESS;
+
+error:
+   if (module->index.io) vc_container_io_close(module->index.io);
+   vc_packetizer_close(module->index.packetizer);
+   module->index.io = 0;
+   module->index.packetizer = 0;
+   return status;
+}
+
 /*****************************************************************************
 Functions exported as part of the Container Module API
 *****************************************************************************/
@@ -1060,9 +1556,8 @@ static VC_CONTAINER_STATUS_T ps_reader_seek( VC_CONTAINER_T *ctx,
    VC_CONTAINER_MODULE_T *module = ctx->priv->module;
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    uint64_t seekpos, position;
-   int64_t scr;
-   
-   VC_CONTAINER_PARAM_UNUSED(flags);
+   int64_t scr, time;
+   unsigned int i;
 
    if (mode != VC_CONTAINER_SEEK_MODE_TIME || !STREAM_SEEKABLE(ctx))
       return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
@@ -1077,13 +1572,27 @@ static VC_CONTAINER_STATUS_T ps_reader_seek( VC_CONTAINER_T *ctx,
       if (!ctx->duration)
          return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
 
-      /* The following is an estimate that might be quite inaccurate */
-      seekpos = module->data_offset + (*p_offset * module->data_size) / ctx->duration;
+      /* Use the keyframe index if we've got one, otherwise search for the
+         right pack as estimating its position from the duration might be quite
+         inaccurate */
+      time = *p_offset;
+      if (ps_index_find(ctx, &time, flags, &seekpos) != VC_CONTAINER_SUCCESS)
+         seekpos = ps_seek_bisect(ctx, *p_offset, flags);
    }
 
    SEEK(ctx, seekpos);
    module->scr = module->scr_offset;
+   if (module->scr_bias == VC_CONTAINER_TIME_UNKNOWN)
+      module->scr_bias = -module->scr_offset; /* We may not have read anything yet */
    status = ps_find_pes_packet(ctx);
+
+   /* Skip the tail of frames started before that pack so we report the time
+      of the first packet that will actually be read */
+   for (i = 0; !status && module->packet_pts == VC_CONTAINER_TIME_UNKNOWN && i != PS_PACK_SCAN_MAX; ++i)
+   {
+      SKIP_BYTES(ctx, module->packet_data_size);
+      status = ps_find_pes_packet(ctx);
+   }
    if (status && status != VC_CONTAINER_ERROR_EOS)
       goto error;
 
@@ -1108,12 +1617,43 @@ static VC_CONTAINER_STATUS_T ps_reader_close( VC_CONTAINER_T *ctx )
    VC_CONTAINER_MODULE_T *module = ctx->priv->module;
    unsigned int i;
 
+   if (module->index.scanning)
+   {
+      module->index.scan_stop = true;
+      vcos_thread_join(&module->index.thread, NULL);
+   }
+   if (module->index.io) vc_container_io_close(module->index.io);
+   if (module->index.packetizer) vc_packetizer_close(module->index.packetizer);
+   free(module->index.entries);
+   vcos_mutex_delete(&module->index.lock);
+   if (module->probe_index) vc_container_index_free(module->probe_index);
+
    for(i = 0; i < ctx->tracks_num; i++)
       vc_container_free_track(ctx, ctx->tracks[i]);
    free(module);
    return VC_CONTAINER_SUCCESS;
 }
 
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ps_reader_control( VC_CONTAINER_T *ctx,
+   VC_CONTAINER_CONTROL_T operation, va_list args )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+
+   switch(operation)
+   {
+   case VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE:
+      vcos_mutex_lock(&module->index.lock);
+      module->index.max_size = va_arg(args, uint32_t);
+      vcos_mutex_unlock(&module->index.lock);
+      /* An index which is full or disabled stops the indexer */
+      return module->index.max_size ? ps_index_start(ctx) : VC_CONTAINER_SUCCESS;
+
+   default:
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   }
+}
+
 /*****************************************************************************/
 VC_CONTAINER_STATUS_T ps_reader_open( VC_CONTAINER_T *ctx )
 {
@@ -1148,6 +1688,11 @@ VC_CONTAINER_STATUS_T ps_reader_open( VC_CONTAINER_T *ctx )
    module = malloc(sizeof(*module));
    if(!module) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
    memset(module, 0, sizeof(*module));
+   if(vcos_mutex_create(&module->index.lock, "ps_index") != VCOS_SUCCESS)
+   {
+      free(module);
+      return VC_CONTAINER_ERROR_OUT_OF_RESOURCES;
+   }
    ctx->priv->module = module;
    ctx->tracks = module->tracks;
 
@@ -1170,7 +1715,10 @@ VC_CONTAINER_STATUS_T ps_reader_open( VC_CONTAINER_T *ctx )
 resync:
       LOG_DEBUG(ctx, "Lost sync, scanning for start code");
       if((status = ps_find_start_code(ctx, buffer)) != VC_CONTAINER_SUCCESS)
-         return VC_CONTAINER_ERROR_CORRUPTED;
+      {
+         status = VC_CONTAINER_ERROR_CORRUPTED;
+         goto error;
+      }
       LOG_DEBUG(ctx, "MPEG PS reader, found start code: 0x%"PRIx64" (%"PRId64"): 0x%02x%02x%02x%02x",
          STREAM_POSITION(ctx), STREAM_POSITION(ctx), buffer[0], buffer[1], buffer[2], buffer[3]);
    }
@@ -1245,11 +1793,16 @@ resync:
 
    ctx->priv->module->searching_tracks = false;
 
-   if(STREAM_SEEKABLE(ctx)) ctx->capabilities |= VC_CONTAINER_CAPS_CAN_SEEK;
+   if(STREAM_SEEKABLE(ctx))
+   {
+      ctx->capabilities |= VC_CONTAINER_CAPS_CAN_SEEK;
+      vc_container_index_create(&module->probe_index, PS_PROBE_INDEX_SIZE);
+   }
 
    ctx->priv->pf_close = ps_reader_close;
    ctx->priv->pf_read = ps_reader_read;
    ctx->priv->pf_seek = ps_reader_seek;
+   ctx->priv->pf_control = ps_reader_control;
 
    return STREAM_STATUS(ctx);
 
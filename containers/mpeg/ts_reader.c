@@ -0,0 +1,1244 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#define CONTAINER_IS_BIG_ENDIAN
+//#define ENABLE_CONTAINERS_LOG_FORMAT
+//#define ENABLE_CONTAINERS_LOG_FORMAT_VERBOSE
+#include "containers/core/containers_private.h"
+#include "containers/core/containers_io_helpers.h"
+#include "containers/core/containers_utils.h"
+#include "containers/core/containers_logging.h"
+#include "containers/core/containers_uri.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define TS_HAVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define TS_HAVE_NEON
+#endif
+
+/******************************************************************************
+Defines.
+******************************************************************************/
+#define TS_TRACKS_MAX 8
+#define TS_PID_MAX 8192
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_HEADER_SIZE 4
+
+/** Number of consecutive sync bytes needed to lock onto a packet size */
+#define TS_SYNC_PACKETS 3
+
+/** Size of the buffer the transport stream packets are read into */
+#define TS_BUFFER_SIZE (512*204)
+
+/** Largest datagram we can receive from udp:// and rtp:// inputs */
+#define TS_DATAGRAM_MAX 65536
+
+/** Amount of data scanned at open time looking for the program tables */
+#define TS_PROBE_SIZE_MAX (8*1024*1024)
+
+/** Initial and maximum size of the buffer a PES packet is reassembled into.
+    Bigger PES packets are delivered in several pieces. */
+#define TS_PES_SIZE_MIN (64*1024)
+#define TS_PES_SIZE_MAX (4*1024*1024)
+
+#define TS_SECTION_SIZE_MAX 1024
+
+/** Wrap around of the 33 bits timestamps, in 27MHz ticks */
+#define TS_CLOCK_WRAP (INT64_C(300) << 33)
+
+/** program_clock_reference jumps bigger than this (in 27MHz ticks) are handled as
+    discontinuities */
+#define TS_PCR_JUMP_MAX (INT64_C(27000000) * 10)
+
+/** Amount of data scanned for a program_clock_reference, from the end of seekable
+    streams for the duration and from where a seek probe lands */
+#define TS_PCR_SCAN_SIZE (1024*1024)
+
+/** Seeking stops probing once it has found a program_clock_reference this close
+    to the requested time (in microseconds), after that many probes or once the
+    range of possible positions is that small */
+#define TS_SEEK_TOLERANCE INT64_C(100000)
+#define TS_SEEK_PROBES_MAX 32
+#define TS_SEEK_RANGE_MIN (64*1024)
+
+/** Maximum number of PES packets without a timestamp skipped after seeking */
+#define TS_SEEK_SKIP_MAX 64
+
+/******************************************************************************
+Type definitions.
+******************************************************************************/
+typedef struct VC_CONTAINER_TRACK_MODULE_T
+{
+   uint16_t pid;
+   uint8_t stream_type;
+   uint8_t continuity_counter;   /**< Last continuity_counter, 0xFF when unknown */
+
+   /** PES packet being reassembled */
+   uint8_t *pes;
+   unsigned int pes_size;
+   unsigned int pes_max;
+   unsigned int pes_length;      /**< Size of the whole PES packet if known, 0 otherwise */
+   bool pes_started;             /**< We're in the middle of a PES packet */
+   bool pes_header;              /**< The data starts with the PES packet header */
+   uint32_t pes_flags;           /**< Packet flags for the PES packet */
+
+} VC_CONTAINER_TRACK_MODULE_T;
+
+typedef struct VC_CONTAINER_MODULE_T
+{
+   /** Track data */
+   VC_CONTAINER_TRACK_T *tracks[TS_TRACKS_MAX];
+
+   /** Size of the packets (188, 192 or 204 bytes) and offset to their sync byte
+       (4 for 192 bytes packets which start with a timestamp) */
+   unsigned int packet_size;
+   unsigned int sync_offset;
+
+   /** Input is made of datagrams (udp:// or rtp://), with an RTP header for the latter */
+   bool datagrams;
+   bool rtp;
+   uint8_t *datagram;
+
+   /** Packets read from the stream, either copied into our buffer or borrowed
+       from the i/o. Unparsed data goes from buffer_pos to buffer_end and
+       buffer_offset is the position in the stream of data[0]. */
+   const uint8_t *data;
+   uint8_t *buffer;
+   unsigned int buffer_size;
+   unsigned int buffer_pos;
+   unsigned int buffer_end;
+   int64_t buffer_offset;
+   bool eos;
+
+   /** Offset to the first packet of the stream and size of the data */
+   int64_t data_offset;
+   int64_t data_size;
+
+   /** Program specific information */
+   unsigned int program_number;
+   uint16_t pmt_pid;
+   uint16_t pcr_pid;
+   bool pmt_found;
+   bool searching_tracks;
+   uint8_t section[TS_SECTION_SIZE_MAX + 184];
+   unsigned int section_size;
+   uint16_t section_pid;
+
+   /** Most recent program_clock_reference (27MHz ticks) and the time it corresponds
+       to in our timeline, which is continuous through wrap arounds and discontinuities */
+   bool pcr_known;
+   int64_t pcr;
+   int64_t clock;
+   int64_t first_pcr;
+
+   /** PES packet being delivered. It is only part of one if it doesn't start with
+       the PES header or if the rest of it is still to come. */
+   int ready_track;
+   unsigned int ready_offset;
+   unsigned int ready_left;
+   bool ready_first;
+   bool ready_header;
+   bool ready_partial;
+   int64_t ready_pts;
+   int64_t ready_dts;
+
+   /** Statistics */
+   uint32_t sync_losses;
+   uint32_t packets_lost;
+
+   /** Index of the track for each pid, -1 if not a track we know about */
+   int8_t pid_track[TS_PID_MAX];
+
+} VC_CONTAINER_MODULE_T;
+
+/******************************************************************************
+Function prototypes
+******************************************************************************/
+VC_CONTAINER_STATUS_T ts_reader_open( VC_CONTAINER_T * );
+
+/******************************************************************************
+Local Functions
+******************************************************************************/
+
+/** Find the first position in data where there are sync bytes for TS_SYNC_PACKETS
+    consecutive packets of the given size. Returns size if there is none, in
+    which case the last (TS_SYNC_PACKETS - 1) packets haven't been fully checked. */
+static unsigned int ts_find_sync( const uint8_t *data, unsigned int size, unsigned int packet_size )
+{
+   unsigned int i = 0, span = (TS_SYNC_PACKETS - 1) * packet_size;
+
+   if (size <= span)
+      return size;
+
+#if defined(TS_HAVE_SSE2)
+   {
+      const __m128i sync = _mm_set1_epi8(TS_SYNC_BYTE);
+      for (; i + 16 + span <= size; i += 16)
+      {
+         __m128i match = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), sync);
+         int mask;
+         match = _mm_and_si128(match, _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(data + i + packet_size)), sync));
+         match = _mm_and_si128(match, _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(data + i + 2 * packet_size)), sync));
+         mask = _mm_movemask_epi8(match);
+         if (mask)
+            return i + __builtin_ctz(mask);
+      }
+   }
+#elif defined(TS_HAVE_NEON)
+   {
+      const uint8x16_t sync = vdupq_n_u8(TS_SYNC_BYTE);
+      for (; i + 16 + span <= size; i += 16)
+      {
+         uint8x16_t match = vceqq_u8(vld1q_u8(data + i), sync);
+         uint64x2_t lanes;
+         match = vandq_u8(match, vceqq_u8(vld1q_u8(data + i + packet_size), sync));
+         match = vandq_u8(match, vceqq_u8(vld1q_u8(data + i + 2 * packet_size), sync));
+         lanes = vreinterpretq_u64_u8(match);
+         if (vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1))
+            break; /* The scalar loop finds which byte it is */
+      }
+   }
+#endif
+
+   for (; i + span < size; i++)
+   {
+      const uint8_t *p = memchr(data + i, TS_SYNC_BYTE, size - span - i);
+      if (!p)
+         break;
+      i = p - data;
+      if (p[packet_size] == TS_SYNC_BYTE && p[2 * packet_size] == TS_SYNC_BYTE)
+         return i;
+   }
+
+   return size;
+}
+
+/*****************************************************************************/
+/** Difference between 2 timestamps, taking into account that they wrap around */
+STATIC_INLINE int64_t ts_clock_delta( int64_t a, int64_t b )
+{
+   int64_t delta = (a - b) % TS_CLOCK_WRAP;
+
+   if (delta >= TS_CLOCK_WRAP / 2)
+      delta -= TS_CLOCK_WRAP;
+   else if (delta < -TS_CLOCK_WRAP / 2)
+      delta += TS_CLOCK_WRAP;
+   return delta;
+}
+
+/*****************************************************************************/
+/** Decode a 33 bits PTS or DTS */
+STATIC_INLINE int64_t ts_decode_timestamp( const uint8_t *data )
+{
+   return ((int64_t)(data[0] & 0x0E) << 29) | (data[1] << 22) |
+      ((data[2] & 0xFE) << 14) | (data[3] << 7) | (data[4] >> 1);
+}
+
+/*****************************************************************************/
+/** Decode the program_clock_reference of an adaptation field, in 27MHz ticks */
+STATIC_INLINE int64_t ts_decode_pcr( const uint8_t *data )
+{
+   int64_t base = ((int64_t)data[0] << 25) | (data[1] << 17) | (data[2] << 9) |
+      (data[3] << 1) | (data[4] >> 7);
+   return base * 300 + (((data[4] & 0x01) << 8) | data[5]);
+}
+
+/*****************************************************************************/
+/** Convert a PES timestamp to microseconds in our timeline */
+static int64_t ts_time_to_us( VC_CONTAINER_T *ctx, int64_t time )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+
+   if (time == VC_CONTAINER_TIME_UNKNOWN)
+      return VC_CONTAINER_TIME_UNKNOWN;
+
+   /* Streams which start before their first program_clock_reference */
+   if (!module->pcr_known)
+   {
+      module->pcr = module->first_pcr = time * 300;
+      module->clock = 0;
+      module->pcr_known = true;
+   }
+
+   return (module->clock + ts_clock_delta(time * 300, module->pcr)) / 27;
+}
+
+/*****************************************************************************/
+static uint32_t ts_crc32( const uint8_t *data, unsigned int size )
+{
+   uint32_t crc = 0xFFFFFFFF;
+   unsigned int i, j;
+
+   for (i = 0; i < size; i++)
+   {
+      crc ^= (uint32_t)data[i] << 24;
+      for (j = 0; j < 8; j++)
+         crc = (crc << 1) ^ (crc & 0x80000000 ? 0x04C11DB7 : 0);
+   }
+   return crc;
+}
+
+/*****************************************************************************/
+static void ts_stream_type_coding( uint8_t stream_type, const uint8_t *descriptors,
+   unsigned int size, VC_CONTAINER_ES_TYPE_T *p_type, VC_CONTAINER_FOURCC_T *p_codec,
+   VC_CONTAINER_FOURCC_T *p_variant )
+{
+   VC_CONTAINER_ES_TYPE_T type = VC_CONTAINER_ES_TYPE_UNKNOWN;
+   VC_CONTAINER_FOURCC_T codec = VC_CONTAINER_CODEC_UNKNOWN, variant = 0;
+   unsigned int i;
+
+   switch (stream_type)
+   {
+   case 0x01: type = VC_CONTAINER_ES_TYPE_VIDEO; codec = VC_CONTAINER_CODEC_MP1V; break;
+   case 0x02: type = VC_CONTAINER_ES_TYPE_VIDEO; codec = VC_CONTAINER_CODEC_MP2V; break;
+   case 0x1B: type = VC_CONTAINER_ES_TYPE_VIDEO; codec = VC_CONTAINER_CODEC_H264; break;
+   case 0x03: type = VC_CONTAINER_ES_TYPE_AUDIO; codec = VC_CONTAINER_CODEC_MPGA;
+              variant = VC_CONTAINER_VARIANT_MPGA_DEFAULT; break;
+   case 0x04: type = VC_CONTAINER_ES_TYPE_AUDIO; codec = VC_CONTAINER_CODEC_MPGA;
+              variant = VC_CONTAINER_VARIANT_MPGA_DEFAULT; break;
+   case 0x0F: type = VC_CONTAINER_ES_TYPE_AUDIO; codec = VC_CONTAINER_CODEC_MP4A; break;
+   case 0x81: type = VC_CONTAINER_ES_TYPE_AUDIO; codec = VC_CONTAINER_CODEC_AC3; break;
+   case 0x06:
+      /* PES private data, look for an AC-3 descriptor */
+      for (i = 0; i + 2 <= size && i + 2 + descriptors[i + 1] <= size; i += 2 + descriptors[i + 1])
+      {
+         if (descriptors[i] == 0x6A ||
+             (descriptors[i] == 0x05 && descriptors[i + 1] >= 4 && !memcmp(descriptors + i + 2, "AC-3", 4)))
+         {
+            type = VC_CONTAINER_ES_TYPE_AUDIO;
+            codec = VC_CONTAINER_CODEC_AC3;
+         }
+      }
+      break;
+   default: break;
+   }
+
+   *p_type = type;
+   *p_codec = codec;
+   *p_variant = variant;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ts_add_track( VC_CONTAINER_T *ctx, uint16_t pid, uint8_t stream_type,
+   const uint8_t *descriptors, unsigned int size )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_TRACK_T *track;
+   VC_CONTAINER_ES_TYPE_T type;
+   VC_CONTAINER_FOURCC_T codec, variant;
+   unsigned int i;
+
+   ts_stream_type_coding(stream_type, descriptors, size, &type, &codec, &variant);
+   LOG_DEBUG(ctx, "pid %u, stream_type 0x%x (%4.4s)", pid, stream_type, (const char *)&codec);
+   if (type == VC_CONTAINER_ES_TYPE_UNKNOWN || module->pid_track[pid] >= 0)
+      return VC_CONTAINER_SUCCESS;
+   if (ctx->tracks_num >= TS_TRACKS_MAX)
+      return VC_CONTAINER_SUCCESS;
+
+   track = vc_container_allocate_track(ctx, sizeof(*ctx->tracks[0]->priv->module));
+   if (!track)
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+
+   track->priv->module->pid = pid;
+   track->priv->module->stream_type = stream_type;
+   track->priv->module->continuity_counter = 0xFF;
+   track->is_enabled = true;
+   track->format->es_type = type;
+   track->format->codec = codec;
+   track->format->codec_variant = variant;
+
+   /* H.264 PES packets carry whole access units so we can deliver them as frames */
+   if (codec == VC_CONTAINER_CODEC_H264)
+      track->format->flags |= VC_CONTAINER_ES_FORMAT_FLAG_FRAMED;
+
+   /* ISO 639 language descriptor */
+   for (i = 0; i + 2 <= size && i + 2 + descriptors[i + 1] <= size; i += 2 + descriptors[i + 1])
+      if (descriptors[i] == 0x0A && descriptors[i + 1] >= 3)
+         memcpy(track->format->language, descriptors + i + 2, 3);
+
+   module->pid_track[pid] = (int8_t)ctx->tracks_num;
+   ctx->tracks[ctx->tracks_num++] = track;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Parse a complete program association or program map section */
+static VC_CONTAINER_STATUS_T ts_parse_section( VC_CONTAINER_T *ctx, const uint8_t *data, unsigned int size )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   unsigned int i, info_length;
+
+   if (size < 12 || ts_crc32(data, size))
+   {
+      LOG_DEBUG(ctx, "invalid section on pid %u", module->section_pid);
+      return VC_CONTAINER_SUCCESS;
+   }
+   size -= 4; /* CRC_32 */
+
+   if (data[0] == 0x00 && module->section_pid == 0) /* program_association_section */
+   {
+      for (i = 8; i + 4 <= size && !module->pmt_pid; i += 4)
+      {
+         unsigned int program_number = (data[i] << 8) | data[i + 1];
+         if (!program_number)
+            continue; /* network_PID */
+         if (module->program_number && program_number != module->program_number)
+            continue;
+         module->program_number = program_number;
+         module->pmt_pid = ((data[i + 2] & 0x1F) << 8) | data[i + 3];
+         LOG_DEBUG(ctx, "program %u, pmt pid %u", program_number, module->pmt_pid);
+      }
+   }
+   else if (data[0] == 0x02 && module->pmt_pid && module->section_pid == module->pmt_pid &&
+            (unsigned int)((data[3] << 8) | data[4]) == module->program_number && !module->pmt_found)
+   {
+      module->pcr_pid = ((data[8] & 0x1F) << 8) | data[9];
+      info_length = ((data[10] & 0x0F) << 8) | data[11];
+
+      for (i = 12 + info_length; i + 5 <= size && status == VC_CONTAINER_SUCCESS; i += 5 + info_length)
+      {
+         uint16_t pid = ((data[i + 1] & 0x1F) << 8) | data[i + 2];
+         info_length = ((data[i + 3] & 0x0F) << 8) | data[i + 4];
+         if (i + 5 + info_length > size)
+            break;
+         status = ts_add_track(ctx, pid, data[i], data + i + 5, info_length);
+      }
+      module->pmt_found = true;
+   }
+
+   return status;
+}
+
+/*****************************************************************************/
+/** Reassemble program specific information sections */
+static VC_CONTAINER_STATUS_T ts_read_psi( VC_CONTAINER_T *ctx, uint16_t pid, bool unit_start,
+   const uint8_t *data, unsigned int size )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   unsigned int section_length;
+
+   if (unit_start)
+   {
+      unsigned int pointer = data[0];
+      if (pointer + 1 > size)
+         return VC_CONTAINER_SUCCESS;
+      data += pointer + 1;
+      size -= pointer + 1;
+      module->section_size = 0;
+      module->section_pid = pid;
+   }
+   else if (!module->section_size || module->section_pid != pid)
+      return VC_CONTAINER_SUCCESS;
+
+   if (module->section_size + size > sizeof(module->section))
+   {
+      module->section_size = 0;
+      return VC_CONTAINER_SUCCESS;
+   }
+   memcpy(module->section + module->section_size, data, size);
+   module->section_size += size;
+
+   if (module->section_size < 3)
+      return VC_CONTAINER_SUCCESS;
+   section_length = ((module->section[1] & 0x0F) << 8) | module->section[2];
+   if (section_length > TS_SECTION_SIZE_MAX)
+   {
+      module->section_size = 0;
+      return VC_CONTAINER_SUCCESS;
+   }
+   if (module->section_size < section_length + 3)
+      return VC_CONTAINER_SUCCESS; /* We need more data */
+
+   module->section_size = 0;
+   return ts_parse_section(ctx, module->section, section_length + 3);
+}
+
+/*****************************************************************************/
+/** Parse the header of the PES packet which has been reassembled for a track and
+    get ready to deliver its payload */
+static bool ts_ready_pes( VC_CONTAINER_T *ctx, int track_num )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track = ctx->tracks[track_num]->priv->module;
+   const uint8_t *data = track->pes;
+   unsigned int size = track->pes_size, offset = 0;
+   int64_t pts = VC_CONTAINER_TIME_UNKNOWN, dts = VC_CONTAINER_TIME_UNKNOWN;
+
+   if (track->pes_header)
+   {
+      unsigned int pts_dts;
+
+      if (size < 9 || data[0] || data[1] || data[2] != 1 || (data[6] & 0xC0) != 0x80)
+      {
+         LOG_DEBUG(ctx, "invalid PES packet on pid %u", track->pid);
+         track->pes_size = 0;
+         return false;
+      }
+      pts_dts = data[7] >> 6;
+      offset = 9 + data[8];
+      if (offset > size)
+      {
+         track->pes_size = 0;
+         return false;
+      }
+      if (pts_dts & 0x2 && data[8] >= 5)
+         pts = ts_decode_timestamp(data + 9);
+      if (pts_dts == 0x3 && data[8] >= 10)
+         dts = ts_decode_timestamp(data + 14);
+   }
+
+   module->ready_track = track_num;
+   module->ready_offset = offset;
+   module->ready_left = size - offset;
+   module->ready_first = true;
+   module->ready_header = track->pes_header;
+   module->ready_partial = false;
+   module->ready_pts = ts_time_to_us(ctx, pts);
+   module->ready_dts = ts_time_to_us(ctx, dts);
+   return true;
+}
+
+/*****************************************************************************/
+/** Process a transport stream packet. Returns true when a PES packet is ready to
+    be delivered, in which case the packet has only been consumed if *p_consumed
+    is set. */
+static bool ts_read_packet( VC_CONTAINER_T *ctx, const uint8_t *packet, bool *p_consumed )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track = 0;
+   unsigned int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+   bool unit_start = !!(packet[1] & 0x40);
+   unsigned int afc = (packet[3] >> 4) & 0x3, cc = packet[3] & 0xF;
+   unsigned int offset = TS_HEADER_SIZE, size;
+   int track_num = module->pid_track[pid];
+   bool discontinuity = false;
+
+   *p_consumed = true;
+   if (packet[1] & 0x80)
+      return false; /* transport_error_indicator */
+
+   if (track_num >= 0)
+   {
+      track = ctx->tracks[track_num]->priv->module;
+
+      /* The start of a PES packet completes the previous one, which we deliver first */
+      if (unit_start && (afc & 0x1) && track->pes_size)
+      {
+         *p_consumed = false;
+         if (ts_ready_pes(ctx, track_num))
+            return true;
+         *p_consumed = true;
+      }
+   }
+
+   /* Adaptation field */
+   if (afc & 0x2)
+   {
+      unsigned int length = packet[4];
+      if (length > TS_PACKET_SIZE - TS_HEADER_SIZE - 1)
+         return false;
+      if (length)
+      {
+         discontinuity = !!(packet[5] & 0x80);
+         if (track && (packet[5] & 0x40))
+            track->pes_flags |= VC_CONTAINER_PACKET_FLAG_KEYFRAME; /* random_access_indicator */
+
+         if (pid == module->pcr_pid && (packet[5] & 0x10) && length >= 7)
+         {
+            int64_t pcr = ts_decode_pcr(packet + 6), delta;
+
+            if (!module->pcr_known)
+            {
+               module->pcr = module->first_pcr = pcr;
+               module->clock = 0;
+               module->pcr_known = true;
+            }
+            delta = ts_clock_delta(pcr, module->pcr);
+            if (discontinuity || delta > TS_PCR_JUMP_MAX || delta < -TS_PCR_JUMP_MAX)
+            {
+               LOG_DEBUG(ctx, "pcr discontinuity (%"PRId64" us)", delta / 27);
+               delta = 0;
+            }
+            module->clock += delta;
+            module->pcr = pcr;
+         }
+      }
+      offset += 1 + length;
+   }
+
+   if (!(afc & 0x1) || offset >= TS_PACKET_SIZE)
+      return false; /* No payload */
+   size = TS_PACKET_SIZE - offset;
+
+   if (!track)
+   {
+      if (pid == 0 || (module->pmt_pid && pid == module->pmt_pid))
+         ts_read_psi(ctx, pid, unit_start, packet + offset, size);
+      return false;
+   }
+
+   /* Continuity check */
+   if (track->continuity_counter != 0xFF && !discontinuity)
+   {
+      unsigned int expected = (track->continuity_counter + 1) & 0xF;
+      if (cc == track->continuity_counter)
+         return false; /* Duplicate packet */
+      if (cc != expected)
+      {
+         module->packets_lost += (cc - expected) & 0xF;
+         track->pes_flags |= VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
+         LOG_DEBUG(ctx, "pid %u: lost %u packets", track->pid, (cc - expected) & 0xF);
+      }
+   }
+   track->continuity_counter = (uint8_t)cc;
+
+   if (unit_start)
+   {
+      track->pes_started = track->pes_header = true;
+      track->pes_length = 0;
+      if (size >= 6)
+      {
+         unsigned int length = (packet[offset + 4] << 8) | packet[offset + 5];
+         track->pes_length = length ? length + 6 : 0;
+      }
+   }
+   else if (!track->pes_started)
+      return false; /* Wait for the start of a PES packet */
+
+   /* Append the payload, delivering what we've got when the buffer is full */
+   if (track->pes_size + size > track->pes_max)
+   {
+      unsigned int max = track->pes_max ? track->pes_max * 2 : TS_PES_SIZE_MIN;
+      uint8_t *pes;
+
+      if (track->pes_max >= TS_PES_SIZE_MAX || !(pes = realloc(track->pes, max)))
+      {
+         *p_consumed = false;
+         if (ts_ready_pes(ctx, track_num))
+         {
+            /* The rest of the PES packet doesn't have a header */
+            module->ready_partial = true;
+            track->pes_header = false;
+            track->pes_length = 0;
+            return true;
+         }
+         *p_consumed = true;
+         track->pes_started = false;
+         return false;
+      }
+      track->pes = pes;
+      track->pes_max = max;
+   }
+   memcpy(track->pes + track->pes_size, packet + offset, size);
+   track->pes_size += size;
+
+   /* We know when PES packets with a length are complete */
+   if (track->pes_length && track->pes_size >= track->pes_length)
+   {
+      track->pes_size = track->pes_length;
+      track->pes_started = false;
+      return ts_ready_pes(ctx, track_num);
+   }
+
+   return false;
+}
+
+/*****************************************************************************/
+/** Read more data into the packet buffer, keeping what hasn't been parsed yet.
+    Whole packets are borrowed from the i/o when it can lend them. */
+static VC_CONTAINER_STATUS_T ts_fill_buffer( VC_CONTAINER_T *ctx )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   unsigned int left = module->buffer_end - module->buffer_pos;
+   size_t size;
+
+   if (module->eos)
+      return VC_CONTAINER_ERROR_EOS;
+
+   module->buffer_offset += module->buffer_pos;
+   module->buffer_pos = 0;
+
+   if (!left && !module->datagrams && !module->searching_tracks)
+   {
+      const uint8_t *data;
+
+      size = TS_BUFFER_SIZE / module->packet_size * module->packet_size;
+      if (ctx->priv->io->size > STREAM_POSITION(ctx))
+         size = MIN((int64_t)size, ctx->priv->io->size - STREAM_POSITION(ctx));
+      data = size ? BORROW_BYTES(ctx, size) : 0;
+      if (data)
+      {
+         module->data = data;
+         module->buffer_end = size;
+         return VC_CONTAINER_SUCCESS;
+      }
+   }
+
+   if (module->data != module->buffer)
+      memcpy(module->buffer, module->data + module->buffer_end - left, left);
+   else if (left)
+      memmove(module->buffer, module->buffer + module->buffer_end - left, left);
+   module->data = module->buffer;
+   module->buffer_end = left;
+
+   if (!module->datagrams)
+   {
+      size = READ_BYTES(ctx, module->buffer + module->buffer_end, module->buffer_size - module->buffer_end);
+   }
+   else
+   {
+      const uint8_t *data = module->datagram;
+
+      /* Read a whole datagram, we'll have to drop it if there's no room for it */
+      size = READ_BYTES(ctx, module->datagram, TS_DATAGRAM_MAX);
+
+      if (module->rtp && size >= 12 && (data[0] >> 6) == 2)
+      {
+         size_t header = 12 + 4 * (data[0] & 0xF);
+         if ((data[0] & 0x10) && size >= header + 4)
+            header += 4 + 4 * ((data[header + 2] << 8) | data[header + 3]);
+         if ((data[0] & 0x20) && size > header)
+            size -= MIN(data[size - 1], size - header);
+         size = size > header ? size - header : 0;
+         data += header;
+      }
+      else if (module->rtp)
+         size = 0;
+
+      if (size > module->buffer_size - module->buffer_end)
+         size = 0;
+      memcpy(module->buffer + module->buffer_end, data, size);
+   }
+
+   module->buffer_end += size;
+   if (!size && STREAM_STATUS(ctx) != VC_CONTAINER_SUCCESS)
+   {
+      /* Live inputs can time out, which isn't the end of the stream */
+      module->eos = STREAM_STATUS(ctx) == VC_CONTAINER_ERROR_EOS;
+      return STREAM_STATUS(ctx);
+   }
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Parse transport stream packets until a PES packet is ready to be delivered */
+static VC_CONTAINER_STATUS_T ts_read_packets( VC_CONTAINER_T *ctx )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   unsigned int packet_size = module->packet_size, sync_offset = module->sync_offset;
+   VC_CONTAINER_STATUS_T status;
+
+   while (module->ready_track < 0)
+   {
+      const uint8_t *packet = module->data + module->buffer_pos + sync_offset;
+      unsigned int pos;
+      bool consumed;
+
+      if (module->buffer_end - module->buffer_pos < packet_size)
+      {
+         if ((status = ts_fill_buffer(ctx)) != VC_CONTAINER_SUCCESS)
+            return status;
+         continue;
+      }
+
+      if (*packet != TS_SYNC_BYTE)
+      {
+         /* Lost sync, we need a few consecutive packets to find it again */
+         pos = ts_find_sync(packet, module->buffer_end - module->buffer_pos - sync_offset, packet_size);
+         if (pos == module->buffer_end - module->buffer_pos - sync_offset)
+         {
+            unsigned int keep = (TS_SYNC_PACKETS - 1) * packet_size + sync_offset;
+            if (module->buffer_end - module->buffer_pos > keep)
+               module->buffer_pos = module->buffer_end - keep;
+            if ((status = ts_fill_buffer(ctx)) != VC_CONTAINER_SUCCESS)
+               return status;
+            continue;
+         }
+         LOG_DEBUG(ctx, "lost sync, skipped %u bytes", pos);
+         module->sync_losses++;
+         module->buffer_pos += pos;
+         for (pos = 0; pos < ctx->tracks_num; pos++)
+            ctx->tracks[pos]->priv->module->pes_flags |= VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
+         continue;
+      }
+
+      if (ts_read_packet(ctx, packet, &consumed) && !consumed)
+         break;
+      module->buffer_pos += packet_size;
+
+      /* At open time we only want the tracks */
+      if (module->searching_tracks && module->pmt_found)
+         break;
+   }
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Deliver whatever is left in the PES packets being reassembled */
+static VC_CONTAINER_STATUS_T ts_flush_tracks( VC_CONTAINER_T *ctx )
+{
+   unsigned int i;
+
+   for (i = 0; i < ctx->tracks_num; i++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *track = ctx->tracks[i]->priv->module;
+      track->pes_started = false;
+      if (track->pes_size && ts_ready_pes(ctx, i))
+         return VC_CONTAINER_SUCCESS;
+   }
+   return VC_CONTAINER_ERROR_EOS;
+}
+
+/*****************************************************************************/
+/** Forget about all the data we've got buffered, e.g. after seeking */
+static void ts_reset( VC_CONTAINER_T *ctx, int64_t offset )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   unsigned int i;
+
+   for (i = 0; i < ctx->tracks_num; i++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *track = ctx->tracks[i]->priv->module;
+      track->pes_size = 0;
+      track->pes_started = false;
+      track->continuity_counter = 0xFF;
+      track->pes_flags = VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
+   }
+   module->ready_track = -1;
+   module->data = module->buffer;
+   module->buffer_pos = module->buffer_end = 0;
+   module->buffer_offset = offset;
+   module->eos = false;
+}
+
+/*****************************************************************************/
+/** Find the first (or last) program_clock_reference between the given offsets.
+    Returns its value as well as the offset of the packet it was found in. */
+static VC_CONTAINER_STATUS_T ts_probe_pcr( VC_CONTAINER_T *ctx, int64_t offset, int64_t end,
+   bool last, int64_t *p_offset, int64_t *p_pcr )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_NOT_FOUND;
+   unsigned int packet_size = module->packet_size, pos, size;
+
+   /* Stay on the packet grid, it's only lost on damaged streams */
+   offset = module->data_offset + (offset - module->data_offset) / packet_size * packet_size;
+   end = MIN(end, offset + TS_PCR_SCAN_SIZE);
+
+   for (; offset < end; offset += pos)
+   {
+      if (SEEK(ctx, offset) != VC_CONTAINER_SUCCESS)
+         break;
+      size = READ_BYTES(ctx, module->buffer, MIN((int64_t)module->buffer_size, end - offset));
+
+      for (pos = 0; pos + packet_size <= size; )
+      {
+         const uint8_t *packet = module->buffer + pos + module->sync_offset;
+
+         if (*packet != TS_SYNC_BYTE)
+         {
+            pos += ts_find_sync(packet, size - pos - module->sync_offset, packet_size);
+            continue;
+         }
+
+         if ((((packet[1] & 0x1F) << 8) | packet[2]) == module->pcr_pid &&
+             (packet[3] & 0x20) && packet[4] >= 7 && (packet[5] & 0x10))
+         {
+            *p_offset = offset + pos;
+            *p_pcr = ts_decode_pcr(packet + 6);
+            status = VC_CONTAINER_SUCCESS;
+            if (!last)
+               return status;
+         }
+         pos += packet_size;
+      }
+      if (!pos)
+         break;
+   }
+
+   return status;
+}
+
+/*****************************************************************************/
+/** Time of a program_clock_reference, relative to the first one */
+STATIC_INLINE int64_t ts_pcr_to_us( VC_CONTAINER_MODULE_T *module, int64_t pcr )
+{
+   return ts_clock_delta(pcr, module->first_pcr) / 27;
+}
+
+/*****************************************************************************/
+/** Find the packet to start reading from to get to the given time by probing
+    the program_clock_reference of packets and narrowing down the range they can
+    be in. */
+static VC_CONTAINER_STATUS_T ts_seek_bisect( VC_CONTAINER_T *ctx, int64_t time,
+   int64_t *p_offset, int64_t *p_pcr )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   int64_t low = module->data_offset, high = module->data_offset + module->data_size;
+   int64_t low_time = 0, high_time = MAX(ctx->duration, time + 1);
+   int64_t low_pcr = module->first_pcr, offset, pcr, pcr_time;
+   unsigned int probes;
+
+   for (probes = 0; probes != TS_SEEK_PROBES_MAX; ++probes)
+   {
+      int64_t range = high - low;
+
+      if (time - low_time <= TS_SEEK_TOLERANCE || range <= TS_SEEK_RANGE_MIN)
+         break;
+
+      /* Interpolate between both ends of the range, without getting too close to either */
+      if (high_time > low_time)
+         offset = low + (int64_t)((double)(time - low_time) * range / (high_time - low_time));
+      else
+         offset = low + range / 2;
+      offset = MAX(offset, low + range / 8);
+      offset = MIN(offset, high - range / 8);
+
+      if (ts_probe_pcr(ctx, offset, high, false, &offset, &pcr) != VC_CONTAINER_SUCCESS)
+      {
+         high = offset; /* Nothing between there and the end of the range */
+         continue;
+      }
+
+      pcr_time = ts_pcr_to_us(module, pcr);
+      if (pcr_time <= time)
+      {
+         low = offset;
+         low_time = pcr_time;
+         low_pcr = pcr;
+      }
+      else
+      {
+         high = offset;
+         high_time = pcr_time;
+      }
+   }
+
+   LOG_DEBUG(ctx, "seek to %"PRId64" took %u probes (pcr at %"PRId64")", time, probes, low_time);
+   *p_offset = low;
+   *p_pcr = low_pcr;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************
+Functions exported as part of the Container Module API
+*****************************************************************************/
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ts_reader_read( VC_CONTAINER_T *ctx,
+   VC_CONTAINER_PACKET_T *p_packet, uint32_t flags )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *track;
+   VC_CONTAINER_STATUS_T status;
+
+   while (module->ready_track < 0)
+   {
+      status = ts_read_packets(ctx);
+      if (status == VC_CONTAINER_ERROR_EOS)
+         status = ts_flush_tracks(ctx);
+      if (status != VC_CONTAINER_SUCCESS)
+         return status;
+   }
+
+   track = ctx->tracks[module->ready_track]->priv->module;
+   p_packet->track = module->ready_track;
+   p_packet->size = module->ready_left;
+   p_packet->pts = module->ready_first ? module->ready_pts : VC_CONTAINER_TIME_UNKNOWN;
+   p_packet->dts = module->ready_first ? module->ready_dts : VC_CONTAINER_TIME_UNKNOWN;
+   p_packet->flags = module->ready_first ? track->pes_flags : 0;
+   if (ctx->tracks[module->ready_track]->format->flags & VC_CONTAINER_ES_FORMAT_FLAG_FRAMED)
+   {
+      if (module->ready_first && module->ready_header)
+         p_packet->flags |= VC_CONTAINER_PACKET_FLAG_FRAME_START;
+      if (!module->ready_partial)
+         p_packet->flags |= VC_CONTAINER_PACKET_FLAG_FRAME_END;
+   }
+
+   if (flags & VC_CONTAINER_READ_FLAG_INFO)
+      return VC_CONTAINER_SUCCESS;
+
+   if (!(flags & VC_CONTAINER_READ_FLAG_SKIP))
+   {
+      p_packet->size = MIN(p_packet->buffer_size, module->ready_left);
+      memcpy(p_packet->data, track->pes + module->ready_offset, p_packet->size);
+      if (p_packet->size < module->ready_left)
+         p_packet->flags &= ~VC_CONTAINER_PACKET_FLAG_FRAME_END;
+   }
+
+   module->ready_offset += p_packet->size;
+   module->ready_left -= p_packet->size;
+   module->ready_first = false;
+   track->pes_flags = 0;
+
+   if (!module->ready_left)
+   {
+      /* Done with this PES packet, keep any data which came after it */
+      if (track->pes_size > module->ready_offset)
+         memmove(track->pes, track->pes + module->ready_offset, track->pes_size - module->ready_offset);
+      track->pes_size -= module->ready_offset;
+      module->ready_track = -1;
+   }
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ts_reader_seek( VC_CONTAINER_T *ctx,
+   int64_t *p_offset, VC_CONTAINER_SEEK_MODE_T mode, VC_CONTAINER_SEEK_FLAGS_T flags )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   int64_t offset = module->data_offset, pcr = module->first_pcr;
+   VC_CONTAINER_PACKET_T packet;
+   unsigned int i;
+   VC_CONTAINER_PARAM_UNUSED(flags);
+
+   if (mode != VC_CONTAINER_SEEK_MODE_TIME || !STREAM_SEEKABLE(ctx) || module->datagrams)
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+
+   if (*p_offset > 0 && module->pcr_pid < TS_PID_MAX - 1)
+      ts_seek_bisect(ctx, *p_offset, &offset, &pcr);
+
+   if (SEEK(ctx, offset) != VC_CONTAINER_SUCCESS)
+      return STREAM_STATUS(ctx);
+   ts_reset(ctx, offset);
+
+   /* Carry on with the timeline of the program_clock_reference we've landed on */
+   module->pcr_known = true;
+   module->pcr = pcr;
+   module->clock = ts_clock_delta(pcr, module->first_pcr);
+
+   /* Skip the tail of PES packets started before that point so we report the
+      time of the first packet we'll deliver */
+   memset(&packet, 0, sizeof(packet));
+   for (i = 0; i != TS_SEEK_SKIP_MAX; ++i)
+   {
+      if (module->ready_track < 0 && ts_read_packets(ctx) != VC_CONTAINER_SUCCESS)
+         break;
+      if (module->ready_pts != VC_CONTAINER_TIME_UNKNOWN)
+         break;
+      ts_reader_read(ctx, &packet, VC_CONTAINER_READ_FLAG_SKIP);
+   }
+   if (module->ready_track >= 0 && module->ready_pts != VC_CONTAINER_TIME_UNKNOWN)
+      *p_offset = module->ready_pts;
+   else
+      *p_offset = ts_pcr_to_us(module, pcr);
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_STATUS_T ts_reader_close( VC_CONTAINER_T *ctx )
+{
+   VC_CONTAINER_MODULE_T *module = ctx->priv->module;
+   unsigned int i;
+
+   LOG_DEBUG(ctx, "sync lost %u times, %u packets lost", module->sync_losses, module->packets_lost);
+
+   for (i = 0; i < ctx->tracks_num; i++)
+   {
+      free(ctx->tracks[i]->priv->module->pes);
+      vc_container_free_track(ctx, ctx->tracks[i]);
+   }
+   free(module->buffer);
+   free(module->datagram);
+   free(module);
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+/** Work out the size of the packets from the start of the stream */
+static bool ts_find_packet_size( VC_CONTAINER_MODULE_T *module, unsigned int *p_pos )
+{
+   static const unsigned int sizes[] = {188, 192, 204};
+   unsigned int i, pos, best = module->buffer_end;
+
+   for (i = 0; i < countof(sizes); i++)
+   {
+      unsigned int sync_offset = sizes[i] == 192 ? 4 : 0;
+      if (module->buffer_end <= sync_offset)
+         continue;
+      pos = ts_find_sync(module->buffer + sync_offset, module->buffer_end - sync_offset, sizes[i]);
+
+      /* Make sure it's not just a coincidence with a few more packets */
+      if (pos + sync_offset + 6 * sizes[i] < module->buffer_end &&
+          module->buffer[pos + sync_offset + 3 * sizes[i]] == TS_SYNC_BYTE &&
+          module->buffer[pos + sync_offset + 4 * sizes[i]] == TS_SYNC_BYTE &&
+          module->buffer[pos + sync_offset + 5 * sizes[i]] == TS_SYNC_BYTE && pos < best)
+      {
+         best = pos;
+         module->packet_size = sizes[i];
+         module->sync_offset = sync_offset;
+      }
+   }
+
+   *p_pos = best;
+   return best < module->buffer_end;
+}
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T ts_reader_open( VC_CONTAINER_T *ctx )
+{
+   const char *extension = vc_uri_path_extension(ctx->priv->uri);
+   const char *scheme = vc_uri_scheme(ctx->priv->uri);
+   VC_CONTAINER_MODULE_T *module = 0;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
+   uint8_t header[TS_SYNC_PACKETS * 204];
+   unsigned int pos;
+   int64_t first_pcr_offset, offset, pcr;
+   bool datagrams = scheme && (!strcasecmp(scheme, "udp") || !strcasecmp(scheme, "rtp"));
+   const char *program;
+
+   /* Check if the user has specified a container */
+   vc_uri_find_query(ctx->priv->uri, 0, "container", &extension);
+
+   /* Network streams can't be probed without losing data so we need to be told */
+   if (datagrams || !STREAM_SEEKABLE(ctx))
+   {
+      if (!extension || (strcasecmp(extension, "ts") && strcasecmp(extension, "m2ts") &&
+                         strcasecmp(extension, "mts") && strcasecmp(extension, "trp")))
+         return VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
+   }
+   else
+   {
+      size_t size = PEEK_BYTES(ctx, header, sizeof(header));
+      bool found = false;
+      for (pos = 0; !found && pos < 204 && pos < size; pos++)
+         found = (ts_find_sync(header + pos, size - pos, 188) == 0 ||
+                  ts_find_sync(header + pos, size - pos, 192) == 0 ||
+                  ts_find_sync(header + pos, size - pos, 204) == 0);
+      if (!found)
+         return VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
+   }
+
+   LOG_DEBUG(ctx, "using ts reader");
+
+   module = malloc(sizeof(*module));
+   if (!module) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
+   memset(module, 0, sizeof(*module));
+   memset(module->pid_track, -1, sizeof(module->pid_track));
+   ctx->priv->module = module;
+   ctx->tracks = module->tracks;
+   module->ready_track = -1;
+   module->pmt_pid = 0;
+   module->pcr_pid = TS_PID_MAX - 1;
+   module->datagrams = datagrams;
+   module->rtp = datagrams && !strcasecmp(scheme, "rtp");
+   if (vc_uri_find_query(ctx->priv->uri, 0, "program", &program) && program)
+      module->program_number = strtoul(program, 0, 0);
+
+   module->buffer_size = TS_BUFFER_SIZE + (datagrams ? TS_DATAGRAM_MAX : 0);
+   module->buffer = malloc(module->buffer_size);
+   if (datagrams)
+      module->datagram = malloc(TS_DATAGRAM_MAX);
+   if (!module->buffer || (datagrams && !module->datagram))
+   { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
+   module->data_offset = module->buffer_offset = STREAM_POSITION(ctx);
+
+   /* Lock onto the packets, copying them into our buffer until we've got the tracks */
+   module->searching_tracks = true;
+   while (module->buffer_end < TS_BUFFER_SIZE / 2 && ts_fill_buffer(ctx) == VC_CONTAINER_SUCCESS);
+   if (!ts_find_packet_size(module, &pos))
+   {
+      status = VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
+      goto error;
+   }
+   module->buffer_pos = pos;
+   module->data_offset += pos;
+   LOG_DEBUG(ctx, "%u bytes packets from offset %u", module->packet_size, pos);
+
+   /* Go through the packets until we've found the program map */
+   while (!module->pmt_found && module->buffer_offset + module->buffer_pos - module->data_offset < TS_PROBE_SIZE_MAX)
+   {
+      if (ts_read_packets(ctx) != VC_CONTAINER_SUCCESS)
+         break;
+   }
+   module->searching_tracks = false;
+   if (!ctx->tracks_num)
+   {
+      status = VC_CONTAINER_ERROR_NO_TRACK_AVAILABLE;
+      goto error;
+   }
+
+   /* Start delivering data from the first packet */
+   if (STREAM_SEEKABLE(ctx) && !datagrams)
+   {
+      first_pcr_offset = module->data_offset;
+      module->data_size = ctx->priv->io->size - module->data_offset;
+
+      if (module->data_size > 0 &&
+          ts_probe_pcr(ctx, module->data_offset, ctx->priv->io->size, false, &first_pcr_offset, &pcr) == VC_CONTAINER_SUCCESS)
+      {
+         module->first_pcr = pcr;
+
+         /* The last program_clock_reference gives us the duration */
+         offset = MAX(module->data_offset, ctx->priv->io->size - TS_PCR_SCAN_SIZE);
+         if (ts_probe_pcr(ctx, offset, ctx->priv->io->size, true, &offset, &pcr) == VC_CONTAINER_SUCCESS &&
+             ts_clock_delta(pcr, module->first_pcr) > 0)
+            ctx->duration = ts_clock_delta(pcr, module->first_pcr) / 27;
+         ctx->capabilities |= VC_CONTAINER_CAPS_CAN_SEEK;
+      }
+
+      SEEK(ctx, module->data_offset);
+      ts_reset(ctx, module->data_offset);
+      module->pcr_known = !!(ctx->capabilities & VC_CONTAINER_CAPS_CAN_SEEK);
+      module->pcr = module->first_pcr;
+      module->clock = 0;
+   }
+   /* Otherwise we can't go back so we just carry on from the program map */
+
+   for (pos = 0; pos < ctx->tracks_num; pos++)
+      ctx->tracks[pos]->priv->module->pes_flags = 0;
+
+   ctx->priv->pf_close = ts_reader_close;
+   ctx->priv->pf_read = ts_reader_read;
+   ctx->priv->pf_seek = ts_reader_seek;
+
+   return VC_CONTAINER_SUCCESS;
+
+ error:
+   LOG_DEBUG(ctx, "ts: error opening stream (%i)", status);
+   if (module) ts_reader_close(ctx);
+   return status;
+}
+
+/********************************************************************************
+ Entrypoint function
+ ********************************************************************************/
+
+#if !defined(ENABLE_CONTAINERS_STANDALONE) && defined(__HIGHC__)
+# pragma weak reader_open ts_reader_open
+#endif
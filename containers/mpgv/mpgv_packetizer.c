@@ -369,6 +369,8 @@ static VC_CONTAINER_STATUS_T mpgv_packetizer_packetize( VC_PACKETIZER_T *p_ctx,
          out->pts = module->pts;
          out->dts = module->dts;
          out->flags |= VC_CONTAINER_PACKET_FLAG_FRAME_START;
+         if(module->picture_type == PICTURE_CODING_TYPE_I)
+            out->flags |= VC_CONTAINER_PACKET_FLAG_KEYFRAME;
       }
 
       if(flags & VC_PACKETIZER_FLAG_INFO)
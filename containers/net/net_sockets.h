@@ -71,13 +71,28 @@ typedef enum {
    /** Set the timeout to be used on read operations
     * arg1: uint32_t - New timeout in milliseconds, or INFINITE_TIMEOUT_MS */
    VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS,
+   /** Send small writes to a stream straight away, rather than holding them back
+    * to coalesce with later ones (i.e. disable Nagle's algorithm)
+    * arg1: int - Non-zero to send without delay */
+   VC_CONTAINER_NET_CONTROL_SET_NO_DELAY,
 } vc_container_net_control_t;
 
+/** Buffer for one datagram, used with vc_container_net_read_datagrams. */
+typedef struct vc_container_net_datagram_tag
+{
+   void *buffer;  /**< Where to store the datagram */
+   size_t size;   /**< Size of the buffer, updated to the size of the datagram received */
+} VC_CONTAINER_NET_DATAGRAM_T;
+
 /** Container Input / Output Context.
  * This is an opaque structure that defines the context for a socket instance.
  * The details of the structure are contained within the platform implementation. */
 typedef struct vc_container_net_tag VC_CONTAINER_NET_T;
 
+/** Set of sockets which are waited on together for data to read.
+ * This is an opaque structure whose details are contained within the platform implementation. */
+typedef struct vc_container_net_poll_tag VC_CONTAINER_NET_POLL_T;
+
 /** \name Socket open flags
  * The following flags can be used when opening a network socket. */
 /* @{ */
@@ -153,10 +168,27 @@ vc_container_net_status_t vc_container_net_status( VC_CONTAINER_NET_T *p_ctx );
  * \return The number of bytes actually read. */
 size_t vc_container_net_read( VC_CONTAINER_NET_T *p_ctx, void *buffer, size_t size );
 
+/** Read a batch of datagrams from a datagram receiver socket.
+ * The function waits for the first datagram for as long as vc_container_net_read would,
+ * then takes any others already waiting, up to the number of buffers given, in as few
+ * system calls as the platform allows (a single recvmmsg call on Linux, which also does
+ * the waiting).
+ * When the function returns zero, an error may have occurred or the timeout been
+ * reached. Check vc_container_net_status() to differentiate.
+ *
+ * \param p_ctx The socket instance.
+ * \param datagrams The buffers to read the datagrams into. The size of each buffer
+ *                  filled is updated to the size of its datagram.
+ * \param count The number of buffers.
+ * \return The number of datagrams actually read. */
+size_t vc_container_net_read_datagrams( VC_CONTAINER_NET_T *p_ctx,
+      VC_CONTAINER_NET_DATAGRAM_T *datagrams, size_t count );
+
 /** Write data to the socket.
  * If the socket cannot send the requested number of bytes in one go, the function
  * will return a value smaller than size.
- * Attempting to write on a datagram receiver socket will trigger an error.
+ * Writing on a datagram receiver socket sends the data to the sender of the last
+ * datagram received, and triggers an error if nothing has been received yet.
  *
  * \param p_ctx The socket instance.
  * \param buffer The buffer from which bytes will be written.
@@ -232,6 +264,49 @@ vc_container_net_status_t vc_container_net_get_client_port( VC_CONTAINER_NET_T *
  * \return The status of the socket. */
 vc_container_net_status_t vc_container_net_control( VC_CONTAINER_NET_T *p_ctx, vc_container_net_control_t operation, va_list args);
 
+/** Create an empty set of sockets to wait on for data.
+ * The set is meant for many sockets, and waiting on it costs no more for those which are
+ * idle (e.g. it uses epoll where that is available).
+ *
+ * \param p_status Optional pointer to a variable to receive the status of the operation.
+ * \return The socket set, or NULL on failure. */
+VC_CONTAINER_NET_POLL_T *vc_container_net_poll_create( vc_container_net_status_t *p_status );
+
+/** Close a socket set. The sockets in it are not closed.
+ *
+ * \param p_poll The socket set. */
+void vc_container_net_poll_close( VC_CONTAINER_NET_POLL_T *p_poll );
+
+/** Add a socket to a set, to be reported by vc_container_net_poll_wait when it has data.
+ * A socket can only be in one set at a time, and must be removed before it is closed.
+ *
+ * \param p_poll The socket set.
+ * \param p_ctx The socket instance.
+ * \param userdata Value reported for the socket by vc_container_net_poll_wait.
+ * \return The status of the operation. */
+vc_container_net_status_t vc_container_net_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      VC_CONTAINER_NET_T *p_ctx, void *userdata );
+
+/** Remove a socket from a set.
+ *
+ * \param p_poll The socket set.
+ * \param p_ctx The socket instance.
+ * \return The status of the operation. */
+vc_container_net_status_t vc_container_net_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      VC_CONTAINER_NET_T *p_ctx );
+
+/** Wait for sockets of a set to have data to read, or for the timeout to pass.
+ * Sockets keep being reported for as long as they have data. Sockets can be added to
+ * and removed from the set by other threads while one is waiting.
+ *
+ * \param p_poll The socket set.
+ * \param ready Array where the userdata values of the sockets with data are written.
+ * \param p_count On entry, the size of the array. On exit, the number of sockets with data.
+ * \param timeout_ms Time to wait for data, in milliseconds, or INFINITE_TIMEOUT_MS.
+ * \return The status of the operation. VC_CONTAINER_NET_ERROR_TIMED_OUT if there is no data. */
+vc_container_net_status_t vc_container_net_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms );
+
 /** Convert a 32-bit unsigned value from network order (big endian) to host order.
  *
  * \param value The value to be converted.
@@ -27,6 +27,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <errno.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <pthread.h>
+#endif
 
 #include "net_sockets.h"
 #include "net_sockets_priv.h"
@@ -42,6 +52,31 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /** Maximum socket buffer size to use. */
 #define MAXIMUM_BUFFER_SIZE   65536
 
+/** Maximum number of datagrams received in one system call. */
+#define MAXIMUM_DATAGRAM_BATCH   64
+
+/** Maximum number of ready sockets taken from the kernel in one go. */
+#define MAXIMUM_POLL_EVENTS      64
+
+#ifdef __linux__
+struct vc_container_net_poll_tag
+{
+   int epoll_fd;
+};
+#else
+struct vc_container_net_poll_tag
+{
+   pthread_mutex_t lock;      /**< Protects the list of sockets */
+   struct pollfd *fds;        /**< Sockets in the set */
+   void **userdata;           /**< Value to report for each socket */
+   size_t count;              /**< Number of sockets in the set */
+   size_t capacity;           /**< Number of entries allocated */
+   struct pollfd *wait_fds;   /**< Copy of the sockets being waited on */
+   void **wait_userdata;      /**< Copy of the values of the sockets being waited on */
+   size_t wait_capacity;      /**< Number of copies allocated */
+};
+#endif
+
 /*****************************************************************************/
 vc_container_net_status_t vc_container_net_private_last_error()
 {
@@ -107,6 +142,22 @@ void vc_container_net_private_set_reusable( SOCKET_T sock, bool enable )
    (void)setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
 }
 
+/*****************************************************************************/
+bool vc_container_net_private_set_read_timeout( SOCKET_T sock, uint32_t timeout_ms )
+{
+   struct timeval tv;
+
+   /* A zero timeout waits forever */
+   memset(&tv, 0, sizeof(tv));
+   if (timeout_ms != INFINITE_TIMEOUT_MS)
+   {
+      tv.tv_sec = timeout_ms / 1000;
+      tv.tv_usec = (timeout_ms % 1000) * 1000;
+   }
+
+   return !setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tv, sizeof(tv));
+}
+
 /*****************************************************************************/
 size_t vc_container_net_private_maximum_datagram_size( SOCKET_T sock )
 {
@@ -115,3 +166,300 @@ size_t vc_container_net_private_maximum_datagram_size( SOCKET_T sock )
    /* No easy way to determine this, just use the default. */
    return DEFAULT_MAXIMUM_DATAGRAM_SIZE;
 }
+
+/*****************************************************************************/
+int vc_container_net_private_read_datagrams( SOCKET_T sock, VC_CONTAINER_NET_DATAGRAM_T *datagrams,
+      size_t count, struct sockaddr *p_addr, SOCKADDR_LEN_T *p_addr_len, bool wait )
+{
+#ifdef MSG_WAITFORONE
+   struct mmsghdr messages[MAXIMUM_DATAGRAM_BATCH];
+   struct iovec vectors[MAXIMUM_DATAGRAM_BATCH];
+   int result, ii;
+
+   if (count > MAXIMUM_DATAGRAM_BATCH)
+      count = MAXIMUM_DATAGRAM_BATCH;
+
+   memset(messages, 0, count * sizeof(messages[0]));
+   for (ii = 0; ii < (int)count; ii++)
+   {
+      vectors[ii].iov_base = datagrams[ii].buffer;
+      vectors[ii].iov_len = datagrams[ii].size;
+      messages[ii].msg_hdr.msg_iov = &vectors[ii];
+      messages[ii].msg_hdr.msg_iovlen = 1;
+      /* Every sender address goes in the same place, so the last one is kept */
+      messages[ii].msg_hdr.msg_name = p_addr;
+      messages[ii].msg_hdr.msg_namelen = *p_addr_len;
+   }
+
+   /* Block for the first datagram only, then take what is already waiting */
+   result = recvmmsg(sock, messages, (unsigned int)count, wait ? MSG_WAITFORONE : MSG_DONTWAIT, NULL);
+   if (result <= 0)
+      return result;
+
+   for (ii = 0; ii < result; ii++)
+      datagrams[ii].size = messages[ii].msg_len;
+   *p_addr_len = messages[result - 1].msg_hdr.msg_namelen;
+
+   return result;
+#else
+   size_t ii;
+
+   for (ii = 0; ii < count; ii++)
+   {
+      SOCKADDR_LEN_T addr_len = *p_addr_len;
+      ssize_t result;
+
+      result = recvfrom(sock, datagrams[ii].buffer, datagrams[ii].size,
+            (ii || !wait) ? MSG_DONTWAIT : 0, p_addr, &addr_len);
+      if (result == SOCKET_ERROR)
+      {
+         if (ii && (errno == EWOULDBLOCK || errno == EAGAIN))
+            break;
+         return SOCKET_ERROR;
+      }
+      datagrams[ii].size = (size_t)result;
+      *p_addr_len = addr_len;
+   }
+
+   return (int)ii;
+#endif
+}
+
+/*****************************************************************************/
+int vc_container_net_private_wait_for_data( SOCKET_T sock, uint32_t timeout_ms )
+{
+   struct pollfd fd;
+   int result;
+
+   fd.fd = sock;
+   fd.events = POLLIN;
+   fd.revents = 0;
+   result = poll(&fd, 1, timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+
+   return result > 0 ? 1 : result;
+}
+
+#ifdef __linux__
+/*****************************************************************************/
+VC_CONTAINER_NET_POLL_T *vc_container_net_private_poll_create( vc_container_net_status_t *p_status )
+{
+   VC_CONTAINER_NET_POLL_T *p_poll = (VC_CONTAINER_NET_POLL_T *)malloc(sizeof(*p_poll));
+
+   if (!p_poll)
+   {
+      *p_status = VC_CONTAINER_NET_ERROR_NO_MEMORY;
+      return NULL;
+   }
+
+   p_poll->epoll_fd = epoll_create(MAXIMUM_POLL_EVENTS);
+   if (p_poll->epoll_fd < 0)
+   {
+      *p_status = vc_container_net_private_last_error();
+      free(p_poll);
+      return NULL;
+   }
+
+   *p_status = VC_CONTAINER_NET_SUCCESS;
+   return p_poll;
+}
+
+/*****************************************************************************/
+void vc_container_net_private_poll_close( VC_CONTAINER_NET_POLL_T *p_poll )
+{
+   close(p_poll->epoll_fd);
+   free(p_poll);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock, void *userdata )
+{
+   struct epoll_event event;
+
+   memset(&event, 0, sizeof(event));
+   event.events = EPOLLIN;
+   event.data.ptr = userdata;
+   if (epoll_ctl(p_poll->epoll_fd, EPOLL_CTL_ADD, sock, &event) < 0)
+      return vc_container_net_private_last_error();
+
+   return VC_CONTAINER_NET_SUCCESS;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock )
+{
+   struct epoll_event event;
+
+   /* Old kernels want an event, even though it is ignored */
+   memset(&event, 0, sizeof(event));
+   if (epoll_ctl(p_poll->epoll_fd, EPOLL_CTL_DEL, sock, &event) < 0)
+      return vc_container_net_private_last_error();
+
+   return VC_CONTAINER_NET_SUCCESS;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms )
+{
+   struct epoll_event events[MAXIMUM_POLL_EVENTS];
+   int result, ii, max_events = *p_count > MAXIMUM_POLL_EVENTS ? MAXIMUM_POLL_EVENTS : (int)*p_count;
+
+   *p_count = 0;
+   result = epoll_wait(p_poll->epoll_fd, events, max_events,
+         timeout_ms == INFINITE_TIMEOUT_MS ? -1 : timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+   if (result < 0)
+      return errno == EINTR ? VC_CONTAINER_NET_ERROR_TIMED_OUT : vc_container_net_private_last_error();
+
+   for (ii = 0; ii < result; ii++)
+      ready[ii] = events[ii].data.ptr;
+   *p_count = (size_t)result;
+
+   return result ? VC_CONTAINER_NET_SUCCESS : VC_CONTAINER_NET_ERROR_TIMED_OUT;
+}
+
+#else
+/*****************************************************************************/
+VC_CONTAINER_NET_POLL_T *vc_container_net_private_poll_create( vc_container_net_status_t *p_status )
+{
+   VC_CONTAINER_NET_POLL_T *p_poll = (VC_CONTAINER_NET_POLL_T *)calloc(1, sizeof(*p_poll));
+
+   if (!p_poll)
+   {
+      *p_status = VC_CONTAINER_NET_ERROR_NO_MEMORY;
+      return NULL;
+   }
+
+   if (pthread_mutex_init(&p_poll->lock, NULL))
+   {
+      *p_status = VC_CONTAINER_NET_ERROR_GENERAL;
+      free(p_poll);
+      return NULL;
+   }
+
+   *p_status = VC_CONTAINER_NET_SUCCESS;
+   return p_poll;
+}
+
+/*****************************************************************************/
+void vc_container_net_private_poll_close( VC_CONTAINER_NET_POLL_T *p_poll )
+{
+   pthread_mutex_destroy(&p_poll->lock);
+   free(p_poll->fds);
+   free(p_poll->userdata);
+   free(p_poll->wait_fds);
+   free(p_poll->wait_userdata);
+   free(p_poll);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock, void *userdata )
+{
+   vc_container_net_status_t status = VC_CONTAINER_NET_SUCCESS;
+
+   pthread_mutex_lock(&p_poll->lock);
+   if (p_poll->count == p_poll->capacity)
+   {
+      size_t capacity = p_poll->capacity ? p_poll->capacity * 2 : MAXIMUM_POLL_EVENTS;
+      struct pollfd *fds = (struct pollfd *)realloc(p_poll->fds, capacity * sizeof(*fds));
+      void **values = fds ? (void **)realloc(p_poll->userdata, capacity * sizeof(*values)) : NULL;
+
+      if (fds)
+         p_poll->fds = fds;
+      if (values)
+      {
+         p_poll->userdata = values;
+         p_poll->capacity = capacity;
+      }
+      else
+         status = VC_CONTAINER_NET_ERROR_NO_MEMORY;
+   }
+
+   if (status == VC_CONTAINER_NET_SUCCESS)
+   {
+      p_poll->fds[p_poll->count].fd = sock;
+      p_poll->fds[p_poll->count].events = POLLIN;
+      p_poll->userdata[p_poll->count] = userdata;
+      p_poll->count++;
+   }
+   pthread_mutex_unlock(&p_poll->lock);
+
+   return status;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock )
+{
+   vc_container_net_status_t status = VC_CONTAINER_NET_ERROR_INVALID_SOCKET;
+   size_t ii;
+
+   pthread_mutex_lock(&p_poll->lock);
+   for (ii = 0; ii < p_poll->count; ii++)
+   {
+      if (p_poll->fds[ii].fd != sock)
+         continue;
+      p_poll->count--;
+      p_poll->fds[ii] = p_poll->fds[p_poll->count];
+      p_poll->userdata[ii] = p_poll->userdata[p_poll->count];
+      status = VC_CONTAINER_NET_SUCCESS;
+      break;
+   }
+   pthread_mutex_unlock(&p_poll->lock);
+
+   return status;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms )
+{
+   size_t ii, count, found = 0;
+   int result;
+
+   /* Wait on a copy, so that the set can change in the meantime */
+   pthread_mutex_lock(&p_poll->lock);
+   count = p_poll->count;
+   if (count > p_poll->wait_capacity)
+   {
+      free(p_poll->wait_fds);
+      free(p_poll->wait_userdata);
+      p_poll->wait_fds = (struct pollfd *)malloc(p_poll->capacity * sizeof(*p_poll->wait_fds));
+      p_poll->wait_userdata = (void **)malloc(p_poll->capacity * sizeof(*p_poll->wait_userdata));
+      p_poll->wait_capacity = p_poll->wait_fds && p_poll->wait_userdata ? p_poll->capacity : 0;
+      if (!p_poll->wait_capacity)
+      {
+         pthread_mutex_unlock(&p_poll->lock);
+         *p_count = 0;
+         return VC_CONTAINER_NET_ERROR_NO_MEMORY;
+      }
+   }
+   if (count)
+   {
+      memcpy(p_poll->wait_fds, p_poll->fds, count * sizeof(*p_poll->fds));
+      memcpy(p_poll->wait_userdata, p_poll->userdata, count * sizeof(*p_poll->userdata));
+   }
+   pthread_mutex_unlock(&p_poll->lock);
+
+   result = poll(p_poll->wait_fds, (nfds_t)count,
+         timeout_ms == INFINITE_TIMEOUT_MS ? -1 : timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+   if (result < 0)
+   {
+      *p_count = 0;
+      return errno == EINTR ? VC_CONTAINER_NET_ERROR_TIMED_OUT : vc_container_net_private_last_error();
+   }
+
+   for (ii = 0; ii < count && found < *p_count && result; ii++)
+   {
+      if (!p_poll->wait_fds[ii].revents)
+         continue;
+      ready[found++] = p_poll->wait_userdata[ii];
+      result--;
+   }
+   *p_count = found;
+
+   return found ? VC_CONTAINER_NET_SUCCESS : VC_CONTAINER_NET_ERROR_TIMED_OUT;
+}
+#endif
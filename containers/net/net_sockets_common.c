@@ -53,10 +53,15 @@ struct vc_container_net_tag
    } to_addr;
    /** Number of bytes in to_addr that have been filled. */
    SOCKADDR_LEN_T to_addr_len;
+   /** True once a datagram receiver has stored the address of a sender in to_addr. */
+   bool has_peer;
    /** Maximum size of datagrams. */
    size_t max_datagram_size;
    /** Timeout to use when reading from a socket. INFINITE_TIMEOUT_MS waits forever. */
    uint32_t read_timeout_ms;
+   /** True if the read timeout couldn't be set on the socket itself, so batched reads
+    * have to wait for data before receiving. */
+   bool poll_for_data;
 };
 
 /*****************************************************************************/
@@ -99,11 +104,35 @@ static vc_container_net_status_t socket_set_read_buffer_size(VC_CONTAINER_NET_T
    return VC_CONTAINER_NET_SUCCESS;
 }
 
+/*****************************************************************************/
+static vc_container_net_status_t socket_set_no_delay(VC_CONTAINER_NET_T *p_ctx,
+      int no_delay)
+{
+   int result;
+   const SOCKOPT_CAST_T optptr = (const SOCKOPT_CAST_T)&no_delay;
+
+   if (p_ctx->type != STREAM_CLIENT && p_ctx->type != STREAM_SERVER)
+      return VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
+
+   no_delay = no_delay ? 1 : 0;
+   result = setsockopt(p_ctx->socket, IPPROTO_TCP, TCP_NODELAY, optptr, sizeof(no_delay));
+
+   if (result == SOCKET_ERROR)
+      return vc_container_net_private_last_error();
+
+   return VC_CONTAINER_NET_SUCCESS;
+}
+
 /*****************************************************************************/
 static vc_container_net_status_t socket_set_read_timeout_ms(VC_CONTAINER_NET_T *p_ctx,
       uint32_t timeout_ms)
 {
    p_ctx->read_timeout_ms = timeout_ms;
+
+   /* Batched reads block in the receive call itself, so they need the timeout too.
+    * Not waiting at all can't be set on the socket, but those reads don't block. */
+   p_ctx->poll_for_data = timeout_ms &&
+         !vc_container_net_private_set_read_timeout(p_ctx->socket, timeout_ms);
    return VC_CONTAINER_NET_SUCCESS;
 }
 
@@ -111,17 +140,11 @@ static vc_container_net_status_t socket_set_read_timeout_ms(VC_CONTAINER_NET_T *
 static bool socket_wait_for_data( VC_CONTAINER_NET_T *p_ctx, uint32_t timeout_ms )
 {
    int result;
-   fd_set set;
-   struct timeval tv;
 
    if (timeout_ms == INFINITE_TIMEOUT_MS)
       return true;
 
-   FD_ZERO(&set);
-   FD_SET(p_ctx->socket, &set);
-   tv.tv_sec = timeout_ms / 1000;
-   tv.tv_usec = (timeout_ms - tv.tv_sec * 1000) * 1000;
-   result = select(p_ctx->socket + 1, &set, NULL, NULL, &tv);
+   result = vc_container_net_private_wait_for_data(p_ctx->socket, timeout_ms);
 
    if (result == SOCKET_ERROR)
       p_ctx->status = vc_container_net_private_last_error();
@@ -340,6 +363,8 @@ size_t vc_container_net_read( VC_CONTAINER_NET_T *p_ctx, void *buffer, size_t si
             result = recvfrom(p_ctx->socket, buffer, size, 0, &p_ctx->to_addr.sa, &p_ctx->to_addr_len);
             if (!result)
                p_ctx->status = VC_CONTAINER_NET_ERROR_CONNECTION_LOST;
+            else if (result != SOCKET_ERROR)
+               p_ctx->has_peer = true;
          } else
             p_ctx->status = VC_CONTAINER_NET_ERROR_TIMED_OUT;
       }
@@ -360,6 +385,53 @@ size_t vc_container_net_read( VC_CONTAINER_NET_T *p_ctx, void *buffer, size_t si
    return (size_t)result;
 }
 
+/*****************************************************************************/
+size_t vc_container_net_read_datagrams( VC_CONTAINER_NET_T *p_ctx,
+      VC_CONTAINER_NET_DATAGRAM_T *datagrams, size_t count )
+{
+   int result;
+
+   if (!p_ctx)
+      return 0;
+
+   if (!datagrams || !count)
+   {
+      p_ctx->status = VC_CONTAINER_NET_ERROR_INVALID_PARAMETER;
+      return 0;
+   }
+
+   if (p_ctx->type != DATAGRAM_RECEIVER)
+   {
+      p_ctx->status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
+      return 0;
+   }
+
+   p_ctx->status = VC_CONTAINER_NET_SUCCESS;
+
+   /* Receiving blocks until the read timeout set on the socket, or not at all for a
+    * zero timeout, so there is no need for a separate system call to wait for data */
+   if (p_ctx->poll_for_data && !socket_wait_for_data(p_ctx, p_ctx->read_timeout_ms))
+   {
+      p_ctx->status = VC_CONTAINER_NET_ERROR_TIMED_OUT;
+      return 0;
+   }
+
+   result = vc_container_net_private_read_datagrams(p_ctx->socket, datagrams, count,
+         &p_ctx->to_addr.sa, &p_ctx->to_addr_len, p_ctx->read_timeout_ms != 0);
+   if (result == SOCKET_ERROR)
+   {
+      p_ctx->status = vc_container_net_private_last_error();
+      if (p_ctx->status == VC_CONTAINER_NET_ERROR_WOULD_BLOCK)
+         p_ctx->status = VC_CONTAINER_NET_ERROR_TIMED_OUT;
+      return 0;
+   }
+
+   if (result)
+      p_ctx->has_peer = true;
+
+   return (size_t)result;
+}
+
 /*****************************************************************************/
 size_t vc_container_net_write( VC_CONTAINER_NET_T *p_ctx, const void *buffer, size_t size )
 {
@@ -394,8 +466,18 @@ size_t vc_container_net_write( VC_CONTAINER_NET_T *p_ctx, const void *buffer, si
       break;
 
    default: /* DATAGRAM_RECEIVER */
-      p_ctx->status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
-      result = 0;
+      /* Reply to the sender of the last datagram received, e.g. with RTCP receiver reports */
+      if (!p_ctx->has_peer)
+      {
+         p_ctx->status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
+         result = 0;
+         break;
+      }
+
+      if (size > p_ctx->max_datagram_size)
+         size = p_ctx->max_datagram_size;
+
+      result = sendto(p_ctx->socket, buffer, size, 0, &p_ctx->to_addr.sa, p_ctx->to_addr_len);
       break;
    }
 
@@ -587,6 +669,9 @@ vc_container_net_status_t vc_container_net_control( VC_CONTAINER_NET_T *p_ctx,
    case VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS:
       status = socket_set_read_timeout_ms(p_ctx, va_arg(args, uint32_t));
       break;
+   case VC_CONTAINER_NET_CONTROL_SET_NO_DELAY:
+      status = socket_set_no_delay(p_ctx, va_arg(args, int));
+      break;
    default:
       status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
    }
@@ -594,6 +679,60 @@ vc_container_net_status_t vc_container_net_control( VC_CONTAINER_NET_T *p_ctx,
    return status;
 }
 
+/*****************************************************************************/
+VC_CONTAINER_NET_POLL_T *vc_container_net_poll_create( vc_container_net_status_t *p_status )
+{
+   vc_container_net_status_t status;
+   VC_CONTAINER_NET_POLL_T *p_poll;
+
+   p_poll = vc_container_net_private_poll_create(&status);
+   if (p_status)
+      *p_status = status;
+
+   return p_poll;
+}
+
+/*****************************************************************************/
+void vc_container_net_poll_close( VC_CONTAINER_NET_POLL_T *p_poll )
+{
+   if (p_poll)
+      vc_container_net_private_poll_close(p_poll);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      VC_CONTAINER_NET_T *p_ctx, void *userdata )
+{
+   if (!p_ctx || p_ctx->socket == INVALID_SOCKET)
+      return VC_CONTAINER_NET_ERROR_INVALID_SOCKET;
+   if (!p_poll)
+      return VC_CONTAINER_NET_ERROR_INVALID_PARAMETER;
+
+   return vc_container_net_private_poll_add(p_poll, p_ctx->socket, userdata);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      VC_CONTAINER_NET_T *p_ctx )
+{
+   if (!p_ctx || p_ctx->socket == INVALID_SOCKET)
+      return VC_CONTAINER_NET_ERROR_INVALID_SOCKET;
+   if (!p_poll)
+      return VC_CONTAINER_NET_ERROR_INVALID_PARAMETER;
+
+   return vc_container_net_private_poll_remove(p_poll, p_ctx->socket);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms )
+{
+   if (!p_poll || !ready || !p_count || !*p_count)
+      return VC_CONTAINER_NET_ERROR_INVALID_PARAMETER;
+
+   return vc_container_net_private_poll_wait(p_poll, ready, p_count, timeout_ms);
+}
+
 /*****************************************************************************/
 uint32_t vc_container_net_to_host( uint32_t value )
 {
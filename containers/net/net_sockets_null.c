@@ -75,6 +75,17 @@ size_t vc_container_net_read( VC_CONTAINER_NET_T *p_ctx, void *buffer, size_t si
    return 0;
 }
 
+/*****************************************************************************/
+size_t vc_container_net_read_datagrams( VC_CONTAINER_NET_T *p_ctx,
+      VC_CONTAINER_NET_DATAGRAM_T *datagrams, size_t count )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_ctx);
+   VC_CONTAINER_PARAM_UNUSED(datagrams);
+   VC_CONTAINER_PARAM_UNUSED(count);
+
+   return 0;
+}
+
 /*****************************************************************************/
 size_t vc_container_net_write( VC_CONTAINER_NET_T *p_ctx, const void *buffer, size_t size )
 {
@@ -150,6 +161,55 @@ vc_container_net_status_t vc_container_net_control( VC_CONTAINER_NET_T *p_ctx,
    return VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
 }
 
+/*****************************************************************************/
+VC_CONTAINER_NET_POLL_T *vc_container_net_poll_create( vc_container_net_status_t *p_status )
+{
+   if (p_status)
+      *p_status = VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
+
+   return NULL;
+}
+
+/*****************************************************************************/
+void vc_container_net_poll_close( VC_CONTAINER_NET_POLL_T *p_poll )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_poll);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      VC_CONTAINER_NET_T *p_ctx, void *userdata )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_poll);
+   VC_CONTAINER_PARAM_UNUSED(p_ctx);
+   VC_CONTAINER_PARAM_UNUSED(userdata);
+
+   return VC_CONTAINER_NET_ERROR_INVALID_SOCKET;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      VC_CONTAINER_NET_T *p_ctx )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_poll);
+   VC_CONTAINER_PARAM_UNUSED(p_ctx);
+
+   return VC_CONTAINER_NET_ERROR_INVALID_SOCKET;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms )
+{
+   VC_CONTAINER_PARAM_UNUSED(p_poll);
+   VC_CONTAINER_PARAM_UNUSED(ready);
+   VC_CONTAINER_PARAM_UNUSED(timeout_ms);
+
+   if (p_count)
+      *p_count = 0;
+   return VC_CONTAINER_NET_ERROR_NOT_ALLOWED;
+}
+
 /*****************************************************************************/
 uint32_t vc_container_net_to_host( uint32_t value )
 {
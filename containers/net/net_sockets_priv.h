@@ -72,12 +72,78 @@ void vc_container_net_private_close( SOCKET_T sock );
  * \param enable True to enable reusability, false to clear it. */
 void vc_container_net_private_set_reusable( SOCKET_T sock, bool enable );
 
+/** Set how long a blocking receive on the socket waits for data before failing.
+ *
+ * \param sock The socket to set the timeout on.
+ * \param timeout_ms Time to wait, in milliseconds, or INFINITE_TIMEOUT_MS. Not zero.
+ * \return True if the timeout was set. */
+bool vc_container_net_private_set_read_timeout( SOCKET_T sock, uint32_t timeout_ms );
+
 /** Query the maximum datagram size for the socket.
  *
  * \param sock The socket to query.
  * \return The maximum supported datagram size on the socket. */
 size_t vc_container_net_private_maximum_datagram_size( SOCKET_T sock );
 
+/** Receive a batch of datagrams.
+ * Blocks until the first datagram arrives or the socket's read timeout passes, unless
+ * told not to wait, then takes those already waiting.
+ *
+ * \param sock The socket to receive from.
+ * \param datagrams The buffers to receive into, whose sizes are updated.
+ * \param count The number of buffers.
+ * \param p_addr Updated with the address of the sender of the last datagram.
+ * \param p_addr_len Size of the address buffer, updated to the size of the address.
+ * \param wait False to fail with a would block error if no datagram is waiting.
+ * \return The number of datagrams received, or SOCKET_ERROR. */
+int vc_container_net_private_read_datagrams( SOCKET_T sock, VC_CONTAINER_NET_DATAGRAM_T *datagrams,
+      size_t count, struct sockaddr *p_addr, SOCKADDR_LEN_T *p_addr_len, bool wait );
+
+/** Wait for a socket to have data to read.
+ *
+ * \param sock The socket to wait on.
+ * \param timeout_ms Time to wait, in milliseconds. Not INFINITE_TIMEOUT_MS.
+ * \return 1 if there is data, 0 if the timeout passed first, or SOCKET_ERROR. */
+int vc_container_net_private_wait_for_data( SOCKET_T sock, uint32_t timeout_ms );
+
+/** Create an empty socket set.
+ *
+ * \param p_status Set to the status of the operation.
+ * \return The socket set, or NULL on failure. */
+VC_CONTAINER_NET_POLL_T *vc_container_net_private_poll_create( vc_container_net_status_t *p_status );
+
+/** Close a socket set.
+ *
+ * \param p_poll The socket set. */
+void vc_container_net_private_poll_close( VC_CONTAINER_NET_POLL_T *p_poll );
+
+/** Add a socket to a set.
+ *
+ * \param p_poll The socket set.
+ * \param sock The socket to add.
+ * \param userdata Value reported for the socket when it has data.
+ * \return The status of the operation. */
+vc_container_net_status_t vc_container_net_private_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock, void *userdata );
+
+/** Remove a socket from a set.
+ *
+ * \param p_poll The socket set.
+ * \param sock The socket to remove.
+ * \return The status of the operation. */
+vc_container_net_status_t vc_container_net_private_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock );
+
+/** Wait for sockets of a set to have data.
+ *
+ * \param p_poll The socket set.
+ * \param ready Array where the userdata values of the sockets with data are written.
+ * \param p_count On entry, the size of the array. On exit, the number of sockets with data.
+ * \param timeout_ms Time to wait, in milliseconds, or INFINITE_TIMEOUT_MS.
+ * \return The status of the operation. */
+vc_container_net_status_t vc_container_net_private_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms );
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,9 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "net_sockets.h"
 #include "net_sockets_priv.h"
 #include "containers/core/containers_common.h"
@@ -41,6 +44,21 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /** Maximum socket buffer size to use. */
 #define MAXIMUM_BUFFER_SIZE   65536
 
+/** Initial number of sockets allocated for in a socket set. */
+#define INITIAL_POLL_CAPACITY 64
+
+struct vc_container_net_poll_tag
+{
+   CRITICAL_SECTION lock;     /**< Protects the list of sockets */
+   WSAPOLLFD *fds;            /**< Sockets in the set */
+   void **userdata;           /**< Value to report for each socket */
+   size_t count;              /**< Number of sockets in the set */
+   size_t capacity;           /**< Number of entries allocated */
+   WSAPOLLFD *wait_fds;       /**< Copy of the sockets being waited on */
+   void **wait_userdata;      /**< Copy of the values of the sockets being waited on */
+   size_t wait_capacity;      /**< Number of copies allocated */
+};
+
 /*****************************************************************************/
 static vc_container_net_status_t translate_error_status( int error )
 {
@@ -127,6 +145,15 @@ void vc_container_net_private_set_reusable( SOCKET_T sock, bool enable )
    (void)setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
 }
 
+/*****************************************************************************/
+bool vc_container_net_private_set_read_timeout( SOCKET_T sock, uint32_t timeout_ms )
+{
+   /* A zero timeout waits forever */
+   DWORD opt = timeout_ms == INFINITE_TIMEOUT_MS ? 0 : timeout_ms;
+
+   return setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&opt, sizeof(opt)) != SOCKET_ERROR;
+}
+
 /*****************************************************************************/
 size_t vc_container_net_private_maximum_datagram_size( SOCKET_T sock )
 {
@@ -138,3 +165,192 @@ size_t vc_container_net_private_maximum_datagram_size( SOCKET_T sock )
 
    return max_datagram_size;
 }
+
+/*****************************************************************************/
+int vc_container_net_private_read_datagrams( SOCKET_T sock, VC_CONTAINER_NET_DATAGRAM_T *datagrams,
+      size_t count, struct sockaddr *p_addr, SOCKADDR_LEN_T *p_addr_len, bool wait )
+{
+   size_t ii;
+
+   /* There is no batched receive, so only read on while more datagrams are waiting */
+   for (ii = 0; ii < count; ii++)
+   {
+      SOCKADDR_LEN_T addr_len = *p_addr_len;
+      u_long available = 0;
+      int result;
+
+      if ((ii || !wait) && (ioctlsocket(sock, FIONREAD, &available) == SOCKET_ERROR || !available))
+      {
+         if (ii)
+            break;
+         WSASetLastError(WSAEWOULDBLOCK);
+         return SOCKET_ERROR;
+      }
+
+      result = recvfrom(sock, (char *)datagrams[ii].buffer, (int)datagrams[ii].size, 0, p_addr, &addr_len);
+      if (result == SOCKET_ERROR)
+         return ii ? (int)ii : SOCKET_ERROR;
+      datagrams[ii].size = (size_t)result;
+      *p_addr_len = addr_len;
+   }
+
+   return (int)ii;
+}
+
+/*****************************************************************************/
+int vc_container_net_private_wait_for_data( SOCKET_T sock, uint32_t timeout_ms )
+{
+   fd_set set;
+   struct timeval tv;
+
+   FD_ZERO(&set);
+   FD_SET(sock, &set);
+   tv.tv_sec = timeout_ms / 1000;
+   tv.tv_usec = (timeout_ms - tv.tv_sec * 1000) * 1000;
+
+   return select(0, &set, NULL, NULL, &tv);
+}
+
+/*****************************************************************************/
+VC_CONTAINER_NET_POLL_T *vc_container_net_private_poll_create( vc_container_net_status_t *p_status )
+{
+   VC_CONTAINER_NET_POLL_T *p_poll = (VC_CONTAINER_NET_POLL_T *)calloc(1, sizeof(*p_poll));
+
+   if (!p_poll)
+   {
+      *p_status = VC_CONTAINER_NET_ERROR_NO_MEMORY;
+      return NULL;
+   }
+
+   InitializeCriticalSection(&p_poll->lock);
+   *p_status = VC_CONTAINER_NET_SUCCESS;
+   return p_poll;
+}
+
+/*****************************************************************************/
+void vc_container_net_private_poll_close( VC_CONTAINER_NET_POLL_T *p_poll )
+{
+   DeleteCriticalSection(&p_poll->lock);
+   free(p_poll->fds);
+   free(p_poll->userdata);
+   free(p_poll->wait_fds);
+   free(p_poll->wait_userdata);
+   free(p_poll);
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_add( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock, void *userdata )
+{
+   vc_container_net_status_t status = VC_CONTAINER_NET_SUCCESS;
+
+   EnterCriticalSection(&p_poll->lock);
+   if (p_poll->count == p_poll->capacity)
+   {
+      size_t capacity = p_poll->capacity ? p_poll->capacity * 2 : INITIAL_POLL_CAPACITY;
+      WSAPOLLFD *fds = (WSAPOLLFD *)realloc(p_poll->fds, capacity * sizeof(*fds));
+      void **values = fds ? (void **)realloc(p_poll->userdata, capacity * sizeof(*values)) : NULL;
+
+      if (fds)
+         p_poll->fds = fds;
+      if (values)
+      {
+         p_poll->userdata = values;
+         p_poll->capacity = capacity;
+      }
+      else
+         status = VC_CONTAINER_NET_ERROR_NO_MEMORY;
+   }
+
+   if (status == VC_CONTAINER_NET_SUCCESS)
+   {
+      p_poll->fds[p_poll->count].fd = sock;
+      p_poll->fds[p_poll->count].events = POLLRDNORM;
+      p_poll->userdata[p_poll->count] = userdata;
+      p_poll->count++;
+   }
+   LeaveCriticalSection(&p_poll->lock);
+
+   return status;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_remove( VC_CONTAINER_NET_POLL_T *p_poll,
+      SOCKET_T sock )
+{
+   vc_container_net_status_t status = VC_CONTAINER_NET_ERROR_INVALID_SOCKET;
+   size_t ii;
+
+   EnterCriticalSection(&p_poll->lock);
+   for (ii = 0; ii < p_poll->count; ii++)
+   {
+      if (p_poll->fds[ii].fd != sock)
+         continue;
+      p_poll->count--;
+      p_poll->fds[ii] = p_poll->fds[p_poll->count];
+      p_poll->userdata[ii] = p_poll->userdata[p_poll->count];
+      status = VC_CONTAINER_NET_SUCCESS;
+      break;
+   }
+   LeaveCriticalSection(&p_poll->lock);
+
+   return status;
+}
+
+/*****************************************************************************/
+vc_container_net_status_t vc_container_net_private_poll_wait( VC_CONTAINER_NET_POLL_T *p_poll,
+      void **ready, size_t *p_count, uint32_t timeout_ms )
+{
+   size_t ii, count, found = 0;
+   int result;
+
+   /* Wait on a copy, so that the set can change in the meantime */
+   EnterCriticalSection(&p_poll->lock);
+   count = p_poll->count;
+   if (count > p_poll->wait_capacity)
+   {
+      free(p_poll->wait_fds);
+      free(p_poll->wait_userdata);
+      p_poll->wait_fds = (WSAPOLLFD *)malloc(p_poll->capacity * sizeof(*p_poll->wait_fds));
+      p_poll->wait_userdata = (void **)malloc(p_poll->capacity * sizeof(*p_poll->wait_userdata));
+      p_poll->wait_capacity = p_poll->wait_fds && p_poll->wait_userdata ? p_poll->capacity : 0;
+      if (!p_poll->wait_capacity)
+      {
+         LeaveCriticalSection(&p_poll->lock);
+         *p_count = 0;
+         return VC_CONTAINER_NET_ERROR_NO_MEMORY;
+      }
+   }
+   if (count)
+   {
+      memcpy(p_poll->wait_fds, p_poll->fds, count * sizeof(*p_poll->fds));
+      memcpy(p_poll->wait_userdata, p_poll->userdata, count * sizeof(*p_poll->userdata));
+   }
+   LeaveCriticalSection(&p_poll->lock);
+
+   /* WSAPoll fails on an empty set, rather than waiting */
+   if (!count)
+   {
+      Sleep(timeout_ms);
+      *p_count = 0;
+      return VC_CONTAINER_NET_ERROR_TIMED_OUT;
+   }
+
+   result = WSAPoll(p_poll->wait_fds, (ULONG)count, timeout_ms == INFINITE_TIMEOUT_MS ? -1 : (INT)timeout_ms);
+   if (result == SOCKET_ERROR)
+   {
+      *p_count = 0;
+      return vc_container_net_private_last_error();
+   }
+
+   for (ii = 0; ii < count && found < *p_count && result; ii++)
+   {
+      if (!p_poll->wait_fds[ii].revents)
+         continue;
+      ready[found++] = p_poll->wait_userdata[ii];
+      result--;
+   }
+   *p_count = found;
+
+   return found ? VC_CONTAINER_NET_SUCCESS : VC_CONTAINER_NET_ERROR_TIMED_OUT;
+}
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_logging.h"
 #include "containers/core/containers_list.h"
 #include "containers/core/containers_bits.h"
+#include "containers/core/containers_nal.h"
 #include "rtp_priv.h"
 #include "rtp_base64.h"
 #include "rtp_h264.h"
@@ -47,6 +48,8 @@ typedef enum
    H264F_NEXT_PACKET_IS_START = 0,
    H264F_INSIDE_FRAGMENT,
    H264F_OUTPUT_NAL_HEADER,
+   H264F_DISCARD_FRAME,
+   H264F_DISCONTINUITY,
 } h264_flag_bit_t;
 
 /** Bit mask to extract F zero bit from NAL unit header */
@@ -128,6 +131,7 @@ typedef struct h264_payload_tag
    uint8_t flags;                   /**< H.264 payload flags */
    uint8_t header_bytes_to_write;   /**< Number of start code bytes left to write */
    uint8_t nal_header;              /**< Header for next NAL unit */
+   uint32_t discard_timestamp;      /**< RTP timestamp of the frame being discarded */
 } H264_PAYLOAD_T;
 
 /******************************************************************************
@@ -152,45 +156,18 @@ Local Functions
 static uint32_t h264_remove_emulation_prevention_bytes(uint8_t *sprop,
       uint32_t sprop_size)
 {
-   uint32_t offset = 0;
-   uint8_t nal_unit_type = sprop[offset++];
-   uint32_t new_sprop_size = sprop_size;
-   uint8_t first_byte, second_byte;
-
-   nal_unit_type &= 0x1F;  /* Just keep NAL unit type bits */
+   uint32_t offset = 1;
+   uint8_t nal_unit_type = sprop[0] & 0x1F;  /* Just keep NAL unit type bits */
 
    /* Certain NAL unit types need a byte triplet passed first */
    if (nal_unit_type == NAL_UNIT_PREFIX || nal_unit_type == NAL_UNIT_EXTENSION)
       offset += 3;
 
-   /* Make sure there is enough data for there to be a 0x00 0x00 0x03 sequence */
-   if (offset + 2 >= new_sprop_size)
-      return new_sprop_size;
-
-   /* Keep a rolling set of the last couple of bytes */
-   first_byte = sprop[offset++];
-   second_byte = sprop[offset++];
-
-   while (offset < new_sprop_size)
-   {
-      uint8_t next_byte = sprop[offset];
-
-      if (!first_byte && !second_byte && next_byte == 0x03)
-      {
-         /* Remove the emulation prevention byte (0x03) */
-         new_sprop_size--;
-         if (offset == new_sprop_size) /* No more data to check */
-            break;
-         memmove(&sprop[offset], &sprop[offset + 1], new_sprop_size - offset);
-         next_byte = sprop[offset];
-      } else
-         offset++;
-
-      first_byte = second_byte;
-      second_byte = next_byte;
-   }
+   if (offset >= sprop_size)
+      return sprop_size;
 
-   return new_sprop_size;
+   return offset + (uint32_t)vc_container_nal_remove_epb(sprop + offset, sprop + offset,
+         sprop_size - offset);
 }
 
 /**************************************************************************//**
@@ -624,6 +601,41 @@ static VC_CONTAINER_STATUS_T h264_new_rtp_packet(VC_CONTAINER_T *p_ctx,
    return VC_CONTAINER_SUCCESS;
 }
 
+/**************************************************************************//**
+ * Decide whether a new RTP packet belongs to a frame that is broken by packet
+ * loss. The packets of a frame share a timestamp and the last one has the
+ * marker bit set, so the frame is over once either of those is seen. The first
+ * packet after a loss could be in the middle of a frame, so that frame is
+ * dropped too.
+ *
+ * @param t_module   The track module with the new RTP packet.
+ * @param extra      The H.264 specific track module information.
+ * @return  True if the packet is to be discarded.
+ */
+static bool h264_discard_packet(VC_CONTAINER_TRACK_MODULE_T *t_module,
+      H264_PAYLOAD_T *extra)
+{
+   if (BIT_IS_SET(t_module->flags, TRACK_PACKET_LOST))
+   {
+      SET_BIT(extra->flags, H264F_DISCARD_FRAME);
+      CLEAR_BIT(extra->flags, H264F_INSIDE_FRAGMENT);
+      extra->discard_timestamp = t_module->timestamp;
+   }
+
+   if (BIT_IS_CLEAR(extra->flags, H264F_DISCARD_FRAME))
+      return false;
+
+   if (t_module->timestamp == extra->discard_timestamp && BIT_IS_CLEAR(t_module->flags, TRACK_HAS_MARKER))
+      return true;
+
+   /* The next frame is complete, and the client needs to know about the gap */
+   CLEAR_BIT(extra->flags, H264F_DISCARD_FRAME);
+   SET_BIT(extra->flags, H264F_NEXT_PACKET_IS_START);
+   SET_BIT(extra->flags, H264F_DISCONTINUITY);
+
+   return t_module->timestamp == extra->discard_timestamp;
+}
+
 /**************************************************************************//**
  * H.264 payload handler.
  * Extracts/skips data from the payload according to the NAL unit headers.
@@ -651,6 +663,12 @@ static VC_CONTAINER_STATUS_T h264_payload_handler(VC_CONTAINER_T *p_ctx,
 
    if (BIT_IS_SET(t_module->flags, TRACK_NEW_PACKET))
    {
+      if (h264_discard_packet(t_module, extra))
+      {
+         BITS_INVALIDATE(p_ctx, payload);
+         return VC_CONTAINER_ERROR_CONTINUE;
+      }
+
       status = h264_new_rtp_packet(p_ctx, t_module);
       if (status != VC_CONTAINER_SUCCESS)
          return status;
@@ -659,9 +677,14 @@ static VC_CONTAINER_STATUS_T h264_payload_handler(VC_CONTAINER_T *p_ctx,
    if (BIT_IS_SET(extra->flags, H264F_NEXT_PACKET_IS_START))
    {
       packet_flags |= VC_CONTAINER_PACKET_FLAG_FRAME_START;
+      if (BIT_IS_SET(extra->flags, H264F_DISCONTINUITY))
+         packet_flags |= VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
 
       if (!(flags & VC_CONTAINER_READ_FLAG_INFO))
+      {
          CLEAR_BIT(extra->flags, H264F_NEXT_PACKET_IS_START);
+         CLEAR_BIT(extra->flags, H264F_DISCONTINUITY);
+      }
    }
 
    if (!extra->nal_unit_size && BITS_BYTES_AVAILABLE(p_ctx, payload))
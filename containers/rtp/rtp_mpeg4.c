@@ -44,6 +44,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 Defines and constants.
 ******************************************************************************/
 
+/** MPEG-4 payload flag bits */
+typedef enum
+{
+   MP4F_DISCARD_FRAGMENTS = 0,
+   MP4F_DISCONTINUITY,
+} mp4_flag_bit_t;
+
 /******************************************************************************
 Type definitions
 ******************************************************************************/
@@ -160,6 +167,8 @@ typedef struct mp4_payload_tag
    uint32_t auxiliary_length;
    VC_CONTAINER_BITS_T au_headers;
    AU_INFO_T au_info;
+   uint8_t flags;
+   uint32_t discard_timestamp;
 } MP4_PAYLOAD_T;
 
 /******************************************************************************
@@ -648,6 +657,61 @@ static VC_CONTAINER_STATUS_T mp4_next_au_header(VC_CONTAINER_T *p_ctx,
    return BITS_VALID(p_ctx, au_headers) ? VC_CONTAINER_SUCCESS : VC_CONTAINER_ERROR_FORMAT_INVALID;
 }
 
+/**************************************************************************//**
+ * Decide whether a new RTP packet holds fragments of an AU that is broken by
+ * packet loss. The fragments of an AU share a timestamp and only the last one
+ * has the marker bit set (RFC3640 section 3.2.3), so the broken AU is over once
+ * either of those is seen. The first packet after a loss could be in the middle
+ * of an AU, so that AU is dropped too.
+ *
+ * @param p_ctx      The RTP container context.
+ * @param t_module   The track module with the new RTP packet.
+ * @return  The resulting status of the function, VC_CONTAINER_ERROR_CONTINUE
+ *          if the packet is to be discarded.
+ */
+static VC_CONTAINER_STATUS_T mp4_discard_fragments(VC_CONTAINER_T *p_ctx,
+      VC_CONTAINER_TRACK_MODULE_T *t_module)
+{
+   MP4_PAYLOAD_T *extra = (MP4_PAYLOAD_T *)t_module->extra;
+   AU_INFO_T *au_info = &extra->au_info;
+   VC_CONTAINER_STATUS_T status;
+
+   if (BIT_IS_SET(t_module->flags, TRACK_PACKET_LOST))
+   {
+      SET_BIT(extra->flags, MP4F_DISCARD_FRAGMENTS);
+      SET_BIT(extra->flags, MP4F_DISCONTINUITY);
+      extra->discard_timestamp = t_module->timestamp;
+      au_info->available = 0;
+   }
+
+   if (BIT_IS_CLEAR(extra->flags, MP4F_DISCARD_FRAGMENTS))
+      return VC_CONTAINER_SUCCESS;
+
+   if (t_module->timestamp != extra->discard_timestamp)
+   {
+      /* A new AU starts with this packet */
+      CLEAR_BIT(extra->flags, MP4F_DISCARD_FRAGMENTS);
+      return VC_CONTAINER_SUCCESS;
+   }
+
+   if (BIT_IS_CLEAR(t_module->flags, TRACK_HAS_MARKER))
+      return VC_CONTAINER_ERROR_CONTINUE;
+
+   /* Either complete AUs, or the last fragment of the broken one */
+   CLEAR_BIT(extra->flags, MP4F_DISCARD_FRAGMENTS);
+   status = mp4_next_au_header(p_ctx, extra, true);
+   if (status != VC_CONTAINER_SUCCESS)
+      return status;
+
+   if (au_info->available > BITS_BYTES_AVAILABLE(p_ctx, &t_module->payload))
+   {
+      au_info->available = 0;
+      return VC_CONTAINER_ERROR_CONTINUE;
+   }
+
+   return VC_CONTAINER_SUCCESS;
+}
+
 /**************************************************************************//**
  * MP4 payload handler.
  * Extracts/skips data from the payload according to the AU headers.
@@ -677,6 +741,12 @@ static VC_CONTAINER_STATUS_T mp4_payload_handler(VC_CONTAINER_T *p_ctx,
       status = mp4_new_rtp_packet(p_ctx, t_module);
       if (status != VC_CONTAINER_SUCCESS)
          return status;
+
+      status = mp4_discard_fragments(p_ctx, t_module);
+      if (status == VC_CONTAINER_ERROR_CONTINUE)
+         BITS_INVALIDATE(p_ctx, payload);
+      if (status != VC_CONTAINER_SUCCESS)
+         return status;
    }
 
    if (!au_info->available)
@@ -691,6 +761,14 @@ static VC_CONTAINER_STATUS_T mp4_payload_handler(VC_CONTAINER_T *p_ctx,
       /* Adjust the packet time stamps using deltas */
       p_packet->pts += au_info->cts_delta;
       p_packet->dts += au_info->dts_delta;
+
+      /* Let the client know that data is missing before this */
+      if (BIT_IS_SET(extra->flags, MP4F_DISCONTINUITY))
+      {
+         p_packet->flags |= VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
+         if (!(flags & VC_CONTAINER_READ_FLAG_INFO))
+            CLEAR_BIT(extra->flags, MP4F_DISCONTINUITY);
+      }
    }
 
    size = au_info->available;
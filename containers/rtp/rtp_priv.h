@@ -56,6 +56,7 @@ typedef enum
    TRACK_SSRC_SET = 0,
    TRACK_HAS_MARKER,
    TRACK_NEW_PACKET,
+   TRACK_PACKET_LOST,
 } track_module_flag_bit_t;
 
 /** RTP track data */
@@ -73,6 +74,7 @@ typedef struct VC_CONTAINER_TRACK_MODULE_T
    uint32_t timestamp_wraps;     /**< Count of the times that the timestamp has wrapped */
    uint32_t timestamp_clock;     /**< Clock frequency of RTP timestamp values */
    uint32_t expected_ssrc;       /**< The expected SSRC, if set */
+   uint32_t cycles;              /**< Count of seq. number wraps, shifted up 16 bits */
    uint32_t base_seq;            /**< Base seq number */
    uint32_t bad_seq;             /**< Last 'bad' seq number + 1 */
    uint32_t probation;           /**< Sequential packets till source is valid */
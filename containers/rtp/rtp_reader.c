@@ -39,10 +39,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_logging.h"
 #include "containers/core/containers_bits.h"
 #include "containers/core/containers_list.h"
+#include "interface/vcos/vcos.h"
 
 #include "rtp_priv.h"
 #include "rtp_mpeg4.h"
 #include "rtp_h264.h"
+#include "rtp_rtcp.h"
 
 #ifdef _DEBUG
 /* Validates static sorted lists are correctly constructed */
@@ -59,19 +61,35 @@ Configurable defines and constants.
 /** Maximum number of RTP packets that can be missed without restarting. */
 #define MAX_DROPOUT           3000
 /** Maximum number of out of sequence RTP packets that are accepted. */
-#define MAX_MISORDER          0
+#define MAX_MISORDER          100
 /** Minimum number of sequential packets required for an acceptable connection
  * when restarting. */
 #define MIN_SEQUENTIAL        2
 
+/** Number of RTP packets the jitter buffer can hold. Must be a power of two. */
+#define JITTER_BUFFER_SLOTS   256
+/** Maximum number of packets received from the network in one go */
+#define RECEIVE_BATCH         16
+/** Default latency budget of the jitter buffer, in milliseconds */
+#define DEFAULT_LATENCY_MS    100
+/** Shortest time a missing packet is waited for, in microseconds, when the budget allows */
+#define MINIMUM_WAIT_US       2000
+/** Shift for the rate at which the reordering delay estimate decays, per packet */
+#define REORDER_DELAY_DECAY   12
+
+/** Default mean interval between RTCP receiver reports, in milliseconds */
+#define DEFAULT_RTCP_INTERVAL_MS  5000
+/** Interval between checks for incoming RTCP packets, in microseconds */
+#define RTCP_POLL_INTERVAL_US     20000
+
 /******************************************************************************
 Defines and constants.
 ******************************************************************************/
 
-#define RTP_SCHEME                     "rtp:"
+#define RTP_SCHEME                     "rtp"
 
 /** The RTP PKT scheme is used with test pkt files */
-#define RTP_PKT_SCHEME                     "rtppkt:"
+#define RTP_PKT_SCHEME                     "rtppkt"
 
 /** \name RTP URI parameter names
  * @{ */
@@ -81,8 +99,13 @@ Defines and constants.
 #define RATE_NAME                      "rate"
 #define SSRC_NAME                      "ssrc"
 #define SEQ_NAME                       "seq"
+#define LATENCY_NAME                   "latency"
+#define RTCP_INTERVAL_NAME             "rtcp-interval"
 /* @} */
 
+/** Size of the fixed part of the RTP header */
+#define RTP_HEADER_SIZE                12
+
 /** A sentinel codec that is not supported */
 #define UNSUPPORTED_CODEC              VC_FOURCC(0,0,0,0)
 
@@ -209,10 +232,69 @@ static MIME_TYPE_DATA_T dynamic_mime_details[] = {
 /** Sorted list of dynamic MIME type details */
 VC_CONTAINERS_STATIC_LIST(dynamic_mime, dynamic_mime_details, mime_type_data_comparator);
 
+/** RTP packet, as held in the jitter buffer */
+typedef struct rtp_packet_tag
+{
+   struct rtp_packet_tag *next;  /**< Next packet in the free list */
+   int64_t arrival;              /**< Time of arrival, in microseconds */
+   uint32_t size;                /**< Number of bytes in the packet */
+   uint16_t seq;                 /**< Sequence number */
+   uint8_t data[MAXIMUM_PACKET_SIZE]; /**< The packet itself */
+} RTP_PACKET_T;
+
+/** Jitter buffer slot states */
+typedef enum
+{
+   SLOT_EMPTY = 0,               /**< Not used yet */
+   SLOT_QUEUED,                  /**< Packet waiting to be delivered */
+   SLOT_DELIVERED,               /**< Packet has been delivered */
+   SLOT_LOST,                    /**< Packet was given up on */
+} jitter_slot_state_t;
+
+/** Jitter buffer slot, for one sequence number */
+typedef struct jitter_slot_tag
+{
+   RTP_PACKET_T *packet;         /**< Packet waiting to be delivered */
+   uint16_t seq;                 /**< Sequence number the slot was last used for */
+   uint8_t state;                /**< One of jitter_slot_state_t */
+} JITTER_SLOT_T;
+
+/** Jitter buffer, putting packets back in order of sequence number */
+typedef struct jitter_buffer_tag
+{
+   JITTER_SLOT_T slots[JITTER_BUFFER_SLOTS]; /**< Packets, indexed by sequence number */
+   RTP_PACKET_T *free_list;      /**< Packets available to receive into */
+   RTP_PACKET_T *current;        /**< Packet being delivered */
+   RTP_PACKET_T *overflow;       /**< Packet too far ahead to fit in the slots yet */
+   uint32_t allocated;           /**< Number of packets allocated */
+   uint32_t queued;              /**< Number of packets waiting in the slots */
+   uint16_t next_seq;            /**< Sequence number of the next packet to deliver */
+   bool started;                 /**< True once next_seq is known */
+   bool packet_lost;             /**< True if packets were given up on since the last delivery */
+   VC_CONTAINER_STATUS_T end_status; /**< Status to return once drained, at the end of the stream */
+   int64_t gap_start;            /**< Time the next packet was first found missing, or zero */
+   int64_t lost_gap_start;       /**< Value gap_start had for the last packets given up on */
+   uint32_t latency;             /**< Latency budget, in microseconds */
+   uint32_t reorder_delay;       /**< Decaying peak of the reordering delays seen, in microseconds */
+   uint32_t read_timeout_ms;     /**< Read timeout set by the client */
+   uint32_t io_timeout_ms;       /**< Read timeout currently set on the i/o */
+   bool single_reads;            /**< True if the i/o can't read batches of datagrams */
+} JITTER_BUFFER_T;
+
 /** RTP reader data. */
 typedef struct VC_CONTAINER_MODULE_T
 {
    VC_CONTAINER_TRACK_T *track;
+   JITTER_BUFFER_T jitter_buffer;   /**< Reorders packets and detects losses */
+   RTCP_SESSION_T *rtcp;            /**< RTCP session, or NULL */
+   int64_t rtcp_poll_time;          /**< Time at which to next check for RTCP packets */
+   uint32_t ssrc;                   /**< SSRC of the source being received */
+   uint32_t transit;                /**< Relative transit time of the previous packet */
+   uint32_t jitter;                 /**< Interarrival jitter, in timestamp units scaled by 16 */
+   bool has_transit;                /**< True once transit has been set */
+   uint32_t expected_prior;         /**< Packets expected at the last receiver report */
+   uint32_t received_prior;         /**< Packets received at the last receiver report */
+   VC_CONTAINER_RTP_STATS_T stats;  /**< Loss, late and reorder counters */
 } VC_CONTAINER_MODULE_T;
 
 /******************************************************************************
@@ -553,13 +635,15 @@ static void init_sequence_number(VC_CONTAINER_TRACK_MODULE_T *t_module,
    t_module->base_seq = seq;
    t_module->max_seq_num = seq;
    t_module->bad_seq = RTP_SEQ_MOD + 1;   /* so seq == bad_seq is false */
+   t_module->cycles = 0;
    t_module->received = 0;
 }
 
 /**************************************************************************//**
  * Checks whether the sequence number for a packet is acceptable or not.
  * The packet will be unacceptable if it is out of sequence by some degree, or
- * if the packet sequence is still being established.
+ * if the packet sequence is still being established. Packets that are only a
+ * little out of order are accepted, the jitter buffer puts them back in order.
  *
  * @param t_module   The track module.
  * @param seq        The new sequence number.
@@ -577,7 +661,7 @@ static bool update_sequence_number(VC_CONTAINER_TRACK_MODULE_T *t_module,
    if (t_module->probation)
    {
       /* packet is in sequence */
-      if (seq == t_module->max_seq_num + 1)
+      if (seq == (uint16_t)(t_module->max_seq_num + 1))
       {
          t_module->probation--;
          t_module->max_seq_num = seq;
@@ -586,7 +670,6 @@ static bool update_sequence_number(VC_CONTAINER_TRACK_MODULE_T *t_module,
          if (!t_module->probation)
          {
             init_sequence_number(t_module, seq);
-            t_module->received++;
             return 1;
          }
       } else {
@@ -597,46 +680,32 @@ static bool update_sequence_number(VC_CONTAINER_TRACK_MODULE_T *t_module,
       return 0;
    } else if (udelta < MAX_DROPOUT)
    {
-      if (!udelta)
-      {
-         /* Duplicate packet, drop it */
-         LOG_INFO(0, "RTP: Drop duplicate packet at 0x%4.4hx", seq);
-         return 0;
-      }
       if (udelta > 1)
       {
          LOG_INFO(0, "RTP: Jumped by %hu packets to 0x%4.4hx", udelta, seq);
       }
       /* in order, with permissible gap */
+      if (seq < t_module->max_seq_num)
+         t_module->cycles += RTP_SEQ_MOD;
       t_module->max_seq_num = seq;
-   } else
-#if (MAX_MISORDER != 0)
-      /* When MAX_MISORDER is zero, always treat as out of order */
-      if (udelta <= RTP_SEQ_MOD - MAX_MISORDER)
-#endif
+   } else if (udelta <= RTP_SEQ_MOD - MAX_MISORDER)
+   {
+      /* the sequence number made a very large jump */
+      if (seq == t_module->bad_seq)
       {
-         /* the sequence number made a very large jump */
-         if (seq == t_module->bad_seq)
-         {
-            LOG_INFO(0, "RTP: Misorder restart at 0x%4.4hx", seq);
-            /* Two sequential packets -- assume that the other side
-             * restarted without telling us so just re-sync
-             * (i.e., pretend this was the first packet). */
-            init_sequence_number(t_module, seq);
-         } else {
-            LOG_INFO(0, "RTP: Misorder at 0x%4.4hx, expected 0x%4.4hx", seq, t_module->max_seq_num);
-            t_module->bad_seq = (seq + 1) & (RTP_SEQ_MOD-1);
-            return 0;
-         }
+         LOG_INFO(0, "RTP: Misorder restart at 0x%4.4hx", seq);
+         /* Two sequential packets -- assume that the other side
+          * restarted without telling us so just re-sync
+          * (i.e., pretend this was the first packet). */
+         init_sequence_number(t_module, seq);
+      } else {
+         LOG_INFO(0, "RTP: Misorder at 0x%4.4hx, expected 0x%4.4hx", seq, t_module->max_seq_num);
+         t_module->bad_seq = (seq + 1) & (RTP_SEQ_MOD-1);
+         return 0;
       }
-#if (MAX_MISORDER != 0)
-   else {
-      /* duplicate or reordered packet */
-
-      /* TODO: handle out of order packets */
    }
-#endif
-   t_module->received++;
+   /* Otherwise a duplicate or reordered packet, left to the jitter buffer */
+
    return 1;
 }
 
@@ -671,25 +740,15 @@ static void decode_rtp_packet_header(VC_CONTAINER_T *p_ctx,
    if (!BITS_VALID(p_ctx, payload))
       return;
 
-   /* Validate version, payload type, sequence number and SSRC, if set */
+   /* Validate version and payload type. The SSRC and sequence number have already
+    * been checked by the jitter buffer. */
+   VC_CONTAINER_PARAM_UNUSED(ssrc);
+   VC_CONTAINER_PARAM_UNUSED(seq_num);
    if (version != 2 || payload_type != t_module->payload_type)
    {
       BITS_INVALIDATE(p_ctx, payload);
       return;
    }
-   if (BIT_IS_SET(t_module->flags, TRACK_SSRC_SET) && (ssrc != t_module->expected_ssrc))
-   {
-      LOG_DEBUG(p_ctx, "RTP: Unexpected SSRC (0x%8.8X)", ssrc);
-      BITS_INVALIDATE(p_ctx, payload);
-      return;
-   }
-
-   /* Check sequence number indicates packet is usable */
-   if (!update_sequence_number(t_module, seq_num))
-   {
-      BITS_INVALIDATE(p_ctx, payload);
-      return;
-   }
 
    /* Adjust to account for padding, CSRCs and extension */
    if (has_padding)
@@ -731,6 +790,567 @@ static void decode_rtp_packet_header(VC_CONTAINER_T *p_ctx,
    t_module->timestamp -= t_module->timestamp_base;
 }
 
+/**************************************************************************//**
+ * Gets a packet to receive into, allocating a new one if necessary.
+ *
+ * @param jb   The jitter buffer.
+ * @return  The packet, or NULL if out of memory.
+ */
+static RTP_PACKET_T *jitter_buffer_get_packet(JITTER_BUFFER_T *jb)
+{
+   RTP_PACKET_T *packet = jb->free_list;
+
+   if (packet)
+   {
+      jb->free_list = packet->next;
+      return packet;
+   }
+
+   /* The slots, the current and the overflow packets, plus those being received */
+   if (jb->allocated >= JITTER_BUFFER_SLOTS + 2 + RECEIVE_BATCH)
+      return NULL;
+
+   packet = (RTP_PACKET_T *)malloc(sizeof(RTP_PACKET_T));
+   if (packet)
+      jb->allocated++;
+   return packet;
+}
+
+/**************************************************************************//**
+ * Returns a packet to the free list.
+ *
+ * @param jb      The jitter buffer.
+ * @param packet  The packet.
+ */
+static void jitter_buffer_release_packet(JITTER_BUFFER_T *jb, RTP_PACKET_T *packet)
+{
+   packet->next = jb->free_list;
+   jb->free_list = packet;
+}
+
+/**************************************************************************//**
+ * Discards all the packets waiting in the jitter buffer.
+ * The sequence is restarted by the next packet received.
+ *
+ * @param jb   The jitter buffer.
+ */
+static void jitter_buffer_flush(JITTER_BUFFER_T *jb)
+{
+   uint32_t ii;
+
+   for (ii = 0; ii < JITTER_BUFFER_SLOTS; ii++)
+   {
+      JITTER_SLOT_T *slot = &jb->slots[ii];
+
+      if (slot->packet)
+         jitter_buffer_release_packet(jb, slot->packet);
+      slot->packet = NULL;
+      slot->state = SLOT_EMPTY;
+   }
+   if (jb->overflow)
+      jitter_buffer_release_packet(jb, jb->overflow);
+   jb->overflow = NULL;
+   jb->queued = 0;
+   jb->started = false;
+   jb->gap_start = 0;
+}
+
+/**************************************************************************//**
+ * Frees all the memory used by the jitter buffer.
+ *
+ * @param jb   The jitter buffer.
+ */
+static void jitter_buffer_free(JITTER_BUFFER_T *jb)
+{
+   jitter_buffer_flush(jb);
+   if (jb->current)
+      jitter_buffer_release_packet(jb, jb->current);
+   jb->current = NULL;
+
+   while (jb->free_list)
+   {
+      RTP_PACKET_T *packet = jb->free_list;
+
+      jb->free_list = packet->next;
+      free(packet);
+   }
+   jb->allocated = 0;
+}
+
+/**************************************************************************//**
+ * Puts a packet in its slot.
+ *
+ * @param jb      The jitter buffer.
+ * @param packet  The packet, which must fit in the slots.
+ */
+static void jitter_buffer_queue(JITTER_BUFFER_T *jb, RTP_PACKET_T *packet)
+{
+   JITTER_SLOT_T *slot = &jb->slots[packet->seq & (JITTER_BUFFER_SLOTS - 1)];
+
+   slot->packet = packet;
+   slot->seq = packet->seq;
+   slot->state = SLOT_QUEUED;
+   jb->queued++;
+}
+
+/**************************************************************************//**
+ * Works out how long to wait for a missing packet.
+ * This adapts to the reordering delays and jitter seen so far, within the
+ * latency budget.
+ *
+ * @param module     The reader module.
+ * @param t_module   The track module.
+ * @return  The time to wait, in microseconds.
+ */
+static uint32_t jitter_buffer_target(VC_CONTAINER_MODULE_T *module,
+      VC_CONTAINER_TRACK_MODULE_T *t_module)
+{
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   uint64_t target, jitter;
+
+   jitter = (uint64_t)(module->jitter >> 4) * MICROSECONDS_PER_SECOND / t_module->timestamp_clock;
+   target = jb->reorder_delay + (jb->reorder_delay >> 1) + 4 * jitter;
+   if (target < MINIMUM_WAIT_US)
+      target = MINIMUM_WAIT_US;
+   if (target > jb->latency)
+      target = jb->latency;
+
+   return (uint32_t)target;
+}
+
+/**************************************************************************//**
+ * Finds when the packets waiting behind the next, missing, one started
+ * arriving.
+ *
+ * @param jb   The jitter buffer.
+ * @return  Earliest arrival time of the packets waiting.
+ */
+static int64_t jitter_buffer_gap_start(JITTER_BUFFER_T *jb)
+{
+   int64_t gap_start = 0;
+   uint32_t ii, found = 0;
+
+   for (ii = 1; ii < JITTER_BUFFER_SLOTS && found < jb->queued; ii++)
+   {
+      uint16_t seq = jb->next_seq + ii;
+      JITTER_SLOT_T *slot = &jb->slots[seq & (JITTER_BUFFER_SLOTS - 1)];
+
+      if (slot->state != SLOT_QUEUED || slot->seq != seq)
+         continue;
+      if (!found++ || slot->packet->arrival < gap_start)
+         gap_start = slot->packet->arrival;
+   }
+
+   if (jb->overflow && (!gap_start || jb->overflow->arrival < gap_start))
+      gap_start = jb->overflow->arrival;
+
+   return gap_start;
+}
+
+/**************************************************************************//**
+ * Gives up on the missing packets up to the next one available.
+ *
+ * @param module   The reader module.
+ */
+static void jitter_buffer_skip_gap(VC_CONTAINER_MODULE_T *module)
+{
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   JITTER_SLOT_T *slot;
+
+   do
+   {
+      slot = &jb->slots[jb->next_seq & (JITTER_BUFFER_SLOTS - 1)];
+      slot->seq = jb->next_seq++;
+      slot->state = SLOT_LOST;
+      module->stats.lost++;
+
+      /* Make room for a packet that was too far ahead */
+      if (jb->overflow && (uint16_t)(jb->overflow->seq - jb->next_seq) < JITTER_BUFFER_SLOTS)
+      {
+         jitter_buffer_queue(jb, jb->overflow);
+         jb->overflow = NULL;
+      }
+
+      slot = &jb->slots[jb->next_seq & (JITTER_BUFFER_SLOTS - 1)];
+   } while ((slot->state != SLOT_QUEUED || slot->seq != jb->next_seq) && (jb->queued || jb->overflow));
+
+   LOG_DEBUG(NULL, "RTP: Lost packets up to 0x%4.4hx", jb->next_seq);
+   jb->packet_lost = true;
+   jb->lost_gap_start = jb->gap_start;
+   jb->gap_start = 0;
+}
+
+/**************************************************************************//**
+ * Checks a packet that has just been received and adds it to the jitter buffer,
+ * or drops it.
+ *
+ * @param p_ctx      The reader context.
+ * @param packet     The packet.
+ */
+static void jitter_buffer_insert(VC_CONTAINER_T *p_ctx, RTP_PACKET_T *packet)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *t_module = module->track->priv->module;
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   const uint8_t *data = packet->data;
+   uint32_t timestamp, ssrc, transit;
+   JITTER_SLOT_T *slot;
+   uint16_t delta;
+
+   /* Check the fixed header before looking at the sequence number */
+   if (packet->size < RTP_HEADER_SIZE || (data[0] >> 6) != 2 || (data[1] & 0x7F) != t_module->payload_type)
+      goto drop;
+
+   packet->seq = (data[2] << 8) | data[3];
+   timestamp = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+   ssrc = (data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+
+   if (BIT_IS_SET(t_module->flags, TRACK_SSRC_SET) && (ssrc != t_module->expected_ssrc))
+   {
+      LOG_DEBUG(p_ctx, "RTP: Unexpected SSRC (0x%8.8X)", ssrc);
+      goto drop;
+   }
+
+   /* Check sequence number indicates packet is usable */
+   if (!update_sequence_number(t_module, packet->seq))
+      goto drop;
+
+   if (!t_module->received)
+   {
+      /* The sequence has started, or restarted, with this packet */
+      if (jb->started)
+      {
+         jitter_buffer_flush(jb);
+         jb->packet_lost = true;
+      }
+      jb->started = true;
+      jb->next_seq = packet->seq;
+      t_module->base_seq = packet->seq;
+      t_module->cycles = 0;
+      module->expected_prior = module->received_prior = 0;
+   }
+   module->ssrc = ssrc;
+
+   /* Interarrival jitter, see RFC3550 section A.8 */
+   transit = (uint32_t)((uint64_t)packet->arrival * t_module->timestamp_clock / MICROSECONDS_PER_SECOND) - timestamp;
+   if (module->has_transit)
+   {
+      int32_t d = (int32_t)(transit - module->transit);
+
+      if (d < 0)
+         d = -d;
+      module->jitter += d - ((module->jitter + 8) >> 4);
+   }
+   module->transit = transit;
+   module->has_transit = true;
+
+   delta = packet->seq - jb->next_seq;
+   if ((int16_t)delta < 0)
+   {
+      /* Already delivered, or given up on */
+      slot = &jb->slots[packet->seq & (JITTER_BUFFER_SLOTS - 1)];
+      if (slot->seq == packet->seq && slot->state == SLOT_LOST)
+      {
+         LOG_DEBUG(p_ctx, "RTP: Late packet at 0x%4.4hx", packet->seq);
+         module->stats.late++;
+         t_module->received++;
+
+         /* Wait longer next time */
+         if (jb->lost_gap_start && packet->arrival - jb->lost_gap_start > jb->reorder_delay)
+            jb->reorder_delay = (uint32_t)(packet->arrival - jb->lost_gap_start);
+      }
+      else
+         module->stats.duplicates++;
+      goto drop;
+   }
+
+   if (delta >= JITTER_BUFFER_SLOTS)
+   {
+      /* Too far ahead to be queued until the missing packets are given up on */
+      jb->overflow = packet;
+      t_module->received++;
+      return;
+   }
+
+   slot = &jb->slots[packet->seq & (JITTER_BUFFER_SLOTS - 1)];
+   if (slot->state == SLOT_QUEUED && slot->seq == packet->seq)
+   {
+      module->stats.duplicates++;
+      goto drop;
+   }
+
+   if ((int16_t)(t_module->max_seq_num - packet->seq) > 0)
+      module->stats.reordered++;
+   jitter_buffer_queue(jb, packet);
+   t_module->received++;
+   return;
+
+drop:
+   jitter_buffer_release_packet(jb, packet);
+}
+
+/**************************************************************************//**
+ * Receives the RTP packets waiting on the i/o straight into free packets, with
+ * a single call where the i/o supports it.
+ *
+ * @param p_ctx      The reader context.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T jitter_buffer_receive_batch(VC_CONTAINER_T *p_ctx)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   VC_CONTAINER_IO_DATAGRAM_T datagrams[RECEIVE_BATCH];
+   RTP_PACKET_T *packets[RECEIVE_BATCH];
+   VC_CONTAINER_STATUS_T status;
+   unsigned int count, received = 0, ii;
+   int64_t arrival;
+
+   for (count = 0; count < RECEIVE_BATCH; count++)
+   {
+      packets[count] = jitter_buffer_get_packet(jb);
+      if (!packets[count])
+         break;
+      datagrams[count].data = packets[count]->data;
+      datagrams[count].size = MAXIMUM_PACKET_SIZE;
+   }
+   if (!count)
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+
+   status = vc_container_io_control(p_ctx->priv->io, VC_CONTAINER_CONTROL_IO_READ_DATAGRAMS,
+         datagrams, count, &received);
+   if (status == VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION)
+      jb->single_reads = true;
+
+   arrival = vcos_getmicrosecs64();
+   for (ii = 0; ii < received; ii++)
+   {
+      /* Give up on the gap before a packet too far ahead, as if received one by one */
+      if (jb->overflow)
+         jitter_buffer_skip_gap(module);
+
+      packets[ii]->size = datagrams[ii].size;
+      packets[ii]->arrival = arrival;
+      jitter_buffer_insert(p_ctx, packets[ii]);
+   }
+   for (; ii < count; ii++)
+      jitter_buffer_release_packet(jb, packets[ii]);
+
+   return received ? VC_CONTAINER_SUCCESS : status;
+}
+
+/**************************************************************************//**
+ * Receives RTP packets, waiting for up to the given time for the first one.
+ *
+ * @param p_ctx      The reader context.
+ * @param timeout_ms Time to wait for a packet, in milliseconds.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T jitter_buffer_receive(VC_CONTAINER_T *p_ctx, uint32_t timeout_ms)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   VC_CONTAINER_STATUS_T status;
+   RTP_PACKET_T *packet;
+
+   if (timeout_ms != jb->io_timeout_ms)
+   {
+      vc_container_io_control(p_ctx->priv->io, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, timeout_ms);
+      jb->io_timeout_ms = timeout_ms;
+   }
+
+   if (!jb->single_reads)
+   {
+      status = jitter_buffer_receive_batch(p_ctx);
+      if (!jb->single_reads)
+         return status;
+   }
+
+   packet = jitter_buffer_get_packet(jb);
+   if (!packet)
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+
+   packet->size = READ_BYTES(p_ctx, packet->data, MAXIMUM_PACKET_SIZE);
+   if (!packet->size)
+   {
+      jitter_buffer_release_packet(jb, packet);
+      return STREAM_STATUS(p_ctx);
+   }
+   packet->arrival = vcos_getmicrosecs64();
+
+   jitter_buffer_insert(p_ctx, packet);
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Checks for RTCP packets and sends a receiver report when one is due.
+ *
+ * @param p_ctx   The reader context.
+ * @param now     Current time, in microseconds.
+ */
+static void rtp_update_rtcp(VC_CONTAINER_T *p_ctx, int64_t now)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *t_module = module->track->priv->module;
+   uint32_t expected, expected_interval, received_interval;
+   RTCP_REPORT_BLOCK_T block;
+
+   module->rtcp_poll_time = now + RTCP_POLL_INTERVAL_US;
+   rtcp_receive(module->rtcp, module->ssrc, now);
+
+   if (!t_module->received || !rtcp_report_due(module->rtcp, now))
+      return;
+
+   /* See RFC3550 section A.3 */
+   block.ssrc = module->ssrc;
+   block.extended_max_seq = t_module->cycles + t_module->max_seq_num;
+   expected = block.extended_max_seq - t_module->base_seq + 1;
+   block.cumulative_lost = (int32_t)(expected - t_module->received);
+
+   expected_interval = expected - module->expected_prior;
+   received_interval = t_module->received - module->received_prior;
+   module->expected_prior = expected;
+   module->received_prior = t_module->received;
+   if (expected_interval && expected_interval > received_interval)
+      block.fraction_lost = (uint8_t)(((expected_interval - received_interval) << 8) / expected_interval);
+   else
+      block.fraction_lost = 0;
+   block.jitter = module->jitter >> 4;
+
+   if (rtcp_send_report(module->rtcp, &block, now) != VC_CONTAINER_SUCCESS)
+      LOG_DEBUG(p_ctx, "RTCP: failed to send receiver report");
+}
+
+/**************************************************************************//**
+ * Gets the next RTP packet, in sequence number order, from the jitter buffer.
+ * Missing packets are waited for until they become too late, then given up on.
+ *
+ * @param p_ctx   The reader context.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtp_next_packet(VC_CONTAINER_T *p_ctx)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *t_module = module->track->priv->module;
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   VC_CONTAINER_STATUS_T status;
+   JITTER_SLOT_T *slot;
+   RTP_PACKET_T *packet;
+
+   if (jb->current)
+      jitter_buffer_release_packet(jb, jb->current);
+   jb->current = NULL;
+
+   while (1)
+   {
+      uint32_t timeout_ms = jb->read_timeout_ms;
+      bool waiting = false;
+      int64_t now;
+
+      if (jb->started)
+      {
+         slot = &jb->slots[jb->next_seq & (JITTER_BUFFER_SLOTS - 1)];
+         if (slot->state == SLOT_QUEUED && slot->seq == jb->next_seq)
+            break;
+      }
+
+      now = vcos_getmicrosecs64();
+      if (module->rtcp && now >= module->rtcp_poll_time)
+         rtp_update_rtcp(p_ctx, now);
+
+      if (jb->queued || jb->overflow)
+      {
+         /* The next packet is missing, wait for it for a while */
+         int64_t deadline;
+
+         if (!jb->gap_start)
+            jb->gap_start = jitter_buffer_gap_start(jb);
+         deadline = jb->gap_start + jitter_buffer_target(module, t_module);
+
+         if (jb->overflow || jb->end_status != VC_CONTAINER_SUCCESS || now >= deadline)
+         {
+            jitter_buffer_skip_gap(module);
+            continue;
+         }
+
+         if ((uint64_t)(deadline - now + 999) / 1000 < timeout_ms)
+         {
+            timeout_ms = (uint32_t)((deadline - now + 999) / 1000);
+            waiting = true;
+         }
+      }
+      else if (jb->end_status != VC_CONTAINER_SUCCESS)
+         return jb->end_status;
+
+      status = jitter_buffer_receive(p_ctx, timeout_ms);
+      if (status == VC_CONTAINER_ERROR_ABORTED && waiting)
+         continue;
+      if (status == VC_CONTAINER_ERROR_ABORTED || status == VC_CONTAINER_ERROR_CONTINUE ||
+          status == VC_CONTAINER_ERROR_OUT_OF_MEMORY)
+         return status;
+      if (status != VC_CONTAINER_SUCCESS)
+         jb->end_status = status;   /* Deliver what is left before reporting this */
+   }
+
+   packet = slot->packet;
+   slot->packet = NULL;
+   slot->state = SLOT_DELIVERED;
+   jb->queued--;
+   jb->next_seq++;
+   jb->current = packet;
+
+   /* Keep track of how long packets take to turn up when out of order */
+   jb->reorder_delay -= jb->reorder_delay >> REORDER_DELAY_DECAY;
+   if (jb->gap_start && packet->arrival > jb->gap_start &&
+         packet->arrival - jb->gap_start > jb->reorder_delay)
+      jb->reorder_delay = (uint32_t)(packet->arrival - jb->gap_start);
+   jb->gap_start = 0;
+
+   if (jb->packet_lost)
+      SET_BIT(t_module->flags, TRACK_PACKET_LOST);
+   else
+      CLEAR_BIT(t_module->flags, TRACK_PACKET_LOST);
+   jb->packet_lost = false;
+
+   t_module->buffer = packet->data;
+   BITS_INIT(p_ctx, &t_module->payload, t_module->buffer, packet->size);
+   decode_rtp_packet_header(p_ctx, t_module);
+   SET_BIT(t_module->flags, TRACK_NEW_PACKET);
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Works out when the reader next needs to be read even if no packet arrives.
+ *
+ * @param p_ctx   The reader context.
+ * @return  Time in microseconds, or INT64_MAX if only the arrival of packets matters.
+ */
+static int64_t rtp_next_read_time(VC_CONTAINER_T *p_ctx)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *t_module = module->track->priv->module;
+   JITTER_BUFFER_T *jb = &module->jitter_buffer;
+   int64_t time = INT64_MAX;
+
+   /* A missing packet is given up on once it is too late */
+   if (jb->queued || jb->overflow)
+      time = jb->gap_start ? jb->gap_start + jitter_buffer_target(module, t_module) : 0;
+
+   /* Receiver reports are only sent at the times RTCP is checked */
+   if (module->rtcp && t_module->received)
+   {
+      int64_t report = rtcp_next_report(module->rtcp);
+
+      if (report < module->rtcp_poll_time)
+         report = module->rtcp_poll_time;
+      if (report < time)
+         time = report;
+   }
+
+   return time;
+}
+
 /**************************************************************************//**
  * Generic payload handler.
  * Copies/skips data verbatim from the packet payload.
@@ -759,6 +1379,14 @@ static VC_CONTAINER_STATUS_T generic_payload_handler(VC_CONTAINER_T *p_ctx,
       return VC_CONTAINER_SUCCESS;
    }
 
+   /* Let the client know that data is missing before this */
+   if (BIT_IS_SET(t_module->flags, TRACK_PACKET_LOST))
+   {
+      p_packet->flags |= VC_CONTAINER_PACKET_FLAG_DISCONTINUITY;
+      if (!(flags & VC_CONTAINER_READ_FLAG_INFO))
+         CLEAR_BIT(t_module->flags, TRACK_PACKET_LOST);
+   }
+
    /* Copy as much as possible into the client packet buffer */
    size = BITS_BYTES_AVAILABLE(p_ctx, payload);
 
@@ -879,6 +1507,40 @@ bool rtp_get_parameter_x32(const VC_CONTAINERS_LIST_T *param_list,
    return false;
 }
 
+/**************************************************************************//**
+ * Fills in the reception statistics.
+ *
+ * @param p_ctx   The reader context.
+ * @param stats   The statistics to fill in.
+ */
+static void rtp_get_stats(VC_CONTAINER_T *p_ctx, VC_CONTAINER_RTP_STATS_T *stats)
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_TRACK_MODULE_T *t_module = module->track->priv->module;
+   uint32_t rtp_timestamp;
+
+   *stats = module->stats;
+   stats->received = t_module->received;
+   stats->expected = t_module->received ?
+         t_module->cycles + t_module->max_seq_num - t_module->base_seq + 1 : 0;
+   stats->jitter = (uint32_t)((uint64_t)(module->jitter >> 4) * MICROSECONDS_PER_SECOND / t_module->timestamp_clock);
+   stats->target_latency = jitter_buffer_target(module, t_module);
+
+   if (module->rtcp && rtcp_get_stats(module->rtcp, stats, &rtp_timestamp) && t_module->timestamp_base)
+   {
+      /* Map the RTP timestamp of the sender report onto the timeline of the packets */
+      int32_t delta = (int32_t)(rtp_timestamp - t_module->timestamp_base - t_module->timestamp);
+      int64_t timestamp = (((int64_t)t_module->timestamp_wraps << 32) | t_module->timestamp) + delta;
+
+      stats->wallclock_pts = timestamp * MICROSECONDS_PER_SECOND / t_module->timestamp_clock;
+   }
+   else
+   {
+      stats->wallclock_time = 0;
+      stats->wallclock_pts = 0;
+   }
+}
+
 /*****************************************************************************
 Functions exported as part of the Container Module API
  *****************************************************************************/
@@ -908,38 +1570,35 @@ static VC_CONTAINER_STATUS_T rtp_reader_read( VC_CONTAINER_T *p_ctx,
 
    CLEAR_BIT(t_module->flags, TRACK_NEW_PACKET);
 
-   while (!BITS_AVAILABLE(p_ctx, &t_module->payload))
+   do
    {
-      uint32_t bytes_read;
-
-      /* No data left from last RTP packet, get another one */
-      bytes_read = READ_BYTES(p_ctx, t_module->buffer, MAXIMUM_PACKET_SIZE);
-      if (!bytes_read)
-         return STREAM_STATUS(p_ctx);
-
-      BITS_INIT(p_ctx, &t_module->payload, t_module->buffer, bytes_read);
-
-      decode_rtp_packet_header(p_ctx, t_module);
-      SET_BIT(t_module->flags, TRACK_NEW_PACKET);
-   }
+      while (!BITS_AVAILABLE(p_ctx, &t_module->payload))
+      {
+         /* No data left from last RTP packet, get another one */
+         status = rtp_next_packet(p_ctx);
+         if (status != VC_CONTAINER_SUCCESS)
+            return status;
+      }
 
-   if (p_packet)
-   {
-      uint32_t timestamp_top = t_module->timestamp >> 30;
-
-      /* Determine whether timestamp has wrapped forwards or backwards around zero */
-      if ((timestamp_top == 0) && (t_module->last_timestamp_top == 3))
-         t_module->timestamp_wraps++;
-      else if ((timestamp_top == 3) && (t_module->last_timestamp_top == 0))
-         t_module->timestamp_wraps--;
-      t_module->last_timestamp_top = timestamp_top;
-
-      p_packet->dts = p_packet->pts = ((int64_t)t_module->timestamp_wraps << 32) | t_module->timestamp;
-      p_packet->track = 0;
-      p_packet->flags = 0;
-   }
+      if (p_packet)
+      {
+         uint32_t timestamp_top = t_module->timestamp >> 30;
+
+         /* Determine whether timestamp has wrapped forwards or backwards around zero */
+         if ((timestamp_top == 0) && (t_module->last_timestamp_top == 3))
+            t_module->timestamp_wraps++;
+         else if ((timestamp_top == 3) && (t_module->last_timestamp_top == 0))
+            t_module->timestamp_wraps--;
+         t_module->last_timestamp_top = timestamp_top;
+
+         p_packet->dts = p_packet->pts = ((int64_t)t_module->timestamp_wraps << 32) | t_module->timestamp;
+         p_packet->track = 0;
+         p_packet->flags = 0;
+      }
 
-   status = t_module->payload_handler(p_ctx, track, p_packet, flags);
+      /* The payload handler discards packets belonging to a frame that is broken */
+      status = t_module->payload_handler(p_ctx, track, p_packet, flags);
+   } while (status == VC_CONTAINER_ERROR_CONTINUE);
    if (p_packet && status == VC_CONTAINER_SUCCESS)
    {
       /* Adjust timestamps from RTP clock rate to microseconds */
@@ -987,6 +1646,7 @@ static VC_CONTAINER_STATUS_T rtp_reader_control( VC_CONTAINER_T *p_ctx,
                                                 va_list args)
 {
    VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    VC_CONTAINER_TRACK_MODULE_T *t_module = p_ctx->tracks[0]->priv->module;
 
    switch (operation)
@@ -1006,6 +1666,47 @@ static VC_CONTAINER_STATUS_T rtp_reader_control( VC_CONTAINER_T *p_ctx,
          status = VC_CONTAINER_SUCCESS;
       }
       break;
+   case VC_CONTAINER_CONTROL_SET_JITTER_BUFFER_LATENCY_MS:
+      {
+         module->jitter_buffer.latency = va_arg(args, uint32_t) * 1000;
+         status = VC_CONTAINER_SUCCESS;
+      }
+      break;
+   case VC_CONTAINER_CONTROL_GET_RTP_STATS:
+      {
+         unsigned int track_num = va_arg(args, unsigned int);
+         VC_CONTAINER_RTP_STATS_T *stats = va_arg(args, VC_CONTAINER_RTP_STATS_T *);
+
+         if (track_num >= p_ctx->tracks_num || !stats)
+            status = VC_CONTAINER_ERROR_INVALID_ARGUMENT;
+         else
+         {
+            rtp_get_stats(p_ctx, stats);
+            status = VC_CONTAINER_SUCCESS;
+         }
+      }
+      break;
+   case VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS:
+      {
+         va_list io_args;
+
+         /* Remember the client's timeout, as the jitter buffer changes the i/o one
+          * while waiting for missing packets. The i/o gets it as usual. */
+         va_copy(io_args, args);
+         module->jitter_buffer.read_timeout_ms = va_arg(io_args, uint32_t);
+         module->jitter_buffer.io_timeout_ms = module->jitter_buffer.read_timeout_ms;
+         va_end(io_args);
+         status = VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+      }
+      break;
+   case VC_CONTAINER_CONTROL_GET_NEXT_READ_TIME:
+      {
+         int64_t *p_time = va_arg(args, int64_t *);
+
+         *p_time = rtp_next_read_time(p_ctx);
+         status = VC_CONTAINER_SUCCESS;
+      }
+      break;
    case VC_CONTAINER_CONTROL_SET_SOURCE_ID:
       {
          t_module->expected_ssrc = va_arg(args, uint32_t);
@@ -1032,6 +1733,12 @@ static VC_CONTAINER_STATUS_T rtp_reader_close( VC_CONTAINER_T *p_ctx )
 
    vc_container_assert(p_ctx->tracks_num < 2);
 
+   if (module)
+   {
+      jitter_buffer_free(&module->jitter_buffer);
+      rtcp_close(module->rtcp);
+   }
+
    if (p_ctx->tracks_num)
    {
       void *payload_extra;
@@ -1069,6 +1776,9 @@ VC_CONTAINER_STATUS_T rtp_reader_open( VC_CONTAINER_T *p_ctx )
    VC_CONTAINERS_LIST_T *parameters = NULL;
    uint32_t payload_type;
    uint32_t initial_seq_num;
+   uint32_t latency_ms = DEFAULT_LATENCY_MS;
+   uint32_t rtcp_interval_ms = DEFAULT_RTCP_INTERVAL_MS;
+   const char *host, *port;
 
    /* Check the URI scheme looks valid */
    if (!vc_uri_scheme(p_ctx->priv->uri) ||
@@ -1095,8 +1805,8 @@ VC_CONTAINER_STATUS_T rtp_reader_open( VC_CONTAINER_T *p_ctx )
    p_ctx->priv->module = module;
    p_ctx->tracks = &module->track;
 
-   /* Allocate the track, including space for reading an RTP packet on the end */
-   track = vc_container_allocate_track(p_ctx, sizeof(VC_CONTAINER_TRACK_MODULE_T) + MAXIMUM_PACKET_SIZE);
+   /* Allocate the track. RTP packets are read into the jitter buffer. */
+   track = vc_container_allocate_track(p_ctx, sizeof(VC_CONTAINER_TRACK_MODULE_T));
    if (!track)
    {
       status = VC_CONTAINER_ERROR_OUT_OF_MEMORY;
@@ -1107,7 +1817,6 @@ VC_CONTAINER_STATUS_T rtp_reader_open( VC_CONTAINER_T *p_ctx )
    t_module = track->priv->module;
 
    /* Initialise the track data */
-   t_module->buffer = (uint8_t *)(t_module + 1);
    status = decode_payload_type(p_ctx, track, parameters, payload_type);
    if (status != VC_CONTAINER_SUCCESS)
       goto error;
@@ -1129,6 +1838,20 @@ VC_CONTAINER_STATUS_T rtp_reader_open( VC_CONTAINER_T *p_ctx )
       t_module->probation = 0;
    }
 
+   rtp_get_parameter_u32(parameters, LATENCY_NAME, &latency_ms);
+   module->jitter_buffer.latency = latency_ms * 1000;
+   module->jitter_buffer.read_timeout_ms = VC_CONTAINER_READ_TIMEOUT_BLOCK;
+   module->jitter_buffer.io_timeout_ms = VC_CONTAINER_READ_TIMEOUT_BLOCK;
+
+   /* When listening for RTP packets, listen for RTCP on the next port up (RFC3550 section 11) */
+   host = vc_uri_host(p_ctx->priv->uri);
+   port = vc_uri_port(p_ctx->priv->uri);
+   if (!strcasecmp(vc_uri_scheme(p_ctx->priv->uri), RTP_SCHEME) && (!host || !*host) && port && *port)
+   {
+      rtp_get_parameter_u32(parameters, RTCP_INTERVAL_NAME, &rtcp_interval_ms);
+      module->rtcp = rtcp_open(strtoul(port, NULL, 10) + 1, rtcp_interval_ms);
+   }
+
    track->is_enabled = true;
 
    vc_containers_list_destroy(parameters);
@@ -1144,7 +1867,6 @@ error:
    if (parameters) vc_containers_list_destroy(parameters);
    if(status == VC_CONTAINER_SUCCESS || status == VC_CONTAINER_ERROR_EOS)
       status = VC_CONTAINER_ERROR_FORMAT_INVALID;
-   LOG_DEBUG(p_ctx, "error opening RTP (%i)", status);
    rtp_reader_close(p_ctx);
    return status;
 }
@@ -0,0 +1,320 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_io.h"
+#include "containers/core/containers_logging.h"
+#include "interface/vcos/vcos.h"
+#include "rtp_rtcp.h"
+
+/******************************************************************************
+Defines and constants.
+******************************************************************************/
+
+/** RTCP packet types, see RFC3550 section 12.1 */
+#define RTCP_PT_SR               200
+#define RTCP_PT_RR               201
+#define RTCP_PT_SDES             202
+#define RTCP_PT_BYE              203
+
+/** SDES item type for the canonical end-point identifier */
+#define RTCP_SDES_CNAME          1
+
+/** Size of the buffer into which compound RTCP packets are read */
+#define RTCP_MAXIMUM_PACKET_SIZE 1500
+
+/** Size of a sender report up to, but not including, its report blocks */
+#define RTCP_SR_SIZE             28
+
+/** Size of a receiver report with a single report block */
+#define RTCP_RR_SIZE             32
+
+/** Seconds between the NTP epoch (1900) and the Unix epoch (1970) */
+#define NTP_UNIX_EPOCH_OFFSET    2208988800ULL
+
+/** Number of microseconds in a second */
+#define MICROSECONDS_PER_SECOND  1000000
+
+/******************************************************************************
+Type definitions
+******************************************************************************/
+
+/** RTCP session data */
+struct rtcp_session_tag
+{
+   VC_CONTAINER_IO_T *io;        /**< Socket on which RTCP packets are received and sent */
+   uint32_t ssrc;                /**< Our SSRC, identifying us in receiver reports */
+   uint32_t random;              /**< Generator state, to randomise the report interval */
+   uint32_t report_interval;     /**< Mean interval between receiver reports, in microseconds */
+   int64_t next_report;          /**< Time at which the next receiver report is due */
+   bool has_sender;              /**< True once reports can be sent back to the sender */
+   bool has_sender_report;       /**< True once a sender report has been received */
+   uint64_t sr_ntp_time;         /**< NTP timestamp of the last sender report */
+   uint32_t sr_rtp_timestamp;    /**< RTP timestamp of the last sender report */
+   int64_t sr_arrival;           /**< Time at which the last sender report arrived */
+   uint32_t sender_reports;      /**< Number of sender reports received */
+   uint32_t receiver_reports;    /**< Number of receiver reports sent */
+   uint8_t buffer[RTCP_MAXIMUM_PACKET_SIZE]; /**< Buffer into which RTCP packets are read */
+};
+
+/******************************************************************************
+Local Functions
+******************************************************************************/
+
+/**************************************************************************//**
+ * Reads a big-endian 32-bit value.
+ *
+ * @param data Pointer to the value.
+ * @return  The value.
+ */
+static uint32_t rtcp_read_u32(const uint8_t *data)
+{
+   return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+/**************************************************************************//**
+ * Writes a big-endian 32-bit value.
+ *
+ * @param data  Where to write the value.
+ * @param value The value.
+ */
+static void rtcp_write_u32(uint8_t *data, uint32_t value)
+{
+   data[0] = (uint8_t)(value >> 24);
+   data[1] = (uint8_t)(value >> 16);
+   data[2] = (uint8_t)(value >> 8);
+   data[3] = (uint8_t)value;
+}
+
+/**************************************************************************//**
+ * Works out when the next receiver report is due.
+ * The interval is randomised between half and one and a half times the mean,
+ * as recommended by RFC3550 section 6.3.1, so receivers don't synchronise.
+ *
+ * @param session The RTCP session.
+ * @param now     Current time, in microseconds.
+ * @param scale   Shift applied to the mean interval, 1 for the initial report.
+ */
+static void rtcp_schedule_report(RTCP_SESSION_T *session, int64_t now, uint32_t scale)
+{
+   uint32_t interval = session->report_interval >> scale;
+
+   session->random = session->random * 1664525 + 1013904223;
+   now += interval / 2 + (((uint64_t)interval * (session->random >> 16)) >> 16);
+   session->next_report = now;
+}
+
+/*****************************************************************************
+Functions exported as part of the RTCP API
+ *****************************************************************************/
+
+/*****************************************************************************/
+RTCP_SESSION_T *rtcp_open(uint32_t port, uint32_t report_interval_ms)
+{
+   RTCP_SESSION_T *session;
+   VC_CONTAINER_STATUS_T status;
+   char uri[32];
+   int64_t now;
+
+   session = (RTCP_SESSION_T *)malloc(sizeof(RTCP_SESSION_T));
+   if (!session)
+      return NULL;
+   memset(session, 0, sizeof(*session));
+
+   snprintf(uri, sizeof(uri), "rtp://:%u", port);
+   session->io = vc_container_io_open(uri, VC_CONTAINER_IO_MODE_READ, &status);
+   if (!session->io)
+   {
+      LOG_DEBUG(NULL, "RTCP: cannot listen on port %u (%i)", port, status);
+      free(session);
+      return NULL;
+   }
+
+   /* RTCP is polled for in between reading RTP packets, so must never block */
+   vc_container_io_control(session->io, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, 0);
+
+   now = vcos_getmicrosecs64();
+   session->ssrc = (uint32_t)(now ^ (now >> 32) ^ (uintptr_t)session);
+   session->random = session->ssrc;
+   session->report_interval = report_interval_ms * 1000;
+
+   return session;
+}
+
+/*****************************************************************************/
+void rtcp_close(RTCP_SESSION_T *session)
+{
+   if (!session)
+      return;
+
+   vc_container_io_close(session->io);
+   free(session);
+}
+
+/*****************************************************************************/
+void rtcp_receive(RTCP_SESSION_T *session, uint32_t ssrc, int64_t now)
+{
+   size_t size;
+
+   while ((size = vc_container_io_read(session->io, session->buffer, sizeof(session->buffer))) != 0)
+   {
+      const uint8_t *ptr = session->buffer, *end = ptr + size;
+
+      if (!session->has_sender)
+      {
+         /* Receiver reports go back to where the RTCP packets come from */
+         session->has_sender = true;
+         rtcp_schedule_report(session, now, 1);
+      }
+
+      /* Walk through the packets in the compound packet */
+      while (end - ptr >= 4)
+      {
+         uint32_t length = (((ptr[2] << 8) | ptr[3]) + 1) << 2;
+
+         if ((ptr[0] >> 6) != 2 || length > (uint32_t)(end - ptr))
+         {
+            LOG_DEBUG(NULL, "RTCP: invalid packet");
+            break;
+         }
+
+         switch (ptr[1])
+         {
+         case RTCP_PT_SR:
+            if (length < RTCP_SR_SIZE || (ssrc && rtcp_read_u32(ptr + 4) != ssrc))
+               break;
+            session->sr_ntp_time = ((uint64_t)rtcp_read_u32(ptr + 8) << 32) | rtcp_read_u32(ptr + 12);
+            session->sr_rtp_timestamp = rtcp_read_u32(ptr + 16);
+            session->sr_arrival = now;
+            session->has_sender_report = true;
+            session->sender_reports++;
+            break;
+         case RTCP_PT_BYE:
+            LOG_DEBUG(NULL, "RTCP: BYE from 0x%8.8X", rtcp_read_u32(ptr + 4));
+            break;
+         default:
+            break;
+         }
+
+         ptr += length;
+      }
+   }
+}
+
+/*****************************************************************************/
+bool rtcp_report_due(RTCP_SESSION_T *session, int64_t now)
+{
+   return session->has_sender && now >= session->next_report;
+}
+
+/*****************************************************************************/
+int64_t rtcp_next_report(RTCP_SESSION_T *session)
+{
+   return session->has_sender ? session->next_report : INT64_MAX;
+}
+
+/*****************************************************************************/
+VC_CONTAINER_STATUS_T rtcp_send_report(RTCP_SESSION_T *session, const RTCP_REPORT_BLOCK_T *block, int64_t now)
+{
+   uint8_t packet[RTCP_RR_SIZE + 40];
+   uint8_t *sdes = packet + RTCP_RR_SIZE;
+   uint32_t lsr = 0, dlsr = 0, sdes_size;
+   int32_t cumulative_lost = block->cumulative_lost;
+   int cname_length;
+
+   rtcp_schedule_report(session, now, 0);
+
+   if (session->has_sender_report)
+   {
+      /* Middle 32 bits of the NTP timestamp, and the delay since in units of 1/65536s */
+      lsr = (uint32_t)(session->sr_ntp_time >> 16);
+      dlsr = (uint32_t)(((now - session->sr_arrival) << 16) / MICROSECONDS_PER_SECOND);
+   }
+
+   /* The cumulative number of packets lost is a signed 24-bit value */
+   if (cumulative_lost > 0x7FFFFF)
+      cumulative_lost = 0x7FFFFF;
+   else if (cumulative_lost < -0x800000)
+      cumulative_lost = -0x800000;
+
+   /* Receiver report, with a single report block (RFC3550 section 6.4.2) */
+   packet[0] = 0x81;
+   packet[1] = RTCP_PT_RR;
+   packet[2] = 0;
+   packet[3] = (RTCP_RR_SIZE >> 2) - 1;
+   rtcp_write_u32(packet + 4, session->ssrc);
+   rtcp_write_u32(packet + 8, block->ssrc);
+   rtcp_write_u32(packet + 12, ((uint32_t)block->fraction_lost << 24) | ((uint32_t)cumulative_lost & 0xFFFFFF));
+   rtcp_write_u32(packet + 16, block->extended_max_seq);
+   rtcp_write_u32(packet + 20, block->jitter);
+   rtcp_write_u32(packet + 24, lsr);
+   rtcp_write_u32(packet + 28, dlsr);
+
+   /* Every compound packet needs an SDES packet with a CNAME (RFC3550 section 6.1) */
+   sdes[0] = 0x81;
+   sdes[1] = RTCP_PT_SDES;
+   rtcp_write_u32(sdes + 4, session->ssrc);
+   sdes[8] = RTCP_SDES_CNAME;
+   cname_length = snprintf((char *)sdes + 10, sizeof(packet) - RTCP_RR_SIZE - 10, "vc-%8.8X@rtp", session->ssrc);
+   sdes[9] = (uint8_t)cname_length;
+
+   /* The item list ends with at least one null byte, padded to a 32-bit boundary */
+   sdes_size = (10 + cname_length + 4) & ~3;
+   memset(sdes + 10 + cname_length, 0, sdes_size - 10 - cname_length);
+   sdes[2] = 0;
+   sdes[3] = (uint8_t)((sdes_size >> 2) - 1);
+
+   vc_container_io_write(session->io, packet, RTCP_RR_SIZE + sdes_size);
+   if (session->io->status != VC_CONTAINER_SUCCESS)
+      return session->io->status;
+
+   session->receiver_reports++;
+   return VC_CONTAINER_SUCCESS;
+}
+
+/*****************************************************************************/
+bool rtcp_get_stats(RTCP_SESSION_T *session, VC_CONTAINER_RTP_STATS_T *stats, uint32_t *rtp_timestamp)
+{
+   uint64_t seconds;
+
+   stats->sender_reports = session->sender_reports;
+   stats->receiver_reports = session->receiver_reports;
+   if (!session->has_sender_report)
+      return false;
+
+   /* Convert the NTP timestamp to microseconds since 1970 */
+   seconds = (session->sr_ntp_time >> 32) - NTP_UNIX_EPOCH_OFFSET;
+   stats->wallclock_time = (int64_t)(seconds * MICROSECONDS_PER_SECOND +
+         (((session->sr_ntp_time & 0xFFFFFFFF) * MICROSECONDS_PER_SECOND) >> 32));
+   *rtp_timestamp = session->sr_rtp_timestamp;
+
+   return true;
+}
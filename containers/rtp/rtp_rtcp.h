@@ -0,0 +1,97 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _RTP_RTCP_H_
+#define _RTP_RTCP_H_
+
+#include "containers/containers.h"
+
+/** RTCP session, the control channel that goes with an RTP stream */
+typedef struct rtcp_session_tag RTCP_SESSION_T;
+
+/** Reception report for a source, see RFC3550 section 6.4.1 */
+typedef struct rtcp_report_block_tag
+{
+   uint32_t ssrc;                /**< SSRC of the source being reported on */
+   uint8_t fraction_lost;        /**< Fraction of packets lost since the last report, in 1/256 */
+   int32_t cumulative_lost;      /**< Number of packets lost since the start of reception */
+   uint32_t extended_max_seq;    /**< Highest sequence number received, with wrap count */
+   uint32_t jitter;              /**< Interarrival jitter, in timestamp units */
+} RTCP_REPORT_BLOCK_T;
+
+/** Open an RTCP session, listening on the given UDP port.
+ *
+ * \param port Port number to listen on.
+ * \param report_interval_ms Mean interval between receiver reports, in milliseconds.
+ * \return The new session, or NULL on error. */
+RTCP_SESSION_T *rtcp_open(uint32_t port, uint32_t report_interval_ms);
+
+/** Close an RTCP session.
+ *
+ * \param session The session to close. */
+void rtcp_close(RTCP_SESSION_T *session);
+
+/** Process any RTCP packets that have arrived, without waiting.
+ * Only the sender reports from the given source are used.
+ *
+ * \param session The RTCP session.
+ * \param ssrc SSRC of the source being received, or zero if not known yet.
+ * \param now Current time, in microseconds. */
+void rtcp_receive(RTCP_SESSION_T *session, uint32_t ssrc, int64_t now);
+
+/** Check whether a receiver report is due to be sent.
+ *
+ * \param session The RTCP session.
+ * \param now Current time, in microseconds.
+ * \return True if rtcp_send_report should be called. */
+bool rtcp_report_due(RTCP_SESSION_T *session, int64_t now);
+
+/** Get the time at which the next receiver report is due.
+ *
+ * \param session The RTCP session.
+ * \return Time in microseconds, or INT64_MAX while there is nobody to send it to. */
+int64_t rtcp_next_report(RTCP_SESSION_T *session);
+
+/** Send a receiver report to the sender of the last RTCP packet received.
+ *
+ * \param session The RTCP session.
+ * \param block Reception report for the source.
+ * \param now Current time, in microseconds.
+ * \return Status of sending the report. */
+VC_CONTAINER_STATUS_T rtcp_send_report(RTCP_SESSION_T *session, const RTCP_REPORT_BLOCK_T *block, int64_t now);
+
+/** Get the RTCP statistics of a session.
+ * The wallclock time is that of the last sender report, and rtp_timestamp gets its RTP
+ * timestamp, if a report has been received.
+ *
+ * \param session The RTCP session.
+ * \param stats Statistics to update.
+ * \param rtp_timestamp Where to put the RTP timestamp of the wallclock time.
+ * \return True if a sender report has been received. */
+bool rtcp_get_stats(RTCP_SESSION_T *session, VC_CONTAINER_RTP_STATS_T *stats, uint32_t *rtp_timestamp);
+
+#endif /* _RTP_RTCP_H_ */
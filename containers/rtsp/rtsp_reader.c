@@ -39,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "containers/core/containers_logging.h"
 #include "containers/core/containers_list.h"
 #include "containers/core/containers_uri.h"
+#include "interface/vcos/vcos.h"
 
 /******************************************************************************
 Configurable defines and constants.
@@ -65,6 +66,13 @@ Configurable defines and constants.
 /** Size of buffer for each track to use when receiving packets */
 #define UDP_READ_BUFFER_SIZE           520000
 
+/** Number of milliseconds to wait for the rest of an interleaved frame or RTSP
+ * message, once its start has been received */
+#define INTERLEAVED_FRAME_TIMEOUT_MS   1000
+
+/** Maximum number of interleaved packets held for a track which is not being read */
+#define INTERLEAVED_QUEUE_MAX          256
+
 /* Arbitrary number of different dynamic ports to try */
 #define DYNAMIC_PORT_ATTEMPTS_MAX      16
 
@@ -72,11 +80,14 @@ Configurable defines and constants.
 Defines and constants.
 ******************************************************************************/
 
-#define RTSP_SCHEME                    "rtsp:"
+#define RTSP_SCHEME                    "rtsp"
 #define RTP_SCHEME                     "rtp"
 
 /** The RTSP PKT scheme is used with test pkt files */
-#define RTSP_PKT_SCHEME                "rtsppkt:"
+#define RTSP_PKT_SCHEME                "rtsppkt"
+
+/** The RTSPT scheme requests RTP interleaved on the RTSP connection from the start */
+#define RTSP_TCP_SCHEME                "rtspt"
 
 #define RTSP_NETWORK_URI_START         "rtsp://"
 #define RTSP_NETWORK_URI_START_LENGTH  (sizeof(RTSP_NETWORK_URI_START)-1)
@@ -94,6 +105,12 @@ Defines and constants.
 /** Format for the Transport: header */
 #define TRANSPORT_HEADER_FORMAT        "Transport: RTP/AVP;unicast;client_port=%hu-%hu;mode=play\r\n"
 
+/** Format for the Transport: header when RTP is interleaved on the RTSP connection */
+#define INTERLEAVED_TRANSPORT_HEADER_FORMAT "Transport: RTP/AVP/TCP;unicast;interleaved=%u-%u;mode=play\r\n"
+
+/** Space to leave in the comms buffer for queuing another request */
+#define REQUEST_LENGTH_MAX             (RTSP_URI_LENGTH_MAX + SESSION_HEADER_LENGTH_MAX + 256)
+
 /** Format for including Session: header. */
 #define SESSION_HEADER_FORMAT          "Session: %s\r\n"
 
@@ -113,6 +130,7 @@ Defines and constants.
 #define CONTENT_LOCATION_NAME          "Content-Location"
 #define RTP_INFO_NAME                  "RTP-Info"
 #define SESSION_NAME                   "Session"
+#define TRANSPORT_NAME                 "Transport"
 /* @} */
 
 /** Supported RTSP major version number */
@@ -124,6 +142,11 @@ Defines and constants.
 #define RTSP_STATUS_OK                 200
 /** Next failure status code after the set of successful ones */
 #define RTSP_STATUS_MULTIPLE_CHOICES   300
+/** Status code of a server refusing the transports offered */
+#define RTSP_STATUS_UNSUPPORTED_TRANSPORT 461
+
+/** Size of the header of an interleaved frame: '$', channel and 16-bit length */
+#define INTERLEAVED_HEADER_SIZE        4
 
 /** Maximum size of a decimal string representation of a uint16_t, plus NUL */
 #define PORT_BUFFER_SIZE               6
@@ -160,6 +183,14 @@ typedef struct rtsp_header_tag
    char *value;
 } RTSP_HEADER_T;
 
+/** An interleaved packet held for a track until its reader asks for it */
+typedef struct rtsp_queued_packet_tag
+{
+   struct rtsp_queued_packet_tag *next;
+   uint32_t size;
+   uint8_t data[1];
+} RTSP_QUEUED_PACKET_T;
+
 typedef struct VC_CONTAINER_TRACK_MODULE_T
 {
    VC_CONTAINER_T *reader;          /**< RTP reader for track */
@@ -170,21 +201,45 @@ typedef struct VC_CONTAINER_TRACK_MODULE_T
    char *media_type;                /**< MIME type for track */
    VC_CONTAINER_PACKET_T info;      /**< Latest track packet info block */
    unsigned short rtp_port;       /**< UDP listener port being used in RTP reader */
+   uint8_t channel;                 /**< Interleaved channel carrying the track's RTP packets */
+   uint32_t read_timeout_ms;        /**< Read timeout set by the RTP reader on its interleaved i/o */
+   RTSP_QUEUED_PACKET_T *queue;     /**< Interleaved packets received for the track while reading others */
+   RTSP_QUEUED_PACKET_T *queue_last;
+   uint32_t queue_length;
 } VC_CONTAINER_TRACK_MODULE_T;
 
 typedef struct VC_CONTAINER_MODULE_T
 {
    VC_CONTAINER_TRACK_T *tracks[RTSP_TRACKS_MAX];
+   char *uri;                                   /**< RTSP URI used in requests */
    char *comms_buffer;                          /**< Buffer used for sending and receiving RTSP messages */
+   uint32_t request_length;                     /**< Length of the requests queued in the comms buffer */
    VC_CONTAINERS_LIST_T *header_list;           /**< Parsed response headers, pointing into comms buffer */
+   unsigned int status_code;                    /**< Status code of the latest response */
+   uint8_t *receive_buffer;                     /**< Data received beyond the end of the latest response */
+   uint32_t receive_offset;                     /**< Offset of the first unused byte in the receive buffer */
+   uint32_t receive_size;                       /**< Size of the data in the receive buffer */
    uint32_t cseq_value;                         /**< CSeq header value for next request */
    uint16_t next_rtp_port;                      /**< Next RTP port to use when opening track reader */
    uint16_t media_item;                         /**< Current media item number during initialization */
    bool uri_has_network_info;                   /**< True if the RTSP URI contains network info */
    int64_t ts_base;                             /**< Base value for dts and pts */
    VC_CONTAINER_TRACK_MODULE_T *current_track;  /**< Next track to be read, to keep info/data on same track */
+   bool interleaved;                            /**< True if RTP is interleaved on the RTSP connection */
+   uint8_t frame_header[INTERLEAVED_HEADER_SIZE]; /**< Header of the current interleaved frame */
+   uint32_t frame_header_size;                  /**< Bytes of the frame header received so far */
+   uint32_t frame_remaining;                    /**< Bytes of the current frame's payload still to be read */
+   uint32_t frame_discard;                      /**< Bytes to drop before the next frame header */
 } VC_CONTAINER_MODULE_T;
 
+/** Private data of the i/o through which a track's RTP reader gets its
+ * interleaved packets */
+typedef struct VC_CONTAINER_IO_MODULE_T
+{
+   VC_CONTAINER_T *rtsp;                        /**< The RTSP reader context */
+   VC_CONTAINER_TRACK_MODULE_T *t_module;       /**< The track the i/o belongs to */
+} VC_CONTAINER_IO_MODULE_T;
+
 /******************************************************************************
 Function prototypes
 ******************************************************************************/
@@ -220,7 +275,7 @@ static char *rtsp_trim( char *str )
 }
 
 /**************************************************************************//**
- * Send out the data in the comms buffer.
+ * Send out the requests queued in the comms buffer.
  *
  * @param p_ctx      The reader context.
  * @return  The resulting status of the function.
@@ -228,16 +283,16 @@ static char *rtsp_trim( char *str )
 static VC_CONTAINER_STATUS_T rtsp_send( VC_CONTAINER_T *p_ctx )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
-   uint32_t to_write;
+   uint32_t to_write = module->request_length;
    uint32_t written;
    const char *buffer = module->comms_buffer;
 
+   module->request_length = 0;
+
    /* When reading from a captured file, do not attempt to send data */
    if (!module->uri_has_network_info)
       return VC_CONTAINER_SUCCESS;
 
-   to_write = strlen(buffer);
-
    while (to_write)
    {
       written = vc_container_io_write(p_ctx->priv->io, buffer, to_write);
@@ -251,16 +306,20 @@ static VC_CONTAINER_STATUS_T rtsp_send( VC_CONTAINER_T *p_ctx )
 }
 
 /**************************************************************************//**
- * Send a DESCRIBE request to the RTSP server.
+ * Start a new request after those already queued in the comms buffer. If
+ * there may not be room for it, the queued requests are sent out first.
  *
  * @param p_ctx      The reader context.
+ * @param method     The request method.
+ * @param uri        The request URI.
+ * @param p_ptr      Pointer to the variable to receive the end of the request line.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T rtsp_send_describe_request( VC_CONTAINER_T *p_ctx )
+static VC_CONTAINER_STATUS_T rtsp_start_request( VC_CONTAINER_T *p_ctx,
+      const char *method, const char *uri, char **p_ptr )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
-   char *ptr = module->comms_buffer, *end = ptr + COMMS_BUFFER_SIZE;
-   char *uri = p_ctx->priv->io->uri;
+   char *ptr;
 
    if (strlen(uri) > RTSP_URI_LENGTH_MAX)
    {
@@ -268,102 +327,116 @@ static VC_CONTAINER_STATUS_T rtsp_send_describe_request( VC_CONTAINER_T *p_ctx )
       return VC_CONTAINER_ERROR_URI_OPEN_FAILED;
    }
 
-   ptr += snprintf(ptr, end - ptr, RTSP_REQUEST_LINE_FORMAT, DESCRIBE_METHOD, uri);
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, TRAILING_HEADERS_FORMAT, module->cseq_value++);
-   vc_container_assert(ptr < end);
+   if (module->request_length > COMMS_BUFFER_SIZE - REQUEST_LENGTH_MAX)
+   {
+      VC_CONTAINER_STATUS_T status = rtsp_send(p_ctx);
+      if (status != VC_CONTAINER_SUCCESS)
+         return status;
+   }
+
+   ptr = module->comms_buffer + module->request_length;
+   ptr += snprintf(ptr, module->comms_buffer + COMMS_BUFFER_SIZE - ptr,
+         RTSP_REQUEST_LINE_FORMAT, method, uri);
+   *p_ptr = ptr;
 
-   return rtsp_send(p_ctx);
+   return VC_CONTAINER_SUCCESS;
 }
 
 /**************************************************************************//**
- * Send a SETUP request to the RTSP server.
+ * Finish a request started with rtsp_start_request, leaving it queued in the
+ * comms buffer to be sent.
  *
  * @param p_ctx      The reader context.
- * @param t_module   The track module relating to the SETUP.
- * @return  The resulting status of the function.
+ * @param ptr        The end of the request so far.
  */
-static VC_CONTAINER_STATUS_T rtsp_send_setup_request( VC_CONTAINER_T *p_ctx,
-      VC_CONTAINER_TRACK_MODULE_T *t_module)
+static void rtsp_end_request( VC_CONTAINER_T *p_ctx, char *ptr )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
-   char *ptr = module->comms_buffer, *end = ptr + COMMS_BUFFER_SIZE;
-   char *uri = t_module->control_uri;
-
-   if (strlen(uri) > RTSP_URI_LENGTH_MAX)
-   {
-      LOG_ERROR(p_ctx, "RTSP: Control URI is too long (%d>%d)", strlen(uri), RTSP_URI_LENGTH_MAX);
-      return VC_CONTAINER_ERROR_URI_OPEN_FAILED;
-   }
+   char *end = module->comms_buffer + COMMS_BUFFER_SIZE;
 
-   ptr += snprintf(ptr, end - ptr, RTSP_REQUEST_LINE_FORMAT, SETUP_METHOD, uri);
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, TRANSPORT_HEADER_FORMAT, t_module->rtp_port, t_module->rtp_port + 1);
    if (ptr < end)
       ptr += snprintf(ptr, end - ptr, TRAILING_HEADERS_FORMAT, module->cseq_value++);
    vc_container_assert(ptr < end);
 
-   return rtsp_send(p_ctx);
+   module->request_length = ptr - module->comms_buffer;
 }
 
 /**************************************************************************//**
- * Send a PLAY request to the RTSP server.
+ * Queue a DESCRIBE request to the RTSP server.
  *
  * @param p_ctx      The reader context.
- * @param t_module   The track module relating to the PLAY.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T rtsp_send_play_request( VC_CONTAINER_T *p_ctx,
-      VC_CONTAINER_TRACK_MODULE_T *t_module )
+static VC_CONTAINER_STATUS_T rtsp_queue_describe_request( VC_CONTAINER_T *p_ctx )
 {
-   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
-   char *ptr = module->comms_buffer, *end = ptr + COMMS_BUFFER_SIZE;
-   char *uri = t_module->control_uri;
-
-   if (strlen(uri) > RTSP_URI_LENGTH_MAX)
-   {
-      LOG_ERROR(p_ctx, "RTSP: Control URI is too long (%d>%d)", strlen(uri), RTSP_URI_LENGTH_MAX);
-      return VC_CONTAINER_ERROR_URI_OPEN_FAILED;
-   }
+   VC_CONTAINER_STATUS_T status;
+   char *ptr;
 
-   ptr += snprintf(ptr, end - ptr, RTSP_REQUEST_LINE_FORMAT, PLAY_METHOD, uri);
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, SESSION_HEADER_FORMAT, t_module->session_header);
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, TRAILING_HEADERS_FORMAT, module->cseq_value++);
-   vc_container_assert(ptr < end);
+   status = rtsp_start_request(p_ctx, DESCRIBE_METHOD, p_ctx->priv->module->uri, &ptr);
+   if (status != VC_CONTAINER_SUCCESS)
+      return status;
 
-   return rtsp_send(p_ctx);
+   rtsp_end_request(p_ctx, ptr);
+   return VC_CONTAINER_SUCCESS;
 }
 
 /**************************************************************************//**
- * Send a TEARDOWN request to the RTSP server.
+ * Queue a SETUP request to the RTSP server.
  *
  * @param p_ctx      The reader context.
  * @param t_module   The track module relating to the SETUP.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T rtsp_send_teardown_request( VC_CONTAINER_T *p_ctx,
-      VC_CONTAINER_TRACK_MODULE_T *t_module )
+static VC_CONTAINER_STATUS_T rtsp_queue_setup_request( VC_CONTAINER_T *p_ctx,
+      VC_CONTAINER_TRACK_MODULE_T *t_module)
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
-   char *ptr = module->comms_buffer, *end = ptr + COMMS_BUFFER_SIZE;
-   char *uri = t_module->control_uri;
+   char *end = module->comms_buffer + COMMS_BUFFER_SIZE;
+   VC_CONTAINER_STATUS_T status;
+   char *ptr;
 
-   if (strlen(uri) > RTSP_URI_LENGTH_MAX)
+   status = rtsp_start_request(p_ctx, SETUP_METHOD, t_module->control_uri, &ptr);
+   if (status != VC_CONTAINER_SUCCESS)
+      return status;
+
+   if (ptr < end)
    {
-      LOG_ERROR(p_ctx, "RTSP: Control URI is too long (%d>%d)", strlen(uri), RTSP_URI_LENGTH_MAX);
-      return VC_CONTAINER_ERROR_URI_OPEN_FAILED;
+      if (module->interleaved)
+         ptr += snprintf(ptr, end - ptr, INTERLEAVED_TRANSPORT_HEADER_FORMAT,
+               t_module->channel, t_module->channel + 1);
+      else
+         ptr += snprintf(ptr, end - ptr, TRANSPORT_HEADER_FORMAT, t_module->rtp_port, t_module->rtp_port + 1);
    }
 
-   ptr += snprintf(ptr, end - ptr, RTSP_REQUEST_LINE_FORMAT, TEARDOWN_METHOD, uri);
+   rtsp_end_request(p_ctx, ptr);
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Queue a request for a track within its session, such as PLAY or TEARDOWN.
+ *
+ * @param p_ctx      The reader context.
+ * @param t_module   The track module relating to the request.
+ * @param method     The request method.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_queue_session_request( VC_CONTAINER_T *p_ctx,
+      VC_CONTAINER_TRACK_MODULE_T *t_module, const char *method )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   char *end = module->comms_buffer + COMMS_BUFFER_SIZE;
+   VC_CONTAINER_STATUS_T status;
+   char *ptr;
+
+   status = rtsp_start_request(p_ctx, method, t_module->control_uri, &ptr);
+   if (status != VC_CONTAINER_SUCCESS)
+      return status;
+
    if (ptr < end)
       ptr += snprintf(ptr, end - ptr, SESSION_HEADER_FORMAT, t_module->session_header);
-   if (ptr < end)
-      ptr += snprintf(ptr, end - ptr, TRAILING_HEADERS_FORMAT, module->cseq_value++);
-   vc_container_assert(ptr < end);
 
-   return rtsp_send(p_ctx);
+   rtsp_end_request(p_ctx, ptr);
+   return VC_CONTAINER_SUCCESS;
 }
 
 /**************************************************************************//**
@@ -388,6 +461,7 @@ static bool rtsp_successful_response_status( VC_CONTAINER_T *p_ctx,
       LOG_ERROR(p_ctx, "RTSP: Invalid response status line:\n%s", status_line);
       return false;
    }
+   p_ctx->priv->module->status_code = status_code;
 
    if (major_version != RTSP_MAJOR_VERSION || minor_version != RTSP_MINOR_VERSION)
    {
@@ -665,11 +739,70 @@ static void rtsp_store_rtp_info(VC_CONTAINERS_LIST_T *header_list,
    }
 }
 
+/**************************************************************************//**
+ * Read data from the RTSP connection, starting with any left over from
+ * reading the latest response.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @param buffer  The buffer to read into.
+ * @param size    The maximum number of bytes to read.
+ * @return  The number of bytes read. The status is in the I/O context.
+ */
+static size_t rtsp_io_read( VC_CONTAINER_T *p_ctx, void *buffer, size_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   if (module->receive_offset < module->receive_size)
+   {
+      if (size > module->receive_size - module->receive_offset)
+         size = module->receive_size - module->receive_offset;
+      memcpy(buffer, module->receive_buffer + module->receive_offset, size);
+      module->receive_offset += size;
+      p_ctx->priv->io->status = VC_CONTAINER_SUCCESS;
+      return size;
+   }
+
+   return vc_container_io_read(p_ctx->priv->io, buffer, size);
+}
+
+/**************************************************************************//**
+ * Put back data read from the RTSP connection, to be read again next.
+ * The data must have been read since the last time all the data put back was
+ * used up, so there is always room for it.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @param data    The data to put back.
+ * @param size    The size of the data.
+ */
+static void rtsp_io_unread( VC_CONTAINER_T *p_ctx, const void *data, uint32_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+
+   if (!size)
+      return;
+
+   if (module->receive_offset >= size)
+   {
+      module->receive_offset -= size;
+   } else {
+      uint32_t unused = module->receive_size - module->receive_offset;
+
+      vc_container_assert(unused + size <= COMMS_BUFFER_SIZE);
+      memmove(module->receive_buffer + size, module->receive_buffer + module->receive_offset, unused);
+      module->receive_offset = 0;
+      module->receive_size = unused + size;
+   }
+   memmove(module->receive_buffer + module->receive_offset, data, size);
+}
+
 /**************************************************************************//**
  * Reads an RTSP response and parses it into headers and content.
  * The headers and content remain stored in the comms buffer, but referenced
  * by the module's header list. Content uses a special header name that cannot
  * occur in the real headers.
+ * Anything received after the end of the response, such as the next of a
+ * number of pipelined responses, is kept to be read next. An unsuccessful
+ * response is read to the end before failing, so the next one can be read.
  *
  * @param p_ctx   The RTSP reader context.
  * @return  The resulting status of the function.
@@ -682,25 +815,20 @@ static VC_CONTAINER_STATUS_T rtsp_read_response( VC_CONTAINER_T *p_ctx )
    uint32_t space_available = COMMS_BUFFER_SIZE - 1;     /* Allow for a NUL */
    uint32_t received;
    char *ptr = next_read;
-   bool found_content = false;
+   char *content_end = NULL;
+   bool successful = true;
    RTSP_HEADER_T header;
 
    vc_containers_list_reset(module->header_list);
+   module->status_code = 0;
 
    /* Response status line doesn't need to be stored, just checked */
    header.name = NULL;
    header.value = next_read;
 
-   while (space_available)
+   for (;;)
    {
-      received = vc_container_io_read(p_ctx_io, next_read, space_available);
-      if (p_ctx_io->status != VC_CONTAINER_SUCCESS)
-         break;
-
-      next_read += received;
-      space_available -= received;
-
-      while (!found_content && ptr < next_read)
+      while (!content_end && ptr < next_read)
       {
          switch (*ptr)
          {
@@ -731,8 +859,7 @@ static VC_CONTAINER_STATUS_T rtsp_read_response( VC_CONTAINER_T *p_ctx )
                   }
                } else {
                   /* Check response status line */
-                  if (!rtsp_successful_response_status(p_ctx, header.value))
-                     return VC_CONTAINER_ERROR_FORMAT_INVALID;
+                  successful = rtsp_successful_response_status(p_ctx, header.value);
                }
                /* Ready for next header */
                header.name = ptr;
@@ -750,7 +877,6 @@ static VC_CONTAINER_STATUS_T rtsp_read_response( VC_CONTAINER_T *p_ctx )
                }
 
                /* An empty name signifies the start of the content has been found */
-               found_content = true;
 
                /* Make a pseudo-header for the content and add it to the list */
                header.name = CONTENT_PSEUDOHEADER_NAME;
@@ -761,24 +887,14 @@ static VC_CONTAINER_STATUS_T rtsp_read_response( VC_CONTAINER_T *p_ctx )
                   return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
                }
 
-               /* Calculate how much content there is left to read, based on Content-Length header */
+               /* The response ends after the number of bytes given by the Content-Length header */
                content_length = rtsp_get_content_length(module->header_list);
-               if (ptr + content_length < next_read)
+               if (content_length > (uint32_t)(module->comms_buffer + COMMS_BUFFER_SIZE - 1 - ptr))
                {
-                  /* Final content byte already present, with extra data after it */
-                  space_available = 0;
-               } else {
-                  uint32_t content_to_read = content_length - (next_read - ptr);
-
-                  if (content_to_read >= space_available)
-                  {
-                     LOG_ERROR(p_ctx, "RTSP: Not enough room to read content");
-                     return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
-                  }
-
-                  /* Restrict further reading to the number of content bytes left */
-                  space_available = content_to_read;
+                  LOG_ERROR(p_ctx, "RTSP: Not enough room to read content");
+                  return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
                }
+               content_end = ptr + content_length;
             }
             break;
 
@@ -787,22 +903,358 @@ static VC_CONTAINER_STATUS_T rtsp_read_response( VC_CONTAINER_T *p_ctx )
             ptr++;
          }
       }
-   }
 
-   if (!space_available)
-   {
-      if (found_content)
+      /* Stop once the final content byte is present */
+      if (content_end && next_read >= content_end)
+         break;
+
+      if (!space_available)
       {
-         /* Terminate content region */
-         *next_read = '\0';
-      } else {
          /* Ran out of buffer space and never found the content */
          LOG_ERROR(p_ctx, "RTSP: Response header section too big / content missing");
          return VC_CONTAINER_ERROR_FORMAT_INVALID;
       }
+
+      received = rtsp_io_read(p_ctx, next_read, space_available);
+      if (p_ctx_io->status != VC_CONTAINER_SUCCESS)
+         return p_ctx_io->status;
+
+      next_read += received;
+      space_available -= received;
+   }
+
+   /* Keep any data after the response, and terminate the content region */
+   rtsp_io_unread(p_ctx, content_end, next_read - content_end);
+   *content_end = '\0';
+
+   return successful ? VC_CONTAINER_SUCCESS : VC_CONTAINER_ERROR_FORMAT_INVALID;
+}
+
+/**************************************************************************//**
+ * Drop the data of interleaved frames which is not wanted, before reading the
+ * next frame header.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_discard_frame_data( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_IO_T *p_ctx_io = p_ctx->priv->io;
+   uint8_t scratch[256];
+
+   while (module->frame_discard)
+   {
+      size_t received = rtsp_io_read(p_ctx, scratch,
+            MIN(module->frame_discard, (uint32_t)sizeof(scratch)));
+      if (p_ctx_io->status != VC_CONTAINER_SUCCESS)
+         return p_ctx_io->status;
+      module->frame_discard -= received;
+   }
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Read the header of the next interleaved frame from the RTSP connection,
+ * unless it has been read already. Anything other than an interleaved frame is
+ * taken to be an RTSP message from the server, which is read and ignored.
+ *
+ * @param p_ctx      The RTSP reader context.
+ * @param timeout_ms Time to wait for the start of a frame, in milliseconds.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_read_frame_header( VC_CONTAINER_T *p_ctx, uint32_t timeout_ms )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_IO_T *p_ctx_io = p_ctx->priv->io;
+   VC_CONTAINER_STATUS_T status;
+   size_t received;
+
+   if (module->frame_header_size == INTERLEAVED_HEADER_SIZE)
+      return VC_CONTAINER_SUCCESS;
+
+   (void)vc_container_io_control(p_ctx_io, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS,
+         module->frame_header_size || module->frame_discard ? INTERLEAVED_FRAME_TIMEOUT_MS : timeout_ms);
+   status = rtsp_discard_frame_data(p_ctx);
+   if (status != VC_CONTAINER_SUCCESS)
+      return status;
+
+   while (module->frame_header_size < INTERLEAVED_HEADER_SIZE)
+   {
+      received = rtsp_io_read(p_ctx, module->frame_header + module->frame_header_size,
+            INTERLEAVED_HEADER_SIZE - module->frame_header_size);
+      if (p_ctx_io->status != VC_CONTAINER_SUCCESS)
+         return p_ctx_io->status;
+
+      if (!module->frame_header_size && module->frame_header[0] != '$')
+      {
+         /* Put the start of the message back and read it all */
+         rtsp_io_unread(p_ctx, module->frame_header, received);
+         (void)vc_container_io_control(p_ctx_io, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS,
+               INTERLEAVED_FRAME_TIMEOUT_MS);
+         status = rtsp_read_response(p_ctx);
+         if (status != VC_CONTAINER_SUCCESS && status != VC_CONTAINER_ERROR_FORMAT_INVALID)
+            return status;
+         continue;
+      }
+
+      module->frame_header_size += received;
+      (void)vc_container_io_control(p_ctx_io, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS,
+            INTERLEAVED_FRAME_TIMEOUT_MS);
+   }
+
+   module->frame_remaining = (module->frame_header[2] << 8) | module->frame_header[3];
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Find the track whose RTP packets are carried on the channel of the current
+ * interleaved frame.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @return  The track module, or NULL if the frame is for no track (e.g. RTCP).
+ */
+static VC_CONTAINER_TRACK_MODULE_T *rtsp_frame_track( VC_CONTAINER_T *p_ctx )
+{
+   uint8_t channel = p_ctx->priv->module->frame_header[1];
+   unsigned int ii;
+
+   for (ii = 0; ii < p_ctx->tracks_num; ii++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *t_module = p_ctx->tracks[ii]->priv->module;
+
+      if (t_module->reader && t_module->channel == channel)
+         return t_module;
+   }
+
+   return NULL;
+}
+
+/**************************************************************************//**
+ * Read the payload of the current interleaved frame, or as much of it as fits
+ * in the buffer, dropping the rest. The rest of the frame is expected to be
+ * arriving, so this waits for it.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @param buffer  The buffer to read into.
+ * @param size    The size of the buffer.
+ * @return  The size of the payload read, or zero on failure. The status is in
+ *          the I/O context.
+ */
+static size_t rtsp_read_frame_payload( VC_CONTAINER_T *p_ctx, uint8_t *buffer, size_t size )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_IO_T *p_ctx_io = p_ctx->priv->io;
+   size_t to_read = MIN(size, module->frame_remaining);
+   size_t done = 0;
+
+   (void)vc_container_io_control(p_ctx_io, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS,
+         INTERLEAVED_FRAME_TIMEOUT_MS);
+   while (done < to_read)
+   {
+      size_t received = rtsp_io_read(p_ctx, buffer + done, to_read - done);
+      if (p_ctx_io->status != VC_CONTAINER_SUCCESS)
+         break;
+      done += received;
    }
 
-   return p_ctx_io->status;
+   /* Whatever happened, move on to the next frame */
+   module->frame_discard = module->frame_remaining - done;
+   module->frame_remaining = 0;
+   module->frame_header_size = 0;
+
+   if (p_ctx_io->status != VC_CONTAINER_SUCCESS)
+      return 0;
+   if (module->frame_discard)
+      LOG_DEBUG(p_ctx, "RTSP: interleaved packet truncated to %u bytes", (unsigned)done);
+   return done;
+}
+
+/**************************************************************************//**
+ * Move the current interleaved frame out of the way into the queue of the
+ * track it belongs to, or drop it if it belongs to no track or the queue is full.
+ *
+ * @param p_ctx      The RTSP reader context.
+ * @param t_module   The track the frame belongs to, or NULL.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_queue_frame( VC_CONTAINER_T *p_ctx,
+      VC_CONTAINER_TRACK_MODULE_T *t_module )
+{
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   RTSP_QUEUED_PACKET_T *packet;
+
+   if (!t_module || t_module->queue_length >= INTERLEAVED_QUEUE_MAX || !module->frame_remaining)
+      packet = NULL;
+   else
+      packet = (RTSP_QUEUED_PACKET_T *)malloc(sizeof(*packet) + module->frame_remaining);
+
+   if (!packet)
+   {
+      module->frame_discard = module->frame_remaining;
+      module->frame_remaining = 0;
+      module->frame_header_size = 0;
+      return VC_CONTAINER_SUCCESS;
+   }
+
+   packet->next = NULL;
+   packet->size = rtsp_read_frame_payload(p_ctx, packet->data, module->frame_remaining);
+   if (!packet->size)
+   {
+      free(packet);
+      return p_ctx->priv->io->status;
+   }
+
+   if (t_module->queue_last)
+      t_module->queue_last->next = packet;
+   else
+      t_module->queue = packet;
+   t_module->queue_last = packet;
+   t_module->queue_length++;
+
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Free the interleaved packets queued for a track.
+ *
+ * @param t_module   The track module.
+ */
+static void rtsp_free_queue( VC_CONTAINER_TRACK_MODULE_T *t_module )
+{
+   while (t_module->queue)
+   {
+      RTSP_QUEUED_PACKET_T *packet = t_module->queue;
+
+      t_module->queue = packet->next;
+      free(packet);
+   }
+   t_module->queue_last = NULL;
+   t_module->queue_length = 0;
+}
+
+/**************************************************************************//**
+ * Wait for interleaved data when none of the tracks has any to give.
+ * A frame that was already waiting has not been taken by its track when
+ * polled, so it is queued for the track to let the frames after it through.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_wait_for_frame( VC_CONTAINER_T *p_ctx )
+{
+   if (p_ctx->priv->module->frame_header_size == INTERLEAVED_HEADER_SIZE)
+      return rtsp_queue_frame(p_ctx, rtsp_frame_track(p_ctx));
+
+   return rtsp_read_frame_header(p_ctx, DATA_UNAVAILABLE_READ_TIMEOUT_MS);
+}
+
+/**************************************************************************//**
+ * Read function of the i/o giving a track's RTP reader its interleaved packets.
+ * Each read gives one packet, read from the RTSP connection straight into the
+ * RTP reader's buffer. When the next frame on the connection belongs to
+ * another track, a non-blocking read leaves it for that track, which is polled
+ * next, while a blocking read queues it for that track and carries on.
+ *
+ * @param io      The track's i/o.
+ * @param buffer  The buffer to read into.
+ * @param size    The size of the buffer.
+ * @return  The size of the packet read, or zero on failure.
+ */
+static size_t rtsp_interleaved_io_read( VC_CONTAINER_IO_T *io, void *buffer, size_t size )
+{
+   VC_CONTAINER_T *p_ctx = io->module->rtsp;
+   VC_CONTAINER_TRACK_MODULE_T *t_module = io->module->t_module;
+   VC_CONTAINER_STATUS_T status;
+   uint32_t timeout_ms = t_module->read_timeout_ms;
+   int64_t deadline = vcos_getmicrosecs64() + (int64_t)timeout_ms * 1000;
+   size_t read = 0;
+
+   if (t_module->queue)
+   {
+      RTSP_QUEUED_PACKET_T *packet = t_module->queue;
+
+      read = MIN(size, packet->size);
+      memcpy(buffer, packet->data, read);
+      t_module->queue = packet->next;
+      if (!t_module->queue)
+         t_module->queue_last = NULL;
+      t_module->queue_length--;
+      free(packet);
+      io->status = VC_CONTAINER_SUCCESS;
+      return read;
+   }
+
+   for (;;)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *frame_track;
+
+      status = rtsp_read_frame_header(p_ctx, timeout_ms);
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+
+      frame_track = rtsp_frame_track(p_ctx);
+      if (frame_track == t_module)
+      {
+         read = rtsp_read_frame_payload(p_ctx, buffer, size);
+         status = p_ctx->priv->io->status;
+         break;
+      }
+
+      if (frame_track && !timeout_ms)
+      {
+         status = VC_CONTAINER_ERROR_ABORTED;
+         break;
+      }
+
+      status = rtsp_queue_frame(p_ctx, frame_track);
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+
+      if (timeout_ms && timeout_ms != VC_CONTAINER_READ_TIMEOUT_BLOCK)
+      {
+         int64_t remaining = deadline - (int64_t)vcos_getmicrosecs64();
+         timeout_ms = remaining > 0 ? (uint32_t)((remaining + 999) / 1000) : 0;
+      }
+   }
+
+   io->status = status;
+   return read;
+}
+
+/**************************************************************************//**
+ * Seek function of a track's interleaved i/o. Seeking is not possible.
+ */
+static VC_CONTAINER_STATUS_T rtsp_interleaved_io_seek( VC_CONTAINER_IO_T *io, int64_t offset )
+{
+   VC_CONTAINER_PARAM_UNUSED(io);
+   VC_CONTAINER_PARAM_UNUSED(offset);
+   return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+}
+
+/**************************************************************************//**
+ * Control function of a track's interleaved i/o. Only the read timeout can
+ * be set.
+ */
+static VC_CONTAINER_STATUS_T rtsp_interleaved_io_control( VC_CONTAINER_IO_T *io,
+      VC_CONTAINER_CONTROL_T operation, va_list args )
+{
+   if (operation != VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS)
+      return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+
+   io->module->t_module->read_timeout_ms = va_arg(args, uint32_t);
+   return VC_CONTAINER_SUCCESS;
+}
+
+/**************************************************************************//**
+ * Close function of a track's interleaved i/o.
+ */
+static VC_CONTAINER_STATUS_T rtsp_interleaved_io_close( VC_CONTAINER_IO_T *io )
+{
+   free(io->module);
+   io->module = NULL;
+   return VC_CONTAINER_SUCCESS;
 }
 
 /**************************************************************************//**
@@ -1183,7 +1635,7 @@ static VC_CONTAINER_STATUS_T rtsp_open_network_reader( VC_CONTAINER_T *p_ctx,
       module->next_rtp_port += 2;
    }
 
-   snprintf(port, sizeof(port)-1, "%hu", t_module->rtp_port);
+   snprintf(port, sizeof(port), "%hu", t_module->rtp_port);
    if (!vc_uri_set_port(t_module->reader_uri, port))
    {
       LOG_ERROR(p_ctx, "RTSP: Failed to set track reader URI port");
@@ -1193,6 +1645,66 @@ static VC_CONTAINER_STATUS_T rtsp_open_network_reader( VC_CONTAINER_T *p_ctx,
    return rtsp_open_track_reader(p_ctx, t_module);
 }
 
+/**************************************************************************//**
+ * Open a reader for the track which gets its RTP packets interleaved on the
+ * RTSP connection, through an i/o of its own.
+ *
+ * @param p_ctx      The RTSP reader context.
+ * @param t_module   The track module for which a reader is needed.
+ * @param channel    The interleaved channel to request for the track's RTP packets.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_open_interleaved_reader( VC_CONTAINER_T *p_ctx,
+      VC_CONTAINER_TRACK_MODULE_T *t_module, uint8_t channel )
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_IO_T *io = NULL;
+   uint32_t uri_buffer_size;
+   char *uri_buffer;
+
+   /* No port, since nothing is received on the network by the track reader itself */
+   if (!vc_uri_set_port(t_module->reader_uri, NULL))
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+
+   uri_buffer_size = vc_uri_build(t_module->reader_uri, NULL, 0) + 1;
+   uri_buffer = (char *)malloc(uri_buffer_size);
+   if (!uri_buffer)
+   {
+      LOG_ERROR(p_ctx, "RTSP: Failed to build RTP URI");
+      return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+   }
+   vc_uri_build(t_module->reader_uri, uri_buffer, uri_buffer_size);
+
+   io = vc_container_io_create(uri_buffer, VC_CONTAINER_IO_MODE_READ, VC_CONTAINER_IO_CAPS_CANT_SEEK, &status);
+   if (!io)
+      goto end;
+
+   io->module = (VC_CONTAINER_IO_MODULE_T *)malloc(sizeof(*io->module));
+   if (!io->module)
+   {
+      status = VC_CONTAINER_ERROR_OUT_OF_MEMORY;
+      goto end;
+   }
+   io->module->rtsp = p_ctx;
+   io->module->t_module = t_module;
+   io->pf_close = rtsp_interleaved_io_close;
+   io->pf_read = rtsp_interleaved_io_read;
+   io->pf_seek = rtsp_interleaved_io_seek;
+   io->pf_control = rtsp_interleaved_io_control;
+
+   t_module->channel = channel;
+   t_module->read_timeout_ms = VC_CONTAINER_READ_TIMEOUT_BLOCK;
+   t_module->reader = vc_container_open_reader_with_io(io, uri_buffer, &status, NULL, NULL);
+   if (t_module->reader)
+      io = NULL;   /* Now belongs to the track reader */
+
+end:
+   if (io)
+      vc_container_io_close(io);
+   free(uri_buffer);
+   return status;
+}
+
 /**************************************************************************//**
  * Open a reader for the track using the file URI that has been generated.
  *
@@ -1347,7 +1859,15 @@ static VC_CONTAINER_STATUS_T rtsp_complete_track( VC_CONTAINER_T *p_ctx,
       return VC_CONTAINER_ERROR_FORMAT_INVALID;
    }
 
-   if (module->uri_has_network_info)
+   if (module->uri_has_network_info && module->interleaved)
+   {
+      status = rtsp_open_interleaved_reader(p_ctx, t_module, (uint8_t)(2 * (p_ctx->tracks_num - 1)));
+
+      /* Reads from the track will be polled */
+      if (status == VC_CONTAINER_SUCCESS)
+         status = vc_container_control(t_module->reader, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, 0);
+   }
+   else if (module->uri_has_network_info)
    {
       int ii;
 
@@ -1376,9 +1896,7 @@ static VC_CONTAINER_STATUS_T rtsp_complete_track( VC_CONTAINER_T *p_ctx,
       status = rtsp_open_file_reader(p_ctx, t_module);
    }
 
-   vc_uri_release(t_module->reader_uri);
-   t_module->reader_uri = NULL;
-
+   /* The reader URI is kept in case the track has to be switched to interleaved transport */
    if (status == VC_CONTAINER_SUCCESS)
       status = rtsp_copy_track_data_from_reader(p_ctx, track);
 
@@ -1552,7 +2070,7 @@ static VC_CONTAINER_STATUS_T rtsp_create_tracks_from_response( VC_CONTAINER_T *p
       if (vc_containers_list_find_entry(header_list, &header))
          base_uri = header.value;
       else
-         base_uri = p_ctx->priv->io->uri;
+         base_uri = p_ctx->priv->module->uri;
    }
 
    return rtsp_create_tracks_from_sdp(p_ctx, content, base_uri);
@@ -1584,7 +2102,9 @@ static VC_CONTAINER_STATUS_T rtsp_describe( VC_CONTAINER_T *p_ctx )
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
 
    /* Send DESCRIBE request and get response */
-   status = rtsp_send_describe_request(p_ctx);
+   status = rtsp_queue_describe_request(p_ctx);
+   if (status != VC_CONTAINER_SUCCESS) return status;
+   status = rtsp_send(p_ctx);
    if (status != VC_CONTAINER_SUCCESS) return status;
    status = rtsp_read_response(p_ctx);
    if (status != VC_CONTAINER_SUCCESS) return status;
@@ -1596,55 +2116,147 @@ static VC_CONTAINER_STATUS_T rtsp_describe( VC_CONTAINER_T *p_ctx )
 }
 
 /**************************************************************************//**
- * Make a SETUP request to the server and get session from response.
+ * Store the session and transport details from a SETUP response.
  *
  * @param p_ctx      The RTSP reader context.
- * @param t_module   The track module to be set up.
+ * @param t_module   The track module that was set up.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T rtsp_setup( VC_CONTAINER_T *p_ctx,
+static VC_CONTAINER_STATUS_T rtsp_store_session( VC_CONTAINER_T *p_ctx,
       VC_CONTAINER_TRACK_MODULE_T *t_module )
 {
-   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
    const char *session_header;
    size_t session_header_len;
-
-   status = rtsp_send_setup_request(p_ctx, t_module);
-   if (status != VC_CONTAINER_SUCCESS) return status;
-   status = rtsp_read_response(p_ctx);
-   if (status != VC_CONTAINER_SUCCESS) return status;
+   RTSP_HEADER_T header;
 
    session_header = rtsp_get_session_header(module->header_list);
    session_header_len = strlen(session_header);
    if (session_header_len > SESSION_HEADER_LENGTH_MAX) return VC_CONTAINER_ERROR_FORMAT_INVALID;
 
+   if (t_module->session_header)
+      free(t_module->session_header);
    t_module->session_header = (char *)malloc(session_header_len + 1);
    if (!t_module->session_header) return VC_CONTAINER_ERROR_OUT_OF_MEMORY;
-   strncpy(t_module->session_header, session_header, session_header_len);
+   memcpy(t_module->session_header, session_header, session_header_len + 1);
 
-   return status;
+   /* The server may choose other interleaved channels than the ones requested */
+   header.name = TRANSPORT_NAME;
+   if (module->interleaved && vc_containers_list_find_entry(module->header_list, &header))
+   {
+      const char *interleaved = strstr(header.value, "interleaved=");
+      unsigned int channel;
+
+      /* coverity[secure_coding] String is null-terminated */
+      if (interleaved && sscanf(interleaved, "interleaved=%u", &channel) == 1 && channel < 256)
+         t_module->channel = (uint8_t)channel;
+   }
+
+   return VC_CONTAINER_SUCCESS;
 }
 
 /**************************************************************************//**
- * Make a SETUP request to the server and get session from response.
+ * Switch all tracks to receiving RTP interleaved on the RTSP connection,
+ * reopening their readers.
  *
- * @param p_ctx      The RTSP reader context.
- * @param t_module   The track module to be set up.
+ * @param p_ctx   The RTSP reader context.
  * @return  The resulting status of the function.
  */
-static VC_CONTAINER_STATUS_T rtsp_play( VC_CONTAINER_T *p_ctx,
-      VC_CONTAINER_TRACK_MODULE_T *t_module )
+static VC_CONTAINER_STATUS_T rtsp_interleave_tracks( VC_CONTAINER_T *p_ctx )
 {
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   unsigned int ii;
+
+   p_ctx->priv->module->interleaved = true;
+   for (ii = 0; status == VC_CONTAINER_SUCCESS && ii < p_ctx->tracks_num; ii++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *t_module = p_ctx->tracks[ii]->priv->module;
+
+      if (t_module->reader)
+         vc_container_close(t_module->reader);
+      t_module->reader = NULL;
+
+      status = rtsp_open_interleaved_reader(p_ctx, t_module, (uint8_t)(2 * ii));
+      if (status == VC_CONTAINER_SUCCESS)
+         status = vc_container_control(t_module->reader, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, 0);
+   }
+
+   return status;
+}
+
+/**************************************************************************//**
+ * Make SETUP requests to the server for all the tracks and get their sessions
+ * from the responses. The requests are pipelined, so that setting up all the
+ * tracks only takes one round trip.
+ * If the server refuses to send RTP over UDP, the tracks are set up again to
+ * receive it interleaved on the RTSP connection.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_setup( VC_CONTAINER_T *p_ctx )
+{
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS, response_status;
+   bool transport_refused = false;
+   unsigned int ii, queued;
 
-   status = rtsp_send_play_request(p_ctx, t_module);
+   for (queued = 0; status == VC_CONTAINER_SUCCESS && queued < p_ctx->tracks_num; queued++)
+      status = rtsp_queue_setup_request(p_ctx, p_ctx->tracks[queued]->priv->module);
    if (status != VC_CONTAINER_SUCCESS) return status;
-   status = rtsp_read_response(p_ctx);
+   status = rtsp_send(p_ctx);
    if (status != VC_CONTAINER_SUCCESS) return status;
 
-   rtsp_store_rtp_info(module->header_list, t_module);
+   /* Read all the responses, even after a failure, to keep the connection usable */
+   for (ii = 0; ii < queued; ii++)
+   {
+      response_status = rtsp_read_response(p_ctx);
+      if (response_status == VC_CONTAINER_SUCCESS)
+         response_status = rtsp_store_session(p_ctx, p_ctx->tracks[ii]->priv->module);
+      else if (module->status_code == RTSP_STATUS_UNSUPPORTED_TRANSPORT)
+         transport_refused = true;
+
+      if (status == VC_CONTAINER_SUCCESS)
+         status = response_status;
+      if (response_status != VC_CONTAINER_SUCCESS && response_status != VC_CONTAINER_ERROR_FORMAT_INVALID)
+         break;
+   }
+
+   if (status != VC_CONTAINER_SUCCESS && transport_refused && !module->interleaved &&
+       module->uri_has_network_info)
+   {
+      LOG_DEBUG(p_ctx, "RTSP: UDP transport refused, trying interleaved transport");
+      status = rtsp_interleave_tracks(p_ctx);
+      if (status == VC_CONTAINER_SUCCESS)
+         status = rtsp_setup(p_ctx);
+   }
+
+   return status;
+}
+
+/**************************************************************************//**
+ * Make PLAY requests to the server for all the tracks, pipelined.
+ *
+ * @param p_ctx   The RTSP reader context.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_play( VC_CONTAINER_T *p_ctx )
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
+   VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
+   unsigned int ii;
+
+   for (ii = 0; status == VC_CONTAINER_SUCCESS && ii < p_ctx->tracks_num; ii++)
+      status = rtsp_queue_session_request(p_ctx, p_ctx->tracks[ii]->priv->module, PLAY_METHOD);
+   if (status != VC_CONTAINER_SUCCESS) return status;
+   status = rtsp_send(p_ctx);
+
+   for (ii = 0; status == VC_CONTAINER_SUCCESS && ii < p_ctx->tracks_num; ii++)
+   {
+      status = rtsp_read_response(p_ctx);
+      if (status == VC_CONTAINER_SUCCESS)
+         rtsp_store_rtp_info(module->header_list, p_ctx->tracks[ii]->priv->module);
+   }
 
    return status;
 }
@@ -1781,8 +2393,11 @@ static VC_CONTAINER_STATUS_T rtsp_reader_read( VC_CONTAINER_T *p_ctx,
 
       while (!module->current_track)
       {
-         /* Check RTSP stream to see if it has closed */
-         status = rtsp_read_response(p_ctx);
+         /* Check RTSP stream to see if it has closed, or wait for interleaved data */
+         if (module->interleaved)
+            status = rtsp_wait_for_frame(p_ctx);
+         else
+            status = rtsp_read_response(p_ctx);
          if (status == VC_CONTAINER_SUCCESS || status == VC_CONTAINER_ERROR_ABORTED)
          {
             /* No data from any track yet, so keep checking */
@@ -1860,6 +2475,57 @@ static VC_CONTAINER_STATUS_T rtsp_reader_seek( VC_CONTAINER_T *p_ctx,
    return VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
 }
 
+/**************************************************************************//**
+ * Apply a control operation to the container.
+ * Jitter buffer and reception statistics operations go to the track readers.
+ *
+ * @param p_ctx      The reader context.
+ * @param operation  The control operation.
+ * @param args       Optional additional arguments for the operation.
+ * @return  The resulting status of the function.
+ */
+static VC_CONTAINER_STATUS_T rtsp_reader_control( VC_CONTAINER_T *p_ctx,
+                                                VC_CONTAINER_CONTROL_T operation,
+                                                va_list args)
+{
+   VC_CONTAINER_STATUS_T status = VC_CONTAINER_ERROR_UNSUPPORTED_OPERATION;
+   unsigned int track_num;
+
+   switch (operation)
+   {
+   case VC_CONTAINER_CONTROL_SET_JITTER_BUFFER_LATENCY_MS:
+      {
+         uint32_t latency_ms = va_arg(args, uint32_t);
+
+         for (track_num = 0; track_num < p_ctx->tracks_num; track_num++)
+         {
+            VC_CONTAINER_TRACK_MODULE_T *t_module = p_ctx->tracks[track_num]->priv->module;
+
+            status = vc_container_control(t_module->reader, operation, latency_ms);
+            if (status != VC_CONTAINER_SUCCESS)
+               break;
+         }
+      }
+      break;
+   case VC_CONTAINER_CONTROL_GET_RTP_STATS:
+      {
+         VC_CONTAINER_RTP_STATS_T *stats;
+
+         track_num = va_arg(args, unsigned int);
+         stats = va_arg(args, VC_CONTAINER_RTP_STATS_T *);
+         if (track_num >= p_ctx->tracks_num)
+            status = VC_CONTAINER_ERROR_INVALID_ARGUMENT;
+         else
+            status = vc_container_control(p_ctx->tracks[track_num]->priv->module->reader, operation, 0, stats);
+      }
+      break;
+   default:
+      break;
+   }
+
+   return status;
+}
+
 /**************************************************************************//**
  * Close the container.
  *
@@ -1869,19 +2535,28 @@ static VC_CONTAINER_STATUS_T rtsp_reader_seek( VC_CONTAINER_T *p_ctx,
 static VC_CONTAINER_STATUS_T rtsp_reader_close( VC_CONTAINER_T *p_ctx )
 {
    VC_CONTAINER_MODULE_T *module = p_ctx->priv->module;
-   unsigned int i;
+   unsigned int i, sent = 0;
 
+   /* Send the teardown messages, pipelined, and wait for the responses although
+    * it isn't important whether they were successful or not. With interleaved
+    * transport, data may still be arriving, so don't wait. */
    for(i = 0; i < p_ctx->tracks_num; i++)
    {
       VC_CONTAINER_TRACK_MODULE_T *t_module = p_ctx->tracks[i]->priv->module;
 
-      if (t_module->control_uri && t_module->session_header)
-      {
-         /* Send the teardown message and wait for a response, although it
-          * isn't important whether it was successful or not. */
-         if (rtsp_send_teardown_request(p_ctx, t_module) == VC_CONTAINER_SUCCESS)
-            (void)rtsp_read_response(p_ctx);
-      }
+      if (t_module->control_uri && t_module->session_header &&
+          rtsp_queue_session_request(p_ctx, t_module, TEARDOWN_METHOD) == VC_CONTAINER_SUCCESS)
+         sent++;
+   }
+   if (sent && rtsp_send(p_ctx) == VC_CONTAINER_SUCCESS && !module->interleaved)
+   {
+      while (sent-- && rtsp_read_response(p_ctx) != VC_CONTAINER_ERROR_ABORTED)
+         ;
+   }
+
+   for(i = 0; i < p_ctx->tracks_num; i++)
+   {
+      VC_CONTAINER_TRACK_MODULE_T *t_module = p_ctx->tracks[i]->priv->module;
 
       if (t_module->reader)
          vc_container_close(t_module->reader);
@@ -1891,6 +2566,7 @@ static VC_CONTAINER_STATUS_T rtsp_reader_close( VC_CONTAINER_T *p_ctx )
          free(t_module->control_uri);
       if (t_module->session_header)
          free(t_module->session_header);
+      rtsp_free_queue(t_module);
       vc_container_free_track(p_ctx, p_ctx->tracks[i]);  /* Also need to close track's reader */
    }
    p_ctx->tracks = NULL;
@@ -1899,6 +2575,10 @@ static VC_CONTAINER_STATUS_T rtsp_reader_close( VC_CONTAINER_T *p_ctx )
    {
       if (module->comms_buffer)
          free(module->comms_buffer);
+      if (module->receive_buffer)
+         free(module->receive_buffer);
+      if (module->uri)
+         free(module->uri);
       if (module->header_list)
          vc_containers_list_destroy(module->header_list);
       free(module);
@@ -1918,13 +2598,16 @@ VC_CONTAINER_STATUS_T rtsp_reader_open( VC_CONTAINER_T *p_ctx )
 {
    VC_CONTAINER_MODULE_T *module = 0;
    VC_CONTAINER_STATUS_T status = VC_CONTAINER_SUCCESS;
-   uint32_t ii;
+   const char *uri = p_ctx->priv->io->uri;
+   bool interleaved;
 
    /* Check the URI scheme looks valid */
    if (!vc_uri_scheme(p_ctx->priv->uri) ||
        (strcasecmp(vc_uri_scheme(p_ctx->priv->uri), RTSP_SCHEME) &&
+        strcasecmp(vc_uri_scheme(p_ctx->priv->uri), RTSP_TCP_SCHEME) &&
         strcasecmp(vc_uri_scheme(p_ctx->priv->uri), RTSP_PKT_SCHEME)))
       return VC_CONTAINER_ERROR_FORMAT_NOT_SUPPORTED;
+   interleaved = !strcasecmp(vc_uri_scheme(p_ctx->priv->uri), RTSP_TCP_SCHEME);
 
    /* Allocate our context */
    if ((module = (VC_CONTAINER_MODULE_T *)malloc(sizeof(VC_CONTAINER_MODULE_T))) == NULL)
@@ -1938,10 +2621,22 @@ VC_CONTAINER_STATUS_T rtsp_reader_open( VC_CONTAINER_T *p_ctx )
    p_ctx->tracks = module->tracks;
    module->next_rtp_port = FIRST_DYNAMIC_PORT;
    module->cseq_value = 0;
+   module->interleaved = interleaved;
+
+   /* Requests use the plain RTSP scheme, whichever transport was asked for */
+   module->uri = (char *)malloc(strlen(uri) + 1);
+   if (!module->uri) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
+   if (interleaved)
+      sprintf(module->uri, "%s%s", RTSP_SCHEME, uri + strlen(RTSP_TCP_SCHEME));
+   else
+      strcpy(module->uri, uri);
+
    module->uri_has_network_info =
-         (strncasecmp(p_ctx->priv->io->uri, RTSP_NETWORK_URI_START, RTSP_NETWORK_URI_START_LENGTH) == 0);
+         (strncasecmp(module->uri, RTSP_NETWORK_URI_START, RTSP_NETWORK_URI_START_LENGTH) == 0);
    module->comms_buffer = (char *)calloc(1, COMMS_BUFFER_SIZE+1);
    if (!module->comms_buffer) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
+   module->receive_buffer = (uint8_t *)malloc(COMMS_BUFFER_SIZE);
+   if (!module->receive_buffer) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
 
    /* header_list will contain pointers into the response_buffer, so take care in re-use */
    module->header_list = vc_containers_list_create(HEADER_LIST_INITIAL_CAPACITY, sizeof(RTSP_HEADER_T),
@@ -1949,10 +2644,10 @@ VC_CONTAINER_STATUS_T rtsp_reader_open( VC_CONTAINER_T *p_ctx )
    if (!module->header_list) { status = VC_CONTAINER_ERROR_OUT_OF_MEMORY; goto error; }
 
    status = rtsp_describe(p_ctx);
-   for (ii = 0; status == VC_CONTAINER_SUCCESS && ii < p_ctx->tracks_num; ii++)
-      status = rtsp_setup(p_ctx, p_ctx->tracks[ii]->priv->module);
-   for (ii = 0; status == VC_CONTAINER_SUCCESS && ii < p_ctx->tracks_num; ii++)
-      status = rtsp_play(p_ctx, p_ctx->tracks[ii]->priv->module);
+   if (status == VC_CONTAINER_SUCCESS)
+      status = rtsp_setup(p_ctx);
+   if (status == VC_CONTAINER_SUCCESS)
+      status = rtsp_play(p_ctx);
    if (status != VC_CONTAINER_SUCCESS)
       goto error;
 
@@ -1962,6 +2657,7 @@ VC_CONTAINER_STATUS_T rtsp_reader_open( VC_CONTAINER_T *p_ctx )
    p_ctx->priv->pf_close = rtsp_reader_close;
    p_ctx->priv->pf_read = rtsp_reader_read;
    p_ctx->priv->pf_seek = rtsp_reader_seek;
+   p_ctx->priv->pf_control = rtsp_reader_control;
 
    if(STREAM_STATUS(p_ctx) != VC_CONTAINER_SUCCESS) goto error;
    return VC_CONTAINER_SUCCESS;
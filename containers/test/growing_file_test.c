@@ -0,0 +1,300 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Test of the reading of files which are still being written, e.g.
+ *    containers_growing_file_test /tmp/growing.mp4
+ * writes a synthetic fragmented MP4 file, then reads it while it grows through the
+ * default i/o, mmap:// and uring://. The file starts off with only part of the data
+ * and the rest is appended in chunks each time the reader runs out of data. All the
+ * packets of the complete file need to come out, in the same order. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/containers_codecs.h"
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_utils.h"
+
+#define DURATION_SECONDS  120
+#define FRAGMENT_MS       1000
+#define NUM_CHUNKS        7     /* Chunks the file is appended in */
+
+static uint8_t buffer[1024*1024];
+
+typedef struct
+{
+   unsigned int packets;
+   uint32_t checksum;
+} RESULT_T;
+
+/*****************************************************************************/
+static int create_file(const char *path)
+{
+   VC_CONTAINER_T *ctx;
+   VC_CONTAINER_ES_FORMAT_T *video, *audio;
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_PACKET_T packet;
+   int64_t video_time = 0, audio_time = 0, end = (int64_t)DURATION_SECONDS * 1000000;
+   uint32_t video_frames = 0, audio_frames = 0;
+   char uri[1024];
+
+   snprintf(uri, sizeof(uri), "%s?fragment=%u", path, FRAGMENT_MS);
+   ctx = vc_container_open_writer(uri, &status, 0, 0);
+   if (!ctx)
+   {
+      printf("Opening <%s> for writing failed: %d\n", uri, status);
+      return 2;
+   }
+
+   video = vc_container_format_create(8);
+   audio = vc_container_format_create(8);
+   if (!video || !audio)
+      return 2;
+   video->es_type = VC_CONTAINER_ES_TYPE_VIDEO;
+   video->codec = VC_CONTAINER_CODEC_H264;
+   video->codec_variant = VC_FOURCC('a','v','c','C');
+   video->type->video.width = 640;
+   video->type->video.height = 480;
+   video->flags = VC_CONTAINER_ES_FORMAT_FLAG_FRAMED;
+   video->extradata_size = 8;
+   memcpy(video->extradata, "\x01\x42\x00\x1e\xff\xe0\x00\x00", 8);
+   audio->es_type = VC_CONTAINER_ES_TYPE_AUDIO;
+   audio->codec = VC_CONTAINER_CODEC_MP4A;
+   audio->type->audio.sample_rate = 44100;
+   audio->type->audio.channels = 2;
+   audio->flags = VC_CONTAINER_ES_FORMAT_FLAG_FRAMED;
+   audio->extradata_size = 2;
+   memcpy(audio->extradata, "\x12\x10", 2);
+
+   if (vc_container_control(ctx, VC_CONTAINER_CONTROL_TRACK_ADD, video) != VC_CONTAINER_SUCCESS ||
+       vc_container_control(ctx, VC_CONTAINER_CONTROL_TRACK_ADD, audio) != VC_CONTAINER_SUCCESS)
+   {
+      printf("Adding the tracks failed\n");
+      vc_container_close(ctx);
+      return 2;
+   }
+
+   while (video_time < end || audio_time < end)
+   {
+      bool is_video = video_time <= audio_time;
+
+      memset(&packet, 0, sizeof(packet));
+      packet.track = is_video ? 0 : 1;
+      packet.pts = packet.dts = is_video ? video_time : audio_time;
+      packet.flags = VC_CONTAINER_PACKET_FLAG_FRAME;
+      if (is_video && !(video_frames % 30))
+         packet.flags |= VC_CONTAINER_PACKET_FLAG_KEYFRAME;
+      packet.data = buffer;
+      packet.size = packet.buffer_size = is_video ? 800 + video_frames % 977 : 200 + audio_frames % 53;
+      memset(buffer, (int)(video_frames + audio_frames), packet.size);
+
+      status = vc_container_write(ctx, &packet);
+      if (status != VC_CONTAINER_SUCCESS)
+      {
+         printf("Writing failed: %d\n", status);
+         vc_container_close(ctx);
+         return 2;
+      }
+
+      if (is_video)
+         video_time = (int64_t)++video_frames * 1000000 / 30;
+      else
+         audio_time = (int64_t)++audio_frames * 1024 * 1000000 / 44100;
+   }
+
+   status = vc_container_close(ctx);
+   vc_container_format_delete(video);
+   vc_container_format_delete(audio);
+   return status == VC_CONTAINER_SUCCESS ? 0 : 2;
+}
+
+/*****************************************************************************/
+/** Read packets until the reader runs out of data */
+static VC_CONTAINER_STATUS_T read_packets(VC_CONTAINER_T *ctx, RESULT_T *result)
+{
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_PACKET_T packet;
+   unsigned int i;
+
+   memset(&packet, 0, sizeof(packet));
+   while (1)
+   {
+      packet.data = buffer;
+      packet.buffer_size = sizeof(buffer);
+      status = vc_container_read(ctx, &packet, 0);
+      if (status == VC_CONTAINER_ERROR_CONTINUE)
+         continue;
+      if (status != VC_CONTAINER_SUCCESS)
+         return status;
+
+      result->packets++;
+      result->checksum = result->checksum * 31 + packet.track;
+      result->checksum = result->checksum * 31 + (uint32_t)packet.pts;
+      for (i = 0; i < packet.size; i++)
+         result->checksum = result->checksum * 31 + buffer[i];
+   }
+}
+
+/*****************************************************************************/
+/** Copy the given part of a file onto the end of another one */
+static int append(const char *dst, const char *src, long offset, long size)
+{
+   FILE *in = fopen(src, "rb"), *out = fopen(dst, "ab");
+   int ret = 0;
+
+   if (!in || !out || fseek(in, offset, SEEK_SET))
+      ret = -1;
+   while (!ret && size > 0)
+   {
+      size_t bytes = fread(buffer, 1, MIN(sizeof(buffer), (size_t)size), in);
+      if (!bytes || fwrite(buffer, 1, bytes, out) != bytes)
+         ret = -1;
+      size -= (long)bytes;
+   }
+   if (in) fclose(in);
+   if (out) fclose(out);
+   return ret;
+}
+
+/*****************************************************************************/
+/** Returns 0 on success, 1 if the i/o isn't available and 2 on failure */
+static int test_growing(const char *scheme, const char *path, const char *grow_path,
+   long size, const RESULT_T *reference)
+{
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx;
+   RESULT_T result = {0, 0};
+   long offset = size / 4, chunk = (size - offset + NUM_CHUNKS - 1) / NUM_CHUNKS;
+   unsigned int appends = 0, grown = 0;
+   char uri[1024];
+
+   remove(grow_path);
+   if (append(grow_path, path, 0, offset))
+   {
+      printf("Creating <%s> failed\n", grow_path);
+      return 2;
+   }
+
+   snprintf(uri, sizeof(uri), "%s%s", scheme, grow_path);
+   ctx = vc_container_open_reader(uri, &status, 0, 0);
+   if (!ctx && *scheme)
+   {
+      printf("%-10s skipped (can't open <%s>: %d)\n", scheme, uri, status);
+      return 1;
+   }
+   if (!ctx)
+   {
+      printf("Opening <%s> failed: %d\n", uri, status);
+      return 2;
+   }
+
+   while (1)
+   {
+      unsigned int packets = result.packets;
+
+      status = read_packets(ctx, &result);
+      if (appends && result.packets > packets)
+         grown++;
+      if (offset >= size)
+         break;
+
+      if (append(grow_path, path, offset, MIN(chunk, size - offset)))
+      {
+         printf("Appending to <%s> failed\n", grow_path);
+         break;
+      }
+      offset += chunk;
+      appends++;
+   }
+   vc_container_close(ctx);
+
+   printf("%-10s %u packets, %u of %u appends brought new packets, last status %d\n",
+          *scheme ? scheme : "default", result.packets, grown, appends, status);
+   if (result.packets != reference->packets || result.checksum != reference->checksum ||
+       grown != appends)
+   {
+      printf("%-10s FAILED: expected %u packets (checksum %08x), got %u (checksum %08x)\n",
+             *scheme ? scheme : "default", reference->packets, reference->checksum,
+             result.packets, result.checksum);
+      return 2;
+   }
+   return 0;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   static const char *schemes[] = {"", "mmap://", "uring://"};
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx;
+   RESULT_T reference = {0, 0};
+   char grow_path[1024];
+   unsigned int i;
+   long size;
+   FILE *file;
+   int ret = 0;
+
+   if (argc < 2 || argv[1][0] != '/')
+   {
+      printf("usage: %s </absolute/path/file.mp4>\n", argv[0]);
+      return 1;
+   }
+   snprintf(grow_path, sizeof(grow_path), "%s.grow.mp4", argv[1]);
+
+   if (create_file(argv[1]))
+      return 2;
+   file = fopen(argv[1], "rb");
+   if (!file || fseek(file, 0, SEEK_END) || (size = ftell(file)) <= 0)
+   {
+      printf("Checking the size of <%s> failed\n", argv[1]);
+      return 2;
+   }
+   fclose(file);
+
+   /* Read the complete file first to know what to expect */
+   ctx = vc_container_open_reader(argv[1], &status, 0, 0);
+   if (!ctx)
+   {
+      printf("Opening <%s> failed: %d\n", argv[1], status);
+      return 2;
+   }
+   read_packets(ctx, &reference);
+   vc_container_close(ctx);
+   printf("%-10s %u packets in %ld bytes\n", "complete", reference.packets, size);
+
+   for (i = 0; i < countof(schemes); i++)
+      if (test_growing(schemes[i], argv[1], grow_path, size, &reference) == 2)
+         ret = 2;
+
+   remove(grow_path);
+   printf("%s\n", ret ? "FAILED" : "PASSED");
+   return ret;
+}
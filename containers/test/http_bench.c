@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Throughput and seek latency benchmark for the container i/o, meant to be run against
+ * containers_http_server on the loopback interface, e.g.
+ *    containers_http_server 8080 268435456 2 &
+ *    containers_http_bench http://127.0.0.1:8080/pattern verify
+ * When the server generates its pattern, "verify" checks every byte that is read. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/core/containers_io.h"
+
+#define READ_SIZE          (64*1024)
+#define SEEK_READ_SIZE     (16*1024)
+#define NUM_SEEKS          64
+
+/** Byte at the given offset of the pattern generated by containers_http_server */
+#define PATTERN_BYTE(offset) ((uint8_t)(((offset) * 31) ^ ((offset) >> 11)))
+
+static uint8_t buffer[1024*1024];
+static bool verify;
+static unsigned int errors;
+
+/*****************************************************************************/
+static size_t bench_read(VC_CONTAINER_IO_T *io, int64_t offset, size_t size)
+{
+   size_t ret, i;
+
+   if (vc_container_io_seek(io, offset) != VC_CONTAINER_SUCCESS)
+      return 0;
+   ret = vc_container_io_read(io, buffer, size);
+
+   for (i = 0; verify && i < ret; i++)
+   {
+      if (buffer[i] != PATTERN_BYTE(offset + (int64_t)i))
+      {
+         if (!errors++)
+            printf("Mismatch at offset %"PRId64"\n", offset + (int64_t)i);
+         break;
+      }
+   }
+
+   return ret;
+}
+
+/*****************************************************************************/
+static void bench_seeks(VC_CONTAINER_IO_T *io, const char *name, int64_t max_skip)
+{
+   uint64_t total = 0, max = 0, time;
+   uint32_t seed = 1;
+   int64_t offset = 0;
+   unsigned int i;
+
+   for (i = 0; i < NUM_SEEKS; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      if (max_skip)
+         offset += SEEK_READ_SIZE + (int64_t)(seed >> 8) % max_skip;
+      else
+         offset = (int64_t)(((uint64_t)seed << 16) % (uint64_t)(io->size - SEEK_READ_SIZE));
+      if (offset > io->size - SEEK_READ_SIZE)
+         offset = 0;
+
+      time = vcos_getmicrosecs64();
+      bench_read(io, offset, SEEK_READ_SIZE);
+      time = vcos_getmicrosecs64() - time;
+
+      total += time;
+      if (time > max)
+         max = time;
+   }
+
+   printf("%-24s avg %8"PRIu64" us  max %8"PRIu64" us\n", name, total / NUM_SEEKS, max);
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   VC_CONTAINER_IO_T *io;
+   VC_CONTAINER_STATUS_T status;
+   uint64_t time, start_time;
+   int64_t offset, total = 0;
+   uint32_t ring_size = 0;
+   int i;
+
+   if (argc < 2)
+   {
+      printf("Usage:\n%s <uri> [verify] [<read buffer size>]\n", argv[0]);
+      return 1;
+   }
+
+   for (i = 2; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "verify"))
+         verify = true;
+      else
+         ring_size = (uint32_t)strtoul(argv[i], NULL, 0);
+   }
+
+   vcos_init();
+
+   time = vcos_getmicrosecs64();
+   io = vc_container_io_open(argv[1], VC_CONTAINER_IO_MODE_READ, &status);
+   if (!io)
+   {
+      printf("Opening <%s> failed: %d\n", argv[1], status);
+      return 2;
+   }
+   if (ring_size)
+      vc_container_io_control(io, VC_CONTAINER_CONTROL_IO_SET_READ_BUFFER_SIZE, ring_size);
+   printf("%-24s %8"PRIu64" us (%"PRId64" bytes)\n", "open", vcos_getmicrosecs64() - time, io->size);
+
+   /* File with its index at the end: header, index, then back to the media data */
+   start_time = vcos_getmicrosecs64();
+   bench_read(io, 0, 4096);
+   time = vcos_getmicrosecs64();
+   bench_read(io, io->size > READ_SIZE ? io->size - READ_SIZE : 0, READ_SIZE);
+   printf("%-24s %8"PRIu64" us\n", "seek to end", vcos_getmicrosecs64() - time);
+   time = vcos_getmicrosecs64();
+   bench_read(io, 4096, sizeof(buffer));
+   printf("%-24s %8"PRIu64" us\n", "seek back to start", vcos_getmicrosecs64() - time);
+   printf("%-24s %8"PRIu64" us\n", "header/index/data", vcos_getmicrosecs64() - start_time);
+
+   /* Sequential throughput */
+   time = vcos_getmicrosecs64();
+   for (offset = 0; offset < io->size; offset += READ_SIZE)
+   {
+      size_t ret = bench_read(io, offset, READ_SIZE);
+      total += ret;
+      if (ret != READ_SIZE)
+         break;
+   }
+   time = vcos_getmicrosecs64() - time;
+   printf("%-24s %8.1f MB/s (%"PRId64" bytes in %"PRIu64" us)\n", "sequential",
+          time ? total / (double)time : 0.0, total, time);
+
+   bench_seeks(io, "forward skips < 256KB", 256*1024);
+   bench_seeks(io, "forward skips < 4MB", 4*1024*1024);
+   bench_seeks(io, "random seeks", 0);
+
+   vc_container_io_close(io);
+
+   if (verify)
+      printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
@@ -0,0 +1,300 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Minimal HTTP/1.1 server for testing the HTTP i/o module on the loopback interface.
+ * It serves either a file or a generated pattern (see http_bench.c) for any path,
+ * understands HEAD and GET with byte ranges, keeps connections alive unless told not to
+ * and can delay each response to simulate the round trip time of a real network. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/net/net_sockets.h"
+
+#define MAX_CONNECTIONS    16
+#define MAX_REQUEST_LEN    4096
+#define DATA_BUFFER_SIZE   (64*1024)
+
+/** Byte at the given offset of the generated pattern */
+#define PATTERN_BYTE(offset) ((uint8_t)(((offset) * 31) ^ ((offset) >> 11)))
+
+typedef struct CONNECTION_T
+{
+   VCOS_THREAD_T thread;
+   VC_CONTAINER_NET_T *sock;
+   bool started;
+   volatile bool done;
+   char request[MAX_REQUEST_LEN];
+   uint8_t data[DATA_BUFFER_SIZE];
+} CONNECTION_T;
+
+static const char *file_name;      /**< File being served, NULL for the pattern */
+static int64_t file_size;
+static uint32_t delay_ms;
+static bool keep_alive = true;
+static CONNECTION_T connections[MAX_CONNECTIONS];
+
+/*****************************************************************************/
+static bool send_all(VC_CONTAINER_NET_T *sock, const void *buffer, size_t size)
+{
+   const char *ptr = buffer;
+
+   while (size)
+   {
+      size_t sent = vc_container_net_write(sock, ptr, size);
+      if (!sent)
+         return false;
+      ptr += sent;
+      size -= sent;
+   }
+
+   return true;
+}
+
+/*****************************************************************************/
+static bool send_data(CONNECTION_T *conn, FILE *file, int64_t offset, int64_t size)
+{
+   if (file && fseek(file, (long)offset, SEEK_SET))
+      return false;
+
+   while (size > 0)
+   {
+      size_t chunk = size > DATA_BUFFER_SIZE ? DATA_BUFFER_SIZE : (size_t)size;
+      size_t i;
+
+      if (file)
+      {
+         if (fread(conn->data, 1, chunk, file) != chunk)
+            return false;
+      }
+      else
+      {
+         for (i = 0; i < chunk; i++)
+            conn->data[i] = PATTERN_BYTE(offset + (int64_t)i);
+      }
+
+      if (!send_all(conn->sock, conn->data, chunk))
+         return false;
+      offset += chunk;
+      size -= chunk;
+   }
+
+   return true;
+}
+
+/*****************************************************************************/
+static void *connection_thread(void *arg)
+{
+   CONNECTION_T *conn = arg;
+   FILE *file = NULL;
+   size_t length = 0;
+
+   if (file_name)
+      file = fopen(file_name, "rb");
+
+   while (1)
+   {
+      char header[512], *end, *range;
+      int64_t start = 0, last = file_size - 1;
+      bool head, partial = false;
+      size_t received;
+      int header_len;
+
+      /* Read until the end of the request headers */
+      conn->request[length] = 0;
+      while (!(end = strstr(conn->request, "\r\n\r\n")))
+      {
+         if (length >= sizeof(conn->request) - 1)
+            goto end;
+         received = vc_container_net_read(conn->sock, conn->request + length,
+                                          sizeof(conn->request) - 1 - length);
+         if (!received)
+            goto end;
+         length += received;
+         conn->request[length] = 0;
+      }
+      end += 4;
+
+      head = !strncmp(conn->request, "HEAD ", 5);
+      range = strstr(conn->request, "\nRange: bytes=");
+      if (range && range < end)
+      {
+         partial = true;
+         if (sscanf(range, "\nRange: bytes=%"SCNd64"-%"SCNd64, &start, &last) < 1)
+            start = 0;
+         if (last >= file_size)
+            last = file_size - 1;
+      }
+
+      /* Keep whatever came after the request */
+      length -= end - conn->request;
+      memmove(conn->request, end, length);
+
+      if (delay_ms)
+         vcos_sleep(delay_ms);
+
+      if (start > last && !head)
+      {
+         header_len = snprintf(header, sizeof(header),
+                               "HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+                               "Content-Length: 0\r\n%s\r\n",
+                               keep_alive ? "" : "Connection: close\r\n");
+         if (!send_all(conn->sock, header, header_len) || !keep_alive)
+            goto end;
+         continue;
+      }
+
+      if (partial && !head)
+         header_len = snprintf(header, sizeof(header),
+                               "HTTP/1.1 206 Partial Content\r\n"
+                               "Accept-Ranges: bytes\r\n"
+                               "Content-Range: bytes %"PRId64"-%"PRId64"/%"PRId64"\r\n"
+                               "Content-Length: %"PRId64"\r\n%s\r\n",
+                               start, last, file_size, last - start + 1,
+                               keep_alive ? "" : "Connection: close\r\n");
+      else
+         header_len = snprintf(header, sizeof(header),
+                               "HTTP/1.1 200 OK\r\n"
+                               "Accept-Ranges: bytes\r\n"
+                               "Content-Length: %"PRId64"\r\n%s\r\n",
+                               file_size, keep_alive ? "" : "Connection: close\r\n");
+
+      if (!send_all(conn->sock, header, header_len))
+         goto end;
+      if (!head && !send_data(conn, file, partial ? start : 0,
+                              partial ? last - start + 1 : file_size))
+         goto end;
+      if (!keep_alive)
+         goto end;
+   }
+
+end:
+   if (file)
+      fclose(file);
+   vc_container_net_close(conn->sock);
+   conn->done = true;
+   return NULL;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   VC_CONTAINER_NET_T *server_sock, *sock;
+   vc_container_net_status_t status;
+   int i;
+
+   if (argc < 3)
+   {
+      printf("Usage:\n%s <port> <file>|<pattern size> [<delay ms> [close]]\n", argv[0]);
+      return 1;
+   }
+
+   vcos_init();
+#ifdef SIGPIPE
+   signal(SIGPIPE, SIG_IGN);
+#endif
+
+   if (sscanf(argv[2], "%"SCNd64, &file_size) == 1 && !strchr(argv[2], '.') && !strchr(argv[2], '/'))
+   {
+      file_name = NULL;
+   }
+   else
+   {
+      FILE *file = fopen(argv[2], "rb");
+      if (!file)
+      {
+         printf("Cannot open %s\n", argv[2]);
+         return 2;
+      }
+      fseek(file, 0, SEEK_END);
+      file_size = ftell(file);
+      fclose(file);
+      file_name = argv[2];
+   }
+   if (argc > 3)
+      delay_ms = (uint32_t)strtoul(argv[3], NULL, 10);
+   if (argc > 4)
+      keep_alive = strcmp(argv[4], "close") != 0;
+
+   server_sock = vc_container_net_open(NULL, argv[1], VC_CONTAINER_NET_OPEN_FLAG_STREAM, &status);
+   if (!server_sock)
+   {
+      printf("vc_container_net_open failed: %d\n", status);
+      return 2;
+   }
+
+   status = vc_container_net_listen(server_sock, MAX_CONNECTIONS);
+   if (status != VC_CONTAINER_NET_SUCCESS)
+   {
+      printf("vc_container_net_listen failed: %d\n", status);
+      vc_container_net_close(server_sock);
+      return 3;
+   }
+
+   printf("Serving %"PRId64" bytes on port %s\n", file_size, argv[1]);
+   fflush(stdout);
+
+   while (vc_container_net_accept(server_sock, &sock) == VC_CONTAINER_NET_SUCCESS)
+   {
+      CONNECTION_T *conn = NULL;
+
+      /* Find a free slot, cleaning up after connections which have been closed */
+      for (i = 0; i < MAX_CONNECTIONS && !conn; i++)
+      {
+         if (connections[i].started && connections[i].done)
+         {
+            vcos_thread_join(&connections[i].thread, NULL);
+            connections[i].started = false;
+         }
+         if (!connections[i].started)
+            conn = &connections[i];
+      }
+
+      if (!conn)
+      {
+         printf("Too many connections\n");
+         vc_container_net_close(sock);
+         continue;
+      }
+
+      conn->sock = sock;
+      conn->done = false;
+      conn->started = true;
+      if (vcos_thread_create(&conn->thread, "http_connection", NULL, connection_thread, conn) != VCOS_SUCCESS)
+      {
+         conn->started = false;
+         vc_container_net_close(sock);
+      }
+   }
+
+   vc_container_net_close(server_sock);
+   return 0;
+}
@@ -0,0 +1,512 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Scalability benchmark for the ingest engine, e.g.
+ *    containers_ingest_bench 256 2 3
+ * receives synthetic H.264 (fragmented into FU-A packets) at 30 frames per second
+ * on each of 1, 4, 16, ... up to that many rtp:// streams on the loopback interface,
+ * with an ingest engine of that many threads, for that many seconds per step. For
+ * each step it reports the access units delivered per second, the CPU time spent
+ * receiving per thousand units, and the latency from the last packet of a unit being
+ * sent to the unit reaching the callback. Give -t as the first argument to compare
+ * with a thread of its own per stream doing blocking reads.
+ * Every unit delivered must be whole and intact, in order, with the right timestamp;
+ * units dropped because the receiver fell behind are counted, and are only errors
+ * if they were not signalled as a discontinuity. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_ingest.h"
+#include "containers/net/net_sockets.h"
+
+#define NET_PORT           16000       /* Stream i on NET_PORT + 2*i, RTCP on the next port up */
+#define STREAMS_MAX        1000
+#define SENDER_THREADS     2
+#define FRAME_RATE         30
+#define FRAME_DURATION     (90000 / FRAME_RATE)  /* 90kHz ticks */
+#define FRAGMENT_SIZE      1200
+#define FRAMES_KEPT        256         /* Sending times remembered, per stream */
+#define READ_TIMEOUT_MS    100
+#define DRAIN_MS           300
+
+/* 320x240 baseline profile sequence and picture parameter sets */
+#define SPROP_PARAMETER_SETS  "Z0LAHtoFB+Q=,aM48gA=="
+
+typedef struct STREAM_T
+{
+   VC_CONTAINER_INGEST_STREAM_T *ingest_stream;
+   VC_CONTAINER_NET_T *sock;           /* Sends to the stream */
+   uint32_t ssrc;
+   uint16_t seq;
+   volatile uint32_t frames_sent;     /* Counts a frame once its sending begins */
+   int64_t next_send;
+   volatile int64_t sent_time[FRAMES_KEPT];
+
+   /* Thread per stream comparison */
+   VC_CONTAINER_T *reader;
+   VCOS_THREAD_T thread;
+   uint8_t *frame_buffer;
+
+   /* Updated by whichever thread receives the stream */
+   bool started;
+   uint32_t first_frame, last_frame;
+   uint32_t units, bad_units, skipped, discontinuities;
+   uint64_t latency, max_latency;
+} STREAM_T;
+
+typedef struct SENDER_T
+{
+   VCOS_THREAD_T thread;
+   STREAM_T *streams;
+   unsigned int first, step, count;
+   int64_t end;
+   uint64_t cpu_time;
+} SENDER_T;
+
+static volatile bool receivers_stop;
+
+/*****************************************************************************/
+static uint64_t process_cpu_time(clockid_t clock)
+{
+   struct timespec now;
+
+   if (clock_gettime(clock, &now))
+      return 0;
+   return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint32_t frame_size(uint32_t frame)
+{
+   return 1000 + (frame * 2654435761u >> 16) % 6000;
+}
+
+static uint8_t frame_byte(uint32_t frame, uint32_t offset)
+{
+   return (uint8_t)(frame * 7 + offset);
+}
+
+static void write_u32(uint8_t *ptr, uint32_t value)
+{
+   ptr[0] = (uint8_t)(value >> 24); ptr[1] = (uint8_t)(value >> 16);
+   ptr[2] = (uint8_t)(value >> 8); ptr[3] = (uint8_t)value;
+}
+
+/* Send one frame to a stream, in a single NAL unit packet if it fits, otherwise in
+ * FU-A packets */
+static bool send_frame(STREAM_T *stream)
+{
+   uint8_t datagram[12 + 2 + FRAGMENT_SIZE];
+   uint32_t frame = stream->frames_sent++, size = frame_size(frame), offset, length, header, j;
+   uint32_t fragments = (size + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE, fragment;
+
+   for (fragment = 0, offset = 0; fragment < fragments; fragment++, offset += length)
+   {
+      bool last = fragment == fragments - 1;
+
+      length = last ? size - offset : FRAGMENT_SIZE;
+      datagram[0] = 0x80;
+      datagram[1] = (uint8_t)((last ? 0x80 : 0) | 96);
+      datagram[2] = (uint8_t)(stream->seq >> 8); datagram[3] = (uint8_t)stream->seq;
+      write_u32(datagram + 4, frame * FRAME_DURATION);
+      write_u32(datagram + 8, stream->ssrc);
+      stream->seq++;
+
+      if (fragments == 1)
+      {
+         datagram[12] = 0x65;
+         header = 13;
+      }
+      else
+      {
+         datagram[12] = 0x60 | 28;
+         datagram[13] = (uint8_t)((!fragment ? 0x80 : 0) | (last ? 0x40 : 0) | 5);
+         header = 14;
+      }
+      for (j = 0; j < length; j++)
+         datagram[header + j] = frame_byte(frame, offset + j);
+      if (!fragment)
+         write_u32(datagram + header, frame);
+
+      if (last)
+         stream->sent_time[frame % FRAMES_KEPT] = (int64_t)vcos_getmicrosecs64();
+      if (!vc_container_net_write(stream->sock, datagram, header + length))
+         return false;
+   }
+
+   return true;
+}
+
+/* Send frames to every step'th stream, each at the frame rate, spread out over the frame period */
+static void *sender_thread(void *arg)
+{
+   SENDER_T *sender = arg;
+   int64_t period = 1000000 / FRAME_RATE, start = vcos_getmicrosecs64(), now;
+   unsigned int i;
+
+   for (i = sender->first; i < sender->count; i += sender->step)
+      sender->streams[i].next_send = start + period * i / sender->count;
+
+   while ((now = vcos_getmicrosecs64()) < sender->end)
+   {
+      for (i = sender->first; i < sender->count; i += sender->step)
+      {
+         STREAM_T *stream = &sender->streams[i];
+
+         if (now < stream->next_send)
+            continue;
+         if (!send_frame(stream))
+            goto end;
+         stream->next_send += period;
+      }
+      vcos_sleep(1);
+   }
+
+ end:
+   sender->cpu_time = process_cpu_time(CLOCK_THREAD_CPUTIME_ID);
+   return NULL;
+}
+
+/*****************************************************************************/
+/* Check a unit which came out whole */
+static void check_unit(STREAM_T *stream, const uint8_t *data, uint32_t size, int64_t pts,
+      uint32_t flags)
+{
+   uint32_t frame, j;
+   int64_t latency;
+
+   if (flags & VC_CONTAINER_PACKET_FLAG_DISCONTINUITY)
+      stream->discontinuities++;
+
+   if (size < 9 || data[0] || data[1] || data[2] != 0 || data[3] != 1 || data[4] != 0x65)
+   {
+      stream->bad_units++;
+      return;
+   }
+
+   frame = ((uint32_t)data[5] << 24) | (data[6] << 16) | (data[7] << 8) | data[8];
+   if (!stream->started)
+   {
+      /* The reader needs a couple of packets in sequence before it starts */
+      stream->started = true;
+      stream->first_frame = frame;
+      stream->last_frame = frame - 1;
+   }
+
+   if (frame >= stream->frames_sent || frame <= stream->last_frame ||
+       size != frame_size(frame) + 5 ||
+       pts != (int64_t)(frame - stream->first_frame) * FRAME_DURATION * 1000000 / 90000)
+   {
+      stream->bad_units++;
+      return;
+   }
+   for (j = 4; j < frame_size(frame); j++)
+      if (data[5 + j] != frame_byte(frame, j))
+         break;
+   if (j < frame_size(frame))
+   {
+      stream->bad_units++;
+      return;
+   }
+
+   stream->skipped += frame - stream->last_frame - 1;
+   stream->last_frame = frame;
+   stream->units++;
+
+   latency = (int64_t)vcos_getmicrosecs64() - stream->sent_time[frame % FRAMES_KEPT];
+   if (latency < 0)
+      latency = 0;
+   stream->latency += latency;
+   if ((uint64_t)latency > stream->max_latency)
+      stream->max_latency = latency;
+}
+
+static void unit_callback(VC_CONTAINER_INGEST_STREAM_T *ingest_stream, void *userdata,
+      const VC_CONTAINER_PACKET_T *unit)
+{
+   VC_CONTAINER_PARAM_UNUSED(ingest_stream);
+   check_unit((STREAM_T *)userdata, unit->data, unit->size, unit->pts, unit->flags);
+}
+
+/* The comparison: a thread per stream, blocked reading from its reader */
+static void *receiver_thread(void *arg)
+{
+   STREAM_T *stream = arg;
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_STATUS_T status;
+   uint32_t size = 0, frame_flags = 0;
+   int64_t frame_pts = 0;
+   bool in_frame = false;
+
+   while (!receivers_stop)
+   {
+      memset(&packet, 0, sizeof(packet));
+      packet.data = stream->frame_buffer + size;
+      packet.buffer_size = 65536 - size;
+      status = vc_container_read(stream->reader, &packet, 0);
+      if (status == VC_CONTAINER_ERROR_ABORTED)
+         continue;
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
+      {
+         memmove(stream->frame_buffer, packet.data, packet.size);
+         size = 0;
+         frame_pts = packet.pts;
+         frame_flags = packet.flags;
+         in_frame = true;
+      }
+      else if (!in_frame)
+         continue;
+      size += packet.size;
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_END)
+      {
+         check_unit(stream, stream->frame_buffer, size, frame_pts, frame_flags);
+         size = 0;
+         in_frame = false;
+      }
+   }
+
+   return NULL;
+}
+
+/*****************************************************************************/
+static unsigned int bench(STREAM_T *streams, unsigned int count, unsigned int threads,
+      unsigned int seconds, bool thread_per_stream)
+{
+   VC_CONTAINER_INGEST_T *ingest = NULL;
+   VC_CONTAINER_STATUS_T status;
+   SENDER_T senders[SENDER_THREADS];
+   unsigned int i, opened = 0, started = 0, errors = 0;
+   uint64_t units = 0, skipped = 0, discontinuities = 0, bad_units = 0, latency = 0, max_latency = 0;
+   uint64_t cpu_time = 0, sender_cpu_time = 0, elapsed = 0;
+   uint32_t frames_sent = 0;
+   int64_t start;
+   char uri[256], port[16];
+
+   memset(streams, 0, sizeof(*streams) * count);
+   memset(senders, 0, sizeof(senders));
+   receivers_stop = false;
+
+   if (!thread_per_stream)
+   {
+      ingest = vc_container_ingest_create(threads, &status);
+      if (!ingest)
+      {
+         printf("failed to create ingest engine (%i)\n", status);
+         return 1;
+      }
+   }
+
+   for (opened = 0; opened < count; opened++)
+   {
+      STREAM_T *stream = &streams[opened];
+
+      stream->ssrc = 0x10000 + opened;
+      stream->seq = (uint16_t)(opened * 977);
+      snprintf(uri, sizeof(uri), "rtp://:%u?rtppt=96&mime-type=video/h264&sprop-parameter-sets=%s",
+            NET_PORT + 2 * opened, SPROP_PARAMETER_SETS);
+
+      if (thread_per_stream)
+      {
+         stream->frame_buffer = malloc(65536);
+         stream->reader = vc_container_open_reader(uri, &status, 0, 0);
+         if (!stream->frame_buffer || !stream->reader)
+            break;
+         vc_container_control(stream->reader, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, READ_TIMEOUT_MS);
+         vc_container_control(stream->reader, VC_CONTAINER_CONTROL_IO_SET_READ_BUFFER_SIZE, 256*1024);
+      }
+      else
+      {
+         stream->ingest_stream = vc_container_ingest_add_stream(ingest, uri, unit_callback, stream, &status);
+         if (!stream->ingest_stream)
+            break;
+         if (vc_container_ingest_stream_format(stream->ingest_stream)->type->video.width != 320)
+            errors++;
+      }
+
+      snprintf(port, sizeof(port), "%u", NET_PORT + 2 * opened);
+      stream->sock = vc_container_net_open("127.0.0.1", port, 0, NULL);
+      if (!stream->sock)
+         break;
+   }
+   if (opened < count)
+   {
+      printf("failed to open stream %u (%i)\n", opened, status);
+      errors++;
+      goto end;
+   }
+
+   if (thread_per_stream)
+   {
+      for (started = 0; started < count; started++)
+         if (vcos_thread_create(&streams[started].thread, "ingest_receiver", NULL,
+                                receiver_thread, &streams[started]) != VCOS_SUCCESS)
+            break;
+      if (started < count)
+      {
+         printf("failed to start receiver thread %u\n", started);
+         errors++;
+         goto end;
+      }
+   }
+
+   start = vcos_getmicrosecs64();
+   cpu_time = process_cpu_time(CLOCK_PROCESS_CPUTIME_ID);
+   for (i = 0; i < SENDER_THREADS; i++)
+   {
+      senders[i].streams = streams;
+      senders[i].first = i;
+      senders[i].step = SENDER_THREADS;
+      senders[i].count = count;
+      senders[i].end = start + (int64_t)seconds * 1000000;
+      if (vcos_thread_create(&senders[i].thread, "ingest_sender", NULL, sender_thread, &senders[i]) != VCOS_SUCCESS)
+         break;
+   }
+   while (i--)
+   {
+      vcos_thread_join(&senders[i].thread, NULL);
+      sender_cpu_time += senders[i].cpu_time;
+   }
+
+   /* Let the last units through */
+   vcos_sleep(DRAIN_MS);
+   cpu_time = process_cpu_time(CLOCK_PROCESS_CPUTIME_ID) - cpu_time - sender_cpu_time;
+   elapsed = vcos_getmicrosecs64() - start - DRAIN_MS * 1000;
+
+ end:
+   receivers_stop = true;
+   for (i = 0; i < started; i++)
+      vcos_thread_join(&streams[i].thread, NULL);
+
+   for (i = 0; i < opened; i++)
+   {
+      STREAM_T *stream = &streams[i];
+
+      if (stream->ingest_stream)
+         vc_container_ingest_remove_stream(stream->ingest_stream);
+      if (stream->reader)
+         vc_container_close(stream->reader);
+      if (stream->sock)
+         vc_container_net_close(stream->sock);
+      free(stream->frame_buffer);
+   }
+   vc_container_ingest_destroy(ingest);
+   if (errors)
+      return errors;
+
+   for (i = 0; i < count; i++)
+   {
+      STREAM_T *stream = &streams[i];
+
+      /* Units still on their way at the end are lost too */
+      if (stream->started)
+         stream->skipped += stream->frames_sent - 1 - stream->last_frame;
+      if (!stream->started || stream->bad_units || (stream->skipped && !stream->discontinuities &&
+          stream->last_frame + 1 == stream->frames_sent))
+         errors++;
+
+      frames_sent += stream->frames_sent;
+      units += stream->units;
+      skipped += stream->skipped;
+      discontinuities += stream->discontinuities;
+      bad_units += stream->bad_units;
+      latency += stream->latency;
+      if (stream->max_latency > max_latency)
+         max_latency = stream->max_latency;
+   }
+
+   printf("%-8s %4u streams %2u threads: %8.0f units/s, %7.1f us CPU per 1000 units (%5.1f%% CPU), "
+          "latency avg %5.2f ms max %6.2f ms, %u sent %" PRIu64 " delivered %" PRIu64 " lost "
+          "%" PRIu64 " discontinuities %" PRIu64 " bad%s\n",
+          thread_per_stream ? "threads" : "ingest", count, thread_per_stream ? count : threads,
+          elapsed ? (double)units * 1000000 / elapsed : 0.0,
+          units ? (double)cpu_time * 1000 / units : 0.0,
+          elapsed ? (double)cpu_time * 100 / elapsed : 0.0,
+          units ? (double)latency / units / 1000 : 0.0, (double)max_latency / 1000,
+          frames_sent, units, skipped, discontinuities, bad_units, errors ? " FAILED" : "");
+
+   return errors;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   bool thread_per_stream = argc > 1 && !strcmp(argv[1], "-t");
+   unsigned int max_streams, threads, seconds, count, errors = 0;
+   STREAM_T *streams;
+   struct rlimit limit;
+
+   if (thread_per_stream)
+   {
+      argc--;
+      argv++;
+   }
+   max_streams = argc > 1 ? strtoul(argv[1], NULL, 0) : 256;
+   threads = argc > 2 ? strtoul(argv[2], NULL, 0) : 2;
+   seconds = argc > 3 ? strtoul(argv[3], NULL, 0) : 3;
+
+   vcos_init();
+   streams = malloc(sizeof(*streams) * STREAMS_MAX);
+   if (!max_streams || max_streams > STREAMS_MAX || !threads ||
+       threads > VC_CONTAINER_INGEST_THREADS_MAX || !seconds || !streams)
+   {
+      printf("Usage:\n%s [-t] [<streams> [<threads> [<seconds>]]]\n", argv[0]);
+      return 1;
+   }
+
+   /* Each stream takes three sockets */
+   if (!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max)
+   {
+      limit.rlim_cur = limit.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &limit);
+   }
+
+   for (count = 1; ; count *= 4)
+   {
+      if (count > max_streams)
+         count = max_streams;
+      errors += bench(streams, count, threads, seconds, false);
+      if (thread_per_stream)
+         errors += bench(streams, count, threads, seconds, true);
+      if (count == max_streams)
+         break;
+   }
+
+   free(streams);
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
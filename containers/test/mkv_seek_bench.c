@@ -0,0 +1,514 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Seek and read benchmark for the Matroska reader, with and without its seek index, e.g.
+ *    containers_mkv_seek_bench /tmp/long.mkv create 10
+ * first writes a synthetic 10 hour file (5 second clusters of 30fps video with a keyframe
+ * and a cue point every second, and 44.1kHz audio in blocks of 8 frames using Xiph and
+ * EBML lacing) then times the same random seeks on two readers and checks that both end
+ * up on exactly the same packets. With "nocues" the file has no cues at all, so only the
+ * reader scanning the clusters in the background can seek. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+
+#define NUM_SEEKS          200
+#define PACKETS_PER_SEEK   4
+#define INDEX_SIZE         (64*1024*1024)
+
+#define CLUSTER_DURATION   5000  /* ms */
+#define AUDIO_LACE_FRAMES  8
+
+static uint8_t buffer[1024*1024];
+static unsigned int errors;
+
+/*****************************************************************************/
+static void write_id(FILE *file, uint32_t id)
+{
+   int shift = id > 0xFFFFFF ? 24 : id > 0xFFFF ? 16 : id > 0xFF ? 8 : 0;
+   for (; shift >= 0; shift -= 8)
+      fputc((int)(id >> shift) & 0xFF, file);
+}
+
+/* Sizes are always written on 8 bytes so they can be patched afterwards */
+static void write_size(FILE *file, uint64_t size)
+{
+   int shift;
+   fputc(0x01, file);
+   for (shift = 48; shift >= 0; shift -= 8)
+      fputc((int)(size >> shift) & 0xFF, file);
+}
+
+static void write_uint(FILE *file, uint32_t id, uint64_t value)
+{
+   int shift;
+   write_id(file, id);
+   write_size(file, 8);
+   for (shift = 56; shift >= 0; shift -= 8)
+      fputc((int)(value >> shift) & 0xFF, file);
+}
+
+static void write_float(FILE *file, uint32_t id, double value)
+{
+   uint64_t bits;
+   int shift;
+   memcpy(&bits, &value, sizeof(bits));
+   write_id(file, id);
+   write_size(file, 8);
+   for (shift = 56; shift >= 0; shift -= 8)
+      fputc((int)(bits >> shift) & 0xFF, file);
+}
+
+static void write_string(FILE *file, uint32_t id, const char *value)
+{
+   write_id(file, id);
+   write_size(file, strlen(value));
+   fputs(value, file);
+}
+
+/* Start a master element, returning the offset of its data */
+static int64_t start_master(FILE *file, uint32_t id)
+{
+   write_id(file, id);
+   write_size(file, 0);
+   return (int64_t)ftell(file);
+}
+
+static void end_master(FILE *file, int64_t data_offset)
+{
+   int64_t end = (int64_t)ftell(file);
+   fseek(file, (long)data_offset - 8, SEEK_SET);
+   write_size(file, (uint64_t)(end - data_offset));
+   fseek(file, (long)end, SEEK_SET);
+}
+
+/*****************************************************************************/
+static void write_video_block(FILE *file, uint32_t frame, int64_t cluster_time)
+{
+   uint32_t size = 16 + frame % 7, time = (uint32_t)((int64_t)frame * 1000 / 30 - cluster_time);
+
+   write_id(file, 0xA3); /* SimpleBlock */
+   write_size(file, 4 + size);
+   fputc(0x81, file);
+   fputc((int)(time >> 8), file);
+   fputc((int)(time & 0xFF), file);
+   fputc(frame % 30 ? 0 : 0x80, file);
+   memset(buffer, (int)frame, size);
+   fwrite(buffer, 1, size, file);
+}
+
+static uint32_t audio_frame_size(uint32_t frame)
+{
+   /* Mostly tiny frames, with the odd one big enough to need several Xiph lacing bytes */
+   return frame % 16 ? 8 + frame % 5 : 300 + frame % 200;
+}
+
+static void write_audio_block(FILE *file, uint32_t frame, int64_t cluster_time)
+{
+   uint32_t time = (uint32_t)((int64_t)frame * 1024 * 1000 / 44100 - cluster_time);
+   uint32_t i, size = 0, header_size = 0;
+   bool xiph = (frame / AUDIO_LACE_FRAMES) & 1;
+   uint8_t header[64];
+
+   header[header_size++] = AUDIO_LACE_FRAMES - 1;
+   for (i = 0; i < AUDIO_LACE_FRAMES - 1; i++)
+   {
+      uint32_t frame_size = audio_frame_size(frame + i);
+
+      if (xiph)
+      {
+         for (; frame_size >= 255; frame_size -= 255)
+            header[header_size++] = 255;
+         header[header_size++] = (uint8_t)frame_size;
+      }
+      else if (!i)
+      {
+         /* First size as a 2 byte EBML unsigned integer */
+         header[header_size++] = 0x40 | (uint8_t)(frame_size >> 8);
+         header[header_size++] = (uint8_t)frame_size;
+      }
+      else
+      {
+         /* Then differences as 2 byte EBML signed integers */
+         uint32_t diff = frame_size - audio_frame_size(frame + i - 1) + 0x1FFF;
+         header[header_size++] = 0x40 | (uint8_t)(diff >> 8);
+         header[header_size++] = (uint8_t)diff;
+      }
+   }
+   for (i = 0; i < AUDIO_LACE_FRAMES; i++)
+      size += audio_frame_size(frame + i);
+
+   write_id(file, 0xA3); /* SimpleBlock */
+   write_size(file, 4 + header_size + size);
+   fputc(0x82, file);
+   fputc((int)(time >> 8), file);
+   fputc((int)(time & 0xFF), file);
+   fputc(0x80 | (xiph ? 0x02 : 0x06), file);
+   fwrite(header, 1, header_size, file);
+   for (i = 0; i < AUDIO_LACE_FRAMES; i++)
+   {
+      memset(buffer, (int)(frame + i), audio_frame_size(frame + i));
+      fwrite(buffer, 1, audio_frame_size(frame + i), file);
+   }
+}
+
+/*****************************************************************************/
+static int create_file(const char *uri, unsigned int hours, bool cues)
+{
+   int64_t segment, seek_position = 0, master, cluster = 0, cluster_time = 0, end = (int64_t)hours * 3600000;
+   int64_t video_time = 0, audio_time = 0;
+   uint32_t video_frames = 0, audio_frames = 0, clusters = 0, i, num_cues = 0;
+   uint64_t *cue_cluster, *cue_relative, time = vcos_getmicrosecs64();
+   FILE *file;
+
+   file = fopen(uri, "wb");
+   cue_cluster = malloc(sizeof(*cue_cluster) * (hours * 3600 + 1));
+   cue_relative = malloc(sizeof(*cue_relative) * (hours * 3600 + 1));
+   if (!file || !cue_cluster || !cue_relative)
+   {
+      printf("Opening <%s> for writing failed\n", uri);
+      return 2;
+   }
+
+   master = start_master(file, 0x1A45DFA3); /* EBML */
+   write_string(file, 0x4282, "matroska");
+   write_uint(file, 0x4287, 2);
+   write_uint(file, 0x4285, 2);
+   end_master(file, master);
+
+   segment = start_master(file, 0x18538067);
+
+   if (cues)
+   {
+      int64_t seek;
+
+      master = start_master(file, 0x114D9B74); /* SeekHead */
+      seek = start_master(file, 0x4DBB);
+      write_id(file, 0x53AB);
+      write_size(file, 4);
+      write_id(file, 0x1C53BB6B);
+      seek_position = (int64_t)ftell(file);
+      write_uint(file, 0x53AC, 0);
+      end_master(file, seek);
+      end_master(file, master);
+   }
+
+   master = start_master(file, 0x1549A966); /* Info */
+   write_uint(file, 0x2AD7B1, 1000000);
+   write_float(file, 0x4489, (double)end);
+   end_master(file, master);
+
+   master = start_master(file, 0x1654AE6B); /* Tracks */
+   {
+      int64_t entry = start_master(file, 0xAE), settings;
+      write_uint(file, 0xD7, 1);
+      write_uint(file, 0x83, 1);
+      write_string(file, 0x86, "V_MPEG4/ISO/ASP");
+      settings = start_master(file, 0xE0);
+      write_uint(file, 0xB0, 640);
+      write_uint(file, 0xBA, 480);
+      end_master(file, settings);
+      end_master(file, entry);
+
+      entry = start_master(file, 0xAE);
+      write_uint(file, 0xD7, 2);
+      write_uint(file, 0x83, 2);
+      write_string(file, 0x86, "A_MPEG/L3");
+      settings = start_master(file, 0xE1);
+      write_float(file, 0xB5, 44100.0);
+      write_uint(file, 0x9F, 2);
+      end_master(file, settings);
+      end_master(file, entry);
+   }
+   end_master(file, master);
+
+   while (video_time < end || audio_time < end)
+   {
+      bool is_video = video_time <= audio_time;
+      int64_t block_time = is_video ? video_time : audio_time;
+
+      if (!clusters || block_time - cluster_time >= CLUSTER_DURATION)
+      {
+         if (clusters)
+            end_master(file, cluster);
+         cluster_time = block_time / CLUSTER_DURATION * CLUSTER_DURATION;
+         cluster = start_master(file, 0x1F43B675);
+         write_uint(file, 0xE7, (uint64_t)cluster_time);
+         clusters++;
+      }
+
+      if (is_video)
+      {
+         if (!(video_frames % 30))
+         {
+            cue_cluster[num_cues] = (uint64_t)(cluster - 12 - segment);
+            cue_relative[num_cues++] = (uint64_t)((int64_t)ftell(file) - cluster);
+         }
+         write_video_block(file, video_frames, cluster_time);
+         video_time = (int64_t)++video_frames * 1000 / 30;
+      }
+      else
+      {
+         write_audio_block(file, audio_frames, cluster_time);
+         audio_frames += AUDIO_LACE_FRAMES;
+         audio_time = (int64_t)audio_frames * 1024 * 1000 / 44100;
+      }
+   }
+   end_master(file, cluster);
+
+   if (cues)
+   {
+      int64_t cues_offset = (int64_t)ftell(file);
+
+      master = start_master(file, 0x1C53BB6B); /* Cues */
+      for (i = 0; i < num_cues; i++)
+      {
+         int64_t point = start_master(file, 0xBB), positions;
+         write_uint(file, 0xB3, (uint64_t)i * 1000);
+         positions = start_master(file, 0xB7);
+         write_uint(file, 0xF7, 1);
+         write_uint(file, 0xF1, cue_cluster[i]);
+         write_uint(file, 0xF0, cue_relative[i]);
+         end_master(file, positions);
+         end_master(file, point);
+      }
+      end_master(file, master);
+
+      fseek(file, (long)seek_position, SEEK_SET);
+      write_uint(file, 0x53AC, (uint64_t)(cues_offset - segment));
+      fseek(file, 0, SEEK_END);
+   }
+   end_master(file, segment);
+
+   fclose(file);
+   free(cue_cluster);
+   free(cue_relative);
+   printf("%-24s %8"PRIu64" ms (%u clusters, %u video, %u audio frames, %u cues)\n", "create",
+          (vcos_getmicrosecs64() - time) / 1000, clusters, video_frames, audio_frames,
+          cues ? num_cues : 0);
+   return 0;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_T *open_reader(const char *uri, uint32_t index_size)
+{
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx;
+
+   ctx = vc_container_open_reader(uri, &status, 0, 0);
+   if (!ctx)
+   {
+      printf("Opening <%s> failed: %d\n", uri, status);
+      return NULL;
+   }
+
+   if (vc_container_control(ctx, VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE, index_size) != VC_CONTAINER_SUCCESS)
+      printf("The reader doesn't support a seek index\n");
+   return ctx;
+}
+
+/*****************************************************************************/
+static uint64_t timed_seek(VC_CONTAINER_T *ctx, int64_t *time, VC_CONTAINER_SEEK_FLAGS_T flags)
+{
+   uint64_t start = vcos_getmicrosecs64();
+
+   if (vc_container_seek(ctx, time, VC_CONTAINER_SEEK_MODE_TIME, flags) != VC_CONTAINER_SUCCESS)
+      *time = -1;
+   return vcos_getmicrosecs64() - start;
+}
+
+/*****************************************************************************/
+static void read_packets(VC_CONTAINER_T *ctx, VC_CONTAINER_PACKET_T *packets)
+{
+   unsigned int i;
+
+   memset(packets, 0, PACKETS_PER_SEEK * sizeof(*packets));
+   for (i = 0; i < PACKETS_PER_SEEK; i++)
+   {
+      packets[i].data = buffer;
+      packets[i].buffer_size = sizeof(buffer);
+      if (vc_container_read(ctx, &packets[i], 0) != VC_CONTAINER_SUCCESS)
+         break;
+      packets[i].data = NULL;
+   }
+}
+
+/*****************************************************************************/
+static void read_all(VC_CONTAINER_T *ctx)
+{
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_STATUS_T status;
+   uint64_t time, count = 0, bytes = 0;
+   int64_t start = 0;
+
+   if (vc_container_seek(ctx, &start, VC_CONTAINER_SEEK_MODE_TIME, 0) != VC_CONTAINER_SUCCESS)
+      return;
+
+   time = vcos_getmicrosecs64();
+   while (1)
+   {
+      memset(&packet, 0, sizeof(packet));
+      packet.data = buffer;
+      packet.buffer_size = sizeof(buffer);
+      status = vc_container_read(ctx, &packet, 0);
+      if (status == VC_CONTAINER_ERROR_CONTINUE)
+         continue;
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+      count++;
+      bytes += packet.size;
+   }
+   time = vcos_getmicrosecs64() - time;
+
+   printf("%-24s %8"PRIu64" ms (%"PRIu64" packets, %"PRIu64" bytes)\n", "sequential read",
+          time / 1000, count, bytes);
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   VC_CONTAINER_PACKET_T packets[PACKETS_PER_SEEK], indexed_packets[PACKETS_PER_SEEK];
+   VC_CONTAINER_T *ctx, *indexed_ctx;
+   uint64_t total = 0, max = 0, indexed_total = 0, indexed_max = 0, time;
+   unsigned int i, hours = 10, seeks = 0, failed = 0;
+   int64_t first_seek_time;
+   uint32_t seed = 1;
+   bool cues = true;
+
+   if (argc < 2)
+   {
+      printf("Usage:\n%s <uri> [create [<hours>] [nocues]]\n", argv[0]);
+      return 1;
+   }
+
+   vcos_init();
+
+   if (argc > 2 && !strcmp(argv[2], "create"))
+   {
+      for (i = 3; i < (unsigned int)argc; i++)
+      {
+         if (!strcmp(argv[i], "nocues"))
+            cues = false;
+         else
+            hours = (unsigned int)strtoul(argv[i], NULL, 0);
+      }
+      if (!hours || create_file(argv[1], hours, cues))
+         return 2;
+   }
+
+   time = vcos_getmicrosecs64();
+   ctx = open_reader(argv[1], 0);
+   if (!ctx)
+      return 2;
+   printf("%-24s %8"PRIu64" us (%"PRId64" s)\n", "open", vcos_getmicrosecs64() - time,
+          ctx->duration / 1000000);
+   indexed_ctx = open_reader(argv[1], INDEX_SIZE);
+   if (!indexed_ctx || ctx->duration <= 0)
+      return 2;
+
+   /* The first seek also pays for building the index, or for waiting on the cluster scan */
+   first_seek_time = ctx->duration / 2;
+   printf("%-24s %8"PRIu64" us\n", "first seek", timed_seek(ctx, &first_seek_time, 0));
+   cues = first_seek_time >= 0; /* Without cues only the cluster scan allows seeking */
+   first_seek_time = ctx->duration / 2;
+   printf("%-24s %8"PRIu64" us\n", "first seek (indexed)", timed_seek(indexed_ctx, &first_seek_time, 0));
+
+   for (i = 0; i < NUM_SEEKS; i++)
+   {
+      VC_CONTAINER_SEEK_FLAGS_T flags = (i & 1) ? VC_CONTAINER_SEEK_FLAG_FORWARD : 0;
+      int64_t target, seek_time, indexed_seek_time;
+      unsigned int j;
+
+      seed = seed * 1103515245 + 12345;
+      target = seek_time = indexed_seek_time = (int64_t)(((uint64_t)seed << 16) % (uint64_t)ctx->duration);
+
+      time = timed_seek(ctx, &seek_time, flags);
+      total += time;
+      if (time > max)
+         max = time;
+      time = timed_seek(indexed_ctx, &indexed_seek_time, flags);
+      indexed_total += time;
+      if (time > indexed_max)
+         indexed_max = time;
+
+      /* Forward seeks past the last keyframe fail on both readers */
+      if (indexed_seek_time < 0)
+      {
+         failed++;
+         if (seek_time >= 0 && !errors++)
+            printf("Indexed seek to %"PRId64" failed\n", target);
+         continue;
+      }
+
+      /* The indexed reader must end up on the keyframe it reports */
+      read_packets(indexed_ctx, indexed_packets);
+      if (indexed_packets[0].track != 0 || indexed_packets[0].pts != indexed_seek_time ||
+          !(indexed_packets[0].flags & VC_CONTAINER_PACKET_FLAG_KEYFRAME) ||
+          ((flags & VC_CONTAINER_SEEK_FLAG_FORWARD) ? indexed_seek_time < target : indexed_seek_time > target))
+      {
+         if (!errors++)
+            printf("Wrong packet after seeking to %"PRId64" (%"PRId64", track %u pts %"PRId64")\n",
+                   target, indexed_seek_time, indexed_packets[0].track, indexed_packets[0].pts);
+      }
+
+      /* Without cues, only the indexed reader can seek at all */
+      if (seek_time < 0 && !cues)
+         continue;
+      seeks++;
+
+      read_packets(ctx, packets);
+      for (j = 0; j < PACKETS_PER_SEEK; j++)
+         if (packets[j].track != indexed_packets[j].track || packets[j].pts != indexed_packets[j].pts ||
+             packets[j].size != indexed_packets[j].size || packets[j].flags != indexed_packets[j].flags)
+            break;
+      if (seek_time != indexed_seek_time || j != PACKETS_PER_SEEK)
+      {
+         if (!errors++)
+            printf("Mismatch after seeking to %"PRId64" (%"PRId64" vs %"PRId64", packet %u)\n",
+                   target, seek_time, indexed_seek_time, j);
+      }
+   }
+
+   printf("%-24s avg %8"PRIu64" us  max %8"PRIu64" us\n", "random seeks",
+          total / NUM_SEEKS, max);
+   printf("%-24s avg %8"PRIu64" us  max %8"PRIu64" us\n", "random seeks (indexed)",
+          indexed_total / NUM_SEEKS, indexed_max);
+   printf("%-24s %8u of %u (%u failed)\n", "compared seeks", seeks, NUM_SEEKS, failed);
+
+   read_all(indexed_ctx);
+
+   vc_container_close(ctx);
+   vc_container_close(indexed_ctx);
+
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
@@ -0,0 +1,259 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Random seek benchmark for the MP4 reader, with and without its in-memory seek index, e.g.
+ *    containers_mp4_seek_bench /tmp/long.mp4 create 10
+ * first writes a synthetic 10 hour file (30fps video with a keyframe every second and
+ * 44.1kHz AAC audio, with tiny samples) then times the same random seeks on two readers
+ * and checks that both end up on exactly the same packets. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/containers_codecs.h"
+#include "containers/core/containers_utils.h"
+
+#define NUM_SEEKS          200
+#define PACKETS_PER_SEEK   4
+#define INDEX_SIZE         (256*1024*1024)
+
+static uint8_t buffer[1024*1024];
+static unsigned int errors;
+
+/*****************************************************************************/
+static int create_file(const char *uri, unsigned int hours)
+{
+   VC_CONTAINER_T *ctx;
+   VC_CONTAINER_ES_FORMAT_T *video, *audio;
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_PACKET_T packet;
+   int64_t video_time = 0, audio_time = 0, end = (int64_t)hours * 3600 * 1000000;
+   uint32_t video_frames = 0, audio_frames = 0;
+   uint64_t time = vcos_getmicrosecs64();
+
+   ctx = vc_container_open_writer(uri, &status, 0, 0);
+   if (!ctx)
+   {
+      printf("Opening <%s> for writing failed: %d\n", uri, status);
+      return 2;
+   }
+
+   video = vc_container_format_create(8);
+   audio = vc_container_format_create(8);
+   if (!video || !audio)
+      return 2;
+   video->es_type = VC_CONTAINER_ES_TYPE_VIDEO;
+   video->codec = VC_CONTAINER_CODEC_H264;
+   video->codec_variant = VC_FOURCC('a','v','c','C');
+   video->type->video.width = 640;
+   video->type->video.height = 480;
+   video->flags = VC_CONTAINER_ES_FORMAT_FLAG_FRAMED;
+   video->extradata_size = 8;
+   memcpy(video->extradata, "\x01\x42\x00\x1e\xff\xe0\x00\x00", 8);
+   audio->es_type = VC_CONTAINER_ES_TYPE_AUDIO;
+   audio->codec = VC_CONTAINER_CODEC_MP4A;
+   audio->type->audio.sample_rate = 44100;
+   audio->type->audio.channels = 2;
+   audio->flags = VC_CONTAINER_ES_FORMAT_FLAG_FRAMED;
+   audio->extradata_size = 2;
+   memcpy(audio->extradata, "\x12\x10", 2);
+
+   if (vc_container_control(ctx, VC_CONTAINER_CONTROL_TRACK_ADD, video) != VC_CONTAINER_SUCCESS ||
+       vc_container_control(ctx, VC_CONTAINER_CONTROL_TRACK_ADD, audio) != VC_CONTAINER_SUCCESS)
+   {
+      printf("Adding the tracks failed\n");
+      vc_container_close(ctx);
+      return 2;
+   }
+
+   while (video_time < end || audio_time < end)
+   {
+      bool is_video = video_time <= audio_time;
+
+      memset(&packet, 0, sizeof(packet));
+      packet.track = is_video ? 0 : 1;
+      packet.pts = packet.dts = is_video ? video_time : audio_time;
+      packet.flags = VC_CONTAINER_PACKET_FLAG_FRAME;
+      if (is_video && !(video_frames % 30))
+         packet.flags |= VC_CONTAINER_PACKET_FLAG_KEYFRAME;
+      packet.data = buffer;
+      packet.size = packet.buffer_size = is_video ? 16 + video_frames % 7 : 8 + audio_frames % 5;
+      memset(buffer, (int)(video_frames + audio_frames), packet.size);
+
+      status = vc_container_write(ctx, &packet);
+      if (status != VC_CONTAINER_SUCCESS)
+      {
+         printf("Writing failed: %d\n", status);
+         vc_container_close(ctx);
+         return 2;
+      }
+
+      if (is_video)
+         video_time = (int64_t)++video_frames * 1000000 / 30;
+      else
+         audio_time = (int64_t)++audio_frames * 1024 * 1000000 / 44100;
+   }
+
+   status = vc_container_close(ctx);
+   vc_container_format_delete(video);
+   vc_container_format_delete(audio);
+   printf("%-24s %8"PRIu64" ms (%u video, %u audio samples)\n", "create",
+          (vcos_getmicrosecs64() - time) / 1000, video_frames, audio_frames);
+   return status == VC_CONTAINER_SUCCESS ? 0 : 2;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_T *open_reader(const char *uri, uint32_t index_size)
+{
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx;
+
+   ctx = vc_container_open_reader(uri, &status, 0, 0);
+   if (!ctx)
+   {
+      printf("Opening <%s> failed: %d\n", uri, status);
+      return NULL;
+   }
+
+   if (index_size &&
+       vc_container_control(ctx, VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE, index_size) != VC_CONTAINER_SUCCESS)
+      printf("The reader doesn't support a seek index\n");
+   return ctx;
+}
+
+/*****************************************************************************/
+static uint64_t timed_seek(VC_CONTAINER_T *ctx, int64_t *time, VC_CONTAINER_SEEK_FLAGS_T flags)
+{
+   uint64_t start = vcos_getmicrosecs64();
+
+   if (vc_container_seek(ctx, time, VC_CONTAINER_SEEK_MODE_TIME, flags) != VC_CONTAINER_SUCCESS)
+      *time = -1;
+   return vcos_getmicrosecs64() - start;
+}
+
+/*****************************************************************************/
+static void read_packets(VC_CONTAINER_T *ctx, VC_CONTAINER_PACKET_T *packets)
+{
+   unsigned int i;
+
+   memset(packets, 0, PACKETS_PER_SEEK * sizeof(*packets));
+   for (i = 0; i < PACKETS_PER_SEEK; i++)
+   {
+      packets[i].data = buffer;
+      packets[i].buffer_size = sizeof(buffer);
+      if (vc_container_read(ctx, &packets[i], 0) != VC_CONTAINER_SUCCESS)
+         break;
+      packets[i].data = NULL;
+   }
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   VC_CONTAINER_PACKET_T packets[PACKETS_PER_SEEK], indexed_packets[PACKETS_PER_SEEK];
+   VC_CONTAINER_T *ctx, *indexed_ctx;
+   uint64_t total = 0, max = 0, indexed_total = 0, indexed_max = 0, time;
+   int64_t first_seek_time;
+   uint32_t seed = 1;
+   unsigned int i;
+
+   if (argc < 2)
+   {
+      printf("Usage:\n%s <uri> [create [<hours>]]\n", argv[0]);
+      return 1;
+   }
+
+   vcos_init();
+
+   if (argc > 2 && !strcmp(argv[2], "create") &&
+       create_file(argv[1], argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 0) : 10))
+      return 2;
+
+   time = vcos_getmicrosecs64();
+   ctx = open_reader(argv[1], 0);
+   if (!ctx)
+      return 2;
+   printf("%-24s %8"PRIu64" us (%"PRId64" s)\n", "open", vcos_getmicrosecs64() - time,
+          ctx->duration / 1000000);
+   indexed_ctx = open_reader(argv[1], INDEX_SIZE);
+   if (!indexed_ctx || ctx->duration <= 0)
+      return 2;
+
+   /* The first seek also pays for building the index */
+   first_seek_time = 1000000;
+   printf("%-24s %8"PRIu64" us\n", "first seek", timed_seek(ctx, &first_seek_time, 0));
+   first_seek_time = 1000000;
+   printf("%-24s %8"PRIu64" us\n", "first seek (indexed)", timed_seek(indexed_ctx, &first_seek_time, 0));
+
+   for (i = 0; i < NUM_SEEKS; i++)
+   {
+      VC_CONTAINER_SEEK_FLAGS_T flags = (i & 1) ? VC_CONTAINER_SEEK_FLAG_FORWARD : 0;
+      int64_t seek_time, indexed_seek_time;
+      unsigned int j;
+
+      seed = seed * 1103515245 + 12345;
+      seek_time = indexed_seek_time = (int64_t)(((uint64_t)seed << 16) % (uint64_t)ctx->duration);
+
+      time = timed_seek(ctx, &seek_time, flags);
+      total += time;
+      if (time > max)
+         max = time;
+      time = timed_seek(indexed_ctx, &indexed_seek_time, flags);
+      indexed_total += time;
+      if (time > indexed_max)
+         indexed_max = time;
+
+      read_packets(ctx, packets);
+      read_packets(indexed_ctx, indexed_packets);
+      for (j = 0; j < PACKETS_PER_SEEK; j++)
+         if (packets[j].track != indexed_packets[j].track || packets[j].pts != indexed_packets[j].pts ||
+             packets[j].size != indexed_packets[j].size || packets[j].flags != indexed_packets[j].flags)
+            break;
+      if (seek_time != indexed_seek_time || j != PACKETS_PER_SEEK)
+      {
+         if (!errors++)
+            printf("Mismatch after seeking to %"PRId64" (%"PRId64" vs %"PRId64", packet %u)\n",
+                   (int64_t)(((uint64_t)seed << 16) % (uint64_t)ctx->duration),
+                   seek_time, indexed_seek_time, j);
+      }
+   }
+
+   printf("%-24s avg %8"PRIu64" us  max %8"PRIu64" us\n", "random seeks",
+          total / NUM_SEEKS, max);
+   printf("%-24s avg %8"PRIu64" us  max %8"PRIu64" us\n", "random seeks (indexed)",
+          indexed_total / NUM_SEEKS, indexed_max);
+
+   vc_container_close(ctx);
+   vc_container_close(indexed_ctx);
+
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
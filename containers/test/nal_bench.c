@@ -0,0 +1,460 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Test and benchmark for the NAL unit byte stream helpers, e.g.
+ *    containers_nal_bench 64
+ * first checks that every helper gives exactly the same result as a simple byte by byte
+ * reference, on many short buffers full of zeros, start codes and emulation prevention
+ * sequences, at every alignment, then measures how many GB/s each helper and its
+ * reference get through on that many MB of:
+ *  - finding start codes, in typical slice data (few zero bytes),
+ *  - removing and inserting emulation prevention bytes,
+ *  - converting an Annex-B byte stream of NAL units of a few KB to avcC and back. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/core/containers_nal.h"
+
+#define CHECK_SIZE_MAX     600
+#define CHECK_ROUNDS       200
+#define NAL_SIZE_MAX       8000
+#define BENCH_TIME_US      500000
+
+/*****************************************************************************/
+static uint32_t next_random(uint32_t *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+static uint64_t now_us(void)
+{
+   struct timespec now;
+
+   if (clock_gettime(CLOCK_MONOTONIC, &now))
+      return 0;
+   return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Bytes which are mostly zeros and the values that follow them in the sequences of interest */
+static void fill_tricky(uint8_t *data, size_t size, uint32_t *seed)
+{
+   size_t i;
+
+   for (i = 0; i < size; i++)
+   {
+      uint32_t r = next_random(seed) % 16;
+      data[i] = r < 7 ? 0 : r < 12 ? (uint8_t)(r - 7) : (uint8_t)next_random(seed);
+   }
+}
+
+/* Bytes as they would be in slice data, i.e. random */
+static void fill_random(uint8_t *data, size_t size, uint32_t *seed)
+{
+   size_t i;
+
+   for (i = 0; i < size; i++)
+      data[i] = (uint8_t)next_random(seed);
+}
+
+/*****************************************************************************/
+/* The references, following the wording of ITU-T H.264 section 7.3.1 and annex B */
+
+static size_t ref_find_start_code(const uint8_t *data, size_t size)
+{
+   size_t i;
+
+   for (i = 0; i + 2 < size; i++)
+      if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+         return i;
+   return size;
+}
+
+static size_t ref_remove_epb(uint8_t *dst, const uint8_t *src, size_t size)
+{
+   size_t i, out = 0;
+   unsigned int zeros = 0;
+
+   for (i = 0; i < size; i++)
+   {
+      if (zeros >= 2 && src[i] == 3)
+      {
+         zeros = 0;
+         continue;
+      }
+      zeros = src[i] ? 0 : zeros + 1;
+      dst[out++] = src[i];
+   }
+   return out;
+}
+
+static size_t ref_insert_epb(uint8_t *dst, const uint8_t *src, size_t size)
+{
+   size_t i, out = 0;
+   unsigned int zeros = 0;
+
+   for (i = 0; i < size; i++)
+   {
+      if (zeros >= 2 && src[i] <= 3)
+      {
+         dst[out++] = 3;
+         zeros = 0;
+      }
+      zeros = src[i] ? 0 : zeros + 1;
+      dst[out++] = src[i];
+   }
+   if (zeros >= 2)
+      dst[out++] = 3;
+   return out;
+}
+
+static size_t ref_annexb_to_avcc(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size,
+      unsigned int length_size)
+{
+   size_t i = ref_find_start_code(src, size), start, end, out = 0;
+   unsigned int j;
+
+   while (i < size)
+   {
+      start = i + 3;
+      i = start + ref_find_start_code(src + start, size - start);
+      end = i;
+      while (end > start && !src[end - 1])
+         end--;
+      if (end == start)
+         continue;
+      if ((length_size < 4 && (end - start) >= (size_t)1 << (8 * length_size)) ||
+          out + length_size + end - start > dst_size)
+         return 0;
+      for (j = 0; j < length_size; j++)
+         dst[out++] = (uint8_t)((end - start) >> (8 * (length_size - 1 - j)));
+      while (start < end)
+         dst[out++] = src[start++];
+   }
+   return out;
+}
+
+static size_t ref_avcc_to_annexb(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size,
+      unsigned int length_size)
+{
+   size_t i = 0, out = 0, nal_size;
+   unsigned int j;
+
+   while (i < size)
+   {
+      if (i + length_size > size)
+         return 0;
+      for (j = 0, nal_size = 0; j < length_size; j++)
+         nal_size = nal_size << 8 | src[i++];
+      if (i + nal_size > size || out + 4 + nal_size > dst_size)
+         return 0;
+      dst[out++] = 0; dst[out++] = 0; dst[out++] = 0; dst[out++] = 1;
+      while (nal_size--)
+         dst[out++] = src[i++];
+   }
+   return out;
+}
+
+/*****************************************************************************/
+/* Write NAL units with random payloads, escaped as they should be, behind start codes of
+ * either size, sometimes with trailing zero bytes. Returns the size written. */
+static size_t make_annexb(uint8_t *data, size_t size, size_t nal_size_max, bool tricky, uint32_t *seed)
+{
+   uint8_t *payload = malloc(nal_size_max);
+   size_t out = 0, nal_size;
+
+   if (!payload)
+      return 0;
+
+   while (out + 5 + VC_CONTAINER_NAL_EPB_SIZE_MAX(nal_size_max) + 2 < size)
+   {
+      nal_size = 1 + next_random(seed) % nal_size_max;
+      if (tricky)
+         fill_tricky(payload, nal_size, seed);
+      else
+         fill_random(payload, nal_size, seed);
+
+      if (next_random(seed) % 2)
+         data[out++] = 0;
+      data[out++] = 0; data[out++] = 0; data[out++] = 1;
+      data[out++] = (uint8_t)(0x61 + next_random(seed) % 4); /* NAL unit header */
+      out += ref_insert_epb(data + out, payload, nal_size - 1);
+      if (!(next_random(seed) % 4))
+         data[out++] = 0;
+   }
+
+   free(payload);
+   return out;
+}
+
+/*****************************************************************************/
+static unsigned int check(void)
+{
+   uint8_t *src = malloc(CHECK_SIZE_MAX + 64), *dst = malloc(CHECK_SIZE_MAX * 2 + 64);
+   uint8_t *ref = malloc(CHECK_SIZE_MAX * 2 + 64);
+   unsigned int errors = 0, round, length_size, checks = 0;
+   size_t size, align, result, expected;
+   uint32_t seed = 1;
+
+   if (!src || !dst || !ref)
+      return 1;
+
+   for (round = 0; round < CHECK_ROUNDS; round++)
+   {
+      for (size = 0; size <= (round < 2 ? 64 : CHECK_SIZE_MAX); size += round < 2 ? 1 : 1 + next_random(&seed) % 37)
+      {
+         for (align = 0; align < 32; align += round < 2 ? 1 : 7)
+         {
+            uint8_t *in = src + align;
+
+            fill_tricky(in, size, &seed);
+            checks++;
+
+            if (vc_container_nal_find_start_code(in, size) != ref_find_start_code(in, size))
+               errors++;
+
+            expected = ref_remove_epb(ref, in, size);
+            result = vc_container_nal_remove_epb(dst, in, size);
+            if (result != expected || memcmp(dst, ref, result))
+               errors++;
+            /* In place too */
+            memcpy(dst + align, in, size);
+            result = vc_container_nal_remove_epb(dst + align, dst + align, size);
+            if (result != expected || memcmp(dst + align, ref, result))
+               errors++;
+
+            expected = ref_insert_epb(ref, in, size);
+            result = vc_container_nal_insert_epb(dst + align, in, size);
+            if (result != expected || memcmp(dst + align, ref, result) ||
+                result > VC_CONTAINER_NAL_EPB_SIZE_MAX(size))
+               errors++;
+            /* Nothing looking like a start code is left, and it all comes back */
+            if (ref_find_start_code(ref, result) != result ||
+                ref_remove_epb(ref, ref, result) != size || memcmp(ref, in, size))
+               errors++;
+
+            for (length_size = 1; length_size <= 4; length_size++)
+            {
+               size_t dst_size = size * 2 + 4;
+
+               /* Sometimes short of space */
+               if (!(next_random(&seed) % 8))
+                  dst_size = next_random(&seed) % (size + 1);
+
+               expected = ref_annexb_to_avcc(ref, dst_size, in, size, length_size);
+               result = vc_container_nal_annexb_to_avcc(dst, dst_size, in, size, length_size);
+               if (result != expected || memcmp(dst, ref, result))
+                  errors++;
+
+               expected = ref_avcc_to_annexb(ref, dst_size, in, size, length_size);
+               result = vc_container_nal_avcc_to_annexb(dst, dst_size, in, size, length_size);
+               if (result != expected || memcmp(dst, ref, result))
+                  errors++;
+            }
+         }
+      }
+   }
+
+   /* Whole streams of well formed NAL units go to avcC and back to the same NAL units */
+   for (round = 0; round < CHECK_ROUNDS; round++)
+   {
+      size_t annexb_size, avcc_size;
+
+      annexb_size = make_annexb(src, CHECK_SIZE_MAX, 40, true, &seed);
+      length_size = 1 + round % 4;
+      avcc_size = vc_container_nal_annexb_to_avcc(dst, CHECK_SIZE_MAX * 2, src, annexb_size, length_size);
+      result = vc_container_nal_avcc_to_annexb(ref, CHECK_SIZE_MAX * 2, dst, avcc_size, length_size);
+      expected = vc_container_nal_annexb_to_avcc(src, CHECK_SIZE_MAX, ref, result, length_size);
+      if (!avcc_size || !result || expected != avcc_size || memcmp(src, dst, avcc_size))
+         errors++;
+      checks++;
+   }
+
+   printf("checked %u buffers against the references: %u errors\n", checks, errors);
+   free(src);
+   free(dst);
+   free(ref);
+   return errors;
+}
+
+/*****************************************************************************/
+typedef size_t (*NAL_FUNCTION_T)(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size);
+
+static size_t find_start_codes(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   size_t i = 0, count = 0;
+   VC_CONTAINER_PARAM_UNUSED(dst);
+   VC_CONTAINER_PARAM_UNUSED(dst_size);
+
+   while ((i += vc_container_nal_find_start_code(src + i, size - i)) < size)
+   {
+      count++;
+      i += 3;
+   }
+   return count;
+}
+
+static size_t ref_find_start_codes(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   size_t i = 0, count = 0;
+   VC_CONTAINER_PARAM_UNUSED(dst);
+   VC_CONTAINER_PARAM_UNUSED(dst_size);
+
+   while ((i += ref_find_start_code(src + i, size - i)) < size)
+   {
+      count++;
+      i += 3;
+   }
+   return count;
+}
+
+static size_t remove_epb(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   VC_CONTAINER_PARAM_UNUSED(dst_size);
+   return vc_container_nal_remove_epb(dst, src, size);
+}
+
+static size_t ref_remove_epb_bench(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   VC_CONTAINER_PARAM_UNUSED(dst_size);
+   return ref_remove_epb(dst, src, size);
+}
+
+static size_t insert_epb(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   VC_CONTAINER_PARAM_UNUSED(dst_size);
+   return vc_container_nal_insert_epb(dst, src, size);
+}
+
+static size_t ref_insert_epb_bench(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   VC_CONTAINER_PARAM_UNUSED(dst_size);
+   return ref_insert_epb(dst, src, size);
+}
+
+static size_t annexb_to_avcc(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   return vc_container_nal_annexb_to_avcc(dst, dst_size, src, size, 4);
+}
+
+static size_t ref_annexb_to_avcc_bench(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   return ref_annexb_to_avcc(dst, dst_size, src, size, 4);
+}
+
+static size_t avcc_to_annexb(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   return vc_container_nal_avcc_to_annexb(dst, dst_size, src, size, 4);
+}
+
+static size_t ref_avcc_to_annexb_bench(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t size)
+{
+   return ref_avcc_to_annexb(dst, dst_size, src, size, 4);
+}
+
+/* Run a function over the data for a while, returning GB/s of input */
+static double measure(NAL_FUNCTION_T function, uint8_t *dst, size_t dst_size,
+      const uint8_t *src, size_t size, size_t *result)
+{
+   uint64_t start = now_us(), elapsed;
+   unsigned int runs = 0;
+
+   do
+   {
+      *result = function(dst, dst_size, src, size);
+      runs++;
+      elapsed = now_us() - start;
+   } while (elapsed < BENCH_TIME_US);
+
+   return (double)size * runs / elapsed / 1000;
+}
+
+static unsigned int bench(const char *name, NAL_FUNCTION_T function, NAL_FUNCTION_T reference,
+      uint8_t *dst, uint8_t *ref, size_t dst_size, const uint8_t *src, size_t size)
+{
+   size_t result, expected;
+   double rate, ref_rate;
+   bool output = function != find_start_codes;
+   unsigned int errors;
+
+   rate = measure(function, dst, dst_size, src, size, &result);
+   ref_rate = measure(reference, ref, dst_size, src, size, &expected);
+   errors = result != expected || (output && memcmp(dst, ref, result));
+
+   printf("%-16s %7.2f GB/s, reference %5.2f GB/s (x%4.1f)%s\n", name, rate, ref_rate,
+          ref_rate ? rate / ref_rate : 0.0, errors ? " FAILED" : "");
+   return errors;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   size_t size = (argc > 1 ? strtoul(argv[1], NULL, 0) : 64) << 20, annexb_size, escaped_size, avcc_size;
+   size_t dst_size = VC_CONTAINER_NAL_EPB_SIZE_MAX(size);
+   uint8_t *slices = malloc(size), *annexb = malloc(size), *escaped = malloc(dst_size);
+   uint8_t *dst = malloc(dst_size), *ref = malloc(dst_size);
+   unsigned int errors;
+   uint32_t seed = 2;
+
+   if (!size || !slices || !annexb || !escaped || !dst || !ref)
+   {
+      printf("Usage:\n%s [<MB>]\n", argv[0]);
+      return 1;
+   }
+
+   errors = check();
+
+   fill_random(slices, size, &seed);
+   annexb_size = make_annexb(annexb, size, NAL_SIZE_MAX, false, &seed);
+   escaped_size = ref_insert_epb(escaped, slices, size);
+   avcc_size = vc_container_nal_annexb_to_avcc(dst, dst_size, annexb, annexb_size, 4);
+   memcpy(slices, dst, avcc_size);
+
+   errors += bench("find start codes", find_start_codes, ref_find_start_codes, dst, ref, dst_size,
+         annexb, annexb_size);
+   errors += bench("remove EPB", remove_epb, ref_remove_epb_bench, dst, ref, dst_size,
+         escaped, escaped_size);
+   errors += bench("insert EPB", insert_epb, ref_insert_epb_bench, dst, ref, dst_size,
+         escaped, size);
+   errors += bench("Annex-B to avcC", annexb_to_avcc, ref_annexb_to_avcc_bench, dst, ref, dst_size,
+         annexb, annexb_size);
+   errors += bench("avcC to Annex-B", avcc_to_annexb, ref_avcc_to_annexb_bench, dst, ref, dst_size,
+         slices, avcc_size);
+
+   free(slices);
+   free(annexb);
+   free(escaped);
+   free(dst);
+   free(ref);
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
@@ -0,0 +1,316 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Benchmark for batched datagram reception, e.g.
+ *    containers_net_batch_bench 4 50000 100
+ * sends that many datagrams to each of that many receiver sockets on the loopback
+ * interface, at that many datagrams per millisecond in all, and receives them
+ * once with vc_container_net_read (one datagram per call) and once with
+ * vc_container_net_read_datagrams. For each way it reports the datagrams received per
+ * second and the CPU time the receiving threads spent per thousand datagrams.
+ * Every datagram received must be intact and in order; datagrams dropped by the
+ * kernel because a receiver fell behind are counted but are not errors. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/core/containers_common.h"
+#include "containers/net/net_sockets.h"
+
+#define NET_PORT           15100       /* One port per stream from here up */
+#define MAXIMUM_STREAMS    16
+#define PACKET_RATE        100         /* default packets per ms, over all the streams */
+#define DATAGRAM_SIZE      1200
+#define BATCH_SIZE         32
+#define READ_TIMEOUT_MS    500
+#define READ_BUFFER_SIZE   (4*1024*1024)
+
+typedef struct RECEIVER_T
+{
+   VCOS_THREAD_T thread;
+   VC_CONTAINER_NET_T *sock;
+   bool batched;
+   uint32_t packets;
+   uint32_t received, reads, errors;
+   uint64_t cpu_time;                  /* microseconds */
+} RECEIVER_T;
+
+typedef struct SENDER_T
+{
+   VCOS_THREAD_T thread;
+   unsigned int streams;
+   uint32_t packets, rate;
+} SENDER_T;
+
+/*****************************************************************************/
+static vc_container_net_status_t net_control(VC_CONTAINER_NET_T *sock,
+      vc_container_net_control_t operation, ...)
+{
+   vc_container_net_status_t result;
+   va_list args;
+
+   va_start(args, operation);
+   result = vc_container_net_control(sock, operation, args);
+   va_end(args);
+
+   return result;
+}
+
+static uint64_t thread_cpu_time(void)
+{
+   struct timespec now;
+
+   if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now))
+      return 0;
+   return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint8_t datagram_byte(uint32_t seq, uint32_t offset)
+{
+   return (uint8_t)(seq * 7 + offset);
+}
+
+/*****************************************************************************/
+/* Send the datagrams round robin over the streams, at a fixed rate */
+static void *sender_thread(void *arg)
+{
+   SENDER_T *sender = arg;
+   VC_CONTAINER_NET_T *socks[MAXIMUM_STREAMS];
+   uint8_t datagram[DATAGRAM_SIZE];
+   uint32_t seq, sent = 0;
+   unsigned int i;
+   uint64_t start;
+   char port[16];
+
+   memset(socks, 0, sizeof(socks));
+   for (i = 0; i < sender->streams; i++)
+   {
+      snprintf(port, sizeof(port), "%u", NET_PORT + i);
+      socks[i] = vc_container_net_open("127.0.0.1", port, 0, NULL);
+      if (!socks[i])
+         goto end;
+   }
+
+   vcos_sleep(100); /* Give the receivers time to start listening */
+   start = vcos_getmicrosecs64();
+   for (seq = 0; seq < sender->packets; seq++)
+   {
+      for (i = 0; i < DATAGRAM_SIZE; i++)
+         datagram[i] = datagram_byte(seq, i);
+      datagram[0] = (uint8_t)(seq >> 24); datagram[1] = (uint8_t)(seq >> 16);
+      datagram[2] = (uint8_t)(seq >> 8); datagram[3] = (uint8_t)seq;
+
+      for (i = 0; i < sender->streams; i++, sent++)
+         if (!vc_container_net_write(socks[i], datagram, sizeof(datagram)))
+            goto end;
+
+      while ((vcos_getmicrosecs64() - start) * sender->rate < (uint64_t)sent * 1000)
+         vcos_sleep(1);
+   }
+
+ end:
+   for (i = 0; i < sender->streams; i++)
+      if (socks[i])
+         vc_container_net_close(socks[i]);
+   return NULL;
+}
+
+/*****************************************************************************/
+/* Check a datagram received, which must come after the last one */
+static void check_datagram(RECEIVER_T *receiver, const uint8_t *data, size_t size,
+      int64_t *last_seq)
+{
+   uint32_t seq, i;
+
+   receiver->received++;
+   if (size != DATAGRAM_SIZE)
+   {
+      receiver->errors++;
+      return;
+   }
+
+   seq = ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+   if ((int64_t)seq <= *last_seq || seq >= receiver->packets)
+      receiver->errors++;
+   *last_seq = seq;
+
+   for (i = 4; i < DATAGRAM_SIZE; i++)
+      if (data[i] != datagram_byte(seq, i))
+      {
+         receiver->errors++;
+         break;
+      }
+}
+
+/* Receive datagrams until the last one, or until they stop coming */
+static void *receiver_thread(void *arg)
+{
+   RECEIVER_T *receiver = arg;
+   VC_CONTAINER_NET_DATAGRAM_T datagrams[BATCH_SIZE];
+   uint8_t *buffer;
+   int64_t last_seq = -1;
+   uint64_t start;
+   size_t count, i;
+
+   buffer = malloc(BATCH_SIZE * DATAGRAM_SIZE);
+   if (!buffer)
+   {
+      receiver->errors++;
+      return NULL;
+   }
+
+   start = thread_cpu_time();
+   while (last_seq < (int64_t)receiver->packets - 1)
+   {
+      if (receiver->batched)
+      {
+         for (i = 0; i < BATCH_SIZE; i++)
+         {
+            datagrams[i].buffer = buffer + i * DATAGRAM_SIZE;
+            datagrams[i].size = DATAGRAM_SIZE;
+         }
+         count = vc_container_net_read_datagrams(receiver->sock, datagrams, BATCH_SIZE);
+         for (i = 0; i < count; i++)
+            check_datagram(receiver, datagrams[i].buffer, datagrams[i].size, &last_seq);
+      }
+      else
+      {
+         count = vc_container_net_read(receiver->sock, buffer, DATAGRAM_SIZE);
+         if (count)
+            check_datagram(receiver, buffer, count, &last_seq);
+      }
+      if (!count)
+         break;
+      receiver->reads++;
+   }
+   receiver->cpu_time = thread_cpu_time() - start;
+
+   if (vc_container_net_status(receiver->sock) != VC_CONTAINER_NET_SUCCESS &&
+       vc_container_net_status(receiver->sock) != VC_CONTAINER_NET_ERROR_TIMED_OUT)
+      receiver->errors++;
+   free(buffer);
+   return NULL;
+}
+
+/*****************************************************************************/
+static unsigned int bench(unsigned int streams, uint32_t packets, uint32_t rate, bool batched)
+{
+   RECEIVER_T receivers[MAXIMUM_STREAMS];
+   SENDER_T sender;
+   uint32_t received = 0, reads = 0;
+   uint64_t cpu_time = 0, start, elapsed;
+   unsigned int i, started = 0, errors = 0;
+   char port[16];
+
+   memset(receivers, 0, sizeof(receivers));
+   start = vcos_getmicrosecs64();
+   for (i = 0; i < streams; i++)
+   {
+      RECEIVER_T *receiver = &receivers[i];
+
+      snprintf(port, sizeof(port), "%u", NET_PORT + i);
+      receiver->sock = vc_container_net_open(NULL, port, 0, NULL);
+      if (!receiver->sock)
+      {
+         printf("failed to open port %s\n", port);
+         errors++;
+         goto end;
+      }
+      net_control(receiver->sock, VC_CONTAINER_NET_CONTROL_SET_READ_TIMEOUT_MS, READ_TIMEOUT_MS);
+      net_control(receiver->sock, VC_CONTAINER_NET_CONTROL_SET_READ_BUFFER_SIZE, READ_BUFFER_SIZE);
+      receiver->batched = batched;
+      receiver->packets = packets;
+   }
+
+   for (; started < streams; started++)
+      if (vcos_thread_create(&receivers[started].thread, "net_receiver", NULL,
+            receiver_thread, &receivers[started]) != VCOS_SUCCESS)
+      {
+         errors++;
+         goto end;
+      }
+
+   sender.streams = streams;
+   sender.packets = packets;
+   sender.rate = rate;
+   if (vcos_thread_create(&sender.thread, "net_sender", NULL, sender_thread, &sender) != VCOS_SUCCESS)
+   {
+      errors++;
+      goto end;
+   }
+   vcos_thread_join(&sender.thread, NULL);
+
+ end:
+   for (i = 0; i < started; i++)
+      vcos_thread_join(&receivers[i].thread, NULL);
+   elapsed = vcos_getmicrosecs64() - start;
+
+   for (i = 0; i < streams; i++)
+   {
+      received += receivers[i].received;
+      reads += receivers[i].reads;
+      cpu_time += receivers[i].cpu_time;
+      errors += receivers[i].errors;
+      if (receivers[i].sock)
+         vc_container_net_close(receivers[i].sock);
+   }
+   if (!received)
+      errors++;
+
+   printf("%-8s %u streams: %8.0f datagrams/s, %u lost, %5.1f datagrams per read, "
+          "%6.1f us CPU per 1000 datagrams%s\n", batched ? "batched" : "single",
+          streams, elapsed ? (double)received * 1000000 / elapsed : 0.0,
+          streams * packets - received, reads ? (double)received / reads : 0.0,
+          received ? (double)cpu_time * 1000 / received : 0.0, errors ? " FAILED" : "");
+   return errors;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   unsigned int streams = argc > 1 ? strtoul(argv[1], NULL, 0) : 4;
+   uint32_t packets = argc > 2 ? strtoul(argv[2], NULL, 0) : 50000;
+   uint32_t rate = argc > 3 ? strtoul(argv[3], NULL, 0) : PACKET_RATE;
+   unsigned int errors = 0;
+
+   vcos_init();
+   if (!streams || streams > MAXIMUM_STREAMS || !packets || !rate)
+   {
+      printf("Usage:\n%s [<streams> [<datagrams per stream> [<datagrams per ms>]]]\n", argv[0]);
+      return 1;
+   }
+
+   errors += bench(streams, packets, rate, false);
+   errors += bench(streams, packets, rate, true);
+
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
@@ -0,0 +1,388 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Seek accuracy benchmark for the MPEG program stream reader, e.g.
+ *    containers_ps_seek_bench /tmp/long.mpg create 1
+ * first writes a synthetic 1 hour variable bitrate file (25fps MPEG-2 video with an
+ * I-picture every 12 frames, alternating between busy and static minutes, plus MPEG
+ * audio) then measures how far from the requested time seeks end up and how much
+ * i/o they take: with a linear estimate from the duration, with the reader's
+ * bisection (cold, again on the same times, and scrubbing) and with its background
+ * keyframe index. Files given by their absolute path are read through mmap:// so the
+ * i/o of the seeks shows up as page faults. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/core/containers_io.h"
+
+#define NUM_SEEKS          100
+#define INDEX_SIZE         (1024*1024)
+#define MAX_ERROR          1000000     /* us */
+
+#define FRAME_DURATION     3600        /* 90kHz ticks, 25fps */
+#define GOP_SIZE           12
+#define AUDIO_DURATION     2160        /* 90kHz ticks, 24ms */
+#define AUDIO_SIZE         192
+#define PTS_DELAY          18000       /* 90kHz ticks */
+#define PES_PAYLOAD_MAX    2010
+
+static uint8_t buffer[1024*1024];
+static unsigned int errors;
+static bool count_faults;
+
+/*****************************************************************************/
+static void write_timestamp(uint8_t *data, unsigned int marker, uint64_t ts)
+{
+   data[0] = (uint8_t)((marker << 4) | ((ts >> 29) & 0x0E) | 1);
+   data[1] = (uint8_t)(ts >> 22);
+   data[2] = (uint8_t)(((ts >> 14) & 0xFE) | 1);
+   data[3] = (uint8_t)(ts >> 7);
+   data[4] = (uint8_t)((ts << 1) | 1);
+}
+
+/* Write a pack header followed by a PES packet */
+static void write_pes(FILE *file, unsigned int stream_id, uint64_t scr, uint64_t pts,
+   const uint8_t *payload, unsigned int size)
+{
+   uint8_t header[32];
+   unsigned int header_size = pts ? 5 : 0;
+
+   header[0] = 0; header[1] = 0; header[2] = 1; header[3] = 0xBA;
+   header[4] = (uint8_t)(0x44 | ((scr >> 27) & 0x38) | ((scr >> 28) & 0x03));
+   header[5] = (uint8_t)(scr >> 20);
+   header[6] = (uint8_t)(((scr >> 12) & 0xF8) | 0x04 | ((scr >> 13) & 0x03));
+   header[7] = (uint8_t)(scr >> 5);
+   header[8] = (uint8_t)(((scr << 3) & 0xF8) | 0x04);
+   header[9] = 0x01;
+   header[10] = 0x00; header[11] = 0x1C; header[12] = 0x9B; /* program_mux_rate */
+   header[13] = 0xF8;
+   fwrite(header, 1, 14, file);
+
+   header[3] = (uint8_t)stream_id;
+   header[4] = (uint8_t)((3 + header_size + size) >> 8);
+   header[5] = (uint8_t)(3 + header_size + size);
+   header[6] = 0x81;
+   header[7] = pts ? 0x80 : 0;
+   header[8] = (uint8_t)header_size;
+   if (pts)
+      write_timestamp(header + 9, 0x2, pts);
+   fwrite(header, 1, 9 + header_size, file);
+   fwrite(payload, 1, size, file);
+}
+
+/* Size of a video frame, which depends on whether its minute is a busy one */
+static unsigned int frame_size(uint32_t frame)
+{
+   uint32_t minute = frame / (25 * 60);
+   bool busy = ((minute * 2654435761u) >> 28) & 1;
+   bool intra = !(frame % GOP_SIZE);
+
+   if (busy)
+      return intra ? 20000 : 4000 + frame % 500;
+   return intra ? 4000 : 200 + frame % 50;
+}
+
+static unsigned int write_frame_data(uint8_t *data, uint32_t frame)
+{
+   unsigned int size = 0, temporal_ref = frame % GOP_SIZE;
+   static const uint8_t sequence[] = {0,0,1,0xB3, 0x2D,0x02,0x40,0x23, 0xFF,0xFF,0xE0,0x18,
+                                      0,0,1,0xB8, 0x00,0x08,0x00,0x40};
+
+   if (!temporal_ref)
+   {
+      memcpy(data, sequence, sizeof(sequence));
+      size += sizeof(sequence);
+   }
+   data[size++] = 0; data[size++] = 0; data[size++] = 1; data[size++] = 0x00;
+   data[size++] = (uint8_t)(temporal_ref >> 2);
+   data[size++] = (uint8_t)((temporal_ref << 6) | ((temporal_ref ? 2 : 1) << 3));
+   data[size++] = 0xFF; data[size++] = 0xF8;
+   data[size++] = 0; data[size++] = 0; data[size++] = 1; data[size++] = 0x01;
+   memset(data + size, 0xAA, frame_size(frame));
+   return size + frame_size(frame);
+}
+
+static int create_file(const char *uri, unsigned int hours)
+{
+   uint64_t video_time = 0, audio_time = 0, end = (uint64_t)hours * 3600 * 90000;
+   uint32_t video_frames = 0, audio_frames = 0;
+   uint64_t time = vcos_getmicrosecs64();
+   FILE *file = fopen(uri, "wb");
+
+   if (!file)
+   {
+      printf("Opening <%s> for writing failed\n", uri);
+      return 2;
+   }
+
+   while (video_time < end || audio_time < end)
+   {
+      if (video_time <= audio_time)
+      {
+         unsigned int size = write_frame_data(buffer, video_frames), offset, chunk;
+
+         for (offset = 0; offset < size; offset += chunk)
+         {
+            chunk = size - offset < PES_PAYLOAD_MAX ? size - offset : PES_PAYLOAD_MAX;
+            write_pes(file, 0xE0, video_time, offset ? 0 : video_time + PTS_DELAY,
+                      buffer + offset, chunk);
+         }
+         video_time = (uint64_t)++video_frames * FRAME_DURATION;
+      }
+      else
+      {
+         memset(buffer, 0x55, AUDIO_SIZE);
+         write_pes(file, 0xC0, audio_time, audio_time + PTS_DELAY, buffer, AUDIO_SIZE);
+         audio_time = (uint64_t)++audio_frames * AUDIO_DURATION;
+      }
+   }
+
+   fwrite("\x00\x00\x01\xB9", 1, 4, file);
+   printf("%-28s %8"PRIu64" ms (%u video, %u audio frames, %ld bytes)\n", "create",
+          (vcos_getmicrosecs64() - time) / 1000, video_frames, audio_frames, ftell(file));
+   fclose(file);
+   return 0;
+}
+
+/*****************************************************************************/
+/* Memory mapped files are read through page faults rather than read calls */
+static int64_t read_count(void)
+{
+   struct rusage usage;
+
+   if (!count_faults || getrusage(RUSAGE_SELF, &usage))
+      return -1;
+   return usage.ru_minflt + usage.ru_majflt;
+}
+
+/*****************************************************************************/
+typedef struct RESULTS_T
+{
+   uint64_t time, error, max_error;
+   int64_t reads;
+   unsigned int seeks;
+} RESULTS_T;
+
+static void print_results(const char *name, const RESULTS_T *results)
+{
+   unsigned int seeks = results->seeks ? results->seeks : 1;
+
+   printf("%-28s error avg %7"PRIu64" us  max %8"PRIu64" us  time avg %6"PRIu64" us",
+          name, results->error / seeks, results->max_error, results->time / seeks);
+   if (results->reads >= 0)
+      printf("  faults avg %5.1f", (double)results->reads / seeks);
+   printf("\n");
+}
+
+static void add_result(RESULTS_T *results, int64_t target, int64_t time, uint64_t elapsed, int64_t reads)
+{
+   uint64_t error = (uint64_t)(time > target ? time - target : target - time);
+
+   results->seeks++;
+   results->error += error;
+   if (error > results->max_error)
+      results->max_error = error;
+   results->time += elapsed;
+   if (reads < 0 || results->reads < 0)
+      results->reads = -1;
+   else
+      results->reads += reads;
+}
+
+/*****************************************************************************/
+/* Where the old linear estimate from the duration ends up: time of the first pack
+ * after the estimated position */
+static int64_t linear_estimate(VC_CONTAINER_IO_T *io, int64_t target, int64_t duration, int64_t first_scr)
+{
+   int64_t offset = target * io->size / duration;
+   size_t size, i;
+   int64_t scr;
+
+   vc_container_io_seek(io, offset);
+   size = vc_container_io_read(io, buffer, 65536);
+   for (i = 0; i + 10 <= size; i++)
+   {
+      const uint8_t *p = buffer + i;
+      if (p[0] || p[1] || p[2] != 1 || p[3] != 0xBA || (p[4] & 0xC4) != 0x44)
+         continue;
+      scr = ((int64_t)(p[4] & 0x38) << 27) | ((int64_t)(p[4] & 0x03) << 28) | (p[5] << 20) |
+         ((p[6] & 0xF8) << 12) | ((p[6] & 0x03) << 13) | (p[7] << 5) | (p[8] >> 3);
+      return (scr * 300 - first_scr) / 27;
+   }
+   return duration;
+}
+
+/*****************************************************************************/
+static VC_CONTAINER_T *open_reader(const char *uri)
+{
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx = vc_container_open_reader(uri, &status, 0, 0);
+
+   if (!ctx)
+      printf("Opening <%s> failed: %d\n", uri, status);
+   return ctx;
+}
+
+/* Seek and check the first packet is where the reader says it is */
+static void bench_seek(VC_CONTAINER_T *ctx, RESULTS_T *results, int64_t target,
+   VC_CONTAINER_SEEK_FLAGS_T flags, bool keyframes)
+{
+   VC_CONTAINER_PACKET_T packet;
+   int64_t time = target, reads = read_count();
+   uint64_t elapsed = vcos_getmicrosecs64();
+   VC_CONTAINER_STATUS_T status;
+
+   status = vc_container_seek(ctx, &time, VC_CONTAINER_SEEK_MODE_TIME, flags);
+   elapsed = vcos_getmicrosecs64() - elapsed;
+   if (reads >= 0)
+      reads = read_count() - reads;
+   if (status != VC_CONTAINER_SUCCESS)
+   {
+      if (!errors++)
+         printf("Seeking to %"PRId64" failed: %d\n", target, status);
+      return;
+   }
+   add_result(results, target, time, elapsed, reads);
+
+   memset(&packet, 0, sizeof(packet));
+   packet.data = buffer;
+   packet.buffer_size = sizeof(buffer);
+   status = vc_container_read(ctx, &packet, 0);
+   if (status != VC_CONTAINER_SUCCESS || packet.pts != time ||
+       (time > target ? time - target : target - time) > MAX_ERROR ||
+       (keyframes && (packet.track != 0 || time > target || packet.data[3] != 0xB3)))
+   {
+      if (!errors++)
+         printf("Wrong packet after seeking to %"PRId64" (%"PRId64", track %u pts %"PRId64")\n",
+                target, time, packet.track, packet.pts);
+   }
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   VC_CONTAINER_T *ctx;
+   VC_CONTAINER_IO_T *io;
+   VC_CONTAINER_STATUS_T status;
+   RESULTS_T results;
+   int64_t targets[NUM_SEEKS], duration, first_scr;
+   uint64_t time;
+   uint32_t seed = 1;
+   unsigned int i;
+   char uri[1024];
+
+   if (argc < 2)
+   {
+      printf("Usage:\n%s <uri> [create [<hours>]]\n", argv[0]);
+      return 1;
+   }
+
+   vcos_init();
+
+   if (argc > 2 && !strcmp(argv[2], "create") &&
+       create_file(argv[1], argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 0) : 1))
+      return 2;
+
+   count_faults = argv[1][0] == '/';
+   snprintf(uri, sizeof(uri), "%s%s", count_faults ? "mmap://" : "", argv[1]);
+
+   ctx = open_reader(uri);
+   if (!ctx)
+      return 2;
+   duration = ctx->duration;
+   printf("%-28s %8"PRId64" s (estimated)\n", "duration", duration / 1000000);
+   if (duration <= 0)
+      return 2;
+   for (i = 0; i < NUM_SEEKS; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      targets[i] = (int64_t)(((uint64_t)seed << 16) % (uint64_t)duration);
+   }
+
+   /* Baseline */
+   io = vc_container_io_open(argv[1], VC_CONTAINER_IO_MODE_READ, &status);
+   if (!io || vc_container_io_read(io, buffer, 14) != 14)
+      return 2;
+   first_scr = (((int64_t)(buffer[4] & 0x38) << 27) | ((int64_t)(buffer[4] & 0x03) << 28) |
+                (buffer[5] << 20) | ((buffer[6] & 0xF8) << 12) | ((buffer[6] & 0x03) << 13) |
+                (buffer[7] << 5) | (buffer[8] >> 3)) * 300;
+   memset(&results, 0, sizeof(results));
+   results.reads = -1;
+   for (i = 0; i < NUM_SEEKS; i++)
+      add_result(&results, targets[i], linear_estimate(io, targets[i], duration, first_scr), 0, -1);
+   vc_container_io_close(io);
+   print_results("linear estimate", &results);
+
+   /* Bisection, then the same seeks again with what's been learnt */
+   memset(&results, 0, sizeof(results));
+   for (i = 0; i < NUM_SEEKS; i++)
+      bench_seek(ctx, &results, targets[i], (i & 1) ? VC_CONTAINER_SEEK_FLAG_FORWARD : 0, false);
+   print_results("bisection", &results);
+   memset(&results, 0, sizeof(results));
+   for (i = 0; i < NUM_SEEKS; i++)
+      bench_seek(ctx, &results, targets[i], (i & 1) ? VC_CONTAINER_SEEK_FLAG_FORWARD : 0, false);
+   print_results("bisection (same times)", &results);
+   vc_container_close(ctx);
+
+   /* Scrubbing back and forth around a point */
+   ctx = open_reader(uri);
+   if (!ctx)
+      return 2;
+   memset(&results, 0, sizeof(results));
+   for (i = 0; i < NUM_SEEKS; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      bench_seek(ctx, &results, duration / 3 + (int64_t)(seed >> 8) % 60000000, 0, false);
+   }
+   print_results("bisection (scrubbing)", &results);
+   vc_container_close(ctx);
+
+   /* Keyframe index */
+   ctx = open_reader(uri);
+   if (!ctx)
+      return 2;
+   if (vc_container_control(ctx, VC_CONTAINER_CONTROL_SET_SEEK_INDEX_SIZE, INDEX_SIZE) != VC_CONTAINER_SUCCESS)
+      printf("The reader doesn't support a seek index\n");
+   time = vcos_getmicrosecs64();
+   memset(&results, 0, sizeof(results));
+   bench_seek(ctx, &results, duration - 1000000, 0, true);
+   printf("%-28s %8"PRIu64" ms\n", "first seek (keyframe index)", (vcos_getmicrosecs64() - time) / 1000);
+   memset(&results, 0, sizeof(results));
+   for (i = 0; i < NUM_SEEKS; i++)
+      bench_seek(ctx, &results, targets[i], 0, true);
+   print_results("keyframe index", &results);
+   vc_container_close(ctx);
+
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
@@ -0,0 +1,516 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Benchmark for the jitter buffer of the RTP reader, e.g.
+ *    containers_rtp_jitter_bench 3000
+ * sends that many frames of synthetic H.264 (fragmented into FU-A packets) over
+ * rtp:// on the loopback interface, along with RTCP sender reports, once for each
+ * of these impairments:
+ *  - none,
+ *  - packets reordered by up to a few places,
+ *  - packets lost,
+ *  - packets duplicated,
+ *  - packets held back so long that they arrive after they have been given up on,
+ *  - all of the above.
+ * Every frame which comes out whole must be intact and have the right timestamp,
+ * frames broken by a loss must never come out whole, and the reader's counters
+ * must agree with what was done to the stream. The timestamps run at about the
+ * rate the frames are sent, so the reader sees realistic jitter. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/net/net_sockets.h"
+
+#define NET_PORT           15008       /* RTCP on the next port up */
+#define PACKET_RATE        20          /* packets per ms */
+#define READ_TIMEOUT_MS    500
+#define READ_BUFFER_SIZE   (1024*1024)
+#define LATENCY_MS         100
+
+#define FRAGMENT_SIZE      1200
+#define FRAME_DURATION     18          /* 90kHz ticks, about as long as sending a frame takes */
+#define SR_EVERY           100         /* packets */
+
+#define LATE_DELAY         80          /* packets, short of looking like a restart */
+#define POSITION_SCALE     16
+
+/* 320x240 baseline profile sequence and picture parameter sets */
+#define SPROP_PARAMETER_SETS  "Z0LAHtoFB+Q=,aM48gA=="
+
+#define NTP_UNIX_EPOCH_OFFSET INT64_C(2208988800)
+#define WALLCLOCK_START    (INT64_C(1500000000) * 1000000)
+
+typedef struct SCENARIO_T
+{
+   const char *name;
+   unsigned int reorder, drop, duplicate, late;  /* per mille */
+} SCENARIO_T;
+
+/* One datagram to send, in the order given by position */
+typedef struct SEND_T
+{
+   uint32_t position;
+   uint32_t frame;
+   uint16_t fragment;
+   uint16_t seq;
+} SEND_T;
+
+typedef struct SENDER_T
+{
+   VCOS_THREAD_T thread;
+   SEND_T *schedule;
+   unsigned int count;
+   uint32_t frames, ssrc, timestamp_base;
+   int64_t *sent_time;                 /* When each frame was last sent */
+   bool stop;
+} SENDER_T;
+
+typedef struct RESULTS_T
+{
+   uint32_t frames, dropped, abandoned, bad_frames, repeated, discontinuities;
+   uint32_t first_frame;               /* Frames before this one are used up by probation */
+   uint64_t latency, max_latency;
+   uint64_t elapsed;
+} RESULTS_T;
+
+static uint8_t frame_buffer[256*1024];
+static uint8_t *damaged, *delivered;
+
+/*****************************************************************************/
+static uint32_t next_random(uint32_t *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+static uint32_t frame_size(uint32_t frame)
+{
+   return 1000 + (frame * 2654435761u >> 16) % 6000;
+}
+
+static unsigned int frame_fragments(uint32_t frame)
+{
+   return (frame_size(frame) + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
+}
+
+static uint8_t frame_byte(uint32_t frame, uint32_t offset)
+{
+   return (uint8_t)(frame * 7 + offset);
+}
+
+static void write_u32(uint8_t *ptr, uint32_t value)
+{
+   ptr[0] = (uint8_t)(value >> 24); ptr[1] = (uint8_t)(value >> 16);
+   ptr[2] = (uint8_t)(value >> 8); ptr[3] = (uint8_t)value;
+}
+
+static int compare_position(const void *a, const void *b)
+{
+   uint32_t first = ((const SEND_T *)a)->position, second = ((const SEND_T *)b)->position;
+   return first < second ? -1 : first > second;
+}
+
+/* Work out which datagrams get sent in which order, and which frames get damaged */
+static SEND_T *schedule_packets(const SCENARIO_T *scenario, uint32_t frames,
+      uint16_t first_seq, unsigned int *count, uint32_t *drops, uint32_t *duplicates, uint32_t *lates)
+{
+   uint32_t seed = 1, frame, index = 0, packets = 0;
+   SEND_T *schedule;
+   unsigned int n = 0, fragment;
+
+   for (frame = 0; frame < frames; frame++)
+      packets += frame_fragments(frame);
+   schedule = malloc(sizeof(*schedule) * packets * 2);
+   if (!schedule)
+      return NULL;
+
+   *drops = *duplicates = *lates = 0;
+   memset(damaged, 0, frames);
+   for (frame = 0; frame < frames; frame++)
+   {
+      for (fragment = 0; fragment < frame_fragments(frame); fragment++, index++)
+      {
+         SEND_T *send = &schedule[n];
+         uint32_t r = next_random(&seed) % 1000;
+
+         send->frame = frame;
+         send->fragment = (uint16_t)fragment;
+         send->seq = (uint16_t)(first_seq + index);
+         send->position = index * POSITION_SCALE;
+
+         /* Keep the first and last few packets clean so that the stream starts and ends
+          * properly */
+         if (index < 10 || index + LATE_DELAY + 10 > packets)
+            r = 1000;
+
+         if (r < scenario->drop)
+         {
+            (*drops)++;
+            damaged[frame] = 1;
+            continue;
+         }
+         r -= scenario->drop;
+         if (r < scenario->late)
+         {
+            /* Whether this gets there in time depends on how long the reader waits */
+            (*lates)++;
+            send->position += LATE_DELAY * POSITION_SCALE + 1;
+         }
+         else if (r - scenario->late < scenario->reorder)
+            send->position += (1 + r % 8) * POSITION_SCALE + 1;
+         else if (r - scenario->late - scenario->reorder < scenario->duplicate)
+         {
+            (*duplicates)++;
+            schedule[++n] = *send;
+            schedule[n].position++;
+         }
+         n++;
+      }
+   }
+
+   qsort(schedule, n, sizeof(*schedule), compare_position);
+   *count = n;
+   return schedule;
+}
+
+/* Send the datagrams of the schedule at a fixed rate, with a sender report now and then */
+static void *sender_thread(void *arg)
+{
+   SENDER_T *sender = arg;
+   uint8_t datagram[12 + 2 + FRAGMENT_SIZE];
+   uint8_t report[28];
+   VC_CONTAINER_NET_T *sock, *rtcp_sock;
+   char port[16];
+   unsigned int i;
+   uint64_t start;
+
+   snprintf(port, sizeof(port), "%u", NET_PORT);
+   sock = vc_container_net_open("127.0.0.1", port, 0, NULL);
+   snprintf(port, sizeof(port), "%u", NET_PORT + 1);
+   rtcp_sock = vc_container_net_open("127.0.0.1", port, 0, NULL);
+   if (!sock || !rtcp_sock)
+      goto end;
+
+   vcos_sleep(100); /* Give the reader time to start listening */
+   start = vcos_getmicrosecs64();
+   for (i = 0; i < sender->count && !sender->stop; i++)
+   {
+      const SEND_T *send = &sender->schedule[i];
+      uint32_t size = frame_size(send->frame), offset = send->fragment * FRAGMENT_SIZE;
+      uint32_t fragments = frame_fragments(send->frame), length, header, j;
+      uint32_t timestamp = sender->timestamp_base + send->frame * FRAME_DURATION;
+      bool last = send->fragment == fragments - 1;
+
+      length = last ? size - offset : FRAGMENT_SIZE;
+      datagram[0] = 0x80;
+      datagram[1] = (uint8_t)((last ? 0x80 : 0) | 96);
+      datagram[2] = (uint8_t)(send->seq >> 8); datagram[3] = (uint8_t)send->seq;
+      write_u32(datagram + 4, timestamp);
+      write_u32(datagram + 8, sender->ssrc);
+
+      /* An IDR slice NAL unit starting with the frame number, in a single NAL unit packet
+       * if it fits, otherwise in FU-A packets */
+      if (fragments == 1)
+      {
+         datagram[12] = 0x65;
+         header = 13;
+      }
+      else
+      {
+         datagram[12] = 0x60 | 28;
+         datagram[13] = (uint8_t)((!send->fragment ? 0x80 : 0) | (last ? 0x40 : 0) | 5);
+         header = 14;
+      }
+      for (j = 0; j < length; j++)
+         datagram[header + j] = frame_byte(send->frame, offset + j);
+      if (!send->fragment)
+         write_u32(datagram + header, send->frame);
+
+      sender->sent_time[send->frame] = (int64_t)vcos_getmicrosecs64();
+      if (!vc_container_net_write(sock, datagram, header + length))
+         break;
+
+      if (i % SR_EVERY == SR_EVERY - 1)
+      {
+         /* The sender's clock runs in step with the frames it is sending */
+         int64_t wallclock = WALLCLOCK_START + (int64_t)send->frame * FRAME_DURATION * 1000000 / 90000;
+         uint64_t ntp = ((uint64_t)(wallclock / 1000000 + NTP_UNIX_EPOCH_OFFSET) << 32) |
+               (((uint64_t)(wallclock % 1000000) << 32) / 1000000);
+
+         memset(report, 0, sizeof(report));
+         report[0] = 0x80; report[1] = 200; report[3] = 6;
+         write_u32(report + 4, sender->ssrc);
+         write_u32(report + 8, (uint32_t)(ntp >> 32));
+         write_u32(report + 12, (uint32_t)ntp);
+         write_u32(report + 16, timestamp);
+         write_u32(report + 20, i);
+         vc_container_net_write(rtcp_sock, report, sizeof(report));
+      }
+
+      while ((vcos_getmicrosecs64() - start) * PACKET_RATE < (uint64_t)i * 1000)
+         vcos_sleep(1);
+   }
+
+ end:
+   if (rtcp_sock)
+      vc_container_net_close(rtcp_sock);
+   if (sock)
+      vc_container_net_close(sock);
+   return NULL;
+}
+
+/*****************************************************************************/
+/* Check a frame which came out whole */
+static void check_frame(const uint8_t *data, uint32_t size, int64_t pts, SENDER_T *sender,
+      RESULTS_T *results)
+{
+   uint32_t frame, j;
+   int64_t latency;
+
+   if (size < 9 || data[0] || data[1] || data[2] != 0 || data[3] != 1 || data[4] != 0x65)
+   {
+      results->bad_frames++;
+      return;
+   }
+
+   frame = ((uint32_t)data[5] << 24) | (data[6] << 16) | (data[7] << 8) | data[8];
+   if (frame >= sender->frames || size != frame_size(frame) + 5 ||
+       pts != (int64_t)(frame - results->first_frame) * FRAME_DURATION * 1000000 / 90000)
+   {
+      results->bad_frames++;
+      return;
+   }
+   for (j = 4; j < frame_size(frame); j++)
+      if (data[5 + j] != frame_byte(frame, j))
+         break;
+   if (j < frame_size(frame) || damaged[frame])
+   {
+      results->bad_frames++;
+      return;
+   }
+
+   if (delivered[frame])
+      results->repeated++;
+   delivered[frame] = 1;
+   results->frames++;
+
+   latency = (int64_t)vcos_getmicrosecs64() - sender->sent_time[frame];
+   if (latency < 0)
+      latency = 0;
+   results->latency += latency;
+   if ((uint64_t)latency > results->max_latency)
+      results->max_latency = latency;
+}
+
+static unsigned int bench(const SCENARIO_T *scenario, uint32_t frames)
+{
+   VC_CONTAINER_T *ctx;
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_RTP_STATS_T stats;
+   SENDER_T sender;
+   RESULTS_T results;
+   uint32_t drops, duplicates, lates, frame, size = 0;
+   int64_t frame_pts = 0;
+   uint16_t first_seq = 65000;        /* Wrap around early on */
+   bool in_frame = false;
+   unsigned int errors = 0;
+   uint64_t start;
+   char uri[256];
+
+   memset(&sender, 0, sizeof(sender));
+   memset(&results, 0, sizeof(results));
+   memset(delivered, 0, frames);
+   sender.frames = frames;
+   sender.ssrc = 0x12345678;
+   sender.timestamp_base = 0xFFF00000;  /* Likewise */
+   sender.sent_time = calloc(frames, sizeof(*sender.sent_time));
+   sender.schedule = schedule_packets(scenario, frames, first_seq, &sender.count,
+         &drops, &duplicates, &lates);
+   if (!sender.sent_time || !sender.schedule)
+      goto error;
+
+   snprintf(uri, sizeof(uri), "rtp://:%u?rtppt=96&mime-type=video/h264&sprop-parameter-sets=%s"
+         "&latency=%u&rtcp-interval=100", NET_PORT, SPROP_PARAMETER_SETS, LATENCY_MS);
+   ctx = vc_container_open_reader(uri, &status, 0, 0);
+   if (!ctx)
+   {
+      printf("%-14s failed to open %s (%i)\n", scenario->name, uri, status);
+      goto error;
+   }
+   if (ctx->tracks[0]->format->type->video.width != 320 ||
+       ctx->tracks[0]->format->type->video.height != 240)
+      errors++;
+   vc_container_control(ctx, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, READ_TIMEOUT_MS);
+   vc_container_control(ctx, VC_CONTAINER_CONTROL_IO_SET_READ_BUFFER_SIZE, READ_BUFFER_SIZE);
+
+   if (vcos_thread_create(&sender.thread, "rtp_sender", NULL, sender_thread, &sender) != VCOS_SUCCESS)
+   {
+      vc_container_close(ctx);
+      goto error;
+   }
+
+   start = 0;
+   for (;;)
+   {
+      memset(&packet, 0, sizeof(packet));
+      packet.data = frame_buffer + size;
+      packet.buffer_size = sizeof(frame_buffer) - size;
+      status = vc_container_read(ctx, &packet, 0);
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+      if (!start)
+      {
+         /* The reader needs a couple of packets in sequence before it starts */
+         start = vcos_getmicrosecs64();
+         if (packet.size >= 9)
+            results.first_frame = ((uint32_t)packet.data[5] << 24) | (packet.data[6] << 16) |
+                  (packet.data[7] << 8) | packet.data[8];
+      }
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_DISCONTINUITY)
+         results.discontinuities++;
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
+      {
+         /* A frame left open was broken by a loss, and the client has to drop it */
+         if (in_frame)
+            results.abandoned++;
+         memmove(frame_buffer, packet.data, packet.size);
+         size = 0;
+         frame_pts = packet.pts;
+         in_frame = true;
+      }
+      else if (!in_frame)
+      {
+         results.bad_frames++;
+         continue;
+      }
+      size += packet.size;
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_END)
+      {
+         check_frame(frame_buffer, size, frame_pts, &sender, &results);
+         size = 0;
+         in_frame = false;
+      }
+   }
+   results.elapsed = vcos_getmicrosecs64() - start;
+   results.elapsed = results.elapsed > READ_TIMEOUT_MS * 1000 ? results.elapsed - READ_TIMEOUT_MS * 1000 : 1;
+   sender.stop = true;
+   vcos_thread_join(&sender.thread, NULL);
+
+   if (status != VC_CONTAINER_ERROR_ABORTED)
+      errors++;
+   memset(&stats, 0, sizeof(stats));
+   if (vc_container_control(ctx, VC_CONTAINER_CONTROL_GET_RTP_STATS, 0, &stats) != VC_CONTAINER_SUCCESS)
+      errors++;
+   vc_container_close(ctx);
+
+   for (frame = results.first_frame; frame < frames; frame++)
+      if (!delivered[frame])
+         results.dropped++;
+
+   /* Only lost packets can cause frames to go missing, each one taking at most the frame
+    * after it too, and all the frames they damaged must go missing */
+   for (frame = results.first_frame; frame < frames; frame++)
+      if (damaged[frame] && delivered[frame])
+         errors++;
+   if (results.bad_frames || results.repeated || results.dropped > 2 * stats.lost ||
+       (!results.dropped) != (!results.discontinuities))
+      errors++;
+
+   /* Packets which were held back are either waited for, or counted as lost then late */
+   if (stats.lost - stats.late != drops || stats.late > lates || (lates && !stats.late) ||
+       stats.duplicates != duplicates || (scenario->reorder && !stats.reordered) ||
+       stats.expected != stats.received + drops)
+      errors++;
+
+   /* The sender's wallclock maps onto the timeline of the frames */
+   if (!stats.sender_reports || !stats.receiver_reports ||
+       llabs(stats.wallclock_time - WALLCLOCK_START - stats.wallclock_pts -
+             (int64_t)results.first_frame * FRAME_DURATION * 1000000 / 90000) > 10)
+      errors++;
+
+   printf("%-14s %8.0f packets/s, latency avg %5.2f ms max %6.2f ms, %u frames %u dropped "
+          "%u abandoned %u discontinuities, received %u lost %u late %u reordered %u "
+          "duplicates %u, jitter %u us, target %u us, SR %u RR %u%s\n", scenario->name,
+          results.elapsed ? (double)sender.count * 1000000 / results.elapsed : 0.0,
+          results.frames ? (double)results.latency / results.frames / 1000 : 0.0,
+          (double)results.max_latency / 1000, results.frames, results.dropped,
+          results.abandoned, results.discontinuities, stats.received, stats.lost, stats.late,
+          stats.reordered, stats.duplicates, stats.jitter, stats.target_latency,
+          stats.sender_reports, stats.receiver_reports, errors ? " FAILED" : "");
+
+   free(sender.schedule);
+   free(sender.sent_time);
+   return errors;
+
+ error:
+   free(sender.schedule);
+   free(sender.sent_time);
+   return 1;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   static const SCENARIO_T scenarios[] = {
+      /* name            reorder drop duplicate late */
+      {"clean",          0,      0,   0,        0},
+      {"reordering",     50,     0,   0,        0},
+      {"loss",           0,      10,  0,        0},
+      {"duplicates",     0,      0,   20,       0},
+      {"late packets",   0,      0,   0,        2},
+      {"all",            50,     10,  20,       2},
+   };
+   uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 3000;
+   unsigned int i, errors = 0;
+
+   vcos_init();
+   damaged = malloc(frames);
+   delivered = malloc(frames);
+   if (frames < 1000 || !damaged || !delivered)
+   {
+      printf("Usage:\n%s [<frames>]\n", argv[0]);
+      return 1;
+   }
+
+   for (i = 0; i < countof(scenarios); i++)
+      errors += bench(&scenarios[i], frames);
+
+   free(damaged);
+   free(delivered);
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
+
@@ -0,0 +1,206 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Start-up latency benchmark for the RTSP reader, e.g.
+ *    containers_rtsp_server 8554 20 &
+ *    containers_rtsp_bench rtsp://127.0.0.1:8554/stream
+ * opens the stream a number of times with RTP over UDP (rtsp://) and interleaved on the
+ * RTSP connection (rtspt://), and reports how long opening took and how long it was
+ * until the first packet of each track arrived. The server's delay stands in for the
+ * round trip time, so these show how many round trips starting a session costs. Against
+ * a server started with the "tcp" option, rtsp:// shows the cost of falling back from UDP.
+ * The video frames and audio samples are checked all the way through. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "interface/vcos/vcos.h"
+
+#define FRAMES_PER_RUN     30
+#define MAX_FRAME_SIZE     16384
+
+/* As sent by rtsp_server.c */
+#define FRAME_SIZE(n)            (3000 + ((n) % 7) * 700)
+#define FRAME_BYTE(n, offset)    ((uint8_t)((n) * 13 + (offset) * 7))
+
+typedef struct RESULTS_T
+{
+   uint64_t open, first[2];
+   unsigned int frames, samples, errors;
+} RESULTS_T;
+
+/*****************************************************************************/
+static unsigned int check_frame(const uint8_t *data, uint32_t size)
+{
+   uint32_t frame, i;
+
+   /* Start code, IDR slice NAL unit header, then the frame number */
+   if (size < 9 || data[0] || data[1] || data[2] || data[3] != 1 || data[4] != 0x65)
+      return 1;
+   frame = ((uint32_t)data[5] << 24) | (data[6] << 16) | (data[7] << 8) | data[8];
+   if (size != 5 + FRAME_SIZE(frame))
+      return 1;
+   for (i = 4; i < size - 5; i++)
+      if (data[5 + i] != FRAME_BYTE(frame, i))
+         return 1;
+
+   return 0;
+}
+
+static void run(const char *uri, RESULTS_T *results)
+{
+   static uint8_t frame_buffer[MAX_FRAME_SIZE];
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_T *ctx;
+   uint64_t start = vcos_getmicrosecs64();
+   uint32_t size = 0, sample = 0;
+   bool in_frame = false, have_sample = false;
+   unsigned int i;
+
+   memset(results, 0, sizeof(*results));
+   ctx = vc_container_open_reader(uri, &status, NULL, NULL);
+   results->open = vcos_getmicrosecs64() - start;
+   if (!ctx)
+   {
+      printf("failed to open %s (%i)\n", uri, status);
+      results->errors++;
+      return;
+   }
+   if (ctx->tracks_num != 2 || ctx->tracks[0]->format->es_type != VC_CONTAINER_ES_TYPE_VIDEO ||
+       ctx->tracks[1]->format->es_type != VC_CONTAINER_ES_TYPE_AUDIO)
+   {
+      results->errors++;
+      vc_container_close(ctx);
+      return;
+   }
+
+   while (results->frames < FRAMES_PER_RUN)
+   {
+      memset(&packet, 0, sizeof(packet));
+      packet.data = frame_buffer + size;
+      packet.buffer_size = sizeof(frame_buffer) - size;
+      status = vc_container_read(ctx, &packet, 0);
+      if (status != VC_CONTAINER_SUCCESS)
+      {
+         results->errors++;
+         break;
+      }
+      if (packet.track > 1)
+         continue;
+      if (!results->first[packet.track])
+         results->first[packet.track] = vcos_getmicrosecs64() - start;
+
+      if (packet.track == 1)
+      {
+         const uint16_t *samples = (const uint16_t *)packet.data;
+
+         /* Each sample counts up from the one before it */
+         for (i = 0; i < packet.size / 2; i++, sample++)
+         {
+            if (have_sample && samples[i] != (uint16_t)sample)
+               results->errors++;
+            sample = samples[i];
+            have_sample = true;
+         }
+         results->samples += packet.size / 2;
+         continue;
+      }
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_START)
+      {
+         if (in_frame)
+            results->errors++;
+         memmove(frame_buffer, packet.data, packet.size);
+         size = 0;
+         in_frame = true;
+      }
+      else if (!in_frame)
+         continue;
+      size += packet.size;
+
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_FRAME_END)
+      {
+         results->errors += check_frame(frame_buffer, size);
+         results->frames++;
+         size = 0;
+         in_frame = false;
+      }
+   }
+
+   vc_container_close(ctx);
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   static const char *schemes[] = { "rtsp", "rtspt" };
+   const char *path;
+   char uri[1024];
+   unsigned int runs = 5, errors = 0, i, j;
+
+   if (argc < 2 || !(path = strstr(argv[1], "://")))
+   {
+      printf("Usage:\n%s rtsp://<host>:<port>/<path> [<runs>]\n", argv[0]);
+      return 1;
+   }
+   if (argc > 2)
+      runs = strtoul(argv[2], NULL, 10);
+
+   vcos_init();
+
+   printf("%-8s %10s %14s %14s %8s %8s %8s\n", "scheme", "open (us)", "1st video (us)",
+          "1st audio (us)", "frames", "samples", "errors");
+   for (i = 0; i < countof(schemes); i++)
+   {
+      RESULTS_T results, total;
+
+      memset(&total, 0, sizeof(total));
+      snprintf(uri, sizeof(uri), "%s%s", schemes[i], path);
+      for (j = 0; j < runs; j++)
+      {
+         run(uri, &results);
+         total.open += results.open;
+         total.first[0] += results.first[0];
+         total.first[1] += results.first[1];
+         total.frames += results.frames;
+         total.samples += results.samples;
+         total.errors += results.errors;
+      }
+
+      printf("%-8s %10"PRIu64" %14"PRIu64" %14"PRIu64" %8u %8u %8u\n", schemes[i],
+             total.open / MAX(runs, 1), total.first[0] / MAX(runs, 1), total.first[1] / MAX(runs, 1),
+             total.frames, total.samples, total.errors);
+      errors += total.errors;
+   }
+
+   return errors ? 2 : 0;
+}
@@ -0,0 +1,553 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Minimal RTSP server for testing the RTSP reader on the loopback interface, e.g.
+ *    containers_rtsp_server 8554 20
+ * Any path describes the same two tracks: synthetic H.264 video (see rtsp_bench.c for
+ * the frame contents) and 16-bit mono audio counting up sample by sample. RTP is sent
+ * over UDP or interleaved on the RTSP connection, whichever the client asks for, unless
+ * the "tcp" option is given, in which case UDP is refused with status 461 like a server
+ * behind NAT would be set up to. Pipelined requests are handled in order, and each batch
+ * of requests can be delayed to simulate the round trip time of a real network. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <stdarg.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/net/net_sockets.h"
+
+#define MAX_CONNECTIONS    16
+#define MAX_REQUEST_LEN    8192
+#define TRACKS             2
+#define VIDEO_TRACK        0
+#define AUDIO_TRACK        1
+
+#define VIDEO_PAYLOAD_TYPE 96
+#define AUDIO_PAYLOAD_TYPE 11          /* L16 mono at 44.1kHz */
+#define FRAME_INTERVAL_MS  33
+#define FRAME_DURATION     3000        /* 90kHz ticks */
+#define AUDIO_INTERVAL_MS  10
+#define AUDIO_SAMPLES      441         /* in 10ms, to fit in a datagram */
+#define FRAGMENT_SIZE      1200
+#define MAX_PACKET_SIZE    (12 + 2 + FRAGMENT_SIZE)
+#define INTERLEAVED_HEADER_SIZE 4
+
+/* 320x240 baseline profile sequence and picture parameter sets */
+#define SPROP_PARAMETER_SETS  "Z0LAHtoFB+Q=,aM48gA=="
+
+/** Size of video frame number n, and its byte at the given offset */
+#define FRAME_SIZE(n)            (3000 + ((n) % 7) * 700)
+#define FRAME_BYTE(n, offset)    ((uint8_t)((n) * 13 + (offset) * 7))
+
+typedef struct TRACK_T
+{
+   bool set_up, playing, interleaved;
+   uint8_t channel;
+   VC_CONTAINER_NET_T *udp_sock;
+   uint16_t seq;
+   uint32_t timestamp_base, ssrc;
+   uint32_t unit;                      /* Next frame or audio sample */
+   uint64_t start;                     /* When playing started, in microseconds */
+} TRACK_T;
+
+typedef struct CONNECTION_T
+{
+   VCOS_THREAD_T thread, stream_thread;
+   VCOS_MUTEX_T lock;                  /* Serialises writes to the connection, and track state */
+   VC_CONTAINER_NET_T *sock;
+   unsigned int index;
+   bool started, streaming;
+   volatile bool done;
+   char request[MAX_REQUEST_LEN];
+   TRACK_T tracks[TRACKS];
+} CONNECTION_T;
+
+static uint32_t delay_ms;
+static bool tcp_only;
+static CONNECTION_T connections[MAX_CONNECTIONS];
+
+/*****************************************************************************/
+static vc_container_net_status_t net_control(VC_CONTAINER_NET_T *sock, vc_container_net_control_t operation, ...)
+{
+   vc_container_net_status_t status;
+   va_list args;
+
+   va_start(args, operation);
+   status = vc_container_net_control(sock, operation, args);
+   va_end(args);
+
+   return status;
+}
+
+static bool send_all(VC_CONTAINER_NET_T *sock, const void *buffer, size_t size)
+{
+   const char *ptr = buffer;
+
+   while (size)
+   {
+      size_t sent = vc_container_net_write(sock, ptr, size);
+      if (!sent)
+         return false;
+      ptr += sent;
+      size -= sent;
+   }
+
+   return true;
+}
+
+static void write_u32(uint8_t *ptr, uint32_t value)
+{
+   ptr[0] = (uint8_t)(value >> 24); ptr[1] = (uint8_t)(value >> 16);
+   ptr[2] = (uint8_t)(value >> 8); ptr[3] = (uint8_t)value;
+}
+
+/* Find a header of the request and copy its value, without leading spaces */
+static bool find_header(const char *request, const char *name, char *value, size_t size)
+{
+   size_t name_len = strlen(name);
+   const char *line, *end;
+
+   for (line = strchr(request, '\n'); line && line[1] != '\r' && line[1] != '\n'; line = strchr(line + 1, '\n'))
+   {
+      if (strncasecmp(line + 1, name, name_len) || line[1 + name_len] != ':')
+         continue;
+      line += 2 + name_len;
+      while (*line == ' ')
+         line++;
+      end = line + strcspn(line, "\r\n");
+      if ((size_t)(end - line) >= size)
+         return false;
+      memcpy(value, line, end - line);
+      value[end - line] = 0;
+      return true;
+   }
+
+   return false;
+}
+
+/*****************************************************************************/
+/* Send one RTP packet of a track, interleaved or over UDP. The packet is preceded by room
+ * for the interleaved frame header, so that it goes out in one write either way. Called
+ * with the lock held. */
+static bool send_packet(CONNECTION_T *conn, TRACK_T *track, uint8_t *frame, size_t size)
+{
+   if (track->interleaved)
+   {
+      frame[0] = '$';
+      frame[1] = track->channel;
+      frame[2] = (uint8_t)(size >> 8);
+      frame[3] = (uint8_t)size;
+      return send_all(conn->sock, frame, size + INTERLEAVED_HEADER_SIZE);
+   }
+
+   return vc_container_net_write(track->udp_sock, frame + INTERLEAVED_HEADER_SIZE, size) == size;
+}
+
+static void rtp_header(TRACK_T *track, uint8_t *packet, uint8_t payload_type, bool marker,
+      uint32_t timestamp)
+{
+   packet[0] = 0x80;
+   packet[1] = (uint8_t)((marker ? 0x80 : 0) | payload_type);
+   packet[2] = (uint8_t)(track->seq >> 8); packet[3] = (uint8_t)track->seq;
+   write_u32(packet + 4, track->timestamp_base + timestamp);
+   write_u32(packet + 8, track->ssrc);
+   track->seq++;
+}
+
+/* Send a video frame as a single NAL unit packet or FU-A fragments of an IDR slice,
+ * which starts with the frame number */
+static bool send_frame(CONNECTION_T *conn, TRACK_T *track)
+{
+   uint8_t buffer[INTERLEAVED_HEADER_SIZE + MAX_PACKET_SIZE], *packet = buffer + INTERLEAVED_HEADER_SIZE;
+   uint32_t frame = track->unit++, size = FRAME_SIZE(frame), offset, length, header, i;
+
+   for (offset = 0; offset < size; offset += length)
+   {
+      bool last;
+
+      length = size - offset > FRAGMENT_SIZE ? FRAGMENT_SIZE : size - offset;
+      last = offset + length == size;
+      rtp_header(track, packet, VIDEO_PAYLOAD_TYPE, last, frame * FRAME_DURATION);
+      packet[12] = 0x60 | 28;
+      packet[13] = (uint8_t)((!offset ? 0x80 : 0) | (last ? 0x40 : 0) | 5);
+      header = 14;
+      for (i = 0; i < length; i++)
+         packet[header + i] = FRAME_BYTE(frame, offset + i);
+      if (!offset)
+         write_u32(packet + header, frame);
+      if (!send_packet(conn, track, buffer, header + length))
+         return false;
+   }
+
+   return true;
+}
+
+/* Send 10ms of audio, each sample being its sample number */
+static bool send_audio(CONNECTION_T *conn, TRACK_T *track)
+{
+   uint8_t buffer[INTERLEAVED_HEADER_SIZE + MAX_PACKET_SIZE], *packet = buffer + INTERLEAVED_HEADER_SIZE;
+   unsigned int i;
+
+   rtp_header(track, packet, AUDIO_PAYLOAD_TYPE, false, track->unit);
+   for (i = 0; i < AUDIO_SAMPLES; i++, track->unit++)
+   {
+      packet[12 + 2 * i] = (uint8_t)(track->unit >> 8);
+      packet[13 + 2 * i] = (uint8_t)track->unit;
+   }
+
+   return send_packet(conn, track, buffer, 12 + 2 * AUDIO_SAMPLES);
+}
+
+/* Send the media of the tracks which are playing, in real time */
+static void *stream_thread(void *arg)
+{
+   CONNECTION_T *conn = arg;
+   bool ok = true;
+
+   while (ok && !conn->done)
+   {
+      uint64_t now = vcos_getmicrosecs64();
+      unsigned int i;
+
+      vcos_mutex_lock(&conn->lock);
+      for (i = 0; ok && i < TRACKS; i++)
+      {
+         TRACK_T *track = &conn->tracks[i];
+
+         if (!track->playing)
+            continue;
+         if (i == VIDEO_TRACK)
+         {
+            while (ok && (uint64_t)track->unit * FRAME_INTERVAL_MS * 1000 <= now - track->start)
+               ok = send_frame(conn, track);
+         }
+         else
+         {
+            while (ok && (uint64_t)track->unit / AUDIO_SAMPLES * AUDIO_INTERVAL_MS * 1000 <= now - track->start)
+               ok = send_audio(conn, track);
+         }
+      }
+      vcos_mutex_unlock(&conn->lock);
+
+      vcos_sleep(1);
+   }
+
+   return NULL;
+}
+
+/*****************************************************************************/
+/* Build the response to a request, returning its status code */
+static int handle_request(CONNECTION_T *conn, const char *request, char *response, size_t size)
+{
+   char method[16], uri[1024], value[256];
+   char *ptr = response, *end = response + size;
+   unsigned int cseq = 0, i;
+   TRACK_T *track = NULL;
+   const char *path_end;
+   int status = 200;
+
+   if (sscanf(request, "%15s %1023s RTSP/1.0", method, uri) != 2)
+      return 400;
+   if (find_header(request, "CSeq", value, sizeof(value)))
+      cseq = strtoul(value, NULL, 10);
+
+   /* Tracks are addressed by their control URI, or by session */
+   path_end = uri + strlen(uri);
+   if (!strcmp(path_end - 7, "/track1"))
+      track = &conn->tracks[VIDEO_TRACK];
+   else if (!strcmp(path_end - 7, "/track2"))
+      track = &conn->tracks[AUDIO_TRACK];
+
+   if (!strcmp(method, "DESCRIBE"))
+   {
+      char sdp[512];
+      int sdp_len = snprintf(sdp, sizeof(sdp),
+            "v=0\r\no=- %u 1 IN IP4 127.0.0.1\r\ns=Test\r\nt=0 0\r\n"
+            "m=video 0 RTP/AVP %u\r\na=rtpmap:%u H264/90000\r\n"
+            "a=fmtp:%u packetization-mode=1;sprop-parameter-sets=%s\r\na=control:track1\r\n"
+            "m=audio 0 RTP/AVP %u\r\na=control:track2\r\n",
+            conn->index, VIDEO_PAYLOAD_TYPE, VIDEO_PAYLOAD_TYPE, VIDEO_PAYLOAD_TYPE,
+            SPROP_PARAMETER_SETS, AUDIO_PAYLOAD_TYPE);
+
+      snprintf(ptr, end - ptr, "RTSP/1.0 200 OK\r\nCSeq: %u\r\nContent-Base: %s/\r\n"
+            "Content-Type: application/sdp\r\nContent-Length: %d\r\n\r\n%s", cseq, uri, sdp_len, sdp);
+      return status;
+   }
+
+   if (!strcmp(method, "SETUP") && track)
+   {
+      char transport[256], client[64];
+      const char *param;
+      unsigned int first;
+
+      if (!find_header(request, "Transport", transport, sizeof(transport)))
+         return 400;
+
+      vcos_mutex_lock(&conn->lock);
+      if (strstr(transport, "RTP/AVP/TCP") && (param = strstr(transport, "interleaved=")) &&
+          sscanf(param, "interleaved=%u", &first) == 1 && first < 255)
+      {
+         track->interleaved = true;
+         track->channel = (uint8_t)first;
+         snprintf(transport, sizeof(transport), "RTP/AVP/TCP;unicast;interleaved=%u-%u", first, first + 1);
+      }
+      else if (!tcp_only && (param = strstr(transport, "client_port=")) &&
+               sscanf(param, "client_port=%u", &first) == 1)
+      {
+         char port[16];
+
+         /* The reverse lookup fails without DNS, but the client is on the loopback interface */
+         if (vc_container_net_get_client_name(conn->sock, client, sizeof(client)) != VC_CONTAINER_NET_SUCCESS)
+            strcpy(client, "127.0.0.1");
+         snprintf(port, sizeof(port), "%u", first);
+         if (track->udp_sock)
+            vc_container_net_close(track->udp_sock);
+         track->udp_sock = vc_container_net_open(client, port, 0, NULL);
+         track->interleaved = false;
+         if (!track->udp_sock)
+            status = 500;
+         snprintf(transport, sizeof(transport), "RTP/AVP;unicast;client_port=%u-%u", first, first + 1);
+      }
+      else
+         status = 461;
+
+      track->set_up = status == 200;
+      vcos_mutex_unlock(&conn->lock);
+
+      if (status != 200)
+         snprintf(ptr, end - ptr, "RTSP/1.0 %d %s\r\nCSeq: %u\r\n\r\n", status,
+               status == 461 ? "Unsupported Transport" : "Internal Server Error", cseq);
+      else
+         snprintf(ptr, end - ptr, "RTSP/1.0 200 OK\r\nCSeq: %u\r\nSession: %08X\r\nTransport: %s\r\n\r\n",
+               cseq, conn->index << 8 | (unsigned int)(track - conn->tracks), transport);
+      return status;
+   }
+
+   /* Otherwise the track may be identified by its session */
+   if (find_header(request, "Session", value, sizeof(value)))
+   {
+      i = strtoul(value, NULL, 16) & 0xFF;
+      if (i < TRACKS)
+         track = &conn->tracks[i];
+   }
+
+   if (!strcmp(method, "PLAY") && track && track->set_up)
+   {
+      vcos_mutex_lock(&conn->lock);
+      if (!track->playing)
+      {
+         track->playing = true;
+         track->start = vcos_getmicrosecs64();
+      }
+      snprintf(ptr, end - ptr, "RTSP/1.0 200 OK\r\nCSeq: %u\r\nSession: %s\r\n"
+            "RTP-Info: url=%s;seq=%u;rtptime=%u\r\n\r\n", cseq, value, uri, track->seq,
+            track->timestamp_base + (track == &conn->tracks[VIDEO_TRACK] ? track->unit * FRAME_DURATION : track->unit));
+      if (!conn->streaming &&
+          vcos_thread_create(&conn->stream_thread, "rtsp_stream", NULL, stream_thread, conn) == VCOS_SUCCESS)
+         conn->streaming = true;
+      vcos_mutex_unlock(&conn->lock);
+      return status;
+   }
+
+   if (!strcmp(method, "TEARDOWN") && track)
+   {
+      vcos_mutex_lock(&conn->lock);
+      track->playing = track->set_up = false;
+      vcos_mutex_unlock(&conn->lock);
+      snprintf(ptr, end - ptr, "RTSP/1.0 200 OK\r\nCSeq: %u\r\n\r\n", cseq);
+      return status;
+   }
+
+   snprintf(ptr, end - ptr, "RTSP/1.0 454 Session Not Found\r\nCSeq: %u\r\n\r\n", cseq);
+   return 454;
+}
+
+/*****************************************************************************/
+static void *connection_thread(void *arg)
+{
+   CONNECTION_T *conn = arg;
+   char response[4096];
+   size_t length = 0, response_length;
+   unsigned int i;
+
+   for (i = 0; i < TRACKS; i++)
+   {
+      conn->tracks[i].seq = (uint16_t)(1000 * (i + 1) + conn->index);
+      conn->tracks[i].timestamp_base = 0x10000000 * (i + 1);
+      conn->tracks[i].ssrc = 0x5000 + conn->index * TRACKS + i;
+   }
+
+   while (1)
+   {
+      char *request = conn->request, *end;
+      size_t received;
+
+      /* Wait for at least one whole request, then answer all those received */
+      conn->request[length] = 0;
+      while (!strstr(conn->request, "\r\n\r\n"))
+      {
+         if (length >= sizeof(conn->request) - 1)
+            goto end;
+         received = vc_container_net_read(conn->sock, conn->request + length,
+                                          sizeof(conn->request) - 1 - length);
+         if (!received)
+            goto end;
+         length += received;
+         conn->request[length] = 0;
+      }
+
+      if (delay_ms)
+         vcos_sleep(delay_ms);
+
+      /* The responses go out together, as a pipelining server would send them */
+      response_length = 0;
+      while ((end = strstr(request, "\r\n\r\n")) != NULL &&
+             response_length < sizeof(response) - 1024)
+      {
+         end[2] = 0;
+         handle_request(conn, request, response + response_length, sizeof(response) - response_length);
+         response_length += strlen(response + response_length);
+         request = end + 4;
+      }
+
+      vcos_mutex_lock(&conn->lock);
+      if (!send_all(conn->sock, response, response_length))
+      {
+         vcos_mutex_unlock(&conn->lock);
+         goto end;
+      }
+      vcos_mutex_unlock(&conn->lock);
+
+      /* Keep whatever came after the requests */
+      length -= request - conn->request;
+      memmove(conn->request, request, length);
+   }
+
+end:
+   conn->done = true;
+   if (conn->streaming)
+      vcos_thread_join(&conn->stream_thread, NULL);
+   for (i = 0; i < TRACKS; i++)
+      if (conn->tracks[i].udp_sock)
+         vc_container_net_close(conn->tracks[i].udp_sock);
+   vc_container_net_close(conn->sock);
+   return NULL;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   VC_CONTAINER_NET_T *server_sock, *sock;
+   vc_container_net_status_t status;
+   unsigned int count = 0;
+   int i;
+
+   if (argc < 2)
+   {
+      printf("Usage:\n%s <port> [<delay ms> [tcp]]\n", argv[0]);
+      return 1;
+   }
+
+   vcos_init();
+#ifdef SIGPIPE
+   signal(SIGPIPE, SIG_IGN);
+#endif
+
+   if (argc > 2)
+      delay_ms = (uint32_t)strtoul(argv[2], NULL, 10);
+   if (argc > 3)
+      tcp_only = !strcmp(argv[3], "tcp");
+
+   server_sock = vc_container_net_open(NULL, argv[1], VC_CONTAINER_NET_OPEN_FLAG_STREAM, &status);
+   if (!server_sock)
+   {
+      printf("vc_container_net_open failed: %d\n", status);
+      return 2;
+   }
+
+   status = vc_container_net_listen(server_sock, MAX_CONNECTIONS);
+   if (status != VC_CONTAINER_NET_SUCCESS)
+   {
+      printf("vc_container_net_listen failed: %d\n", status);
+      vc_container_net_close(server_sock);
+      return 3;
+   }
+
+   printf("Serving RTSP on port %s%s\n", argv[1], tcp_only ? ", interleaved only" : "");
+   fflush(stdout);
+
+   while (vc_container_net_accept(server_sock, &sock) == VC_CONTAINER_NET_SUCCESS)
+   {
+      CONNECTION_T *conn = NULL;
+
+      /* Find a free slot, cleaning up after connections which have been closed */
+      for (i = 0; i < MAX_CONNECTIONS && !conn; i++)
+      {
+         if (connections[i].started && connections[i].done)
+         {
+            vcos_thread_join(&connections[i].thread, NULL);
+            vcos_mutex_delete(&connections[i].lock);
+            connections[i].started = false;
+         }
+         if (!connections[i].started)
+            conn = &connections[i];
+      }
+
+      if (!conn)
+      {
+         printf("Too many connections\n");
+         vc_container_net_close(sock);
+         continue;
+      }
+
+      /* Media interleaved on the connection must not wait for acknowledgements */
+      net_control(sock, VC_CONTAINER_NET_CONTROL_SET_NO_DELAY, 1);
+
+      memset(conn, 0, sizeof(*conn));
+      conn->sock = sock;
+      conn->index = count++ & 0xFFFFFF;
+      if (vcos_mutex_create(&conn->lock, "rtsp_connection") != VCOS_SUCCESS)
+      {
+         vc_container_net_close(sock);
+         continue;
+      }
+      conn->started = true;
+      if (vcos_thread_create(&conn->thread, "rtsp_connection", NULL, connection_thread, conn) != VCOS_SUCCESS)
+      {
+         conn->started = false;
+         vcos_mutex_delete(&conn->lock);
+         vc_container_net_close(sock);
+      }
+   }
+
+   vc_container_net_close(server_sock);
+   return 0;
+}
@@ -328,7 +328,12 @@ int main(int argc, char **argv)
    if(p_writer_ctx)
    {
       container_test_info(p_writer_ctx, false);
-      vc_container_close(p_writer_ctx);
+      status = vc_container_close(p_writer_ctx);
+      if(status != VC_CONTAINER_SUCCESS)
+      {
+         LOG_ERROR(0, "error closing file %s (%i)", psz_out, status);
+         retval = status;
+      }
    }
    if(dump_file) fclose(dump_file);
    free(buffer);
@@ -0,0 +1,584 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Throughput benchmark for the MPEG transport stream reader, e.g.
+ *    containers_ts_bench /tmp/bench 1
+ * writes synthetic transport streams of that many hours (25fps H.264 video carrying
+ * the program clock with an IDR picture every 12 frames, plus MPEG audio, with the
+ * timestamps wrapping around after a minute) into files starting with the given
+ * name then demuxes them, checking every frame is there with the right timestamp:
+ *  - a clean stream of 188 bytes packets, reading and skipping the data, and seeking,
+ *  - 192 and 204 bytes packets,
+ *  - a stream with junk between packets, which needs resyncing,
+ *  - a stream with missing packets, which the continuity counters must catch,
+ *  - the clean stream sent over udp:// and rtp:// on the loopback interface. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "interface/vcos/vcos.h"
+#include "containers/containers.h"
+#include "containers/core/containers_common.h"
+#include "containers/net/net_sockets.h"
+
+#define FRAME_DURATION     3600        /* 90kHz ticks, 25fps */
+#define GOP_SIZE           12
+#define AUDIO_DURATION     2160        /* 90kHz ticks, 24ms */
+#define AUDIO_SIZE         192
+#define PTS_DELAY          18000       /* 90kHz ticks */
+#define FIRST_PCR          ((INT64_C(1) << 33) - INT64_C(90000) * 60)
+
+#define PMT_PID            0x20
+#define VIDEO_PID          0x100
+#define AUDIO_PID          0x101
+
+#define JUNK_EVERY         500         /* packets */
+#define DROP_EVERY         1000        /* video packets */
+
+#define NUM_SEEKS          100
+
+#define NET_PORT           "15004"
+#define NET_SIZE           (64*1024*1024)
+#define NET_RATE           40          /* MB/s */
+#define NET_PACKETS        7           /* per datagram */
+
+static uint8_t buffer[4*1024*1024];
+
+typedef struct STREAM_T
+{
+   FILE *file;
+   unsigned int packet_size;
+   unsigned int junk_every, drop_every;
+   uint8_t cc[0x2000];
+   uint32_t packets, video_packets, seed;
+   uint32_t video_frames, audio_frames, keyframes, damaged_frames;
+   bool damaged;
+   int64_t size;
+} STREAM_T;
+
+/*****************************************************************************/
+static uint32_t next_random(uint32_t *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+/* Write one transport stream packet, with stuffing if there isn't enough payload */
+static unsigned int write_packet(STREAM_T *stream, unsigned int pid, bool unit_start,
+   int64_t pcr, bool random_access, const uint8_t *payload, unsigned int size)
+{
+   uint8_t packet[204], *p = packet;
+   unsigned int header = 4, adaptation = 0, i;
+
+   if (stream->packet_size == 192)
+   {
+      memset(p, 0, 4); /* arrival timestamp */
+      p += 4;
+   }
+
+   if (pcr >= 0 || random_access)
+      adaptation = 2 + (pcr >= 0 ? 6 : 0);
+   if (size > 184 - adaptation)
+      size = 184 - adaptation;
+   else if (size < 184 - adaptation)
+      adaptation = 184 - size;
+
+   p[0] = 0x47;
+   p[1] = (uint8_t)((unit_start ? 0x40 : 0) | (pid >> 8));
+   p[2] = (uint8_t)pid;
+   p[3] = (uint8_t)((adaptation ? 0x30 : 0x10) | (stream->cc[pid]++ & 0xF));
+   if (adaptation)
+   {
+      p[4] = (uint8_t)(adaptation - 1);
+      if (adaptation > 1)
+      {
+         p[5] = (uint8_t)((random_access ? 0x40 : 0) | (pcr >= 0 ? 0x10 : 0));
+         memset(p + 6, 0xFF, adaptation - 2);
+         if (pcr >= 0)
+         {
+            int64_t base = (pcr / 300) & ((INT64_C(1) << 33) - 1);
+            p[6] = (uint8_t)(base >> 25); p[7] = (uint8_t)(base >> 17);
+            p[8] = (uint8_t)(base >> 9); p[9] = (uint8_t)(base >> 1);
+            p[10] = (uint8_t)((base << 7) | 0x7E | ((pcr % 300) >> 8)); p[11] = (uint8_t)(pcr % 300);
+         }
+      }
+      header += adaptation;
+   }
+   memcpy(p + header, payload, size);
+   if (stream->packet_size == 204)
+      memset(p + 188, 0, 16); /* Reed-Solomon parity */
+
+   stream->packets++;
+   if (pid == VIDEO_PID && stream->drop_every && !unit_start &&
+       !(++stream->video_packets % stream->drop_every))
+   {
+      stream->damaged = true;
+      return size;
+   }
+   fwrite(packet, 1, stream->packet_size, stream->file);
+   stream->size += stream->packet_size;
+
+   if (stream->junk_every && !(stream->packets % stream->junk_every))
+   {
+      unsigned int junk = 1 + next_random(&stream->seed) % 200;
+      /* Without sync bytes, which could make it look like a packet */
+      for (i = 0; i < junk; i++)
+         if ((packet[i] = (uint8_t)next_random(&stream->seed)) == 0x47)
+            packet[i] = 0;
+      fwrite(packet, 1, junk, stream->file);
+      stream->size += junk;
+   }
+   return size;
+}
+
+static void write_pes(STREAM_T *stream, unsigned int pid, unsigned int stream_id, int64_t pcr,
+   bool random_access, int64_t pts, const uint8_t *payload, unsigned int size)
+{
+   uint8_t pes[14 + AUDIO_SIZE];
+   unsigned int length = stream_id == 0xE0 ? 0 : 8 + size, offset;
+   int64_t ts = pts & ((INT64_C(1) << 33) - 1);
+
+   pes[0] = 0; pes[1] = 0; pes[2] = 1; pes[3] = (uint8_t)stream_id;
+   pes[4] = (uint8_t)(length >> 8); pes[5] = (uint8_t)length;
+   pes[6] = 0x80; pes[7] = 0x80; pes[8] = 5;
+   pes[9] = (uint8_t)(0x21 | ((ts >> 29) & 0x0E));
+   pes[10] = (uint8_t)(ts >> 22); pes[11] = (uint8_t)(((ts >> 14) & 0xFE) | 1);
+   pes[12] = (uint8_t)(ts >> 7); pes[13] = (uint8_t)((ts << 1) | 1);
+
+   /* The PES header and the start of the payload go in the first packet */
+   offset = MIN(size, 184 - 14 - (pcr >= 0 ? 8 : random_access ? 2 : 0));
+   memcpy(pes + 14, payload, offset);
+   write_packet(stream, pid, true, pcr, random_access, pes, 14 + offset);
+   while (offset < size)
+      offset += write_packet(stream, pid, false, -1, false, payload + offset, size - offset);
+}
+
+static void write_psi(STREAM_T *stream)
+{
+   static const uint8_t pat[] = {0, 0x00, 0xB0, 13, 0x00, 0x01, 0xC1, 0, 0,
+                                 0x00, 0x01, 0xE0 | (PMT_PID >> 8), PMT_PID & 0xFF};
+   static const uint8_t pmt[] = {0, 0x02, 0xB0, 23, 0x00, 0x01, 0xC1, 0, 0,
+                                 0xE0 | (VIDEO_PID >> 8), VIDEO_PID & 0xFF, 0xF0, 0,
+                                 0x1B, 0xE0 | (VIDEO_PID >> 8), VIDEO_PID & 0xFF, 0xF0, 0,
+                                 0x03, 0xE0 | (AUDIO_PID >> 8), AUDIO_PID & 0xFF, 0xF0, 0};
+   uint8_t section[64];
+   uint32_t crc;
+   unsigned int i, j;
+
+   for (i = 0; i < 2; i++)
+   {
+      const uint8_t *table = i ? pmt : pat;
+      unsigned int size = i ? sizeof(pmt) : sizeof(pat);
+
+      memcpy(section, table, size);
+      for (crc = 0xFFFFFFFF, j = 1; j < size; j++)
+      {
+         unsigned int k;
+         crc ^= (uint32_t)section[j] << 24;
+         for (k = 0; k < 8; k++)
+            crc = (crc << 1) ^ (crc & 0x80000000 ? 0x04C11DB7 : 0);
+      }
+      section[size] = (uint8_t)(crc >> 24); section[size + 1] = (uint8_t)(crc >> 16);
+      section[size + 2] = (uint8_t)(crc >> 8); section[size + 3] = (uint8_t)crc;
+      write_packet(stream, i ? PMT_PID : 0, true, -1, false, section, size + 4);
+   }
+}
+
+/* Size of a video frame, which depends on whether its minute is a busy one */
+static unsigned int frame_size(uint32_t frame)
+{
+   uint32_t minute = frame / (25 * 60);
+   bool busy = ((minute * 2654435761u) >> 28) & 1;
+   bool intra = !(frame % GOP_SIZE);
+
+   if (busy)
+      return intra ? 60000 : 12000 + frame % 1500;
+   return intra ? 12000 : 600 + frame % 150;
+}
+
+static unsigned int write_frame_data(uint8_t *data, uint32_t frame)
+{
+   static const uint8_t aud[] = {0,0,0,1,0x09,0xF0};
+   static const uint8_t idr[] = {0,0,0,1,0x67,0x42,0xC0,0x1E, 0,0,0,1,0x68,0xCE,0x3C,0x80,
+                                 0,0,0,1,0x65,0x88};
+   static const uint8_t slice[] = {0,0,0,1,0x41,0x9A};
+   unsigned int size = 0;
+
+   memcpy(data, aud, sizeof(aud));
+   size += sizeof(aud);
+   if (!(frame % GOP_SIZE))
+   {
+      memcpy(data + size, idr, sizeof(idr));
+      size += sizeof(idr);
+   }
+   else
+   {
+      memcpy(data + size, slice, sizeof(slice));
+      size += sizeof(slice);
+   }
+   memset(data + size, 0xAA, frame_size(frame));
+   return size + frame_size(frame);
+}
+
+static int create_file(const char *uri, STREAM_T *stream, unsigned int seconds)
+{
+   int64_t video_time = 0, audio_time = 0, end = (int64_t)seconds * 90000;
+
+   stream->file = fopen(uri, "wb");
+   if (!stream->file)
+   {
+      printf("Opening <%s> for writing failed\n", uri);
+      return 2;
+   }
+
+   while (video_time < end || audio_time < end)
+   {
+      if (video_time <= audio_time)
+      {
+         unsigned int size = write_frame_data(buffer, stream->video_frames);
+         bool intra = !(stream->video_frames % GOP_SIZE);
+
+         if (intra)
+         {
+            write_psi(stream);
+            stream->keyframes++;
+         }
+         stream->damaged = false;
+         write_pes(stream, VIDEO_PID, 0xE0, (FIRST_PCR + video_time) * 300, intra,
+                   FIRST_PCR + video_time + PTS_DELAY, buffer, size);
+         stream->damaged_frames += stream->damaged;
+         video_time = (int64_t)++stream->video_frames * FRAME_DURATION;
+      }
+      else
+      {
+         memset(buffer, 0x55, AUDIO_SIZE);
+         write_pes(stream, AUDIO_PID, 0xC0, -1, false, FIRST_PCR + audio_time + PTS_DELAY,
+                   buffer, AUDIO_SIZE);
+         audio_time = (int64_t)++stream->audio_frames * AUDIO_DURATION;
+      }
+   }
+
+   fclose(stream->file);
+   return 0;
+}
+
+/*****************************************************************************/
+typedef struct RESULTS_T
+{
+   uint32_t frames[2], keyframes, discontinuities, bad_frames;
+   int64_t bytes;
+} RESULTS_T;
+
+static VC_CONTAINER_STATUS_T demux(const char *uri, RESULTS_T *results, uint32_t flags, bool live,
+   uint64_t *p_elapsed)
+{
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx;
+   uint64_t time = vcos_getmicrosecs64();
+   int64_t first_pts = VC_CONTAINER_TIME_UNKNOWN;
+
+   memset(results, 0, sizeof(*results));
+   ctx = vc_container_open_reader(uri, &status, 0, 0);
+   if (!ctx)
+   {
+      printf("Opening <%s> failed: %d\n", uri, status);
+      return status;
+   }
+   if (live)
+   {
+      vc_container_control(ctx, VC_CONTAINER_CONTROL_IO_SET_READ_TIMEOUT_MS, 500);
+      vc_container_control(ctx, VC_CONTAINER_CONTROL_IO_SET_READ_BUFFER_SIZE, 4*1024*1024);
+      time = vcos_getmicrosecs64();
+   }
+
+   memset(&packet, 0, sizeof(packet));
+   while (1)
+   {
+      packet.data = buffer;
+      packet.buffer_size = sizeof(buffer);
+      status = vc_container_read(ctx, &packet, flags);
+      if (status != VC_CONTAINER_SUCCESS)
+         break;
+      if (packet.track > 1)
+         continue;
+      results->bytes += packet.size;
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_DISCONTINUITY)
+         results->discontinuities++;
+      if (packet.track != 0)
+      {
+         results->frames[1]++;
+         continue;
+      }
+
+      /* Video frames come whole and with the right timestamp */
+      if (first_pts == VC_CONTAINER_TIME_UNKNOWN && packet.pts != VC_CONTAINER_TIME_UNKNOWN)
+         first_pts = packet.pts - (live ? 0 : INT64_C(40000) * results->frames[0]);
+      if ((packet.flags & (VC_CONTAINER_PACKET_FLAG_FRAME_START | VC_CONTAINER_PACKET_FLAG_FRAME_END)) !=
+          (VC_CONTAINER_PACKET_FLAG_FRAME_START | VC_CONTAINER_PACKET_FLAG_FRAME_END) ||
+          packet.pts != first_pts + INT64_C(40000) * results->frames[0] ||
+          (!(flags & VC_CONTAINER_READ_FLAG_SKIP) && (buffer[4] != 0x09 || buffer[0] || buffer[2])))
+      {
+         if (!results->bad_frames++ && !live)
+            printf("Wrong frame %u (flags %x, pts %"PRId64")\n", results->frames[0], packet.flags, packet.pts);
+         if (live)
+            first_pts = packet.pts - INT64_C(40000) * results->frames[0];
+      }
+      if (packet.flags & VC_CONTAINER_PACKET_FLAG_KEYFRAME)
+         results->keyframes++;
+      results->frames[0]++;
+   }
+
+   *p_elapsed = vcos_getmicrosecs64() - time;
+   if (!live && first_pts != PTS_DELAY * 1000 / 90)
+   {
+      printf("Wrong first timestamp %"PRId64"\n", first_pts);
+      results->bad_frames++;
+   }
+   vc_container_close(ctx);
+   return status;
+}
+
+static unsigned int check(const char *name, const RESULTS_T *results, const STREAM_T *stream,
+   uint64_t elapsed, int64_t size)
+{
+   unsigned int errors = results->bad_frames;
+
+   if (results->frames[0] != stream->video_frames || results->frames[1] != stream->audio_frames ||
+       results->keyframes != stream->keyframes)
+      errors++;
+   if (stream->damaged_frames && results->discontinuities != stream->damaged_frames)
+      errors++;
+   if (!stream->damaged_frames && !stream->junk_every && results->discontinuities)
+      errors++;
+   if (stream->junk_every && !results->discontinuities)
+      errors++;
+
+   printf("%-22s %8.1f MB/s %7"PRIu64" ms  %u/%u video %u/%u audio frames, %u keyframes, "
+          "%u discontinuities%s\n", name, (double)size / elapsed, elapsed / 1000,
+          results->frames[0], stream->video_frames, results->frames[1], stream->audio_frames,
+          results->keyframes, results->discontinuities, errors ? " FAILED" : "");
+   return errors;
+}
+
+/*****************************************************************************/
+/* Seek to random times and check the reader reports the time of the first packet */
+static unsigned int bench_seek(const char *uri, const STREAM_T *stream)
+{
+   VC_CONTAINER_PACKET_T packet;
+   VC_CONTAINER_STATUS_T status;
+   VC_CONTAINER_T *ctx;
+   uint64_t elapsed = 0, error = 0, time;
+   unsigned int i, errors = 0;
+   uint32_t seed = 1;
+   int64_t target, position;
+
+   ctx = vc_container_open_reader(uri, &status, 0, 0);
+   if (!ctx || !(ctx->capabilities & VC_CONTAINER_CAPS_CAN_SEEK) ||
+       ctx->duration < INT64_C(40000) * (stream->video_frames - 1))
+   {
+      printf("Opening <%s> failed or it can't seek\n", uri);
+      if (ctx)
+         vc_container_close(ctx);
+      return 1;
+   }
+
+   memset(&packet, 0, sizeof(packet));
+   for (i = 0; i < NUM_SEEKS; i++)
+   {
+      position = target = (int64_t)(next_random(&seed) % (uint64_t)(ctx->duration / 1000)) * 1000;
+      time = vcos_getmicrosecs64();
+      status = vc_container_seek(ctx, &position, VC_CONTAINER_SEEK_MODE_TIME, 0);
+      elapsed += vcos_getmicrosecs64() - time;
+      error += (uint64_t)(position > target ? position - target : target - position);
+
+      packet.data = buffer;
+      packet.buffer_size = sizeof(buffer);
+      if (status != VC_CONTAINER_SUCCESS ||
+          vc_container_read(ctx, &packet, 0) != VC_CONTAINER_SUCCESS || packet.pts != position ||
+          (position > target ? position - target : target - position) > 1000000)
+      {
+         if (!errors++)
+            printf("Seeking to %"PRId64" failed (%"PRId64", pts %"PRId64")\n", target, position, packet.pts);
+      }
+   }
+   vc_container_close(ctx);
+
+   printf("%-22s %8"PRIu64" us per seek, error avg %"PRIu64" us%s\n", "seek", elapsed / NUM_SEEKS,
+          error / NUM_SEEKS, errors ? " FAILED" : "");
+   return errors;
+}
+
+/*****************************************************************************/
+typedef struct SENDER_T
+{
+   const char *uri;
+   bool rtp;
+   VCOS_THREAD_T thread;
+   int64_t sent;
+} SENDER_T;
+
+/* Send the start of a file in datagrams of a few packets, at a fixed rate */
+static void *sender_thread(void *arg)
+{
+   SENDER_T *sender = arg;
+   uint8_t datagram[12 + NET_PACKETS * 188];
+   unsigned int header = sender->rtp ? 12 : 0;
+   uint16_t sequence = 0;
+   uint64_t start;
+   VC_CONTAINER_NET_T *sock;
+   FILE *file;
+   size_t size;
+
+   sock = vc_container_net_open("127.0.0.1", NET_PORT, 0, NULL);
+   file = fopen(sender->uri, "rb");
+   if (!sock || !file)
+      goto end;
+
+   vcos_sleep(100); /* Give the reader time to start listening */
+   start = vcos_getmicrosecs64();
+   while (sender->sent < NET_SIZE &&
+          (size = fread(datagram + header, 1, NET_PACKETS * 188, file)) > 0)
+   {
+      if (sender->rtp)
+      {
+         memset(datagram, 0, 12);
+         datagram[0] = 0x80; datagram[1] = 33; /* MP2T */
+         datagram[2] = (uint8_t)(sequence >> 8); datagram[3] = (uint8_t)sequence++;
+      }
+      if (!vc_container_net_write(sock, datagram, header + size))
+         break;
+      sender->sent += size;
+      while ((int64_t)(vcos_getmicrosecs64() - start) * NET_RATE < sender->sent)
+         vcos_sleep(1);
+   }
+
+ end:
+   if (file)
+      fclose(file);
+   if (sock)
+      vc_container_net_close(sock);
+   return NULL;
+}
+
+static unsigned int bench_net(const char *name, const char *uri, bool rtp)
+{
+   SENDER_T sender;
+   RESULTS_T results;
+   uint64_t elapsed;
+   char net_uri[64];
+
+   memset(&sender, 0, sizeof(sender));
+   sender.uri = uri;
+   sender.rtp = rtp;
+   if (vcos_thread_create(&sender.thread, "ts_sender", NULL, sender_thread, &sender) != VCOS_SUCCESS)
+      return 1;
+
+   snprintf(net_uri, sizeof(net_uri), "%s://:%s?container=ts", rtp ? "rtp" : "udp", NET_PORT);
+   demux(net_uri, &results, 0, true, &elapsed);
+   vcos_thread_join(&sender.thread, NULL);
+
+   /* Datagrams can get lost, but it's the reader's job to notice */
+   elapsed = elapsed > 500000 ? elapsed - 500000 : 1; /* read timeout */
+   printf("%-22s %8.1f MB/s %7"PRIu64" ms  %u video %u audio frames, %u discontinuities, "
+          "%u damaged frames\n", name, (double)sender.sent / elapsed, elapsed / 1000,
+          results.frames[0], results.frames[1], results.discontinuities, results.bad_frames);
+   return results.frames[0] ? 0 : 1;
+}
+
+/*****************************************************************************/
+int main(int argc, char **argv)
+{
+   static const struct {
+      const char *name;
+      unsigned int packet_size, junk_every, drop_every;
+   } variants[] = {
+      {"188 bytes packets", 188, 0, 0},
+      {"192 bytes packets", 192, 0, 0},
+      {"204 bytes packets", 204, 0, 0},
+      {"resync (junk)", 188, JUNK_EVERY, 0},
+      {"continuity (drops)", 188, 0, DROP_EVERY},
+   };
+   static STREAM_T streams[countof(variants)];
+   RESULTS_T results;
+   uint64_t elapsed;
+   unsigned int i, seconds, errors = 0;
+   char uri[256];
+
+   if (argc < 2)
+   {
+      printf("Usage:\n%s <file name prefix> [<hours>]\n", argv[0]);
+      return 1;
+   }
+
+   vcos_init();
+   seconds = argc > 2 ? (unsigned int)(strtod(argv[2], NULL) * 3600) : 600;
+
+   for (i = 0; i < countof(variants); i++)
+   {
+      STREAM_T *stream = &streams[i];
+
+      stream->packet_size = variants[i].packet_size;
+      stream->junk_every = variants[i].junk_every;
+      stream->drop_every = variants[i].drop_every;
+      stream->seed = 1;
+      snprintf(uri, sizeof(uri), "%s_%u.ts", argv[1], i);
+      elapsed = vcos_getmicrosecs64();
+      if (create_file(uri, stream, seconds))
+         return 2;
+      printf("%-22s %8"PRIu64" ms (%"PRId64" bytes)\n", "create", (vcos_getmicrosecs64() - elapsed) / 1000,
+             stream->size);
+
+      if (demux(uri, &results, 0, false, &elapsed) != VC_CONTAINER_ERROR_EOS)
+         errors++;
+      errors += check(variants[i].name, &results, stream, elapsed, stream->size);
+
+      /* Without copying the data out */
+      if (!i)
+      {
+         if (demux(uri, &results, VC_CONTAINER_READ_FLAG_SKIP, false, &elapsed) != VC_CONTAINER_ERROR_EOS)
+            errors++;
+         errors += check("188 bytes (skip)", &results, stream, elapsed, stream->size);
+         errors += bench_seek(uri, stream);
+      }
+   }
+
+   snprintf(uri, sizeof(uri), "%s_0.ts", argv[1]);
+   errors += bench_net("udp loopback", uri, false);
+   errors += bench_net("rtp loopback", uri, true);
+
+   for (i = 0; i < countof(variants); i++)
+   {
+      snprintf(uri, sizeof(uri), "%s_%u.ts", argv[1], i);
+      remove(uri);
+   }
+
+   printf("%u errors\n", errors);
+   return errors ? 3 : 0;
+}
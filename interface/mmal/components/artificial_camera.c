@@ -138,15 +138,19 @@ static MMAL_STATUS_T artificial_camera_port_enable(MMAL_PORT_T *port, MMAL_PORT_
 /** Flush a port */
 static MMAL_STATUS_T artificial_camera_port_flush(MMAL_PORT_T *port)
 {
-   MMAL_PARAM_UNUSED(port);
+   MMAL_BUFFER_HEADER_T *buffer;
+
+   /* Send back the buffers we are holding on to */
+   while ((buffer = mmal_queue_get(port->priv->module->queue)) != NULL)
+      mmal_port_buffer_header_callback(port, buffer);
    return MMAL_SUCCESS;
 }
 
 /** Disable processing on a port */
 static MMAL_STATUS_T artificial_camera_port_disable(MMAL_PORT_T *port)
 {
-   MMAL_PARAM_UNUSED(port);
-   return MMAL_SUCCESS;
+   /* We just need to flush our internal queue */
+   return artificial_camera_port_flush(port);
 }
 
 /** Send a buffer header to a port */
@@ -158,6 +162,19 @@ static MMAL_STATUS_T artificial_camera_port_send(MMAL_PORT_T *port, MMAL_BUFFER_
    return MMAL_SUCCESS;
 }
 
+/** Send an array of buffer headers to a port */
+static MMAL_STATUS_T artificial_camera_port_send_batch(MMAL_PORT_T *port,
+   MMAL_BUFFER_HEADER_T **buffers, unsigned int num)
+{
+   unsigned int i;
+
+   /* Queue all the buffers and only wake up the processing thread once */
+   for (i = 0; i < num; i++)
+      mmal_queue_put(port->priv->module->queue, buffers[i]);
+   mmal_component_action_trigger(port->component);
+   return MMAL_SUCCESS;
+}
+
 /** Set format on a port */
 static MMAL_STATUS_T artificial_camera_port_format_commit(MMAL_PORT_T *port)
 {
@@ -252,7 +269,7 @@ static MMAL_STATUS_T mmal_component_create_artificial_camera(const char *name, M
       component->output[i]->priv->pf_disable = artificial_camera_port_disable;
       component->output[i]->priv->pf_flush = artificial_camera_port_flush;
       component->output[i]->priv->pf_send = artificial_camera_port_send;
-      component->output[i]->priv->pf_send = artificial_camera_port_send;
+      component->output[i]->priv->pf_send_batch = artificial_camera_port_send_batch;
       component->output[i]->priv->pf_set_format = artificial_camera_port_format_commit;
       component->output[i]->priv->pf_parameter_set = artificial_port_parameter_set;
       component->output[i]->priv->pf_parameter_get = artificial_port_parameter_get;
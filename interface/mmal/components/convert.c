@@ -0,0 +1,556 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __unix__
+# include <unistd.h>
+#endif
+#include "mmal.h"
+#include "core/mmal_component_private.h"
+#include "core/mmal_port_private.h"
+#include "util/mmal_util.h"
+#include "util/mmal_util_convert.h"
+#include "mmal_logging.h"
+
+/** Environment variable overriding the number of threads used for a conversion */
+#define CONVERT_THREADS_ENV "MMAL_CONVERT_THREADS"
+/** Maximum number of threads used for a conversion */
+#define CONVERT_THREADS_MAX 8
+/** Number of rows making up a tile. Tiles are the unit of work given to threads. */
+#define CONVERT_TILE_ROWS 16
+
+/*****************************************************************************/
+struct MMAL_COMPONENT_MODULE_T;
+
+typedef struct CONVERT_WORKER_T
+{
+   struct MMAL_COMPONENT_MODULE_T *module;
+   VCOS_THREAD_T thread;
+   VCOS_SEMAPHORE_T start; /**< signalled when a frame is ready to be converted */
+
+} CONVERT_WORKER_T;
+
+typedef struct MMAL_COMPONENT_MODULE_T
+{
+   MMAL_STATUS_T status; /**< current status of the component */
+   const MMAL_CONVERT_KERNEL_T *kernel; /**< kernel for the currently configured formats */
+
+   /* Frame being converted */
+   struct {
+      MMAL_CONVERT_PICTURE_T src;
+      MMAL_CONVERT_PICTURE_T dst;
+      uint32_t width;
+      uint32_t height;
+      uint32_t tiles;
+      uint32_t next_tile; /**< index of the next tile to convert, accessed atomically */
+   } frame;
+
+   unsigned int workers_num;
+   CONVERT_WORKER_T workers[CONVERT_THREADS_MAX];
+   VCOS_SEMAPHORE_T done; /**< signalled by workers when they run out of tiles */
+   MMAL_BOOL_T quit;
+
+} MMAL_COMPONENT_MODULE_T;
+
+typedef struct MMAL_PORT_MODULE_T
+{
+   MMAL_QUEUE_T *queue; /**< queue for the buffers sent to the ports */
+   MMAL_BOOL_T needs_configuring; /**< port is waiting for a format commit */
+
+} MMAL_PORT_MODULE_T;
+
+/*****************************************************************************/
+
+/** Size of the visible area of a picture */
+static void convert_visible_size(const MMAL_ES_FORMAT_T *format, uint32_t *width, uint32_t *height)
+{
+   const MMAL_VIDEO_FORMAT_T *video = &format->es->video;
+
+   *width = video->crop.width ? (uint32_t)video->crop.width : video->width;
+   *height = video->crop.height ? (uint32_t)video->crop.height : video->height;
+}
+
+/** Convert tiles of the current frame until there are none left */
+static void convert_do_tiles(MMAL_COMPONENT_MODULE_T *module)
+{
+   uint32_t tile;
+
+   while ((tile = __atomic_fetch_add(&module->frame.next_tile, 1, __ATOMIC_RELAXED)) < module->frame.tiles)
+   {
+      uint32_t y_start = tile * CONVERT_TILE_ROWS;
+      uint32_t y_end = MMAL_MIN(y_start + CONVERT_TILE_ROWS, module->frame.height);
+
+      mmal_convert_kernel_run(module->kernel, &module->frame.src, &module->frame.dst,
+                              module->frame.width, y_start, y_end);
+   }
+}
+
+static void *convert_worker_thread(void *arg)
+{
+   CONVERT_WORKER_T *worker = arg;
+   MMAL_COMPONENT_MODULE_T *module = worker->module;
+
+   while (1)
+   {
+      vcos_semaphore_wait(&worker->start);
+      if (module->quit)
+         break;
+      convert_do_tiles(module);
+      vcos_semaphore_post(&module->done);
+   }
+   return NULL;
+}
+
+/** Convert the current frame, sharing the tiles between the workers and the calling thread */
+static void convert_do_frame(MMAL_COMPONENT_MODULE_T *module)
+{
+   unsigned int i, workers;
+
+   module->frame.tiles = (module->frame.height + CONVERT_TILE_ROWS - 1) / CONVERT_TILE_ROWS;
+   module->frame.next_tile = 0;
+
+   /* Small frames aren't worth waking up all the workers */
+   workers = MMAL_MIN(module->workers_num, module->frame.tiles - 1);
+   for (i = 0; i < workers; i++)
+      vcos_semaphore_post(&module->workers[i].start);
+
+   convert_do_tiles(module);
+
+   for (i = 0; i < workers; i++)
+      vcos_semaphore_wait(&module->done);
+}
+
+/** Actual processing function */
+static MMAL_BOOL_T convert_do_processing(MMAL_COMPONENT_T *component)
+{
+   MMAL_COMPONENT_MODULE_T *module = component->priv->module;
+   MMAL_PORT_T *port_in = component->input[0];
+   MMAL_PORT_T *port_out = component->output[0];
+   MMAL_BUFFER_HEADER_T *in, *out;
+   uint32_t size;
+
+   if (port_out->priv->module->needs_configuring)
+      return 0;
+
+   in = mmal_queue_get(port_in->priv->module->queue);
+   if (!in)
+      return 0;
+
+   /* Handle event buffers */
+   if (in->cmd)
+   {
+      MMAL_EVENT_FORMAT_CHANGED_T *event = mmal_event_format_changed_get(in);
+      if (event)
+      {
+         module->status = mmal_format_full_copy(port_in->format, event->format);
+         if (module->status == MMAL_SUCCESS)
+            module->status = port_in->priv->pf_set_format(port_in);
+         if (module->status != MMAL_SUCCESS)
+         {
+            LOG_ERROR("format not set on port %s %p (%i)", port_in->name, port_in, module->status);
+            if (mmal_event_error_send(component, module->status) != MMAL_SUCCESS)
+               LOG_ERROR("unable to send an error event buffer");
+         }
+      }
+      else
+      {
+         LOG_ERROR("discarding event %i on port %s %p", (int)in->cmd, port_in->name, port_in);
+      }
+
+      in->length = 0;
+      mmal_port_buffer_header_callback(port_in, in);
+      return 1;
+   }
+
+   /* Don't do anything if we've already seen an error */
+   if (module->status != MMAL_SUCCESS)
+   {
+      mmal_queue_put_back(port_in->priv->module->queue, in);
+      return 0;
+   }
+
+   out = mmal_queue_get(port_out->priv->module->queue);
+   if (!out)
+   {
+      mmal_queue_put_back(port_in->priv->module->queue, in);
+      return 0;
+   }
+
+   /* Sanity check the buffers are big enough */
+   size = mmal_convert_frame_size(port_out->format);
+   if (out->alloc_size < size || in->length < mmal_convert_frame_size(port_in->format))
+   {
+      LOG_ERROR("buffers too small (in %u/%u, out %u/%u)", in->length,
+                mmal_convert_frame_size(port_in->format), out->alloc_size, size);
+      module->status = MMAL_EINVAL;
+      mmal_queue_put_back(port_in->priv->module->queue, in);
+      mmal_queue_put_back(port_out->priv->module->queue, out);
+      if (mmal_event_error_send(component, module->status) != MMAL_SUCCESS)
+         LOG_ERROR("unable to send an error event buffer");
+      return 0;
+   }
+
+   mmal_buffer_header_mem_lock(out);
+   mmal_buffer_header_mem_lock(in);
+   if (mmal_convert_picture_setup(&module->frame.src, port_in->format, in->data + in->offset) == MMAL_SUCCESS &&
+       mmal_convert_picture_setup(&module->frame.dst, port_out->format, out->data) == MMAL_SUCCESS)
+   {
+      convert_visible_size(port_in->format, &module->frame.width, &module->frame.height);
+      convert_do_frame(module);
+   }
+   mmal_buffer_header_mem_unlock(in);
+   mmal_buffer_header_mem_unlock(out);
+   out->length     = size;
+   out->offset     = 0;
+   out->flags      = in->flags;
+   out->pts        = in->pts;
+   out->dts        = in->dts;
+   *out->type      = *in->type;
+
+   /* Send buffers back */
+   in->length = 0;
+   mmal_port_buffer_header_callback(port_in, in);
+   mmal_port_buffer_header_callback(port_out, out);
+   return 1;
+}
+
+/*****************************************************************************/
+static void convert_do_processing_loop(MMAL_COMPONENT_T *component)
+{
+   while (convert_do_processing(component));
+}
+
+/** Stop and destroy the worker threads */
+static void convert_workers_destroy(MMAL_COMPONENT_MODULE_T *module)
+{
+   unsigned int i;
+
+   module->quit = MMAL_TRUE;
+   for (i = 0; i < module->workers_num; i++)
+   {
+      vcos_semaphore_post(&module->workers[i].start);
+      vcos_thread_join(&module->workers[i].thread, NULL);
+      vcos_semaphore_delete(&module->workers[i].start);
+   }
+   module->workers_num = 0;
+   vcos_semaphore_delete(&module->done);
+}
+
+/** Number of threads to use for a conversion, including the calling thread */
+static unsigned int convert_threads_num(void)
+{
+   const char *env = getenv(CONVERT_THREADS_ENV);
+   long threads = 1;
+
+   if (env)
+      threads = atoi(env);
+#ifdef _SC_NPROCESSORS_ONLN
+   else
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+   return threads < 1 ? 1 : threads > CONVERT_THREADS_MAX ? CONVERT_THREADS_MAX : threads;
+}
+
+/** Create the worker threads helping the action thread */
+static MMAL_STATUS_T convert_workers_create(MMAL_COMPONENT_MODULE_T *module)
+{
+   unsigned int i, threads = convert_threads_num();
+
+   if (vcos_semaphore_create(&module->done, "mmal convert done", 0) != VCOS_SUCCESS)
+      return MMAL_ENOMEM;
+
+   for (i = 0; i + 1 < threads; i++)
+   {
+      CONVERT_WORKER_T *worker = &module->workers[i];
+
+      worker->module = module;
+      if (vcos_semaphore_create(&worker->start, "mmal convert start", 0) != VCOS_SUCCESS)
+         break;
+      if (vcos_thread_create(&worker->thread, "mmal convert", NULL,
+                             convert_worker_thread, worker) != VCOS_SUCCESS)
+      {
+         vcos_semaphore_delete(&worker->start);
+         break;
+      }
+      module->workers_num++;
+   }
+
+   if (module->workers_num + 1 < threads)
+      LOG_ERROR("only %u out of %u worker threads created", module->workers_num, threads - 1);
+   LOG_DEBUG("using %u threads and %s kernels", module->workers_num + 1,
+             mmal_convert_isa_to_string(mmal_convert_isa_best()));
+   return MMAL_SUCCESS;
+}
+
+/** Destroy a previously created component */
+static MMAL_STATUS_T convert_component_destroy(MMAL_COMPONENT_T *component)
+{
+   MMAL_COMPONENT_MODULE_T *module = component->priv->module;
+   unsigned int i;
+
+   for(i = 0; i < component->input_num; i++)
+      if(component->input[i]->priv->module->queue)
+         mmal_queue_destroy(component->input[i]->priv->module->queue);
+   if(component->input_num)
+      mmal_ports_free(component->input, component->input_num);
+
+   for(i = 0; i < component->output_num; i++)
+      if(component->output[i]->priv->module->queue)
+         mmal_queue_destroy(component->output[i]->priv->module->queue);
+   if(component->output_num)
+      mmal_ports_free(component->output, component->output_num);
+
+   if (module->status != MMAL_ENOMEM)
+      convert_workers_destroy(module);
+
+   vcos_free(module);
+   return MMAL_SUCCESS;
+}
+
+/** Enable processing on a port */
+static MMAL_STATUS_T convert_port_enable(MMAL_PORT_T *port, MMAL_PORT_BH_CB_T cb)
+{
+   MMAL_PARAM_UNUSED(cb);
+
+   /* We need to propagate the buffer requirements when the input port is
+    * enabled */
+   if (port->type == MMAL_PORT_TYPE_INPUT)
+      return port->priv->pf_set_format(port);
+
+   return MMAL_SUCCESS;
+}
+
+/** Flush a port */
+static MMAL_STATUS_T convert_port_flush(MMAL_PORT_T *port)
+{
+   MMAL_PORT_MODULE_T *port_module = port->priv->module;
+   MMAL_BUFFER_HEADER_T *buffer;
+
+   /* Flush buffers that our component is holding on to */
+   buffer = mmal_queue_get(port_module->queue);
+   while(buffer)
+   {
+      mmal_port_buffer_header_callback(port, buffer);
+      buffer = mmal_queue_get(port_module->queue);
+   }
+
+   return MMAL_SUCCESS;
+}
+
+/** Disable processing on a port */
+static MMAL_STATUS_T convert_port_disable(MMAL_PORT_T *port)
+{
+   /* We just need to flush our internal queue */
+   return convert_port_flush(port);
+}
+
+/** Send a buffer header to a port */
+static MMAL_STATUS_T convert_port_send(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   mmal_queue_put(port->priv->module->queue, buffer);
+   mmal_component_action_trigger(port->component);
+   return MMAL_SUCCESS;
+}
+
+/** Set format on input port */
+static MMAL_STATUS_T convert_input_port_format_commit(MMAL_PORT_T *in)
+{
+   MMAL_COMPONENT_T *component = in->component;
+   MMAL_PORT_T *out = component->output[0];
+   MMAL_EVENT_FORMAT_CHANGED_T *event;
+   MMAL_BUFFER_HEADER_T *buffer;
+   MMAL_ES_FORMAT_T *format;
+   MMAL_STATUS_T status;
+   uint32_t width, height, size;
+
+   if (!mmal_convert_encoding_supported(in->format->encoding))
+   {
+      LOG_ERROR("unsupported input encoding %4.4s", (char *)&in->format->encoding);
+      return MMAL_ENOSYS;
+   }
+   in->buffer_size_min = in->buffer_size_recommended = mmal_convert_frame_size(in->format);
+
+   /* The output picture is the visible area of the input picture, keeping the
+    * output encoding if the conversion to it is supported */
+   format = mmal_format_alloc();
+   if (!format)
+      return MMAL_ENOMEM;
+   status = mmal_format_full_copy(format, in->format);
+   if (status != MMAL_SUCCESS)
+      goto end;
+   if (mmal_convert_kernel_get(in->format->encoding, out->format->encoding, MMAL_CONVERT_ISA_C))
+      format->encoding = out->format->encoding;
+   convert_visible_size(in->format, &width, &height);
+   format->es->video.width = VCOS_ALIGN_UP(width, 32);
+   format->es->video.height = VCOS_ALIGN_UP(height, 16);
+   format->es->video.crop.x = format->es->video.crop.y = 0;
+   format->es->video.crop.width = width;
+   format->es->video.crop.height = height;
+   size = mmal_convert_frame_size(format);
+
+   /* Check if there's anything to propagate to the output port */
+   if (!mmal_format_compare(format, out->format) &&
+       out->buffer_size_min == size && out->buffer_size_recommended == size)
+      goto end;
+
+   /* If the output port is not enabled we just need to update its format.
+    * Otherwise we'll have to trigger a format changed event for it. */
+   if (!out->is_enabled)
+   {
+      out->buffer_size_min = out->buffer_size_recommended = size;
+      status = mmal_format_full_copy(out->format, format);
+      goto end;
+   }
+
+   /* Send an event on the output port */
+   status = mmal_port_event_get(out, &buffer, MMAL_EVENT_FORMAT_CHANGED);
+   if (status != MMAL_SUCCESS)
+   {
+      LOG_ERROR("unable to get an event buffer");
+      goto end;
+   }
+
+   event = mmal_event_format_changed_get(buffer);
+   mmal_format_copy(event->format, format);
+
+   /* Pass on the buffer requirements */
+   event->buffer_num_min = out->buffer_num_min;
+   event->buffer_num_recommended = out->buffer_num_recommended;
+   event->buffer_size_min = event->buffer_size_recommended = size;
+
+   out->priv->module->needs_configuring = 1;
+   mmal_port_event_send(out, buffer);
+
+ end:
+   mmal_format_free(format);
+   return status;
+}
+
+/** Set format on output port */
+static MMAL_STATUS_T convert_output_port_format_commit(MMAL_PORT_T *out)
+{
+   MMAL_COMPONENT_T *component = out->component;
+   MMAL_COMPONENT_MODULE_T *module = component->priv->module;
+   MMAL_PORT_T *in = component->input[0];
+   const MMAL_CONVERT_KERNEL_T *kernel;
+   uint32_t width, height;
+
+   kernel = mmal_convert_kernel_get(in->format->encoding, out->format->encoding, mmal_convert_isa_best());
+   if (!kernel)
+   {
+      LOG_ERROR("unsupported conversion from %4.4s to %4.4s",
+                (char *)&in->format->encoding, (char *)&out->format->encoding);
+      return MMAL_ENOSYS;
+   }
+
+   /* The output picture needs to be big enough for the visible area of the input.
+    * Only the visible area of the input is converted, to the top left of the output. */
+   convert_visible_size(in->format, &width, &height);
+   if (out->format->es->video.width < width || out->format->es->video.height < height)
+      return MMAL_EINVAL;
+   out->format->es->video.crop.x = out->format->es->video.crop.y = 0;
+   out->format->es->video.crop.width = width;
+   out->format->es->video.crop.height = height;
+
+   module->kernel = kernel;
+   out->buffer_size_min = out->buffer_size_recommended = mmal_convert_frame_size(out->format);
+   out->priv->module->needs_configuring = 0;
+   mmal_component_action_trigger(out->component);
+   return MMAL_SUCCESS;
+}
+
+/** Create an instance of a component  */
+static MMAL_STATUS_T mmal_component_create_convert(const char *name, MMAL_COMPONENT_T *component)
+{
+   MMAL_COMPONENT_MODULE_T *module;
+   MMAL_STATUS_T status = MMAL_ENOMEM;
+   MMAL_PARAM_UNUSED(name);
+
+   /* Allocate the context for our module */
+   component->priv->module = module = vcos_malloc(sizeof(*module), "mmal module");
+   if (!module)
+      return MMAL_ENOMEM;
+   memset(module, 0, sizeof(*module));
+
+   /* Don't release resources that haven't been created */
+   module->status = MMAL_ENOMEM;
+   component->priv->pf_destroy = convert_component_destroy;
+
+   /* Allocate and initialise all the ports for this component */
+   component->input = mmal_ports_alloc(component, 1, MMAL_PORT_TYPE_INPUT, sizeof(MMAL_PORT_MODULE_T));
+   if(!component->input)
+      goto error;
+   component->input_num = 1;
+   component->input[0]->priv->pf_enable = convert_port_enable;
+   component->input[0]->priv->pf_disable = convert_port_disable;
+   component->input[0]->priv->pf_flush = convert_port_flush;
+   component->input[0]->priv->pf_send = convert_port_send;
+   component->input[0]->priv->pf_set_format = convert_input_port_format_commit;
+   component->input[0]->buffer_num_min = 1;
+   component->input[0]->buffer_num_recommended = 0;
+   component->input[0]->priv->module->queue = mmal_queue_create();
+   if(!component->input[0]->priv->module->queue)
+      goto error;
+
+   component->output = mmal_ports_alloc(component, 1, MMAL_PORT_TYPE_OUTPUT, sizeof(MMAL_PORT_MODULE_T));
+   if(!component->output)
+      goto error;
+   component->output_num = 1;
+   component->output[0]->priv->pf_enable = convert_port_enable;
+   component->output[0]->priv->pf_disable = convert_port_disable;
+   component->output[0]->priv->pf_flush = convert_port_flush;
+   component->output[0]->priv->pf_send = convert_port_send;
+   component->output[0]->priv->pf_set_format = convert_output_port_format_commit;
+   component->output[0]->buffer_num_min = 1;
+   component->output[0]->buffer_num_recommended = 0;
+   component->output[0]->priv->module->queue = mmal_queue_create();
+   if(!component->output[0]->priv->module->queue)
+      goto error;
+
+   status = convert_workers_create(module);
+   if (status != MMAL_SUCCESS)
+      goto error;
+   module->status = MMAL_SUCCESS;
+
+   status = mmal_component_action_register(component, convert_do_processing_loop);
+   if (status != MMAL_SUCCESS)
+      goto error;
+
+   return MMAL_SUCCESS;
+
+ error:
+   convert_component_destroy(component);
+   return status;
+}
+
+MMAL_CONSTRUCTOR(mmal_register_component_convert);
+void mmal_register_component_convert(void)
+{
+   mmal_component_supplier_register("convert", mmal_component_create_convert);
+}
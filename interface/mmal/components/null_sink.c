@@ -78,6 +78,29 @@ static MMAL_STATUS_T null_sink_port_send(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T
    return MMAL_SUCCESS;
 }
 
+/** Send an array of buffer headers to a port */
+static MMAL_STATUS_T null_sink_port_send_batch(MMAL_PORT_T *port,
+   MMAL_BUFFER_HEADER_T **buffers, unsigned int num)
+{
+   unsigned int i, eos = 0;
+
+   for (i = 0; i < num; i++)
+   {
+      if (buffers[i]->flags & MMAL_BUFFER_HEADER_FLAG_EOS)
+         eos++;
+      buffers[i]->length = 0;
+   }
+
+   /* Send all the buffers back at once */
+   mmal_port_buffer_headers_callback(port, buffers, num);
+
+   /* Generate EOS events */
+   for (i = 0; i < eos; i++)
+      mmal_event_eos_send(port);
+
+   return MMAL_SUCCESS;
+}
+
 /** Set format on a port */
 static MMAL_STATUS_T null_sink_port_format_commit(MMAL_PORT_T *port)
 {
@@ -106,6 +129,7 @@ static MMAL_STATUS_T mmal_component_create_null_sink(const char *name, MMAL_COMP
       component->input[i]->priv->pf_disable = null_sink_port_disable;
       component->input[i]->priv->pf_flush = null_sink_port_flush;
       component->input[i]->priv->pf_send = null_sink_port_send;
+      component->input[i]->priv->pf_send_batch = null_sink_port_send_batch;
       component->input[i]->priv->pf_set_format = null_sink_port_format_commit;
       component->input[i]->buffer_num_min = 1;
       component->input[i]->buffer_num_recommended = 1;
@@ -31,27 +31,63 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "mmal_logging.h"
 
 #define SPLITTER_OUTPUT_PORTS_NUM 4 /* 4 should do for now */
+#define SPLITTER_REFERENCES_NUM  64 /* Maximum number of input buffers being referenced */
+#define SPLITTER_BACKLOG_MAX     16 /* Maximum number of input buffers waiting for an output */
+#define SPLITTER_WORK_MAX        64 /* Maximum number of callbacks batched outside the lock */
 
 /*****************************************************************************/
 typedef struct MMAL_COMPONENT_MODULE_T
 {
    uint32_t enabled_flags; /**< Flags indicating which output port is enabled */
-   uint32_t sent_flags;    /**< Flags indicating which output port we've already sent data to */
    MMAL_BOOL_T error;      /**< Error state */
 
+   /** Buffer headers tracking the references held on input buffers. Each input buffer
+    * is attached to one of these and the output buffer headers are replicated from it.
+    * The input buffer is sent back once the last reference is released. */
+   MMAL_POOL_T *references;
+
+   VCOS_MUTEX_T lock;      /**< Protects the backlogs and processing state */
+   MMAL_BOOL_T processing; /**< A thread is currently processing buffers */
+   MMAL_BOOL_T pending;    /**< Processing was requested while already in progress */
+
 } MMAL_COMPONENT_MODULE_T;
 
 typedef struct MMAL_PORT_MODULE_T
 {
    MMAL_QUEUE_T *queue; /**< queue for the buffers sent to the ports */
 
+   /* Output ports only */
+   MMAL_SPLITTER_POLICY_T policy; /**< What to do when the backlog is full */
+   unsigned int backlog_max;      /**< Maximum number of references in the backlog */
+   unsigned int backlog_first;    /**< Index of the oldest reference in the backlog */
+   unsigned int backlog_num;      /**< Number of references in the backlog */
+   MMAL_BUFFER_HEADER_T *backlog[SPLITTER_BACKLOG_MAX]; /**< References waiting for a free buffer header */
+
+   uint32_t buffers_sent;    /**< Number of buffers sent out of the port */
+   uint32_t buffers_dropped; /**< Number of buffers dropped because of the policy */
+
 } MMAL_PORT_MODULE_T;
 
+/** Callbacks and releases collected while holding the lock and run once it is released */
+typedef struct SPLITTER_WORK_T
+{
+   unsigned int sends_num;
+   MMAL_PORT_T *port[SPLITTER_WORK_MAX];
+   MMAL_BUFFER_HEADER_T *send[SPLITTER_WORK_MAX];
+
+   unsigned int releases_num;
+   MMAL_BUFFER_HEADER_T *release[SPLITTER_WORK_MAX];
+
+   MMAL_STATUS_T status;
+
+} SPLITTER_WORK_T;
+
 /*****************************************************************************/
 
 /** Destroy a previously created component */
 static MMAL_STATUS_T splitter_component_destroy(MMAL_COMPONENT_T *component)
 {
+   MMAL_COMPONENT_MODULE_T *module = component->priv->module;
    unsigned int i;
 
    for(i = 0; i < component->input_num; i++)
@@ -66,153 +102,309 @@ static MMAL_STATUS_T splitter_component_destroy(MMAL_COMPONENT_T *component)
    if(component->output_num)
       mmal_ports_free(component->output, component->output_num);
 
-   vcos_free(component->priv->module);
+   if (module->references)
+      mmal_pool_destroy(module->references);
+   vcos_mutex_delete(&module->lock);
+   vcos_free(module);
    return MMAL_SUCCESS;
 }
 
-/** Enable processing on a port */
-static MMAL_STATUS_T splitter_port_enable(MMAL_PORT_T *port, MMAL_PORT_BH_CB_T cb)
+/*****************************************************************************/
+static MMAL_BUFFER_HEADER_T *splitter_backlog_pop(MMAL_PORT_MODULE_T *port_module)
 {
-#if 0
-   MMAL_COMPONENT_T *component = port->component;
-   uint32_t buffer_num, buffer_size;
+   MMAL_BUFFER_HEADER_T *reference = port_module->backlog[port_module->backlog_first];
+
+   port_module->backlog_first = (port_module->backlog_first + 1) % SPLITTER_BACKLOG_MAX;
+   port_module->backlog_num--;
+   return reference;
+}
+
+static void splitter_backlog_push(MMAL_PORT_MODULE_T *port_module, MMAL_BUFFER_HEADER_T *reference)
+{
+   unsigned int index = (port_module->backlog_first + port_module->backlog_num) % SPLITTER_BACKLOG_MAX;
+
+   mmal_buffer_header_acquire(reference);
+   port_module->backlog[index] = reference;
+   port_module->backlog_num++;
+}
+
+/** Send a reference to an output port using one of its free buffer headers.
+ * Must be called with the lock held. */
+static MMAL_BOOL_T splitter_send_output(MMAL_PORT_T *out_port, MMAL_BUFFER_HEADER_T *reference,
+   SPLITTER_WORK_T *work)
+{
+   MMAL_BUFFER_HEADER_T *out;
+   MMAL_STATUS_T status;
+
+   /* Get a buffer header from output port */
+   out = mmal_queue_get(out_port->priv->module->queue);
+   if (!out)
+      return MMAL_FALSE;
+
+   /* The output buffer header points to the payload of the input buffer and
+    * holds a reference on it until it is released */
+   status = mmal_buffer_header_replicate(out, reference);
+   if (status != MMAL_SUCCESS)
+   {
+      mmal_queue_put_back(out_port->priv->module->queue, out);
+      work->status = status;
+      return MMAL_FALSE;
+   }
+
+   out_port->priv->module->buffers_sent++;
+   work->port[work->sends_num] = out_port;
+   work->send[work->sends_num++] = out;
+   return MMAL_TRUE;
+}
+
+/** Hand out input buffers and backlogged references to the output ports.
+ * Must be called with the lock held. Returns the amount of work collected. */
+static unsigned int splitter_collect(MMAL_COMPONENT_T *component, SPLITTER_WORK_T *work)
+{
+   MMAL_COMPONENT_MODULE_T *module = component->priv->module;
+   MMAL_PORT_T *in_port = component->input[0];
+   MMAL_BUFFER_HEADER_T *in, *reference;
    unsigned int i;
 
-   /* Find the max and apply that to all ports */
-   buffer_num = component->input[0]->buffer_num;
-   buffer_size = component->input[0]->buffer_size;
+   if (module->error)
+      return 0;
+
+   /* Outputs which got buffer headers back first catch up with their backlog */
    for (i = 0; i < component->output_num; i++)
    {
-      buffer_num = MMAL_MAX(buffer_num, component->output[i]->buffer_num);
-      buffer_size = MMAL_MAX(buffer_num, component->output[i]->buffer_size);
+      MMAL_PORT_T *out_port = component->output[i];
+      MMAL_PORT_MODULE_T *port_module = out_port->priv->module;
+
+      if (!(module->enabled_flags & (1<<i)))
+         continue;
+
+      while (port_module->backlog_num &&
+             work->sends_num < SPLITTER_WORK_MAX && work->releases_num < SPLITTER_WORK_MAX)
+      {
+         reference = port_module->backlog[port_module->backlog_first];
+         if (!splitter_send_output(out_port, reference, work))
+            break;
+         work->release[work->releases_num++] = splitter_backlog_pop(port_module);
+      }
    }
-   component->input[0]->buffer_num = buffer_num;
-   component->input[0]->buffer_size = buffer_size;
-   for (i = 0; i < component->output_num; i++)
+
+   /* Then distribute new input buffers */
+   while (work->status == MMAL_SUCCESS &&
+          work->sends_num + component->output_num <= SPLITTER_WORK_MAX &&
+          work->releases_num + component->output_num + 1 <= SPLITTER_WORK_MAX)
    {
-      component->output[i]->buffer_num = buffer_num;
-      component->output[i]->buffer_size = buffer_num;
+      /* Outputs using the blocking policy hold up the input once their backlog is full */
+      for (i = 0; i < component->output_num; i++)
+      {
+         MMAL_PORT_MODULE_T *port_module = component->output[i]->priv->module;
+         if ((module->enabled_flags & (1<<i)) && port_module->policy == MMAL_SPLITTER_POLICY_BLOCK &&
+             port_module->backlog_num >= port_module->backlog_max)
+            break;
+      }
+      if (i < component->output_num)
+         break;
+
+      reference = mmal_queue_get(module->references->queue);
+      if (!reference)
+         break; /* We'll be called again once a reference is released */
+
+      in = mmal_queue_get(in_port->priv->module->queue);
+      if (!in)
+      {
+         mmal_queue_put_back(module->references->queue, reference);
+         break;
+      }
+
+      reference->user_data  = in;
+      reference->cmd        = in->cmd;
+      reference->alloc_size = in->alloc_size;
+      reference->data       = in->data;
+      reference->offset     = in->offset;
+      reference->length     = in->length;
+      reference->flags      = in->flags;
+      reference->pts        = in->pts;
+      reference->dts        = in->dts;
+      *reference->type      = *in->type;
+
+      for (i = 0; i < component->output_num; i++)
+      {
+         MMAL_PORT_T *out_port = component->output[i];
+         MMAL_PORT_MODULE_T *port_module = out_port->priv->module;
+
+         if (!(module->enabled_flags & (1<<i)))
+            continue;
+
+         /* Fast path, the output has a free buffer header */
+         if (!port_module->backlog_num && splitter_send_output(out_port, reference, work))
+            continue;
+
+         if (port_module->backlog_num >= port_module->backlog_max)
+         {
+            port_module->buffers_dropped++;
+            if (port_module->policy == MMAL_SPLITTER_POLICY_DROP_NEWEST)
+               continue;
+            work->release[work->releases_num++] = splitter_backlog_pop(port_module);
+         }
+         splitter_backlog_push(port_module, reference);
+      }
+
+      /* Drop our own reference. The input buffer is sent back straight away
+       * if none of the outputs wanted it. */
+      work->release[work->releases_num++] = reference;
    }
-#endif
 
-   MMAL_PARAM_UNUSED(cb);
-   if (port->buffer_size)
-   if (port->type == MMAL_PORT_TYPE_OUTPUT)
-      port->component->priv->module->enabled_flags |= (1<<port->index);
-   return MMAL_SUCCESS;
+   return work->sends_num + work->releases_num;
 }
 
-/** Flush a port */
-static MMAL_STATUS_T splitter_port_flush(MMAL_PORT_T *port)
+/** Run the callbacks and releases collected under the lock */
+static void splitter_work_run(SPLITTER_WORK_T *work)
 {
-   MMAL_PORT_MODULE_T *port_module = port->priv->module;
-   MMAL_BUFFER_HEADER_T *buffer;
+   unsigned int i;
 
-   /* Flush buffers that our component is holding on to */
-   buffer = mmal_queue_get(port_module->queue);
-   while(buffer)
+   for (i = 0; i < work->sends_num; i++)
+      mmal_port_buffer_header_callback(work->port[i], work->send[i]);
+   for (i = 0; i < work->releases_num; i++)
+      mmal_buffer_header_release(work->release[i]);
+}
+
+/** Process buffers until there is nothing left to do.
+ * Only one thread processes at any given time, which keeps buffers in order on
+ * each output. Requests coming in while processing is in progress (including
+ * re-entrant ones from the callbacks) just make the processing thread loop. */
+static void splitter_process(MMAL_COMPONENT_T *component)
+{
+   MMAL_COMPONENT_MODULE_T *module = component->priv->module;
+   SPLITTER_WORK_T work;
+   unsigned int work_num;
+
+   vcos_mutex_lock(&module->lock);
+   if (module->processing)
    {
-      mmal_port_buffer_header_callback(port, buffer);
-      buffer = mmal_queue_get(port_module->queue);
+      module->pending = MMAL_TRUE;
+      vcos_mutex_unlock(&module->lock);
+      return;
    }
+   module->processing = MMAL_TRUE;
 
-   if (port->type == MMAL_PORT_TYPE_INPUT)
-      port->component->priv->module->sent_flags = 0;
-
-   return MMAL_SUCCESS;
+   do
+   {
+      module->pending = MMAL_FALSE;
+      work.sends_num = work.releases_num = 0;
+      work.status = MMAL_SUCCESS;
+      work_num = splitter_collect(component, &work);
+      if (work.status != MMAL_SUCCESS)
+         module->error = MMAL_TRUE;
+      vcos_mutex_unlock(&module->lock);
+
+      splitter_work_run(&work);
+      if (work.status != MMAL_SUCCESS &&
+          mmal_event_error_send(component, work.status) != MMAL_SUCCESS)
+         LOG_ERROR("unable to send an error event buffer (%i)", (int)work.status);
+
+      vcos_mutex_lock(&module->lock);
+   } while (work_num || module->pending);
+
+   module->processing = MMAL_FALSE;
+   vcos_mutex_unlock(&module->lock);
 }
 
-/** Disable processing on a port */
-static MMAL_STATUS_T splitter_port_disable(MMAL_PORT_T *port)
+/** Called when the last reference to an input buffer has been released */
+static MMAL_BOOL_T splitter_reference_released(MMAL_POOL_T *pool, MMAL_BUFFER_HEADER_T *reference,
+   void *userdata)
 {
-   if (port->type == MMAL_PORT_TYPE_OUTPUT)
-      port->component->priv->module->enabled_flags &= ~(1<<port->index);
+   MMAL_COMPONENT_T *component = (MMAL_COMPONENT_T *)userdata;
+   MMAL_BUFFER_HEADER_T *in = (MMAL_BUFFER_HEADER_T *)reference->user_data;
 
-   /* We just need to flush our internal queue */
-   return splitter_port_flush(port);
-}
+   reference->user_data = NULL;
+   reference->data = NULL;
+   mmal_queue_put(pool->queue, reference);
 
-/** Send a buffer header to a port */
-static MMAL_STATUS_T splitter_send_output(MMAL_BUFFER_HEADER_T *buffer, MMAL_PORT_T *out_port)
-{
-   MMAL_BUFFER_HEADER_T *out;
-   MMAL_STATUS_T status;
+   if (in)
+   {
+      in->length = 0; /* Consume the input buffer */
+      mmal_port_buffer_header_callback(component->input[0], in);
+   }
 
-   /* Get a buffer header from output port */
-   out = mmal_queue_get(out_port->priv->module->queue);
-   if (!out)
-      return MMAL_EAGAIN;
+   /* Input buffers might have been waiting for a free reference */
+   splitter_process(component);
+   return MMAL_FALSE;
+}
 
-   /* Copy our input buffer header */
-   status = mmal_buffer_header_replicate(out, buffer);
-   if (status != MMAL_SUCCESS)
-      goto error;
+/*****************************************************************************/
 
-   /* Send buffer back */
-   mmal_port_buffer_header_callback(out_port, out);
-   return MMAL_SUCCESS;
+/** Enable processing on a port */
+static MMAL_STATUS_T splitter_port_enable(MMAL_PORT_T *port, MMAL_PORT_BH_CB_T cb)
+{
+   MMAL_COMPONENT_MODULE_T *module = port->component->priv->module;
+   MMAL_PARAM_UNUSED(cb);
 
- error:
-   mmal_queue_put_back(out_port->priv->module->queue, out);
-   return status;
+   if (port->type == MMAL_PORT_TYPE_OUTPUT)
+   {
+      vcos_mutex_lock(&module->lock);
+      module->enabled_flags |= (1<<port->index);
+      vcos_mutex_unlock(&module->lock);
+   }
+   return MMAL_SUCCESS;
 }
 
-/** Send a buffer header to a port */
-static MMAL_STATUS_T splitter_port_send(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+/** Flush a port */
+static MMAL_STATUS_T splitter_port_flush(MMAL_PORT_T *port)
 {
    MMAL_COMPONENT_T *component = port->component;
    MMAL_COMPONENT_MODULE_T *module = component->priv->module;
-   MMAL_PORT_T *in_port, *out_port;
-   MMAL_BUFFER_HEADER_T *in;
-   MMAL_STATUS_T status;
-   unsigned int i;
-
-   mmal_queue_put(port->priv->module->queue, buffer);
-
-   if (module->error)
-      return MMAL_SUCCESS; /* Just do nothing */
-
-   /* Get input buffer header */
-   in_port = component->input[0];
-   in = mmal_queue_get(in_port->priv->module->queue);
-   if (!in)
-      return MMAL_SUCCESS; /* Nothing to do */
+   MMAL_PORT_MODULE_T *port_module = port->priv->module;
+   MMAL_BUFFER_HEADER_T *buffer, *release[SPLITTER_BACKLOG_MAX * SPLITTER_OUTPUT_PORTS_NUM];
+   unsigned int i, release_num = 0;
 
+   /* Drop the references waiting in the backlogs. Flushing the input drops
+    * all of them so the input buffers can be sent back. */
+   vcos_mutex_lock(&module->lock);
    for (i = 0; i < component->output_num; i++)
    {
-      out_port = component->output[i];
-      status = splitter_send_output(in, out_port);
-
-      if (status != MMAL_SUCCESS && status != MMAL_EAGAIN)
-         goto error;
+      MMAL_PORT_MODULE_T *out_module = component->output[i]->priv->module;
 
-      if (status == MMAL_SUCCESS)
-         module->sent_flags |= (1<<i);
+      if (port->type == MMAL_PORT_TYPE_OUTPUT && component->output[i] != port)
+         continue;
+      while (out_module->backlog_num)
+         release[release_num++] = splitter_backlog_pop(out_module);
    }
+   vcos_mutex_unlock(&module->lock);
+
+   for (i = 0; i < release_num; i++)
+      mmal_buffer_header_release(release[i]);
 
-   /* Check if we're done with the input buffer */
-   if ((module->sent_flags & module->enabled_flags) == module->enabled_flags)
+   /* Flush buffers that our component is holding on to */
+   buffer = mmal_queue_get(port_module->queue);
+   while(buffer)
    {
-      in->length = 0; /* Consume the input buffer */
-      mmal_port_buffer_header_callback(in_port, in);
-      module->sent_flags = 0;
-      return MMAL_SUCCESS;
+      mmal_port_buffer_header_callback(port, buffer);
+      buffer = mmal_queue_get(port_module->queue);
    }
 
-   /* We're not done yet so put the buffer back in the queue */
-   mmal_queue_put(in_port->priv->module->queue, in);
    return MMAL_SUCCESS;
+}
 
- error:
-   mmal_queue_put(in_port->priv->module->queue, in);
+/** Disable processing on a port */
+static MMAL_STATUS_T splitter_port_disable(MMAL_PORT_T *port)
+{
+   MMAL_COMPONENT_MODULE_T *module = port->component->priv->module;
 
-   status = mmal_event_error_send(port->component, status);
-   if (status != MMAL_SUCCESS)
+   if (port->type == MMAL_PORT_TYPE_OUTPUT)
    {
-      LOG_ERROR("unable to send an error event buffer (%i)", (int)status);
-      return MMAL_SUCCESS;
+      vcos_mutex_lock(&module->lock);
+      module->enabled_flags &= ~(1<<port->index);
+      vcos_mutex_unlock(&module->lock);
    }
-   module->error = 1;
+
+   /* We just need to flush our internal queue */
+   return splitter_port_flush(port);
+}
+
+/** Send a buffer header to a port */
+static MMAL_STATUS_T splitter_port_send(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   mmal_queue_put(port->priv->module->queue, buffer);
+   splitter_process(port->component);
    return MMAL_SUCCESS;
 }
 
@@ -272,6 +464,70 @@ static MMAL_STATUS_T splitter_port_parameter_set(MMAL_PORT_T *port, const MMAL_P
       }
       return MMAL_SUCCESS;
 
+   case MMAL_PARAMETER_SPLITTER_POLICY:
+      {
+         const MMAL_PARAMETER_SPLITTER_POLICY_T *policy = (const MMAL_PARAMETER_SPLITTER_POLICY_T *)param;
+         MMAL_PORT_MODULE_T *port_module = port->priv->module;
+
+         if (port->type != MMAL_PORT_TYPE_OUTPUT || param->size < sizeof(*policy) ||
+             policy->policy > MMAL_SPLITTER_POLICY_DROP_NEWEST ||
+             policy->backlog > SPLITTER_BACKLOG_MAX)
+            return MMAL_EINVAL;
+
+         vcos_mutex_lock(&component->priv->module->lock);
+         port_module->policy = policy->policy;
+         port_module->backlog_max = policy->backlog ? policy->backlog :
+            policy->policy == MMAL_SPLITTER_POLICY_BLOCK ? SPLITTER_BACKLOG_MAX : 1;
+         vcos_mutex_unlock(&component->priv->module->lock);
+      }
+      return MMAL_SUCCESS;
+
+   case MMAL_PARAMETER_SPLITTER_STATISTICS:
+      if (port->type != MMAL_PORT_TYPE_OUTPUT)
+         return MMAL_EINVAL;
+      vcos_mutex_lock(&component->priv->module->lock);
+      port->priv->module->buffers_sent = 0;
+      port->priv->module->buffers_dropped = 0;
+      vcos_mutex_unlock(&component->priv->module->lock);
+      return MMAL_SUCCESS;
+
+   default:
+      return MMAL_ENOSYS;
+   }
+}
+
+static MMAL_STATUS_T splitter_port_parameter_get(MMAL_PORT_T *port, MMAL_PARAMETER_HEADER_T *param)
+{
+   MMAL_COMPONENT_MODULE_T *module = port->component->priv->module;
+   MMAL_PORT_MODULE_T *port_module = port->priv->module;
+
+   switch (param->id)
+   {
+   case MMAL_PARAMETER_SPLITTER_POLICY:
+      {
+         MMAL_PARAMETER_SPLITTER_POLICY_T *policy = (MMAL_PARAMETER_SPLITTER_POLICY_T *)param;
+
+         if (port->type != MMAL_PORT_TYPE_OUTPUT || param->size < sizeof(*policy))
+            return MMAL_EINVAL;
+         policy->policy = port_module->policy;
+         policy->backlog = port_module->backlog_max;
+      }
+      return MMAL_SUCCESS;
+
+   case MMAL_PARAMETER_SPLITTER_STATISTICS:
+      {
+         MMAL_PARAMETER_SPLITTER_STATISTICS_T *stats = (MMAL_PARAMETER_SPLITTER_STATISTICS_T *)param;
+
+         if (port->type != MMAL_PORT_TYPE_OUTPUT || param->size < sizeof(*stats))
+            return MMAL_EINVAL;
+         vcos_mutex_lock(&module->lock);
+         stats->buffers_sent = port_module->buffers_sent;
+         stats->buffers_dropped = port_module->buffers_dropped;
+         stats->backlog = port_module->backlog_num;
+         vcos_mutex_unlock(&module->lock);
+      }
+      return MMAL_SUCCESS;
+
    default:
       return MMAL_ENOSYS;
    }
@@ -290,9 +546,19 @@ static MMAL_STATUS_T mmal_component_create_splitter(const char *name, MMAL_COMPO
    if (!module)
       return MMAL_ENOMEM;
    memset(module, 0, sizeof(*module));
+   if (vcos_mutex_create(&module->lock, "mmal splitter") != VCOS_SUCCESS)
+   {
+      vcos_free(module);
+      return MMAL_ENOMEM;
+   }
 
    component->priv->pf_destroy = splitter_component_destroy;
 
+   module->references = mmal_pool_create(SPLITTER_REFERENCES_NUM, 0);
+   if (!module->references)
+      goto error;
+   mmal_pool_callback_set(module->references, splitter_reference_released, component);
+
    /* Allocate and initialise all the ports for this component */
    component->input = mmal_ports_alloc(component, 1, MMAL_PORT_TYPE_INPUT, sizeof(MMAL_PORT_MODULE_T));
    if(!component->input)
@@ -323,12 +589,15 @@ static MMAL_STATUS_T mmal_component_create_splitter(const char *name, MMAL_COMPO
       component->output[i]->priv->pf_send = splitter_port_send;
       component->output[i]->priv->pf_set_format = splitter_port_format_commit;
       component->output[i]->priv->pf_parameter_set = splitter_port_parameter_set;
+      component->output[i]->priv->pf_parameter_get = splitter_port_parameter_get;
       component->output[i]->buffer_num_min = 1;
       component->output[i]->buffer_num_recommended = 0;
       component->output[i]->capabilities = MMAL_PORT_CAPABILITY_PASSTHROUGH;
       component->output[i]->priv->module->queue = mmal_queue_create();
       if(!component->output[i]->priv->module->queue)
          goto error;
+      component->output[i]->priv->module->policy = MMAL_SPLITTER_POLICY_BLOCK;
+      component->output[i]->priv->module->backlog_max = SPLITTER_BACKLOG_MAX;
    }
 
    return MMAL_SUCCESS;
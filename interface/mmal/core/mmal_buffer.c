@@ -40,7 +40,12 @@ void mmal_buffer_header_acquire(MMAL_BUFFER_HEADER_T *header)
 #ifdef ENABLE_MMAL_EXTRA_LOGGING
    LOG_TRACE("%p (%i)", header, (int)header->priv->refcount+1);
 #endif
+#ifdef __GNUC__
+   /* Buffer headers can be shared between threads (e.g. splitter outputs) */
+   __atomic_add_fetch(&header->priv->refcount, 1, __ATOMIC_RELAXED);
+#else
    header->priv->refcount++;
+#endif
 }
 
 /** Reset a buffer header */
@@ -60,8 +65,13 @@ void mmal_buffer_header_release(MMAL_BUFFER_HEADER_T *header)
    LOG_TRACE("%p (%i)", header, (int)header->priv->refcount-1);
 #endif
 
+#ifdef __GNUC__
+   if (__atomic_sub_fetch(&header->priv->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+#else
    if(--header->priv->refcount != 0)
       return;
+#endif
 
    if (header->priv->pf_pre_release)
    {
@@ -63,6 +63,9 @@ typedef struct MMAL_BUFFER_HEADER_PRIVATE_T
    void *component_data;      /**< Field reserved for use by the component */
    void *payload_handle;      /**< Field reserved for mmal_buffer_header_mem_lock */
 
+   uint64_t send_time;        /**< Time (us) the buffer header was last sent to a port.
+                                   Used by the core to measure the time spent in transit. */
+
    uint8_t driver_area[MMAL_DRIVER_BUFFER_SIZE];
 
 } MMAL_BUFFER_HEADER_PRIVATE_T;
@@ -35,12 +35,23 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /* Use RTOS timer for improved accuracy */
 # include "vcfw/rtos/rtos.h"
 # define USE_RTOS_TIMER
+#elif defined(__linux__)
+/* Use a timerfd for microsecond accuracy, waited on by the worker thread itself */
+# include <sys/timerfd.h>
+# include <sys/eventfd.h>
+# include <poll.h>
+# include <unistd.h>
+# define USE_TIMERFD
 #endif
 
 
 /*****************************************************************************/
+/* Requests due within MIN_TIMER_DELAY of the current media-time are serviced
+ * together, in a single batch */
 #ifdef USE_RTOS_TIMER
 # define MIN_TIMER_DELAY  1     /* microseconds */
+#elif defined(USE_TIMERFD)
+# define MIN_TIMER_DELAY  1000  /* microseconds */
 #else
 # define MIN_TIMER_DELAY  10000 /* microseconds */
 #endif
@@ -48,9 +59,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /* 1.0 in Q16 format */
 #define Q16_ONE  (1 << 16)
 
-/* Maximum number of pending requests */
+/* Number of request slots allocated at a time */
 #define CLOCK_REQUEST_SLOTS  32
 
+/* Maximum number of pending requests */
+#define CLOCK_REQUEST_SLOTS_MAX  16384
+
 /* Number of microseconds the clock tries to service requests early
  * to account for processing overhead */
 #define CLOCK_TARGET_OFFSET  20
@@ -86,6 +100,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /*****************************************************************************/
 #ifdef USE_RTOS_TIMER
 typedef RTOS_TIMER_T MMAL_TIMER_T;
+#elif defined(USE_TIMERFD)
+typedef int MMAL_TIMER_T;
 #else
 typedef VCOS_TIMER_T MMAL_TIMER_T;
 #endif
@@ -100,8 +116,17 @@ typedef struct MMAL_CLOCK_REQUEST_T
    int64_t media_time_adj;   /**< adjusted media-time at which the request will
                                   be serviced in microseconds (this takes
                                   CLOCK_TARGET_OFFSET into account) */
+   int64_t key;              /**< ordering key in the pending heap (media_time_adj,
+                                  negated when the clock scale is negative) */
 } MMAL_CLOCK_REQUEST_T;
 
+/* Block of request slots */
+typedef struct MMAL_CLOCK_REQUEST_CHUNK_T
+{
+   struct MMAL_CLOCK_REQUEST_CHUNK_T *next;
+   MMAL_CLOCK_REQUEST_T slot[CLOCK_REQUEST_SLOTS];
+} MMAL_CLOCK_REQUEST_CHUNK_T;
+
 typedef struct MMAL_CLOCK_PRIVATE_T
 {
    MMAL_CLOCK_T clock;        /**< must be first */
@@ -110,7 +135,11 @@ typedef struct MMAL_CLOCK_PRIVATE_T
 
    MMAL_BOOL_T scheduling;    /**< TRUE -> client request scheduling is enabled */
    MMAL_BOOL_T stop_thread;
+#ifdef USE_TIMERFD
+   int event;                 /**< eventfd used to wake up the worker thread */
+#else
    VCOS_SEMAPHORE_T event;
+#endif
    VCOS_THREAD_T thread;      /**< processing thread for client requests */
    MMAL_TIMER_T timer;        /**< used for scheduling client requests */
 
@@ -152,8 +181,11 @@ typedef struct MMAL_CLOCK_PRIVATE_T
    struct
    {
       MMAL_LIST_T* list_free;
-      MMAL_LIST_T* list_pending;
-      MMAL_CLOCK_REQUEST_T pool[CLOCK_REQUEST_SLOTS];
+      MMAL_CLOCK_REQUEST_T **pending; /**< binary min-heap of pending requests */
+      unsigned int pending_num;       /**< number of pending requests */
+      unsigned int slots_num;         /**< number of request slots allocated */
+      MMAL_BOOL_T backwards;          /**< heap keys are ordered for a negative scale */
+      MMAL_CLOCK_REQUEST_CHUNK_T *chunks;
    } request;
 
 } MMAL_CLOCK_PRIVATE_T;
@@ -173,6 +205,8 @@ static void mmal_clock_timer_cb(MMAL_TIMER_T *timer, void *ctx)
    /* Notify the worker thread */
    mmal_clock_wake_thread((MMAL_CLOCK_PRIVATE_T*)ctx);
 }
+#elif defined(USE_TIMERFD)
+/* The worker thread waits on the timer directly */
 #else
 static void mmal_clock_timer_cb(void *ctx)
 {
@@ -186,6 +220,10 @@ static inline MMAL_BOOL_T mmal_clock_timer_create(MMAL_TIMER_T *timer, void *ctx
 {
 #ifdef USE_RTOS_TIMER
    return (rtos_timer_init(timer, mmal_clock_timer_cb, ctx) == 0);
+#elif defined(USE_TIMERFD)
+   MMAL_PARAM_UNUSED(ctx);
+   *timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   return (*timer >= 0);
 #else
    return (vcos_timer_create(timer, "mmal-clock timer", mmal_clock_timer_cb, ctx) == VCOS_SUCCESS);
 #endif
@@ -196,6 +234,8 @@ static inline void mmal_clock_timer_destroy(MMAL_TIMER_T *timer)
 {
 #ifdef USE_RTOS_TIMER
    /* Nothing to do */
+#elif defined(USE_TIMERFD)
+   close(*timer);
 #else
    vcos_timer_delete(timer);
 #endif
@@ -206,6 +246,13 @@ static inline void mmal_clock_timer_set(MMAL_TIMER_T *timer, int64_t delay_us)
 {
 #ifdef USE_RTOS_TIMER
    rtos_timer_set(timer, (RTOS_TIMER_TIME_T)delay_us);
+#elif defined(USE_TIMERFD)
+   struct itimerspec spec = {{0, 0}, {0, 0}};
+   if (delay_us <= 0)
+      delay_us = 1; /* A zero value would disarm the timer */
+   spec.it_value.tv_sec = delay_us / 1000000;
+   spec.it_value.tv_nsec = (delay_us % 1000000) * 1000;
+   timerfd_settime(*timer, 0, &spec, NULL);
 #else
    /* VCOS timer only provides millisecond accuracy */
    vcos_timer_set(timer, (VCOS_UNSIGNED)(delay_us / 1000));
@@ -217,11 +264,202 @@ static inline void mmal_clock_timer_cancel(MMAL_TIMER_T *timer)
 {
 #ifdef USE_RTOS_TIMER
    rtos_timer_cancel(timer);
+#elif defined(USE_TIMERFD)
+   struct itimerspec spec = {{0, 0}, {0, 0}};
+   timerfd_settime(*timer, 0, &spec, NULL);
 #else
    vcos_timer_cancel(timer);
 #endif
 }
 
+/*****************************************************************************
+ * Worker thread event functions
+ *****************************************************************************/
+/* Create the event used to wake up the worker thread */
+static MMAL_BOOL_T mmal_clock_event_create(MMAL_CLOCK_PRIVATE_T *private)
+{
+#ifdef USE_TIMERFD
+   private->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   return (private->event >= 0);
+#else
+   return (vcos_semaphore_create(&private->event, "mmal-clock sema", 0) == VCOS_SUCCESS);
+#endif
+}
+
+/* Destroy the worker thread event */
+static void mmal_clock_event_destroy(MMAL_CLOCK_PRIVATE_T *private)
+{
+#ifdef USE_TIMERFD
+   close(private->event);
+#else
+   vcos_semaphore_delete(&private->event);
+#endif
+}
+
+/* Signal the worker thread event */
+static void mmal_clock_event_post(MMAL_CLOCK_PRIVATE_T *private)
+{
+#ifdef USE_TIMERFD
+   uint64_t value = 1;
+   if (write(private->event, &value, sizeof(value)) < 0)
+      LOG_ERROR("failed to signal worker thread");
+#else
+   vcos_semaphore_post(&private->event);
+#endif
+}
+
+/* Wait for either the worker thread event or the timer to fire */
+static void mmal_clock_event_wait(MMAL_CLOCK_PRIVATE_T *private)
+{
+#ifdef USE_TIMERFD
+   struct pollfd fds[2];
+   uint64_t value;
+
+   fds[0].fd = private->event;
+   fds[0].events = POLLIN;
+   fds[1].fd = private->timer;
+   fds[1].events = POLLIN;
+   while (poll(fds, 2, -1) < 0)
+      /* Interrupted */;
+
+   /* Reset both of them, the cause doesn't matter */
+   if (fds[0].revents & POLLIN)
+      (void)!read(private->event, &value, sizeof(value));
+   if (fds[1].revents & POLLIN)
+      (void)!read(private->timer, &value, sizeof(value));
+#else
+   vcos_semaphore_wait(&private->event);
+#endif
+}
+
+/*****************************************************************************
+ * Pending requests heap
+ *****************************************************************************/
+/* Move a request up the heap until its parent is due before it */
+static void mmal_clock_heap_up(MMAL_CLOCK_REQUEST_T **heap, unsigned int i)
+{
+   MMAL_CLOCK_REQUEST_T *request = heap[i];
+
+   while (i)
+   {
+      unsigned int parent = (i - 1) / 2;
+      if (heap[parent]->key <= request->key)
+         break;
+      heap[i] = heap[parent];
+      i = parent;
+   }
+   heap[i] = request;
+}
+
+/* Move a request down the heap until its children are due after it */
+static void mmal_clock_heap_down(MMAL_CLOCK_REQUEST_T **heap, unsigned int num, unsigned int i)
+{
+   MMAL_CLOCK_REQUEST_T *request = heap[i];
+
+   while (1)
+   {
+      unsigned int child = 2 * i + 1;
+      if (child >= num)
+         break;
+      if (child + 1 < num && heap[child + 1]->key < heap[child]->key)
+         child++;
+      if (request->key <= heap[child]->key)
+         break;
+      heap[i] = heap[child];
+      i = child;
+   }
+   heap[i] = request;
+}
+
+/* Return the earliest pending request without removing it */
+static MMAL_CLOCK_REQUEST_T *mmal_clock_heap_top(MMAL_CLOCK_PRIVATE_T *private)
+{
+   return private->request.pending_num ? private->request.pending[0] : NULL;
+}
+
+/* Remove the earliest pending request */
+static MMAL_CLOCK_REQUEST_T *mmal_clock_heap_pop(MMAL_CLOCK_PRIVATE_T *private)
+{
+   MMAL_CLOCK_REQUEST_T **heap = private->request.pending;
+   MMAL_CLOCK_REQUEST_T *request;
+
+   if (!private->request.pending_num)
+      return NULL;
+
+   request = heap[0];
+   heap[0] = heap[--private->request.pending_num];
+   if (private->request.pending_num)
+      mmal_clock_heap_down(heap, private->request.pending_num, 0);
+   return request;
+}
+
+/* Re-order the pending requests after a change in the direction of the clock */
+static void mmal_clock_heap_reorder(MMAL_CLOCK_PRIVATE_T *private)
+{
+   MMAL_CLOCK_REQUEST_T **heap = private->request.pending;
+   MMAL_BOOL_T backwards = private->scale < 0;
+   unsigned int i, num = private->request.pending_num;
+
+   if (backwards == private->request.backwards)
+      return;
+   private->request.backwards = backwards;
+
+   for (i = 0; i < num; i++)
+      heap[i]->key = -heap[i]->key;
+   for (i = num / 2; i-- > 0; )
+      mmal_clock_heap_down(heap, num, i);
+}
+
+/* Allocate more request slots */
+static MMAL_BOOL_T mmal_clock_request_slots_grow(MMAL_CLOCK_PRIVATE_T *private)
+{
+   unsigned int i, slots_num = private->request.slots_num + CLOCK_REQUEST_SLOTS;
+   MMAL_CLOCK_REQUEST_CHUNK_T *chunk;
+   MMAL_CLOCK_REQUEST_T **pending;
+
+   if (slots_num > CLOCK_REQUEST_SLOTS_MAX)
+      return MMAL_FALSE;
+
+   chunk = vcos_calloc(1, sizeof(*chunk), "mmal-clock requests");
+   pending = vcos_calloc(slots_num, sizeof(*pending), "mmal-clock pending");
+   if (!chunk || !pending)
+   {
+      vcos_free(chunk);
+      vcos_free(pending);
+      return MMAL_FALSE;
+   }
+
+   if (private->request.pending)
+   {
+      memcpy(pending, private->request.pending, private->request.pending_num * sizeof(*pending));
+      vcos_free(private->request.pending);
+   }
+   private->request.pending = pending;
+   private->request.slots_num = slots_num;
+
+   chunk->next = private->request.chunks;
+   private->request.chunks = chunk;
+   for (i = 0; i < CLOCK_REQUEST_SLOTS; ++i)
+      mmal_list_push_back(private->request.list_free, &chunk->slot[i].link);
+
+   return MMAL_TRUE;
+}
+
+/* Release all the request slots */
+static void mmal_clock_request_slots_free(MMAL_CLOCK_PRIVATE_T *private)
+{
+   MMAL_CLOCK_REQUEST_CHUNK_T *chunk;
+
+   while ((chunk = private->request.chunks) != NULL)
+   {
+      private->request.chunks = chunk->next;
+      vcos_free(chunk);
+   }
+   vcos_free(private->request.pending);
+   private->request.pending = NULL;
+   private->request.pending_num = private->request.slots_num = 0;
+}
+
 
 /*****************************************************************************
  * Clock module private functions
@@ -252,49 +490,18 @@ static int64_t mmal_clock_media_time_get_locked(MMAL_CLOCK_PRIVATE_T *private)
    return private->media_time;
 }
 
-/* Comparison function used for inserting a request into
- * the list of pending requests when clock scale is positive. */
-static int mmal_clock_request_compare_pos(MMAL_LIST_ELEMENT_T *lhs, MMAL_LIST_ELEMENT_T *rhs)
-{
-   return ((MMAL_CLOCK_REQUEST_T*)lhs)->media_time_adj < ((MMAL_CLOCK_REQUEST_T*)rhs)->media_time_adj;
-}
-
-/* Comparison function used for inserting a request into
- * the list of pending requests when clock scale is negative. */
-static int mmal_clock_request_compare_neg(MMAL_LIST_ELEMENT_T *lhs, MMAL_LIST_ELEMENT_T *rhs)
-{
-   return ((MMAL_CLOCK_REQUEST_T*)lhs)->media_time_adj > ((MMAL_CLOCK_REQUEST_T*)rhs)->media_time_adj;
-}
-
-/* Insert a new request into the list of pending requests */
+/* Insert a new request into the heap of pending requests */
 static MMAL_BOOL_T mmal_clock_request_insert(MMAL_CLOCK_PRIVATE_T *private, MMAL_CLOCK_REQUEST_T *request)
 {
-   MMAL_LIST_T *list = private->request.list_pending;
-   MMAL_CLOCK_REQUEST_T *pending;
-
    if (private->stop_thread)
       return MMAL_FALSE; /* the clock is being destroyed */
 
-   if (list->length == 0)
-   {
-      mmal_list_push_front(list, &request->link);
-      return MMAL_TRUE;
-   }
+   mmal_clock_heap_reorder(private);
 
-   /* It is more likely for requests to be received in sequence,
-    * so try adding to the back of the list first before doing
-    * a more expensive list insert. */
-   pending = (MMAL_CLOCK_REQUEST_T*)list->last;
-   if ((private->scale >= 0 && (request->media_time_adj >= pending->media_time_adj)) ||
-       (private->scale <  0 && (request->media_time_adj <= pending->media_time_adj)))
-   {
-      mmal_list_push_back(list, &request->link);
-   }
-   else
-   {
-      mmal_list_insert(list, &request->link,
-            (private->scale >= 0) ? mmal_clock_request_compare_pos : mmal_clock_request_compare_neg);
-   }
+   /* Requests are serviced in decreasing media-time order when playing backwards */
+   request->key = private->request.backwards ? -request->media_time_adj : request->media_time_adj;
+   private->request.pending[private->request.pending_num] = request;
+   mmal_clock_heap_up(private->request.pending, private->request.pending_num++);
    return MMAL_TRUE;
 }
 
@@ -302,11 +509,10 @@ static MMAL_BOOL_T mmal_clock_request_insert(MMAL_CLOCK_PRIVATE_T *private, MMAL
 static MMAL_STATUS_T mmal_clock_request_flush_locked(MMAL_CLOCK_PRIVATE_T *private,
                                                      int64_t media_time)
 {
-   MMAL_LIST_T *pending = private->request.list_pending;
    MMAL_LIST_T *list_free = private->request.list_free;
    MMAL_CLOCK_REQUEST_T *request;
 
-   while ((request = (MMAL_CLOCK_REQUEST_T *)mmal_list_pop_front(pending)) != NULL)
+   while ((request = mmal_clock_heap_pop(private)) != NULL)
    {
       /* Inform the client */
       request->cb(&private->clock, media_time, request->cb_data, request->priv);
@@ -319,19 +525,34 @@ static MMAL_STATUS_T mmal_clock_request_flush_locked(MMAL_CLOCK_PRIVATE_T *priva
    return MMAL_SUCCESS;
 }
 
+/* Check whether a pending request is due at the given media-time */
+static MMAL_BOOL_T mmal_clock_request_is_due(MMAL_CLOCK_PRIVATE_T *private,
+                                             MMAL_CLOCK_REQUEST_T *request, int64_t media_time_now)
+{
+   /* Fire the request if it matches the pending discontinuity or if its requested media time
+    * has been reached. */
+   return (private->discont_expiry != 0 &&
+           request->media_time_adj >= private->discont_start &&
+           request->media_time_adj < private->discont_end) ||
+          (private->scale > 0 && ((media_time_now + MIN_TIMER_DELAY) >= request->media_time_adj)) ||
+          (private->scale < 0 && ((media_time_now - MIN_TIMER_DELAY) <= request->media_time_adj));
+}
+
 /* Process all pending requests */
 static void mmal_clock_process_requests(MMAL_CLOCK_PRIVATE_T *private)
 {
    int64_t media_time_now;
    MMAL_LIST_T* free = private->request.list_free;
-   MMAL_LIST_T* pending = private->request.list_pending;
    MMAL_CLOCK_REQUEST_T *next;
+   MMAL_BOOL_T stale = MMAL_FALSE;
 
-   if (pending->length == 0 || !private->is_active)
+   if (private->request.pending_num == 0 || !private->is_active)
       return;
 
    LOCK(private);
 
+   mmal_clock_heap_reorder(private);
+
    /* Detect discontinuity */
    if (private->media_time_at_timer != 0)
    {
@@ -340,8 +561,8 @@ static void mmal_clock_process_requests(MMAL_CLOCK_PRIVATE_T *private)
       if (private->scale > 0 &&
           media_time_now + private->discont_threshold < private->media_time_at_timer)
       {
-         LOG_INFO("discontinuity: was=%" PRIi64 " now=%" PRIi64 " pending=%d",
-                  private->media_time_at_timer, media_time_now, pending->length);
+         LOG_INFO("discontinuity: was=%" PRIi64 " now=%" PRIi64 " pending=%u",
+                  private->media_time_at_timer, media_time_now, private->request.pending_num);
 
          /* It's likely that packets from before the discontinuity will continue to arrive for
           * a short time. Ensure these are detected and the requests fired immediately. */
@@ -354,30 +575,31 @@ static void mmal_clock_process_requests(MMAL_CLOCK_PRIVATE_T *private)
       }
    }
 
-   /* Earliest request is always at the front */
-   next = (MMAL_CLOCK_REQUEST_T*)mmal_list_pop_front(pending);
-   while (next)
-   {
-      media_time_now = mmal_clock_media_time_get_locked(private);
-
-      if (private->discont_expiry != 0 && private->wall_time > private->discont_expiry)
-         private->discont_expiry = 0;
+   /* Service the whole batch of requests which are due with the same media-time.
+    * The earliest request is always at the top of the heap. */
+   media_time_now = mmal_clock_media_time_get_locked(private);
+   if (private->discont_expiry != 0 && private->wall_time > private->discont_expiry)
+      private->discont_expiry = 0;
 
-      /* Fire the request if it matches the pending discontinuity or if its requested media time
-       * has been reached. */
-      if ((private->discont_expiry != 0 &&
-           next->media_time_adj >= private->discont_start &&
-           next->media_time_adj < private->discont_end) ||
-          (private->scale > 0 && ((media_time_now + MIN_TIMER_DELAY) >= next->media_time_adj)) ||
-          (private->scale < 0 && ((media_time_now - MIN_TIMER_DELAY) <= next->media_time_adj)))
+   while ((next = mmal_clock_heap_top(private)) != NULL)
+   {
+      if (mmal_clock_request_is_due(private, next, media_time_now))
       {
          LOG_TRACE("servicing request: next %"PRIi64" now %"PRIi64, next->media_time_adj, media_time_now);
+         mmal_clock_heap_pop(private);
          /* Inform the client */
          next->cb(&private->clock, media_time_now, next->cb_data, next->priv);
          /* Recycle the request slot */
          mmal_list_push_back(free, &next->link);
-         /* Move onto next pending request */
-         next = (MMAL_CLOCK_REQUEST_T*)mmal_list_pop_front(pending);
+         stale = MMAL_TRUE;
+      }
+      else if (stale)
+      {
+         /* Callbacks take time so check again with an up-to-date media-time before sleeping */
+         media_time_now = mmal_clock_media_time_get_locked(private);
+         if (private->discont_expiry != 0 && private->wall_time > private->discont_expiry)
+            private->discont_expiry = 0;
+         stale = MMAL_FALSE;
       }
       else
       {
@@ -389,15 +611,12 @@ static void mmal_clock_process_requests(MMAL_CLOCK_PRIVATE_T *private)
          if (private->scale == 0)
             wall_time_delay = CLOCK_WAIT_TIME; /* Clock is paused */
 
-         /* Put next request back into pending list */
-         mmal_list_push_front(pending, &next->link);
-         next = NULL;
-
          /* Set the timer */
          private->media_time_at_timer = media_time_now;
          mmal_clock_timer_set(&private->timer, wall_time_delay);
 
          LOG_TRACE("re-schedule timer: now %"PRIi64" delay %"PRIi64, media_time_now, wall_time_delay);
+         break;
       }
    }
 
@@ -408,7 +627,7 @@ static void mmal_clock_process_requests(MMAL_CLOCK_PRIVATE_T *private)
 static void mmal_clock_wake_thread(MMAL_CLOCK_PRIVATE_T *private)
 {
    if (private->scheduling)
-      vcos_semaphore_post(&private->event);
+      mmal_clock_event_post(private);
 }
 
 /* Stop the worker thread */
@@ -426,7 +645,7 @@ static void* mmal_clock_worker_thread(void *ctx)
 
    while (1)
    {
-      vcos_semaphore_wait(&private->event);
+      mmal_clock_event_wait(private);
 
       /* Either the timer has expired or a new request is pending */
       mmal_clock_timer_cancel(&private->timer);
@@ -442,9 +661,8 @@ static void* mmal_clock_worker_thread(void *ctx)
 /* Create scheduling resources */
 static MMAL_STATUS_T mmal_clock_create_scheduling(MMAL_CLOCK_PRIVATE_T *private)
 {
-   unsigned int i;
    MMAL_BOOL_T timer_status = MMAL_FALSE;
-   VCOS_STATUS_T event_status = VCOS_EINVAL;
+   MMAL_BOOL_T event_status = MMAL_FALSE;
    VCOS_UNSIGNED priority;
 
    timer_status = mmal_clock_timer_create(&private->timer, private);
@@ -454,24 +672,26 @@ static MMAL_STATUS_T mmal_clock_create_scheduling(MMAL_CLOCK_PRIVATE_T *private)
       goto error;
    }
 
-   event_status = vcos_semaphore_create(&private->event, "mmal-clock sema", 0);
-   if (event_status != VCOS_SUCCESS)
+   event_status = mmal_clock_event_create(private);
+   if (!event_status)
    {
-      LOG_ERROR("failed to create event semaphore %d", event_status);
+      LOG_ERROR("failed to create event %p", private);
       goto error;
    }
 
    private->request.list_free = mmal_list_create();
-   private->request.list_pending = mmal_list_create();
-   if (!private->request.list_free || !private->request.list_pending)
+   if (!private->request.list_free)
    {
-      LOG_ERROR("failed to create list %p %p", private->request.list_free, private->request.list_pending);
+      LOG_ERROR("failed to create list");
       goto error;
    }
 
    /* Populate the list of available request slots */
-   for (i = 0; i < CLOCK_REQUEST_SLOTS; ++i)
-      mmal_list_push_back(private->request.list_free, &private->request.pool[i].link);
+   if (!mmal_clock_request_slots_grow(private))
+   {
+      LOG_ERROR("failed to allocate request slots");
+      goto error;
+   }
 
    if (vcos_thread_create(&private->thread, "mmal-clock thread", NULL,
                           mmal_clock_worker_thread, private) != VCOS_SUCCESS)
@@ -487,10 +707,11 @@ static MMAL_STATUS_T mmal_clock_create_scheduling(MMAL_CLOCK_PRIVATE_T *private)
    return MMAL_SUCCESS;
 
 error:
-   if (event_status == VCOS_SUCCESS) vcos_semaphore_delete(&private->event);
+   if (event_status) mmal_clock_event_destroy(private);
    if (timer_status) mmal_clock_timer_destroy(&private->timer);
+   mmal_clock_request_slots_free(private);
    if (private->request.list_free) mmal_list_destroy(private->request.list_free);
-   if (private->request.list_pending) mmal_list_destroy(private->request.list_pending);
+   private->request.list_free = NULL;
    return MMAL_ENOSPC;
 }
 
@@ -501,10 +722,10 @@ static void mmal_clock_destroy_scheduling(MMAL_CLOCK_PRIVATE_T *private)
 
    mmal_clock_request_flush(&private->clock);
 
+   mmal_clock_request_slots_free(private);
    mmal_list_destroy(private->request.list_free);
-   mmal_list_destroy(private->request.list_pending);
 
-   vcos_semaphore_delete(&private->event);
+   mmal_clock_event_destroy(private);
 
    mmal_clock_timer_destroy(&private->timer);
 }
@@ -630,6 +851,8 @@ MMAL_STATUS_T mmal_clock_request_add(MMAL_CLOCK_T *clock, int64_t media_time,
    }
 
    request = (MMAL_CLOCK_REQUEST_T*)mmal_list_pop_front(private->request.list_free);
+   if (request == NULL && mmal_clock_request_slots_grow(private))
+      request = (MMAL_CLOCK_REQUEST_T*)mmal_list_pop_front(private->request.list_free);
    if (request == NULL)
    {
       LOG_ERROR("no more free clock request slots");
@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "core/mmal_component_private.h"
 #include "core/mmal_port_private.h"
 #include "core/mmal_core_private.h"
+#include "core/mmal_scheduler_private.h"
 #include "mmal_logging.h"
 
 /* Minimum number of buffers that will be available on the control port */
@@ -48,6 +49,10 @@ typedef struct
    VCOS_MUTEX_T action_mutex;
    MMAL_BOOL_T action_quit;
 
+   /** Task used instead of the action thread when the shared scheduler is enabled */
+   MMAL_SCHEDULER_TASK_T action_task;
+   MMAL_BOOL_T action_scheduled;
+
    VCOS_MUTEX_T lock; /**< Used to lock access to the component */
    MMAL_BOOL_T destruction_pending;
 
@@ -64,10 +69,13 @@ static MMAL_STATUS_T mmal_component_destroy_internal(MMAL_COMPONENT_T *component
 static MMAL_STATUS_T mmal_component_release_internal(MMAL_COMPONENT_T *component);
 
 /*****************************************************************************/
+static VCOS_ONCE_T mmal_core_once = VCOS_ONCE_INIT;
 static VCOS_MUTEX_T mmal_core_lock;
 /** Used to generate a unique id for each MMAL component in this context.    */
 static unsigned int mmal_core_instance_count;
 static unsigned int mmal_core_refcount;
+/** Number of scheduler worker threads requested by the client (-1 if not set) */
+static int mmal_core_scheduler_threads = -1;
 /*****************************************************************************/
 
 /** Create an instance of a component */
@@ -567,6 +575,17 @@ static void *mmal_component_action_thread_func(void *arg)
    return 0;
 }
 
+/** Runs the action of a component from one of the scheduler worker threads */
+static void mmal_component_action_task_func(void *arg)
+{
+   MMAL_COMPONENT_T *component = (MMAL_COMPONENT_T *)arg;
+   MMAL_COMPONENT_CORE_PRIVATE_T *private = (MMAL_COMPONENT_CORE_PRIVATE_T *)component->priv;
+
+   vcos_mutex_lock(&private->action_mutex);
+   private->pf_action(component);
+   vcos_mutex_unlock(&private->action_mutex);
+}
+
 /** Registers an action with the core */
 MMAL_STATUS_T mmal_component_action_register(MMAL_COMPONENT_T *component,
                                              void (*pf_action)(MMAL_COMPONENT_T *) )
@@ -578,6 +597,31 @@ MMAL_STATUS_T mmal_component_action_register(MMAL_COMPONENT_T *component,
    if (private->pf_action)
       return MMAL_EINVAL;
 
+   if (mmal_scheduler_enabled())
+   {
+      MMAL_STATUS_T task_status;
+
+      status = vcos_mutex_create(&private->action_mutex, component->name);
+      if (status != VCOS_SUCCESS)
+         return MMAL_ENOMEM;
+
+      /* Any pending trigger will only be acted upon once pf_action is set
+       * since the task runs under the action mutex */
+      vcos_mutex_lock(&private->action_mutex);
+      task_status = mmal_scheduler_task_create(&private->action_task, component->name,
+                                               mmal_component_action_task_func, component);
+      if (task_status != MMAL_SUCCESS)
+      {
+         vcos_mutex_unlock(&private->action_mutex);
+         vcos_mutex_delete(&private->action_mutex);
+         return task_status;
+      }
+      private->action_scheduled = MMAL_TRUE;
+      private->pf_action = pf_action;
+      vcos_mutex_unlock(&private->action_mutex);
+      return MMAL_SUCCESS;
+   }
+
    status = vcos_event_create(&private->action_event, component->name);
    if (status != VCOS_SUCCESS)
       return MMAL_ENOMEM;
@@ -613,6 +657,15 @@ MMAL_STATUS_T mmal_component_action_deregister(MMAL_COMPONENT_T *component)
    if (!private->pf_action)
       return MMAL_EINVAL;
 
+   if (private->action_scheduled)
+   {
+      mmal_scheduler_task_destroy(&private->action_task);
+      vcos_mutex_delete(&private->action_mutex);
+      private->pf_action = NULL;
+      private->action_scheduled = MMAL_FALSE;
+      return MMAL_SUCCESS;
+   }
+
    private->action_quit = 1;
    vcos_event_signal(&private->action_event);
    vcos_thread_join(&private->action_thread, NULL);
@@ -631,6 +684,12 @@ MMAL_STATUS_T mmal_component_action_trigger(MMAL_COMPONENT_T *component)
    if (!private->pf_action)
       return MMAL_EINVAL;
 
+   if (private->action_scheduled)
+   {
+      mmal_scheduler_task_trigger(&private->action_task);
+      return MMAL_SUCCESS;
+   }
+
    vcos_event_signal(&private->action_event);
    return MMAL_SUCCESS;
 }
@@ -667,11 +726,47 @@ static void mmal_core_init_once(void)
    vcos_mutex_create(&mmal_core_lock, VCOS_FUNCTION);
 }
 
+/** Number of scheduler worker threads to use.
+ * An explicit configuration takes precedence over the environment. */
+static unsigned int mmal_core_scheduler_threads_num(void)
+{
+   const char *env;
+   int threads;
+
+   if (mmal_core_scheduler_threads >= 0)
+      return mmal_core_scheduler_threads;
+
+   env = getenv(MMAL_SCHEDULER_THREADS_ENV);
+   if (!env)
+      return 0;
+
+   threads = atoi(env);
+   return threads > 0 ? threads : 0;
+}
+
+MMAL_STATUS_T mmal_component_scheduler_configure(unsigned int threads_num)
+{
+   MMAL_STATUS_T status = MMAL_SUCCESS;
+
+   vcos_init();
+   vcos_once(&mmal_core_once, mmal_core_init_once);
+
+   /* The execution model can't change under the feet of existing components */
+   vcos_mutex_lock(&mmal_core_lock);
+   if (mmal_core_refcount)
+      status = MMAL_EINVAL;
+   else
+      mmal_core_scheduler_threads = threads_num;
+   vcos_mutex_unlock(&mmal_core_lock);
+
+   vcos_deinit();
+   return status;
+}
+
 static void mmal_core_init(void)
 {
-   static VCOS_ONCE_T once = VCOS_ONCE_INIT;
    vcos_init();
-   vcos_once(&once, mmal_core_init_once);
+   vcos_once(&mmal_core_once, mmal_core_init_once);
 
    vcos_mutex_lock(&mmal_core_lock);
    if (mmal_core_refcount++)
@@ -681,6 +776,7 @@ static void mmal_core_init(void)
    }
 
    mmal_logging_init();
+   mmal_scheduler_init(mmal_core_scheduler_threads_num());
    vcos_mutex_unlock(&mmal_core_lock);
 }
 
@@ -693,6 +789,7 @@ static void mmal_core_deinit(void)
       return;
    }
 
+   mmal_scheduler_deinit();
    mmal_logging_deinit();
    vcos_mutex_unlock(&mmal_core_lock);
    vcos_deinit();
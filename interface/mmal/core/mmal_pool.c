@@ -30,6 +30,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "core/mmal_buffer_private.h"
 #include "mmal_logging.h"
 
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 /** Definition of a pool */
 typedef struct MMAL_POOL_PRIVATE_T
 {
@@ -47,13 +52,63 @@ typedef struct MMAL_POOL_PRIVATE_T
 
    unsigned int headers_alloc_num; /**< Number of buffer headers allocated as part of the private structure */
 
+   uint32_t flags;       /**< Creation flags (MMAL_POOL_FLAG_XXX) */
+   uint8_t *slab;        /**< Contiguous memory backing all the payloads (slab pools only) */
+   size_t slab_size;     /**< Size of the slab */
+   unsigned int queue_capacity; /**< Number of buffer headers the queue was created for */
+   uint32_t slab_stride; /**< Distance between 2 consecutive payloads in the slab */
+
 } MMAL_POOL_PRIVATE_T;
 
 #define ROUND_UP(s,align) ((((unsigned long)(s)) & ~((align)-1)) + (align))
 #define ALIGN  8
 
+/** Exact rounding, unlike ROUND_UP which always adds an alignment unit */
+#define ALIGN_UP(s,align) ((((size_t)(s)) + (align) - 1) & ~((size_t)(align) - 1))
+
+#define MMAL_POOL_SLAB_CACHE_LINE 64
+#define MMAL_POOL_SLAB_PAGE       4096
+#define MMAL_POOL_SLAB_HUGEPAGE   (2*1024*1024)
+
+/** Maximum number of bytes kept in the slab cache, overridable from the environment */
+#define MMAL_POOL_CACHE_SIZE_DEFAULT (64*1024*1024)
+#define MMAL_POOL_CACHE_SIZE_ENV     "MMAL_POOL_CACHE_SIZE"
+
+/** Slab sitting in the cache. The node lives at the start of the slab it describes. */
+typedef struct MMAL_POOL_SLAB_NODE_T
+{
+   struct MMAL_POOL_SLAB_NODE_T *next;
+   size_t size;
+   uint32_t flags;
+} MMAL_POOL_SLAB_NODE_T;
+
+/** Global cache of released slabs, ordered from most to least recently released */
+static struct {
+   VCOS_MUTEX_T lock;
+   MMAL_POOL_SLAB_NODE_T *list;
+   size_t size;      /**< Number of bytes currently held by the cache */
+   size_t size_max;  /**< Maximum number of bytes held by the cache */
+   unsigned int hits, misses;
+} mmal_pool_cache;
+static VCOS_ONCE_T mmal_pool_cache_once = VCOS_ONCE_INIT;
+
 static void mmal_pool_buffer_header_release(MMAL_BUFFER_HEADER_T *header);
 
+/** Create the queue of free buffer headers of a pool.
+ * With MMAL_POOL_FLAG_THREAD_CACHE, released buffer headers are cached per thread
+ * so that a thread recycling buffer headers in a loop doesn't have to go through
+ * the shared queue. */
+static MMAL_QUEUE_T *mmal_pool_queue_create(uint32_t flags, unsigned int headers)
+{
+   if (flags & MMAL_POOL_FLAG_THREAD_CACHE)
+      return mmal_queue_create_with_flags(MMAL_QUEUE_FLAG_LOCKFREE|MMAL_QUEUE_FLAG_THREAD_CACHE, headers);
+   return mmal_queue_create();
+}
+static MMAL_POOL_T *mmal_pool_create_with_allocator_and_flags(unsigned int headers, uint32_t payload_size,
+                              uint32_t flags, void *allocator_context,
+                              mmal_pool_allocator_alloc_t allocator_alloc,
+                              mmal_pool_allocator_free_t allocator_free);
+
 static void *mmal_pool_allocator_default_alloc(void *context, uint32_t size)
 {
    MMAL_PARAM_UNUSED(context);
@@ -66,6 +121,163 @@ static void mmal_pool_allocator_default_free(void *context, void *mem)
    vcos_free(mem);
 }
 
+static void mmal_pool_cache_init_once(void)
+{
+   const char *env = getenv(MMAL_POOL_CACHE_SIZE_ENV);
+
+   vcos_mutex_create(&mmal_pool_cache.lock, "mmal pool cache");
+   mmal_pool_cache.size_max = env ? (size_t)strtoul(env, NULL, 0) : MMAL_POOL_CACHE_SIZE_DEFAULT;
+}
+
+/** Allocate a new slab straight from the system */
+static void *mmal_pool_slab_map(size_t size, uint32_t flags)
+{
+#ifdef __linux__
+   void *mem = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+   if (flags & MMAL_POOL_FLAG_HUGEPAGES)
+      mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+   if (mem == MAP_FAILED)
+   {
+      mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      if (mem == MAP_FAILED)
+         return NULL;
+#ifdef MADV_HUGEPAGE
+      /* No reserved hugepages available, fall back to transparent ones */
+      if (flags & MMAL_POOL_FLAG_HUGEPAGES)
+         madvise(mem, size, MADV_HUGEPAGE);
+#endif
+   }
+   return mem;
+#else
+   MMAL_PARAM_UNUSED(flags);
+   return vcos_malloc_aligned(size, MMAL_POOL_SLAB_PAGE, "mmal_pool slab");
+#endif
+}
+
+/** Give a slab back to the system */
+static void mmal_pool_slab_unmap(void *mem, size_t size)
+{
+#ifdef __linux__
+   munmap(mem, size);
+#else
+   MMAL_PARAM_UNUSED(size);
+   vcos_free(mem);
+#endif
+}
+
+/** Get a slab of the given size, preferably from the cache */
+static void *mmal_pool_slab_alloc(size_t size, uint32_t flags)
+{
+   MMAL_POOL_SLAB_NODE_T *node, **prev;
+   uint32_t key = flags & MMAL_POOL_FLAG_HUGEPAGES;
+
+   vcos_once(&mmal_pool_cache_once, mmal_pool_cache_init_once);
+
+   vcos_mutex_lock(&mmal_pool_cache.lock);
+   for (prev = &mmal_pool_cache.list; *prev; prev = &(*prev)->next)
+      if ((*prev)->size == size && (*prev)->flags == key)
+         break;
+   node = *prev;
+   if (node)
+   {
+      *prev = node->next;
+      mmal_pool_cache.size -= size;
+      mmal_pool_cache.hits++;
+   }
+   else
+      mmal_pool_cache.misses++;
+   vcos_mutex_unlock(&mmal_pool_cache.lock);
+
+   if (node)
+   {
+      LOG_TRACE("reusing cached slab %p (%u bytes)", node, (unsigned int)size);
+      return node;
+   }
+
+   return mmal_pool_slab_map(size, flags);
+}
+
+/** Release a slab into the cache, evicting the least recently released slabs if needed */
+static void mmal_pool_slab_free(void *mem, size_t size, uint32_t flags)
+{
+   MMAL_POOL_SLAB_NODE_T *node = (MMAL_POOL_SLAB_NODE_T *)mem, *evict = NULL, **prev;
+
+   vcos_once(&mmal_pool_cache_once, mmal_pool_cache_init_once);
+
+   if (size > mmal_pool_cache.size_max || (flags & MMAL_POOL_FLAG_NO_CACHE))
+   {
+      mmal_pool_slab_unmap(mem, size);
+      return;
+   }
+
+   node->size = size;
+   node->flags = flags & MMAL_POOL_FLAG_HUGEPAGES;
+
+   vcos_mutex_lock(&mmal_pool_cache.lock);
+   node->next = mmal_pool_cache.list;
+   mmal_pool_cache.list = node;
+   mmal_pool_cache.size += size;
+
+   /* Detach the tail of the list which doesn't fit in the cache anymore */
+   if (mmal_pool_cache.size > mmal_pool_cache.size_max)
+   {
+      size_t kept = 0;
+      for (prev = &mmal_pool_cache.list; *prev; prev = &(*prev)->next)
+      {
+         if (kept + (*prev)->size > mmal_pool_cache.size_max)
+            break;
+         kept += (*prev)->size;
+      }
+      evict = *prev;
+      *prev = NULL;
+      mmal_pool_cache.size = kept;
+   }
+   vcos_mutex_unlock(&mmal_pool_cache.lock);
+
+   while (evict)
+   {
+      node = evict;
+      evict = node->next;
+      mmal_pool_slab_unmap(node, node->size);
+   }
+}
+
+/** Allocate the slab backing all the payloads of a pool */
+static MMAL_STATUS_T mmal_pool_slab_create(MMAL_POOL_PRIVATE_T *private, unsigned int headers)
+{
+   size_t size;
+
+   /* Keep every payload on its own cache lines (or pages for large payloads)
+    * so that neighbouring buffers never share a line between cores */
+   private->slab_stride = ALIGN_UP(private->payload_size,
+      private->payload_size >= MMAL_POOL_SLAB_PAGE ? MMAL_POOL_SLAB_PAGE : MMAL_POOL_SLAB_CACHE_LINE);
+   size = ALIGN_UP((size_t)private->slab_stride * headers, MMAL_POOL_SLAB_PAGE);
+   if (private->flags & MMAL_POOL_FLAG_HUGEPAGES)
+      size = ALIGN_UP(size, MMAL_POOL_SLAB_HUGEPAGE);
+
+   private->slab = mmal_pool_slab_alloc(size, private->flags);
+   if (!private->slab)
+   {
+      LOG_ERROR("failed to allocate %u bytes slab", (unsigned int)size);
+      return MMAL_ENOMEM;
+   }
+   private->slab_size = size;
+   return MMAL_SUCCESS;
+}
+
+/** Release the slab backing the payloads of a pool */
+static void mmal_pool_slab_destroy(MMAL_POOL_PRIVATE_T *private)
+{
+   if (!private->slab)
+      return;
+   mmal_pool_slab_free(private->slab, private->slab_size, private->flags);
+   private->slab = NULL;
+   private->slab_size = 0;
+}
+
 static MMAL_STATUS_T mmal_pool_initialise_buffer_headers(MMAL_POOL_T *pool, unsigned int headers,
                                                          MMAL_BOOL_T reinitialise)
 {
@@ -76,12 +288,20 @@ static MMAL_STATUS_T mmal_pool_initialise_buffer_headers(MMAL_POOL_T *pool, unsi
 
    header = (MMAL_BUFFER_HEADER_T *)((uint8_t *)pool->header + ROUND_UP(sizeof(void *)*headers,ALIGN));
 
+   if (private->payload_size && (private->flags & MMAL_POOL_FLAG_SLAB) && !private->slab &&
+       mmal_pool_slab_create(private, headers) != MMAL_SUCCESS)
+      return MMAL_ENOMEM;
+
    for (i = 0; i < headers; i++)
    {
       if (reinitialise)
          header = mmal_buffer_header_initialise(header, private->header_size);
 
-      if (private->payload_size && private->allocator_alloc)
+      if (private->payload_size && private->slab)
+      {
+         payload = private->slab + (size_t)private->slab_stride * i;
+      }
+      else if (private->payload_size && private->allocator_alloc)
       {
          LOG_TRACE("allocating %u bytes for payload %u/%u", private->payload_size, i, headers);
          payload = (uint8_t*)private->allocator_alloc(private->allocator_context, private->payload_size);
@@ -106,7 +326,8 @@ static MMAL_STATUS_T mmal_pool_initialise_buffer_headers(MMAL_POOL_T *pool, unsi
       header->priv->refcount = 1;
       header->priv->payload = payload;
       header->priv->payload_context = private->allocator_context;
-      header->priv->pf_payload_free = private->allocator_free;
+      /* Payloads carved out of a slab are released along with the slab */
+      header->priv->pf_payload_free = private->slab ? NULL : private->allocator_free;
       header->priv->payload_size = private->payload_size;
       pool->header[i] = header;
       pool->headers_num = i+1;
@@ -127,6 +348,22 @@ MMAL_POOL_T *mmal_pool_create(unsigned int headers, uint32_t payload_size)
 MMAL_POOL_T *mmal_pool_create_with_allocator(unsigned int headers, uint32_t payload_size,
                               void *allocator_context, mmal_pool_allocator_alloc_t allocator_alloc,
                               mmal_pool_allocator_free_t allocator_free)
+{
+   return mmal_pool_create_with_allocator_and_flags(headers, payload_size, 0,
+             allocator_context, allocator_alloc, allocator_free);
+}
+
+/** Create a pool of MMAL_BUFFER_HEADER_T */
+MMAL_POOL_T *mmal_pool_create_with_flags(unsigned int headers, uint32_t payload_size, uint32_t flags)
+{
+   return mmal_pool_create_with_allocator_and_flags(headers, payload_size, flags, NULL, NULL, NULL);
+}
+
+/** Create a pool of MMAL_BUFFER_HEADER_T */
+static MMAL_POOL_T *mmal_pool_create_with_allocator_and_flags(unsigned int headers, uint32_t payload_size,
+                              uint32_t flags, void *allocator_context,
+                              mmal_pool_allocator_alloc_t allocator_alloc,
+                              mmal_pool_allocator_free_t allocator_free)
 {
    unsigned int i, headers_array_size, header_size, pool_size;
    MMAL_POOL_PRIVATE_T *private;
@@ -134,7 +371,7 @@ MMAL_POOL_T *mmal_pool_create_with_allocator(unsigned int headers, uint32_t payl
    MMAL_POOL_T *pool;
    MMAL_QUEUE_T *queue;
 
-   queue = mmal_queue_create();
+   queue = mmal_pool_queue_create(flags, headers);
    if (!queue)
    {
       LOG_ERROR("failed to create queue");
@@ -164,6 +401,10 @@ MMAL_POOL_T *mmal_pool_create_with_allocator(unsigned int headers, uint32_t payl
    private->header_size = header_size;
    private->payload_size = payload_size;
    private->headers_alloc_num = headers;
+   private->queue_capacity = (mmal_queue_flags(queue) & MMAL_QUEUE_FLAG_LOCKFREE) ? headers : 0;
+   if (flags & MMAL_POOL_FLAG_HUGEPAGES)
+      flags |= MMAL_POOL_FLAG_SLAB;
+   private->flags = flags;
 
    /* Use default allocators if none has been specified by client */
    if (!allocator_alloc || !allocator_free)
@@ -173,6 +414,10 @@ MMAL_POOL_T *mmal_pool_create_with_allocator(unsigned int headers, uint32_t payl
       allocator_context = NULL;
    }
 
+   /* Slabs are carved by the pool itself so they can't be used with a client allocator */
+   if (allocator_alloc != mmal_pool_allocator_default_alloc)
+      private->flags &= ~(MMAL_POOL_FLAG_SLAB|MMAL_POOL_FLAG_HUGEPAGES);
+
    /* Keep reference to the allocator to allow resizing the payloads at a later point */
    private->allocator_alloc = allocator_alloc;
    private->allocator_free = allocator_free;
@@ -208,6 +453,7 @@ void mmal_pool_destroy(MMAL_POOL_T *pool)
       if (priv->pf_payload_free && priv->payload && priv->payload_size)
          priv->pf_payload_free(priv->payload_context, priv->payload);
    }
+   mmal_pool_slab_destroy((MMAL_POOL_PRIVATE_T *)pool);
 
    if (pool->header)
       vcos_free(pool->header);
@@ -236,6 +482,7 @@ MMAL_STATUS_T mmal_pool_resize(MMAL_POOL_T *pool, unsigned int headers, uint32_t
    /* Start by freeing the current payloads */
    private->payload_size = 0;
    mmal_pool_initialise_buffer_headers(pool, pool->headers_num, 0);
+   mmal_pool_slab_destroy(private);
    pool->headers_num = 0;
 
    /* Check if we need to reallocate the buffer headers themselves */
@@ -252,6 +499,17 @@ MMAL_STATUS_T mmal_pool_resize(MMAL_POOL_T *pool, unsigned int headers, uint32_t
       private->headers_alloc_num = headers;
    }
 
+   /* The ring behind a lock-free queue can't grow so replace it (it is empty at this point) */
+   if (private->queue_capacity && headers > private->queue_capacity)
+   {
+      MMAL_QUEUE_T *queue = mmal_pool_queue_create(private->flags, headers);
+      if (!queue)
+         return MMAL_ENOMEM;
+      mmal_queue_destroy(pool->queue);
+      pool->queue = queue;
+      private->queue_capacity = (mmal_queue_flags(queue) & MMAL_QUEUE_FLAG_LOCKFREE) ? headers : 0;
+   }
+
    /* Allocate the new payloads */
    private->payload_size = payload_size;
    mmal_pool_initialise_buffer_headers(pool, headers, 1);
@@ -301,3 +559,25 @@ void mmal_pool_pre_release_callback_set(MMAL_POOL_T *pool, MMAL_BH_PRE_RELEASE_C
       header = (MMAL_BUFFER_HEADER_T *)((uint8_t*)header + private->header_size);
    }
 }
+
+/** Release all the memory held in the slab cache */
+void mmal_pool_cache_flush(void)
+{
+   MMAL_POOL_SLAB_NODE_T *list, *node;
+
+   vcos_once(&mmal_pool_cache_once, mmal_pool_cache_init_once);
+
+   vcos_mutex_lock(&mmal_pool_cache.lock);
+   list = mmal_pool_cache.list;
+   mmal_pool_cache.list = NULL;
+   mmal_pool_cache.size = 0;
+   LOG_INFO("slab cache hits %u, misses %u", mmal_pool_cache.hits, mmal_pool_cache.misses);
+   vcos_mutex_unlock(&mmal_pool_cache.lock);
+
+   while (list)
+   {
+      node = list;
+      list = node->next;
+      mmal_pool_slab_unmap(node, node->size);
+   }
+}
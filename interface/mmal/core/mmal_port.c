@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "util/mmal_util.h"
 #include "core/mmal_component_private.h"
 #include "core/mmal_port_private.h"
+#include "core/mmal_buffer_private.h"
 #include "interface/vcos/vcos.h"
 #include "mmal_logging.h"
 #include "interface/mmal/util/mmal_util.h"
@@ -39,8 +40,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "vcfw/rtos/common/rtos_common_mem.h" /* mem_alloc */
 #endif
 
-/** Only collect port stats if enabled in build. Performance could be
- * affected on an ARM since gettimeofday() involves a system call.
+/** Only collect port stats if enabled in build. Collection doesn't take any
+ * lock but still reads the time for every buffer in both directions.
  */
 #if defined(MMAL_COLLECT_PORT_STATS)
 # define MMAL_COLLECT_PORT_STATS_ENABLED 1
@@ -57,12 +58,29 @@ static MMAL_STATUS_T mmal_port_private_parameter_set(MMAL_PORT_T *port,
 /* Define this if you want to log all buffer transfers */
 //#define ENABLE_MMAL_EXTRA_LOGGING
 
+/** Lock-free log-linear histogram of durations in microseconds */
+typedef struct MMAL_PORT_HISTOGRAM_T
+{
+   uint32_t count;
+   uint32_t min;
+   uint32_t max;
+   uint32_t bucket[MMAL_CORE_LATENCY_BUCKETS];
+} MMAL_PORT_HISTOGRAM_T;
+
+/** Statistics for one direction of a port. All fields are only ever
+ * accessed with atomic operations. */
+typedef struct MMAL_PORT_STATS_T
+{
+   MMAL_CORE_STATISTICS_T core;  /**< Same as reported by MMAL_PARAMETER_CORE_STATISTICS */
+   MMAL_PORT_HISTOGRAM_T gap;    /**< Time between consecutive buffers */
+   MMAL_PORT_HISTOGRAM_T transit;/**< Time between send and callback (TX only) */
+} MMAL_PORT_STATS_T;
+
 /** Definition of the core's private structure for a port. */
 typedef struct MMAL_PORT_PRIVATE_CORE_T
 {
    VCOS_MUTEX_T lock; /**< Used to lock access to the port */
    VCOS_MUTEX_T send_lock; /**< Used to lock access while sending buffer to the port */
-   VCOS_MUTEX_T stats_lock; /**< Used to lock access to the stats */
    VCOS_MUTEX_T connection_lock; /**< Used to lock access to a connection */
 
    /** Callback set by client to call when buffer headers need to be returned */
@@ -93,7 +111,8 @@ typedef struct MMAL_PORT_PRIVATE_CORE_T
    MMAL_BUFFER_HEADER_T** queue_last;
 
    /** Per-port statistics collected directly by the MMAL core */
-   MMAL_CORE_PORT_STATISTICS_T stats;
+   MMAL_PORT_STATS_T stats_rx;
+   MMAL_PORT_STATS_T stats_tx;
 
    char *name; /**< Port name */
    unsigned int name_size; /** Size of the memory area reserved for the name string */
@@ -116,7 +135,8 @@ static void mmal_port_connected_output_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_
 static MMAL_BOOL_T mmal_port_connected_pool_cb(MMAL_POOL_T *pool, MMAL_BUFFER_HEADER_T *buffer, void *userdata);
 
 static void mmal_port_name_update(MMAL_PORT_T *port);
-static void mmal_port_update_port_stats(MMAL_PORT_T *port, MMAL_CORE_STATS_DIR direction);
+static void mmal_port_update_port_stats(MMAL_PORT_T *port, MMAL_CORE_STATS_DIR direction,
+                                        MMAL_BUFFER_HEADER_T **buffers, unsigned int count);
 
 /*****************************************************************************/
 
@@ -144,6 +164,18 @@ static void mmal_port_update_port_stats(MMAL_PORT_T *port, MMAL_CORE_STATS_DIR d
    if (!--(a)->priv->core->transit_buffer_headers) \
       vcos_semaphore_post(&(a)->priv->core->transit_sema); \
    vcos_mutex_unlock(&(a)->priv->core->transit_lock)
+#define IN_TRANSIT_ADD(a,n) \
+   vcos_mutex_lock(&(a)->priv->core->transit_lock); \
+   if (!(a)->priv->core->transit_buffer_headers) \
+      vcos_semaphore_wait(&(a)->priv->core->transit_sema); \
+   (a)->priv->core->transit_buffer_headers += (n); \
+   vcos_mutex_unlock(&(a)->priv->core->transit_lock)
+#define IN_TRANSIT_SUB(a,n) \
+   vcos_mutex_lock(&(a)->priv->core->transit_lock); \
+   (a)->priv->core->transit_buffer_headers -= (n); \
+   if (!(a)->priv->core->transit_buffer_headers) \
+      vcos_semaphore_post(&(a)->priv->core->transit_sema); \
+   vcos_mutex_unlock(&(a)->priv->core->transit_lock)
 #define IN_TRANSIT_WAIT(a) \
    vcos_semaphore_wait(&(a)->priv->core->transit_sema); \
    vcos_semaphore_post(&(a)->priv->core->transit_sema)
@@ -163,7 +195,7 @@ MMAL_PORT_T *mmal_port_alloc(MMAL_COMPONENT_T *component, MMAL_PORT_TYPE_T type,
    unsigned int size = sizeof(*port) + sizeof(MMAL_PORT_PRIVATE_T) +
       sizeof(MMAL_PORT_PRIVATE_CORE_T) + name_size + extra_size;
    MMAL_BOOL_T lock = 0, lock_send = 0, lock_transit = 0, sema_transit = 0;
-   MMAL_BOOL_T lock_stats = 0, lock_connection = 0;
+   MMAL_BOOL_T lock_connection = 0;
 
    LOG_TRACE("component:%s type:%u extra:%u", component->name, type, extra_size);
 
@@ -191,13 +223,12 @@ MMAL_PORT_T *mmal_port_alloc(MMAL_COMPONENT_T *component, MMAL_PORT_TYPE_T type,
    lock_send = vcos_mutex_create(&port->priv->core->send_lock, "mmal port send lock") == VCOS_SUCCESS;
    lock_transit = vcos_mutex_create(&port->priv->core->transit_lock, "mmal port transit lock") == VCOS_SUCCESS;
    sema_transit = vcos_semaphore_create(&port->priv->core->transit_sema, "mmal port transit sema", 1) == VCOS_SUCCESS;
-   lock_stats = vcos_mutex_create(&port->priv->core->stats_lock, "mmal stats lock") == VCOS_SUCCESS;
    lock_connection = vcos_mutex_create(&port->priv->core->connection_lock, "mmal connection lock") == VCOS_SUCCESS;
 
-   if (!lock || !lock_send || !lock_transit || !sema_transit || !lock_stats || !lock_connection)
+   if (!lock || !lock_send || !lock_transit || !sema_transit || !lock_connection)
    {
-      LOG_ERROR("%s: failed to create sync objects (%u,%u,%u,%u,%u,%u)",
-            port->name, lock, lock_send, lock_transit, sema_transit, lock_stats, lock_connection);
+      LOG_ERROR("%s: failed to create sync objects (%u,%u,%u,%u,%u)",
+            port->name, lock, lock_send, lock_transit, sema_transit, lock_connection);
       goto error;
    }
 
@@ -217,7 +248,6 @@ MMAL_PORT_T *mmal_port_alloc(MMAL_COMPONENT_T *component, MMAL_PORT_TYPE_T type,
    if (lock_send) vcos_mutex_delete(&port->priv->core->send_lock);
    if (lock_transit) vcos_mutex_delete(&port->priv->core->transit_lock);
    if (sema_transit) vcos_semaphore_delete(&port->priv->core->transit_sema);
-   if (lock_stats) vcos_mutex_delete(&port->priv->core->stats_lock);
    if (lock_connection) vcos_mutex_delete(&port->priv->core->connection_lock);
    if (port->format) mmal_format_free(port->format);
    vcos_free(port);
@@ -235,7 +265,6 @@ void mmal_port_free(MMAL_PORT_T *port)
    vcos_assert(port->format == port->priv->core->format_ptr_copy);
    mmal_format_free(port->priv->core->format_ptr_copy);
    vcos_mutex_delete(&port->priv->core->connection_lock);
-   vcos_mutex_delete(&port->priv->core->stats_lock);
    vcos_semaphore_delete(&port->priv->core->transit_sema);
    vcos_mutex_delete(&port->priv->core->transit_lock);
    vcos_mutex_delete(&port->priv->core->send_lock);
@@ -748,6 +777,13 @@ MMAL_STATUS_T mmal_port_send_buffer(MMAL_PORT_T *port,
       buffer->length = 0;
    }
 
+   /* Stats are updated before the buffer is given away since the component
+    * might send it straight back to the client */
+   if (MMAL_COLLECT_PORT_STATS_ENABLED)
+   {
+      mmal_port_update_port_stats(port, MMAL_CORE_STATS_RX, &buffer, 1);
+   }
+
    /* coverity[lock] transit_sema is used for signalling, and is not a lock */
    /* coverity[lock_order] since transit_sema is not a lock, there is no ordering conflict */
    IN_TRANSIT_INCREMENT(port);
@@ -768,14 +804,121 @@ MMAL_STATUS_T mmal_port_send_buffer(MMAL_PORT_T *port,
    if (status != MMAL_SUCCESS)
    {
       IN_TRANSIT_DECREMENT(port);
+      if (MMAL_COLLECT_PORT_STATS_ENABLED)
+         __atomic_fetch_sub(&port->priv->core->stats_rx.core.buffer_count, 1, __ATOMIC_RELAXED);
       LOG_ERROR("%s: send failed: %s", port->name, mmal_status_to_string(status));
    }
+
+   UNLOCK_SENDING(port);
+   return status;
+}
+
+/** Send an array of buffer headers to a port */
+MMAL_STATUS_T mmal_port_send_buffers(MMAL_PORT_T *port,
+   MMAL_BUFFER_HEADER_T **buffers, unsigned int num)
+{
+   MMAL_STATUS_T status = MMAL_SUCCESS;
+   unsigned int i, sent = 0;
+
+   if (!port || !port->priv || !buffers)
+   {
+      LOG_ERROR("invalid port or buffers");
+      return MMAL_EINVAL;
+   }
+   if (!num)
+      return MMAL_SUCCESS;
+
+#ifdef ENABLE_MMAL_EXTRA_LOGGING
+   LOG_TRACE("%s(%i:%i) port %p, %u buffers", port->component->name,
+             (int)port->type, (int)port->index, port, num);
+#endif
+
+   for (i = 0; i < num; i++)
+   {
+      if (!buffers[i] || (buffers[i]->alloc_size && !buffers[i]->data &&
+          !(port->capabilities & MMAL_PORT_CAPABILITY_PASSTHROUGH)))
+      {
+         LOG_ERROR("%s(%p) received invalid buffer header", port->name, port);
+         return MMAL_EINVAL;
+      }
+   }
+
+   if (!port->priv->pf_send)
+      return MMAL_ENOSYS;
+
+   LOCK_SENDING(port);
+
+   if (!port->is_enabled)
+   {
+      UNLOCK_SENDING(port);
+      return MMAL_EINVAL;
+   }
+
+   if (port->type == MMAL_PORT_TYPE_OUTPUT)
+   {
+      for (i = 0; i < num; i++)
+      {
+         if (!buffers[i]->length)
+            continue;
+         LOG_DEBUG("given an output buffer with length != 0");
+         buffers[i]->length = 0;
+      }
+   }
+
+   if (MMAL_COLLECT_PORT_STATS_ENABLED)
+   {
+      mmal_port_update_port_stats(port, MMAL_CORE_STATS_RX, buffers, num);
+   }
+
+   /* coverity[lock] transit_sema is used for signalling, and is not a lock */
+   /* coverity[lock_order] since transit_sema is not a lock, there is no ordering conflict */
+   IN_TRANSIT_ADD(port, num);
+
+   if (port->priv->core->is_paused)
+   {
+      /* Add buffers to our internal queue */
+      for (i = 0; i < num; i++)
+      {
+         buffers[i]->next = NULL;
+         *port->priv->core->queue_last = buffers[i];
+         port->priv->core->queue_last = &buffers[i]->next;
+      }
+      sent = num;
+   }
+   else if (port->priv->pf_send_batch)
+   {
+      /* Send the whole batch to the component in one go */
+      status = port->priv->pf_send_batch(port, buffers, num);
+      if (status == MMAL_SUCCESS)
+         sent = num;
+   }
    else
    {
-      mmal_port_update_port_stats(port, MMAL_CORE_STATS_RX);
+      /* Fall back to sending buffers one by one */
+      for (; sent < num; sent++)
+      {
+         status = port->priv->pf_send(port, buffers[sent]);
+         if (status != MMAL_SUCCESS)
+            break;
+      }
+   }
+
+   if (sent != num)
+   {
+      IN_TRANSIT_SUB(port, num - sent);
+      if (MMAL_COLLECT_PORT_STATS_ENABLED)
+         __atomic_fetch_sub(&port->priv->core->stats_rx.core.buffer_count, num - sent,
+                            __ATOMIC_RELAXED);
+      LOG_ERROR("%s: send failed: %s (%u/%u sent)", port->name,
+                mmal_status_to_string(status), sent, num);
    }
 
    UNLOCK_SENDING(port);
+
+   /* Let the caller know which buffer headers it still owns */
+   for (i = 0; i < sent && status != MMAL_SUCCESS; i++)
+      buffers[i] = NULL;
+
    return status;
 }
 
@@ -819,9 +962,12 @@ MMAL_STATUS_T mmal_port_flush(MMAL_PORT_T *port)
 
    while (buffer)
    {
-      MMAL_BUFFER_HEADER_T *next = buffer->next;
-      mmal_port_buffer_header_callback(port, buffer);
-      buffer = next;
+      MMAL_BUFFER_HEADER_T *batch[MMAL_PORT_BUFFER_BATCH_MAX];
+      unsigned int num = 0;
+
+      for (; buffer && num < MMAL_PORT_BUFFER_BATCH_MAX; buffer = buffer->next)
+         batch[num++] = buffer;
+      mmal_port_buffer_headers_callback(port, batch, num);
    }
    return status;
 }
@@ -908,7 +1054,7 @@ void mmal_port_buffer_header_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *b
 
    if (MMAL_COLLECT_PORT_STATS_ENABLED)
    {
-      mmal_port_update_port_stats(port, MMAL_CORE_STATS_TX);
+      mmal_port_update_port_stats(port, MMAL_CORE_STATS_TX, &buffer, 1);
    }
 
    port->priv->core->buffer_header_callback(port, buffer);
@@ -916,6 +1062,38 @@ void mmal_port_buffer_header_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *b
    IN_TRANSIT_DECREMENT(port);
 }
 
+/** Buffer header callback for an array of buffer headers. */
+void mmal_port_buffer_headers_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T **buffers,
+                                       unsigned int num)
+{
+   unsigned int i;
+
+   if (!num)
+      return;
+
+#ifdef ENABLE_MMAL_EXTRA_LOGGING
+   LOG_TRACE("%s(%i:%i) port %p, %u buffers", port->component->name,
+             (int)port->type, (int)port->index, port, num);
+#endif
+
+   if (!vcos_verify(IN_TRANSIT_COUNT(port) >= (int32_t)num))
+      LOG_ERROR("%s: buffer headers in transit < %u (%d)", port->name, num,
+                (int)IN_TRANSIT_COUNT(port));
+
+   if (MMAL_COLLECT_PORT_STATS_ENABLED)
+   {
+      mmal_port_update_port_stats(port, MMAL_CORE_STATS_TX, buffers, num);
+   }
+
+   /* The buffers array can be modified by the client callback (e.g. the
+    * buffer header is sent straight back to the port) so we don't touch it
+    * after having given away a buffer header */
+   for (i = 0; i < num; i++)
+      port->priv->core->buffer_header_callback(port, buffers[i]);
+
+   IN_TRANSIT_SUB(port, num);
+}
+
 /** Event callback */
 void mmal_port_event_send(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
 {
@@ -1246,23 +1424,32 @@ static MMAL_STATUS_T mmal_port_populate_from_pool(MMAL_PORT_T* port, MMAL_POOL_T
 
    LOG_TRACE("%s port %p, pool: %p", port->name, port, pool);
 
-   /* Populate port from pool */
-   for (buffer_idx = 0; buffer_idx < port->buffer_num; buffer_idx++)
+   /* Populate port from pool, sending the buffers in batches */
+   for (buffer_idx = 0; buffer_idx < port->buffer_num && status == MMAL_SUCCESS; )
    {
-      buffer = mmal_queue_get(pool->queue);
-      if (!buffer)
+      MMAL_BUFFER_HEADER_T *batch[MMAL_PORT_BUFFER_BATCH_MAX];
+      unsigned int i, num = 0;
+
+      while (num < MMAL_PORT_BUFFER_BATCH_MAX && buffer_idx < port->buffer_num)
       {
-         LOG_ERROR("too few buffers in the pool");
-         status = MMAL_ENOMEM;
-         break;
+         buffer = mmal_queue_get(pool->queue);
+         if (!buffer)
+         {
+            LOG_ERROR("too few buffers in the pool");
+            status = MMAL_ENOMEM;
+            break;
+         }
+         batch[num++] = buffer;
+         buffer_idx++;
       }
 
-      status = mmal_port_send_buffer(port, buffer);
-      if (status != MMAL_SUCCESS)
+      if (mmal_port_send_buffers(port, batch, num) != MMAL_SUCCESS)
       {
-         LOG_ERROR("failed to send buffer to port");
-         mmal_buffer_header_release(buffer);
-         break;
+         LOG_ERROR("failed to send buffers to port");
+         status = MMAL_EINVAL;
+         for (i = 0; i < num; i++)
+            if (batch[i])
+               mmal_buffer_header_release(batch[i]);
       }
    }
 
@@ -1388,54 +1575,173 @@ static void mmal_port_name_update(MMAL_PORT_T *port)
             port->format && port->format->encoding ? (char *)&port->format->encoding : "");
 }
 
+/** Map a duration in microseconds to a histogram bucket.
+ * Values below 4us get their own bucket, then each power of 2 is split in 4. */
+static unsigned int mmal_port_histogram_bucket(uint32_t value)
+{
+   unsigned int msb;
+
+   if (value < 4)
+      return value;
+   msb = 31 - __builtin_clz(value);
+   return (msb - 1) * 4 + ((value >> (msb - 2)) & 3);
+}
+
+/** Smallest duration in microseconds falling in a given histogram bucket */
+static uint32_t mmal_port_histogram_bucket_start(unsigned int bucket)
+{
+   if (bucket < 4)
+      return bucket;
+   return (uint32_t)(4 + (bucket & 3)) << (bucket / 4 - 1);
+}
+
+static void mmal_port_histogram_add(MMAL_PORT_HISTOGRAM_T *histogram, uint32_t value)
+{
+   uint32_t current;
+
+   __atomic_fetch_add(&histogram->bucket[mmal_port_histogram_bucket(value)], 1, __ATOMIC_RELAXED);
+
+   /* min is stored off by one so that 0 means no samples yet */
+   current = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+   while ((!current || value + 1 < current) &&
+          !__atomic_compare_exchange_n(&histogram->min, &current, value + 1, 1,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+   current = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+   while (value > current &&
+          !__atomic_compare_exchange_n(&histogram->max, &current, value, 1,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+   __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+}
+
+/** Read (and optionally reset) a counter */
+static uint32_t mmal_port_stats_read(uint32_t *value, MMAL_BOOL_T reset)
+{
+   return reset ? __atomic_exchange_n(value, 0, __ATOMIC_RELAXED) :
+      __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+/** Take a snapshot of a histogram and work out its percentiles.
+ * The snapshot is not atomic as a whole, which is fine for statistics. */
+static void mmal_port_histogram_get(MMAL_PORT_HISTOGRAM_T *histogram, MMAL_CORE_LATENCY_T *latency,
+                                    MMAL_BOOL_T reset)
+{
+   static const unsigned int percentile[] = {50, 95, 99};
+   uint32_t *result[] = {&latency->p50, &latency->p95, &latency->p99};
+   uint64_t count = 0, total = 0;
+   unsigned int i, p = 0;
+
+   memset(latency, 0, sizeof(*latency));
+   for (i = 0; i < MMAL_CORE_LATENCY_BUCKETS; i++)
+   {
+      latency->histogram[i] = mmal_port_stats_read(&histogram->bucket[i], reset);
+      total += latency->histogram[i];
+   }
+   latency->count = mmal_port_stats_read(&histogram->count, reset);
+   latency->min = mmal_port_stats_read(&histogram->min, reset);
+   latency->min = latency->min ? latency->min - 1 : 0;
+   latency->max = mmal_port_stats_read(&histogram->max, reset);
+
+   /* Percentiles are reported as the upper bound of the bucket they fall in */
+   for (i = 0; i < MMAL_CORE_LATENCY_BUCKETS && total; i++)
+   {
+      count += latency->histogram[i];
+      while (p < vcos_countof(percentile) && count * 100 >= total * percentile[p])
+      {
+         *result[p] = i + 1 < MMAL_CORE_LATENCY_BUCKETS ?
+            mmal_port_histogram_bucket_start(i + 1) - 1 : latency->max;
+         *result[p] = MMAL_MIN(*result[p], latency->max);
+         p++;
+      }
+   }
+}
+
+static void mmal_port_get_core_stats_dir(MMAL_PORT_STATS_T *src, MMAL_CORE_STATISTICS_T *stats,
+                                         MMAL_BOOL_T reset)
+{
+   stats->buffer_count = mmal_port_stats_read(&src->core.buffer_count, reset);
+   stats->first_buffer_time = mmal_port_stats_read(&src->core.first_buffer_time, reset);
+   stats->last_buffer_time = mmal_port_stats_read(&src->core.last_buffer_time, reset);
+   stats->max_delay = mmal_port_stats_read(&src->core.max_delay, reset);
+}
+
 static MMAL_STATUS_T mmal_port_get_core_stats(MMAL_PORT_T *port, MMAL_PARAMETER_HEADER_T *param)
 {
    MMAL_PARAMETER_CORE_STATISTICS_T *stats_param = (MMAL_PARAMETER_CORE_STATISTICS_T*)param;
-   MMAL_CORE_STATISTICS_T *stats = &stats_param->stats;
-   MMAL_CORE_STATISTICS_T *src_stats;
    MMAL_PORT_PRIVATE_CORE_T *core = port->priv->core;
-   vcos_mutex_lock(&core->stats_lock);
-   switch (stats_param->dir)
-   {
-   case MMAL_CORE_STATS_RX:
-      src_stats = &port->priv->core->stats.rx;
-      break;
-   default:
-      src_stats = &port->priv->core->stats.tx;
-      break;
-   }
-   *stats = *src_stats;
-   if (stats_param->reset)
-      memset(src_stats, 0, sizeof(*src_stats));
-   vcos_mutex_unlock(&core->stats_lock);
+
+   mmal_port_get_core_stats_dir(stats_param->dir == MMAL_CORE_STATS_RX ?
+                                &core->stats_rx : &core->stats_tx,
+                                &stats_param->stats, stats_param->reset);
    return MMAL_SUCCESS;
 }
 
-/** Update the port stats, called per buffer.
- *
- */
-static void mmal_port_update_port_stats(MMAL_PORT_T *port, MMAL_CORE_STATS_DIR direction)
+static MMAL_STATUS_T mmal_port_get_core_latency_stats(MMAL_PORT_T *port, MMAL_PARAMETER_HEADER_T *param)
 {
+   MMAL_PARAMETER_CORE_LATENCY_STATISTICS_T *stats_param =
+      (MMAL_PARAMETER_CORE_LATENCY_STATISTICS_T*)param;
    MMAL_PORT_PRIVATE_CORE_T *core = port->priv->core;
-   MMAL_CORE_STATISTICS_T *stats;
-   unsigned stc = vcos_getmicrosecs();
+   MMAL_PORT_STATS_T *src;
 
-   vcos_mutex_lock(&core->stats_lock);
+   if (param->size < sizeof(*stats_param))
+      return MMAL_ENOSPC;
 
-   stats = direction == MMAL_CORE_STATS_RX ? &core->stats.rx : &core->stats.tx;
+   src = stats_param->dir == MMAL_CORE_STATS_RX ? &core->stats_rx : &core->stats_tx;
+   mmal_port_get_core_stats_dir(src, &stats_param->stats, stats_param->reset);
+   mmal_port_histogram_get(&src->gap, &stats_param->gap, stats_param->reset);
+   mmal_port_histogram_get(&src->transit, &stats_param->transit, stats_param->reset);
+   return MMAL_SUCCESS;
+}
 
-   stats->buffer_count++;
+/** Update the port stats, called per buffer or per batch of buffers.
+ * This doesn't take any lock so it is safe to call from any context.
+ */
+static void mmal_port_update_port_stats(MMAL_PORT_T *port, MMAL_CORE_STATS_DIR direction,
+                                        MMAL_BUFFER_HEADER_T **buffers, unsigned int count)
+{
+   MMAL_PORT_PRIVATE_CORE_T *core = port->priv->core;
+   MMAL_PORT_STATS_T *stats = direction == MMAL_CORE_STATS_RX ? &core->stats_rx : &core->stats_tx;
+   uint64_t now = vcos_getmicrosecs64();
+   uint32_t stc = (uint32_t)now, last, first = 0, gap, current;
+   unsigned int i;
 
-   if (!stats->first_buffer_time)
+   __atomic_fetch_add(&stats->core.buffer_count, count, __ATOMIC_RELAXED);
+
+   last = __atomic_exchange_n(&stats->core.last_buffer_time, stc, __ATOMIC_RELAXED);
+   if (!last)
    {
-      stats->last_buffer_time = stats->first_buffer_time = stc;
+      __atomic_compare_exchange_n(&stats->core.first_buffer_time, &first, stc, 0,
+                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED);
    }
    else
    {
-      stats->max_delay = vcos_max(stats->max_delay, stc-stats->last_buffer_time);
-      stats->last_buffer_time = stc;
+      gap = stc - last;
+      current = __atomic_load_n(&stats->core.max_delay, __ATOMIC_RELAXED);
+      while (gap > current &&
+             !__atomic_compare_exchange_n(&stats->core.max_delay, &current, gap, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+      /* Buffers of the same batch arrive at the same time */
+      mmal_port_histogram_add(&stats->gap, gap);
+      for (i = 1; i < count; i++)
+         mmal_port_histogram_add(&stats->gap, 0);
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      MMAL_BUFFER_HEADER_T *buffer = buffers[i];
+      if (!buffer->priv)
+         continue;
+
+      if (direction == MMAL_CORE_STATS_RX)
+      {
+         buffer->priv->send_time = now;
+      }
+      else if (buffer->priv->send_time)
+      {
+         mmal_port_histogram_add(&stats->transit, (uint32_t)(now - buffer->priv->send_time));
+         buffer->priv->send_time = 0;
+      }
    }
-   vcos_mutex_unlock(&core->stats_lock);
 }
 
 static MMAL_STATUS_T mmal_port_private_parameter_get(MMAL_PORT_T *port,
@@ -1445,6 +1751,8 @@ static MMAL_STATUS_T mmal_port_private_parameter_get(MMAL_PORT_T *port,
    {
    case MMAL_PARAMETER_CORE_STATISTICS:
       return mmal_port_get_core_stats(port, param);
+   case MMAL_PARAMETER_CORE_LATENCY_STATISTICS:
+      return mmal_port_get_core_latency_stats(port, param);
    default:
       return MMAL_ENOSYS;
    }
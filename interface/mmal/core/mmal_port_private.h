@@ -50,6 +50,10 @@ typedef struct MMAL_PORT_PRIVATE_T
    MMAL_STATUS_T (*pf_enable)(MMAL_PORT_T *port, MMAL_PORT_BH_CB_T);
    MMAL_STATUS_T (*pf_disable)(MMAL_PORT_T *port);
    MMAL_STATUS_T (*pf_send)(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *);
+   /** Optional. Send an array of buffer headers in one go. Must either accept
+    * all of them or fail without having accepted any. The core falls back
+    * to pf_send when this isn't implemented. */
+   MMAL_STATUS_T (*pf_send_batch)(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T **, unsigned int num);
    MMAL_STATUS_T (*pf_flush)(MMAL_PORT_T *port);
    MMAL_STATUS_T (*pf_parameter_set)(MMAL_PORT_T *port, const MMAL_PARAMETER_HEADER_T *param);
    MMAL_STATUS_T (*pf_parameter_get)(MMAL_PORT_T *port, MMAL_PARAMETER_HEADER_T *param);
@@ -64,6 +68,12 @@ typedef struct MMAL_PORT_PRIVATE_T
  * user */
 void mmal_port_buffer_header_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer);
 
+/** Callback called by components when an array of \ref MMAL_BUFFER_HEADER_T needs to be sent
+ * back to the user. This is equivalent to calling \ref mmal_port_buffer_header_callback for
+ * each buffer header but the core only does its book-keeping once per batch. */
+void mmal_port_buffer_headers_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T **buffers,
+                                       unsigned int num);
+
 /** Callback called by components when an event \ref MMAL_BUFFER_HEADER_T needs to be sent to the
  * user. Events differ from ordinary buffer headers because they originate from the component
  * and do not return data from the client to the component. */
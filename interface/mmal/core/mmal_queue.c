@@ -27,6 +27,85 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "mmal.h"
 #include "mmal_queue.h"
+#include "mmal_logging.h"
+
+#if defined(__linux__) && defined(__GNUC__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#define MMAL_QUEUE_HAVE_LOCKFREE
+#endif
+
+#define MMAL_QUEUE_CACHE_LINE 64
+
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+/** Maximum number of buffer headers cached by a thread for a given queue */
+#define MMAL_QUEUE_MAGAZINE_SIZE 16
+
+/** Per-thread cache of buffer headers sitting in front of a lock-free queue.
+ * The magazine is owned by the thread which created it and referenced by the
+ * queue so that other threads can steal from it when the ring runs dry. It is
+ * freed by whichever of the two lets go of it last. */
+typedef struct MMAL_QUEUE_MAGAZINE_T
+{
+   struct MMAL_QUEUE_MAGAZINE_T *next;        /**< Next magazine of the queue */
+   struct MMAL_QUEUE_MAGAZINE_T *thread_next; /**< Next magazine of the owner thread */
+   struct MMAL_QUEUE_T *queue; /**< Queue the magazine belongs to, NULL once destroyed */
+   uint32_t lock;              /**< Only contended when another thread steals */
+   uint32_t refcount;
+   uint32_t orphan;            /**< The owner thread has exited */
+   unsigned int count;
+   MMAL_BUFFER_HEADER_T *buffer[MMAL_QUEUE_MAGAZINE_SIZE];
+} MMAL_QUEUE_MAGAZINE_T;
+
+/** Slot of the lock-free ring.
+ * The sequence number tells producers and consumers whose turn it is to
+ * use the slot (see Dmitry Vyukov's bounded MPMC queue). */
+typedef struct MMAL_QUEUE_CELL_T
+{
+   uint32_t seq;
+   MMAL_BUFFER_HEADER_T *buffer;
+} MMAL_QUEUE_CELL_T;
+
+/** State of a lock-free queue.
+ * Producer and consumer positions live on separate cache lines so that
+ * a producer and a consumer running on different cores don't bounce the
+ * same line around. */
+typedef struct MMAL_QUEUE_LOCKFREE_T
+{
+   uint32_t enqueue_pos __attribute__((aligned(MMAL_QUEUE_CACHE_LINE)));
+   uint32_t dequeue_pos __attribute__((aligned(MMAL_QUEUE_CACHE_LINE)));
+
+   /* Wait path. Only touched by waiters and by producers when waiters exist */
+   uint32_t event __attribute__((aligned(MMAL_QUEUE_CACHE_LINE))); /**< Futex word */
+   uint32_t waiters;
+
+   /* Buffer headers put back at the front of the queue. This is a rare
+    * operation so a simple spinlock protected stack is good enough */
+   uint32_t front_lock;
+   MMAL_BUFFER_HEADER_T *front;
+   unsigned int front_length;
+
+   /* Buffer headers which didn't fit in the ring. This only happens when the
+    * client breaks its promise on the capacity of the queue. Protected by
+    * the front lock and drained once the ring is empty so order is kept. */
+   MMAL_BUFFER_HEADER_T *overflow;
+   MMAL_BUFFER_HEADER_T **overflow_last;
+   unsigned int overflow_length;
+
+   uint32_t mask;
+   MMAL_QUEUE_CELL_T *cells;
+
+   /* Per-thread caches (MMAL_QUEUE_FLAG_THREAD_CACHE) */
+   unsigned int magazine_size;        /**< Maximum number of buffer headers per magazine */
+   uint32_t magazines_lock;
+   MMAL_QUEUE_MAGAZINE_T *magazines;
+} MMAL_QUEUE_LOCKFREE_T;
+#endif
 
 /** Definition of the QUEUE */
 struct MMAL_QUEUE_T
@@ -36,6 +115,11 @@ struct MMAL_QUEUE_T
    MMAL_BUFFER_HEADER_T *first;
    MMAL_BUFFER_HEADER_T **last;
    VCOS_SEMAPHORE_T semaphore;
+
+   uint32_t flags; /**< MMAL_QUEUE_FLAG_XXX flags the queue was created with */
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   MMAL_QUEUE_LOCKFREE_T *lockfree; /**< Non-NULL for lock-free queues */
+#endif
 };
 
 // Only sanity check if asserts are enabled
@@ -55,13 +139,592 @@ static void mmal_queue_sanity_check(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *b
 #define mmal_queue_sanity_check(q,b)
 #endif
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+/*****************************************************************************
+ * Lock-free implementation
+ *****************************************************************************/
+
+static void mmal_queue_futex_wake(uint32_t *addr)
+{
+   syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void mmal_queue_futex_wait(uint32_t *addr, uint32_t value, const struct timespec *timeout)
+{
+   syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, timeout, NULL, 0);
+}
+
+static MMAL_QUEUE_LOCKFREE_T *mmal_queue_lockfree_create(unsigned int capacity)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf;
+   unsigned int i, size = 2;
+
+   /* The ring size needs to be a power of 2 */
+   while (size < capacity)
+      size <<= 1;
+
+   lf = vcos_malloc_aligned(sizeof(*lf), MMAL_QUEUE_CACHE_LINE, "MMAL lock-free queue");
+   if (!lf)
+      return NULL;
+   memset(lf, 0, sizeof(*lf));
+
+   lf->cells = vcos_malloc_aligned(size * sizeof(*lf->cells), MMAL_QUEUE_CACHE_LINE,
+                                   "MMAL lock-free queue cells");
+   if (!lf->cells)
+   {
+      vcos_free(lf);
+      return NULL;
+   }
+
+   for (i = 0; i < size; i++)
+   {
+      lf->cells[i].seq = i;
+      lf->cells[i].buffer = NULL;
+   }
+   lf->mask = size - 1;
+   lf->overflow_last = &lf->overflow;
+   return lf;
+}
+
+static void mmal_queue_lockfree_destroy(MMAL_QUEUE_LOCKFREE_T *lf)
+{
+   vcos_free(lf->cells);
+   vcos_free(lf);
+}
+
+/** Try to add a buffer header at the end of the ring. Fails if the ring is full. */
+static MMAL_BOOL_T mmal_queue_lockfree_push(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_QUEUE_CELL_T *cell;
+   uint32_t pos, seq;
+   int32_t diff;
+
+   pos = __atomic_load_n(&lf->enqueue_pos, __ATOMIC_RELAXED);
+   for (;;)
+   {
+      cell = &lf->cells[pos & lf->mask];
+      seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      diff = (int32_t)(seq - pos);
+      if (diff < 0)
+         return MMAL_FALSE; /* Full */
+      if (diff > 0)
+      {
+         pos = __atomic_load_n(&lf->enqueue_pos, __ATOMIC_RELAXED);
+         continue;
+      }
+
+      if (queue->flags & MMAL_QUEUE_FLAG_SINGLE_PRODUCER)
+      {
+         __atomic_store_n(&lf->enqueue_pos, pos + 1, __ATOMIC_RELAXED);
+         break;
+      }
+      if (__atomic_compare_exchange_n(&lf->enqueue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+         break;
+   }
+
+   cell->buffer = buffer;
+   __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+   return MMAL_TRUE;
+}
+
+/** Try to take the buffer header at the front of the ring. */
+static MMAL_BUFFER_HEADER_T *mmal_queue_lockfree_pop(MMAL_QUEUE_T *queue)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_BUFFER_HEADER_T *buffer;
+   MMAL_QUEUE_CELL_T *cell;
+   uint32_t pos, seq;
+   int32_t diff;
+
+   pos = __atomic_load_n(&lf->dequeue_pos, __ATOMIC_RELAXED);
+   for (;;)
+   {
+      cell = &lf->cells[pos & lf->mask];
+      seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      diff = (int32_t)(seq - (pos + 1));
+      if (diff < 0)
+         return NULL; /* Empty */
+      if (diff > 0)
+      {
+         pos = __atomic_load_n(&lf->dequeue_pos, __ATOMIC_RELAXED);
+         continue;
+      }
+
+      if (queue->flags & MMAL_QUEUE_FLAG_SINGLE_CONSUMER)
+      {
+         __atomic_store_n(&lf->dequeue_pos, pos + 1, __ATOMIC_RELAXED);
+         break;
+      }
+      if (__atomic_compare_exchange_n(&lf->dequeue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+         break;
+   }
+
+   buffer = cell->buffer;
+   __atomic_store_n(&cell->seq, pos + lf->mask + 1, __ATOMIC_RELEASE);
+   return buffer;
+}
+
+static void mmal_queue_lockfree_front_lock(MMAL_QUEUE_LOCKFREE_T *lf)
+{
+   while (__atomic_exchange_n(&lf->front_lock, 1, __ATOMIC_ACQUIRE))
+      while (__atomic_load_n(&lf->front_lock, __ATOMIC_RELAXED))
+         /* spin */;
+}
+
+static void mmal_queue_lockfree_front_unlock(MMAL_QUEUE_LOCKFREE_T *lf)
+{
+   __atomic_store_n(&lf->front_lock, 0, __ATOMIC_RELEASE);
+}
+
+/** Take the oldest buffer header from the overflow list */
+static MMAL_BUFFER_HEADER_T *mmal_queue_lockfree_overflow_get(MMAL_QUEUE_LOCKFREE_T *lf)
+{
+   MMAL_BUFFER_HEADER_T *buffer;
+
+   mmal_queue_lockfree_front_lock(lf);
+   buffer = lf->overflow;
+   if (buffer)
+   {
+      lf->overflow = buffer->next;
+      if (!lf->overflow)
+         lf->overflow_last = &lf->overflow;
+      __atomic_store_n(&lf->overflow_length, lf->overflow_length - 1, __ATOMIC_RELAXED);
+   }
+   mmal_queue_lockfree_front_unlock(lf);
+   return buffer;
+}
+
+/** Get a buffer header without blocking. Buffer headers which have been put
+ * back take precedence over the ones in the ring, which are older than the
+ * ones in the overflow list. */
+static MMAL_BUFFER_HEADER_T *mmal_queue_lockfree_get(MMAL_QUEUE_T *queue)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_BUFFER_HEADER_T *buffer = NULL;
+
+   if (__atomic_load_n(&lf->front_length, __ATOMIC_ACQUIRE))
+   {
+      mmal_queue_lockfree_front_lock(lf);
+      buffer = lf->front;
+      if (buffer)
+      {
+         lf->front = buffer->next;
+         __atomic_store_n(&lf->front_length, lf->front_length - 1, __ATOMIC_RELAXED);
+      }
+      mmal_queue_lockfree_front_unlock(lf);
+   }
+
+   if (!buffer)
+      buffer = mmal_queue_lockfree_pop(queue);
+   if (!buffer && __atomic_load_n(&lf->overflow_length, __ATOMIC_ACQUIRE))
+      buffer = mmal_queue_lockfree_overflow_get(lf);
+   if (!buffer)
+      return NULL;
+
+   buffer->next = NULL;
+   __atomic_fetch_sub(&queue->length, 1, __ATOMIC_RELAXED);
+   return buffer;
+}
+
+/** Signal a waiter, if any, that the queue isn't empty anymore */
+static void mmal_queue_lockfree_signal(MMAL_QUEUE_T *queue)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+
+   /* Pairs with the increment of the waiters count in mmal_queue_lockfree_wait */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (!__atomic_load_n(&lf->waiters, __ATOMIC_RELAXED))
+      return;
+
+   __atomic_fetch_add(&lf->event, 1, __ATOMIC_RELEASE);
+   mmal_queue_futex_wake(&lf->event);
+}
+
+static void mmal_queue_lockfree_put(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+
+   buffer->next = NULL;
+   if (__atomic_load_n(&lf->overflow_length, __ATOMIC_ACQUIRE) ||
+       !mmal_queue_lockfree_push(queue, buffer))
+   {
+      /* The ring is sized when the queue is created so this means the
+       * client is using more buffer headers than it told us about. Keep
+       * the buffer header on the side rather than waiting for room. */
+      vcos_assert(lf->overflow_length || !"lock-free queue overflow");
+      mmal_queue_lockfree_front_lock(lf);
+      if (!lf->overflow_length)
+         LOG_ERROR("lock-free queue %p is full (capacity %u)", queue, lf->mask + 1);
+      *lf->overflow_last = buffer;
+      lf->overflow_last = &buffer->next;
+      __atomic_store_n(&lf->overflow_length, lf->overflow_length + 1, __ATOMIC_RELEASE);
+      mmal_queue_lockfree_front_unlock(lf);
+   }
+
+   /* Increment the length only once the buffer is visible to consumers so
+    * that a non-zero length guarantees a single consumer a successful get */
+   __atomic_fetch_add(&queue->length, 1, __ATOMIC_RELEASE);
+   mmal_queue_lockfree_signal(queue);
+}
+
+static void mmal_queue_lockfree_put_back(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+
+   mmal_queue_lockfree_front_lock(lf);
+   buffer->next = lf->front;
+   lf->front = buffer;
+   __atomic_store_n(&lf->front_length, lf->front_length + 1, __ATOMIC_RELEASE);
+   mmal_queue_lockfree_front_unlock(lf);
+
+   __atomic_fetch_add(&queue->length, 1, __ATOMIC_RELEASE);
+   mmal_queue_lockfree_signal(queue);
+}
+
+/*****************************************************************************
+ * Per-thread caches of buffer headers
+ *****************************************************************************/
+
+/** Magazines of the calling thread, most recently used first */
+static __thread MMAL_QUEUE_MAGAZINE_T *mmal_queue_thread_magazines;
+static pthread_key_t mmal_queue_thread_key;
+static pthread_once_t mmal_queue_thread_once = PTHREAD_ONCE_INIT;
+
+static void mmal_queue_spin_lock(uint32_t *lock)
+{
+   while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+      while (__atomic_load_n(lock, __ATOMIC_RELAXED))
+         sched_yield(); /* The holder might have been preempted */
+}
+
+static void mmal_queue_spin_unlock(uint32_t *lock)
+{
+   __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+static void mmal_queue_magazine_release(MMAL_QUEUE_MAGAZINE_T *mag)
+{
+   if (!__atomic_sub_fetch(&mag->refcount, 1, __ATOMIC_ACQ_REL))
+      vcos_free(mag);
+}
+
+/** Move all the buffer headers of a magazine to the ring. Magazine lock must be held. */
+static void mmal_queue_magazine_flush(MMAL_QUEUE_T *queue, MMAL_QUEUE_MAGAZINE_T *mag)
+{
+   while (mag->count)
+      mmal_queue_lockfree_put(queue, mag->buffer[--mag->count]);
+}
+
+/** Give back the buffer headers cached by a thread when it exits */
+static void mmal_queue_thread_exit(void *value)
+{
+   MMAL_QUEUE_MAGAZINE_T *mag;
+   MMAL_PARAM_UNUSED(value);
+
+   while ((mag = mmal_queue_thread_magazines) != NULL)
+   {
+      mmal_queue_thread_magazines = mag->thread_next;
+
+      /* Holding the magazine lock keeps the queue from being destroyed under our feet */
+      mmal_queue_spin_lock(&mag->lock);
+      if (mag->queue)
+         mmal_queue_magazine_flush(mag->queue, mag);
+      __atomic_store_n(&mag->orphan, 1, __ATOMIC_RELEASE);
+      mmal_queue_spin_unlock(&mag->lock);
+      mmal_queue_magazine_release(mag);
+   }
+}
+
+static void mmal_queue_thread_init_once(void)
+{
+   pthread_key_create(&mmal_queue_thread_key, mmal_queue_thread_exit);
+}
+
+/** Find the magazine of the calling thread for a queue, optionally creating it */
+static MMAL_QUEUE_MAGAZINE_T *mmal_queue_magazine_get(MMAL_QUEUE_T *queue, MMAL_BOOL_T create)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_QUEUE_MAGAZINE_T *mag, **prev = &mmal_queue_thread_magazines;
+
+   while ((mag = *prev) != NULL)
+   {
+      MMAL_QUEUE_T *owner = __atomic_load_n(&mag->queue, __ATOMIC_ACQUIRE);
+
+      if (owner == queue)
+      {
+         /* Keep the magazines of busy queues at the front */
+         if (prev != &mmal_queue_thread_magazines)
+         {
+            *prev = mag->thread_next;
+            mag->thread_next = mmal_queue_thread_magazines;
+            mmal_queue_thread_magazines = mag;
+         }
+         return mag;
+      }
+
+      if (!owner)
+      {
+         /* The queue has been destroyed */
+         *prev = mag->thread_next;
+         mmal_queue_magazine_release(mag);
+         continue;
+      }
+      prev = &mag->thread_next;
+   }
+
+   if (!create)
+      return NULL;
+
+   pthread_once(&mmal_queue_thread_once, mmal_queue_thread_init_once);
+
+   mag = vcos_calloc(1, sizeof(*mag), "MMAL queue magazine");
+   if (!mag)
+      return NULL;
+   mag->queue = queue;
+   mag->refcount = 2; /* One for the thread, one for the queue */
+
+   mmal_queue_spin_lock(&lf->magazines_lock);
+   mag->next = lf->magazines;
+   lf->magazines = mag;
+   mmal_queue_spin_unlock(&lf->magazines_lock);
+
+   mag->thread_next = mmal_queue_thread_magazines;
+   mmal_queue_thread_magazines = mag;
+   /* Only used to get a callback on thread exit */
+   pthread_setspecific(mmal_queue_thread_key, mag);
+   return mag;
+}
+
+/** Cache a buffer header in the calling thread's magazine */
+static void mmal_queue_magazine_put(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_QUEUE_MAGAZINE_T *mag = mmal_queue_magazine_get(queue, MMAL_TRUE);
+
+   if (!mag)
+   {
+      mmal_queue_lockfree_put(queue, buffer);
+      return;
+   }
+
+   buffer->next = NULL;
+   mmal_queue_spin_lock(&mag->lock);
+   /* Hand a full magazine over to the other threads in one go */
+   if (mag->count >= lf->magazine_size)
+      mmal_queue_magazine_flush(queue, mag);
+   mag->buffer[mag->count++] = buffer;
+   mmal_queue_spin_unlock(&mag->lock);
+
+   /* Someone is waiting for a buffer header so don't keep it to ourselves.
+    * Pairs with the increment of the waiters count in mmal_queue_lockfree_wait. */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&lf->waiters, __ATOMIC_RELAXED))
+   {
+      mmal_queue_spin_lock(&mag->lock);
+      mmal_queue_magazine_flush(queue, mag);
+      mmal_queue_spin_unlock(&mag->lock);
+   }
+}
+
+/** Refill the calling thread's magazine from the magazine of another thread */
+static MMAL_BUFFER_HEADER_T *mmal_queue_magazine_steal(MMAL_QUEUE_T *queue, MMAL_QUEUE_MAGAZINE_T *own)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_QUEUE_MAGAZINE_T *mag, **prev, *dead = NULL;
+   MMAL_BUFFER_HEADER_T *buffer = NULL;
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   mmal_queue_spin_lock(&lf->magazines_lock);
+   for (prev = &lf->magazines; !buffer && (mag = *prev) != NULL; )
+   {
+      if (mag == own || !__atomic_load_n(&mag->count, __ATOMIC_RELAXED))
+      {
+         /* Magazines of exited threads are empty and can go */
+         if (mag != own && __atomic_load_n(&mag->orphan, __ATOMIC_ACQUIRE))
+         {
+            *prev = mag->next;
+            mag->next = dead;
+            dead = mag;
+            continue;
+         }
+         prev = &mag->next;
+         continue;
+      }
+
+      mmal_queue_spin_lock(&mag->lock);
+      if (mag->count)
+      {
+         buffer = mag->buffer[--mag->count];
+         if (own)
+         {
+            /* Take the whole magazine to amortise the cost of stealing */
+            mmal_queue_spin_lock(&own->lock);
+            while (mag->count && own->count < lf->magazine_size)
+               own->buffer[own->count++] = mag->buffer[--mag->count];
+            mmal_queue_spin_unlock(&own->lock);
+         }
+      }
+      mmal_queue_spin_unlock(&mag->lock);
+      prev = &mag->next;
+   }
+   mmal_queue_spin_unlock(&lf->magazines_lock);
+
+   while ((mag = dead) != NULL)
+   {
+      dead = mag->next;
+      mmal_queue_magazine_release(mag);
+   }
+   return buffer;
+}
+
+/** Get a buffer header from the calling thread's magazine, the ring, or another thread's magazine */
+static MMAL_BUFFER_HEADER_T *mmal_queue_magazine_get_buffer(MMAL_QUEUE_T *queue)
+{
+   MMAL_QUEUE_MAGAZINE_T *mag = mmal_queue_magazine_get(queue, MMAL_FALSE);
+   MMAL_BUFFER_HEADER_T *buffer = NULL;
+
+   if (mag && __atomic_load_n(&mag->count, __ATOMIC_RELAXED))
+   {
+      mmal_queue_spin_lock(&mag->lock);
+      if (mag->count)
+         buffer = mag->buffer[--mag->count];
+      mmal_queue_spin_unlock(&mag->lock);
+      if (buffer)
+         return buffer;
+   }
+
+   buffer = mmal_queue_lockfree_get(queue);
+   if (!buffer)
+      buffer = mmal_queue_magazine_steal(queue, mag);
+   return buffer;
+}
+
+/** Number of buffer headers sitting in magazines */
+static unsigned int mmal_queue_magazines_length(MMAL_QUEUE_T *queue)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_QUEUE_MAGAZINE_T *mag;
+   unsigned int length = 0;
+
+   mmal_queue_spin_lock(&lf->magazines_lock);
+   for (mag = lf->magazines; mag; mag = mag->next)
+      length += __atomic_load_n(&mag->count, __ATOMIC_RELAXED);
+   mmal_queue_spin_unlock(&lf->magazines_lock);
+   return length;
+}
+
+/** Detach all the magazines from a queue which is being destroyed */
+static void mmal_queue_magazines_destroy(MMAL_QUEUE_T *queue)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_QUEUE_MAGAZINE_T *mag;
+
+   mmal_queue_spin_lock(&lf->magazines_lock);
+   while ((mag = lf->magazines) != NULL)
+   {
+      lf->magazines = mag->next;
+      mmal_queue_spin_lock(&mag->lock);
+      __atomic_store_n(&mag->queue, NULL, __ATOMIC_RELEASE);
+      mag->count = 0;
+      mmal_queue_spin_unlock(&mag->lock);
+      mmal_queue_magazine_release(mag);
+   }
+   mmal_queue_spin_unlock(&lf->magazines_lock);
+}
+
+/** Get a buffer header without blocking */
+static MMAL_BUFFER_HEADER_T *mmal_queue_lockfree_get_any(MMAL_QUEUE_T *queue)
+{
+   if (queue->lockfree->magazine_size)
+      return mmal_queue_magazine_get_buffer(queue);
+   return mmal_queue_lockfree_get(queue);
+}
+
+/** Wait for a buffer header. Only sleeps in the kernel if the queue is empty.
+ * A timeout of VCOS_SUSPEND means waiting forever. */
+static MMAL_BUFFER_HEADER_T *mmal_queue_lockfree_wait(MMAL_QUEUE_T *queue, VCOS_UNSIGNED timeout)
+{
+   MMAL_QUEUE_LOCKFREE_T *lf = queue->lockfree;
+   MMAL_BUFFER_HEADER_T *buffer;
+   uint64_t deadline = 0, now;
+   struct timespec ts, *pts = NULL;
+   uint32_t event;
+
+   buffer = mmal_queue_lockfree_get_any(queue);
+   if (buffer)
+      return buffer;
+
+   if (timeout != VCOS_SUSPEND)
+   {
+      deadline = vcos_getmicrosecs64() + (uint64_t)timeout * 1000;
+      pts = &ts;
+   }
+
+   __atomic_fetch_add(&lf->waiters, 1, __ATOMIC_SEQ_CST);
+   for (;;)
+   {
+      event = __atomic_load_n(&lf->event, __ATOMIC_ACQUIRE);
+      buffer = mmal_queue_lockfree_get_any(queue);
+      if (buffer)
+         break;
+
+      if (pts)
+      {
+         now = vcos_getmicrosecs64();
+         if (now >= deadline)
+            break;
+         ts.tv_sec = (deadline - now) / 1000000;
+         ts.tv_nsec = ((deadline - now) % 1000000) * 1000;
+      }
+      mmal_queue_futex_wait(&lf->event, event, pts);
+   }
+   __atomic_fetch_sub(&lf->waiters, 1, __ATOMIC_RELAXED);
+
+   return buffer;
+}
+#endif /* MMAL_QUEUE_HAVE_LOCKFREE */
+
 /** Create a QUEUE of MMAL_BUFFER_HEADER_T */
 MMAL_QUEUE_T *mmal_queue_create(void)
+{
+   return mmal_queue_create_with_flags(0, 0);
+}
+
+/** Create a QUEUE of MMAL_BUFFER_HEADER_T with specific behaviour */
+MMAL_QUEUE_T *mmal_queue_create_with_flags(uint32_t flags, unsigned int capacity)
 {
    MMAL_QUEUE_T *queue;
 
    queue = vcos_malloc(sizeof(*queue), "MMAL queue");
    if(!queue) return 0;
+   memset(queue, 0, sizeof(*queue));
+
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   if ((flags & MMAL_QUEUE_FLAG_LOCKFREE) && capacity)
+   {
+      queue->flags = flags;
+      queue->lockfree = mmal_queue_lockfree_create(capacity);
+      if (!queue->lockfree)
+      {
+         vcos_free(queue);
+         return 0;
+      }
+
+      /* Leave at least half of the buffer headers to the ring */
+      if (flags & MMAL_QUEUE_FLAG_THREAD_CACHE)
+         queue->lockfree->magazine_size = MMAL_MIN(capacity / 2, MMAL_QUEUE_MAGAZINE_SIZE);
+      if (!queue->lockfree->magazine_size)
+         queue->flags &= ~MMAL_QUEUE_FLAG_THREAD_CACHE;
+      return queue;
+   }
+#else
+   MMAL_PARAM_UNUSED(capacity);
+#endif
+   /* Fall back to the mutex protected implementation */
+   queue->flags = flags & ~(MMAL_QUEUE_FLAG_LOCKFREE|MMAL_QUEUE_FLAG_THREAD_CACHE);
 
    if(vcos_mutex_create(&queue->lock, "MMAL queue lock") != VCOS_SUCCESS )
    {
@@ -86,12 +749,29 @@ MMAL_QUEUE_T *mmal_queue_create(void)
    return queue;
 }
 
+/** Get the flags a QUEUE is actually using */
+uint32_t mmal_queue_flags(MMAL_QUEUE_T *queue)
+{
+   return queue ? queue->flags : 0;
+}
+
 /** Put a MMAL_BUFFER_HEADER_T into a QUEUE */
 void mmal_queue_put(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *buffer)
 {
    vcos_assert(queue && buffer);
    if(!queue || !buffer) return;
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   if (queue->lockfree)
+   {
+      if (queue->lockfree->magazine_size)
+         mmal_queue_magazine_put(queue, buffer);
+      else
+         mmal_queue_lockfree_put(queue, buffer);
+      return;
+   }
+#endif
+
    vcos_mutex_lock(&queue->lock);
    mmal_queue_sanity_check(queue, buffer);
    queue->length++;
@@ -116,6 +796,14 @@ void mmal_queue_put_back(MMAL_QUEUE_T *queue, MMAL_BUFFER_HEADER_T *buffer)
 {
    if(!queue || !buffer) return;
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   if (queue->lockfree)
+   {
+      mmal_queue_lockfree_put_back(queue, buffer);
+      return;
+   }
+#endif
+
    vcos_mutex_lock(&queue->lock);
    mmal_queue_sanity_check(queue, buffer);
    queue->length++;
@@ -152,6 +840,11 @@ MMAL_BUFFER_HEADER_T *mmal_queue_get(MMAL_QUEUE_T *queue)
    vcos_assert(queue);
    if(!queue) return 0;
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   if (queue->lockfree)
+      return mmal_queue_lockfree_get_any(queue);
+#endif
+
    if(vcos_semaphore_trywait(&queue->semaphore) != VCOS_SUCCESS)
        return NULL;
 
@@ -163,6 +856,11 @@ MMAL_BUFFER_HEADER_T *mmal_queue_wait(MMAL_QUEUE_T *queue)
 {
 	if(!queue) return 0;
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   if (queue->lockfree)
+      return mmal_queue_lockfree_wait(queue, VCOS_SUSPEND);
+#endif
+
    if (vcos_semaphore_wait(&queue->semaphore) != VCOS_SUCCESS)
        return NULL;
 
@@ -174,6 +872,11 @@ MMAL_BUFFER_HEADER_T *mmal_queue_timedwait(MMAL_QUEUE_T *queue, VCOS_UNSIGNED ti
     if (!queue)
         return NULL;
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+    if (queue->lockfree)
+        return mmal_queue_lockfree_wait(queue, timeout);
+#endif
+
     if (vcos_semaphore_wait_timeout(&queue->semaphore, timeout) != VCOS_SUCCESS)
         return NULL;
 
@@ -185,6 +888,11 @@ unsigned int mmal_queue_length(MMAL_QUEUE_T *queue)
 {
 	if(!queue) return 0;
 
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+	if (queue->lockfree)
+		return __atomic_load_n(&queue->length, __ATOMIC_ACQUIRE) +
+			(queue->lockfree->magazine_size ? mmal_queue_magazines_length(queue) : 0);
+#endif
 	return queue->length;
 }
 
@@ -192,6 +900,15 @@ unsigned int mmal_queue_length(MMAL_QUEUE_T *queue)
 void mmal_queue_destroy(MMAL_QUEUE_T *queue)
 {
    if(!queue) return;
+#ifdef MMAL_QUEUE_HAVE_LOCKFREE
+   if (queue->lockfree)
+   {
+      mmal_queue_magazines_destroy(queue);
+      mmal_queue_lockfree_destroy(queue->lockfree);
+      vcos_free(queue);
+      return;
+   }
+#endif
    vcos_mutex_delete(&queue->lock);
    vcos_semaphore_delete(&queue->semaphore);
    vcos_free(queue);
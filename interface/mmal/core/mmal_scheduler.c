@@ -0,0 +1,405 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mmal.h"
+#include "core/mmal_scheduler_private.h"
+#include "mmal_logging.h"
+
+/** Scheduling states of a task */
+enum {
+   MMAL_SCHEDULER_TASK_IDLE = 0, /**< Not queued and not running */
+   MMAL_SCHEDULER_TASK_QUEUED,   /**< Sitting in the run queue of a worker */
+   MMAL_SCHEDULER_TASK_RUNNING,  /**< Being run by a worker */
+   MMAL_SCHEDULER_TASK_PENDING,  /**< Being run and triggered again since */
+};
+
+/** Definition of a worker thread */
+typedef struct MMAL_SCHEDULER_WORKER_T
+{
+   VCOS_THREAD_T thread;
+   unsigned int index;
+
+   VCOS_MUTEX_T lock;            /**< Protects the run queue */
+   MMAL_SCHEDULER_TASK_T *first; /**< Head of the run queue */
+   MMAL_SCHEDULER_TASK_T **last; /**< Tail of the run queue */
+
+   /** Task being run by the worker. Reset by mmal_scheduler_task_destroy when
+    * the task destroys itself so that the worker doesn't touch it anymore. */
+   MMAL_SCHEDULER_TASK_T *running;
+
+} MMAL_SCHEDULER_WORKER_T;
+
+/** Definition of the scheduler context */
+static struct
+{
+   unsigned int threads_num;   /**< Number of worker threads requested */
+   unsigned int started_num;   /**< Number of worker threads running */
+   unsigned int next;          /**< Worker used for tasks triggered from outside */
+   MMAL_BOOL_T quit;
+
+   VCOS_MUTEX_T lock;          /**< Protects the starting of the workers */
+   VCOS_SEMAPHORE_T work;      /**< Counts the tasks sitting in the run queues */
+   VCOS_TLS_KEY_T current;     /**< Worker running on the current thread */
+
+   MMAL_SCHEDULER_WORKER_T worker[MMAL_SCHEDULER_THREADS_MAX];
+
+} mmal_scheduler;
+
+/*****************************************************************************/
+static void mmal_scheduler_worker_push(MMAL_SCHEDULER_WORKER_T *worker,
+   MMAL_SCHEDULER_TASK_T *task)
+{
+   task->next = NULL;
+   vcos_mutex_lock(&worker->lock);
+   *worker->last = task;
+   worker->last = &task->next;
+   vcos_mutex_unlock(&worker->lock);
+   vcos_semaphore_post(&mmal_scheduler.work);
+}
+
+static MMAL_SCHEDULER_TASK_T *mmal_scheduler_worker_pop(MMAL_SCHEDULER_WORKER_T *worker)
+{
+   MMAL_SCHEDULER_TASK_T *task;
+
+   vcos_mutex_lock(&worker->lock);
+   task = worker->first;
+   if (task)
+   {
+      worker->first = task->next;
+      if (!worker->first)
+         worker->last = &worker->first;
+   }
+   vcos_mutex_unlock(&worker->lock);
+   return task;
+}
+
+/** Queue a task on a worker.
+ * Tasks triggered from a worker thread are queued on that same worker so the
+ * data they are about to process is likely to still be hot in its cache. */
+static void mmal_scheduler_task_queue(MMAL_SCHEDULER_TASK_T *task)
+{
+   MMAL_SCHEDULER_WORKER_T *worker = vcos_tls_get(mmal_scheduler.current);
+
+   if (!worker)
+      worker = &mmal_scheduler.worker[__atomic_fetch_add(&mmal_scheduler.next, 1,
+         __ATOMIC_RELAXED) % mmal_scheduler.started_num];
+
+   mmal_scheduler_worker_push(worker, task);
+}
+
+/** Run a task which has just been dequeued */
+static void mmal_scheduler_task_run(MMAL_SCHEDULER_WORKER_T *worker, MMAL_SCHEDULER_TASK_T *task)
+{
+   MMAL_SCHEDULER_TASK_T *previous = worker->running;
+   MMAL_BOOL_T requeue = MMAL_FALSE;
+
+   vcos_mutex_lock(&task->lock);
+   if (task->quit)
+   {
+      task->state = MMAL_SCHEDULER_TASK_IDLE;
+      vcos_mutex_unlock(&task->lock);
+      vcos_semaphore_post(&task->idle);
+      return;
+   }
+   task->state = MMAL_SCHEDULER_TASK_RUNNING;
+   vcos_mutex_unlock(&task->lock);
+
+   worker->running = task;
+   task->pf_run(task->context);
+   if (worker->running != task)
+   {
+      /* The task has destroyed itself */
+      worker->running = previous;
+      return;
+   }
+   worker->running = previous;
+
+   vcos_mutex_lock(&task->lock);
+   if (task->quit)
+   {
+      task->state = MMAL_SCHEDULER_TASK_IDLE;
+      vcos_mutex_unlock(&task->lock);
+      vcos_semaphore_post(&task->idle);
+      return;
+   }
+   if (task->state == MMAL_SCHEDULER_TASK_PENDING)
+   {
+      task->state = MMAL_SCHEDULER_TASK_QUEUED;
+      requeue = MMAL_TRUE;
+   }
+   else
+      task->state = MMAL_SCHEDULER_TASK_IDLE;
+   vcos_mutex_unlock(&task->lock);
+
+   /* Go to the back of the queue so other tasks get a chance to run */
+   if (requeue)
+      mmal_scheduler_task_queue(task);
+}
+
+/** Find and run a task once a post on the work semaphore has been consumed */
+static void mmal_scheduler_worker_run_one(MMAL_SCHEDULER_WORKER_T *worker)
+{
+   MMAL_SCHEDULER_TASK_T *task = NULL;
+   unsigned int i;
+
+   /* There is one task in the run queues for each post on the semaphore.
+    * Look in our own queue first then steal from the other workers. A task
+    * can move to a queue we have already looked at while we scan so keep
+    * going until we find one. */
+   while (!task)
+   {
+      for (i = 0; i < mmal_scheduler.started_num && !task; i++)
+         task = mmal_scheduler_worker_pop(&mmal_scheduler.worker[
+            (worker->index + i) % mmal_scheduler.started_num]);
+   }
+
+   mmal_scheduler_task_run(worker, task);
+}
+
+static void *mmal_scheduler_worker_func(void *arg)
+{
+   MMAL_SCHEDULER_WORKER_T *worker = (MMAL_SCHEDULER_WORKER_T *)arg;
+
+   vcos_tls_set(mmal_scheduler.current, worker);
+
+   while (1)
+   {
+      vcos_semaphore_wait(&mmal_scheduler.work);
+      if (mmal_scheduler.quit)
+         break;
+
+      mmal_scheduler_worker_run_one(worker);
+   }
+
+   return 0;
+}
+
+/** Stop and join the worker threads that have been started */
+static void mmal_scheduler_workers_stop(void)
+{
+   unsigned int i;
+
+   if (!mmal_scheduler.started_num)
+      return;
+
+   mmal_scheduler.quit = MMAL_TRUE;
+   for (i = 0; i < mmal_scheduler.started_num; i++)
+      vcos_semaphore_post(&mmal_scheduler.work);
+   for (i = 0; i < mmal_scheduler.started_num; i++)
+   {
+      vcos_thread_join(&mmal_scheduler.worker[i].thread, NULL);
+      vcos_mutex_delete(&mmal_scheduler.worker[i].lock);
+   }
+
+   vcos_semaphore_delete(&mmal_scheduler.work);
+   vcos_tls_delete(mmal_scheduler.current);
+   mmal_scheduler.started_num = 0;
+   mmal_scheduler.quit = MMAL_FALSE;
+}
+
+/** Start the worker threads. Called with the scheduler lock held. */
+static MMAL_STATUS_T mmal_scheduler_workers_start(void)
+{
+   VCOS_THREAD_ATTR_T attrs;
+   char name[16];
+   unsigned int i;
+
+   if (vcos_semaphore_create(&mmal_scheduler.work, "mmal scheduler", 0) != VCOS_SUCCESS)
+      return MMAL_ENOMEM;
+   if (vcos_tls_create(&mmal_scheduler.current) != VCOS_SUCCESS)
+   {
+      vcos_semaphore_delete(&mmal_scheduler.work);
+      return MMAL_ENOMEM;
+   }
+
+   vcos_thread_attr_init(&attrs);
+   for (i = 0; i < mmal_scheduler.threads_num; i++)
+   {
+      MMAL_SCHEDULER_WORKER_T *worker = &mmal_scheduler.worker[i];
+
+      worker->index = i;
+      worker->running = NULL;
+      worker->first = NULL;
+      worker->last = &worker->first;
+      if (vcos_mutex_create(&worker->lock, "mmal worker") != VCOS_SUCCESS)
+         break;
+
+      vcos_snprintf(name, sizeof(name), "mmal worker %u", i);
+      if (vcos_thread_create(&worker->thread, name, &attrs,
+                             mmal_scheduler_worker_func, worker) != VCOS_SUCCESS)
+      {
+         vcos_mutex_delete(&worker->lock);
+         break;
+      }
+      mmal_scheduler.started_num++;
+   }
+
+   if (mmal_scheduler.started_num != mmal_scheduler.threads_num)
+   {
+      LOG_ERROR("only started %u out of %u worker threads",
+                mmal_scheduler.started_num, mmal_scheduler.threads_num);
+      mmal_scheduler_workers_stop();
+      return MMAL_ENOMEM;
+   }
+
+   LOG_DEBUG("started %u worker threads", mmal_scheduler.started_num);
+   return MMAL_SUCCESS;
+}
+
+/*****************************************************************************/
+MMAL_STATUS_T mmal_scheduler_init(unsigned int threads_num)
+{
+   if (threads_num > MMAL_SCHEDULER_THREADS_MAX)
+   {
+      LOG_ERROR("too many worker threads requested (%u), using %u",
+                threads_num, MMAL_SCHEDULER_THREADS_MAX);
+      threads_num = MMAL_SCHEDULER_THREADS_MAX;
+   }
+
+   mmal_scheduler.threads_num = 0;
+   mmal_scheduler.started_num = 0;
+   if (!threads_num)
+      return MMAL_SUCCESS;
+
+   if (vcos_mutex_create(&mmal_scheduler.lock, "mmal scheduler") != VCOS_SUCCESS)
+      return MMAL_ENOMEM;
+
+   mmal_scheduler.threads_num = threads_num;
+   return MMAL_SUCCESS;
+}
+
+void mmal_scheduler_deinit(void)
+{
+   if (!mmal_scheduler.threads_num)
+      return;
+
+   mmal_scheduler_workers_stop();
+   vcos_mutex_delete(&mmal_scheduler.lock);
+   mmal_scheduler.threads_num = 0;
+}
+
+MMAL_BOOL_T mmal_scheduler_enabled(void)
+{
+   return mmal_scheduler.threads_num != 0;
+}
+
+MMAL_STATUS_T mmal_scheduler_task_create(MMAL_SCHEDULER_TASK_T *task, const char *name,
+   void (*pf_run)(void *context), void *context)
+{
+   MMAL_STATUS_T status = MMAL_SUCCESS;
+
+   if (!mmal_scheduler.threads_num)
+      return MMAL_ENOSYS;
+
+   vcos_mutex_lock(&mmal_scheduler.lock);
+   if (!mmal_scheduler.started_num)
+      status = mmal_scheduler_workers_start();
+   vcos_mutex_unlock(&mmal_scheduler.lock);
+   if (status != MMAL_SUCCESS)
+      return status;
+
+   memset(task, 0, sizeof(*task));
+   task->pf_run = pf_run;
+   task->context = context;
+
+   if (vcos_mutex_create(&task->lock, name) != VCOS_SUCCESS)
+      return MMAL_ENOMEM;
+   if (vcos_semaphore_create(&task->idle, name, 0) != VCOS_SUCCESS)
+   {
+      vcos_mutex_delete(&task->lock);
+      return MMAL_ENOMEM;
+   }
+
+   return MMAL_SUCCESS;
+}
+
+void mmal_scheduler_task_destroy(MMAL_SCHEDULER_TASK_T *task)
+{
+   MMAL_SCHEDULER_WORKER_T *worker = vcos_tls_get(mmal_scheduler.current);
+   MMAL_BOOL_T busy;
+
+   vcos_mutex_lock(&task->lock);
+   task->quit = MMAL_TRUE;
+   busy = task->state != MMAL_SCHEDULER_TASK_IDLE;
+   vcos_mutex_unlock(&task->lock);
+
+   if (busy && worker && worker->running == task)
+   {
+      /* The task is destroying itself. It can't be queued anywhere while it
+       * is running so just tell the worker to forget about it. */
+      worker->running = NULL;
+      busy = MMAL_FALSE;
+   }
+
+   /* A queued task might be sitting in the run queue of this very worker, in
+    * which case nobody else is going to run it. Run pending tasks ourselves
+    * until ours has been dealt with, and only block once there is nothing
+    * left for us to run. */
+   while (busy && worker && vcos_semaphore_trywait(&task->idle) != VCOS_SUCCESS)
+   {
+      if (vcos_semaphore_trywait(&mmal_scheduler.work) != VCOS_SUCCESS)
+      {
+         /* Whatever is left is in the hands of other workers */
+         vcos_semaphore_wait(&task->idle);
+         break;
+      }
+      if (mmal_scheduler.quit)
+      {
+         /* The workers are being stopped and that post was for one of them */
+         vcos_semaphore_post(&mmal_scheduler.work);
+         vcos_semaphore_wait(&task->idle);
+         break;
+      }
+      mmal_scheduler_worker_run_one(worker);
+   }
+   if (busy && !worker)
+      vcos_semaphore_wait(&task->idle);
+
+   vcos_semaphore_delete(&task->idle);
+   vcos_mutex_delete(&task->lock);
+}
+
+void mmal_scheduler_task_trigger(MMAL_SCHEDULER_TASK_T *task)
+{
+   MMAL_BOOL_T queue = MMAL_FALSE;
+
+   vcos_mutex_lock(&task->lock);
+   if (!task->quit)
+   {
+      if (task->state == MMAL_SCHEDULER_TASK_IDLE)
+      {
+         task->state = MMAL_SCHEDULER_TASK_QUEUED;
+         queue = MMAL_TRUE;
+      }
+      else if (task->state == MMAL_SCHEDULER_TASK_RUNNING)
+         task->state = MMAL_SCHEDULER_TASK_PENDING;
+   }
+   vcos_mutex_unlock(&task->lock);
+
+   if (queue)
+      mmal_scheduler_task_queue(task);
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MMAL_SCHEDULER_PRIVATE_H
+#define MMAL_SCHEDULER_PRIVATE_H
+
+#include "mmal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of worker threads the shared scheduler will start */
+#define MMAL_SCHEDULER_THREADS_MAX 64
+
+/** Name of the environment variable used to enable the shared scheduler */
+#define MMAL_SCHEDULER_THREADS_ENV "MMAL_SCHEDULER_THREADS"
+
+/** Task run by the shared scheduler.
+ * A task is queued at most once at any given time. Triggering a task which is
+ * already queued is a no-op and triggering a task which is currently running
+ * will have it run once more after it returns, which gives the same semantics
+ * as signalling the event of a dedicated action thread. */
+typedef struct MMAL_SCHEDULER_TASK_T
+{
+   struct MMAL_SCHEDULER_TASK_T *next; /**< Used to chain tasks in a run queue */
+
+   void (*pf_run)(void *context); /**< Function run by the worker threads */
+   void *context;                 /**< Context passed to pf_run */
+
+   VCOS_MUTEX_T lock;             /**< Protects the state of the task */
+   unsigned int state;            /**< Scheduling state of the task */
+   MMAL_BOOL_T quit;              /**< Task is being destroyed */
+   VCOS_SEMAPHORE_T idle;         /**< Signalled once a quitting task is idle */
+
+} MMAL_SCHEDULER_TASK_T;
+
+/** Initialise the shared scheduler.
+ * This only records the configuration, the worker threads are started on
+ * first use.
+ *
+ * @param threads_num number of worker threads to use. 0 means the scheduler is
+ *                    disabled and components get a dedicated action thread.
+ * @return MMAL_SUCCESS on success
+ */
+MMAL_STATUS_T mmal_scheduler_init(unsigned int threads_num);
+
+/** Deinitialise the shared scheduler and join its worker threads.
+ * All the tasks must have been destroyed beforehand. */
+void mmal_scheduler_deinit(void);
+
+/** Check whether the shared scheduler is enabled.
+ *
+ * @return MMAL_TRUE if actions should be run by the shared scheduler
+ */
+MMAL_BOOL_T mmal_scheduler_enabled(void);
+
+/** Create a task and attach it to the shared scheduler.
+ *
+ * @param task    task to initialise
+ * @param name    name of the task, used for debugging
+ * @param pf_run  function run when the task is scheduled
+ * @param context context passed to pf_run
+ * @return MMAL_SUCCESS on success
+ */
+MMAL_STATUS_T mmal_scheduler_task_create(MMAL_SCHEDULER_TASK_T *task, const char *name,
+   void (*pf_run)(void *context), void *context);
+
+/** Destroy a task.
+ * This waits for the task to be done running if it is currently scheduled.
+ * Must not be called from within the task itself.
+ *
+ * @param task task to destroy
+ */
+void mmal_scheduler_task_destroy(MMAL_SCHEDULER_TASK_T *task);
+
+/** Schedule a task to be run by one of the worker threads.
+ *
+ * @param task task to schedule
+ */
+void mmal_scheduler_task_trigger(MMAL_SCHEDULER_TASK_T *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MMAL_SCHEDULER_PRIVATE_H */
@@ -69,6 +69,27 @@ typedef struct MMAL_CORE_STATISTICS_T
    uint32_t max_delay;           /**< Max delay (us) between buffers, ignoring first few frames */
 } MMAL_CORE_STATISTICS_T;
 
+/** Number of buckets of the latency histograms collected by the core */
+#define MMAL_CORE_LATENCY_BUCKETS 128
+
+/** Latency distribution collected by the core.
+ * Durations are in microseconds. The histogram is log-linear: values below 4us
+ * have their own bucket, then each power of 2 is split into 4 buckets, i.e. bucket
+ * i (i >= 4) covers durations from (4 + i%4) << (i/4 - 1) up to the start of
+ * bucket i+1. Percentiles are given as the upper bound of the bucket they fall in,
+ * so their precision is within 25%.
+ */
+typedef struct MMAL_CORE_LATENCY_T
+{
+   uint32_t count;               /**< Number of samples */
+   uint32_t min;                 /**< Smallest sample (us) */
+   uint32_t max;                 /**< Largest sample (us) */
+   uint32_t p50;                 /**< Median (us) */
+   uint32_t p95;                 /**< 95th percentile (us) */
+   uint32_t p99;                 /**< 99th percentile (us) */
+   uint32_t histogram[MMAL_CORE_LATENCY_BUCKETS]; /**< Number of samples in each bucket */
+} MMAL_CORE_LATENCY_T;
+
 /** Statistics collected by the core on all ports, if enabled in the build.
  */
 typedef struct MMAL_CORE_PORT_STATISTICS_T
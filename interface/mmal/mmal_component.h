@@ -139,6 +139,21 @@ MMAL_STATUS_T mmal_component_enable(MMAL_COMPONENT_T *component);
  */
 MMAL_STATUS_T mmal_component_disable(MMAL_COMPONENT_T *component);
 
+/** Configure how the processing of components is scheduled.
+ * By default each component runs its processing on a dedicated thread. When a
+ * non-zero number of threads is given, the processing of all the components is
+ * instead run by a shared pool of worker threads, which reduces the number of
+ * threads and context switches in large pipelines. Thread priorities set by
+ * the components are ignored in this mode.
+ * The same can be achieved by setting the MMAL_SCHEDULER_THREADS environment
+ * variable, this function taking precedence over it.
+ * This must be called before any component is created.
+ *
+ * @param threads_num number of worker threads to use, 0 for dedicated threads
+ * @return MMAL_SUCCESS on success, MMAL_EINVAL if components already exist
+ */
+MMAL_STATUS_T mmal_component_scheduler_configure(unsigned int threads_num);
+
 /* @} */
 
 #ifdef __cplusplus
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "mmal_parameters_video.h"
 #include "mmal_parameters_audio.h"
 #include "mmal_parameters_clock.h"
+#include "mmal_parameters_splitter.h"
 
 /** \defgroup MmalParameters List of pre-defined parameters
  * This defines a list of standard parameters. Components can define proprietary
@@ -51,6 +51,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MMAL_PARAMETER_GROUP_CLOCK             (4<<16)
 /** Miracast-specific parameter ID group. */
 #define MMAL_PARAMETER_GROUP_MIRACAST       (5<<16)
+/** Splitter-specific parameter ID group. */
+#define MMAL_PARAMETER_GROUP_SPLITTER          (6<<16)
 
 
 /**@}*/
@@ -74,7 +76,8 @@ enum {
    MMAL_PARAMETER_LOGGING,                /**< Takes a MMAL_PARAMETER_LOGGING_T */
    MMAL_PARAMETER_SYSTEM_TIME,            /**< Takes a MMAL_PARAMETER_UINT64_T */
    MMAL_PARAMETER_NO_IMAGE_PADDING,       /**< Takes a MMAL_PARAMETER_BOOLEAN_T */
-   MMAL_PARAMETER_LOCKSTEP_ENABLE         /**< Takes a MMAL_PARAMETER_BOOLEAN_T */
+   MMAL_PARAMETER_LOCKSTEP_ENABLE,        /**< Takes a MMAL_PARAMETER_BOOLEAN_T */
+   MMAL_PARAMETER_CORE_LATENCY_STATISTICS /**< Takes a MMAL_PARAMETER_CORE_LATENCY_STATISTICS_T */
 };
 
 /**@}*/
@@ -167,6 +170,24 @@ typedef struct MMAL_PARAMETER_CORE_STATISTICS_T
    MMAL_CORE_STATISTICS_T stats;    /**< The statistics */
 } MMAL_PARAMETER_CORE_STATISTICS_T;
 
+/** MMAL core statistics, including latency distributions.
+ * This is a superset of \ref MMAL_PARAMETER_CORE_STATISTICS_T. Like the core
+ * statistics, they are only collected if the core is built with
+ * MMAL_COLLECT_PORT_STATS defined. They are collected without any locking so
+ * a snapshot taken while buffers are flowing might be very slightly inconsistent.
+ */
+typedef struct MMAL_PARAMETER_CORE_LATENCY_STATISTICS_T
+{
+   MMAL_PARAMETER_HEADER_T hdr;
+   MMAL_CORE_STATS_DIR dir;
+   MMAL_BOOL_T reset;               /**< Reset to zero after reading */
+   MMAL_CORE_STATISTICS_T stats;    /**< Same as MMAL_PARAMETER_CORE_STATISTICS_T */
+   MMAL_CORE_LATENCY_T gap;         /**< Time between consecutive buffers in this direction */
+   MMAL_CORE_LATENCY_T transit;     /**< Time between a buffer being sent to the port and it
+                                         coming back from the port. Only valid for
+                                         MMAL_CORE_STATS_TX. */
+} MMAL_PARAMETER_CORE_LATENCY_STATISTICS_T;
+
 /**
  * Component memory usage statistics.
  */
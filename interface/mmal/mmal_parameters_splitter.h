@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MMAL_PARAMETERS_SPLITTER_H
+#define MMAL_PARAMETERS_SPLITTER_H
+
+#include "mmal_parameters_common.h"
+
+/*************************************************
+ * ALWAYS ADD NEW ENUMS AT THE END OF THIS LIST! *
+ ************************************************/
+
+/** Splitter-specific MMAL parameter IDs.
+ * @ingroup MMAL_PARAMETER_IDS
+ */
+enum
+{
+   MMAL_PARAMETER_SPLITTER_POLICY           /**< Takes a MMAL_PARAMETER_SPLITTER_POLICY_T */
+      = MMAL_PARAMETER_GROUP_SPLITTER,
+   MMAL_PARAMETER_SPLITTER_STATISTICS,      /**< Takes a MMAL_PARAMETER_SPLITTER_STATISTICS_T */
+};
+
+/** Policies applied by the splitter when one of its output ports has no free
+ * buffer header to receive a new input buffer. */
+typedef enum
+{
+   MMAL_SPLITTER_POLICY_BLOCK,       /**< Stop accepting input until the output catches up */
+   MMAL_SPLITTER_POLICY_DROP_OLDEST, /**< Drop the oldest buffer waiting for this output */
+   MMAL_SPLITTER_POLICY_DROP_NEWEST, /**< Drop the new buffer for this output */
+   MMAL_SPLITTER_POLICY_MAX = 0x7fffffff /* Force 32 bit size for this enum */
+} MMAL_SPLITTER_POLICY_T;
+
+/** Policy of a splitter output port.
+ * Input buffers waiting for an output port to have a free buffer header are kept in
+ * a backlog of up to \a backlog entries. Once the backlog is full the policy decides
+ * what happens. A slow output using a drop policy will not hold up the other outputs.
+ */
+typedef struct MMAL_PARAMETER_SPLITTER_POLICY_T
+{
+   MMAL_PARAMETER_HEADER_T hdr;
+   MMAL_SPLITTER_POLICY_T policy;   /**< Policy applied when the backlog is full */
+   uint32_t backlog;                /**< Size of the backlog, 0 for the default */
+} MMAL_PARAMETER_SPLITTER_POLICY_T;
+
+/** Statistics of a splitter output port.
+ * Setting this parameter resets the counters to zero.
+ */
+typedef struct MMAL_PARAMETER_SPLITTER_STATISTICS_T
+{
+   MMAL_PARAMETER_HEADER_T hdr;
+   uint32_t buffers_sent;           /**< Number of buffers sent out of the port */
+   uint32_t buffers_dropped;        /**< Number of buffers dropped because of the policy */
+   uint32_t backlog;                /**< Number of buffers currently in the backlog */
+} MMAL_PARAMETER_SPLITTER_STATISTICS_T;
+
+#endif /* MMAL_PARAMETERS_SPLITTER_H */
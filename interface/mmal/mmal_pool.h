@@ -102,6 +102,47 @@ MMAL_POOL_T *mmal_pool_create_with_allocator(unsigned int headers, uint32_t payl
                               void *allocator_context, mmal_pool_allocator_alloc_t allocator_alloc,
                               mmal_pool_allocator_free_t allocator_free);
 
+/** \name Pool creation flags
+ * \anchor poolflags
+ * The following flags describe how the payload buffers of a pool are allocated
+ * and how its free buffer headers are queued. */
+/* @{ */
+/** All the payloads are carved out of a single contiguous, page-aligned slab.
+ * Each payload starts on a cache line boundary (page boundary for payloads of a page or more).
+ * Released slabs are kept in a global cache, indexed by size, so that a pool destroyed and
+ * recreated with the same geometry (e.g. after a format change) reuses the same memory. */
+#define MMAL_POOL_FLAG_SLAB       (1<<0)
+/** Back the slab with hugepages (MAP_HUGETLB, or transparent hugepages as a fallback).
+ * Implies MMAL_POOL_FLAG_SLAB. */
+#define MMAL_POOL_FLAG_HUGEPAGES  (1<<1)
+/** Give the slab straight back to the system on release instead of caching it */
+#define MMAL_POOL_FLAG_NO_CACHE   (1<<2)
+/** Keep the free buffer headers in a lock-free queue with per-thread caches in front of it
+ * (see MMAL_QUEUE_FLAG_THREAD_CACHE). A thread recycling buffer headers in a loop doesn't go
+ * through the shared queue anymore, but buffer headers don't come out of the pool in FIFO
+ * order. The queue can't hold more buffer headers than the pool was created or resized with. */
+#define MMAL_POOL_FLAG_THREAD_CACHE (1<<3)
+/* @} */
+
+/** Create a pool of MMAL_BUFFER_HEADER_T with specific allocation flags.
+ * This behaves like mmal_pool_create() but allows selecting how the payload buffers
+ * are allocated (see \ref poolflags "Pool creation flags").
+ *
+ * @param headers      Number of buffer headers to be allocated with the pool.
+ * @param payload_size Size of the payload buffer that will be allocated in
+ *                     each of the buffer headers.
+ * @param flags        Combination of MMAL_POOL_FLAG_XXX values.
+ * @return Pointer to the newly created pool or NULL on failure.
+ */
+MMAL_POOL_T *mmal_pool_create_with_flags(unsigned int headers, uint32_t payload_size, uint32_t flags);
+
+/** Release all the memory held in the global slab cache.
+ * The size of the cache is bounded (64MB by default, or the number of bytes given by the
+ * MMAL_POOL_CACHE_SIZE environment variable) but this can be used to give the memory back
+ * to the system early, e.g. once a pipeline has been torn down.
+ */
+void mmal_pool_cache_flush(void);
+
 /** Destroy a pool of MMAL_BUFFER_HEADER_T.
  * This will also deallocate all of the memory which was allocated when creating or
  * resizing the pool.
@@ -216,6 +216,27 @@ MMAL_STATUS_T mmal_port_parameter_get(MMAL_PORT_T *port,
 MMAL_STATUS_T mmal_port_send_buffer(MMAL_PORT_T *port,
    MMAL_BUFFER_HEADER_T *buffer);
 
+/** Maximum number of buffer headers the core batches together when it sends
+ * or returns buffer headers on its own behalf. */
+#define MMAL_PORT_BUFFER_BATCH_MAX 32
+
+/** Send an array of buffer headers to a port.
+ * This is equivalent to calling \ref mmal_port_send_buffer for each buffer header
+ * but the port is only locked once for the whole batch, and components which
+ * support it receive the whole batch at once.
+ *
+ * On failure, the entries of the array corresponding to buffer headers which
+ * were accepted by the port are set to NULL. The caller is still the owner of
+ * the other ones.
+ *
+ * @param port The port to which the buffer headers are to be sent.
+ * @param buffers Array of buffer headers to send.
+ * @param num Number of buffer headers in the array.
+ * @return MMAL_SUCCESS on success
+ */
+MMAL_STATUS_T mmal_port_send_buffers(MMAL_PORT_T *port,
+   MMAL_BUFFER_HEADER_T **buffers, unsigned int num);
+
 /** Connect an output port to an input port.
  *
  * When connected and enabled, buffers will automatically progress from the
@@ -48,6 +48,51 @@ typedef struct MMAL_QUEUE_T MMAL_QUEUE_T;
  */
 MMAL_QUEUE_T *mmal_queue_create(void);
 
+/** \name Queue flags
+ * Flags which can be passed to \ref mmal_queue_create_with_flags. */
+/* @{ */
+/** Use a lock-free ring of buffer headers instead of a mutex protected list.
+ * Waiting for a buffer header will then only sleep when the queue is empty.
+ * This is only available on platforms with futex support (Linux), and the
+ * queue falls back to the default implementation elsewhere. */
+#define MMAL_QUEUE_FLAG_LOCKFREE         (1<<0)
+/** Only one thread will ever put buffer headers into the queue (lock-free queues only) */
+#define MMAL_QUEUE_FLAG_SINGLE_PRODUCER  (1<<1)
+/** Only one thread will ever get buffer headers from the queue (lock-free queues only) */
+#define MMAL_QUEUE_FLAG_SINGLE_CONSUMER  (1<<2)
+/** Keep small per-thread caches of buffer headers in front of the queue (lock-free queues only).
+ * A thread putting a buffer header into the queue keeps it for itself until its cache is full,
+ * and gets it back without touching the shared ring. Other threads steal from those caches
+ * when the ring is empty, and caches are given back when a thread exits, so buffer headers
+ * are never lost. The order in which buffer headers come out of the queue isn't FIFO anymore,
+ * so this is only meant for queues of free buffer headers (e.g. pools). */
+#define MMAL_QUEUE_FLAG_THREAD_CACHE     (1<<3)
+/* @} */
+
+/** Create a queue of MMAL_BUFFER_HEADER_T with specific behaviour.
+ *
+ * A lock-free queue is backed by a ring of fixed size so the client must
+ * specify the maximum number of buffer headers which will ever be in the
+ * queue at the same time (typically the number of buffer headers in the pool
+ * feeding it). The semantics of all the queue functions, including
+ * \ref mmal_queue_put_back, are the same as for a default queue.
+ *
+ * @param flags    Combination of MMAL_QUEUE_FLAG_XXX flags. 0 gives a default queue.
+ * @param capacity Maximum number of buffer headers in the queue. Only used by lock-free queues.
+ *
+ * @return Pointer to the newly created queue or NULL on failure.
+ */
+MMAL_QUEUE_T *mmal_queue_create_with_flags(uint32_t flags, unsigned int capacity);
+
+/** Get the flags actually in use by a queue.
+ * This can be used to find out whether a lock-free queue could be created.
+ *
+ * @param queue  Pointer to a queue
+ *
+ * @return MMAL_QUEUE_FLAG_XXX flags of the queue.
+ */
+uint32_t mmal_queue_flags(MMAL_QUEUE_T *queue);
+
 /** Put a MMAL_BUFFER_HEADER_T into a queue
  *
  * @param queue  Pointer to a queue
@@ -0,0 +1,208 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Stress test of the clock request scheduler. A number of streams, each
+ * running at a fixed frame rate with a random phase, keep one request
+ * outstanding on the same clock at all times. Every request is re-armed for
+ * the next frame as soon as it has been serviced, and the difference between
+ * the wall-time at which a request is serviced and the wall-time at which its
+ * media-time was reached gives the dispatch jitter. */
+
+#include "mmal.h"
+#include "core/mmal_clock_private.h"
+#include "interface/vcos/vcos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Benchmark options */
+static struct {
+   unsigned int streams;    /**< Number of streams, i.e. outstanding requests */
+   unsigned int rate;       /**< Frame rate of each stream */
+   unsigned int duration;   /**< Duration of the run in milliseconds */
+} options = { 2000, 60, 5000 };
+
+#define SAMPLES_MAX  (4*1024*1024)
+
+/** State shared with the clock callback */
+static struct CONTEXT_T {
+   VCOS_MUTEX_T lock;
+   int64_t wall_start;      /**< Wall-time at media-time 0 */
+   unsigned int *fired;     /**< Streams whose request has just been serviced */
+   unsigned int fired_num;
+   int32_t *samples;        /**< Dispatch jitter of each request (microseconds) */
+   unsigned int samples_num;
+   int64_t *next;           /**< Media-time of the next request of each stream */
+} context;
+
+static void request_cb(MMAL_CLOCK_T *clock, int64_t media_time, void *cb_data, MMAL_CLOCK_VOID_FP priv)
+{
+   unsigned int stream = (unsigned int)(uintptr_t)cb_data;
+   int64_t jitter = vcos_getmicrosecs64() - (context.wall_start + context.next[stream]);
+   MMAL_PARAM_UNUSED(clock);
+   MMAL_PARAM_UNUSED(media_time);
+   MMAL_PARAM_UNUSED(priv);
+
+   vcos_mutex_lock(&context.lock);
+   if (context.samples_num < SAMPLES_MAX)
+      context.samples[context.samples_num++] = (int32_t)jitter;
+   context.fired[context.fired_num++] = stream;
+   vcos_mutex_unlock(&context.lock);
+}
+
+static int compare_abs(const void *a, const void *b)
+{
+   int32_t x = abs(*(const int32_t *)a), y = abs(*(const int32_t *)b);
+   return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int i, n, period, *rearm = NULL, rearm_num, requests = 0, early = 0;
+   int64_t end, add_time = 0, t, sum = 0;
+   MMAL_CLOCK_T *clock = NULL;
+   MMAL_STATUS_T status = MMAL_ENOMEM;
+   int c;
+
+   while ((c = getopt(argc, argv, "s:r:d:h")) != -1)
+   {
+      switch (c)
+      {
+      case 's': options.streams = strtoul(optarg, NULL, 0); break;
+      case 'r': options.rate = strtoul(optarg, NULL, 0); break;
+      case 'd': options.duration = strtoul(optarg, NULL, 0); break;
+      default: break;
+      }
+      if (c == 'h' || c == '?' || !options.streams || !options.rate)
+      {
+         fprintf(stderr, "usage: %s [-s streams] [-r frame rate per stream] [-d duration (ms)]\n",
+                 argv[0]);
+         return c == 'h' ? 0 : -1;
+      }
+   }
+   period = 1000000 / options.rate;
+
+   vcos_init();
+   vcos_mutex_create(&context.lock, "mmal_bench_clock");
+   context.fired = calloc(options.streams, sizeof(*context.fired));
+   context.next = calloc(options.streams, sizeof(*context.next));
+   context.samples = calloc(SAMPLES_MAX, sizeof(*context.samples));
+   rearm = calloc(options.streams, sizeof(*rearm));
+   if (!context.fired || !context.next || !context.samples || !rearm)
+      goto error;
+
+   status = mmal_clock_create(&clock);
+   if (status != MMAL_SUCCESS)
+      goto error;
+
+   context.wall_start = vcos_getmicrosecs64();
+   mmal_clock_media_time_set(clock, 0);
+   mmal_clock_active_set(clock, MMAL_TRUE);
+
+   /* Spread the first frame of each stream over one period, starting a bit later
+    * so that the initial burst of requests doesn't skew the results */
+   for (i = 0; i < options.streams; i++)
+   {
+      context.next[i] = 100000 + rand() % period;
+      t = vcos_getmicrosecs64();
+      status = mmal_clock_request_add(clock, context.next[i], request_cb, (void *)(uintptr_t)i, NULL);
+      add_time += vcos_getmicrosecs64() - t;
+      if (status != MMAL_SUCCESS)
+      {
+         fprintf(stderr, "failed to add request %u (%i)\n", i, status);
+         goto error;
+      }
+      requests++;
+   }
+
+   end = context.wall_start + options.duration * 1000LL;
+   while (vcos_getmicrosecs64() < end)
+   {
+      vcos_sleep(1);
+
+      vcos_mutex_lock(&context.lock);
+      rearm_num = context.fired_num;
+      memcpy(rearm, context.fired, rearm_num * sizeof(*rearm));
+      context.fired_num = 0;
+      vcos_mutex_unlock(&context.lock);
+
+      for (n = 0; n < rearm_num; n++)
+      {
+         i = rearm[n];
+         /* Skip frames we are already too late for */
+         context.next[i] += period;
+         while (context.wall_start + context.next[i] < vcos_getmicrosecs64())
+            context.next[i] += period;
+
+         t = vcos_getmicrosecs64();
+         status = mmal_clock_request_add(clock, context.next[i], request_cb, (void *)(uintptr_t)i, NULL);
+         add_time += vcos_getmicrosecs64() - t;
+         if (status != MMAL_SUCCESS)
+         {
+            fprintf(stderr, "failed to add request for stream %u (%i)\n", i, status);
+            goto error;
+         }
+         requests++;
+      }
+   }
+
+   mmal_clock_active_set(clock, MMAL_FALSE);
+   mmal_clock_destroy(clock);
+   clock = NULL;
+
+   n = context.samples_num;
+   if (!n)
+   {
+      fprintf(stderr, "no request serviced\n");
+      status = MMAL_EINVAL;
+      goto error;
+   }
+   for (i = 0; i < n; i++)
+   {
+      sum += abs(context.samples[i]);
+      early += context.samples[i] < 0;
+   }
+   qsort(context.samples, n, sizeof(*context.samples), compare_abs);
+
+   fprintf(stderr, "%u streams at %u fps, %u requests added (%.2f us each), %u serviced\n",
+           options.streams, options.rate, requests, (double)add_time / requests, n);
+   fprintf(stderr, "dispatch jitter (us): mean %.1f, p50 %d, p99 %d, p99.9 %d, max %d, %.1f%% early\n",
+           (double)sum / n, abs(context.samples[n / 2]), abs(context.samples[(uint64_t)n * 99 / 100]),
+           abs(context.samples[(uint64_t)n * 999 / 1000]), abs(context.samples[n - 1]),
+           100.0 * early / n);
+   status = MMAL_SUCCESS;
+
+error:
+   if (clock)
+      mmal_clock_destroy(clock);
+   free(rearm);
+   free(context.samples);
+   free(context.next);
+   free(context.fired);
+   vcos_mutex_delete(&context.lock);
+   return status == MMAL_SUCCESS ? 0 : -1;
+}
@@ -0,0 +1,325 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Measures the throughput of the software format conversion kernels for each
+ * instruction set, checking their output is identical to the scalar reference
+ * implementation, then the throughput of the convert component. */
+
+#include "mmal.h"
+#include "util/mmal_util.h"
+#include "util/mmal_util_convert.h"
+#include "interface/vcos/vcos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHECK_STATUS(status, msg) if (status != MMAL_SUCCESS) { fprintf(stderr, msg"\n"); goto error; }
+
+/** Benchmark options */
+static struct {
+   unsigned int width;        /**< Width of the visible area */
+   unsigned int height;       /**< Height of the visible area */
+   unsigned int frames;       /**< Number of frames converted for each measurement */
+   unsigned int threads;      /**< Threads used by the component, 0 for the default */
+} options = { 1920, 1080, 100, 0 };
+
+static const struct {
+   uint32_t from;
+   uint32_t to;
+} conversions[] =
+{
+   { MMAL_ENCODING_I420, MMAL_ENCODING_NV12 },
+   { MMAL_ENCODING_NV12, MMAL_ENCODING_I420 },
+   { MMAL_ENCODING_I420, MMAL_ENCODING_RGB24 },
+   { MMAL_ENCODING_I420, MMAL_ENCODING_BGR24 },
+   { MMAL_ENCODING_I420, MMAL_ENCODING_RGBA },
+   { MMAL_ENCODING_NV12, MMAL_ENCODING_RGB24 },
+   { MMAL_ENCODING_NV12, MMAL_ENCODING_RGBA },
+   { MMAL_ENCODING_YUYV, MMAL_ENCODING_I420 },
+   { MMAL_ENCODING_I420, MMAL_ENCODING_YUYV },
+};
+
+/** Context for the component run */
+static struct CONTEXT_T {
+   VCOS_SEMAPHORE_T done;
+   unsigned int received;
+   MMAL_STATUS_T status;
+   MMAL_POOL_T *out_pool;
+} context;
+
+/** Set up a video format with a crop offset, to exercise strides and cropping */
+static void format_setup(MMAL_ES_FORMAT_T *format, uint32_t encoding)
+{
+   format->type = MMAL_ES_TYPE_VIDEO;
+   format->encoding = encoding;
+   format->es->video.width = VCOS_ALIGN_UP(options.width + 2, 32);
+   format->es->video.height = VCOS_ALIGN_UP(options.height + 2, 16);
+   format->es->video.crop.x = 2;
+   format->es->video.crop.y = 2;
+   format->es->video.crop.width = options.width;
+   format->es->video.crop.height = options.height;
+}
+
+static uint8_t *frame_alloc(const MMAL_ES_FORMAT_T *format, MMAL_BOOL_T random)
+{
+   uint32_t i, size = mmal_convert_frame_size(format);
+   uint8_t *data = malloc(size);
+
+   for (i = 0; data && i < size; i++)
+      data[i] = random ? (uint8_t)rand() : 0;
+   return data;
+}
+
+/** Benchmark and check all the kernels of a conversion */
+static MMAL_BOOL_T run_kernels(uint32_t from, uint32_t to)
+{
+   MMAL_ES_FORMAT_T *in_format = mmal_format_alloc(), *out_format = mmal_format_alloc();
+   MMAL_CONVERT_PICTURE_T src, dst;
+   uint8_t *in = NULL, *ref = NULL, *out = NULL;
+   MMAL_BOOL_T success = MMAL_FALSE;
+   uint32_t size;
+   int isa;
+
+   if (!in_format || !out_format)
+      goto end;
+   format_setup(in_format, from);
+   format_setup(out_format, to);
+   size = mmal_convert_frame_size(out_format);
+   in = frame_alloc(in_format, MMAL_TRUE);
+   ref = frame_alloc(out_format, MMAL_FALSE);
+   out = frame_alloc(out_format, MMAL_FALSE);
+   if (!in || !ref || !out)
+      goto end;
+
+   mmal_convert_picture_setup(&src, in_format, in);
+   mmal_convert_picture_setup(&dst, out_format, ref);
+   mmal_convert_kernel_run(mmal_convert_kernel_get(from, to, MMAL_CONVERT_ISA_C),
+                           &src, &dst, options.width, 0, options.height);
+
+   success = MMAL_TRUE;
+   for (isa = MMAL_CONVERT_ISA_C; isa < MMAL_CONVERT_ISA_MAX; isa++)
+   {
+      const MMAL_CONVERT_KERNEL_T *kernel = mmal_convert_kernel_get(from, to, (MMAL_CONVERT_ISA_T)isa);
+      int64_t start_time, time;
+      MMAL_BOOL_T match;
+      unsigned int i;
+
+      if (!kernel)
+         continue;
+
+      memset(out, 0, size);
+      mmal_convert_picture_setup(&dst, out_format, out);
+      start_time = vcos_getmicrosecs64();
+      for (i = 0; i < options.frames; i++)
+         mmal_convert_kernel_run(kernel, &src, &dst, options.width, 0, options.height);
+      time = vcos_getmicrosecs64() - start_time;
+
+      /* The padding is left untouched too so the whole frame can be compared */
+      match = !memcmp(ref, out, size);
+      success &= match;
+      fprintf(stderr, "%4.4s -> %4.4s %-5s %8.1f frames/s, %8.1f MB/s written%s\n",
+              (char *)&from, (char *)&to, mmal_convert_isa_to_string((MMAL_CONVERT_ISA_T)isa),
+              options.frames * 1000000.0 / time, (double)options.frames * size / time,
+              match ? "" : "  MISMATCH");
+   }
+
+ end:
+   free(in);
+   free(ref);
+   free(out);
+   if (in_format) mmal_format_free(in_format);
+   if (out_format) mmal_format_free(out_format);
+   return success;
+}
+
+/** Callback from the input port. The buffer goes back to the input pool. */
+static void input_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_PARAM_UNUSED(port);
+   mmal_buffer_header_release(buffer);
+}
+
+/** Callback from the output port. The buffer is recycled straight away. */
+static void output_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   mmal_buffer_header_release(buffer);
+
+   if (++context.received == options.frames)
+      vcos_semaphore_post(&context.done);
+
+   if (!port->is_enabled)
+      return;
+   buffer = mmal_queue_get(context.out_pool->queue);
+   if (buffer && mmal_port_send_buffer(port, buffer) != MMAL_SUCCESS)
+      mmal_buffer_header_release(buffer);
+}
+
+/** Callback from the control port */
+static void control_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_PARAM_UNUSED(port);
+   if (buffer->cmd == MMAL_EVENT_ERROR)
+   {
+      context.status = *(MMAL_STATUS_T *)buffer->data;
+      vcos_semaphore_post(&context.done);
+   }
+   mmal_buffer_header_release(buffer);
+}
+
+/** Benchmark the convert component */
+static MMAL_STATUS_T run_component(uint32_t from, uint32_t to)
+{
+   MMAL_COMPONENT_T *component = NULL;
+   MMAL_POOL_T *in_pool = NULL;
+   MMAL_PORT_T *input = NULL, *output = NULL;
+   MMAL_BUFFER_HEADER_T *buffer;
+   MMAL_STATUS_T status;
+   int64_t start_time, time;
+   unsigned int i;
+
+   context.received = 0;
+   context.status = MMAL_SUCCESS;
+   context.out_pool = NULL;
+
+   status = mmal_component_create("convert", &component);
+   CHECK_STATUS(status, "failed to create convert component");
+   input = component->input[0];
+   output = component->output[0];
+   status = mmal_port_enable(component->control, control_callback);
+   CHECK_STATUS(status, "failed to enable control port");
+
+   format_setup(input->format, from);
+   status = mmal_port_format_commit(input);
+   CHECK_STATUS(status, "failed to commit input format");
+   output->format->encoding = to;
+   status = mmal_port_format_commit(output);
+   CHECK_STATUS(status, "failed to commit output format");
+
+   input->buffer_num = output->buffer_num = 3;
+   input->buffer_size = input->buffer_size_min;
+   output->buffer_size = output->buffer_size_min;
+   context.out_pool = mmal_port_pool_create(output, output->buffer_num, output->buffer_size);
+   in_pool = mmal_port_pool_create(input, input->buffer_num, input->buffer_size);
+   if (!context.out_pool || !in_pool)
+   {
+      status = MMAL_ENOMEM;
+      CHECK_STATUS(status, "failed to create pools");
+   }
+   status = mmal_port_enable(output, output_callback);
+   CHECK_STATUS(status, "failed to enable output port");
+   status = mmal_port_enable(input, input_callback);
+   CHECK_STATUS(status, "failed to enable input port");
+
+   while ((buffer = mmal_queue_get(context.out_pool->queue)) != NULL)
+   {
+      status = mmal_port_send_buffer(output, buffer);
+      CHECK_STATUS(status, "failed to send output buffer");
+   }
+
+   start_time = vcos_getmicrosecs64();
+   for (i = 0; i < options.frames; i++)
+   {
+      buffer = mmal_queue_wait(in_pool->queue);
+      buffer->length = input->buffer_size;
+      status = mmal_port_send_buffer(input, buffer);
+      CHECK_STATUS(status, "failed to send input buffer");
+   }
+   vcos_semaphore_wait(&context.done);
+   time = vcos_getmicrosecs64() - start_time;
+   status = context.status;
+   CHECK_STATUS(status, "error during processing");
+
+   fprintf(stderr, "component %4.4s -> %4.4s %8.1f frames/s\n", (char *)&from, (char *)&to,
+           options.frames * 1000000.0 / time);
+
+ error:
+   if (component)
+   {
+      if (input->is_enabled)
+         mmal_port_disable(input);
+      if (output->is_enabled)
+         mmal_port_disable(output);
+      if (in_pool)
+         mmal_port_pool_destroy(input, in_pool);
+      if (context.out_pool)
+         mmal_port_pool_destroy(output, context.out_pool);
+      mmal_component_destroy(component);
+   }
+   return status;
+}
+
+int main(int argc, char **argv)
+{
+   MMAL_BOOL_T success = MMAL_TRUE;
+   char threads[16];
+   unsigned int i;
+   int c;
+
+   while ((c = getopt(argc, argv, "w:H:n:t:h")) != -1)
+   {
+      switch (c)
+      {
+      case 'w': options.width = strtoul(optarg, NULL, 0); break;
+      case 'H': options.height = strtoul(optarg, NULL, 0); break;
+      case 'n': options.frames = strtoul(optarg, NULL, 0); break;
+      case 't': options.threads = strtoul(optarg, NULL, 0); break;
+      default:
+         fprintf(stderr, "usage: %s [-w width] [-H height] [-n frames] [-t component threads]\n", argv[0]);
+         return c == 'h' ? 0 : -1;
+      }
+   }
+
+   if (options.width < 2 || options.height < 2 || !options.frames)
+   {
+      fprintf(stderr, "invalid arguments\n");
+      return -1;
+   }
+   options.width &= ~1;
+   options.height &= ~1;
+
+   if (options.threads)
+   {
+      snprintf(threads, sizeof(threads), "%u", options.threads);
+      setenv("MMAL_CONVERT_THREADS", threads, 1);
+   }
+
+   vcos_semaphore_create(&context.done, "mmal_bench_convert", 0);
+
+   fprintf(stderr, "%ux%u frames, best instruction set %s\n", options.width, options.height,
+           mmal_convert_isa_to_string(mmal_convert_isa_best()));
+
+   for (i = 0; i < vcos_countof(conversions); i++)
+      success &= run_kernels(conversions[i].from, conversions[i].to);
+
+   for (i = 0; i < vcos_countof(conversions); i++)
+      if (run_component(conversions[i].from, conversions[i].to) != MMAL_SUCCESS)
+         success = MMAL_FALSE;
+
+   vcos_semaphore_delete(&context.done);
+   return success ? 0 : -1;
+}
@@ -0,0 +1,243 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Measures the throughput of a multi-branch graph with serial and pipelined
+ * execution. The graph mimics decode -> resize -> (render | encode):
+ *
+ *   artificial_camera -> copy -> splitter -> copy -> null_sink
+ *                                         -> copy -> null_sink
+ *
+ * Every internal connection is driven by the graph worker threads, which also
+ * run a configurable amount of per-buffer work to stand in for client side
+ * processing done in the connection callback. */
+
+#include "mmal.h"
+#include "util/mmal_graph.h"
+#include "interface/vcos/vcos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CHECK_STATUS(status, msg) if (status != MMAL_SUCCESS) { fprintf(stderr, msg"\n"); goto error; }
+
+/** Benchmark options */
+static struct {
+   unsigned int work;       /**< Busy work per buffer and connection in microseconds */
+   unsigned int duration;   /**< Duration of each run in milliseconds */
+   unsigned int width;      /**< Width of the frames */
+   unsigned int height;     /**< Height of the frames */
+   unsigned int workers;    /**< Maximum number of workers in pipelined mode */
+} options = { 2000, 3000, 640, 480, 0 };
+
+/** Context for a run */
+static struct CONTEXT_T {
+   MMAL_COMPONENT_T *sink[2];
+   VCOS_MUTEX_T lock;
+   unsigned int frames;
+   MMAL_STATUS_T status;
+} context;
+
+/** Spin on the payload for the given amount of time */
+static void busy_work(MMAL_BUFFER_HEADER_T *buffer, unsigned int us)
+{
+   int64_t end = vcos_getmicrosecs64() + us;
+   volatile uint32_t sum = 0;
+   uint32_t i = 0;
+
+   while (vcos_getmicrosecs64() < end)
+   {
+      sum += buffer->data && buffer->length ? buffer->data[i++ % buffer->length] : i++;
+   }
+}
+
+/** Intercept buffers going through internal connections */
+static MMAL_STATUS_T connection_buffer(MMAL_GRAPH_T *graph, MMAL_CONNECTION_T *connection,
+   MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_PARAM_UNUSED(graph);
+
+   if (!buffer->cmd)
+   {
+      busy_work(buffer, options.work);
+
+      if (connection->in->component == context.sink[0] ||
+          connection->in->component == context.sink[1])
+      {
+         vcos_mutex_lock(&context.lock);
+         context.frames++;
+         vcos_mutex_unlock(&context.lock);
+      }
+   }
+
+   return MMAL_ENOSYS; /* Let the graph forward the buffer */
+}
+
+/** Callback from the control ports of the components */
+static void event_callback(MMAL_GRAPH_T *graph, MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer,
+   void *cb_data)
+{
+   MMAL_PARAM_UNUSED(graph); MMAL_PARAM_UNUSED(port); MMAL_PARAM_UNUSED(cb_data);
+
+   if (buffer->cmd == MMAL_EVENT_ERROR)
+      context.status = *(MMAL_STATUS_T *)buffer->data;
+   mmal_buffer_header_release(buffer);
+}
+
+/** Build the graph and run it for the configured duration */
+static MMAL_STATUS_T run(MMAL_GRAPH_EXECUTION_T mode)
+{
+   MMAL_COMPONENT_T *camera = 0, *decode = 0, *splitter = 0, *branch[2] = {0};
+   MMAL_GRAPH_T *graph = 0;
+   MMAL_STATUS_T status;
+   MMAL_PORT_T *port;
+   MMAL_BOOL_T enabled = MMAL_FALSE;
+   unsigned int i, frames;
+   int64_t time;
+
+   context.sink[0] = context.sink[1] = 0;
+   context.frames = 0;
+   context.status = MMAL_SUCCESS;
+
+   status = mmal_graph_create(&graph, 0);
+   CHECK_STATUS(status, "failed to create graph");
+   graph->pf_connection_buffer = connection_buffer;
+
+   status = mmal_graph_new_component(graph, "artificial_camera", &camera);
+   CHECK_STATUS(status, "failed to create camera");
+   status = mmal_graph_new_component(graph, "copy", &decode);
+   CHECK_STATUS(status, "failed to create copy");
+   status = mmal_graph_new_component(graph, "splitter", &splitter);
+   CHECK_STATUS(status, "failed to create splitter");
+   for (i = 0; i < 2; i++)
+   {
+      status = mmal_graph_new_component(graph, "copy", &branch[i]);
+      CHECK_STATUS(status, "failed to create copy");
+      status = mmal_graph_new_component(graph, "null_sink", &context.sink[i]);
+      CHECK_STATUS(status, "failed to create null_sink");
+   }
+
+   port = camera->output[0];
+   port->format->encoding = MMAL_ENCODING_I420;
+   port->format->es->video.width = options.width;
+   port->format->es->video.height = options.height;
+   status = mmal_port_format_commit(port);
+   CHECK_STATUS(status, "failed to commit camera format");
+
+   status = mmal_graph_new_connection(graph, camera->output[0], decode->input[0], 0, NULL);
+   CHECK_STATUS(status, "failed to connect camera");
+   status = mmal_graph_new_connection(graph, decode->output[0], splitter->input[0], 0, NULL);
+   CHECK_STATUS(status, "failed to connect splitter");
+   for (i = 0; i < 2; i++)
+   {
+      /* The splitter passes the buffers through so tell the branches how big they are */
+      splitter->output[i]->buffer_size = camera->output[0]->buffer_size_recommended;
+      status = mmal_graph_new_connection(graph, splitter->output[i], branch[i]->input[0], 0, NULL);
+      CHECK_STATUS(status, "failed to connect branch");
+      status = mmal_graph_new_connection(graph, branch[i]->output[0], context.sink[i]->input[0], 0, NULL);
+      CHECK_STATUS(status, "failed to connect sink");
+   }
+
+   status = mmal_graph_execution_mode(graph, mode, options.workers);
+   CHECK_STATUS(status, "failed to set execution mode");
+
+   status = mmal_graph_enable(graph, event_callback, NULL);
+   CHECK_STATUS(status, "failed to enable graph");
+   enabled = MMAL_TRUE;
+
+   time = vcos_getmicrosecs64();
+   vcos_sleep(options.duration);
+   vcos_mutex_lock(&context.lock);
+   frames = context.frames;
+   vcos_mutex_unlock(&context.lock);
+   time = vcos_getmicrosecs64() - time;
+
+   status = context.status;
+   CHECK_STATUS(status, "error during processing");
+
+   fprintf(stderr, "%-9s: %7.1f frames/s per branch\n",
+           mode == MMAL_GRAPH_EXECUTION_PIPELINED ? "pipelined" : "serial",
+           frames * 1000000.0 / time / 2);
+
+ error:
+   if (enabled)
+      mmal_graph_disable(graph);
+   if (camera)
+      mmal_component_release(camera);
+   if (decode)
+      mmal_component_release(decode);
+   if (splitter)
+      mmal_component_release(splitter);
+   for (i = 0; i < 2; i++)
+   {
+      if (branch[i])
+         mmal_component_release(branch[i]);
+      if (context.sink[i])
+         mmal_component_release(context.sink[i]);
+   }
+   if (graph)
+      mmal_graph_destroy(graph);
+   return status;
+}
+
+int main(int argc, char **argv)
+{
+   MMAL_STATUS_T status;
+   int c;
+
+   while ((c = getopt(argc, argv, "w:d:s:t:h")) != -1)
+   {
+      switch (c)
+      {
+      case 'w': options.work = strtoul(optarg, NULL, 0); break;
+      case 'd': options.duration = strtoul(optarg, NULL, 0); break;
+      case 's':
+         if (sscanf(optarg, "%ux%u", &options.width, &options.height) != 2)
+            c = '?';
+         break;
+      case 't': options.workers = strtoul(optarg, NULL, 0); break;
+      default: break;
+      }
+      if (c == 'h' || c == '?')
+      {
+         fprintf(stderr, "usage: %s [-w work per buffer (us)] [-d duration (ms)] "
+                 "[-s WxH] [-t max pipelined workers]\n", argv[0]);
+         return c == 'h' ? 0 : -1;
+      }
+   }
+
+   vcos_mutex_create(&context.lock, "mmal_bench_graph");
+
+   fprintf(stderr, "%ux%u frames, %u us of work per buffer and connection\n",
+           options.width, options.height, options.work);
+
+   status = run(MMAL_GRAPH_EXECUTION_SERIAL);
+   if (status == MMAL_SUCCESS)
+      status = run(MMAL_GRAPH_EXECUTION_PIPELINED);
+
+   vcos_mutex_delete(&context.lock);
+   return status == MMAL_SUCCESS ? 0 : -1;
+}
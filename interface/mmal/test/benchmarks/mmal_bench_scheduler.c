@@ -0,0 +1,314 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Measures the throughput and number of context switches of chains of copy
+ * components, with each component running on a dedicated action thread and
+ * with the shared scheduler worker pool. */
+
+#include "mmal.h"
+#include "util/mmal_connection.h"
+#include "util/mmal_util.h"
+#include "interface/vcos/vcos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define CHECK_STATUS(status, msg) if (status != MMAL_SUCCESS) { fprintf(stderr, msg"\n"); goto error; }
+
+#define CHAINS_MAX 64
+#define LENGTH_MAX 64
+
+/** Benchmark options */
+static struct {
+   unsigned int chains;       /**< Number of parallel chains */
+   unsigned int length;       /**< Number of copy components per chain */
+   unsigned int buffers;      /**< Number of buffers pushed through each run */
+   unsigned int buffer_num;   /**< Number of buffers in flight per chain */
+   unsigned int buffer_size;  /**< Size of the payload copied by each component */
+} options = { 4, 8, 20000, 4, 4096 };
+
+/** Context for a run */
+static struct CONTEXT_T {
+   VCOS_MUTEX_T lock;
+   VCOS_SEMAPHORE_T done;
+   unsigned int received;
+   unsigned int expected;
+   MMAL_STATUS_T status;
+   MMAL_POOL_T *out_pool[CHAINS_MAX]; /**< Pools used by the output port of each chain */
+} context;
+
+/** Callback from the input port of a chain. The buffer goes back to the input pool. */
+static void input_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   MMAL_PARAM_UNUSED(port);
+   mmal_buffer_header_release(buffer);
+}
+
+/** Callback from the output port of a chain. The buffer is recycled straight away. */
+static void output_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   struct CONTEXT_T *ctx = &context;
+   MMAL_POOL_T *pool = (MMAL_POOL_T *)port->userdata;
+   MMAL_BOOL_T done;
+
+   mmal_buffer_header_release(buffer);
+
+   vcos_mutex_lock(&ctx->lock);
+   done = ++ctx->received == ctx->expected;
+   vcos_mutex_unlock(&ctx->lock);
+   if (done)
+      vcos_semaphore_post(&ctx->done);
+
+   if (!port->is_enabled)
+      return;
+   buffer = mmal_queue_get(pool->queue);
+   if (buffer && mmal_port_send_buffer(port, buffer) != MMAL_SUCCESS)
+      mmal_buffer_header_release(buffer);
+}
+
+/** Callback from a control port */
+static void control_callback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
+{
+   struct CONTEXT_T *ctx = (struct CONTEXT_T *)port->userdata;
+
+   if (buffer->cmd == MMAL_EVENT_ERROR)
+      ctx->status = *(MMAL_STATUS_T *)buffer->data;
+   mmal_buffer_header_release(buffer);
+}
+
+static int64_t context_switches(void)
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+/** Run the benchmark once with the given number of worker threads */
+static MMAL_STATUS_T run(unsigned int threads)
+{
+   MMAL_COMPONENT_T *component[CHAINS_MAX][LENGTH_MAX];
+   MMAL_CONNECTION_T *connection[CHAINS_MAX][LENGTH_MAX];
+   MMAL_POOL_T *in_pool = NULL;
+   MMAL_BUFFER_HEADER_T *buffer;
+   MMAL_STATUS_T status;
+   unsigned int i, j, sent;
+   int64_t start_time, time, start_switches, switches;
+
+   memset(component, 0, sizeof(component));
+   memset(connection, 0, sizeof(connection));
+   memset(context.out_pool, 0, sizeof(context.out_pool));
+   context.received = 0;
+   context.expected = options.buffers;
+   context.status = MMAL_SUCCESS;
+
+   status = mmal_component_scheduler_configure(threads);
+   CHECK_STATUS(status, "failed to configure scheduler");
+
+   for (i = 0; i < options.chains; i++)
+   {
+      MMAL_PORT_T *input, *output;
+
+      for (j = 0; j < options.length; j++)
+      {
+         status = mmal_component_create("copy", &component[i][j]);
+         CHECK_STATUS(status, "failed to create copy component");
+         component[i][j]->control->userdata = (void *)&context;
+         status = mmal_port_enable(component[i][j]->control, control_callback);
+         CHECK_STATUS(status, "failed to enable control port");
+      }
+
+      input = component[i][0]->input[0];
+      input->format->type = MMAL_ES_TYPE_VIDEO;
+      input->format->encoding = MMAL_ENCODING_I420;
+      input->buffer_num = options.buffer_num;
+      input->buffer_size = options.buffer_size;
+      status = mmal_port_format_commit(input);
+      CHECK_STATUS(status, "failed to commit format");
+
+      for (j = 1; j < options.length; j++)
+      {
+         MMAL_PORT_T *out = component[i][j-1]->output[0], *in = component[i][j]->input[0];
+
+         out->buffer_num = in->buffer_num = options.buffer_num;
+         out->buffer_size = in->buffer_size = options.buffer_size;
+         status = mmal_connection_create(&connection[i][j], out, in,
+                                         MMAL_CONNECTION_FLAG_TUNNELLING);
+         CHECK_STATUS(status, "failed to create connection");
+         in->buffer_size = options.buffer_size;
+         status = mmal_connection_enable(connection[i][j]);
+         CHECK_STATUS(status, "failed to enable connection");
+      }
+
+      output = component[i][options.length-1]->output[0];
+      output->buffer_num = options.buffer_num;
+      output->buffer_size = options.buffer_size;
+      context.out_pool[i] = mmal_port_pool_create(output, output->buffer_num, output->buffer_size);
+      output->userdata = (void *)context.out_pool[i];
+      if (!context.out_pool[i])
+      {
+         status = MMAL_ENOMEM;
+         CHECK_STATUS(status, "failed to create output pool");
+      }
+      status = mmal_port_enable(output, output_callback);
+      CHECK_STATUS(status, "failed to enable output port");
+      status = mmal_port_enable(input, input_callback);
+      CHECK_STATUS(status, "failed to enable input port");
+   }
+
+   in_pool = mmal_pool_create(options.buffer_num * options.chains, options.buffer_size);
+   if (!in_pool)
+   {
+      status = MMAL_ENOMEM;
+      CHECK_STATUS(status, "failed to create input pool");
+   }
+
+   for (i = 0; i < options.chains; i++)
+   {
+      MMAL_PORT_T *output = component[i][options.length-1]->output[0];
+      MMAL_POOL_T *pool = context.out_pool[i];
+
+      while ((buffer = mmal_queue_get(pool->queue)) != NULL)
+      {
+         status = mmal_port_send_buffer(output, buffer);
+         CHECK_STATUS(status, "failed to send output buffer");
+      }
+   }
+
+   start_switches = context_switches();
+   start_time = vcos_getmicrosecs64();
+
+   for (sent = 0; sent < options.buffers; sent++)
+   {
+      buffer = mmal_queue_wait(in_pool->queue);
+      buffer->length = options.buffer_size;
+      status = mmal_port_send_buffer(component[sent % options.chains][0]->input[0], buffer);
+      CHECK_STATUS(status, "failed to send input buffer");
+   }
+   vcos_semaphore_wait(&context.done);
+
+   time = vcos_getmicrosecs64() - start_time;
+   switches = context_switches() - start_switches;
+   status = context.status;
+   CHECK_STATUS(status, "error during processing");
+
+   fprintf(stderr, "%-10s %3u threads: %8.0f buffers/s, %7.1f MB/s copied, "
+           "%8lld context switches (%.2f per buffer)\n",
+           threads ? "pool" : "dedicated",
+           threads ? threads : options.chains * options.length,
+           options.buffers * 1000000.0 / time,
+           (double)options.buffers * options.length * options.buffer_size / time,
+           (long long)switches, (double)switches / options.buffers);
+
+ error:
+   for (i = 0; i < options.chains; i++)
+   {
+      if (component[i][options.length-1])
+      {
+         MMAL_PORT_T *output = component[i][options.length-1]->output[0];
+         if (output->is_enabled)
+            mmal_port_disable(output);
+         if (context.out_pool[i])
+            mmal_port_pool_destroy(output, context.out_pool[i]);
+      }
+      if (component[i][0] && component[i][0]->input[0]->is_enabled)
+         mmal_port_disable(component[i][0]->input[0]);
+      for (j = 0; j < options.length; j++)
+      {
+         if (connection[i][j])
+            mmal_connection_destroy(connection[i][j]);
+      }
+      for (j = 0; j < options.length; j++)
+      {
+         if (component[i][j])
+            mmal_component_destroy(component[i][j]);
+      }
+   }
+   if (in_pool)
+      mmal_pool_destroy(in_pool);
+   return status;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int threads[8], threads_num = 0, i;
+   int c;
+
+   while ((c = getopt(argc, argv, "c:l:n:b:s:t:h")) != -1)
+   {
+      switch (c)
+      {
+      case 'c': options.chains = strtoul(optarg, NULL, 0); break;
+      case 'l': options.length = strtoul(optarg, NULL, 0); break;
+      case 'n': options.buffers = strtoul(optarg, NULL, 0); break;
+      case 'b': options.buffer_num = strtoul(optarg, NULL, 0); break;
+      case 's': options.buffer_size = strtoul(optarg, NULL, 0); break;
+      case 't':
+         if (threads_num < vcos_countof(threads))
+            threads[threads_num++] = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         fprintf(stderr, "usage: %s [-c chains] [-l length] [-n buffers] "
+                 "[-b buffers in flight] [-s buffer size] [-t threads]...\n"
+                 "  -t can be given several times, 0 means dedicated threads\n", argv[0]);
+         return c == 'h' ? 0 : -1;
+      }
+   }
+
+   if (!options.chains || options.chains > CHAINS_MAX ||
+       !options.length || options.length > LENGTH_MAX ||
+       !options.buffers || !options.buffer_num || !options.buffer_size)
+   {
+      fprintf(stderr, "invalid arguments\n");
+      return -1;
+   }
+
+   /* By default compare dedicated threads with a pool of a few workers */
+   if (!threads_num)
+   {
+      threads[threads_num++] = 0;
+      threads[threads_num++] = 2;
+      threads[threads_num++] = 4;
+   }
+
+   vcos_mutex_create(&context.lock, "mmal_bench_scheduler");
+   vcos_semaphore_create(&context.done, "mmal_bench_scheduler", 0);
+
+   fprintf(stderr, "%u chains of %u copy components, %u buffers of %u bytes (%u in flight)\n",
+           options.chains, options.length, options.buffers, options.buffer_size,
+           options.buffer_num);
+
+   for (i = 0; i < threads_num; i++)
+      if (run(threads[i]) != MMAL_SUCCESS)
+         break;
+
+   vcos_semaphore_delete(&context.done);
+   vcos_mutex_delete(&context.lock);
+   return i == threads_num ? 0 : -1;
+}
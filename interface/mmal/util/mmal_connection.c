@@ -366,13 +366,30 @@ MMAL_STATUS_T mmal_connection_enable(MMAL_CONNECTION_T *connection)
       MMAL_BUFFER_HEADER_T *buffer = mmal_queue_get(connection->pool->queue);
       while (buffer)
       {
-         mmal_port_send_buffer(out, buffer);
-         buffer = mmal_queue_get(connection->pool->queue);
-         if (buffer)
+         MMAL_BUFFER_HEADER_T *out_batch[MMAL_PORT_BUFFER_BATCH_MAX / 2];
+         MMAL_BUFFER_HEADER_T *in_batch[MMAL_PORT_BUFFER_BATCH_MAX / 2];
+         unsigned int i, out_num = 0, in_num = 0;
+
+         /* Share the buffers between both ports */
+         while (buffer && in_num < MMAL_PORT_BUFFER_BATCH_MAX / 2)
          {
-            mmal_port_send_buffer(in, buffer);
+            out_batch[out_num++] = buffer;
             buffer = mmal_queue_get(connection->pool->queue);
+            if (buffer)
+            {
+               in_batch[in_num++] = buffer;
+               buffer = mmal_queue_get(connection->pool->queue);
+            }
          }
+
+         if (mmal_port_send_buffers(out, out_batch, out_num) != MMAL_SUCCESS)
+            for (i = 0; i < out_num; i++)
+               if (out_batch[i])
+                  mmal_buffer_header_release(out_batch[i]);
+         if (mmal_port_send_buffers(in, in_batch, in_num) != MMAL_SUCCESS)
+            for (i = 0; i < in_num; i++)
+               if (in_batch[i])
+                  mmal_buffer_header_release(in_batch[i]);
       }
    }
 
@@ -33,9 +33,30 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "mmal_logging.h"
 
 #define GRAPH_CONNECTIONS_MAX 16
+#define GRAPH_STAGES_MAX GRAPH_CONNECTIONS_MAX
 #define PROCESSING_TIME_MAX 20000
 
 /*****************************************************************************/
+struct MMAL_COMPONENT_MODULE_T;
+
+/** Pipeline stage.
+ * In pipelined execution mode, each stage has its own worker thread which drives
+ * a subset of the internal connections. The queues of the connections at the
+ * boundaries of a stage are bounded by the number of buffers of the connection. */
+typedef struct MMAL_GRAPH_STAGE_T
+{
+   struct MMAL_COMPONENT_MODULE_T *graph;
+
+   MMAL_CONNECTION_T *connection[GRAPH_CONNECTIONS_MAX];
+   unsigned int connection_num;
+   unsigned int connection_current;
+
+   MMAL_BOOL_T stop_thread;      /**< informs the worker thread to exit */
+   VCOS_THREAD_T thread;         /**< worker thread which processes the connections of the stage */
+   VCOS_SEMAPHORE_T sema;        /**< informs the worker thread that buffers are available */
+
+} MMAL_GRAPH_STAGE_T;
+
 
 /** Private context for our graph.
  * This also acts as a MMAL_COMPONENT_MODULE_T for when components are instantiated from graphs */
@@ -64,6 +85,12 @@ typedef struct MMAL_COMPONENT_MODULE_T
    VCOS_THREAD_T thread;         /**< worker thread which processes all internal connections */
    VCOS_SEMAPHORE_T sema;        /**< informs the worker thread that buffers are available */
 
+   MMAL_GRAPH_EXECUTION_T execution; /**< execution mode used when the graph is enabled */
+   unsigned int workers_max;     /**< maximum number of worker threads in pipelined mode */
+   MMAL_GRAPH_STAGE_T *stage;    /**< pipeline stages (pipelined mode only) */
+   unsigned int stage_num;
+   MMAL_BOOL_T enabled;
+
    MMAL_GRAPH_EVENT_CB event_cb; /**< callback for sending control port events to the client */
    void *event_cb_data;          /**< callback data supplied by the client */
 
@@ -74,8 +101,12 @@ typedef MMAL_GRAPH_PRIVATE_T MMAL_COMPONENT_MODULE_T;
 /*****************************************************************************/
 static MMAL_STATUS_T mmal_component_create_from_graph(const char *name, MMAL_COMPONENT_T *component);
 static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph);
+static MMAL_BOOL_T graph_do_processing_connections(MMAL_GRAPH_PRIVATE_T *graph_private,
+   MMAL_CONNECTION_T **connections, unsigned int connection_num, unsigned int *connection_current);
 static void graph_process_buffer(MMAL_GRAPH_PRIVATE_T *graph_private,
    MMAL_CONNECTION_T *connection, MMAL_BUFFER_HEADER_T *buffer);
+static MMAL_BOOL_T graph_component_topology_ports_linked(MMAL_GRAPH_PRIVATE_T *graph,
+   MMAL_PORT_T *port1, MMAL_PORT_T *port2);
 
 /*****************************************************************************/
 static void graph_control_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
@@ -139,6 +170,206 @@ static void graph_stop_worker_thread(MMAL_GRAPH_PRIVATE_T *graph)
    vcos_thread_join(&graph->thread, NULL);
 }
 
+/*****************************************************************************/
+static void graph_stage_connection_cb(MMAL_CONNECTION_T *connection)
+{
+   MMAL_GRAPH_STAGE_T *stage = (MMAL_GRAPH_STAGE_T *)connection->user_data;
+   MMAL_BUFFER_HEADER_T *buffer;
+
+   if (connection->flags == MMAL_CONNECTION_FLAG_DIRECT &&
+       (buffer = mmal_queue_get(connection->queue)) != NULL)
+   {
+      graph_process_buffer(stage->graph, connection, buffer);
+      return;
+   }
+
+   vcos_semaphore_post(&stage->sema);
+}
+
+/*****************************************************************************/
+static void* graph_stage_worker_thread(void* ctx)
+{
+   MMAL_GRAPH_STAGE_T *stage = (MMAL_GRAPH_STAGE_T *)ctx;
+
+   while (1)
+   {
+      vcos_semaphore_wait(&stage->sema);
+      if (stage->stop_thread)
+         break;
+      while(graph_do_processing_connections(stage->graph, stage->connection,
+               stage->connection_num, &stage->connection_current));
+   }
+
+   LOG_TRACE("stage worker thread exit %p", stage);
+
+   return 0;
+}
+
+/*****************************************************************************/
+static void graph_stop_stages(MMAL_GRAPH_PRIVATE_T *graph)
+{
+   unsigned int i;
+
+   for (i = 0; i < graph->stage_num; i++)
+   {
+      graph->stage[i].stop_thread = MMAL_TRUE;
+      vcos_semaphore_post(&graph->stage[i].sema);
+   }
+   for (i = 0; i < graph->stage_num; i++)
+   {
+      vcos_thread_join(&graph->stage[i].thread, NULL);
+      vcos_semaphore_delete(&graph->stage[i].sema);
+   }
+
+   vcos_free(graph->stage);
+   graph->stage = NULL;
+   graph->stage_num = 0;
+}
+
+/*****************************************************************************/
+static unsigned int graph_partition_find(unsigned int *set, unsigned int i)
+{
+   while (set[i] != i)
+      i = set[i] = set[set[i]];
+   return i;
+}
+
+/** Connections which are not driven by a stage worker of their own */
+static MMAL_BOOL_T graph_partition_excluded(MMAL_CONNECTION_T *cx)
+{
+   return (cx->flags & MMAL_CONNECTION_FLAG_TUNNELLING) || cx->out->type == MMAL_PORT_TYPE_CLOCK;
+}
+
+/** Check whether a connection going into a component and one coming out of it
+ * belong to the same linear section of the graph. This is the case when the
+ * topology of the component links both ports and neither of them has another
+ * linked connection on the same component. */
+static MMAL_BOOL_T graph_partition_chained(MMAL_GRAPH_PRIVATE_T *graph,
+   MMAL_CONNECTION_T *cx_in, MMAL_CONNECTION_T *cx_out)
+{
+   unsigned int i;
+
+   if (cx_in->in->component != cx_out->out->component ||
+       cx_in->in->type != MMAL_PORT_TYPE_INPUT || cx_out->out->type != MMAL_PORT_TYPE_OUTPUT)
+      return MMAL_FALSE;
+
+   if (!graph_component_topology_ports_linked(graph, cx_in->in, cx_out->out))
+      return MMAL_FALSE;
+
+   for (i = 0; i < graph->connection_num; i++)
+   {
+      MMAL_CONNECTION_T *cx = graph->connection[i];
+
+      /* Another branch coming out of the same component (fork) */
+      if (cx != cx_out && cx->out->component == cx_out->out->component &&
+          cx->out->type == MMAL_PORT_TYPE_OUTPUT &&
+          graph_component_topology_ports_linked(graph, cx_in->in, cx->out))
+         return MMAL_FALSE;
+
+      /* Another branch going into the same component (join) */
+      if (cx != cx_in && cx->in->component == cx_in->in->component &&
+          cx->in->type == MMAL_PORT_TYPE_INPUT &&
+          graph_component_topology_ports_linked(graph, cx->in, cx_out->out))
+         return MMAL_FALSE;
+   }
+
+   return MMAL_TRUE;
+}
+
+/** Partition the internal connections into pipeline stages and start their workers.
+ * Linear sections of the graph form a stage, and a new stage starts at every
+ * component where the graph forks or joins, as described by the topology of the
+ * components. Connections which don't need a worker (tunnelled) and clock
+ * connections all go into the first stage. */
+static MMAL_STATUS_T graph_start_stages(MMAL_GRAPH_PRIVATE_T *graph)
+{
+   unsigned int set[GRAPH_CONNECTIONS_MAX], stage_index[GRAPH_CONNECTIONS_MAX];
+   unsigned int i, j, stage_num = 0, workers_max;
+
+   for (i = 0; i < graph->connection_num; i++)
+      set[i] = i;
+
+   for (i = 0; i < graph->connection_num; i++)
+   {
+      MMAL_CONNECTION_T *cx = graph->connection[i];
+
+      if (graph_partition_excluded(cx))
+      {
+         set[graph_partition_find(set, i)] = graph_partition_find(set, 0);
+         continue;
+      }
+
+      for (j = 0; j < graph->connection_num; j++)
+         if (j != i && !graph_partition_excluded(graph->connection[j]) &&
+             graph_partition_chained(graph, cx, graph->connection[j]))
+            set[graph_partition_find(set, j)] = graph_partition_find(set, i);
+   }
+
+   /* Number the stages */
+   workers_max = graph->workers_max ? graph->workers_max : GRAPH_STAGES_MAX;
+   for (i = 0; i < graph->connection_num; i++)
+      stage_index[i] = (unsigned int)-1;
+   for (i = 0; i < graph->connection_num; i++)
+   {
+      unsigned int root = graph_partition_find(set, i);
+      if (stage_index[root] == (unsigned int)-1)
+         stage_index[root] = stage_num++ % workers_max;
+   }
+   stage_num = MMAL_MIN(stage_num, workers_max);
+   if (!stage_num)
+      stage_num = 1;
+
+   graph->stage = vcos_calloc(stage_num, sizeof(*graph->stage), "mmal graph stages");
+   if (!graph->stage)
+      return MMAL_ENOMEM;
+
+   for (i = 0; i < graph->connection_num; i++)
+   {
+      MMAL_GRAPH_STAGE_T *stage = &graph->stage[stage_index[graph_partition_find(set, i)]];
+      MMAL_CONNECTION_T *cx = graph->connection[i];
+
+      stage->connection[stage->connection_num++] = cx;
+      cx->callback = graph_stage_connection_cb;
+      cx->user_data = stage;
+   }
+
+   for (i = 0; i < stage_num; i++)
+   {
+      MMAL_GRAPH_STAGE_T *stage = &graph->stage[i];
+
+      stage->graph = graph;
+      if (vcos_semaphore_create(&stage->sema, "mmal graph stage sema", 0) != VCOS_SUCCESS)
+         break;
+      if (vcos_thread_create(&stage->thread, "mmal graph stage", NULL,
+                             graph_stage_worker_thread, stage) != VCOS_SUCCESS)
+      {
+         vcos_semaphore_delete(&stage->sema);
+         break;
+      }
+      graph->stage_num++;
+      LOG_DEBUG("graph %p stage %u has %u connections", graph, i, stage->connection_num);
+   }
+
+   if (graph->stage_num != stage_num)
+   {
+      LOG_ERROR("failed to create worker thread for stage %u", graph->stage_num);
+      graph_stop_stages(graph);
+      return MMAL_ENOSPC;
+   }
+
+   return MMAL_SUCCESS;
+}
+
+/*****************************************************************************/
+static void graph_stop_workers(MMAL_GRAPH_PRIVATE_T *graph)
+{
+   if (graph->stage_num)
+      graph_stop_stages(graph);
+   else
+      graph_stop_worker_thread(graph);
+   graph->enabled = MMAL_FALSE;
+}
+
 /*****************************************************************************/
 MMAL_STATUS_T mmal_graph_create(MMAL_GRAPH_T **graph, unsigned int userdata_size)
 {
@@ -246,6 +477,22 @@ MMAL_STATUS_T mmal_graph_component_topology(MMAL_GRAPH_T *graph, MMAL_COMPONENT_
    return MMAL_SUCCESS;
 }
 
+/*****************************************************************************/
+MMAL_STATUS_T mmal_graph_execution_mode(MMAL_GRAPH_T *graph, MMAL_GRAPH_EXECUTION_T mode,
+   unsigned int workers_max)
+{
+   MMAL_GRAPH_PRIVATE_T *private = (MMAL_GRAPH_PRIVATE_T *)graph;
+
+   LOG_TRACE("graph: %p, mode: %i, workers_max: %u", graph, (int)mode, workers_max);
+
+   if (!graph || mode >= MMAL_GRAPH_EXECUTION_MAX || private->enabled)
+      return MMAL_EINVAL;
+
+   private->execution = mode;
+   private->workers_max = workers_max;
+   return MMAL_SUCCESS;
+}
+
 /*****************************************************************************/
 MMAL_STATUS_T mmal_graph_add_connection(MMAL_GRAPH_T *graph, MMAL_CONNECTION_T *cx)
 {
@@ -388,12 +635,22 @@ MMAL_STATUS_T mmal_graph_enable(MMAL_GRAPH_T *graph, MMAL_GRAPH_EVENT_CB cb, voi
 
    LOG_TRACE("graph: %p", graph);
 
-   if (vcos_thread_create(&private->thread, "mmal graph thread", NULL,
-                          graph_worker_thread, private) != VCOS_SUCCESS)
+   if (private->enabled)
+      return MMAL_EINVAL;
+
+   if (private->execution == MMAL_GRAPH_EXECUTION_PIPELINED)
+   {
+      status = graph_start_stages(private);
+      if (status != MMAL_SUCCESS)
+         return status;
+   }
+   else if (vcos_thread_create(&private->thread, "mmal graph thread", NULL,
+                               graph_worker_thread, private) != VCOS_SUCCESS)
    {
       LOG_ERROR("failed to create worker thread %p", graph);
       return MMAL_ENOSPC;
    }
+   private->enabled = MMAL_TRUE;
 
    private->event_cb = cb;
    private->event_cb_data = cb_data;
@@ -412,20 +669,29 @@ MMAL_STATUS_T mmal_graph_enable(MMAL_GRAPH_T *graph, MMAL_GRAPH_EVENT_CB cb, voi
    {
       MMAL_CONNECTION_T *cx = private->connection[i];
 
-      cx->callback = graph_connection_cb;
-      cx->user_data = private;
+      if (private->execution != MMAL_GRAPH_EXECUTION_PIPELINED)
+      {
+         cx->callback = graph_connection_cb;
+         cx->user_data = private;
+      }
 
       status = mmal_connection_enable(cx);
       if (status != MMAL_SUCCESS)
          goto error;
    }
 
-   /* Trigger the worker thread to populate the output ports with empty buffers */
-   vcos_semaphore_post(&private->sema);
+   /* Trigger the worker threads to populate the output ports with empty buffers */
+   if (private->execution == MMAL_GRAPH_EXECUTION_PIPELINED)
+   {
+      for (i = 0; i < private->stage_num; i++)
+         vcos_semaphore_post(&private->stage[i].sema);
+   }
+   else
+      vcos_semaphore_post(&private->sema);
    return status;
 
  error:
-   graph_stop_worker_thread(private);
+   graph_stop_workers(private);
    return status;
 }
 
@@ -438,12 +704,19 @@ MMAL_STATUS_T mmal_graph_disable(MMAL_GRAPH_T *graph)
 
    LOG_TRACE("graph: %p", graph);
 
-   graph_stop_worker_thread(private);
+   if (!private->enabled)
+      return MMAL_SUCCESS;
 
-   /* Disable all our connections */
-   for (i = 0; i < private->connection_num; i++)
+   graph_stop_workers(private);
+
+   /* Disable all our connections in reverse order, i.e. starting from the most
+    * downstream ones for graphs built from their source. Buffers sitting in the
+    * queues of the connections are not forwarded anymore and they might still
+    * reference buffers from upstream ports (e.g. splitter outputs) so those need
+    * to be released first. */
+   for (i = private->connection_num; i; i--)
    {
-      status = mmal_connection_disable(private->connection[i]);
+      status = mmal_connection_disable(private->connection[i-1]);
       if (status != MMAL_SUCCESS)
          break;
    }
@@ -576,7 +849,8 @@ static void graph_process_buffer(MMAL_GRAPH_PRIVATE_T *graph_private,
 }
 
 /*****************************************************************************/
-static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph_private)
+static MMAL_BOOL_T graph_do_processing_connections(MMAL_GRAPH_PRIVATE_T *graph_private,
+   MMAL_CONNECTION_T **connections, unsigned int connection_num, unsigned int *connection_current)
 {
    MMAL_BUFFER_HEADER_T *buffer;
    MMAL_BOOL_T run_again = 0;
@@ -584,11 +858,9 @@ static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph_private)
    unsigned int i, j;
 
    /* Process all the empty buffers first */
-   for (i = 0, j = graph_private->connection_current;
-        i < graph_private->connection_num; i++, j++)
+   for (i = 0, j = *connection_current; i < connection_num; i++, j++)
    {
-      MMAL_CONNECTION_T *connection =
-         graph_private->connection[j%graph_private->connection_num];
+      MMAL_CONNECTION_T *connection = connections[j%connection_num];
 
       if ((connection->flags & MMAL_CONNECTION_FLAG_TUNNELLING) ||
           !connection->pool)
@@ -597,14 +869,25 @@ static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph_private)
       /* Send empty buffers to the output port of the connection */
       while ((buffer = mmal_queue_get(connection->pool->queue)) != NULL)
       {
+         MMAL_BUFFER_HEADER_T *batch[MMAL_PORT_BUFFER_BATCH_MAX];
+         unsigned int num = 0;
+
          run_again = 1;
 
-         status = mmal_port_send_buffer(connection->out, buffer);
+         batch[num++] = buffer;
+         while (num < MMAL_PORT_BUFFER_BATCH_MAX &&
+                (buffer = mmal_queue_get(connection->pool->queue)) != NULL)
+            batch[num++] = buffer;
+
+         status = mmal_port_send_buffers(connection->out, batch, num);
          if (status != MMAL_SUCCESS)
          {
             if (connection->out->is_enabled)
-               LOG_ERROR("mmal_port_send_buffer failed (%i)", status);
-            mmal_queue_put_back(connection->pool->queue, buffer);
+               LOG_ERROR("mmal_port_send_buffers failed (%i)", status);
+            /* Put back the buffers which weren't accepted, preserving their order */
+            while (num--)
+               if (batch[num])
+                  mmal_queue_put_back(connection->pool->queue, batch[num]);
             run_again = 0;
             break;
          }
@@ -612,11 +895,9 @@ static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph_private)
    }
 
    /* Loop through all the connections */
-   for (i = 0, j = graph_private->connection_current++;
-        i < graph_private->connection_num; i++, j++)
+   for (i = 0, j = (*connection_current)++; i < connection_num; i++, j++)
    {
-      MMAL_CONNECTION_T *connection =
-         graph_private->connection[j%graph_private->connection_num];
+      MMAL_CONNECTION_T *connection = connections[j%connection_num];
       int64_t duration = vcos_getmicrosecs64();
 
       if (connection->flags & MMAL_CONNECTION_FLAG_TUNNELLING)
@@ -639,6 +920,13 @@ static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph_private)
    return run_again;
 }
 
+/*****************************************************************************/
+static MMAL_BOOL_T graph_do_processing(MMAL_GRAPH_PRIVATE_T *graph_private)
+{
+   return graph_do_processing_connections(graph_private, graph_private->connection,
+      graph_private->connection_num, &graph_private->connection_current);
+}
+
 /*****************************************************************************/
 static void graph_do_processing_loop(MMAL_COMPONENT_T *component)
 {
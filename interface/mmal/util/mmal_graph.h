@@ -51,6 +51,15 @@ typedef enum
 
 } MMAL_GRAPH_TOPOLOGY_T;
 
+/** List of execution modes */
+typedef enum
+{
+   MMAL_GRAPH_EXECUTION_SERIAL = 0, /**< A single worker thread drives all the internal connections */
+   MMAL_GRAPH_EXECUTION_PIPELINED,  /**< Each pipeline stage is driven by its own worker thread */
+   MMAL_GRAPH_EXECUTION_MAX
+
+} MMAL_GRAPH_EXECUTION_T;
+
 /** Structure describing a graph */
 typedef struct MMAL_GRAPH_T
 {
@@ -128,6 +137,25 @@ MMAL_STATUS_T mmal_graph_component_topology(MMAL_GRAPH_T *graph, MMAL_COMPONENT_
     MMAL_GRAPH_TOPOLOGY_T topology, int8_t *input, unsigned int input_num,
     int8_t *output, unsigned int output_num);
 
+/** Select how the internal connections of a graph are driven.
+ * By default a single worker thread processes all the internal connections of the
+ * graph, which means independent branches are processed serially.
+ * In pipelined mode, \ref mmal_graph_enable partitions the graph into pipeline stages
+ * using the topology of the components. Linear sections of the graph form a stage and
+ * a new stage starts wherever the graph forks or joins. Each stage gets its own worker
+ * thread and the queues of the connections between stages are bounded by the number of
+ * buffers of these connections.
+ * This only applies to \ref mmal_graph_enable and must be called before it.
+ *
+ * @param graph       instance of the graph
+ * @param mode        execution mode
+ * @param workers_max maximum number of worker threads in pipelined mode (0 for no limit).
+ *                    Stages are shared between workers when there are more stages.
+ * @return MMAL_SUCCESS on success
+ */
+MMAL_STATUS_T mmal_graph_execution_mode(MMAL_GRAPH_T *graph, MMAL_GRAPH_EXECUTION_T mode,
+   unsigned int workers_max);
+
 /** Add a port to a graph.
  * Allows the client to add an input or output port to a graph. The given port
  * will effectively become an end point for the graph.
@@ -86,6 +86,10 @@ static struct {
    {MMAL_ENCODING_RGB24, 3, 1, 1},
    {MMAL_ENCODING_BGR16, 2, 1, 1},
    {MMAL_ENCODING_BGR24, 3, 1, 1},
+   {MMAL_ENCODING_YUYV,  2, 1, 1},
+   {MMAL_ENCODING_YVYU,  2, 1, 1},
+   {MMAL_ENCODING_UYVY,  2, 1, 1},
+   {MMAL_ENCODING_VYUY,  2, 1, 1},
    {MMAL_ENCODING_I420_16, 2, 1, 1},
    {MMAL_ENCODING_I420_10, 2, 1, 1},
    {MMAL_ENCODING_I420_S, 1, 1, 1},
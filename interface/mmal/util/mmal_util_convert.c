@@ -0,0 +1,948 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+#include "interface/mmal/mmal.h"
+#include "interface/mmal/util/mmal_util.h"
+#include "interface/mmal/util/mmal_util_convert.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define CONVERT_HAVE_SSE2
+# define CONVERT_HAVE_AVX2
+# define CONVERT_TARGET_SSE2 __attribute__((target("sse2")))
+# define CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define CONVERT_HAVE_NEON
+#endif
+
+/* YUV to RGB conversion uses BT.601 limited range coefficients in Q6 fixed point,
+ * which keeps all the intermediate values within 16 bits for the SIMD kernels:
+ *   R = (74 * (Y - 16) + 102 * (V - 128) + 32) >> 6
+ *   G = (74 * (Y - 16) -  25 * (U - 128) - 52 * (V - 128) + 32) >> 6
+ *   B = (74 * (Y - 16) + 129 * (U - 128) + 32) >> 6
+ * The SIMD kernels use saturating 16 bits additions, which only saturate for
+ * values which get clamped to 255 anyway, so all implementations match exactly. */
+#define CONVERT_Y_MUL   74
+#define CONVERT_RV_MUL  102
+#define CONVERT_GU_MUL  25
+#define CONVERT_GV_MUL  52
+#define CONVERT_BU_MUL  129
+#define CONVERT_ROUND   32
+#define CONVERT_SHIFT   6
+
+/** Layout of RGB pixels */
+typedef enum {
+   CONVERT_RGB24,
+   CONVERT_BGR24,
+   CONVERT_RGBA
+} CONVERT_RGB_T;
+
+/** Row functions making up the kernels of an instruction set.
+ * Each function processes as many elements as it efficiently can from the start
+ * of the row and returns how many it did, the scalar implementation finishing the row. */
+typedef struct CONVERT_ROWS_T
+{
+   /** Interleave n U and V samples */
+   unsigned int (*interleave)(uint8_t *uv, const uint8_t *u, const uint8_t *v, unsigned int n);
+   /** De-interleave n pairs of U and V samples */
+   unsigned int (*deinterleave)(uint8_t *u, uint8_t *v, const uint8_t *uv, unsigned int n);
+   /** Convert n pixels (n even) of YUV 4:2:0 to RGB. Chroma is interleaved when v == u + 1 */
+   unsigned int (*yuv_to_rgb)(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                              unsigned int n, CONVERT_RGB_T rgb);
+   /** Convert n pixels (n even) of 2 rows of YUYV to I420 */
+   unsigned int (*yuyv_to_i420)(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                const uint8_t *src0, const uint8_t *src1, unsigned int n);
+   /** Convert n pixels (n even) of a row of I420 to YUYV */
+   unsigned int (*i420_to_yuyv)(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                unsigned int n);
+} CONVERT_ROWS_T;
+
+typedef void (*CONVERT_FRAME_FN_T)(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end);
+
+struct MMAL_CONVERT_KERNEL_T
+{
+   uint32_t from;
+   uint32_t to;
+   CONVERT_FRAME_FN_T pf_frame;
+   const CONVERT_ROWS_T *rows;
+};
+
+/*****************************************************************************
+ * Scalar reference implementation
+ *****************************************************************************/
+static inline uint8_t convert_clamp(int v)
+{
+   return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+static unsigned int convert_interleave_c(uint8_t *uv, const uint8_t *u, const uint8_t *v, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i < n; i++)
+   {
+      uv[2*i] = u[i];
+      uv[2*i+1] = v[i];
+   }
+   return n;
+}
+
+static unsigned int convert_deinterleave_c(uint8_t *u, uint8_t *v, const uint8_t *uv, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i < n; i++)
+   {
+      u[i] = uv[2*i];
+      v[i] = uv[2*i+1];
+   }
+   return n;
+}
+
+static unsigned int convert_yuv_to_rgb_c(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                         unsigned int n, CONVERT_RGB_T rgb)
+{
+   unsigned int i, step = (v == u + 1) ? 2 : 1, bpp = rgb == CONVERT_RGBA ? 4 : 3;
+   unsigned int ri = rgb == CONVERT_BGR24 ? 2 : 0, bi = 2 - ri;
+
+   for (i = 0; i < n; i++, dst += bpp)
+   {
+      int c = CONVERT_Y_MUL * (y[i] - 16) + CONVERT_ROUND;
+      int d = u[(i / 2) * step] - 128;
+      int e = v[(i / 2) * step] - 128;
+
+      dst[ri] = convert_clamp((c + CONVERT_RV_MUL * e) >> CONVERT_SHIFT);
+      dst[1] = convert_clamp((c - CONVERT_GU_MUL * d - CONVERT_GV_MUL * e) >> CONVERT_SHIFT);
+      dst[bi] = convert_clamp((c + CONVERT_BU_MUL * d) >> CONVERT_SHIFT);
+      if (bpp == 4)
+         dst[3] = 0xff;
+   }
+   return n;
+}
+
+static unsigned int convert_yuyv_to_i420_c(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                           const uint8_t *src0, const uint8_t *src1, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i < n / 2; i++, src0 += 4, src1 += 4)
+   {
+      y0[2*i] = src0[0];
+      y0[2*i+1] = src0[2];
+      y1[2*i] = src1[0];
+      y1[2*i+1] = src1[2];
+      /* Chroma of both rows is averaged, rounding up */
+      u[i] = (src0[1] + src1[1] + 1) >> 1;
+      v[i] = (src0[3] + src1[3] + 1) >> 1;
+   }
+   return n;
+}
+
+static unsigned int convert_i420_to_yuyv_c(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                           unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i < n / 2; i++, dst += 4)
+   {
+      dst[0] = y[2*i];
+      dst[1] = u[i];
+      dst[2] = y[2*i+1];
+      dst[3] = v[i];
+   }
+   return n;
+}
+
+static const CONVERT_ROWS_T convert_rows_c =
+{
+   convert_interleave_c,
+   convert_deinterleave_c,
+   convert_yuv_to_rgb_c,
+   convert_yuyv_to_i420_c,
+   convert_i420_to_yuyv_c
+};
+
+/*****************************************************************************
+ * SSE2 implementation
+ *****************************************************************************/
+#ifdef CONVERT_HAVE_SSE2
+CONVERT_TARGET_SSE2
+static unsigned int convert_interleave_sse2(uint8_t *uv, const uint8_t *u, const uint8_t *v, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      __m128i mu = _mm_loadu_si128((const __m128i *)(u + i));
+      __m128i mv = _mm_loadu_si128((const __m128i *)(v + i));
+      _mm_storeu_si128((__m128i *)(uv + 2*i), _mm_unpacklo_epi8(mu, mv));
+      _mm_storeu_si128((__m128i *)(uv + 2*i + 16), _mm_unpackhi_epi8(mu, mv));
+   }
+   return i;
+}
+
+CONVERT_TARGET_SSE2
+static unsigned int convert_deinterleave_sse2(uint8_t *u, uint8_t *v, const uint8_t *uv, unsigned int n)
+{
+   const __m128i mask = _mm_set1_epi16(0xff);
+   unsigned int i;
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i *)(uv + 2*i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(uv + 2*i + 16));
+      _mm_storeu_si128((__m128i *)(u + i), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+      _mm_storeu_si128((__m128i *)(v + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+   }
+   return i;
+}
+
+/** Load 8 chroma samples of each component, widened to 16 bits */
+CONVERT_TARGET_SSE2
+static inline void convert_load_uv_sse2(const uint8_t *u, const uint8_t *v, __m128i *mu, __m128i *mv)
+{
+   const __m128i zero = _mm_setzero_si128();
+
+   if (v == u + 1)
+   {
+      __m128i uv = _mm_loadu_si128((const __m128i *)u);
+      *mu = _mm_and_si128(uv, _mm_set1_epi16(0xff));
+      *mv = _mm_srli_epi16(uv, 8);
+   }
+   else
+   {
+      *mu = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)u), zero);
+      *mv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)v), zero);
+   }
+}
+
+/** Convert 8 pixels from 16 bits Y and chroma contributions to 16 bits R, G, B */
+CONVERT_TARGET_SSE2
+static inline void convert_rgb_8_sse2(__m128i y, __m128i rd, __m128i gd, __m128i bd,
+                                      __m128i *r, __m128i *g, __m128i *b)
+{
+   y = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(CONVERT_Y_MUL)),
+                     _mm_set1_epi16(CONVERT_ROUND));
+   *r = _mm_srai_epi16(_mm_adds_epi16(y, rd), CONVERT_SHIFT);
+   *g = _mm_srai_epi16(_mm_subs_epi16(y, gd), CONVERT_SHIFT);
+   *b = _mm_srai_epi16(_mm_adds_epi16(y, bd), CONVERT_SHIFT);
+}
+
+/** Store 16 pixels given as 8 bits R, G and B vectors */
+CONVERT_TARGET_SSE2
+static inline void convert_store_rgb_16_sse2(uint8_t *dst, __m128i r, __m128i g, __m128i b, CONVERT_RGB_T rgb)
+{
+   const __m128i alpha = _mm_set1_epi8((char)0xff);
+   __m128i rg, ba, px[4];
+   unsigned int i;
+
+   if (rgb == CONVERT_BGR24)
+   {
+      __m128i t = r; r = b; b = t;
+   }
+
+   rg = _mm_unpacklo_epi8(r, g);
+   ba = _mm_unpacklo_epi8(b, alpha);
+   px[0] = _mm_unpacklo_epi16(rg, ba);
+   px[1] = _mm_unpackhi_epi16(rg, ba);
+   rg = _mm_unpackhi_epi8(r, g);
+   ba = _mm_unpackhi_epi8(b, alpha);
+   px[2] = _mm_unpacklo_epi16(rg, ba);
+   px[3] = _mm_unpackhi_epi16(rg, ba);
+
+   if (rgb == CONVERT_RGBA)
+   {
+      for (i = 0; i < 4; i++)
+         _mm_storeu_si128((__m128i *)(dst + 16*i), px[i]);
+      return;
+   }
+
+   /* Pack each pair of 4 bytes pixels into 6 bytes. Each 8 bytes store writes
+    * 2 bytes past the pixels, which are overwritten by the next store, so the
+    * caller must leave at least one pixel to the scalar code. */
+   for (i = 0; i < 4; i++)
+   {
+      __m128i p = _mm_or_si128(_mm_and_si128(px[i], _mm_set_epi32(0, 0xffffff, 0, 0xffffff)),
+                               _mm_and_si128(_mm_srli_epi64(px[i], 8), _mm_set_epi32(0xffff, 0xff000000, 0xffff, 0xff000000)));
+      _mm_storel_epi64((__m128i *)(dst + 12*i), p);
+      _mm_storel_epi64((__m128i *)(dst + 12*i + 6), _mm_unpackhi_epi64(p, p));
+   }
+}
+
+CONVERT_TARGET_SSE2
+static unsigned int convert_yuv_to_rgb_sse2(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                            unsigned int n, CONVERT_RGB_T rgb)
+{
+   const __m128i zero = _mm_setzero_si128();
+   unsigned int i, step = (v == u + 1) ? 2 : 1, bpp = rgb == CONVERT_RGBA ? 4 : 3;
+   /* Packed RGB stores write past the last pixel */
+   unsigned int end = rgb == CONVERT_RGBA ? n : n - 1;
+
+   for (i = 0; i + 16 <= end; i += 16)
+   {
+      __m128i my = _mm_loadu_si128((const __m128i *)(y + i));
+      __m128i mu, mv, rd, gd, bd, r0, g0, b0, r1, g1, b1;
+
+      convert_load_uv_sse2(u + i / 2 * step, v + i / 2 * step, &mu, &mv);
+      mu = _mm_sub_epi16(mu, _mm_set1_epi16(128));
+      mv = _mm_sub_epi16(mv, _mm_set1_epi16(128));
+      rd = _mm_mullo_epi16(mv, _mm_set1_epi16(CONVERT_RV_MUL));
+      gd = _mm_add_epi16(_mm_mullo_epi16(mu, _mm_set1_epi16(CONVERT_GU_MUL)),
+                         _mm_mullo_epi16(mv, _mm_set1_epi16(CONVERT_GV_MUL)));
+      bd = _mm_mullo_epi16(mu, _mm_set1_epi16(CONVERT_BU_MUL));
+
+      /* Each chroma sample covers 2 pixels */
+      convert_rgb_8_sse2(_mm_unpacklo_epi8(my, zero), _mm_unpacklo_epi16(rd, rd),
+                         _mm_unpacklo_epi16(gd, gd), _mm_unpacklo_epi16(bd, bd), &r0, &g0, &b0);
+      convert_rgb_8_sse2(_mm_unpackhi_epi8(my, zero), _mm_unpackhi_epi16(rd, rd),
+                         _mm_unpackhi_epi16(gd, gd), _mm_unpackhi_epi16(bd, bd), &r1, &g1, &b1);
+
+      convert_store_rgb_16_sse2(dst + i * bpp, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1),
+                                _mm_packus_epi16(b0, b1), rgb);
+   }
+   return i;
+}
+
+CONVERT_TARGET_SSE2
+static unsigned int convert_yuyv_to_i420_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                              const uint8_t *src0, const uint8_t *src1, unsigned int n)
+{
+   const __m128i mask = _mm_set1_epi16(0xff);
+   unsigned int i;
+
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      __m128i a0 = _mm_loadu_si128((const __m128i *)(src0 + 2*i));
+      __m128i a1 = _mm_loadu_si128((const __m128i *)(src0 + 2*i + 16));
+      __m128i b0 = _mm_loadu_si128((const __m128i *)(src1 + 2*i));
+      __m128i b1 = _mm_loadu_si128((const __m128i *)(src1 + 2*i + 16));
+      __m128i uv;
+
+      _mm_storeu_si128((__m128i *)(y0 + i), _mm_packus_epi16(_mm_and_si128(a0, mask), _mm_and_si128(a1, mask)));
+      _mm_storeu_si128((__m128i *)(y1 + i), _mm_packus_epi16(_mm_and_si128(b0, mask), _mm_and_si128(b1, mask)));
+
+      uv = _mm_avg_epu8(_mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8)),
+                        _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8)));
+      _mm_storel_epi64((__m128i *)(u + i/2), _mm_packus_epi16(_mm_and_si128(uv, mask), mask));
+      _mm_storel_epi64((__m128i *)(v + i/2), _mm_packus_epi16(_mm_srli_epi16(uv, 8), mask));
+   }
+   return i;
+}
+
+CONVERT_TARGET_SSE2
+static unsigned int convert_i420_to_yuyv_sse2(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                              unsigned int n)
+{
+   unsigned int i;
+
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      __m128i my = _mm_loadu_si128((const __m128i *)(y + i));
+      __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u + i/2)),
+                                     _mm_loadl_epi64((const __m128i *)(v + i/2)));
+      _mm_storeu_si128((__m128i *)(dst + 2*i), _mm_unpacklo_epi8(my, uv));
+      _mm_storeu_si128((__m128i *)(dst + 2*i + 16), _mm_unpackhi_epi8(my, uv));
+   }
+   return i;
+}
+
+static const CONVERT_ROWS_T convert_rows_sse2 =
+{
+   convert_interleave_sse2,
+   convert_deinterleave_sse2,
+   convert_yuv_to_rgb_sse2,
+   convert_yuyv_to_i420_sse2,
+   convert_i420_to_yuyv_sse2
+};
+# define CONVERT_ROWS_SSE2 &convert_rows_sse2
+#else
+# define CONVERT_ROWS_SSE2 NULL
+#endif /* CONVERT_HAVE_SSE2 */
+
+/*****************************************************************************
+ * AVX2 implementation
+ *****************************************************************************/
+#ifdef CONVERT_HAVE_AVX2
+CONVERT_TARGET_AVX2
+static unsigned int convert_interleave_avx2(uint8_t *uv, const uint8_t *u, const uint8_t *v, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i + 32 <= n; i += 32)
+   {
+      __m256i mu = _mm256_loadu_si256((const __m256i *)(u + i));
+      __m256i mv = _mm256_loadu_si256((const __m256i *)(v + i));
+      __m256i lo = _mm256_unpacklo_epi8(mu, mv), hi = _mm256_unpackhi_epi8(mu, mv);
+      /* Unpacking works within 128 bits lanes */
+      _mm256_storeu_si256((__m256i *)(uv + 2*i), _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i *)(uv + 2*i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+   }
+   return i;
+}
+
+CONVERT_TARGET_AVX2
+static unsigned int convert_deinterleave_avx2(uint8_t *u, uint8_t *v, const uint8_t *uv, unsigned int n)
+{
+   const __m256i mask = _mm256_set1_epi16(0xff);
+   unsigned int i;
+   for (i = 0; i + 32 <= n; i += 32)
+   {
+      __m256i a = _mm256_loadu_si256((const __m256i *)(uv + 2*i));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(uv + 2*i + 32));
+      /* Packing works within 128 bits lanes */
+      __m256i mu = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+      __m256i mv = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+      _mm256_storeu_si256((__m256i *)(u + i), _mm256_permute4x64_epi64(mu, 0xd8));
+      _mm256_storeu_si256((__m256i *)(v + i), _mm256_permute4x64_epi64(mv, 0xd8));
+   }
+   return i;
+}
+
+/** Load 16 chroma samples of each component, each repeated twice, widened to 16 bits */
+CONVERT_TARGET_AVX2
+static inline void convert_load_uv_avx2(const uint8_t *u, const uint8_t *v, __m256i mu[2], __m256i mv[2])
+{
+   __m128i cu, cv;
+
+   if (v == u + 1)
+   {
+      const __m128i mask = _mm_set1_epi16(0xff);
+      __m128i a = _mm_loadu_si128((const __m128i *)u);
+      __m128i b = _mm_loadu_si128((const __m128i *)(u + 16));
+      cu = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+      cv = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+   }
+   else
+   {
+      cu = _mm_loadu_si128((const __m128i *)u);
+      cv = _mm_loadu_si128((const __m128i *)v);
+   }
+
+   mu[0] = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cu, cu));
+   mu[1] = _mm256_cvtepu8_epi16(_mm_unpackhi_epi8(cu, cu));
+   mv[0] = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cv, cv));
+   mv[1] = _mm256_cvtepu8_epi16(_mm_unpackhi_epi8(cv, cv));
+}
+
+/** Convert 16 pixels to 16 bits R, G, B */
+CONVERT_TARGET_AVX2
+static inline void convert_rgb_16_avx2(__m256i y, __m256i u, __m256i v,
+                                       __m256i *r, __m256i *g, __m256i *b)
+{
+   __m256i d = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+   __m256i e = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+
+   y = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)),
+                                           _mm256_set1_epi16(CONVERT_Y_MUL)),
+                        _mm256_set1_epi16(CONVERT_ROUND));
+   *r = _mm256_srai_epi16(_mm256_adds_epi16(y, _mm256_mullo_epi16(e, _mm256_set1_epi16(CONVERT_RV_MUL))),
+                          CONVERT_SHIFT);
+   *g = _mm256_srai_epi16(_mm256_subs_epi16(y,
+           _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(CONVERT_GU_MUL)),
+                            _mm256_mullo_epi16(e, _mm256_set1_epi16(CONVERT_GV_MUL)))), CONVERT_SHIFT);
+   *b = _mm256_srai_epi16(_mm256_adds_epi16(y, _mm256_mullo_epi16(d, _mm256_set1_epi16(CONVERT_BU_MUL))),
+                          CONVERT_SHIFT);
+}
+
+CONVERT_TARGET_AVX2
+static unsigned int convert_yuv_to_rgb_avx2(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                            unsigned int n, CONVERT_RGB_T rgb)
+{
+   unsigned int i, step = (v == u + 1) ? 2 : 1, bpp = rgb == CONVERT_RGBA ? 4 : 3;
+   /* Packed RGB stores write past the last pixel */
+   unsigned int end = rgb == CONVERT_RGBA ? n : n - 1;
+
+   for (i = 0; i + 32 <= end; i += 32)
+   {
+      __m256i mu[2], mv[2], r0, g0, b0, r1, g1, b1, r, g, b;
+
+      convert_load_uv_avx2(u + i / 2 * step, v + i / 2 * step, mu, mv);
+      convert_rgb_16_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + i))),
+                          mu[0], mv[0], &r0, &g0, &b0);
+      convert_rgb_16_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + i + 16))),
+                          mu[1], mv[1], &r1, &g1, &b1);
+
+      /* Packing works within 128 bits lanes */
+      r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r0, r1), 0xd8);
+      g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g0, g1), 0xd8);
+      b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b1), 0xd8);
+
+      convert_store_rgb_16_sse2(dst + i * bpp, _mm256_castsi256_si128(r), _mm256_castsi256_si128(g),
+                                _mm256_castsi256_si128(b), rgb);
+      convert_store_rgb_16_sse2(dst + (i + 16) * bpp, _mm256_extracti128_si256(r, 1),
+                                _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(b, 1), rgb);
+   }
+   return i;
+}
+
+/* Conversions to and from YUYV are memory bound and use the SSE2 kernels */
+static const CONVERT_ROWS_T convert_rows_avx2 =
+{
+   convert_interleave_avx2,
+   convert_deinterleave_avx2,
+   convert_yuv_to_rgb_avx2,
+   convert_yuyv_to_i420_sse2,
+   convert_i420_to_yuyv_sse2
+};
+# define CONVERT_ROWS_AVX2 &convert_rows_avx2
+#else
+# define CONVERT_ROWS_AVX2 NULL
+#endif /* CONVERT_HAVE_AVX2 */
+
+/*****************************************************************************
+ * NEON implementation
+ *****************************************************************************/
+#ifdef CONVERT_HAVE_NEON
+static unsigned int convert_interleave_neon(uint8_t *uv, const uint8_t *u, const uint8_t *v, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      uint8x16x2_t p;
+      p.val[0] = vld1q_u8(u + i);
+      p.val[1] = vld1q_u8(v + i);
+      vst2q_u8(uv + 2*i, p);
+   }
+   return i;
+}
+
+static unsigned int convert_deinterleave_neon(uint8_t *u, uint8_t *v, const uint8_t *uv, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      uint8x16x2_t p = vld2q_u8(uv + 2*i);
+      vst1q_u8(u + i, p.val[0]);
+      vst1q_u8(v + i, p.val[1]);
+   }
+   return i;
+}
+
+/** Convert 8 pixels to 8 bits R, G, B */
+static inline void convert_rgb_8_neon(uint8x8_t y8, int16x8_t rd, int16x8_t gd, int16x8_t bd,
+                                      uint8x8_t *r, uint8x8_t *g, uint8x8_t *b)
+{
+   int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(y8));
+   y = vaddq_s16(vmulq_n_s16(vsubq_s16(y, vdupq_n_s16(16)), CONVERT_Y_MUL), vdupq_n_s16(CONVERT_ROUND));
+   *r = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y, rd), CONVERT_SHIFT));
+   *g = vqmovun_s16(vshrq_n_s16(vqsubq_s16(y, gd), CONVERT_SHIFT));
+   *b = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y, bd), CONVERT_SHIFT));
+}
+
+static unsigned int convert_yuv_to_rgb_neon(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                            unsigned int n, CONVERT_RGB_T rgb)
+{
+   unsigned int i, step = (v == u + 1) ? 2 : 1, bpp = rgb == CONVERT_RGBA ? 4 : 3;
+
+   for (i = 0; i + 16 <= n; i += 16)
+   {
+      uint8x16_t my = vld1q_u8(y + i);
+      uint8x8_t cu, cv, r0, g0, b0, r1, g1, b1;
+      int16x8_t d, e, rd, gd, bd;
+      int16x8x2_t rr, gg, bb;
+
+      if (step == 2)
+      {
+         uint8x8x2_t uv = vld2_u8(u + i);
+         cu = uv.val[0];
+         cv = uv.val[1];
+      }
+      else
+      {
+         cu = vld1_u8(u + i / 2);
+         cv = vld1_u8(v + i / 2);
+      }
+      d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cu)), vdupq_n_s16(128));
+      e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cv)), vdupq_n_s16(128));
+      rd = vmulq_n_s16(e, CONVERT_RV_MUL);
+      gd = vaddq_s16(vmulq_n_s16(d, CONVERT_GU_MUL), vmulq_n_s16(e, CONVERT_GV_MUL));
+      bd = vmulq_n_s16(d, CONVERT_BU_MUL);
+
+      /* Each chroma sample covers 2 pixels */
+      rr = vzipq_s16(rd, rd);
+      gg = vzipq_s16(gd, gd);
+      bb = vzipq_s16(bd, bd);
+      convert_rgb_8_neon(vget_low_u8(my), rr.val[0], gg.val[0], bb.val[0], &r0, &g0, &b0);
+      convert_rgb_8_neon(vget_high_u8(my), rr.val[1], gg.val[1], bb.val[1], &r1, &g1, &b1);
+
+      if (rgb == CONVERT_RGBA)
+      {
+         uint8x16x4_t px;
+         px.val[0] = vcombine_u8(r0, r1);
+         px.val[1] = vcombine_u8(g0, g1);
+         px.val[2] = vcombine_u8(b0, b1);
+         px.val[3] = vdupq_n_u8(0xff);
+         vst4q_u8(dst + i * bpp, px);
+      }
+      else
+      {
+         uint8x16x3_t px;
+         px.val[rgb == CONVERT_BGR24 ? 2 : 0] = vcombine_u8(r0, r1);
+         px.val[1] = vcombine_u8(g0, g1);
+         px.val[rgb == CONVERT_BGR24 ? 0 : 2] = vcombine_u8(b0, b1);
+         vst3q_u8(dst + i * bpp, px);
+      }
+   }
+   return i;
+}
+
+static unsigned int convert_yuyv_to_i420_neon(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+                                              const uint8_t *src0, const uint8_t *src1, unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i + 32 <= n; i += 32)
+   {
+      /* Y0 U Y1 V for 16 pairs of pixels */
+      uint8x16x4_t a = vld4q_u8(src0 + 2*i);
+      uint8x16x4_t b = vld4q_u8(src1 + 2*i);
+      uint8x16x2_t ya, yb;
+
+      ya.val[0] = a.val[0]; ya.val[1] = a.val[2];
+      yb.val[0] = b.val[0]; yb.val[1] = b.val[2];
+      vst2q_u8(y0 + i, ya);
+      vst2q_u8(y1 + i, yb);
+      vst1q_u8(u + i/2, vrhaddq_u8(a.val[1], b.val[1]));
+      vst1q_u8(v + i/2, vrhaddq_u8(a.val[3], b.val[3]));
+   }
+   return i;
+}
+
+static unsigned int convert_i420_to_yuyv_neon(uint8_t *dst, const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                              unsigned int n)
+{
+   unsigned int i;
+   for (i = 0; i + 32 <= n; i += 32)
+   {
+      uint8x16x2_t my = vld2q_u8(y + i);
+      uint8x16x4_t px;
+      px.val[0] = my.val[0];
+      px.val[1] = vld1q_u8(u + i/2);
+      px.val[2] = my.val[1];
+      px.val[3] = vld1q_u8(v + i/2);
+      vst4q_u8(dst + 2*i, px);
+   }
+   return i;
+}
+
+static const CONVERT_ROWS_T convert_rows_neon =
+{
+   convert_interleave_neon,
+   convert_deinterleave_neon,
+   convert_yuv_to_rgb_neon,
+   convert_yuyv_to_i420_neon,
+   convert_i420_to_yuyv_neon
+};
+# define CONVERT_ROWS_NEON &convert_rows_neon
+#else
+# define CONVERT_ROWS_NEON NULL
+#endif /* CONVERT_HAVE_NEON */
+
+/*****************************************************************************
+ * Frame kernels
+ *****************************************************************************/
+static CONVERT_RGB_T convert_rgb_layout(uint32_t encoding)
+{
+   return encoding == MMAL_ENCODING_RGBA ? CONVERT_RGBA :
+          encoding == MMAL_ENCODING_BGR24 ? CONVERT_BGR24 : CONVERT_RGB24;
+}
+
+static void convert_copy_rows(uint8_t *dst, uint32_t dst_pitch, const uint8_t *src, uint32_t src_pitch,
+                              unsigned int size, unsigned int y_start, unsigned int y_end)
+{
+   unsigned int y;
+   for (y = y_start; y < y_end; y++)
+      memcpy(dst + y * dst_pitch, src + y * src_pitch, size);
+}
+
+static void convert_frame_copy(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end)
+{
+   unsigned int i;
+
+   switch (kernel->from)
+   {
+   case MMAL_ENCODING_I420:
+      convert_copy_rows(dst->plane[0], dst->pitch[0], src->plane[0], src->pitch[0], width, y_start, y_end);
+      for (i = 1; i < 3; i++)
+         convert_copy_rows(dst->plane[i], dst->pitch[i], src->plane[i], src->pitch[i], width / 2,
+                           y_start / 2, y_end / 2);
+      break;
+   case MMAL_ENCODING_NV12:
+      convert_copy_rows(dst->plane[0], dst->pitch[0], src->plane[0], src->pitch[0], width, y_start, y_end);
+      convert_copy_rows(dst->plane[1], dst->pitch[1], src->plane[1], src->pitch[1], width,
+                        y_start / 2, y_end / 2);
+      break;
+   default:
+      convert_copy_rows(dst->plane[0], dst->pitch[0], src->plane[0], src->pitch[0],
+                        mmal_encoding_width_to_stride(kernel->from, width), y_start, y_end);
+      break;
+   }
+}
+
+static void convert_frame_i420_to_nv12(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end)
+{
+   unsigned int y, n = width / 2, done;
+
+   convert_copy_rows(dst->plane[0], dst->pitch[0], src->plane[0], src->pitch[0], width, y_start, y_end);
+   for (y = y_start / 2; y < y_end / 2; y++)
+   {
+      uint8_t *uv = dst->plane[1] + y * dst->pitch[1];
+      const uint8_t *u = src->plane[1] + y * src->pitch[1];
+      const uint8_t *v = src->plane[2] + y * src->pitch[2];
+
+      done = kernel->rows->interleave(uv, u, v, n);
+      convert_interleave_c(uv + 2 * done, u + done, v + done, n - done);
+   }
+}
+
+static void convert_frame_nv12_to_i420(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end)
+{
+   unsigned int y, n = width / 2, done;
+
+   convert_copy_rows(dst->plane[0], dst->pitch[0], src->plane[0], src->pitch[0], width, y_start, y_end);
+   for (y = y_start / 2; y < y_end / 2; y++)
+   {
+      const uint8_t *uv = src->plane[1] + y * src->pitch[1];
+      uint8_t *u = dst->plane[1] + y * dst->pitch[1];
+      uint8_t *v = dst->plane[2] + y * dst->pitch[2];
+
+      done = kernel->rows->deinterleave(u, v, uv, n);
+      convert_deinterleave_c(u + done, v + done, uv + 2 * done, n - done);
+   }
+}
+
+static void convert_frame_yuv420_to_rgb(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end)
+{
+   CONVERT_RGB_T rgb = convert_rgb_layout(kernel->to);
+   unsigned int y, done, bpp = rgb == CONVERT_RGBA ? 4 : 3;
+   MMAL_BOOL_T nv12 = kernel->from == MMAL_ENCODING_NV12;
+
+   for (y = y_start; y < y_end; y++)
+   {
+      const uint8_t *luma = src->plane[0] + y * src->pitch[0];
+      const uint8_t *u = src->plane[1] + y / 2 * src->pitch[1];
+      const uint8_t *v = nv12 ? u + 1 : src->plane[2] + y / 2 * src->pitch[2];
+      uint8_t *out = dst->plane[0] + y * dst->pitch[0];
+      unsigned int c;
+
+      done = kernel->rows->yuv_to_rgb(out, luma, u, v, width, rgb);
+      c = nv12 ? done : done / 2; /* Offset of the chroma of the remaining pixels */
+      convert_yuv_to_rgb_c(out + done * bpp, luma + done, u + c, v + c, width - done, rgb);
+   }
+}
+
+static void convert_frame_yuyv_to_i420(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end)
+{
+   unsigned int y, done;
+
+   for (y = y_start; y < y_end; y += 2)
+   {
+      const uint8_t *src0 = src->plane[0] + y * src->pitch[0];
+      const uint8_t *src1 = src0 + src->pitch[0];
+      uint8_t *y0 = dst->plane[0] + y * dst->pitch[0];
+      uint8_t *y1 = y0 + dst->pitch[0];
+      uint8_t *u = dst->plane[1] + y / 2 * dst->pitch[1];
+      uint8_t *v = dst->plane[2] + y / 2 * dst->pitch[2];
+
+      done = kernel->rows->yuyv_to_i420(y0, y1, u, v, src0, src1, width);
+      convert_yuyv_to_i420_c(y0 + done, y1 + done, u + done / 2, v + done / 2,
+                             src0 + 2 * done, src1 + 2 * done, width - done);
+   }
+}
+
+static void convert_frame_i420_to_yuyv(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, unsigned int width, unsigned int y_start, unsigned int y_end)
+{
+   unsigned int y, done;
+
+   for (y = y_start; y < y_end; y++)
+   {
+      const uint8_t *luma = src->plane[0] + y * src->pitch[0];
+      const uint8_t *u = src->plane[1] + y / 2 * src->pitch[1];
+      const uint8_t *v = src->plane[2] + y / 2 * src->pitch[2];
+      uint8_t *out = dst->plane[0] + y * dst->pitch[0];
+
+      done = kernel->rows->i420_to_yuyv(out, luma, u, v, width);
+      convert_i420_to_yuyv_c(out + 2 * done, luma + done, u + done / 2, v + done / 2, width - done);
+   }
+}
+
+#define CONVERT_KERNELS(rows) { \
+   { MMAL_ENCODING_I420,  MMAL_ENCODING_NV12,  convert_frame_i420_to_nv12,  rows }, \
+   { MMAL_ENCODING_NV12,  MMAL_ENCODING_I420,  convert_frame_nv12_to_i420,  rows }, \
+   { MMAL_ENCODING_I420,  MMAL_ENCODING_RGB24, convert_frame_yuv420_to_rgb, rows }, \
+   { MMAL_ENCODING_I420,  MMAL_ENCODING_BGR24, convert_frame_yuv420_to_rgb, rows }, \
+   { MMAL_ENCODING_I420,  MMAL_ENCODING_RGBA,  convert_frame_yuv420_to_rgb, rows }, \
+   { MMAL_ENCODING_NV12,  MMAL_ENCODING_RGB24, convert_frame_yuv420_to_rgb, rows }, \
+   { MMAL_ENCODING_NV12,  MMAL_ENCODING_BGR24, convert_frame_yuv420_to_rgb, rows }, \
+   { MMAL_ENCODING_NV12,  MMAL_ENCODING_RGBA,  convert_frame_yuv420_to_rgb, rows }, \
+   { MMAL_ENCODING_YUYV,  MMAL_ENCODING_I420,  convert_frame_yuyv_to_i420,  rows }, \
+   { MMAL_ENCODING_I420,  MMAL_ENCODING_YUYV,  convert_frame_i420_to_yuyv,  rows }, \
+   { MMAL_ENCODING_I420,  MMAL_ENCODING_I420,  convert_frame_copy,          rows }, \
+   { MMAL_ENCODING_NV12,  MMAL_ENCODING_NV12,  convert_frame_copy,          rows }, \
+   { MMAL_ENCODING_YUYV,  MMAL_ENCODING_YUYV,  convert_frame_copy,          rows }, \
+   { MMAL_ENCODING_RGB24, MMAL_ENCODING_RGB24, convert_frame_copy,          rows }, \
+   { MMAL_ENCODING_BGR24, MMAL_ENCODING_BGR24, convert_frame_copy,          rows }, \
+   { MMAL_ENCODING_RGBA,  MMAL_ENCODING_RGBA,  convert_frame_copy,          rows }, \
+   { MMAL_ENCODING_UNKNOWN, MMAL_ENCODING_UNKNOWN, NULL, NULL } }
+
+static const MMAL_CONVERT_KERNEL_T convert_kernels[MMAL_CONVERT_ISA_MAX][17] =
+{
+   CONVERT_KERNELS(&convert_rows_c),
+   CONVERT_KERNELS(CONVERT_ROWS_SSE2),
+   CONVERT_KERNELS(CONVERT_ROWS_AVX2),
+   CONVERT_KERNELS(CONVERT_ROWS_NEON)
+};
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+static MMAL_BOOL_T mmal_convert_isa_available(MMAL_CONVERT_ISA_T isa)
+{
+   switch (isa)
+   {
+   case MMAL_CONVERT_ISA_C:
+      return MMAL_TRUE;
+#ifdef CONVERT_HAVE_SSE2
+   case MMAL_CONVERT_ISA_SSE2:
+      return __builtin_cpu_supports("sse2");
+#endif
+#ifdef CONVERT_HAVE_AVX2
+   case MMAL_CONVERT_ISA_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+#ifdef CONVERT_HAVE_NEON
+   case MMAL_CONVERT_ISA_NEON:
+      return MMAL_TRUE;
+#endif
+   default:
+      return MMAL_FALSE;
+   }
+}
+
+MMAL_CONVERT_ISA_T mmal_convert_isa_best(void)
+{
+   int isa;
+
+   for (isa = MMAL_CONVERT_ISA_MAX - 1; isa > MMAL_CONVERT_ISA_C; isa--)
+      if (mmal_convert_isa_available((MMAL_CONVERT_ISA_T)isa))
+         break;
+   return (MMAL_CONVERT_ISA_T)isa;
+}
+
+const char *mmal_convert_isa_to_string(MMAL_CONVERT_ISA_T isa)
+{
+   switch (isa)
+   {
+   case MMAL_CONVERT_ISA_C:    return "C";
+   case MMAL_CONVERT_ISA_SSE2: return "SSE2";
+   case MMAL_CONVERT_ISA_AVX2: return "AVX2";
+   case MMAL_CONVERT_ISA_NEON: return "NEON";
+   default:                    return "unknown";
+   }
+}
+
+const MMAL_CONVERT_KERNEL_T *mmal_convert_kernel_get(uint32_t from, uint32_t to, MMAL_CONVERT_ISA_T isa)
+{
+   const MMAL_CONVERT_KERNEL_T *kernel;
+
+   if (isa >= MMAL_CONVERT_ISA_MAX || !mmal_convert_isa_available(isa))
+      return NULL;
+
+   for (kernel = convert_kernels[isa]; kernel->pf_frame; kernel++)
+      if (kernel->from == from && kernel->to == to)
+         return kernel->rows ? kernel : NULL;
+
+   return NULL;
+}
+
+void mmal_convert_kernel_run(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, uint32_t width, uint32_t y_start, uint32_t y_end)
+{
+   kernel->pf_frame(kernel, src, dst, width & ~1, y_start & ~1, y_end & ~1);
+}
+
+MMAL_BOOL_T mmal_convert_encoding_supported(uint32_t encoding)
+{
+   const MMAL_CONVERT_KERNEL_T *kernel;
+
+   for (kernel = convert_kernels[MMAL_CONVERT_ISA_C]; kernel->pf_frame; kernel++)
+      if (kernel->from == encoding || kernel->to == encoding)
+         return MMAL_TRUE;
+   return MMAL_FALSE;
+}
+
+uint32_t mmal_convert_frame_size(const MMAL_ES_FORMAT_T *format)
+{
+   const MMAL_VIDEO_FORMAT_T *video = &format->es->video;
+   uint32_t stride = mmal_encoding_width_to_stride(format->encoding, video->width);
+
+   if (!mmal_convert_encoding_supported(format->encoding))
+      return 0;
+
+   switch (format->encoding)
+   {
+   case MMAL_ENCODING_I420:
+   case MMAL_ENCODING_NV12:
+      return stride * video->height * 3 / 2;
+   default:
+      return stride * video->height;
+   }
+}
+
+MMAL_STATUS_T mmal_convert_picture_setup(MMAL_CONVERT_PICTURE_T *picture,
+   const MMAL_ES_FORMAT_T *format, uint8_t *data)
+{
+   const MMAL_VIDEO_FORMAT_T *video = &format->es->video;
+   uint32_t stride = mmal_encoding_width_to_stride(format->encoding, video->width);
+   uint32_t x = video->crop.x & ~1, y = video->crop.y & ~1;
+
+   if (!stride || !mmal_convert_encoding_supported(format->encoding))
+      return MMAL_ENOSYS;
+
+   memset(picture, 0, sizeof(*picture));
+   picture->plane[0] = data + y * stride + mmal_encoding_width_to_stride(format->encoding, x);
+   picture->pitch[0] = stride;
+
+   switch (format->encoding)
+   {
+   case MMAL_ENCODING_I420:
+      picture->pitch[1] = picture->pitch[2] = stride / 2;
+      picture->plane[1] = data + stride * video->height + y / 2 * picture->pitch[1] + x / 2;
+      picture->plane[2] = data + stride * video->height + picture->pitch[1] * video->height / 2 +
+                          y / 2 * picture->pitch[2] + x / 2;
+      break;
+   case MMAL_ENCODING_NV12:
+      picture->pitch[1] = stride;
+      picture->plane[1] = data + stride * video->height + y / 2 * picture->pitch[1] + x;
+      break;
+   default:
+      break;
+   }
+   return MMAL_SUCCESS;
+}
@@ -0,0 +1,153 @@
+/*
+Copyright (c) 2012, Broadcom Europe Ltd
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MMAL_UTIL_CONVERT_H
+#define MMAL_UTIL_CONVERT_H
+
+#include "interface/mmal/mmal_types.h"
+#include "interface/mmal/mmal_format.h"
+
+/** \defgroup MmalConvertUtilities Pixel Format Conversion Utility Functions
+ * \ingroup MmalUtilities
+ * The pixel format conversion functions convert video frames between a few
+ * common YUV and RGB layouts in software.
+ *
+ * Conversions are done by kernels which process a range of rows of a picture,
+ * so that a frame can be split into bands converted in parallel. Each kernel
+ * comes as a scalar reference implementation and, where available, SIMD
+ * implementations which produce exactly the same output.
+ *
+ * The supported conversions are:
+ *  - I420 <-> NV12
+ *  - I420, NV12 -> RGB24, BGR24, RGBA (BT.601, limited range)
+ *  - YUYV <-> I420
+ *  - a plain copy between pictures of the same encoding
+ *
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Instruction sets conversion kernels can be implemented with */
+typedef enum MMAL_CONVERT_ISA_T
+{
+   MMAL_CONVERT_ISA_C = 0,  /**< Portable scalar reference implementation */
+   MMAL_CONVERT_ISA_SSE2,   /**< x86 SSE2 */
+   MMAL_CONVERT_ISA_AVX2,   /**< x86 AVX2 */
+   MMAL_CONVERT_ISA_NEON,   /**< ARM NEON */
+   MMAL_CONVERT_ISA_MAX
+} MMAL_CONVERT_ISA_T;
+
+/** Description of the planes of a picture */
+typedef struct MMAL_CONVERT_PICTURE_T
+{
+   uint8_t *plane[3];   /**< Start of the visible area in each plane */
+   uint32_t pitch[3];   /**< Distance in bytes between 2 rows of each plane */
+} MMAL_CONVERT_PICTURE_T;
+
+/** Conversion kernel */
+typedef struct MMAL_CONVERT_KERNEL_T MMAL_CONVERT_KERNEL_T;
+
+/** Find the kernel converting between 2 encodings.
+ *
+ * @param from Encoding of the source picture
+ * @param to   Encoding of the destination picture
+ * @param isa  Instruction set to use. The kernel will fall back to a lesser instruction set
+ *             for the parts of the conversion which aren't implemented with this one.
+ *
+ * @return The kernel or NULL if the conversion or the instruction set isn't supported
+ */
+const MMAL_CONVERT_KERNEL_T *mmal_convert_kernel_get(uint32_t from, uint32_t to, MMAL_CONVERT_ISA_T isa);
+
+/** Convert a band of rows of a picture.
+ * Bands of a picture can be converted concurrently.
+ *
+ * @param kernel  Kernel to use
+ * @param src     Source picture
+ * @param dst     Destination picture
+ * @param width   Number of pixels to convert on each row (must be even)
+ * @param y_start First row of the band (must be even)
+ * @param y_end   Row after the last row of the band (must be even)
+ */
+void mmal_convert_kernel_run(const MMAL_CONVERT_KERNEL_T *kernel, const MMAL_CONVERT_PICTURE_T *src,
+   const MMAL_CONVERT_PICTURE_T *dst, uint32_t width, uint32_t y_start, uint32_t y_end);
+
+/** Get the best instruction set supported by the CPU we are running on.
+ *
+ * @return Instruction set
+ */
+MMAL_CONVERT_ISA_T mmal_convert_isa_best(void);
+
+/** Get a string describing an instruction set.
+ *
+ * @param isa Instruction set
+ *
+ * @return String describing the instruction set
+ */
+const char *mmal_convert_isa_to_string(MMAL_CONVERT_ISA_T isa);
+
+/** Check whether an encoding can be converted to or from.
+ *
+ * @param encoding Encoding
+ *
+ * @return MMAL_TRUE if the encoding is supported
+ */
+MMAL_BOOL_T mmal_convert_encoding_supported(uint32_t encoding);
+
+/** Get the size of a frame in a given video format.
+ * The layout of the frame is derived from the encoding, the width and the height
+ * of the format, using \ref mmal_encoding_width_to_stride for the stride.
+ *
+ * @param format Video format
+ *
+ * @return Size of the frame in bytes or 0 if the encoding isn't supported
+ */
+uint32_t mmal_convert_frame_size(const MMAL_ES_FORMAT_T *format);
+
+/** Describe the planes of a frame in a given video format.
+ * The layout of the frame is the one used by \ref mmal_convert_frame_size.
+ * The plane pointers point to the top-left corner of the crop rectangle of the format,
+ * rounded down to an even position.
+ *
+ * @param picture Picture to fill in
+ * @param format  Video format of the frame
+ * @param data    Start of the frame
+ *
+ * @return MMAL_SUCCESS or MMAL_ENOSYS if the encoding isn't supported
+ */
+MMAL_STATUS_T mmal_convert_picture_setup(MMAL_CONVERT_PICTURE_T *picture,
+   const MMAL_ES_FORMAT_T *format, uint8_t *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif /* MMAL_UTIL_CONVERT_H */